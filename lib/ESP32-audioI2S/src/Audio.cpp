@@ -14,6 +14,7 @@
 #include "mp3_decoder/mp3_decoder.h"
 #include "opus_decoder/opus_decoder.h"
 #include "vorbis_decoder/vorbis_decoder.h"
+#include "ogg_demuxer/ogg_demuxer.h"
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 AudioBuffer::AudioBuffer(size_t maxBlockSize) {
@@ -35,21 +36,23 @@ void AudioBuffer::setBufsize(int ram, int psram) {
 
 int32_t AudioBuffer::getBufsize() { return m_buffSize; }
 
-size_t AudioBuffer::init() {
+size_t AudioBuffer::init(size_t psramSize) {
     if(m_buffer) free(m_buffer);
     m_buffer = NULL;
     if(psramInit() && m_buffSizePSRAM > 0) {
         // PSRAM found, AudioBuffer will be allocated in PSRAM
         m_f_psram = true;
-        m_buffSize = m_buffSizePSRAM;
+        m_buffSize = psramSize ? psramSize + m_resBuffSizePSRAM : m_buffSizePSRAM;
         m_buffer = (uint8_t*)ps_calloc(m_buffSize, sizeof(uint8_t));
-        m_buffSize = m_buffSizePSRAM - m_resBuffSizePSRAM;
+        m_buffSize = m_buffSize - m_resBuffSizePSRAM;
+        m_resBuffSize = m_resBuffSizePSRAM;
     }
     if(m_buffer == NULL) {
         // PSRAM not found, not configured or not enough available
         m_f_psram = false;
         m_buffer = (uint8_t*)heap_caps_calloc(m_buffSizeRAM, sizeof(uint8_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
         m_buffSize = m_buffSizeRAM - m_resBuffSizeRAM;
+        m_resBuffSize = m_resBuffSizeRAM;
     }
     if(!m_buffer) return 0;
     m_f_init = true;
@@ -59,6 +62,7 @@ size_t AudioBuffer::init() {
 
 void AudioBuffer::changeMaxBlockSize(uint16_t mbs) {
     m_maxBlockSize = mbs;
+    if(m_f_init && m_resBuffSize < mbs) resize(m_buffSize, m_f_psram); // resized in RAM, the reserve must grow too
     return;
 }
 
@@ -96,6 +100,7 @@ size_t AudioBuffer::getMaxAvailableBytes() {
 }
 
 void AudioBuffer::bytesWritten(size_t bw) {
+    m_bytesIn += bw;
     m_writePtr += bw;
     if(m_writePtr == m_endPtr) { m_writePtr = m_buffer; }
     if(bw && m_f_start) m_f_start = false;
@@ -130,6 +135,37 @@ void AudioBuffer::resetBuffer() {
 uint32_t AudioBuffer::getWritePos() { return m_writePtr - m_buffer; }
 
 uint32_t AudioBuffer::getReadPos() { return m_readPtr - m_buffer; }
+
+size_t AudioBuffer::getBytesToEnd() { return m_endPtr - m_readPtr; }
+
+size_t AudioBuffer::getMaxBufsize() { return psramFound() ? m_buffSizePSRAM - m_resBuffSizePSRAM : m_buffSizeRAM - m_resBuffSizeRAM; }
+
+bool AudioBuffer::resize(size_t size, bool psram, size_t tail) {
+    // the stored data is moved to the beginning of the new buffer, nobody may hold a pointer into the old one. 'tail'
+    // bytes at the write pointer, read but not yet written (the incomplete TS packet, see processWebStreamTS()),
+    // follow it, they lie within writeSpace()
+    size_t filled = bufferFilled();
+    if(!m_f_init || size <= filled + tail || tail > writeSpace()) return false;
+    size_t   resBuffSize = max(psram ? m_resBuffSizePSRAM : m_resBuffSizeRAM, m_maxBlockSize);
+    uint8_t* buff = NULL;
+    if(psram) buff = (uint8_t*)ps_calloc(size + resBuffSize, sizeof(uint8_t));
+    else buff = (uint8_t*)heap_caps_calloc(size + resBuffSize, sizeof(uint8_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+    if(!buff) return false;
+    size_t n = min(filled, (size_t)(m_endPtr - m_readPtr));
+    memcpy(buff, m_readPtr, n);
+    memcpy(buff + n, m_buffer, filled - n);
+    if(tail) memcpy(buff + filled, m_writePtr, tail);
+    free(m_buffer);
+    m_buffer = buff;
+    m_buffSize = size;
+    m_resBuffSize = resBuffSize;
+    m_f_psram = psram;
+    m_endPtr = m_buffer + m_buffSize;
+    m_readPtr = m_buffer;
+    m_writePtr = m_buffer + filled;
+    if(!filled) m_f_start = true;
+    return true;
+}
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // clang-format off
 Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLOT_MODE_STEREO */, uint8_t i2sPort) {
@@ -192,6 +228,9 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLO
     m_i2s_std_cfg.clk_cfg.clk_src        = I2S_CLK_SRC_DEFAULT;        // Select PLL_F160M as the default source clock
     m_i2s_std_cfg.clk_cfg.mclk_multiple  = I2S_MCLK_MULTIPLE_128;      // mclk = sample_rate * 256
     i2s_channel_init_std_mode(m_i2s_tx_handle, &m_i2s_std_cfg);
+    i2s_event_callbacks_t i2s_cbs = {};
+    i2s_cbs.on_sent = onI2Ssent;                                       // play time of the written frames, audio_output_tap()
+    i2s_channel_register_event_callback(m_i2s_tx_handle, &i2s_cbs, this);
     I2Sstart(0);
     m_sampleRate = 44100;
 #else
@@ -227,13 +266,10 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLO
     i2s_zero_dma_buffer((i2s_port_t) m_i2s_num);
 
 #endif // ESP_IDF_VERSION_MAJOR == 5
-    for(int i = 0; i < 3; i++) {
-        m_filter[i].a0 = 1;
-        m_filter[i].a1 = 0;
-        m_filter[i].a2 = 0;
-        m_filter[i].b1 = 0;
-        m_filter[i].b2 = 0;
-    }
+    m_eq.setSampleRate(m_sampleRate);
+    m_i2sSampleRate = m_sampleRate;
+    m_mixer.setSampleRate(m_sampleRate);
+    m_soundBank.begin(&m_mixer);
     computeLimit();  // first init, vol = 21, vol_steps = 21
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -253,6 +289,7 @@ Audio::~Audio() {
     if(m_chbuf)       {free(m_chbuf);        m_chbuf        = NULL;}
     if(m_lastHost)    {free(m_lastHost);     m_lastHost     = NULL;}
     if(m_outBuff)     {free(m_outBuff);      m_outBuff      = NULL; }
+    if(m_rsBuff)      {free(m_rsBuff);       m_rsBuff       = NULL; }
     if(m_ibuff)       {free(m_ibuff);        m_ibuff        = NULL;}
     if(m_lastM3U8host){free(m_lastM3U8host); m_lastM3U8host = NULL;}
 
@@ -270,7 +307,7 @@ void Audio::setBufsize(int rambuf_sz, int psrambuf_sz) {
 
 void Audio::initInBuff() {
     if(!InBuff.isInitialized()) {
-        size_t size = InBuff.init();
+        size_t size = InBuff.init(m_f_bufAdaptive ? BH_MIN_SIZE : 0); // adaptive: grows with the first data
         if(size > 0) { AUDIO_INFO("PSRAM %sfound, inputBufferSize: %u bytes", InBuff.havePSRAM() ? "" : "not ", size - 1); }
     }
     changeMaxBlockSize(1600); // default size mp3 or aac
@@ -279,7 +316,9 @@ void Audio::initInBuff() {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 esp_err_t Audio::I2Sstart(uint8_t i2s_num) {
 #if ESP_IDF_VERSION_MAJOR == 5
-    return i2s_channel_enable(m_i2s_tx_handle);
+    esp_err_t err = i2s_channel_enable(m_i2s_tx_handle);
+    I2SresetCounters();
+    return err;
 #else
     // It is not necessary to call this function after i2s_driver_install() (it is started automatically),
     // however it is necessary to call it after i2s_stop()
@@ -294,16 +333,89 @@ esp_err_t Audio::I2Sstop(uint8_t i2s_num) {
     return i2s_stop((i2s_port_t)i2s_num);
 #endif
 }
+
+void Audio::I2SsetSampleRate(uint32_t sampRate) {
+    if(m_i2sSampleRate == sampRate) return; // the reconfiguration causes a gap, only if necessary
+    m_i2sSampleRate = sampRate;
+    m_mixer.setSampleRate(sampRate);
+#if ESP_IDF_VERSION_MAJOR == 5
+    m_i2s_std_cfg.clk_cfg.sample_rate_hz = sampRate;
+    I2Sstop(0);
+    i2s_channel_reconfig_std_clock(m_i2s_tx_handle, &m_i2s_std_cfg.clk_cfg);
+    I2Sstart(0);
+#else
+    i2s_set_sample_rates((i2s_port_t)m_i2s_num, sampRate);
+#endif
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#if ESP_IDF_VERSION_MAJOR == 5 // audio_output_tap() needs the on_sent event
+bool IRAM_ATTR Audio::onI2Ssent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    // a DMA buffer is played, the next one starts now
+    Audio* a = (Audio*)user_ctx;
+    a->m_i2sSentUs = esp_timer_get_time();
+    a->m_i2sSent = a->m_i2sSent + a->m_i2s_chan_cfg.dma_frame_num;
+    return false;
+}
+
+void Audio::I2SresetCounters() {
+    // the channel was (re)started, the DMA buffers are empty: what is written now is played from now on
+    m_tapCnt = 0;
+    m_i2sWritten = 0;
+    m_i2sSent = 0;
+    m_i2sSentUs = esp_timer_get_time();
+}
+
+int64_t Audio::I2SplayTime(uint32_t frame) {
+    // esp_timer time at which the frame counted by m_i2sWritten is played
+    int64_t  us;
+    uint32_t sent;
+    do {                                                  // onI2Ssent() may come in between
+        us = m_i2sSentUs;
+        sent = m_i2sSent;
+    } while(us != m_i2sSentUs);
+    int32_t ahead = frame - sent;
+    if(ahead < 0 || !m_i2sSampleRate) return us;
+    return us + (int64_t)ahead * 1000000 / m_i2sSampleRate;
+}
+
+void Audio::I2SrebaseWritten() {
+    // after an underrun the DMA has played silence, the next frame goes into the buffer after the one that is playing
+    uint32_t sent = m_i2sSent;
+    if((int32_t)(m_i2sWritten - sent) >= 0) return;
+    flushTap();
+    m_i2sWritten = sent + m_i2s_chan_cfg.dma_frame_num;
+}
+
+void Audio::tapOutput(const int16_t* frames, uint16_t n) {
+    // frames written as a block (passthroughPCM()), same order as m_tapBuff; frames of outputSample() go first
+    flushTap();
+    I2SrebaseWritten();
+    audio_output_tap(frames, n, m_i2sSampleRate, I2SplayTime(m_i2sWritten));
+    m_i2sWritten += n;
+}
+
+void Audio::flushTap() {
+    if(!m_tapCnt) return;
+    uint16_t n = m_tapCnt;
+    m_tapCnt = 0;
+    audio_output_tap(m_tapBuff, n, m_i2sSampleRate, I2SplayTime(m_tapFirst));
+}
+#endif
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::setDefaults() {
     stopSong();
     initInBuff(); // initialize InputBuffer if not already done
     InBuff.resetBuffer();
+    m_passDone = 0;
+    m_f_passthrough = false;
+    m_bufHealth.begin(BH_HTTP); // connecttoFS() and loop() (m3u8) change it
     MP3Decoder_FreeBuffers();
     FLACDecoder_FreeBuffers();
     AACDecoder_FreeBuffers();
     OPUSDecoder_FreeBuffers();
     VORBISDecoder_FreeBuffers();
+    OGG_indexReset();             // granule index of the previous ogg file
+    clearNextFile();              // setNextFile() belongs to the previous file
     if(m_playlistBuff) {
         free(m_playlistBuff);
         m_playlistBuff = NULL;
@@ -315,7 +427,7 @@ void Audio::setDefaults() {
     client.stop();
     clientsecure.stop();
     _client = static_cast<WiFiClient*>(&client); /* default to *something* so that no NULL deref can happen */
-    ts_parsePacket(0, 0, 0);                     // reset ts routine
+    m_tsDemux.reset();                           // reset ts routine
     if(m_lastM3U8host) {
         free(m_lastM3U8host);
         m_lastM3U8host = NULL;
@@ -339,6 +451,15 @@ void Audio::setDefaults() {
     m_f_m3u8data = false; // set again in processM3U8entries() if necessary
     m_f_continue = false;
     m_f_ts = false;
+    m_f_hlsQueue = false;
+    m_f_hlsNext = false;
+    m_hlsRefresh = 0;
+    m_hlsSeq = 0;
+    m_hls.clear(); // a segment that is loading is dropped by the prefetch task
+    vector_clear_and_shrink(m_speechURL);
+    m_speechSkip = 0;
+    m_speechHeadLen = 0;
+    m_f_speechHead = false;
     m_f_m4aID3dataAreRead = false;
 
     m_streamType = ST_NONE;
@@ -363,6 +484,14 @@ void Audio::setDefaults() {
     m_streamTitleHash = 0;
     m_file_size = 0;
     m_ID3Size = 0;
+    m_f_connectNext = false;
+    m_gaplessSkip = 0;
+    m_gaplessLeft = UINT32_MAX;
+    m_gaplessDelay = 0;
+    m_gaplessTotal = UINT32_MAX;
+    m_seekIndex.reset();
+    m_resumeSkip = -1;
+    m_resumeLeft = UINT32_MAX;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -818,6 +947,7 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t resumeFilePos) {
 
     m_resumeFilePos = resumeFilePos;
     setDefaults(); // free buffers an set defaults
+    m_bufHealth.begin(BH_SD);
 
     { // open audiofile scope
         const char *audioName = nullptr; // pointer for the final file path
@@ -871,6 +1001,7 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t resumeFilePos) {
         vTaskDelay(2);
 
         audiofile = fs.open(audioName);
+        m_seekIndex.open(fs, audioName); // nothing is read before the codec is known
 
         // free audioNameAlternative if used
         if (audioNameAlternative) {
@@ -918,34 +1049,89 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t resumeFilePos) {
     xSemaphoreGiveRecursive(mutex_audio);
     return ret;
 }
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setNextFile(fs::FS& fs, const char* path) {
+    // The file follows the current one. It is opened in the last seconds of the current file, if both are mp3 or both
+    // are m4a files with the same sample rate and channels the decoder continues without a gap, otherwise connecttoFS()
+    // is called at the end of the current file. audio_next_file() reports the change.
+    if(!path) return false;
+    xSemaphoreTakeRecursive(mutex_audio, portMAX_DELAY);
+    clearNextFile();
+    m_preroll.path = strdup(path);
+    if(!m_preroll.path) {
+        log_e("oom");
+        xSemaphoreGiveRecursive(mutex_audio);
+        return false;
+    }
+    m_preroll.fs = &fs;
+    m_preroll.state = PR_QUEUED;
+    xSemaphoreGiveRecursive(mutex_audio);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int8_t Audio::loadSound(fs::FS& fs, const char* path) {
+    // decoded in the task of the caller while the music goes on: a WAV clip without mutex_audio, the bank locks its
+    // table only to insert. The MP3 decoder keeps its state in globals, an MP3 clip is decoded under mutex_audio and
+    // only if the music does not use it; preload such clips before the music starts
+    if(!path) return SB_ERR_FILE;
+    int8_t res = m_soundBank.load(fs, path, true);
+    if(res == SB_ERR_BUSY) {
+        xSemaphoreTakeRecursive(mutex_audio, portMAX_DELAY);
+        bool mp3Busy = (m_codec == CODEC_MP3) || (m_preroll.state != PR_NONE);
+        if(!mp3Busy) res = m_soundBank.load(fs, path, false);
+        xSemaphoreGiveRecursive(mutex_audio);
+    }
+    if(res != SB_OK) AUDIO_INFO("sound %s not loaded: %i", path, res);
+    return res;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int8_t Audio::playSound(const char* path, uint8_t type, float gain) {
+    // a table lookup and a mixer slot, without the mutex and without a decoder; a clip that is not in the bank is not
+    // decoded here (SB_ERR_MISS), loadSound() it beforehand. Returns the mixer stream id
+    if(!path) return SB_ERR_FILE;
+    return m_soundBank.play(path, type, gain);
+}
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::connecttospeech(const char* speech, const char* lang) {
     xSemaphoreTakeRecursive(mutex_audio, portMAX_DELAY);
 
     setDefaults();
     char host[] = "translate.google.com.vn";
-    char path[] = "/translate_tts";
 
-    uint16_t speechLen = strlen(speech);
-    uint16_t speechBuffLen = speechLen + 300;
     memcpy(m_lastHost, speech, 256);
-    char* speechBuff = (char*)malloc(speechBuffLen);
-    if(!speechBuff) {
+    // the first sentence is requested here, the others are loaded by m_hls while it is played and follow it in
+    // InBuff without a new connection or a new decoder, see nextSpeech(). Without PSRAM the text goes in one piece.
+    while(*speech == ' ' || *speech == '\n' || *speech == '\r') speech++;
+    uint16_t firstLen = strlen(speech);
+    if(m_hls.begin()) {
+        firstLen = speechSentence(speech, m_speechMaxLen);
+        const char* p = speech + firstLen;
+        while(*p) {
+            while(*p == ' ' || *p == '\n' || *p == '\r') p++;
+            if(!*p) break;
+            uint16_t len = speechSentence(p, m_speechMaxLen);
+            char*    query = speechQuery(p, len, lang);
+            p += len;
+            if(!query) continue;
+            char* url = (char*)malloc(strlen(host) + strlen(query) + 8);
+            if(url) {
+                sprintf(url, "http://%s%s", host, query);
+                m_speechURL.insert(m_speechURL.begin(), url); // as m_playlistURL, the next one at the end
+            }
+            free(query);
+        }
+        if(m_speechURL.size()) AUDIO_INFO("speech in %u sentences", (unsigned int)m_speechURL.size() + 1);
+    }
+    char* query = speechQuery(speech, firstLen, lang);
+    if(!query) {
         log_e("out of memory");
         xSemaphoreGiveRecursive(mutex_audio);
         return false;
     }
-    memcpy(speechBuff, speech, speechLen);
-    speechBuff[speechLen] = '\0';
-    urlencode(speechBuff, speechBuffLen);
 
-    char resp[strlen(speechBuff) + 200] = "";
+    char resp[strlen(query) + 200] = "";
     strcat(resp, "GET ");
-    strcat(resp, path);
-    strcat(resp, "?ie=UTF-8&tl=");
-    strcat(resp, lang);
-    strcat(resp, "&client=tw-ob&q=");
-    strcat(resp, speechBuff);
+    strcat(resp, query);
     strcat(resp, " HTTP/1.1\r\n");
     strcat(resp, "Host: ");
     strcat(resp, host);
@@ -954,11 +1140,8 @@ bool Audio::connecttospeech(const char* speech, const char* lang) {
     strcat(resp, "Accept-Encoding: identity\r\n");
     strcat(resp, "Accept: text/html\r\n");
     strcat(resp, "Connection: close\r\n\r\n");
+    free(query);
 
-    if(speechBuff) {
-        free(speechBuff);
-        speechBuff = NULL;
-    }
     _client = static_cast<WiFiClient*>(&client);
     if(!_client->connect(host, 80)) {
         log_e("Connection failed");
@@ -966,16 +1149,51 @@ bool Audio::connecttospeech(const char* speech, const char* lang) {
         return false;
     }
     _client->print(resp);
+    speechPrefetch(); // the second sentence is requested now as well
 
     m_streamType = ST_WEBFILE;
     m_f_running = true;
     m_f_ssl = false;
     m_f_tts = true;
+    MP3Decoder_AllocateBuffers(); // warm start, translate_tts answers with mp3, initializeDecoder() finds it ready
     setDatamode(HTTP_RESPONSE_HEADER);
     xSemaphoreGiveRecursive(mutex_audio);
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::speechSentence(const char* text, uint16_t maxLen) {
+    // length of the first sentence of text: up to . ! ? ; : or a line break that is followed by a blank, else up to
+    // the last blank in front of maxLen, a long word is cut in front of an UTF-8 sequence
+    uint16_t len = strlen(text);
+    uint16_t lastBlank = 0;
+    for(uint16_t i = 0; i < len && i < maxLen; i++) {
+        char c = text[i];
+        if(c == '\n') return i + 1;
+        if(c == ' ') lastBlank = i + 1;
+        if(c == '.' || c == '!' || c == '?' || c == ';' || c == ':') {
+            if(text[i + 1] == ' ' || text[i + 1] == '\n' || text[i + 1] == '\r' || text[i + 1] == '\0') return i + 1;
+        }
+    }
+    if(len <= maxLen) return len;
+    if(lastBlank) return lastBlank;
+    while(maxLen > 1 && (text[maxLen] & 0xC0) == 0x80) maxLen--;
+    return maxLen;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+char* Audio::speechQuery(const char* text, uint16_t len, const char* lang) {
+    // path and query of a translate_tts request, free() it
+    uint16_t buffLen = len * 3 + 1; // urlencoded
+    char*    buff = (char*)malloc(buffLen);
+    if(!buff) return NULL;
+    memcpy(buff, text, len);
+    buff[len] = '\0';
+    urlencode(buff, buffLen);
+    char* query = (char*)malloc(strlen(buff) + strlen(lang) + 60);
+    if(query) sprintf(query, "/translate_tts?ie=UTF-8&tl=%s&client=tw-ob&q=%s", lang, buff);
+    free(buff);
+    return query;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::urlencode(char* buff, uint16_t buffLen, bool spacesOnly) {
     uint16_t len = strlen(buff);
     uint8_t* tmpbuff = (uint8_t*)malloc(buffLen);
@@ -1419,7 +1637,7 @@ int Audio::read_WAV_Header(uint8_t* data, size_t len) {
         size_t cs = *(data + 0) + (*(data + 1) << 8) + (*(data + 2) << 16) + (*(data + 3) << 24); // read chunkSize
         headerSize += 4;
         if(getDatamode() == AUDIO_LOCALFILE) m_contentlength = getFileSize();
-        if(cs) { m_audioDataSize = cs - 44; }
+        if(cs) { m_audioDataSize = cs; } // the size of the data chunk, the header is not part of it
         else { // sometimes there is nothing here
             if(getDatamode() == AUDIO_LOCALFILE) m_audioDataSize = getFileSize() - headerSize;
             if(m_streamType == ST_WEBFILE) m_audioDataSize = m_contentlength - headerSize;
@@ -2276,7 +2494,9 @@ uint32_t Audio::stopSong() {
         log_w("Closing audio file"); // for debug
     }
     memset(m_outBuff, 0, m_outbuffSize); // Clear OutputBuffer
-    memset(m_filterBuff, 0, sizeof(m_filterBuff)); // Clear FilterBuffer
+    m_eq.clear(); // Clear FilterBuffer
+    m_resampler.reset();
+    m_f_resampled = false;
     m_validSamples = 0;
     return pos;
 }
@@ -2291,6 +2511,7 @@ bool Audio::pauseResume() {
             memset(m_outBuff, 0, m_outbuffSize); // Clear OutputBuffer
             m_validSamples = 0;
         }
+        else m_bufHealth.resume(millis());
     }
     xSemaphoreGive(mutex_audio);
     return retVal;
@@ -2298,7 +2519,8 @@ bool Audio::pauseResume() {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::playChunk() {
 
-    int16_t sample[2];
+    int16_t  sample[2];
+    int16_t* buff = m_f_resampled ? m_rsBuff : m_outBuff;
 
     auto pc = [&](int16_t* s16) { // lambda, inner function
         if(playSample(s16)) {
@@ -2313,8 +2535,8 @@ void Audio::playChunk() {
     while(m_validSamples) {
         if(getBitsPerSample() == 8) {
             if(getChannels() == 1) {
-                uint8_t x = m_outBuff[m_curSample] & 0x00FF;
-                uint8_t y = (m_outBuff[m_curSample] & 0xFF00) >> 8;
+                uint8_t x = buff[m_curSample] & 0x00FF;
+                uint8_t y = (buff[m_curSample] & 0xFF00) >> 8;
                 sample[RIGHTCHANNEL] = x;
                 sample[LEFTCHANNEL] = x;
                 if(!pc(sample)) { break; } // playSample in lambda
@@ -2323,8 +2545,8 @@ void Audio::playChunk() {
                 if(!pc(sample)) { break; } // playSample in lambda
             }
             if(getChannels() == 2) {
-                uint8_t x = m_outBuff[m_curSample] & 0x00FF;
-                uint8_t y = (m_outBuff[m_curSample] & 0xFF00) >> 8;
+                uint8_t x = buff[m_curSample] & 0x00FF;
+                uint8_t y = (buff[m_curSample] & 0xFF00) >> 8;
                 if(!m_f_forceMono) { // stereo mode
                     sample[RIGHTCHANNEL] = x;
                     sample[LEFTCHANNEL] = y;
@@ -2340,16 +2562,16 @@ void Audio::playChunk() {
 
         if(getBitsPerSample() == 16) {
             if(getChannels() == 1) {
-                sample[RIGHTCHANNEL] = m_outBuff[m_curSample];
-                sample[LEFTCHANNEL] = m_outBuff[m_curSample];
+                sample[RIGHTCHANNEL] = buff[m_curSample];
+                sample[LEFTCHANNEL] = buff[m_curSample];
             }
             if(getChannels() == 2) {
                 if(!m_f_forceMono) { // stereo mode
-                    sample[RIGHTCHANNEL] = m_outBuff[m_curSample * 2];
-                    sample[LEFTCHANNEL] = m_outBuff[m_curSample * 2 + 1];
+                    sample[RIGHTCHANNEL] = buff[m_curSample * 2];
+                    sample[LEFTCHANNEL] = buff[m_curSample * 2 + 1];
                 }
                 else { // mono mode, #100
-                    int16_t xy = (m_outBuff[m_curSample * 2] + m_outBuff[m_curSample * 2 + 1]) / 2;
+                    int16_t xy = (buff[m_curSample * 2] + buff[m_curSample * 2 + 1]) / 2;
                     sample[RIGHTCHANNEL] = xy;
                     sample[LEFTCHANNEL] = xy;
                 }
@@ -2360,7 +2582,10 @@ void Audio::playChunk() {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::loop() {
-    if(!m_f_running) return;
+    if(!m_f_running) {
+        if(m_mixer.isActive()) playMixerOnly(); // prompts and effects without music
+        return;
+    }
 
     xSemaphoreTake(mutex_audio, portMAX_DELAY);
 
@@ -2405,17 +2630,44 @@ void Audio::loop() {
 
                 break;
             case AUDIO_DATA:
+                if(m_f_hlsNext) { // the segment is read, the next one comes from m_hls if it has one
+                    uint8_t res = nextSegmentHLS();
+                    if(res == 0) setDatamode(AUDIO_PLAYLISTDATA); // the old way
+                    if(res == 2) playAudioData();                 // queued, but not yet readable
+                    break;
+                }
                 if(m_f_ts) { processWebStreamTS(); } // aac or aacp with ts packets
                 else { processWebStreamHLS(); }      // aac or aacp normal stream
 
+                if(m_f_hlsQueue && m_hls.headState() == HP_FAILED && !m_hls.available()) m_f_continue = true; // rest is lost
                 if(m_f_continue) { // at this point m_f_continue is true, means processWebStream() needs more data
-                    setDatamode(AUDIO_PLAYLISTDATA);
+                    if(m_f_hlsPrefetch) {
+                        if(m_f_hlsQueue) m_hls.pop();
+                        m_f_hlsQueue = false;
+                        m_f_hlsNext = true;
+                    }
+                    else setDatamode(AUDIO_PLAYLISTDATA);
                     m_f_continue = false;
                 }
+                if(m_f_hlsPrefetch && getDatamode() == AUDIO_DATA) hlsPrefetch();
                 break;
         }
     }
+    if(m_playlistFormat == FORMAT_M3U8 && m_bufHealth.getSource() != BH_HLS) m_bufHealth.begin(BH_HLS);
+    m_bufHealth.update(InBuff.getBytesIn(), InBuff.bufferFilled(), InBuff.getBufsize(), InBuff.getMaxBlockSize(), m_f_playing, millis());
+    if(m_f_bufAdaptive) adaptInBuff();
     xSemaphoreGive(mutex_audio);
+
+    if(m_f_connectNext) { // the file given by setNextFile() could not follow without a gap
+        m_f_connectNext = false;
+        fs::FS* fs = m_preroll.fs;
+        char*   path = m_preroll.path;
+        m_preroll.path = NULL; // is freed here, not in setDefaults()
+        if(connecttoFS(*fs, path)) {
+            if(audio_next_file) audio_next_file(path);
+        }
+        free(path);
+    }
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::readPlayListData() {
@@ -3087,12 +3339,18 @@ void Audio::processLocalFile() {
             f_stream = true;
             AUDIO_INFO("stream ready_1");
             if(m_f_Log) log_i("m_audioDataStart %d", m_audioDataStart);
+            bool f_dataStart = (byteCounter - InBuff.bufferFilled() == m_audioDataStart && m_resumeSkip < 0); // not after a jump
+            if(m_codec == CODEC_MP3 && f_dataStart) InBuff.bytesWasRead(mp3_readGaplessInfo(InBuff.getReadPtr(), InBuff.bufferFilled()));
+            if(m_codec == CODEC_MP3) m_seekIndex.beginMP3(m_audioDataStart);
+            if(m_codec == CODEC_M4A) m_seekIndex.beginM4A(m_audioDataStart, m_stsz_position, m_stsz_numEntries, getSampleRate());
+            m_resumeSkip = -1;
         }
     }
     if(m_resumeFilePos >= 0) {
+        bool f_indexed = (m_resumeSkip >= 0); // m_resumeFilePos is the beginning of a frame (see setAudioPlayPosition)
         if(m_resumeFilePos < m_audioDataStart) m_resumeFilePos = m_audioDataStart;
         if(m_resumeFilePos > m_file_size) m_resumeFilePos = m_file_size;
-        if(m_codec == CODEC_M4A) m_resumeFilePos = m4a_correctResumeFilePos(m_resumeFilePos);
+        if(m_codec == CODEC_M4A && !f_indexed) m_resumeFilePos = m4a_correctResumeFilePos(m_resumeFilePos);
         if(m_codec == CODEC_WAV) {
             while((m_resumeFilePos % 4) != 0) m_resumeFilePos++;
         } // must be divisible by four
@@ -3100,10 +3358,16 @@ void Audio::processLocalFile() {
             m_resumeFilePos = flac_correctResumeFilePos(m_resumeFilePos);
             FLACDecoderReset();
         }
-        if(m_codec == CODEC_MP3) { m_resumeFilePos = mp3_correctResumeFilePos(m_resumeFilePos); }
-        if(m_avr_bitrate) m_audioCurrentTime = ((double)(m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
+        if(m_codec == CODEC_MP3 && !f_indexed) { m_resumeFilePos = mp3_correctResumeFilePos(m_resumeFilePos); }
+        if(m_codec == CODEC_MP3 && f_indexed) MP3Decoder_ClearBuffer(); // the bit reservoir belongs to the old position
+        if(m_codec == CODEC_OPUS) OPUSDecoderSeekReset();     // m_resumeFilePos is the beginning of an ogg page
+        if(m_codec == CODEC_VORBIS) VORBISDecoderSeekReset(); // (see setAudioPlayPosition)
+        bool f_granuleTime = (m_codec == CODEC_OPUS || m_codec == CODEC_VORBIS); // m_audioCurrentTime is already set
+        if(m_avr_bitrate && !f_granuleTime && !f_indexed) m_audioCurrentTime = ((double)(m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
         audiofile.seek(m_resumeFilePos);
         InBuff.resetBuffer();
+        m_passDone = 0;
+        m_bufHealth.begin(BH_SD); // the buffer was emptied, not drained
         byteCounter = m_resumeFilePos;
         f_fileDataComplete = false; // #570
 
@@ -3115,16 +3379,25 @@ void Audio::processLocalFile() {
         }
         m_resumeFilePos = -1;
         f_stream = false;
+        if(f_indexed) {             // the decoder starts some frames earlier, the samples up to the target are dropped
+            m_gaplessSkip = m_resumeSkip;
+            m_gaplessLeft = m_resumeLeft;
+        }
+        else {                      // the position of the samples is not exactly known after a jump
+            m_gaplessSkip = 0;
+            m_gaplessLeft = UINT32_MAX;
+        }
     }
     // end of file reached? - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(f_fileDataComplete && InBuff.bufferFilled() < InBuff.getMaxBlockSize()) {
+        if(m_validSamples) {
+            playChunk();
+            return;
+        } // play samples first, those of the last frame as well
         if(InBuff.bufferFilled()) {
             if(!readID3V1Tag()) {
-                if(m_validSamples) {
-                    playChunk();
-                    return;
-                } // play samples first
                 int bytesDecoded = sendBytes(InBuff.getReadPtr(), InBuff.bufferFilled());
+                if(bytesDecoded == 0 && m_f_passthrough) return; // dma buffer full, try it later
                 if(bytesDecoded <= InBuff.bufferFilled()) { // avoid InBuff overrun (can be if file is corrupt)
                     if(m_f_playing) {
                         if(bytesDecoded > 2) {
@@ -3147,6 +3420,21 @@ void Audio::processLocalFile() {
             return;
         } // loop
 
+        if(m_preroll.state == PR_READY && f_stream) { // gapless, the decoder continues with the next file
+            char* afn = strdup(audiofile.name());
+            if(startNextFile()) {
+                byteCounter = getFilePos();
+                f_fileDataComplete = false;
+                if(afn && audio_eof_mp3) audio_eof_mp3(afn);
+                if(audio_next_file) audio_next_file(m_preroll.path);
+                clearNextFile();
+                if(afn) free(afn);
+                return;
+            }
+            if(afn) free(afn);
+        }
+        if(m_preroll.state != PR_NONE) m_f_connectNext = true; // connecttoFS() in loop()
+
         char* afn = NULL;
         if(audiofile) afn = strdup(audiofile.name()); // store temporary the name
         m_f_running = false;
@@ -3171,40 +3459,215 @@ void Audio::processLocalFile() {
     }
     if(byteCounter == audiofile.size()) { f_fileDataComplete = true; }
     if(byteCounter == m_audioDataSize + m_audioDataStart) { f_fileDataComplete = true; }
+    // open the next file in advance - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    if(f_stream && (m_preroll.state == PR_QUEUED || m_preroll.state == PR_OPEN)) { prerollNextFile(); }
+    // index the frames of the file - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    if(f_stream && m_seekIndex.isBusy()) { m_seekIndex.scanStep(); }
     // play audio data - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(f_stream) { playAudioData(); }
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::prerollNextFile() {
+    // Opening a file on the SD card and reading its first kilobytes takes some ms, in the last seconds of the
+    // current file this is done in two steps, one per loop() call. The first frame is parsed here, it tells whether
+    // the next file fits to the running decoder.
+    if(m_preroll.state == PR_QUEUED) {
+        if(!m_avr_bitrate) return;
+        uint32_t remaining = m_file_size - getFilePos() + InBuff.bufferFilled(); // bytes
+        if((uint64_t)remaining * 8 / m_avr_bitrate > m_prerollSec) return;
+        const char* ext = strrchr(m_preroll.path, '.');
+        bool f_mp3 = ext && strcasecmp(ext, ".mp3") == 0 && m_codec == CODEC_MP3;
+        bool f_m4a = ext && strcasecmp(ext, ".m4a") == 0 && m_codec == CODEC_M4A;
+        if(!f_mp3 && !f_m4a) { // only mp3 after mp3 and m4a after m4a can follow seamlessly
+            m_preroll.state = PR_FAILED;
+            return;
+        }
+        m_preroll.file = m_preroll.fs->open(m_preroll.path);
+        m_preroll.state = m_preroll.file ? PR_OPEN : PR_FAILED;
+        return;
+    }
+    if(m_preroll.state == PR_OPEN && m_codec == CODEC_M4A) {
+        if(!prerollM4A()) {
+            m_preroll.state = PR_FAILED;
+            return;
+        }
+        m_preroll.buff = (uint8_t*)__malloc_heap_psram(m_prerollBytes);
+        if(!m_preroll.buff) {
+            log_e("oom");
+            m_preroll.state = PR_FAILED;
+            return;
+        }
+        m_preroll.file.seek(m_preroll.dataStart);
+        m_preroll.len = m_preroll.file.read(m_preroll.buff, min((uint32_t)m_prerollBytes, m_preroll.dataSize));
+        m_preroll.state = PR_READY;
+        return;
+    }
+    if(m_preroll.state == PR_OPEN) {
+        uint8_t  hdr[10];
+        uint32_t pos = 0;
+        while(m_preroll.file.read(hdr, 10) == 10 && hdr[0] == 'I' && hdr[1] == 'D' && hdr[2] == '3') { // skip ID3v2 tags
+            pos += 10 + bigEndian(hdr + 6, 4, 7);
+            if(hdr[5] & 0x10) pos += 10; // footer
+            m_preroll.file.seek(pos);
+        }
+        m_preroll.file.seek(pos);
+        m_preroll.buff = (uint8_t*)__malloc_heap_psram(m_prerollBytes);
+        if(!m_preroll.buff) {
+            log_e("oom");
+            m_preroll.state = PR_FAILED;
+            return;
+        }
+        m_preroll.len = m_preroll.file.read(m_preroll.buff, m_prerollBytes);
+        m_preroll.dataStart = pos;
+
+        MP3XingInfo_t xi;
+        int syncPos = MP3FindSyncWord(m_preroll.buff, m_preroll.len);
+        if(syncPos < 0 || MP3GetXingInfo(m_preroll.buff + syncPos, m_preroll.len - syncPos, &xi) != ERR_MP3_NONE) {
+            m_preroll.state = PR_FAILED;
+            return;
+        }
+        m_preroll.sampleRate = xi.samprate;
+        m_preroll.channels = xi.nChans;
+        m_preroll.state = PR_READY;
+    }
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::prerollM4A() {
+    // what seek_m4a_stsz() and seek_m4a_ilst() take from audiofile, here from the next file: the content of mdat,
+    // channels and sample rate in stsd, the sample sizes in stsz and the encoder delay in iTunSMPB. moov can be in
+    // front of or behind mdat, only the atoms on the way are read.
+    File&    f = m_preroll.file;
+    uint32_t fileSize = f.size();
+    uint8_t  hdr[64];
+
+    auto findAtom = [&](uint32_t pos, uint32_t end, const char* name, uint32_t* size) -> uint32_t { // 0: not found
+        while(pos + 8 <= end) {
+            f.seek(pos);
+            if(f.read(hdr, 8) != 8) return 0;
+            uint32_t len = bigEndian(hdr, 4);
+            if(len == 0) len = end - pos; // up to the end of the file
+            if(len < 8 || len > end - pos) return 0; // 64 bit size or broken
+            if(!memcmp(hdr + 4, name, 4)) {
+                *size = len;
+                return pos;
+            }
+            pos += len;
+        }
+        return 0;
+    };
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+    uint32_t mdatSize = 0, moovSize = 0, size = 0;
+    uint32_t mdat = findAtom(0, fileSize, "mdat", &mdatSize);
+    uint32_t moov = findAtom(0, fileSize, "moov", &moovSize);
+    if(!mdat || !moov) return false;
+    m_preroll.dataStart = mdat + 8;
+    m_preroll.dataSize = mdatSize - 8;
+
+    const char path[5][5] = {"trak", "mdia", "minf", "stbl", "stsd"};
+    uint32_t   pos = moov, end = moov + moovSize, stbl = 0, stblSize = 0;
+    for(int i = 0; i < 5; i++) {
+        pos = findAtom(pos + 8, end, path[i], &size);
+        if(!pos) return false;
+        end = pos + size;
+        if(i == 3) {stbl = pos; stblSize = size;}
+    }
+    f.seek(pos); // stsd: 8 bytes size + name, 4 bytes version + flags, 4 bytes number of entries, the first one is mp4a
+    if(f.read(hdr, 50) != 50 || memcmp(hdr + 20, "mp4a", 4)) return false;
+    m_preroll.channels = bigEndian(hdr + 40, 2);
+    m_preroll.sampleRate = bigEndian(hdr + 48, 2);
+
+    uint32_t stsz = findAtom(stbl + 8, stbl + stblSize, "stsz", &size);
+    if(!stsz) return false;
+    f.seek(stsz + 16); // 1 byte version + 3 bytes flags + 4 bytes sample size
+    if(f.read(hdr, 4) != 4) return false;
+    m_preroll.stszEntries = bigEndian(hdr, 4);
+    m_preroll.stszPos = stsz + 20;
+
+    m_preroll.gaplessDelay = 0;
+    m_preroll.gaplessTotal = UINT32_MAX;
+    uint32_t udta = findAtom(moov + 8, moov + moovSize, "udta", &size);
+    uint32_t meta = udta ? findAtom(udta + 8, udta + size, "meta", &size) : 0;
+    uint32_t ilst = meta ? findAtom(meta + 12, meta + size, "ilst", &size) : 0; // meta has 4 bytes version + flags
+    if(ilst) {
+        uint32_t ilstEnd = ilst + size;
+        pos = ilst + 8;
+        while((pos = findAtom(pos, ilstEnd, "----", &size)) != 0) { // freeform: mean, name, data
+            uint8_t item[256];
+            uint32_t len = min(size, (uint32_t)sizeof(item));
+            f.seek(pos);
+            if(f.read(item, len) == len && m4a_readSMPB(item, len, &m_preroll.gaplessDelay, &m_preroll.gaplessTotal)) break;
+            pos += size;
+        }
+    }
+    return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::startNextFile() {
+    // The remaining bytes of the current file are discarded (incomplete frame, ID3v1 tag), the first frames of the
+    // next file are already read. The decoder keeps its state, m_outBuff may still hold samples of the current file.
+    if(m_codec != CODEC_MP3 && m_codec != CODEC_M4A) return false;
+    if(m_preroll.sampleRate != getSampleRate() || m_preroll.channels != getChannels()) return false;
+
+    audiofile.close();
+    audiofile = m_preroll.file;
+    m_preroll.file = File(); // audiofile owns it now
+    m_file_size = audiofile.size();
+    m_contentlength = m_file_size;
+    m_audioDataStart = m_preroll.dataStart;
+    m_audioDataSize = (m_codec == CODEC_M4A) ? m_preroll.dataSize : m_file_size - m_audioDataStart;
+
+    InBuff.resetBuffer();
+    m_bufHealth.begin(BH_SD);
+    uint32_t len = min(m_preroll.len, (uint32_t)InBuff.writeSpace());
+    memcpy(InBuff.getWritePtr(), m_preroll.buff, len);
+    InBuff.bytesWritten(len);
+    if(len < m_preroll.len) audiofile.seek(m_audioDataStart + len);
+    if(m_codec == CODEC_MP3) InBuff.bytesWasRead(mp3_readGaplessInfo(InBuff.getReadPtr(), InBuff.bufferFilled()));
+    if(m_codec == CODEC_M4A) { // the AAC decoder continues with raw blocks, the trim of the next file comes from iTunSMPB
+        m_stsz_position = m_preroll.stszPos;
+        m_stsz_numEntries = m_preroll.stszEntries;
+        bool f_smpb = (m_preroll.gaplessTotal != UINT32_MAX);
+        m_gaplessSkip = f_smpb ? m_preroll.gaplessDelay : 0;
+        m_gaplessLeft = m_preroll.gaplessTotal;
+        m_gaplessDelay = m_gaplessSkip;
+        m_gaplessTotal = m_preroll.gaplessTotal;
+    }
+    m_seekIndex.reset();
+    m_seekIndex.open(*m_preroll.fs, m_preroll.path);
+    if(m_codec == CODEC_MP3) m_seekIndex.beginMP3(m_audioDataStart);
+    if(m_codec == CODEC_M4A) m_seekIndex.beginM4A(m_audioDataStart, m_stsz_position, m_stsz_numEntries, getSampleRate());
+
+    m_audioCurrentTime = 0;
+    m_audioFileDuration = 0;
+    m_avr_bitrate = 0; // restarts the bitrate average in compute_audioCurrentTime()
+    AUDIO_INFO("Next file \"%s\", gapless", m_preroll.path);
+    return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::clearNextFile() {
+    if(m_preroll.file) m_preroll.file.close();
+    if(m_preroll.path) {free(m_preroll.path); m_preroll.path = NULL;}
+    if(m_preroll.buff) {free(m_preroll.buff); m_preroll.buff = NULL;}
+    m_preroll.len = 0;
+    m_preroll.state = PR_NONE;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::processWebStream() {
     const uint16_t  maxFrameSize = InBuff.getMaxBlockSize(); // every mp3/aac frame is not bigger
     static bool     f_stream;                                // first audio data received
-    static uint32_t chunkSize;                               // chunkcount read from stream
 
     // first call, set some values to default  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_f_firstCall) { // runs only ont time per connection, prepare for start
         m_f_firstCall = false;
         f_stream = false;
-        chunkSize = 0;
-        m_metacount = m_metaint;
-        readMetadata(0, true); // reset all static vars
+        m_httpBody.begin(m_f_chunked, m_f_metadata ? m_metaint : 0);
+        m_httpBody.setMetadataBuffer(m_chbuf, m_chbufSize);
+        m_httpBody.setMetadataCallback(icyMetadata, this);
     }
 
     if(getDatamode() != AUDIO_DATA) return;         // guard
     uint32_t availableBytes = _client->available(); // available from stream
-    // chunked data tramsfer - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    if(m_f_chunked && availableBytes) {
-        uint8_t readedBytes = 0;
-        if(!chunkSize) chunkSize = chunkedDataTransfer(&readedBytes);
-        availableBytes = min(availableBytes, chunkSize);
-    }
-    // we have metadata  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    if(m_f_metadata && availableBytes) {
-        if(m_metacount == 0) {
-            chunkSize -= readMetadata(availableBytes);
-            return;
-        }
-        availableBytes = min(availableBytes, m_metacount);
-    }
 
     // if the buffer is often almost empty issue a warning - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(f_stream) {
@@ -3212,15 +3675,11 @@ void Audio::processWebStream() {
     }
 
     // buffer fill routine - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    if(availableBytes) {
+    if(availableBytes) { // one read as big as possible, chunk lines and metadata are cut out in place, see http_body.h
         availableBytes = min(availableBytes, (uint32_t)InBuff.writeSpace());
-        int16_t bytesAddedToBuffer = _client->read(InBuff.getWritePtr(), availableBytes);
+        int32_t bytesAddedToBuffer = availableBytes ? _client->read(InBuff.getWritePtr(), availableBytes) : 0;
 
-        if(bytesAddedToBuffer > 0) {
-            if(m_f_metadata) m_metacount -= bytesAddedToBuffer;
-            if(m_f_chunked) chunkSize -= bytesAddedToBuffer;
-            InBuff.bytesWritten(bytesAddedToBuffer);
-        }
+        if(bytesAddedToBuffer > 0) InBuff.bytesWritten(m_httpBody.decode(InBuff.getWritePtr(), bytesAddedToBuffer));
 
         if(InBuff.bufferFilled() > maxFrameSize && !f_stream) { // waiting for buffer filled
             f_stream = true;                                    // ready to play the audio data
@@ -3260,6 +3719,7 @@ void Audio::processWebFile() {
     static uint32_t byteCounter; 
     static uint32_t chunkSize;                               // chunkcount read from stream
     static size_t   audioDataCount;                          // counts the decoded audiodata only
+    static bool     f_speechWait;                            // the next sentence is requested but not yet there
 
     // first call, set some values to default - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_f_firstCall) { // runs only ont time per connection, prepare for start
@@ -3267,6 +3727,7 @@ void Audio::processWebFile() {
         m_t0 = millis();
         f_webFileDataComplete = false;
         f_stream = false;
+        f_speechWait = false;
         byteCounter = 0;
         chunkSize = 0;
         audioDataCount = 0;
@@ -3278,7 +3739,21 @@ void Audio::processWebFile() {
         return;
     } // guard
 
-    uint32_t availableBytes = _client->available(); // available from stream
+    // text to speech, the sentences that follow - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    if(m_f_tts) {
+        if(m_speechURL.size()) speechPrefetch();
+        if(f_speechWait) {
+            uint8_t res = nextSpeech();
+            if(res == 2) { // InBuff plays on
+                if(f_stream) playAudioData();
+                return;
+            }
+            f_speechWait = false;
+            if(res == 0) f_webFileDataComplete = true;
+        }
+    }
+
+    uint32_t availableBytes = hlsAvailable(); // available from stream, or from m_hls (next sentence)
 
     // chunked data tramsfer - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_f_chunked) {
@@ -3297,30 +3772,38 @@ void Audio::processWebFile() {
     availableBytes = min(m_contentlength - byteCounter, availableBytes);
     if(m_audioDataSize) availableBytes = min(m_audioDataSize - (byteCounter - m_audioDataStart), availableBytes);
 
-    int16_t bytesAddedToBuffer = _client->read(InBuff.getWritePtr(), availableBytes);
+    int16_t bytesAddedToBuffer = 0;
+    if(m_f_hlsQueue && m_f_speechHead) byteCounter += readSpeechHead(availableBytes, m_contentlength - byteCounter);
+    else bytesAddedToBuffer = hlsRead(InBuff.getWritePtr(), availableBytes);
 
     if(bytesAddedToBuffer > 0) {
         byteCounter += bytesAddedToBuffer; // Pull request #42
         if(m_f_chunked) m_chunkcount -= bytesAddedToBuffer;
+        if(m_f_hlsQueue) bytesAddedToBuffer = skipSpeechID3(InBuff.getWritePtr(), bytesAddedToBuffer);
         if(m_controlCounter == 100) audioDataCount += bytesAddedToBuffer;
         InBuff.bytesWritten(bytesAddedToBuffer);
     }
 
     if(!f_stream) {
-        if((InBuff.freeSpace() > maxFrameSize) && (byteCounter < m_contentlength)) return;
+        if(m_f_tts) { // speech: time to first audio counts, a few frames are enough, the server sends faster than we play
+            if(InBuff.bufferFilled() < 2 * maxFrameSize && byteCounter < m_contentlength) return;
+        }
+        else if((InBuff.freeSpace() > maxFrameSize) && (byteCounter < m_contentlength)) return;
         f_stream = true; // ready to play the audio data
         uint16_t filltime = millis() - m_t0;
         AUDIO_INFO("stream ready, buffer filled in %d ms", filltime);
-        return;
+        if(!m_f_tts) return;
     }
 
     // we have a webfile, read the file header first - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_controlCounter != 100) {
-        if(InBuff.bufferFilled() > maxFrameSize) { // read the file header first
+        for(int i = 0; i < (m_f_tts ? 8 : 1); i++) { // speech: the header steps in one call, not one per loop()
+            if(InBuff.bufferFilled() <= maxFrameSize) break; // read the file header first
             int32_t bytesRead = readAudioHeader(InBuff.getMaxAvailableBytes());
             if(bytesRead > 0) InBuff.bytesWasRead(bytesRead);
+            if(m_controlCounter == 100) break;
         }
-        return;
+        if(m_controlCounter != 100 || !m_f_tts) return;
     }
 
     if(m_codec == CODEC_OGG) { // log_i("determine correct codec here");
@@ -3346,13 +3829,14 @@ void Audio::processWebFile() {
 
     // end of webfile reached? - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(f_webFileDataComplete && InBuff.bufferFilled() < InBuff.getMaxBlockSize()) {
+        if(m_validSamples) {
+            playChunk();
+            return;
+        } // play samples first, those of the last frame as well
         if(InBuff.bufferFilled()) {
             if(!readID3V1Tag()) {
-                if(m_validSamples) {
-                    playChunk();
-                    return;
-                } // play samples first
                 int bytesDecoded = sendBytes(InBuff.getReadPtr(), InBuff.bufferFilled());
+                if(bytesDecoded == 0 && m_f_passthrough) return; // dma buffer full, try it later
                 if(bytesDecoded > 2) {
                     InBuff.bytesWasRead(bytesDecoded);
                     return;
@@ -3382,6 +3866,14 @@ void Audio::processWebFile() {
 
     if(byteCounter == m_contentlength) { f_webFileDataComplete = true; }
     if(byteCounter - m_audioDataStart == m_audioDataSize) { f_webFileDataComplete = true; }
+    if(f_webFileDataComplete && m_f_tts) { // the next sentence follows in InBuff, the decoder goes on
+        uint8_t res = nextSpeech();
+        if(res) {
+            f_webFileDataComplete = false;
+            f_speechWait = (res == 2);
+            byteCounter = 0;
+        }
+    }
 
     // play audio data - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(f_stream) { playAudioData(); }
@@ -3394,12 +3886,7 @@ void Audio::processWebStreamTS() {
     static bool     f_stream;                                // first audio data received
     static bool     f_firstPacket;
     static bool     f_chunkFinished;
-    static uint32_t byteCounter;    // count received data
-    static uint8_t  ts_packet[188]; // m3u8 transport stream is 188 bytes long
-    uint8_t         ts_packetStart = 0;
-    uint8_t         ts_packetLength = 0;
-    static uint8_t  ts_packetPtr = 0;
-    const uint8_t   ts_packetsize = 188;
+    static uint32_t byteCounter; // count received data
     static size_t   chunkSize = 0;
 
     // first call, set some values to default - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -3410,7 +3897,7 @@ void Audio::processWebStreamTS() {
         byteCounter = 0;
         chunkSize = 0;
         m_t0 = millis();
-        ts_packetPtr = 0;
+        m_tsDemux.dropPending(); // a segment begins with a whole packet
         m_controlCounter = 0;
         m_f_firstCall = false;
     }
@@ -3422,51 +3909,63 @@ void Audio::processWebStreamTS() {
         return;
     }
 
-    availableBytes = _client->available();
+    availableBytes = hlsAvailable();
+    if(availableBytes && f_firstPacket && availableBytes < TS_PACKET_SIZE) availableBytes = 0; // ID3 header is checked
     if(availableBytes) {
         uint8_t readedBytes = 0;
-        if(m_f_chunked) chunkSize = chunkedDataTransfer(&readedBytes);
-        int res = _client->read(ts_packet + ts_packetPtr, ts_packetsize - ts_packetPtr);
-        if(res > 0) {
-            ts_packetPtr += res;
+        if(m_f_chunked && !chunkSize) chunkSize = chunkedDataTransfer(&readedBytes);
+        uint32_t want = availableBytes;
+        if(m_contentlength > byteCounter && want > m_contentlength - byteCounter) want = m_contentlength - byteCounter;
+        if(chunkSize > byteCounter && want > chunkSize - byteCounter) want = chunkSize - byteCounter;
+
+        // the segment is read straight into InBuff and demuxed in place, see ts_demuxer.h
+        uint16_t pending = m_tsDemux.pending(); // behind the write pointer, not yet written
+        uint8_t* wp = InBuff.getWritePtr();
+        uint32_t ws = InBuff.writeSpace();
+        if(ws >= pending + 2 * TS_PACKET_SIZE) {
+            uint32_t res = hlsRead(wp + pending, min(want, ws - pending));
             byteCounter += res;
-            if(ts_packetPtr < ts_packetsize) return;
-            ts_packetPtr = 0;
-            if(f_firstPacket) { // search for ID3 Header in the first packet
+            if(f_firstPacket && res) { // search for ID3 Header in the first packet
                 f_firstPacket = false;
-                uint8_t ID3_HeaderSize = process_m3u8_ID3_Header(ts_packet);
-                if(ID3_HeaderSize > ts_packetsize) {
+                size_t ID3_HeaderSize = process_m3u8_ID3_Header(wp);
+                if(ID3_HeaderSize > res) {
                     log_e("ID3 Header is too big");
                     stopSong();
                     return;
                 }
                 if(ID3_HeaderSize) {
-                    memcpy(ts_packet, &ts_packet[ID3_HeaderSize], ts_packetsize - ID3_HeaderSize);
-                    ts_packetPtr = ts_packetsize - ID3_HeaderSize;
-                    return;
+                    memmove(wp, wp + ID3_HeaderSize, res - ID3_HeaderSize);
+                    res -= ID3_HeaderSize;
                 }
             }
-            ts_parsePacket(&ts_packet[0], &ts_packetStart, &ts_packetLength);
-
-            if(ts_packetLength) {
-                size_t ws = InBuff.writeSpace();
-                if(ws >= ts_packetLength) {
-                    memcpy(InBuff.getWritePtr(), ts_packet + ts_packetStart, ts_packetLength);
-                    InBuff.bytesWritten(ts_packetLength);
-                }
-                else {
-                    memcpy(InBuff.getWritePtr(), ts_packet + ts_packetStart, ws);
-                    InBuff.bytesWritten(ws);
-                    memcpy(InBuff.getWritePtr(), &ts_packet[ws + ts_packetStart], ts_packetLength - ws);
-                    InBuff.bytesWritten(ts_packetLength - ws);
-                }
+            InBuff.bytesWritten(m_tsDemux.demux(wp, pending + res));
+        }
+        else if(InBuff.freeSpace() > pending + TS_PACKET_SIZE && (want >= TS_PACKET_SIZE - pending || want == m_contentlength - byteCounter)) {
+            // end of the ring buffer, this packet goes through ts_packet and is written in two parts
+            uint8_t ts_packet[TS_PACKET_SIZE];
+            memcpy(ts_packet, wp, pending);
+            m_tsDemux.dropPending();
+            uint32_t res = hlsRead(ts_packet + pending, TS_PACKET_SIZE - pending);
+            byteCounter += res;
+            uint32_t ts_packetLength = m_tsDemux.demux(ts_packet, pending + res);
+            m_tsDemux.dropPending(); // only if the read was short, the continuity counter shows the loss
+            size_t ws = InBuff.writeSpace();
+            if(ws >= ts_packetLength) {
+                memcpy(InBuff.getWritePtr(), ts_packet, ts_packetLength);
+                InBuff.bytesWritten(ts_packetLength);
             }
-            if (byteCounter == m_contentlength || byteCounter == chunkSize) {
-                f_chunkFinished = true;
-                byteCounter = 0;
+            else {
+                memcpy(InBuff.getWritePtr(), ts_packet, ws);
+                InBuff.bytesWritten(ws);
+                memcpy(InBuff.getWritePtr(), &ts_packet[ws], ts_packetLength - ws);
+                InBuff.bytesWritten(ts_packetLength - ws);
             }
-            if(byteCounter > m_contentlength) log_e("byteCounter overflow");
         }
+        if(byteCounter == m_contentlength || byteCounter == chunkSize) {
+            f_chunkFinished = true;
+            byteCounter = 0;
+        }
+        if(byteCounter > m_contentlength) log_e("byteCounter overflow");
     }
     if(f_chunkFinished) {
         if(m_f_psramFound) {
@@ -3533,7 +4032,7 @@ void Audio::processWebStreamHLS() {
 
     if(getDatamode() != AUDIO_DATA) return; // guard
 
-    availableBytes = _client->available();
+    availableBytes = hlsAvailable();
     if(availableBytes) { // an ID3 header could come here
         uint8_t readedBytes = 0;
 
@@ -3544,7 +4043,7 @@ void Audio::processWebStreamHLS() {
 
         if(firstBytes) {
             if(ID3WritePtr < ID3BuffSize) {
-                ID3WritePtr += _client->readBytes(&ID3Buff[ID3WritePtr], ID3BuffSize - ID3WritePtr);
+                ID3WritePtr += hlsRead(&ID3Buff[ID3WritePtr], ID3BuffSize - ID3WritePtr);
                 return;
             }
             if(m_controlCounter < 100) {
@@ -3579,9 +4078,9 @@ void Audio::processWebStreamHLS() {
         size_t bytesWasWritten = 0;
         if(InBuff.writeSpace() >= availableBytes) {
             if(availableBytes > 1024) availableBytes = 1024; // 1K throttle
-            bytesWasWritten = _client->read(InBuff.getWritePtr(), availableBytes);
+            bytesWasWritten = hlsRead(InBuff.getWritePtr(), availableBytes);
         }
-        else { bytesWasWritten = _client->read(InBuff.getWritePtr(), InBuff.writeSpace()); }
+        else { bytesWasWritten = hlsRead(InBuff.getWritePtr(), InBuff.writeSpace()); }
         InBuff.bytesWritten(bytesWasWritten);
 
         byteCounter += bytesWasWritten;
@@ -3622,12 +4121,170 @@ void Audio::processWebStreamHLS() {
     return;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::hlsAvailable() {
+    if(m_f_hlsQueue) return m_hls.available();
+    return _client->available();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::hlsRead(uint8_t* buff, uint32_t len) {
+    if(m_f_hlsQueue) return m_hls.read(buff, len);
+    int res = _client->read(buff, len);
+    return res > 0 ? res : 0;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::hlsPrefetch() {
+    // m3u8 only, while a segment is played: the playlist is refreshed and the next segments are loaded by m_hls,
+    // parsePlaylist_M3U8() still sorts out the new URLs by media sequence number (or hash)
+    if(!m_hls.begin()) { // no PSRAM, or no task
+        m_f_hlsPrefetch = false;
+        return;
+    }
+    uint8_t plState = m_hls.playlistState();
+    if(plState == HP_DONE) {
+        uint32_t len = 0;
+        char*    pl = m_hls.takePlaylist(&len);
+        if(pl && !strstr(pl, "#EXT-X-STREAM-INF:")) { // a master playlist would redirect _client
+            vector_clear_and_shrink(m_playlistContent);
+            char* p = pl;
+            while(*p) { // lines as readPlayListData() stores them
+                char* e = p + strcspn(p, "\r\n");
+                char  c = *e;
+                *e = '\0';
+                if(*p) m_playlistContent.push_back(x_strdup(p));
+                p = c ? e + 1 : e;
+            }
+            const char* host = parsePlaylist_M3U8();
+            if(host && host == m_playlistBuff) m_playlistURL.push_back(x_strdup(host)); // it took the oldest one, back
+            vector_clear_and_shrink(m_playlistContent);
+        }
+        if(pl) free(pl);
+    }
+    if(plState == HP_FAILED) m_hls.dropPlaylist(); // once more after HP_REFRESH_MS
+
+    while(m_playlistURL.size() && m_hls.queued() < HP_SLOTS) { // the oldest URL is at the end
+        if(!m_hls.push(m_playlistURL.back(), m_hlsSeq)) break;
+        m_hlsSeq++;
+        free(m_playlistURL.back());
+        m_playlistURL.pop_back();
+    }
+    if(m_playlistURL.size() == 0 && m_hls.queued() < HP_SLOTS && m_hls.playlistState() == HP_FREE) {
+        if(millis() - m_hlsRefresh > HP_REFRESH_MS) {
+            m_hlsRefresh = millis();
+            m_hls.requestPlaylist(m_lastM3U8host ? m_lastM3U8host : m_lastHost);
+        }
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t Audio::nextSegmentHLS() {
+    // 0: m_hls has no segment, 1: the next one is read from m_hls now, 2: it is queued but its length is not yet known
+    uint32_t len = 0;
+    while(true) {
+        uint8_t state = m_hls.headState();
+        if(state == HP_FAILED) log_w("segment %llu lost", (long long unsigned)m_hls.headSeq());
+        else if(state == HP_FREE) {
+            m_f_hlsNext = false;
+            return 0;
+        }
+        else if(!m_hls.headLength(&len)) return 2;
+        else if(len) break;
+        m_hls.pop(); // failed or empty (Content-Length: 0), nothing to play
+    }
+    m_f_hlsNext = false;
+    m_f_hlsQueue = true;
+    m_contentlength = len;
+    m_f_chunked = false;
+    if(m_f_Log) log_i("segment %llu from the queue, %lu bytes", (long long unsigned)m_hls.headSeq(), (long unsigned)len);
+    // as parseHttpResponseHeader() does at the end of a segment header
+    setDatamode(AUDIO_DATA);
+    if(!initializeDecoder()) {
+        stopSong();
+        return 1;
+    }
+    m_controlCounter = 0;
+    m_f_firstCall = true;
+    return 1;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::speechPrefetch() {
+    // connecttospeech(): the sentences behind the one that is played are requested by m_hls in advance
+    while(m_speechURL.size() && m_hls.queued() < HP_SLOTS) { // the next one is at the end
+        if(!m_hls.push(m_speechURL.back(), m_hlsSeq)) break;
+        m_hlsSeq++;
+        free(m_speechURL.back());
+        m_speechURL.pop_back();
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t Audio::nextSpeech() {
+    // the body of a sentence is read, 0: no more sentences, 1: the next one is read from m_hls now, 2: it is
+    // requested but its length is not yet known
+    if(m_f_hlsQueue) { // it came from m_hls
+        m_hls.pop();
+        m_f_hlsQueue = false;
+    }
+    uint32_t len = 0;
+    while(true) {
+        speechPrefetch();
+        uint8_t state = m_hls.headState();
+        if(state == HP_FAILED) log_w("sentence %llu of the speech lost", (long long unsigned)m_hls.headSeq());
+        else if(state == HP_FREE) return 0;
+        else if(!m_hls.headLength(&len)) return 2;
+        else if(len) break;
+        m_hls.pop(); // failed or empty, nothing to play
+    }
+    m_f_hlsQueue = true;
+    m_f_speechHead = true;
+    m_speechHeadLen = 0;
+    m_f_chunked = false;
+    m_contentlength = len;
+    m_audioDataStart = 0;
+    m_audioDataSize = len;
+    if(m_f_Log) log_i("sentence %llu of the speech, %lu bytes", (long long unsigned)m_hls.headSeq(), (long unsigned)len);
+    return 1;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::readSpeechHead(uint32_t len, uint32_t remaining) {
+    // a sentence that follows may begin with an ID3v2 tag: its 10 byte header is collected from m_hls, the reads can
+    // be shorter than that. Returns the bytes taken from m_hls
+    uint32_t n = hlsRead(m_speechHead + m_speechHeadLen, min(len, (uint32_t)(10 - m_speechHeadLen)));
+    m_speechHeadLen += n;
+    if(m_speechHeadLen < 10 && n < remaining) return n; // wait for more, or the end of the sentence
+    uint8_t* h = m_speechHead;
+    if(m_speechHeadLen == 10 && h[0] == 'I' && h[1] == 'D' && h[2] == '3') {
+        m_speechSkip = (h[6] & 0x7F) << 21 | (h[7] & 0x7F) << 14 | (h[8] & 0x7F) << 7 | (h[9] & 0x7F); // behind the header
+        if(h[5] & 0x10) m_speechSkip += 10; // footer
+    }
+    else { // no tag, the bytes go to InBuff, at the end of the ring in two parts
+        if(InBuff.freeSpace() < m_speechHeadLen) return n; // next time
+        size_t part = min(InBuff.writeSpace(), (size_t)m_speechHeadLen);
+        memcpy(InBuff.getWritePtr(), h, part);
+        InBuff.bytesWritten(part);
+        memcpy(InBuff.getWritePtr(), h + part, m_speechHeadLen - part);
+        InBuff.bytesWritten(m_speechHeadLen - part);
+    }
+    m_speechHeadLen = 0;
+    m_f_speechHead = false;
+    return n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::skipSpeechID3(uint8_t* buff, uint32_t len) {
+    // the rest of the ID3 tag of a sentence is cut out of the bytes just read (buff, len)
+    if(!m_speechSkip) return len;
+    uint32_t n = min(m_speechSkip, len);
+    m_speechSkip -= n;
+    if(len > n) memmove(buff, buff + n, len - n);
+    return len - n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::playAudioData() {
     if(m_validSamples) {
         playChunk();
         return;
     } // play samples first
-    if(InBuff.bufferFilled() < InBuff.getMaxBlockSize()) return; // guard
+    if(InBuff.bufferFilled() < InBuff.getMaxBlockSize()) { // guard
+        m_bufHealth.starved();                               // an underrun if more data comes
+        return;
+    }
 
     int bytesDecoded = sendBytes(InBuff.getReadPtr(), InBuff.getMaxBlockSize());
 
@@ -3649,6 +4306,18 @@ void Audio::playAudioData() {
     return;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::adaptInBuff() {
+    // loop() with the mutex taken, nobody holds a pointer into InBuff. Small buffers go to internal RAM if it is not
+    // needed elsewhere.
+    if(!m_bufHealth.adaptDue(millis())) return;
+    uint32_t target = m_bufHealth.adaptSize(InBuff.getBufsize(), InBuff.bufferFilled(), InBuff.getMaxBlockSize(), getBitRate() / 8, m_bufAdaptMax);
+    if(!target) return;
+    bool f_psram = psramFound() && (target > BH_INTERNAL_MAX || heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < target + BH_INTERNAL_KEEP);
+    if(InBuff.resize(target, f_psram, m_tsDemux.pending())) { // the pending TS bytes move along
+        AUDIO_INFO("inputBufferSize: %lu bytes in %s", (long unsigned int)target, f_psram ? "PSRAM" : "RAM");
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::parseHttpResponseHeader() { // this is the response to a GET / request
 
     if(getDatamode() != HTTP_RESPONSE_HEADER) return false;
@@ -4376,6 +5045,7 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     int         bytesLeft;
     static bool f_setDecodeParamsOnce = true;
     int         nextSync = 0;
+    int         bytesDecoded = 0;
     if(!m_f_playing) {
         f_setDecodeParamsOnce = true;
         nextSync = findNextSync(data, len);
@@ -4383,9 +5053,19 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
         return nextSync;
     }
     // m_f_playing is true at this pos
+    if(m_codec == CODEC_WAV && (m_passDone || canPassthrough())) { // nothing to do for the PCM, no copy to m_outBuff
+        if(f_setDecodeParamsOnce) {
+            f_setDecodeParamsOnce = false;
+            setDecoderItems();
+            m_PlayingStartTime = millis();
+        }
+        bytesDecoded = passthroughPCM(data, len);
+        if(bytesDecoded > 0) compute_audioCurrentTime(bytesDecoded);
+        return bytesDecoded;
+    }
+    m_f_passthrough = false;
     bytesLeft = len;
     m_decodeError = 0;
-    int bytesDecoded = 0;
 
     switch(m_codec) {
         case CODEC_WAV:  m_decodeError = 0; bytesLeft = 0; break;
@@ -4408,8 +5088,12 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
 
     if(m_decodeError < 0) { // Error, skip the frame...
                             //        i2s_zero_dma_buffer((i2s_port_t)m_i2s_num);
-        if(!getChannels() && m_codec == CODEC_MP3 && (m_decodeError == -2)) {
-            ; // at the beginning this doesn't have to be a mistake, suppress errorcode MAINDATA_UNDERFLOW
+        if(m_codec == CODEC_MP3 && m_decodeError == ERR_MP3_MAINDATA_UNDERFLOW) {
+            // not a mistake at the beginning or after a jump: the frame is consumed by the bit reservoir, but gives
+            // no samples, they are missing in the count of samples to drop
+            uint32_t spf = indexSamplesPerFrame();
+            if(m_gaplessSkip) m_gaplessSkip -= min(m_gaplessSkip, spf);
+            return len - bytesLeft;
         }
         else {
             printDecodeError(m_decodeError);
@@ -4430,6 +5114,19 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     }
     bytesDecoded = len - bytesLeft;
 
+    if(audiofile && (m_codec == CODEC_OPUS || m_codec == CODEC_VORBIS)) { // remember where the ogg pages are, for seeking
+        static uint32_t oggPageCount = 0;
+        if(oggPageCount != OGG_getPageCount()) {
+            oggPageCount = OGG_getPageCount();
+            const uint8_t* page = OGG_getLastPageHeader();
+            // only pages that begin with a new packet can be used as a starting point
+            if(page >= data && page < data + len && !(page[5] & 0x01)) {
+                uint32_t pagePos = getFilePos() - inBufferFilled() + (page - data);
+                OGG_indexAdd(pagePos, OGG_getLastPageStartGranule(), OGG_getLastGranule());
+            }
+        }
+    }
+
     if(bytesDecoded == 0 && m_decodeError == 0) { // unlikely framesize
         if(audio_info) audio_info("framesize is 0, start decoding again");
         m_f_playing = false; // seek for new syncword
@@ -4506,12 +5203,36 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     }
 
     compute_audioCurrentTime(bytesDecoded);
+    if(m_gaplessSkip || m_gaplessLeft != UINT32_MAX) gaplessTrim();
 
     if(audio_process_extern) {
         bool continueI2S = false;
         audio_process_extern(m_outBuff, m_validSamples, &continueI2S);
         if(!continueI2S) { return bytesDecoded; }
     }
+    if(getBitsPerSample() == 16) m_eq.process(m_outBuff, m_validSamples, getChannels()); // equaliser, whole block in place
+
+    m_f_resampled = false;
+    if(m_fixedOutRate) { // convert to the fixed I2S rate
+        if(getBitsPerSample() == 16) {
+            I2SsetSampleRate(m_fixedOutRate);
+            m_resampler.setRates(getSampleRate() * m_playSpeed, m_fixedOutRate, getChannels());
+            if(!m_resampler.isBypass()) {
+                uint32_t len = m_resampler.maxOutputFrames(m_validSamples) * getChannels();
+                if(len > m_rsBuffLen) {
+                    if(m_rsBuff) free(m_rsBuff);
+                    m_rsBuff = (int16_t*)__malloc_heap_psram(len * sizeof(int16_t));
+                    m_rsBuffLen = m_rsBuff ? len : 0;
+                }
+                if(m_rsBuff) {
+                    m_validSamples = m_resampler.process(m_outBuff, m_validSamples, m_rsBuff);
+                    m_f_resampled = true;
+                }
+            }
+        }
+        else I2SsetSampleRate(getSampleRate()); // 8 bit PCM
+    }
+    if(getBitsPerSample() == 16) m_mixer.mix(m_f_resampled ? m_rsBuff : m_outBuff, m_validSamples, getChannels()); // prompts, effects, ducking
     m_curSample = 0;
     playChunk();
     return bytesDecoded;
@@ -4557,7 +5278,14 @@ void Audio::compute_audioCurrentTime(int bd) {
     m_audioCurrentTime += ((float)bd / m_avr_bitrate) * 8;
 
     if(cnt == 1) {
-        m_audioCurrentTime = ((float)(getFilePos() - m_audioDataStart - inBufferFilled()) / m_avr_bitrate) * 8; // #293
+        int32_t  frame = -1;
+        uint16_t spf = indexSamplesPerFrame();
+        if(spf) frame = m_seekIndex.frameAt(getFilePos() - inBufferFilled());
+        if(frame >= 0) { // exact, also with VBR
+            int64_t t = (int64_t)frame * spf - m_gaplessDelay;
+            m_audioCurrentTime = (t > 0) ? (double)t / getSampleRate() : 0;
+        }
+        else m_audioCurrentTime = ((float)(getFilePos() - m_audioDataStart - inBufferFilled()) / m_avr_bitrate) * 8; // #293
     }
     cnt++;
     if(cnt == 100) cnt = 0;
@@ -4734,7 +5462,13 @@ uint32_t Audio::getAudioFileDuration() {
         if(!m_contentlength) return 0;
     }
 
-    if(m_avr_bitrate && m_codec == CODEC_MP3) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate); // #289
+    uint16_t spf = indexSamplesPerFrame();
+    if(m_seekIndex.isReady() && spf && getSampleRate()) { // all frames are counted
+        uint64_t samples = (uint64_t)m_seekIndex.getFrames() * spf;
+        if(m_gaplessTotal != UINT32_MAX) samples = m_gaplessTotal;
+        m_audioFileDuration = samples / getSampleRate();
+    }
+    else if(m_avr_bitrate && m_codec == CODEC_MP3) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate); // #289
     else if(m_avr_bitrate && m_codec == CODEC_WAV) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate);
     else if(m_avr_bitrate && m_codec == CODEC_M4A) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate);
     else if(m_avr_bitrate && m_codec == CODEC_AAC) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate);
@@ -4748,15 +5482,65 @@ uint32_t Audio::getAudioCurrentTime() { // return current time in seconds
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::setAudioPlayPosition(uint16_t sec) {
-    if(m_codec == CODEC_OPUS) return false;   // not impl. yet
-    if(m_codec == CODEC_VORBIS) return false; // not impl. yet
     // Jump to an absolute position in time within an audio file
     // e.g. setAudioPlayPosition(300) sets the pointer at pos 5 min
+    if(m_codec == CODEC_OPUS || m_codec == CODEC_VORBIS) {
+        // the ogg granule index knows the pages that have already been played, positions beyond are found by a
+        // bisection over the file from the furthest indexed page on
+        if(!audiofile) return false;
+        uint32_t rate = (m_codec == CODEC_OPUS) ? 48000 : getSampleRate(); // opus granule is always 48kHz
+        uint64_t preSkip = (m_codec == CODEC_OPUS) ? OPUSGetPreSkip() : 0; // opus granules count the pre-skip samples
+        uint64_t granule = (uint64_t)sec * rate + preSkip;
+        uint64_t pageGranule = 0;
+        int32_t  pagePos = OGG_indexFind(granule, &pageGranule);
+        if(pagePos < 0) {
+            uint32_t startPos = 0;
+            uint64_t startGranule = 0;
+            OGG_indexLast(&startPos, &startGranule);
+            xSemaphoreTakeRecursive(mutex_audio, portMAX_DELAY); // the audio task reads the same file
+            uint32_t filePos = audiofile.position();
+            pagePos = OGG_bisect(audiofile, startPos, startGranule, granule, &pageGranule);
+            audiofile.seek(filePos);
+            xSemaphoreGiveRecursive(mutex_audio);
+        }
+        if(pagePos < 0) return false;
+        m_resumeFilePos = pagePos;
+        m_audioCurrentTime = (double)(pageGranule - min(pageGranule, preSkip)) / rate;
+        memset(m_outBuff, 0, m_outbuffSize);
+        m_validSamples = 0;
+        return true;
+    }
     if(sec > getAudioFileDuration()) sec = getAudioFileDuration();
+    uint16_t spf = indexSamplesPerFrame();
+    if(spf) {
+        // exact jump with the seek index. The decoder starts some frames before the target (mp3: bit reservoir,
+        // aac: overlap of the transform), the samples up to the target are dropped in gaplessTrim()
+        uint32_t sampleRate = getSampleRate();
+        uint32_t target = sec * sampleRate + m_gaplessDelay;
+        uint32_t frame = target / spf;
+        uint8_t  pre = (m_codec == CODEC_MP3) ? 6 : 2;
+        uint32_t entryFrame = 0;
+        int32_t  pos = m_seekIndex.find(frame > pre ? frame - pre : 0, &entryFrame);
+        if(pos >= 0) {
+            m_resumeSkip = target - entryFrame * spf;
+            m_resumeLeft = UINT32_MAX;
+            if(m_gaplessTotal != UINT32_MAX) m_resumeLeft = m_gaplessTotal - min(m_gaplessTotal, sec * sampleRate);
+            m_audioCurrentTime = sec;
+            m_resumeFilePos = pos;
+            memset(m_outBuff, 0, m_outbuffSize);
+            m_validSamples = 0;
+            return true;
+        }
+    }
     uint32_t filepos = m_audioDataStart + (m_avr_bitrate * sec / 8);
     return setFilePos(filepos);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setOggCRCcheck(bool enable) {
+    // off by default, the CRC costs a pass over every page and the table takes 1 KB
+    OGG_setCRCcheck(enable);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::setVolumeSteps(uint8_t steps) {
     m_vol_steps = steps;
     if(steps < 1) m_vol_steps = 64; /* avoid div-by-zero :-) */
@@ -4771,8 +5555,16 @@ uint32_t Audio::getTotalPlayingTime() {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::setTimeOffset(int sec) {
-    if(m_codec == CODEC_OPUS) return false;   // not impl. yet
-    if(m_codec == CODEC_VORBIS) return false; // not impl. yet
+    if(m_codec == CODEC_OPUS || m_codec == CODEC_VORBIS) { // granule index or bisection
+        int32_t t = (int32_t)getAudioCurrentTime() + sec;
+        if(t < 0) t = 0;
+        return setAudioPlayPosition(t);
+    }
+    if(m_seekIndex.isReady() && indexSamplesPerFrame()) { // mp3, m4a
+        int32_t t = (int32_t)getAudioCurrentTime() + sec;
+        if(t < 0) t = 0;
+        return setAudioPlayPosition(t);
+    }
     // fast forward or rewind the current position in seconds
     // audiosource must be a mp3, aac or wav file
 
@@ -4812,15 +5604,9 @@ bool Audio::audioFileSeek(const float speed) {
     // 1.5 is one and half speed
     if((speed > 1.5f) || (speed < 0.25f)) return false;
 
-    uint32_t srate = getSampleRate() * speed;
-#if ESP_IDF_VERSION_MAJOR == 5
-    I2Sstop(0);
-    m_i2s_std_cfg.clk_cfg.sample_rate_hz = srate;
-    i2s_channel_reconfig_std_clock(m_i2s_tx_handle, &m_i2s_std_cfg.clk_cfg);
-    I2Sstart(0);
-#else
-    i2s_set_sample_rates((i2s_port_t)m_i2s_num, srate);
-#endif
+    m_playSpeed = speed;
+    if(m_fixedOutRate) return true; // the resampler takes getSampleRate() * m_playSpeed, see sendBytes()
+    I2SsetSampleRate(getSampleRate() * speed);
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4828,21 +5614,26 @@ bool Audio::setSampleRate(uint32_t sampRate) {
     if(!sampRate) sampRate = 44100; // fuse, if there is no value -> set default #209
     if(m_sampleRate == sampRate) return true;
     m_sampleRate = sampRate;
-#if ESP_IDF_VERSION_MAJOR == 5
-    m_i2s_std_cfg.clk_cfg.sample_rate_hz = sampRate;
-    I2Sstop(0);
-    i2s_channel_reconfig_std_clock(m_i2s_tx_handle, &m_i2s_std_cfg.clk_cfg);
-    I2Sstart(0);
-#else
-    i2s_set_sample_rates((i2s_port_t)m_i2s_num, sampRate);
-#endif
-    memset(m_filterBuff, 0, sizeof(m_filterBuff)); // Clear FilterBuffer
-    IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2); // must be recalculated after each samplerate change
+    m_playSpeed = 1.0;
+    if(!m_fixedOutRate) I2SsetSampleRate(sampRate); // otherwise the I2S clock stays and the resampler follows
+    m_eq.clear(); // Clear FilterBuffer
+    m_eq.setSampleRate(sampRate); // coefficients must be recalculated after each samplerate change
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::getSampleRate() { return m_sampleRate; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setOutputSampleRate(uint32_t sampRate) {
+    // 0: the I2S clock follows the decoder (default)
+    // otherwise the I2S runs at this rate all the time and the decoded PCM is converted, there are no gaps between
+    // tracks with different rates and sounds with different rates can be mixed (8 bit PCM still switches the clock)
+    if(sampRate && (sampRate < 8000 || sampRate > 48000)) return false; // m_validSamples is int16, max ratio 6
+    m_fixedOutRate = sampRate;
+    I2SsetSampleRate(sampRate ? sampRate : getSampleRate());
+    m_resampler.reset();
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::setBitsPerSample(int bits) {
     if((bits != 16) && (bits != 8)) return false;
     m_bitsPerSample = bits;
@@ -4964,21 +5755,15 @@ bool Audio::playSample(int16_t sample[2]) {
     if(getBitsPerSample() == 8) { // Upsample from unsigned 8 bits to signed 16 bits
         sample[LEFTCHANNEL] = ((sample[LEFTCHANNEL] & 0xff) - 128) << 8;
         sample[RIGHTCHANNEL] = ((sample[RIGHTCHANNEL] & 0xff) - 128) << 8;
-    }
-
-    // set a correction factor if filter have positive amplification
-    if(m_corr > 1) {
-        sample[LEFTCHANNEL] = sample[LEFTCHANNEL] / m_corr;
-        sample[RIGHTCHANNEL] = sample[RIGHTCHANNEL] / m_corr;
+        m_eq.process(sample, 1, 2); // 16 bit samples have already passed the equaliser and the mixer in sendBytes()
+        m_mixer.mix(sample, 1, 2);
     }
 
     computeVUlevel(sample);
-
-    // Filterchain, can commented out if not used
-    sample = IIR_filterChain0(sample);
-    sample = IIR_filterChain1(sample);
-    sample = IIR_filterChain2(sample);
-    //-------------------------------------------
+    return outputSample(sample);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::outputSample(int16_t sample[2]) {
 
     uint32_t s32 = Gain(sample); // sample2volume;
 
@@ -4989,49 +5774,130 @@ bool Audio::playSample(int16_t sample[2]) {
         if(!continueI2S) { return true; }
     }
 
-    if(m_f_internalDAC) { s32 += 0x80008000; }
+    uint32_t dac = s32;
+    if(m_f_internalDAC) { dac += 0x80008000; }
     m_i2s_bytesWritten = 0;
 #if(ESP_IDF_VERSION_MAJOR == 5)
-    esp_err_t err = i2s_channel_write(m_i2s_tx_handle, (const char*)&s32, sizeof(uint32_t), &m_i2s_bytesWritten, 0);
+    esp_err_t err = i2s_channel_write(m_i2s_tx_handle, (const char*)&dac, sizeof(uint32_t), &m_i2s_bytesWritten, 0);
 #else
-    esp_err_t err = i2s_write((i2s_port_t)m_i2s_num, (const char*)&s32, sizeof(uint32_t), &m_i2s_bytesWritten, 0); // no wait
+    esp_err_t err = i2s_write((i2s_port_t)m_i2s_num, (const char*)&dac, sizeof(uint32_t), &m_i2s_bytesWritten, 0); // no wait
 #endif
     if(err != ESP_OK) {
         if(err != 263) { log_e("ESP32 Errorcode: %i", err); }
         return false;
     }
     if(m_i2s_bytesWritten < 4) { // no more space in dma buffer  --> break and try it later
+#if(ESP_IDF_VERSION_MAJOR == 5)
+        if(audio_output_tap) flushTap();
+#endif
         return false;
     }
+#if(ESP_IDF_VERSION_MAJOR == 5)
+    if(audio_output_tap) {
+        I2SrebaseWritten();
+        if(!m_tapCnt) m_tapFirst = m_i2sWritten;
+        m_tapBuff[m_tapCnt * 2] = (int16_t)(s32 & 0xffff);   // the order of the I2S word, see Gain()
+        m_tapBuff[m_tapCnt * 2 + 1] = (int16_t)(s32 >> 16);
+        m_i2sWritten++;
+        if(++m_tapCnt == AUDIO_TAP_FRAMES) flushTap();
+    }
+#endif
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::playMixerOnly() {
+    // no track is running, the mixer streams are played on silence with the current I2S rate
+    int16_t sample[2];
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    while(true) {
+        if(m_mixCur == m_mixValid) {
+            if(!m_mixer.isActive()) break;
+            memset(m_mixBuff, 0, sizeof(m_mixBuff));
+            m_mixer.mix(m_mixBuff, MIX_CHUNK_FRAMES, 2);
+            m_mixValid = MIX_CHUNK_FRAMES;
+            m_mixCur = 0;
+        }
+        sample[RIGHTCHANNEL] = m_mixBuff[m_mixCur * 2];
+        sample[LEFTCHANNEL] = m_mixBuff[m_mixCur * 2 + 1];
+        if(!outputSample(sample)) break; // dma buffer full, try it later
+        m_mixCur++;
+    }
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::canPassthrough() {
+    // 16 bit stereo PCM that needs nothing but the volume can go from InBuff to the DMA buffers
+    if(getBitsPerSample() != 16 || getChannels() != 2) return false;
+    if(m_f_forceMono || m_f_internalDAC || audio_process_extern || audio_process_i2s) return false;
+    if(m_validSamples || !m_eq.isFlat() || m_mixer.isActive()) return false;
+    if(m_gaplessSkip || m_gaplessLeft != UINT32_MAX) return false;
+    if(m_fixedOutRate && (m_fixedOutRate != getSampleRate() || m_playSpeed != 1.0)) return false;
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int Audio::passthroughPCM(uint8_t* data, size_t len) {
+    // data is the InBuff readpointer. The frame order in the file is the order in the 32 bit I2S word (see playChunk()
+    // and Gain()), whole frames are written without a copy. Below full volume the gain is applied in place; bytes the
+    // dma buffers do not take keep it, m_passDone counts them. When passthrough is no longer possible (eq, mixer ...)
+    // only these bytes are written here, the rest goes the normal way.
+    m_f_passthrough = true;
+    size_t n = min(len, InBuff.getBytesToEnd()) & ~3;     // behind the end is a copy of the beginning, it is not kept
+    if(m_passDone && !canPassthrough()) n = min(n, (size_t)m_passDone);
+    if(n == 0) {
+        if(len < 4) return len;                          // incomplete frame at the end of the file
+        int16_t sample[2];                               // one frame across the end of the ring
+        sample[RIGHTCHANNEL] = data[0] | (data[1] << 8);
+        sample[LEFTCHANNEL] = data[2] | (data[3] << 8);
+        return playSample(sample) ? 4 : 0;
+    }
+    int16_t* pcm = (int16_t*)data;                        // the WAV header and all blocks have even length
+    bool     unity = (m_limit_left == 1.0 && m_limit_right == 1.0);
+    for(uint32_t i = m_passDone / 2; i < n / 2; i += 2) {
+        int16_t sample[2];
+        sample[RIGHTCHANNEL] = pcm[i];
+        sample[LEFTCHANNEL] = pcm[i + 1];
+        computeVUlevel(sample);
+        if(unity) continue;
+        pcm[i] = (int32_t)(pcm[i] * m_limit_right);      // as in Gain()
+        pcm[i + 1] = (int32_t)(pcm[i + 1] * m_limit_left);
+    }
+    m_passDone = n;
+    if(m_fixedOutRate) I2SsetSampleRate(m_fixedOutRate);
+    size_t written = 0;
+#if(ESP_IDF_VERSION_MAJOR == 5)
+    esp_err_t err = i2s_channel_write(m_i2s_tx_handle, (const char*)data, n, &written, 0);
+#else
+    esp_err_t err = i2s_write((i2s_port_t)m_i2s_num, (const char*)data, n, &written, 0); // no wait
+#endif
+    if(err != ESP_OK && err != 263) { log_e("ESP32 Errorcode: %i", err); }
+    written &= ~3;
+#if(ESP_IDF_VERSION_MAJOR == 5)
+    if(audio_output_tap && written) tapOutput((const int16_t*)data, written / 4);
+#endif
+    m_passDone = n - written;
+    return written;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass) {
     // see https://www.earlevel.com/main/2013/10/13/biquad-calculator-v2/
     // values can be between -40 ... +6 (dB)
+    // bands 0...2 of the equaliser: lowshelf 500Hz, peakEQ 3000Hz, highshelf 6000Hz
 
-    m_gain0 = gainLowPass;
-    m_gain1 = gainBandPass;
-    m_gain2 = gainHighPass;
-
-    // gain, attenuation (set in digital filters)
-    int db = max(m_gain0, max(m_gain1, m_gain2));
-    m_corr = pow10f((float)db / 20);
+    m_gain0 = constrain(gainLowPass, -40, 6);
+    m_gain1 = constrain(gainBandPass, -40, 6);
+    m_gain2 = constrain(gainHighPass, -40, 6);
 
-    IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2);
-
-    /*
-          This will cause a clicking sound when adjusting the EQ.
-          Because when the EQ is adjusted, the IIR filter will be cleared and played,
-          mixed in the audio data frame, and a click-like sound will be produced.
-      */
-    /*
-      int16_t tmp[2]; tmp[0] = 0; tmp[1]= 0;
-
-      IIR_filterChain0(tmp, true ); // flush the filter
-      IIR_filterChain1(tmp, true ); // flush the filter
-      IIR_filterChain2(tmp, true ); // flush the filter
-      */
+    // the equaliser reduces the level by the highest boost and moves smoothly to the new coefficients,
+    // the filter history is kept, so there is no click while adjusting
+    m_eq.setBand(0, EQ_LOWSHELF, 500, 0.707, m_gain0);
+    m_eq.setBand(1, EQ_PEAK, 3000, 2.5, m_gain1);
+    m_eq.setBand(2, EQ_HIGHSHELF, 6000, 0.707, m_gain2);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setToneBand(uint8_t band, uint8_t type, uint16_t freq, float Q, int8_t gainDB) {
+    // parametric band 0...9, type EQ_LOWSHELF, EQ_PEAK or EQ_HIGHSHELF, gain -40...+12dB, 0dB switches the band off
+    // bands 0...2 are also used by setTone()
+    return m_eq.setBand(band, type, freq, Q, gainDB);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::forceMono(bool m) { // #100 mono option
@@ -5115,506 +5981,57 @@ uint32_t Audio::inBufferSize() {
     return InBuff.getBufsize();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-//            ***     D i g i t a l   b i q u a d r a t i c     f i l t e r     ***
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infinite Impulse Response (IIR) filters
-
-    // G1 - gain low shelf   set between -40 ... +6 dB
-    // G2 - gain peakEQ      set between -40 ... +6 dB
-    // G3 - gain high shelf  set between -40 ... +6 dB
-    // https://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
-
-    if(getSampleRate() < 1000) return; // fuse
-
-    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-
-    if(G0 < -40) G0 = -40; // -40dB -> Vin*0.01
-    if(G0 > 6) G0 = 6;     // +6dB -> Vin*2
-    if(G1 < -40) G1 = -40;
-    if(G1 > 6) G1 = 6;
-    if(G2 < -40) G2 = -40;
-    if(G2 > 6) G2 = 6;
-
-    const float FcLS = 500;    // Frequency LowShelf[Hz]
-    const float FcPKEQ = 3000; // Frequency PeakEQ[Hz]
-    float       FcHS = 6000;   // Frequency HighShelf[Hz]
-
-    if(getSampleRate() < FcHS * 2 - 100) { // Prevent HighShelf filter from clogging
-        FcHS = getSampleRate() / 2 - 100;
-        // according to the sampling theorem, the sample rate must be at least 2 * 6000 >= 12000Hz for a filter
-        // frequency of 6000Hz. If this is not the case, the filter frequency (plus a reserve of 100Hz) is lowered
-        AUDIO_INFO("Highshelf frequency lowered, from 6000Hz to %luHz", (long unsigned int)FcHS);
-    }
-    float K, norm, Q, Fc, V;
-
-    // LOWSHELF
-    Fc = (float)FcLS / (float)getSampleRate(); // Cutoff frequency
-    K = tanf((float)PI * Fc);
-    V = powf(10, fabs(G0) / 20.0);
-
-    if(G0 >= 0) { // boost
-        norm = 1 / (1 + sqrtf(2) * K + K * K);
-        m_filter[LOWSHELF].a0 = (1 + sqrtf(2 * V) * K + V * K * K) * norm;
-        m_filter[LOWSHELF].a1 = 2 * (V * K * K - 1) * norm;
-        m_filter[LOWSHELF].a2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
-        m_filter[LOWSHELF].b1 = 2 * (K * K - 1) * norm;
-        m_filter[LOWSHELF].b2 = (1 - sqrtf(2) * K + K * K) * norm;
-    }
-    else { // cut
-        norm = 1 / (1 + sqrtf(2 * V) * K + V * K * K);
-        m_filter[LOWSHELF].a0 = (1 + sqrtf(2) * K + K * K) * norm;
-        m_filter[LOWSHELF].a1 = 2 * (K * K - 1) * norm;
-        m_filter[LOWSHELF].a2 = (1 - sqrtf(2) * K + K * K) * norm;
-        m_filter[LOWSHELF].b1 = 2 * (V * K * K - 1) * norm;
-        m_filter[LOWSHELF].b2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
-    }
-
-    // PEAK EQ
-    Fc = (float)FcPKEQ / (float)getSampleRate(); // Cutoff frequency
-    K = tanf((float)PI * Fc);
-    V = powf(10, fabs(G1) / 20.0);
-    Q = 2.5;      // Quality factor
-    if(G1 >= 0) { // boost
-        norm = 1 / (1 + 1 / Q * K + K * K);
-        m_filter[PEAKEQ].a0 = (1 + V / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].a1 = 2 * (K * K - 1) * norm;
-        m_filter[PEAKEQ].a2 = (1 - V / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].b1 = m_filter[PEAKEQ].a1;
-        m_filter[PEAKEQ].b2 = (1 - 1 / Q * K + K * K) * norm;
-    }
-    else { // cut
-        norm = 1 / (1 + V / Q * K + K * K);
-        m_filter[PEAKEQ].a0 = (1 + 1 / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].a1 = 2 * (K * K - 1) * norm;
-        m_filter[PEAKEQ].a2 = (1 - 1 / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].b1 = m_filter[PEAKEQ].a1;
-        m_filter[PEAKEQ].b2 = (1 - V / Q * K + K * K) * norm;
-    }
-
-    // HIGHSHELF
-    Fc = (float)FcHS / (float)getSampleRate(); // Cutoff frequency
-    K = tanf((float)PI * Fc);
-    V = powf(10, fabs(G2) / 20.0);
-    if(G2 >= 0) { // boost
-        norm = 1 / (1 + sqrtf(2) * K + K * K);
-        m_filter[HIFGSHELF].a0 = (V + sqrtf(2 * V) * K + K * K) * norm;
-        m_filter[HIFGSHELF].a1 = 2 * (K * K - V) * norm;
-        m_filter[HIFGSHELF].a2 = (V - sqrtf(2 * V) * K + K * K) * norm;
-        m_filter[HIFGSHELF].b1 = 2 * (K * K - 1) * norm;
-        m_filter[HIFGSHELF].b2 = (1 - sqrtf(2) * K + K * K) * norm;
-    }
-    else {
-        norm = 1 / (V + sqrtf(2 * V) * K + K * K);
-        m_filter[HIFGSHELF].a0 = (1 + sqrtf(2) * K + K * K) * norm;
-        m_filter[HIFGSHELF].a1 = 2 * (K * K - 1) * norm;
-        m_filter[HIFGSHELF].a2 = (1 - sqrtf(2) * K + K * K) * norm;
-        m_filter[HIFGSHELF].b1 = 2 * (K * K - V) * norm;
-        m_filter[HIFGSHELF].b2 = (V - sqrtf(2 * V) * K + K * K) * norm;
-    }
-
-    //    log_i("LS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[0].a0, m_filter[0].a1, m_filter[0].a2,
-    //                                                  m_filter[0].b1, m_filter[0].b2);
-    //    log_i("EQ a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[1].a0, m_filter[1].a1, m_filter[1].a2,
-    //                                                  m_filter[1].b1, m_filter[1].b2);
-    //    log_i("HS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[2].a0, m_filter[2].a1, m_filter[2].a2,
-    //                                                  m_filter[2].b1, m_filter[2].b2);
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-// clang-format off
-int16_t* Audio::IIR_filterChain0(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[0].a0 * inSample[LEFTCHANNEL] + m_filter[0].a1 * m_filterBuff[0][z1][in][LEFTCHANNEL] +
-        m_filter[0].a2 * m_filterBuff[0][z2][in][LEFTCHANNEL] - m_filter[0].b1 * m_filterBuff[0][z1][out][LEFTCHANNEL] -
-        m_filter[0].b2 * m_filterBuff[0][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[0][z2][in][LEFTCHANNEL] = m_filterBuff[0][z1][in][LEFTCHANNEL];
-    m_filterBuff[0][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[0][z2][out][LEFTCHANNEL] = m_filterBuff[0][z1][out][LEFTCHANNEL];
-    m_filterBuff[0][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[0].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[0].a1 * m_filterBuff[0][z1][in][RIGHTCHANNEL] +
-                              m_filter[0].a2 * m_filterBuff[0][z2][in][RIGHTCHANNEL] -
-                              m_filter[0].b1 * m_filterBuff[0][z1][out][RIGHTCHANNEL] -
-                              m_filter[0].b2 * m_filterBuff[0][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[0][z2][in][RIGHTCHANNEL] = m_filterBuff[0][z1][in][RIGHTCHANNEL];
-    m_filterBuff[0][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[0][z2][out][RIGHTCHANNEL] = m_filterBuff[0][z1][out][RIGHTCHANNEL];
-    m_filterBuff[0][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    return iir_out;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-int16_t* Audio::IIR_filterChain1(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[1].a0 * inSample[LEFTCHANNEL] + m_filter[1].a1 * m_filterBuff[1][z1][in][LEFTCHANNEL] +
-        m_filter[1].a2 * m_filterBuff[1][z2][in][LEFTCHANNEL] - m_filter[1].b1 * m_filterBuff[1][z1][out][LEFTCHANNEL] -
-        m_filter[1].b2 * m_filterBuff[1][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[1][z2][in][LEFTCHANNEL] = m_filterBuff[1][z1][in][LEFTCHANNEL];
-    m_filterBuff[1][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[1][z2][out][LEFTCHANNEL] = m_filterBuff[1][z1][out][LEFTCHANNEL];
-    m_filterBuff[1][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[1].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[1].a1 * m_filterBuff[1][z1][in][RIGHTCHANNEL] +
-                              m_filter[1].a2 * m_filterBuff[1][z2][in][RIGHTCHANNEL] -
-                              m_filter[1].b1 * m_filterBuff[1][z1][out][RIGHTCHANNEL] -
-                              m_filter[1].b2 * m_filterBuff[1][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[1][z2][in][RIGHTCHANNEL] = m_filterBuff[1][z1][in][RIGHTCHANNEL];
-    m_filterBuff[1][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[1][z2][out][RIGHTCHANNEL] = m_filterBuff[1][z1][out][RIGHTCHANNEL];
-    m_filterBuff[1][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    return iir_out;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-int16_t* Audio::IIR_filterChain2(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[2].a0 * inSample[LEFTCHANNEL] + m_filter[2].a1 * m_filterBuff[2][z1][in][LEFTCHANNEL] +
-        m_filter[2].a2 * m_filterBuff[2][z2][in][LEFTCHANNEL] - m_filter[2].b1 * m_filterBuff[2][z1][out][LEFTCHANNEL] -
-        m_filter[2].b2 * m_filterBuff[2][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[2][z2][in][LEFTCHANNEL] = m_filterBuff[2][z1][in][LEFTCHANNEL];
-    m_filterBuff[2][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[2][z2][out][LEFTCHANNEL] = m_filterBuff[2][z1][out][LEFTCHANNEL];
-    m_filterBuff[2][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[2].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[2].a1 * m_filterBuff[2][z1][in][RIGHTCHANNEL] +
-                              m_filter[2].a2 * m_filterBuff[2][z2][in][RIGHTCHANNEL] -
-                              m_filter[2].b1 * m_filterBuff[2][z1][out][RIGHTCHANNEL] -
-                              m_filter[2].b2 * m_filterBuff[2][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[2][z2][in][RIGHTCHANNEL] = m_filterBuff[2][z1][in][RIGHTCHANNEL];
-    m_filterBuff[2][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[2][z2][out][RIGHTCHANNEL] = m_filterBuff[2][z1][out][RIGHTCHANNEL];
-    m_filterBuff[2][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    return iir_out;
+void Audio::setBufferAdaptive(bool enable, uint32_t maxSize) {
+    // the size set by setBufsize() is the upper limit if maxSize is 0, telemetry is collected in both modes. Called
+    // before the first connect, the buffer starts with BH_MIN_SIZE, otherwise it changes in the next seconds.
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_f_bufAdaptive = enable;
+    m_bufAdaptMax = maxSize ? maxSize : InBuff.getMaxBufsize();
+    xSemaphoreGive(mutex_audio);
 }
-// clang-format on
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-//    AAC - T R A N S P O R T S T R E A M
+uint16_t Audio::indexSamplesPerFrame() {
+    // decoded frames (samples per channel) per indexed frame, 0 if there is no seek index for this codec
+    if(!audiofile || !m_seekIndex.getFrames()) return 0; // the decoder buffers are freed at the end of the file
+    if(m_codec == CODEC_MP3) return m_seekIndex.getSamplesPerFrame();
+    if(m_codec == CODEC_M4A && getChannels()) return AACGetOutputSamps() / getChannels(); // 2048 with SBR
+    return 0;
+}
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-bool Audio::ts_parsePacket(uint8_t* packet, uint8_t* packetStart, uint8_t* packetLength) {
-    const uint8_t TS_PACKET_SIZE = 188;
-    const uint8_t PAYLOAD_SIZE = 184;
-    const uint8_t PID_ARRAY_LEN = 4;
-
-    (void)PAYLOAD_SIZE; // suppress [-Wunused-variable]
-
-    typedef struct {
-        int number = 0;
-        int pids[PID_ARRAY_LEN];
-    } pid_array;
-
-    static pid_array pidsOfPMT;
-    static int       PES_DataLength = 0;
-    static int       pidOfAAC = 0;
-
-    if(packet == NULL) {
-        if(m_f_Log) log_i("parseTS reset");
-        for(int i = 0; i < PID_ARRAY_LEN; i++) pidsOfPMT.pids[i] = 0;
-        PES_DataLength = 0;
-        pidOfAAC = 0;
-        return true;
-    }
-
-    // --------------------------------------------------------------------------------------------------------
-    // 0. Byte SyncByte  | 0 | 1 | 0 | 0 | 0 | 1 | 1 | 1 | always bit pattern of 0x47
-    //---------------------------------------------------------------------------------------------------------
-    // 1. Byte           |PUSI|TP|   |PID|PID|PID|PID|PID|
-    //---------------------------------------------------------------------------------------------------------
-    // 2. Byte           |PID|PID|PID|PID|PID|PID|PID|PID|
-    //---------------------------------------------------------------------------------------------------------
-    // 3. Byte           |TSC|TSC|AFC|AFC|CC |CC |CC |CC |
-    //---------------------------------------------------------------------------------------------------------
-    // 4.-187. Byte      |Payload data if AFC==01 or 11  |
-    //---------------------------------------------------------------------------------------------------------
-
-    // PUSI Payload unit start indicator, set when this packet contains the first byte of a new payload unit.
-    //      The first byte of the payload will indicate where this new payload unit starts.
-    // TP   Transport priority, set when the current packet has a higher priority than other packets with the same PID.
-    // PID  Packet Identifier, describing the payload data.
-    // TSC  Transport scrambling control, '00' = Not scrambled.
-    // AFC  Adaptation field control, 01 – no adaptation field, payload only, 10 – adaptation field only, no payload,
-    //                                11 – adaptation field followed by payload, 00 – RESERVED for future use
-    // CC   Continuity counter, Sequence number of payload packets (0x00 to 0x0F) within each stream (except PID 8191)
-
-    if(packet[0] != 0x47) {
-        log_e("ts SyncByte not found, first bytes are %X %X %X %X", packet[0], packet[1], packet[2], packet[3]);
-        stopSong();
-        return false;
-    }
-    int PID = (packet[1] & 0x1F) << 8 | (packet[2] & 0xFF);
-    if(m_f_Log) log_i("PID: 0x%04X(%d)", PID, PID);
-    int PUSI = (packet[1] & 0x40) >> 6;
-    if(m_f_Log) log_i("Payload Unit Start Indicator: %d", PUSI);
-    int AFC = (packet[3] & 0x30) >> 4;
-    if(m_f_Log) log_i("Adaption Field Control: %d", AFC);
-
-    int AFL = -1;
-    if((AFC & 0b10) == 0b10) {  // AFC '11' Adaptation Field followed
-        AFL = packet[4] & 0xFF; // Adaptation Field Length
-        if(m_f_Log) log_i("Adaptation Field Length: %d", AFL);
-    }
-    int PLS = PUSI ? 5 : 4;     // PayLoadStart, Payload Unit Start Indicator
-    if(AFL > 0) PLS += AFL + 1; // skip adaption field
-
-    if(PID == 0) {
-        // Program Association Table (PAT) - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-        if(m_f_Log) log_i("PAT");
-        pidsOfPMT.number = 0;
-        pidOfAAC = 0;
-
-        int startOfProgramNums = 8;
-        int lengthOfPATValue = 4;
-        int sectionLength = ((packet[PLS + 1] & 0x0F) << 8) | (packet[PLS + 2] & 0xFF);
-        if(m_f_Log) log_i("Section Length: %d", sectionLength);
-        int program_number, program_map_PID;
-        int indexOfPids = 0;
-        (void)program_number; // [-Wunused-but-set-variable]
-        for(int i = startOfProgramNums; i <= sectionLength; i += lengthOfPATValue) {
-            program_number = ((packet[PLS + i] & 0xFF) << 8) | (packet[PLS + i + 1] & 0xFF);
-            program_map_PID = ((packet[PLS + i + 2] & 0x1F) << 8) | (packet[PLS + i + 3] & 0xFF);
-            if(m_f_Log) log_i("Program Num: 0x%04X(%d) PMT PID: 0x%04X(%d)", program_number, program_number, program_map_PID, program_map_PID);
-            pidsOfPMT.pids[indexOfPids++] = program_map_PID;
-        }
-        pidsOfPMT.number = indexOfPids;
-        *packetStart = 0;
-        *packetLength = 0;
-        return true;
-    }
-    else if(PID == pidOfAAC) {
-        static uint8_t fillData = 0;
-        if(m_f_Log) log_i("AAC");
-        uint8_t posOfPacketStart = 4;
-        if(AFL >= 0) {
-            posOfPacketStart = 5 + AFL;
-            if(m_f_Log) log_i("posOfPacketStart: %d", posOfPacketStart);
-        }
-        // Packetized Elementary Stream (PES) - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-        if(m_f_Log) log_i("PES_DataLength %i", PES_DataLength);
-        if(PES_DataLength > 0) {
-            *packetStart = posOfPacketStart + fillData;
-            *packetLength = TS_PACKET_SIZE - posOfPacketStart - fillData;
-            fillData = 0;
-            PES_DataLength -= (*packetLength);
-            return true;
-        }
-        else {
-            int firstByte = packet[posOfPacketStart] & 0xFF;
-            int secondByte = packet[posOfPacketStart + 1] & 0xFF;
-            int thirdByte = packet[posOfPacketStart + 2] & 0xFF;
-            if(m_f_Log) log_i("First 3 bytes: %02X %02X %02X", firstByte, secondByte, thirdByte);
-            if(firstByte == 0x00 && secondByte == 0x00 && thirdByte == 0x01) { // Packet start code prefix
-                // PES
-                uint8_t StreamID = packet[posOfPacketStart + 3] & 0xFF;
-                if(StreamID >= 0xC0 && StreamID <= 0xDF) { ; } // okay ist audio stream
-                if(StreamID >= 0xE0 && StreamID <= 0xEF) {
-                    log_e("video stream!");
-                    return false;
-                }
-                uint8_t PES_HeaderDataLength = packet[posOfPacketStart + 8] & 0xFF;
-                if(m_f_Log) log_i("PES_headerDataLength %d", PES_HeaderDataLength);
-                int PES_PacketLength = ((packet[posOfPacketStart + 4] & 0xFF) << 8) + (packet[posOfPacketStart + 5] & 0xFF);
-                if(m_f_Log) log_i("PES Packet length: %d", PES_PacketLength);
-                PES_DataLength = PES_PacketLength;
-                int startOfData = PES_HeaderDataLength + 9;
-                if(posOfPacketStart + startOfData >= 188) { // only fillers in packet
-                    if(m_f_Log) log_e("posOfPacketStart + startOfData %i", posOfPacketStart + startOfData);
-                    *packetStart = 0;
-                    *packetLength = 0;
-                    PES_DataLength -= (PES_HeaderDataLength + 3);
-                    fillData = (posOfPacketStart + startOfData) - 188;
-                    if(m_f_Log) log_i("fillData %i", fillData);
-                    return true;
-                }
-                if(m_f_Log) log_i("First AAC data byte: %02X", packet[posOfPacketStart + startOfData]);
-                if(m_f_Log) log_i("Second AAC data byte: %02X", packet[posOfPacketStart + startOfData + 1]);
-                *packetStart = posOfPacketStart + startOfData;
-                *packetLength = TS_PACKET_SIZE - posOfPacketStart - startOfData;
-                PES_DataLength -= (*packetLength);
-                PES_DataLength -= (PES_HeaderDataLength + 3);
-                return true;
-            }
-            if(firstByte == 0 && secondByte == 0 && thirdByte == 0){
-                // PES packet startcode prefix is 0x000000
-                // skip such packets
-                return true;
-            }
-        }
-        *packetStart = 0;
-        *packetLength = 0;
-        log_e("PES not found");
-        return false;
-    }
-    else if(pidsOfPMT.number) {
-        //  Program Map Table (PMT) - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-        for(int i = 0; i < pidsOfPMT.number; i++) {
-            if(PID == pidsOfPMT.pids[i]) {
-                if(m_f_Log) log_i("PMT");
-                int staticLengthOfPMT = 12;
-                int sectionLength = ((packet[PLS + 1] & 0x0F) << 8) | (packet[PLS + 2] & 0xFF);
-                if(m_f_Log) log_i("Section Length: %d", sectionLength);
-                int programInfoLength = ((packet[PLS + 10] & 0x0F) << 8) | (packet[PLS + 11] & 0xFF);
-                if(m_f_Log) log_i("Program Info Length: %d", programInfoLength);
-                int cursor = staticLengthOfPMT + programInfoLength;
-                while(cursor < sectionLength - 1) {
-                    int streamType = packet[PLS + cursor] & 0xFF;
-                    int elementaryPID = ((packet[PLS + cursor + 1] & 0x1F) << 8) | (packet[PLS + cursor + 2] & 0xFF);
-                    if(m_f_Log) log_i("Stream Type: 0x%02X Elementary PID: 0x%04X", streamType, elementaryPID);
-
-                    if(streamType == 0x0F || streamType == 0x11) {
-                        if(m_f_Log) log_i("AAC PID discover");
-                        pidOfAAC = elementaryPID;
-                    }
-                    int esInfoLength = ((packet[PLS + cursor + 3] & 0x0F) << 8) | (packet[PLS + cursor + 4] & 0xFF);
-                    if(m_f_Log) log_i("ES Info Length: 0x%04X", esInfoLength);
-                    cursor += 5 + esInfoLength;
-                }
-            }
-        }
-        *packetStart = 0;
-        *packetLength = 0;
-        return true;
-    }
-    // PES received before PAT and PMT seen
-    *packetStart = 0;
-    *packetLength = 0;
-    return false;
+void Audio::gaplessTrim() {
+    // removes the encoder and decoder delay at the beginning and the padding at the end of the decoded samples
+    int16_t  valid = m_validSamples;
+    uint8_t  ch = getChannels();
+    if(m_gaplessSkip) {
+        uint32_t n = min(m_gaplessSkip, (uint32_t)valid);
+        m_gaplessSkip -= n;
+        valid -= n;
+        if(valid) memmove(m_outBuff, m_outBuff + n * ch, valid * ch * sizeof(int16_t));
+    }
+    if(m_gaplessLeft != UINT32_MAX) {
+        if((uint32_t)valid > m_gaplessLeft) valid = m_gaplessLeft;
+        m_gaplessLeft -= valid;
+    }
+    m_validSamples = valid;
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //    W E B S T R E A M  -  H E L P   F U N C T I O N S
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-uint16_t Audio::readMetadata(uint16_t maxBytes, bool first) {
-    static uint16_t pos_ml = 0; // determines the current position in metaline
-    static uint16_t metalen = 0;
-    uint16_t        res = 0;
-    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    if(first) {
-        pos_ml = 0;
-        metalen = 0;
-        return 0;
-    }
-    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    if(!maxBytes) return 0; // guard
-
-    if(!metalen) {
-        int b = _client->read(); // First byte of metadata?
-        metalen = b * 16;        // New count for metadata including length byte, max 4096
-        pos_ml = 0;
-        m_chbuf[pos_ml] = 0; // Prepare for new line
-        res = 1;
-    }
-    if(!metalen) {
-        m_metacount = m_metaint;
-        return res;
-    } // metalen is 0
-    if(metalen < m_chbufSize) {
-        uint16_t a = _client->readBytes(&m_chbuf[pos_ml], min((uint16_t)(metalen - pos_ml), (uint16_t)(maxBytes - 1)));
-        res += a;
-        pos_ml += a;
-    }
-    else { // metadata doesn't fit in m_chbuf
-        uint8_t c = 0;
-        int8_t  i = 0;
-        while(pos_ml != metalen) {
-            i = _client->read(&c, 1); // fake read
-            if(i != -1) {
-                pos_ml++;
-                res++;
-            }
-            else { return res; }
-        }
-        m_metacount = m_metaint;
-        metalen = 0;
-        pos_ml = 0;
-        return res;
-    }
-    if(pos_ml == metalen) {
-        m_chbuf[pos_ml] = '\0';
-        if(strlen(m_chbuf)) { // Any info present?
-            // metaline contains artist and song name.  For example:
-            // "StreamTitle='Don McLean - American Pie';StreamUrl='';"
-            // Sometimes it is just other info like:
-            // "StreamTitle='60s 03 05 Magic60s';StreamUrl='';"
-            // Isolate the StreamTitle, remove leading and trailing quotes if present.
-            latinToUTF8(m_chbuf, m_chbufSize);          // convert to UTF-8 if necessary
-            int pos = indexOf(m_chbuf, "song_spot", 0); // remove some irrelevant infos
-            if(pos > 3) {                               // e.g. song_spot="T" MediaBaseId="0" itunesTrackId="0"
-                m_chbuf[pos] = 0;
-            }
-            showstreamtitle(m_chbuf); // Show artist and title if present in metadata
-        }
-        m_metacount = m_metaint;
-        metalen = 0;
-        pos_ml = 0;
-    }
-    return res;
+void Audio::icyMetadata(void* audio, char* meta, uint16_t len) {
+    // AudioHTTPBody, a whole metadata block in m_chbuf
+    (void)len;
+    Audio* a = (Audio*)audio;
+    // metaline contains artist and song name.  For example:
+    // "StreamTitle='Don McLean - American Pie';StreamUrl='';"
+    // Sometimes it is just other info like:
+    // "StreamTitle='60s 03 05 Magic60s';StreamUrl='';"
+    // Isolate the StreamTitle, remove leading and trailing quotes if present.
+    a->latinToUTF8(meta, a->m_chbufSize);       // convert to UTF-8 if necessary
+    int pos = a->indexOf(meta, "song_spot", 0); // remove some irrelevant infos
+    if(pos > 3) {                               // e.g. song_spot="T" MediaBaseId="0" itunesTrackId="0"
+        meta[pos] = 0;
+    }
+    a->showstreamtitle(meta); // Show artist and title if present in metadata
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 size_t Audio::chunkedDataTransfer(uint8_t* bytes) {
@@ -5891,12 +6308,36 @@ void Audio::seek_m4a_ilst() {
             }
         }
     }
+    uint32_t delay = 0, samples = 0;
+    if(m4a_readSMPB(data, len, &delay, &samples)) {
+        m_gaplessSkip = delay;
+        m_gaplessLeft = samples;
+        m_gaplessDelay = delay;
+        m_gaplessTotal = samples;
+        if(m_f_Log) log_i("gapless: delay %lu, samples %lu", (long unsigned)delay, (long unsigned)samples);
+    }
     m_f_m4aID3dataAreRead = true;
     if(data) free(data);
     audiofile.seek(0);
     return;
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::m4a_readSMPB(uint8_t* data, int len, uint32_t* delay, uint32_t* samples) {
+    // gapless: " 00000000 00000840 000001CA 00000000003F1234 ...", delay, padding, number of samples
+    int offset = specialIndexOf(data, "iTunSMPB", len);
+    if(offset <= 0) return false;
+    int d = specialIndexOf(data + offset, "data", len - offset);
+    if(d <= 0 || offset + d + 12 >= len) return false;
+    char               smpb[64] = {0};
+    unsigned int       del = 0, padding = 0;
+    unsigned long long num = 0;
+    memcpy(smpb, data + offset + d + 12, min(63, len - offset - d - 12));
+    if(sscanf(smpb, " %*x %x %x %llx", &del, &padding, &num) != 3 || !num || num >= UINT32_MAX) return false;
+    *delay = del;
+    *samples = num;
+    return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::seek_m4a_stsz() {
     // stsz says what size each sample is in bytes. This is important for the decoder to be able to start at a chunk,
     // and then go through each sample by its size. The stsz atom can be behind the audio block. Therefore, searching
@@ -6077,22 +6518,40 @@ uint32_t Audio::mp3_correctResumeFilePos(uint32_t resumeFilePos) {
     return m_audioDataStart;
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::mp3_readGaplessInfo(uint8_t* data, uint32_t len) {
+    // data points to the beginning of the audio data. A Xing/Info frame contains no audio, it is skipped. The LAME
+    // tag gives the encoder delay and padding, the decoder delay of 529 samples is added.
+    // returns the number of bytes to skip
+    m_gaplessSkip = 0;
+    m_gaplessLeft = UINT32_MAX;
+    m_gaplessDelay = 0;
+    m_gaplessTotal = UINT32_MAX;
+    int syncPos = MP3FindSyncWord(data, len);
+    if(syncPos < 0) return 0;
+    MP3XingInfo_t xi;
+    if(MP3GetXingInfo(data + syncPos, len - syncPos, &xi) != ERR_MP3_NONE || !xi.frameLen) return 0;
+    if(xi.frames && (xi.encDelay || xi.encPadding)) {
+        uint32_t total = xi.frames * xi.samplesPerFrame;
+        if(total > (uint32_t)(xi.encDelay + xi.encPadding)) {
+            m_gaplessSkip = xi.encDelay + 529;
+            m_gaplessLeft = total - xi.encDelay - xi.encPadding;
+            m_gaplessDelay = m_gaplessSkip;
+            m_gaplessTotal = m_gaplessLeft;
+            if(m_f_Log) log_i("gapless: delay %i, padding %i, samples %lu", xi.encDelay, xi.encPadding, (long unsigned)m_gaplessLeft);
+        }
+    }
+    return min((uint32_t)(syncPos + xi.frameLen), len);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint8_t Audio::determineOggCodec(uint8_t* data, uint16_t len) {
     // if we have contentType == application/ogg; codec cn be OPUS, FLAC or VORBIS
     // let's have a look, what it is
-    int idx = specialIndexOf(data, "OggS", 6);
-    if(idx != 0) {
-        if(specialIndexOf(data, "fLaC", 6)) return CODEC_FLAC;
-        return CODEC_NONE;
-    }
-    data += 27;
-    idx = specialIndexOf(data, "OpusHead", 40);
-    if(idx >= 0) { return CODEC_OPUS; }
-    idx = specialIndexOf(data, "fLaC", 40);
-    if(idx >= 0) { return CODEC_FLAC; }
-    idx = specialIndexOf(data, "vorbis", 40);
-    if(idx >= 0) { return CODEC_VORBIS; }
-    return CODEC_NONE;
+    switch(OGG_identifyCodec(data, len)) {
+        case OGG_CODEC_OPUS:   return CODEC_OPUS;
+        case OGG_CODEC_FLAC:   return CODEC_FLAC;
+        case OGG_CODEC_VORBIS: return CODEC_VORBIS;
+        default:               return CODEC_NONE;
+    }
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
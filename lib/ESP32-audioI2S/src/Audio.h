@@ -22,9 +22,19 @@
 #include <FS.h>
 #include <FFat.h>
 #include <atomic>
+#include "biquad_eq/biquad_eq.h"
+#include "resampler/resampler.h"
+#include "audio_mixer/audio_mixer.h"
+#include "sound_bank/sound_bank.h"
+#include "seek_index/seek_index.h"
+#include "buffer_health/buffer_health.h"
+#include "hls_prefetch/hls_prefetch.h"
+#include "ts_demuxer/ts_demuxer.h"
+#include "http_body/http_body.h"
 
 #if ESP_IDF_VERSION_MAJOR == 5
 #include <driver/i2s_std.h>
+#include <esp_timer.h>
 #else
 #include <driver/i2s.h>
 #endif
@@ -32,6 +42,7 @@
 #ifndef I2S_GPIO_UNUSED
   #define I2S_GPIO_UNUSED -1 // = I2S_PIN_NO_CHANGE in IDF < 5
 #endif
+#define AUDIO_TAP_FRAMES 64 // frames per audio_output_tap() call from outputSample()
 using namespace std;
 
 extern __attribute__((weak)) void audio_info(const char*);
@@ -40,6 +51,7 @@ extern __attribute__((weak)) void audio_id3image(File& file, const size_t pos, c
 extern __attribute__((weak)) void audio_oggimage(File& file, std::vector<uint32_t> v); //OGG blockpicture
 extern __attribute__((weak)) void audio_id3lyrics(File& file, const size_t pos, const size_t size); //ID3 metadata lyrics
 extern __attribute__((weak)) void audio_eof_mp3(const char*); //end of mp3 file
+extern __attribute__((weak)) void audio_next_file(const char*); //the file given by setNextFile() is playing now
 extern __attribute__((weak)) void audio_showstreamtitle(const char*);
 extern __attribute__((weak)) void audio_showstation(const char*);
 extern __attribute__((weak)) void audio_bitrate(const char*);
@@ -52,6 +64,7 @@ extern __attribute__((weak)) void audio_eof_speech(const char*);
 extern __attribute__((weak)) void audio_eof_stream(const char*); // The webstream comes to an end
 extern __attribute__((weak)) void audio_process_extern(int16_t* buff, uint16_t len, bool *continueI2S); // record audiodata or send via BT
 extern __attribute__((weak)) void audio_process_i2s(uint32_t* sample, bool *continueI2S); // record audiodata or send via BT
+extern __attribute__((weak)) void audio_output_tap(const int16_t* frames, uint16_t n, uint32_t rate, int64_t playUs); // what goes to the DAC, playUs: esp_timer time of the first frame (IDF 5)
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -85,7 +98,7 @@ class AudioBuffer {
 public:
     AudioBuffer(size_t maxBlockSize = 0);       // constructor
     ~AudioBuffer();                             // frees the buffer
-    size_t   init();                            // set default values
+    size_t   init(size_t psramSize = 0);        // set default values, psramSize 0: the size given by setBufsize()
     bool     isInitialized() { return m_f_init; };
     void     setBufsize(int ram, int psram);
     int32_t  getBufsize();
@@ -101,7 +114,12 @@ public:
     uint8_t* getReadPtr();                      // returns the current readpointer
     uint32_t getWritePos();                     // write position relative to the beginning
     uint32_t getReadPos();                      // read position relative to the beginning
+    size_t   getBytesToEnd();                   // from readpointer to the end, without the copy behind it
     void     resetBuffer();                     // restore defaults
+    bool     resize(size_t size, bool psram, size_t tail = 0); // keeps the stored data and 'tail' bytes behind it,
+                                                               // the buffer can move between RAM and PSRAM
+    size_t   getMaxBufsize();                   // size given by setBufsize() for the memory that is available
+    uint32_t getBytesIn() { return m_bytesIn; } // all bytes written so far, wraps around
     bool     havePSRAM() { return m_f_psram; };
 
 protected:
@@ -113,11 +131,13 @@ protected:
     size_t   m_dataLength       = 0;
     size_t   m_resBuffSizeRAM   = 2048;     // reserved buffspace, >= one wav  frame
     size_t   m_resBuffSizePSRAM = 4096 * 4; // reserved buffspace, >= one flac frame
+    size_t   m_resBuffSize      = 0;        // of the current buffer
     size_t   m_maxBlockSize     = 1600;
     uint8_t* m_buffer           = NULL;
     uint8_t* m_writePtr         = NULL;
     uint8_t* m_readPtr          = NULL;
     uint8_t* m_endPtr           = NULL;
+    uint32_t m_bytesIn          = 0;
     bool     m_f_start          = true;
     bool     m_f_init           = false;
     bool     m_f_psram          = false;    // PSRAM is available (and used...)
@@ -134,14 +154,19 @@ public:
     void setBufsize(int rambuf_sz, int psrambuf_sz);
     bool openai_speech(const String& api_key, const String& model, const String& input, const String& voice, const String& response_format, const String& speed);
     bool connecttohost(const char* host, const char* user = "", const char* pwd = "");
-    bool connecttospeech(const char* speech, const char* lang);
+    bool connecttospeech(const char* speech, const char* lang); // sentence by sentence, the next ones load while one plays (PSRAM)
     bool connecttoFS(fs::FS &fs, const char* path, int32_t resumeFilePos = -1);
+    bool setNextFile(fs::FS &fs, const char* path); // gapless (mp3, m4a), follows the current file without connecttoFS()
+    int8_t loadSound(fs::FS &fs, const char* path); // decodes a short WAV or MP3 clip into the sound bank, SB_OK or SB_ERR_...
+    int8_t playSound(const char* path, uint8_t type = MIX_EFFECT, float gain = 1.0); // from the bank, SB_ERR_MISS if not loaded
     bool setFileLoop(bool input);//TEST loop
     void setConnectionTimeout(uint16_t timeout_ms, uint16_t timeout_ms_ssl);
     bool setAudioPlayPosition(uint16_t sec);
     bool setFilePos(uint32_t pos);
     bool audioFileSeek(const float speed);
+    bool setOutputSampleRate(uint32_t sampRate); // fixed I2S rate, e.g. 48000, the PCM is resampled; 0: I2S follows the decoder
     bool setTimeOffset(int sec);
+    void setOggCRCcheck(bool enable); // Opus, Vorbis, Ogg-FLAC: a page with a wrong CRC is dropped, the decoder resyncs
     bool setPinout(uint8_t BCLK, uint8_t LRC, uint8_t DOUT, int8_t MCLK = I2S_GPIO_UNUSED);
     bool pauseResume();
     bool isRunning() {return m_f_running;}
@@ -170,7 +195,16 @@ public:
     uint32_t inBufferFilled(); // returns the number of stored bytes in the inputbuffer
     uint32_t inBufferFree();   // returns the number of free bytes in the inputbuffer
     uint32_t inBufferSize();   // returns the size of the inputbuffer in bytes
+    void setBufferAdaptive(bool enable, uint32_t maxSize = 0); // the inputbuffer follows rate and jitter, see buffer_health.h
+    const bh_stats_t* getBufferHealth(uint8_t source) {return m_bufHealth.getStats(source);} // BH_SD, BH_HTTP, BH_HLS
+    void resetBufferHealth() {m_bufHealth.clear();}
+    void setHLSPrefetch(bool enable) {m_f_hlsPrefetch = enable;} // m3u8: the next segments are loaded in advance, needs PSRAM, off by default
+    uint32_t getHLSLoadTime() {return m_hls.getLoadTime();}        // ms of the last prefetched segment
+    AudioTSDemuxer* getTSDemuxer() {return &m_tsDemux;}           // m3u8 .ts: audio streams, selectStream(), statistics
     void setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass);
+    bool setToneBand(uint8_t band, uint8_t type, uint16_t freq, float Q, int8_t gainDB); // EQ_LOWSHELF, EQ_PEAK, EQ_HIGHSHELF
+    AudioMixer* getMixer() {return &m_mixer;} // prompts and effects on top of the music, see audio_mixer.h
+    AudioSoundBank* getSoundBank() {return &m_soundBank;} // decoded clips, budget and statistics, see sound_bank.h
     void setI2SCommFMT_LSB(bool commFMT);
     int getCodec() {return m_codec;}
     const char *getCodecname() {return codecname[m_codec];}
@@ -194,7 +228,18 @@ private:
     void processWebFile();
     void processWebStreamTS();
     void processWebStreamHLS();
+    uint32_t hlsAvailable();
+    uint32_t hlsRead(uint8_t* buff, uint32_t len);
+    void hlsPrefetch();
+    uint8_t nextSegmentHLS();
+    uint16_t speechSentence(const char* text, uint16_t maxLen);
+    char* speechQuery(const char* text, uint16_t len, const char* lang);
+    void speechPrefetch();
+    uint8_t nextSpeech();
+    uint32_t readSpeechHead(uint32_t len, uint32_t remaining);
+    uint32_t skipSpeechID3(uint8_t* buff, uint32_t len);
     void playAudioData();
+    void adaptInBuff();
     bool readPlayListData();
     const char* parsePlaylist_M3U();
     const char* parsePlaylist_PLS();
@@ -222,6 +267,10 @@ private:
     bool setBitrate(int br);
     void playChunk();
     bool playSample(int16_t sample[2]);
+    bool outputSample(int16_t sample[2]);
+    void playMixerOnly();
+    bool canPassthrough();
+    int  passthroughPCM(uint8_t* data, size_t len);
     void computeVUlevel(int16_t sample[2]);
     void computeLimit();
     int32_t Gain(int16_t s[2]);
@@ -231,18 +280,22 @@ private:
     bool initializeDecoder();
     esp_err_t I2Sstart(uint8_t i2s_num);
     esp_err_t I2Sstop(uint8_t i2s_num);
+    void I2SsetSampleRate(uint32_t sampRate);
+#if ESP_IDF_VERSION_MAJOR == 5
+    void I2SresetCounters();
+    int64_t I2SplayTime(uint32_t frame);
+    void I2SrebaseWritten();
+    void tapOutput(const int16_t* frames, uint16_t n);
+    void flushTap();
+    static bool IRAM_ATTR onI2Ssent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+#endif
     void urlencode(char* buff, uint16_t buffLen, bool spacesOnly = false);
-    int16_t* IIR_filterChain0(int16_t iir_in[2], bool clear = false);
-    int16_t* IIR_filterChain1(int16_t iir_in[2], bool clear = false);
-    int16_t* IIR_filterChain2(int16_t iir_in[2], bool clear = false);
     inline void setDatamode(uint8_t dm){m_datamode=dm;}
     inline uint8_t getDatamode(){return m_datamode;}
     inline uint32_t streamavail(){ return _client ? _client->available() : 0;}
-    void IIR_calculateCoefficients(int8_t G1, int8_t G2, int8_t G3);
-    bool ts_parsePacket(uint8_t* packet, uint8_t* packetStart, uint8_t* packetLength);
 
 //+++ W E B S T R E A M  -  H E L P   F U N C T I O N S +++
-    uint16_t readMetadata(uint16_t b, bool first = false);
+    static void icyMetadata(void* audio, char* meta, uint16_t len);
     size_t   chunkedDataTransfer(uint8_t* bytes);
     bool     readID3V1Tag();
     boolean  streamDetection(uint32_t bytesAvail);
@@ -252,6 +305,14 @@ private:
     uint32_t flac_correctResumeFilePos(uint32_t resumeFilePos);
     uint32_t mp3_correctResumeFilePos(uint32_t resumeFilePos);
     uint8_t  determineOggCodec(uint8_t* data, uint16_t len);
+    uint32_t mp3_readGaplessInfo(uint8_t* data, uint32_t len);
+    bool     m4a_readSMPB(uint8_t* data, int len, uint32_t* delay, uint32_t* samples);
+    void     gaplessTrim();
+    uint16_t indexSamplesPerFrame();
+    void     prerollNextFile();
+    bool     prerollM4A();
+    bool     startNextFile();
+    void     clearNextFile();
 
 
 //++++ implement several function with respect to the index of string ++++
@@ -305,7 +366,7 @@ private:
         const char *p = base;
         for (; startIndex > 0; startIndex--)
             if (*p++ == '\0') return -1;
-        char* pos = strstr(p, str);
+        const char* pos = strstr(p, str);
         if (pos == nullptr) return -1;
         return pos - base;
     }
@@ -315,7 +376,7 @@ private:
         const char *p = base;
         for (; startIndex > 0; startIndex--)
             if (*p++ == '\0') return -1;
-        char *pos = strchr(p, ch);
+        const char* pos = strchr(p, ch);
         if (pos == nullptr) return -1;
         return pos - base;
     }
@@ -435,16 +496,25 @@ private:
     enum : int { CODEC_NONE = 0, CODEC_WAV = 1, CODEC_MP3 = 2, CODEC_AAC = 3, CODEC_M4A = 4, CODEC_FLAC = 5,
                  CODEC_AACP = 6, CODEC_OPUS = 7, CODEC_OGG = 8, CODEC_VORBIS = 9};
     enum : int { ST_NONE = 0, ST_WEBFILE = 1, ST_WEBSTREAM = 2};
+    enum : int { PR_NONE = 0, PR_QUEUED = 1, PR_OPEN = 2, PR_READY = 3, PR_FAILED = 4 };
     typedef enum { LEFTCHANNEL=0, RIGHTCHANNEL=1 } SampleIndex;
-    typedef enum { LOWSHELF = 0, PEAKEQ = 1, HIFGSHELF =2 } FilterType;
 
-    typedef struct _filter{
-        float a0;
-        float a1;
-        float a2;
-        float b1;
-        float b2;
-    } filter_t;
+    typedef struct _preroll{        // next file, opened during the last seconds of the current one
+        fs::FS*  fs;
+        char*    path;
+        File     file;
+        uint8_t  state;             // PR_NONE ... PR_FAILED
+        uint8_t* buff;              // first audio frames of the next file
+        uint32_t len;
+        uint32_t dataStart;         // file position behind the ID3 tags, m4a: of the mdat content
+        uint32_t dataSize;          // m4a: mdat content, moov can follow
+        uint32_t sampleRate;
+        uint8_t  channels;
+        uint32_t stszPos;           // m4a: as m_stsz_position, m_stsz_numEntries
+        uint32_t stszEntries;
+        uint32_t gaplessDelay;      // m4a: iTunSMPB, gaplessTotal is UINT32_MAX without it
+        uint32_t gaplessTotal;
+    } preroll_t;
 
     typedef struct _pis_array{
         int number;
@@ -471,6 +541,7 @@ private:
 
     std::vector<char*>    m_playlistContent;  // m3u8 playlist buffer
     std::vector<char*>    m_playlistURL;      // m3u8 streamURLs buffer
+    std::vector<char*>    m_speechURL;        // connecttospeech(): the sentences that follow, the next one at the end
     std::vector<uint32_t> m_hashQueue;
 
     const size_t    m_frameSizeWav    = 2048;
@@ -480,6 +551,7 @@ private:
     const size_t    m_frameSizeOPUS   = 1024;
     const size_t    m_frameSizeVORBIS = 4096 * 2;
     const size_t    m_outbuffSize     = 4096 * 2;
+    const uint16_t  m_speechMaxLen    = 180;    // bytes of one sentence, translate_tts takes up to 200 characters
 
     static const uint8_t m_tsPacketSize  = 188;
     static const uint8_t m_tsHeaderSize  = 4;
@@ -492,13 +564,51 @@ private:
     char*           m_lastM3U8host = NULL;
     char*           m_playlistBuff = NULL;          // stores playlistdata
     const uint16_t  m_plsBuffEntryLen = 256;        // length of each entry in playlistBuff
-    filter_t        m_filter[3];                    // digital filters
+    BiquadEQ        m_eq;                           // digital filters, equaliser
+    AudioResampler  m_resampler;                    // decoder rate -> m_fixedOutRate
+    int16_t*        m_rsBuff = NULL;                // resampled PCM
+    uint32_t        m_rsBuffLen = 0;                // in samples
+    uint32_t        m_fixedOutRate = 0;             // 0: the I2S clock follows the decoder
+    uint32_t        m_i2sSampleRate = 0;            // current I2S clock
+    float           m_playSpeed = 1.0;              // audioFileSeek()
+    bool            m_f_resampled = false;          // playChunk() plays m_rsBuff
+    AudioMixer      m_mixer;                        // SPSC streams added to the music, ducking
+    AudioSoundBank  m_soundBank;                    // decoded clips, played by the mixer
+    int16_t         m_mixBuff[MIX_CHUNK_FRAMES * 2];// mixer output while no track is running
+    uint16_t        m_mixValid = 0;                 // frames in m_mixBuff
+    uint16_t        m_mixCur = 0;
+    volatile uint32_t m_i2sSent = 0;                // frames the DMA has played, counted in onI2Ssent()
+    volatile int64_t  m_i2sSentUs = 0;              // esp_timer time of the last count, the next buffer starts there
+    uint32_t        m_i2sWritten = 0;               // frames given to the DMA, same origin as m_i2sSent
+    int16_t         m_tapBuff[AUDIO_TAP_FRAMES * 2];// outputSample() frames for audio_output_tap()
+    uint16_t        m_tapCnt = 0;
+    uint32_t        m_tapFirst = 0;                 // m_i2sWritten of m_tapBuff[0]
+    preroll_t       m_preroll = {};                 // setNextFile()
+    const uint8_t   m_prerollSec = 5;               // the next file is opened when the current one ends in less than 5s
+    const uint16_t  m_prerollBytes = 8192;          // first frames of the next file, read in advance
+    bool            m_f_connectNext = false;        // the next file cannot follow seamlessly, connecttoFS() in loop()
+    uint32_t        m_gaplessSkip = 0;              // frames to drop, encoder and decoder delay
+    uint32_t        m_gaplessLeft = UINT32_MAX;     // valid frames until the encoder padding, UINT32_MAX: unknown
+    uint32_t        m_gaplessDelay = 0;             // m_gaplessSkip at the beginning of the file
+    uint32_t        m_gaplessTotal = UINT32_MAX;    // m_gaplessLeft at the beginning of the file
+    AudioSeekIndex  m_seekIndex;                    // frame positions of mp3 and m4a files, exact jumps
+    AudioBufferHealth m_bufHealth;                  // fill level, refill gaps and underruns of InBuff
+    uint32_t        m_bufAdaptMax = 0;              // setBufferAdaptive()
+    AudioHLSPrefetch m_hls;                         // m3u8 segments loaded in advance
+    AudioTSDemuxer  m_tsDemux;                      // m3u8 .ts segments
+    AudioHTTPBody   m_httpBody;                     // web stream: chunk framing and ICY metadata
+    uint32_t        m_hlsRefresh = 0;               // millis() of the last playlist request of m_hls
+    uint64_t        m_hlsSeq = 0;                   // segments given to m_hls
+    uint32_t        m_speechSkip = 0;               // bytes of an ID3 tag at the start of a sentence that follows
+    uint8_t         m_speechHead[10];               // its first bytes, ID3 header?
+    uint8_t         m_speechHeadLen = 0;
+    int32_t         m_resumeSkip = -1;              // frames to drop after an indexed jump, (-1) no indexed jump
+    uint32_t        m_resumeLeft = UINT32_MAX;      // m_gaplessLeft after an indexed jump
     int             m_LFcount = 0;                  // Detection of end of header
     uint32_t        m_sampleRate=16000;
     uint32_t        m_bitRate=0;                    // current bitrate given fom decoder
     uint32_t        m_avr_bitrate = 0;              // average bitrate, median computed by VBR
     int             m_readbytes = 0;                // bytes read
-    uint32_t        m_metacount = 0;                // counts down bytes between metadata
     int             m_controlCounter = 0;           // Status within readID3data() and readWaveHeader()
     int8_t          m_balance = 0;                  // -16 (mute left) ... +16 (mute right)
     uint16_t        m_vol = 21;                     // volume
@@ -538,6 +648,7 @@ private:
 	//uint32_t        m_byteCounter = 0;              // count received data
     uint32_t        m_contentlength = 0;            // Stores the length if the stream comes from fileserver
     uint32_t        m_bytesNotDecoded = 0;          // pictures or something else that comes with the stream
+    uint32_t        m_passDone = 0;                 // bytes at the InBuff readpointer that already have the gain
     uint32_t        m_PlayingStartTime = 0;         // Stores the milliseconds after the start of the audio
     int32_t         m_resumeFilePos = -1;           // the return value from stopSong() can be entered here, (-1) is idle
     uint16_t        m_m3u8_targetDuration = 10;     //
@@ -556,12 +667,18 @@ private:
     bool            m_f_tts = false;                // text to speech
     bool            m_f_loop = false;               // Set if audio file should loop
     bool            m_f_forceMono = false;          // if true stereo -> mono
+    bool            m_f_passthrough = false;        // the last block went from InBuff directly to the DMA buffers
+    bool            m_f_bufAdaptive = false;        // InBuff is resized in loop()
     bool            m_f_internalDAC = false;        // false: output vis I2S, true output via internal DAC
     bool            m_f_rtsp = false;               // set if RTSP is used (m3u8 stream)
     bool            m_f_m3u8data = false;           // used in processM3U8entries
     bool            m_f_Log = false;                // set in platformio.ini  -DAUDIO_LOG and -DCORE_DEBUG_LEVEL=3 or 4
     bool            m_f_continue = false;           // next m3u8 chunk is available
     bool            m_f_ts = true;                  // transport stream
+    bool            m_f_hlsPrefetch = false;        // setHLSPrefetch()
+    bool            m_f_hlsQueue = false;           // the current m3u8 segment comes from m_hls, not from _client
+    bool            m_f_hlsNext = false;            // waiting for the next segment of m_hls
+    bool            m_f_speechHead = false;         // the first bytes of a sentence from m_hls, ID3 tag?
     bool            m_f_m4aID3dataAreRead = false;  // has the m4a-ID3data already been read?
     bool            m_f_psramFound = false;         // set in constructor, result of psramInit()
     bool            m_f_timeout = false;            //
@@ -570,8 +687,6 @@ private:
     float           m_audioCurrentTime = 0;
     uint32_t        m_audioDataStart = 0;           // in bytes
     size_t          m_audioDataSize = 0;            //
-    float           m_filterBuff[3][2][2][2];       // IIR filters memory for Audio DSP
-    float           m_corr = 1.0;					// correction factor for level adjustment
     size_t          m_i2s_bytesWritten = 0;         // set in i2s_write() but not used
     size_t          m_file_size = 0;                // size of the file
     uint16_t        m_filterFrequency[2];
@@ -75,6 +75,7 @@ const uint8_t  postSkip[2]          = {15, 1};
 const uint16_t nfftTab[2]           = {64, 512};
 const uint8_t  nfftlog2Tab[2]       = {6, 9};
 const uint8_t  cos4sin4tabOffset[2] = {0, 128};
+const uint8_t  HUFF_SPEC_LUT_BITS   = 8;             /* first-level lookup for spectral codewords up to 8 bits */
 
 PSInfoBase_t        *m_PSInfoBase;
 AACDecInfo_t        *m_AACDecInfo;
@@ -85,6 +86,7 @@ ProgConfigElement_t *m_pce[16];
 PulseInfo_t          m_pulseInfo[2]; // [MAX_NCHANS_ELEM]
 aac_BitStreamInfo_t  m_aac_BitStreamInfo;
 PSInfoSBR_t         *m_PSInfoSBR;
+int32_t             *m_huffTabSpecLUT;  /* [11][1 << HUFF_SPEC_LUT_BITS], (symbol << 8) | codeword length, 0 = longer code */
 
 //----------------------------------------------------------------------------------------------------------------------
 inline int MULSHIFT32(int x, int y){
@@ -1684,8 +1686,12 @@ bool AACDecoder_AllocateBuffers(void){
     if(!m_AACDecInfo) {m_AACDecInfo = (AACDecInfo_t*)        __malloc_heap_psram(sizeof(AACDecInfo_t));}
     if(!m_PSInfoBase) {m_PSInfoBase = (PSInfoBase_t*)        __malloc_heap_psram(sizeof(PSInfoBase_t));}
     if(!m_pce[0])     {m_pce[0]     = (ProgConfigElement_t*) __malloc_heap_psram(sizeof(ProgConfigElement_t)*16);}
+    if(!m_huffTabSpecLUT) {
+        m_huffTabSpecLUT = (int32_t*)__malloc_heap_psram(sizeof(int32_t) * 11 * (1 << HUFF_SPEC_LUT_BITS));
+        if(m_huffTabSpecLUT) InitHuffTabSpecLUT();
+    }
 
-    if(!m_AACDecInfo || !m_PSInfoBase || !m_pce[0]) {
+    if(!m_AACDecInfo || !m_PSInfoBase || !m_pce[0] || !m_huffTabSpecLUT) {
             log_e("not enough memory to allocate aacdecoder buffers");
             AACDecoder_FreeBuffers();
             return false;
@@ -1773,6 +1779,7 @@ void AACDecoder_FreeBuffers(void) {
     if(m_AACDecInfo)                         {free(m_AACDecInfo);    m_AACDecInfo=NULL;}
     if(m_PSInfoBase)                         {free(m_PSInfoBase);    m_PSInfoBase=NULL;}
     if(m_pce[0])                             {free(m_pce[0]);        m_pce[0]=NULL;}
+    if(m_huffTabSpecLUT)                     {free(m_huffTabSpecLUT); m_huffTabSpecLUT=NULL;}
 
 #ifdef AAC_ENABLE_SBR
     if(m_PSInfoSBR)                           {free(m_PSInfoSBR);    m_PSInfoSBR=NULL;}               //Clear AACDecInfo
@@ -1794,7 +1801,7 @@ void AACDecoder_FreeBuffers(void) {
 
  **********************************************************************************************************************/
 bool AACDecoder_IsInit(void) {
-    if(m_AACDecInfo && m_PSInfoBase && m_pce[0]){
+    if(m_AACDecInfo && m_PSInfoBase && m_pce[0] && m_huffTabSpecLUT){
         return true;
     }
     return false;
@@ -3287,7 +3294,7 @@ void UnpackQuads(int cb, int nVals, int *coef)
     while (nVals > 0) {
         /* decode quad */
         bitBuf = GetBitsNoAdvance(maxBits) << (32 - maxBits);
-        nCodeBits = DecodeHuffmanScalar(huffTabSpec, &huffTabSpecInfo[cb - HUFFTAB_SPEC_OFFSET], bitBuf, &val);
+        nCodeBits = DecodeHuffmanSpec(cb, bitBuf, &val);
 
         w = (((int32_t)(val) << 20) >>   29);    /* bits 11-9, sign-extend */
         x = (((int32_t)(val) << 23) >>   29);    /* bits  8-6, sign-extend */
@@ -3334,7 +3341,7 @@ void UnpackPairsNoEsc(int cb, int nVals, int *coef)
     while (nVals > 0) {
         /* decode pair */
         bitBuf = GetBitsNoAdvance(maxBits) << (32 - maxBits);
-        nCodeBits = DecodeHuffmanScalar(huffTabSpec, &huffTabSpecInfo[cb-HUFFTAB_SPEC_OFFSET], bitBuf, &val);
+        nCodeBits = DecodeHuffmanSpec(cb, bitBuf, &val);
 
         y = (((int32_t)(val) << 22) >>   27);    /* bits  9-5, sign-extend */
         z = (((int32_t)(val) << 27) >>   27);    /* bits  4-0, sign-extend */
@@ -3376,7 +3383,7 @@ void UnpackPairsEsc(int cb, int nVals, int *coef)
     while (nVals > 0) {
         /* decode pair with escape value */
         bitBuf = GetBitsNoAdvance(maxBits) << (32 - maxBits);
-        nCodeBits = DecodeHuffmanScalar(huffTabSpec, &huffTabSpecInfo[cb-HUFFTAB_SPEC_OFFSET], bitBuf, &val);
+        nCodeBits = DecodeHuffmanSpec(cb, bitBuf, &val);
 
         y = (((int32_t)(val) << 20) >>   26);    /* bits 11-6, sign-extend */
         z = (((int32_t)(val) << 26) >>   26);    /* bits  5-0, sign-extend */
@@ -3386,15 +3393,11 @@ void UnpackPairsEsc(int cb, int nVals, int *coef)
         AdvanceBitstream(nCodeBits + nSignBits);
 
         if (y == 16) {
-            n = 4;
-            while (GetBits(1) == 1)
-                n++;
+            n = DecodeEscapePrefix();
             y = (1 << n) + GetBits(n);
         }
         if (z == 16) {
-            n = 4;
-            while (GetBits(1) == 1)
-                n++;
+            n = DecodeEscapePrefix();
             z = (1 << n) + GetBits(n);
         }
 
@@ -3408,6 +3411,35 @@ void UnpackPairsEsc(int cb, int nVals, int *coef)
     }
 }
 
+/***********************************************************************************************************************
+ * Function:    DecodeEscapePrefix
+ *
+ * Description: decode the escape_prefix (unary code of 1's terminated by a 0) of an escape sequence
+ *
+ * Inputs:      none
+ *
+ * Outputs:     updated bitstream info struct
+ *
+ * Return:      number of bits in the escape_word, 4 + number of 1's
+ *
+ * Notes:       a valid prefix has at most 8 1's (escape_word <= 13 bits), reads them with one CLZ instead of
+ *                bit by bit, falls back to the bitwise loop for corrupt streams
+ **********************************************************************************************************************/
+int DecodeEscapePrefix()
+{
+    int n, ones;
+
+    ones = CLZ(~(GetBitsNoAdvance(9) << 23));
+    if (ones <= 8) {
+        AdvanceBitstream(ones + 1);
+        return 4 + ones;
+    }
+    n = 4;
+    while (GetBits(1) == 1)
+        n++;
+    return n;
+}
+
 /***********************************************************************************************************************
  * Function:    DecodeSpectrumLong
  *
@@ -4514,6 +4546,75 @@ int DecodeHuffmanScalar(const signed short *huffTab, const HuffInfo_t *huffTabIn
     return (countPtr - huffTabInfo->count);
 }
 
+/***********************************************************************************************************************
+ * Function:    InitHuffTabSpecLUT
+ *
+ * Description: build the first-level lookup tables for the spectral Huffman codebooks 1...11
+ *
+ * Inputs:      none
+ *
+ * Outputs:     m_huffTabSpecLUT, one table of (1 << HUFF_SPEC_LUT_BITS) entries per codebook
+ *
+ * Return:      none
+ *
+ * Notes:       walks the canonical codes exactly like DecodeHuffmanScalar(), every codeword with
+ *                length <= HUFF_SPEC_LUT_BITS fills all entries that start with it
+ *              entries of longer codewords stay 0 and are decoded with DecodeHuffmanScalar()
+ **********************************************************************************************************************/
+void InitHuffTabSpecLUT()
+{
+    int cb, len, k, i, nFill;
+    uint32_t start, count;
+    const HuffInfo_t *hi;
+    const signed short *map;
+    int32_t *lut;
+
+    memset(m_huffTabSpecLUT, 0, sizeof(int32_t) * 11 * (1 << HUFF_SPEC_LUT_BITS));
+    for (cb = 0; cb < 11; cb++) {
+        hi = &huffTabSpecInfo[cb];
+        map = huffTabSpec + hi->offset;
+        lut = m_huffTabSpecLUT + (cb << HUFF_SPEC_LUT_BITS);
+        start = 0;
+        count = 0;
+        for (len = 1; len <= HUFF_SPEC_LUT_BITS; len++) {
+            start += count;
+            start <<= 1;
+            map += count;
+            count = hi->count[len - 1];
+            nFill = 1 << (HUFF_SPEC_LUT_BITS - len);
+            for (k = 0; k < (int)count; k++) {
+                for (i = 0; i < nFill; i++)
+                    lut[((start + k) << (HUFF_SPEC_LUT_BITS - len)) + i] = ((int32_t)map[k] << 8) | len;
+            }
+        }
+    }
+}
+
+/***********************************************************************************************************************
+ * Function:    DecodeHuffmanSpec
+ *
+ * Description: decode one spectral Huffman symbol from bitstream
+ *
+ * Inputs:      index of Huffman codebook (1...11)
+ *              left-aligned bit buffer with >= huffTabSpecInfo[cb - 1].maxBits bits
+ *
+ * Outputs:     decoded symbol in *val
+ *
+ * Return:      number of bits in symbol
+ *
+ * Notes:       same result as DecodeHuffmanScalar(), short codewords need only one table lookup
+ **********************************************************************************************************************/
+int DecodeHuffmanSpec(int cb, uint32_t bitBuf, int32_t *val)
+{
+    int32_t e = m_huffTabSpecLUT[((cb - HUFFTAB_SPEC_OFFSET) << HUFF_SPEC_LUT_BITS) + (bitBuf >> (32 - HUFF_SPEC_LUT_BITS))];
+
+    if (e & 0xff) {
+        *val = e >> 8;
+        return e & 0xff;
+    }
+    return DecodeHuffmanScalar(huffTabSpec, &huffTabSpecInfo[cb - HUFFTAB_SPEC_OFFSET], bitBuf, val);
+}
+
 /***********************************************************************************************************************
 * Function:    UnpackADTSHeader
 *
@@ -488,6 +488,9 @@ void DecodeGainControlInfo(int winSequence, GainControlInfo_t *gi);
 void DecodeICS(int ch);
 int DecodeNoiselessData(uint8_t **buf, int *bitOffset, int *bitsAvail, int ch);
 int DecodeHuffmanScalar(const signed short *huffTab, const HuffInfo_t *huffTabInfo, uint32_t bitBuf, int32_t *val);
+void InitHuffTabSpecLUT();
+int DecodeHuffmanSpec(int cb, uint32_t bitBuf, int32_t *val);
+int DecodeEscapePrefix();
 int UnpackADTSHeader(uint8_t **buf, int *bitOffset, int *bitsAvail);
 int GetADTSChannelMapping(uint8_t *buf, int bitOffset, int bitsAvail);
 int GetNumChannelsADIF(int nPCE);
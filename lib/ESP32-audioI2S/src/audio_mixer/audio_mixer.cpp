@@ -0,0 +1,353 @@
+/*
+ * audio_mixer.cpp
+ * fixed point multi stream mixer with per stream gain ramps and music ducking
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "audio_mixer.h"
+
+// prefer PSRAM
+#define __malloc_heap_psram(size) \
+    heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT|MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT|MALLOC_CAP_INTERNAL)
+
+static const uint32_t MIX_NO_REQUEST = 0xFFFFFFFF;
+
+//----------------------------------------------------------------------------------------------------------------------
+static inline int16_t sat16(int32_t v) {
+    if(v > 32767) return 32767;
+    if(v < -32768) return -32768;
+    return v;
+}
+//----------------------------------------------------------------------------------------------------------------------
+AudioMixer::AudioMixer() {
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        m_stream[i].state = MIX_FREE;
+        m_stream[i].head = 0;
+        m_stream[i].tail = 0;
+        m_stream[i].gainReq = MIX_NO_REQUEST;
+        m_stream[i].queue = NULL;
+        m_stream[i].external = false;
+    }
+    m_duckHold = false;
+    setDucking(-12, m_attackMs, m_releaseMs);
+}
+AudioMixer::~AudioMixer() {
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        if(m_stream[i].queue && !m_stream[i].external) {free(m_stream[i].queue); m_stream[i].queue = NULL;}
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioMixer::openStream(uint8_t type, uint32_t sampleRate, uint8_t channels, uint16_t queueMs) {
+
+    if(type > MIX_VOICE || (channels != 1 && channels != 2)) return -1;
+    if(sampleRate < 4000 || sampleRate > 96000) return -1;
+
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        mix_stream_t* s = &m_stream[i];
+        uint8_t expected = MIX_FREE;
+        if(!s->state.compare_exchange_strong(expected, MIX_ALLOC)) continue; // the slot is ours now
+
+        uint32_t size = 256; // power of two, the positions are masked
+        while(size < (uint64_t)sampleRate * queueMs / 1000 && size < (1 << 16)) size <<= 1;
+        s->queue = (int16_t*)__malloc_heap_psram(size * channels * sizeof(int16_t));
+        if(!s->queue) {
+            log_e("oom");
+            s->state.store(MIX_FREE);
+            return -1;
+        }
+        s->external = false;
+        s->type = type;
+        s->channels = channels;
+        s->rate = sampleRate;
+        s->mask = size - 1;
+        s->step = 1 << 16;
+        s->stepRate = 0;              // the step is computed by the consumer, it owns m_outRate
+        s->frac = 1 << 16;            // the first output frame pulls the first input frame
+        s->x0[0] = s->x0[1] = 0;
+        s->x1[0] = s->x1[1] = 0;
+        s->gain = MIX_UNITY;
+        s->gainTarget = MIX_UNITY;
+        s->gainStep = 0;
+        s->rampLeft = 0;
+        s->head.store(0);
+        s->tail.store(0);
+        s->gainReq.store(MIX_NO_REQUEST);
+        s->state.store(MIX_OPEN, std::memory_order_release);
+        return i;
+    }
+    return -1; // all streams in use
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioMixer::streamSpace(int8_t id) {
+    if(id < 0 || id >= MIX_MAX_STREAMS) return 0;
+    mix_stream_t* s = &m_stream[id];
+    if(s->state.load(std::memory_order_acquire) != MIX_OPEN) return 0;
+    return s->mask + 1 - (s->head.load(std::memory_order_relaxed) - s->tail.load(std::memory_order_acquire));
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioMixer::writeStream(int8_t id, const int16_t* pcm, uint32_t frames) {
+
+    uint32_t space = streamSpace(id);
+    if(!space) return 0;
+    mix_stream_t* s = &m_stream[id];
+    if(frames > space) frames = space;
+
+    uint32_t head = s->head.load(std::memory_order_relaxed);
+    uint32_t pos = head & s->mask;
+    uint32_t n = min(frames, s->mask + 1 - pos); // up to the end of the ring
+    memcpy(s->queue + pos * s->channels, pcm, n * s->channels * sizeof(int16_t));
+    if(frames > n) memcpy(s->queue, pcm + n * s->channels, (frames - n) * s->channels * sizeof(int16_t));
+    s->head.store(head + frames, std::memory_order_release);
+    return frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::endStream(int8_t id) {
+    if(id < 0 || id >= MIX_MAX_STREAMS) return;
+    uint8_t expected = MIX_OPEN;
+    m_stream[id].state.compare_exchange_strong(expected, MIX_END);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioMixer::playBuffer(uint8_t type, const int16_t* pcm, uint32_t frames, uint32_t sampleRate, uint8_t channels, float gain) {
+    // the whole clip is the queue: head is at its end, the stream is ended from the start and closes when drained
+
+    if(!pcm || !frames || type > MIX_VOICE || (channels != 1 && channels != 2)) return -1;
+    if(sampleRate < 4000 || sampleRate > 96000) return -1;
+    if(gain < 0) gain = 0;
+    if(gain > 2.0f) gain = 2.0f;
+
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        mix_stream_t* s = &m_stream[i];
+        uint8_t expected = MIX_FREE;
+        if(!s->state.compare_exchange_strong(expected, MIX_ALLOC)) continue;
+
+        s->queue = (int16_t*)pcm;     // only read
+        s->external = true;
+        s->type = type;
+        s->channels = channels;
+        s->rate = sampleRate;
+        s->mask = 0xFFFFFFFF;         // the positions never wrap
+        s->step = 1 << 16;
+        s->stepRate = 0;
+        s->frac = 1 << 16;
+        s->x0[0] = s->x0[1] = 0;
+        s->x1[0] = s->x1[1] = 0;
+        s->gain = (int32_t)(gain * MIX_UNITY);
+        s->gainTarget = s->gain;
+        s->gainStep = 0;
+        s->rampLeft = 0;
+        s->head.store(frames);
+        s->tail.store(0);
+        s->gainReq.store(MIX_NO_REQUEST);
+        s->state.store(MIX_END, std::memory_order_release);
+        return i;
+    }
+    return -1; // all streams in use
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioMixer::isPlaying(const int16_t* pcm) {
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        mix_stream_t* s = &m_stream[i];
+        if(s->state.load(std::memory_order_acquire) != MIX_FREE && s->queue == pcm) return true;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::stopStream(int8_t id) {
+    if(id < 0 || id >= MIX_MAX_STREAMS) return;
+    uint8_t expected = MIX_OPEN;
+    if(m_stream[id].state.compare_exchange_strong(expected, MIX_STOP)) return;
+    expected = MIX_END;
+    m_stream[id].state.compare_exchange_strong(expected, MIX_STOP);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::setStreamGain(int8_t id, float gain, uint16_t rampMs) {
+    // the consumer takes the request at the start of the next block, gain and ramp travel in one atomic word
+    if(id < 0 || id >= MIX_MAX_STREAMS) return;
+    if(gain < 0) gain = 0;
+    if(gain > 2.0f) gain = 2.0f;
+    uint32_t q14 = (uint32_t)(gain * 16384 + 0.5f);
+    m_stream[id].gainReq.store((q14 << 16) | rampMs, std::memory_order_release);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::setDucking(int8_t duckDB, uint16_t attackMs, uint16_t releaseMs) {
+    if(duckDB > 0) duckDB = 0;
+    if(duckDB < -60) duckDB = -60;
+    m_duckLevel = (int32_t)(powf(10, duckDB / 20.0f) * MIX_UNITY);
+    m_attackMs = max(attackMs, (uint16_t)1);
+    m_releaseMs = max(releaseMs, (uint16_t)1);
+    computeDuckSteps();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::computeDuckSteps() {
+    // linear ramps of the music gain, per output frame
+    m_duckDown = max((int32_t)1, (int32_t)((int64_t)(MIX_UNITY - m_duckLevel) * 1000 / ((int64_t)m_attackMs * m_outRate)));
+    m_duckUp = max((int32_t)1, (int32_t)((int64_t)(MIX_UNITY - m_duckLevel) * 1000 / ((int64_t)m_releaseMs * m_outRate)));
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::holdDucking(bool hold) {
+    m_duckHold = hold;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::setSampleRate(uint32_t outRate) {
+    if(outRate < 4000 || outRate == m_outRate) return;
+    m_outRate = outRate; // the streams recompute their step in mix()
+    computeDuckSteps();
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioMixer::isActive() {
+    if(m_duck != MIX_UNITY || m_duckHold) return true;
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        if(m_stream[i].state.load(std::memory_order_acquire) >= MIX_OPEN) return true;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::startRamp(mix_stream_t* s, int32_t target, uint32_t ms) {
+    uint32_t frames = ms * m_outRate / 1000;
+    s->gainTarget = target;
+    if(!frames) {
+        s->gain = target;
+        s->rampLeft = 0;
+        return;
+    }
+    s->gainStep = (target - s->gain) / (int32_t)frames;
+    s->rampLeft = frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::closeStream(mix_stream_t* s) {
+    if(s->queue && !s->external) free(s->queue);
+    s->queue = NULL;
+    s->state.store(MIX_FREE, std::memory_order_release);
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t AudioMixer::addStream(mix_stream_t* s, int32_t* acc, uint16_t frames, uint8_t channels) {
+    // adds up to 'frames' output frames of stream s to acc, returns the number of frames before the queue ran dry
+
+    const int16_t* q = s->queue;
+    const uint32_t mask = s->mask;
+    const uint8_t  sch = s->channels;
+    uint32_t tail = s->tail.load(std::memory_order_relaxed);
+    uint32_t avail = s->head.load(std::memory_order_acquire) - tail;
+    int32_t  l, r;
+    uint16_t n;
+
+    if(s->step != (1 << 16) || s->frac != (1 << 16)) { // resample, linear interpolation between x0 and x1
+        for(n = 0; n < frames; n++) {
+            while(s->frac >= (1 << 16)) {
+                if(!avail) goto done;
+                const int16_t* x = q + (tail & mask) * sch;
+                s->x0[0] = s->x1[0];
+                s->x0[1] = s->x1[1];
+                s->x1[0] = x[0];
+                s->x1[1] = x[sch - 1];
+                tail++;
+                avail--;
+                s->frac -= (1 << 16);
+            }
+            int32_t f = s->frac >> 1; // Q15, (x1 - x0) * f stays in int32
+            l = s->x0[0] + (((s->x1[0] - s->x0[0]) * f) >> 15);
+            r = s->x0[1] + (((s->x1[1] - s->x0[1]) * f) >> 15);
+            s->frac += s->step;
+
+            if(s->rampLeft) {
+                s->gain += s->gainStep;
+                if(--s->rampLeft == 0) s->gain = s->gainTarget;
+            }
+            int32_t g = s->gain >> (MIX_GAIN_SHIFT - 15);
+            if(channels == 2) {
+                acc[2 * n]     += (l * g) >> 15;
+                acc[2 * n + 1] += (r * g) >> 15;
+            }
+            else acc[n] += (((l + r) >> 1) * g) >> 15;
+        }
+    }
+    else { // same rate, x1 keeps the last frame for a later change of the output rate
+        for(n = 0; n < frames && avail; n++, avail--) {
+            const int16_t* x = q + (tail++ & mask) * sch;
+            l = x[0];
+            r = x[sch - 1];
+            if(s->rampLeft) {
+                s->gain += s->gainStep;
+                if(--s->rampLeft == 0) s->gain = s->gainTarget;
+            }
+            int32_t g = s->gain >> (MIX_GAIN_SHIFT - 15);
+            if(channels == 2) {
+                acc[2 * n]     += (l * g) >> 15;
+                acc[2 * n + 1] += (r * g) >> 15;
+            }
+            else acc[n] += (((l + r) >> 1) * g) >> 15;
+        }
+        if(n) { s->x1[0] = l; s->x1[1] = r; }
+    }
+done:
+    s->tail.store(tail, std::memory_order_release);
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMixer::mix(int16_t* buff, uint16_t frames, uint8_t channels) {
+
+    if(channels != 1 && channels != 2) return;
+
+    bool    voice = m_duckHold;
+    uint8_t streams = 0;                 // bit mask of the streams that take part
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        mix_stream_t* s = &m_stream[i];
+        uint8_t st = s->state.load(std::memory_order_acquire);
+        if(st < MIX_OPEN) continue;
+        streams |= (1 << i);
+        if(st != MIX_STOP && s->type == MIX_VOICE) voice = true;
+
+        if(s->stepRate != m_outRate) {
+            s->step = ((uint64_t)s->rate << 16) / m_outRate;
+            s->stepRate = m_outRate;
+        }
+        if(st == MIX_STOP) {
+            if(s->gainTarget != 0) startRamp(s, 0, MIX_STOP_RAMP_MS);
+            continue;
+        }
+        uint32_t req = s->gainReq.exchange(MIX_NO_REQUEST, std::memory_order_acquire);
+        if(req != MIX_NO_REQUEST) startRamp(s, (int32_t)(req >> 16) << (MIX_GAIN_SHIFT - 14), req & 0xFFFF);
+    }
+    const int32_t duckTarget = voice ? m_duckLevel : MIX_UNITY;
+    if(!streams && m_duck == duckTarget && m_duck == MIX_UNITY) return; // nothing to do, the music passes unchanged
+
+    int32_t acc[MIX_CHUNK_FRAMES * 2];
+
+    while(frames) {
+        uint16_t n = min(frames, (uint16_t)MIX_CHUNK_FRAMES);
+        uint16_t ns = n * channels;
+
+        // music, ducked
+        if(m_duck == duckTarget && m_duck == MIX_UNITY) {
+            for(int i = 0; i < ns; i++) acc[i] = buff[i];
+        }
+        else {
+            for(int i = 0; i < ns; i += channels) {
+                if(m_duck > duckTarget)      { m_duck -= m_duckDown; if(m_duck < duckTarget) m_duck = duckTarget; }
+                else if(m_duck < duckTarget) { m_duck += m_duckUp;   if(m_duck > duckTarget) m_duck = duckTarget; }
+                int32_t g = m_duck >> (MIX_GAIN_SHIFT - 15);
+                acc[i] = (buff[i] * g) >> 15;
+                if(channels == 2) acc[i + 1] = (buff[i + 1] * g) >> 15;
+            }
+        }
+
+        // prompts and effects
+        for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+            if(streams & (1 << i)) addStream(&m_stream[i], acc, n, channels);
+        }
+
+        for(int i = 0; i < ns; i++) buff[i] = sat16(acc[i]);
+        buff += ns;
+        frames -= n;
+    }
+
+    // close drained and faded out streams, the queue memory is released in the consumer task
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) {
+        if(!(streams & (1 << i))) continue;
+        mix_stream_t* s = &m_stream[i];
+        uint8_t st = s->state.load(std::memory_order_acquire);
+        if(st == MIX_END && s->head.load(std::memory_order_acquire) == s->tail.load(std::memory_order_relaxed)) closeStream(s);
+        if(st == MIX_STOP && s->gain == 0 && !s->rampLeft) closeStream(s);
+    }
+}
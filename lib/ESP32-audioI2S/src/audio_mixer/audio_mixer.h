@@ -0,0 +1,86 @@
+/*
+ * audio_mixer.h
+ * adds prompts and effects to the decoded music, every stream is fed by its own task through a lock free SPSC queue
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  producer (any task): openStream() -> writeStream() ... -> endStream()
+ *                       or playBuffer(): a complete clip, played from the caller's memory
+ *  consumer (audio task): mix() adds all streams to the music block, the music is ducked while a voice stream is open
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+#include <atomic>
+
+#define MIX_MAX_STREAMS   4
+#define MIX_CHUNK_FRAMES  128      // frames per int32 accumulator block
+#define MIX_GAIN_SHIFT    23       // gains are Q23, 1.0 = 1 << 23
+#define MIX_UNITY         (1 << MIX_GAIN_SHIFT)
+#define MIX_STOP_RAMP_MS  5        // stopStream() fades out instead of cutting
+
+enum : uint8_t {MIX_EFFECT = 0, MIX_VOICE = 1};                                   // stream types, MIX_VOICE ducks the music
+enum : uint8_t {MIX_FREE = 0, MIX_ALLOC = 1, MIX_OPEN = 2, MIX_END = 3, MIX_STOP = 4}; // stream states
+
+class AudioMixer {
+
+public:
+    AudioMixer();
+    ~AudioMixer();
+    // producer side, any task, one producer per stream
+    int8_t   openStream(uint8_t type, uint32_t sampleRate, uint8_t channels, uint16_t queueMs = 200); // returns id or -1
+    uint32_t writeStream(int8_t id, const int16_t* pcm, uint32_t frames); // interleaved, returns the accepted frames
+    uint32_t streamSpace(int8_t id);                                     // free frames in the queue
+    void     endStream(int8_t id);                                       // play what is queued, then close
+    int8_t   playBuffer(uint8_t type, const int16_t* pcm, uint32_t frames, uint32_t sampleRate, uint8_t channels,
+                        float gain = 1.0);                               // no copy, pcm must stay valid while isPlaying()
+    bool     isPlaying(const int16_t* pcm);                              // a stream still reads from pcm
+    void     stopStream(int8_t id);                                      // fade out and close
+    void     setStreamGain(int8_t id, float gain, uint16_t rampMs = 20); // 0.0 ... 2.0
+    void     setDucking(int8_t duckDB, uint16_t attackMs = 30, uint16_t releaseMs = 300);
+    void     holdDucking(bool hold);                                     // duck without a voice stream, e.g. wake word
+    // consumer side, audio task
+    void     setSampleRate(uint32_t outRate);                            // I2S rate
+    bool     isActive();                                                 // a stream is open or the music is not at full level
+    void     mix(int16_t* buff, uint16_t frames, uint8_t channels);      // interleaved, in place
+
+protected:
+    typedef struct _mix_stream{
+        std::atomic<uint8_t>  state;
+        std::atomic<uint32_t> head;        // frames written, producer
+        std::atomic<uint32_t> tail;        // frames read, consumer
+        std::atomic<uint32_t> gainReq;     // gain Q14 << 16 | ramp ms, 0xFFFFFFFF: no request
+        uint8_t  type;
+        uint8_t  channels;
+        uint32_t rate;
+        int16_t* queue;
+        bool     external;                 // playBuffer(): the queue is not ours, it is not freed
+        uint32_t mask;                     // queue size in frames - 1
+        uint32_t step;                     // Q16 input frames per output frame
+        uint32_t stepRate;                 // output rate the step belongs to
+        uint32_t frac;                     // Q16 position between x0 and x1
+        int16_t  x0[2];
+        int16_t  x1[2];
+        int32_t  gain;                     // Q23
+        int32_t  gainTarget;
+        int32_t  gainStep;
+        uint32_t rampLeft;                 // frames
+    } mix_stream_t;
+
+    void     computeDuckSteps();
+    void     startRamp(mix_stream_t* s, int32_t target, uint32_t ms);
+    void     closeStream(mix_stream_t* s);
+    uint16_t addStream(mix_stream_t* s, int32_t* acc, uint16_t frames, uint8_t channels);
+
+    mix_stream_t          m_stream[MIX_MAX_STREAMS];
+    uint32_t              m_outRate = 44100;
+    int32_t               m_duckLevel = MIX_UNITY / 4;  // -12dB
+    uint16_t              m_attackMs = 30;
+    uint16_t              m_releaseMs = 300;
+    int32_t               m_duck = MIX_UNITY;           // current music gain, Q23
+    int32_t               m_duckDown = 0;               // per frame
+    int32_t               m_duckUp = 0;
+    std::atomic<bool>     m_duckHold;
+};
@@ -0,0 +1,250 @@
+/*
+ * biquad_eq.cpp
+ * N-band equaliser, cascaded biquads in transposed direct form II
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "biquad_eq.h"
+
+static const float EQ_FLAT[5] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f}; // a0, a1, a2, b1, b2
+
+//----------------------------------------------------------------------------------------------------------------------
+BiquadEQ::BiquadEQ() {
+    for(int i = 0; i < EQ_MAX_BANDS; i++) {
+        memset(&m_band[i], 0, sizeof(eq_band_t));
+        memcpy(&m_band[i].cur, EQ_FLAT, sizeof(eq_coef_t));
+        memcpy(&m_band[i].target, EQ_FLAT, sizeof(eq_coef_t));
+        m_band[i].Q = 0.707f;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::setSampleRate(uint32_t sampleRate) {
+    // the history is cleared by the caller, therefore the new coefficients are used immediately
+    if(sampleRate < 1000) return; // fuse
+    m_sampleRate = sampleRate;
+    for(int i = 0; i < EQ_MAX_BANDS; i++) {
+        eq_band_t* b = &m_band[i];
+        if(b->gainDB == 0) continue;
+        calculateCoefficients(b);
+        b->cur = b->target;
+        b->rampLeft = 0;
+    }
+    m_preamp = m_preampTarget;
+    m_preampRamp = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool BiquadEQ::setBand(uint8_t band, uint8_t type, float freq, float Q, float gainDB) {
+    if(band >= EQ_MAX_BANDS) return false;
+    if(type > EQ_HIGHSHELF) return false;
+    if(freq < 10) freq = 10;
+    if(Q < 0.1f) Q = 0.1f;
+    if(gainDB < -40) gainDB = -40; // -40dB -> Vin*0.01
+    if(gainDB > 12) gainDB = 12;   // +12dB -> Vin*4
+
+    eq_band_t* b = &m_band[band];
+    if(b->type == type && b->freq == freq && b->Q == Q && b->gainDB == gainDB) return true; // nothing to do
+    b->type = type;
+    b->freq = freq;
+    b->Q = Q;
+    b->gainDB = gainDB;
+    if(gainDB == 0) memcpy(&b->target, EQ_FLAT, sizeof(eq_coef_t));
+    else calculateCoefficients(b);
+    startRamp(b);
+    if(b->active) m_activeBands |= (1 << band);
+    updatePreamp();
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+float BiquadEQ::getBandGain(uint8_t band) {
+    if(band >= EQ_MAX_BANDS) return 0;
+    return m_band[band].gainDB;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::clear() {
+    for(int i = 0; i < EQ_MAX_BANDS; i++) {
+        eq_band_t* b = &m_band[i];
+        b->z1[0] = b->z1[1] = b->z2[0] = b->z2[1] = 0;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::calculateCoefficients(eq_band_t* b) {
+
+    float Fc = b->freq;
+    if(Fc > m_sampleRate / 2 - 100) Fc = m_sampleRate / 2 - 100; // sampling theorem, plus a reserve of 100Hz
+    float K = tanf((float)PI * Fc / (float)m_sampleRate);
+    float V = powf(10, fabsf(b->gainDB) / 20.0f);
+    float Q = b->Q;
+    float norm;
+    eq_coef_t* c = &b->target;
+
+    switch(b->type) {
+        case EQ_LOWSHELF:
+            if(b->gainDB >= 0) { // boost
+                norm = 1 / (1 + sqrtf(2) * K + K * K);
+                c->a0 = (1 + sqrtf(2 * V) * K + V * K * K) * norm;
+                c->a1 = 2 * (V * K * K - 1) * norm;
+                c->a2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
+                c->b1 = 2 * (K * K - 1) * norm;
+                c->b2 = (1 - sqrtf(2) * K + K * K) * norm;
+            }
+            else { // cut
+                norm = 1 / (1 + sqrtf(2 * V) * K + V * K * K);
+                c->a0 = (1 + sqrtf(2) * K + K * K) * norm;
+                c->a1 = 2 * (K * K - 1) * norm;
+                c->a2 = (1 - sqrtf(2) * K + K * K) * norm;
+                c->b1 = 2 * (V * K * K - 1) * norm;
+                c->b2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
+            }
+            break;
+        case EQ_PEAK:
+            if(b->gainDB >= 0) { // boost
+                norm = 1 / (1 + 1 / Q * K + K * K);
+                c->a0 = (1 + V / Q * K + K * K) * norm;
+                c->a1 = 2 * (K * K - 1) * norm;
+                c->a2 = (1 - V / Q * K + K * K) * norm;
+                c->b1 = c->a1;
+                c->b2 = (1 - 1 / Q * K + K * K) * norm;
+            }
+            else { // cut
+                norm = 1 / (1 + V / Q * K + K * K);
+                c->a0 = (1 + 1 / Q * K + K * K) * norm;
+                c->a1 = 2 * (K * K - 1) * norm;
+                c->a2 = (1 - 1 / Q * K + K * K) * norm;
+                c->b1 = c->a1;
+                c->b2 = (1 - V / Q * K + K * K) * norm;
+            }
+            break;
+        case EQ_HIGHSHELF:
+            if(b->gainDB >= 0) { // boost
+                norm = 1 / (1 + sqrtf(2) * K + K * K);
+                c->a0 = (V + sqrtf(2 * V) * K + K * K) * norm;
+                c->a1 = 2 * (K * K - V) * norm;
+                c->a2 = (V - sqrtf(2 * V) * K + K * K) * norm;
+                c->b1 = 2 * (K * K - 1) * norm;
+                c->b2 = (1 - sqrtf(2) * K + K * K) * norm;
+            }
+            else { // cut
+                norm = 1 / (V + sqrtf(2 * V) * K + K * K);
+                c->a0 = (1 + sqrtf(2) * K + K * K) * norm;
+                c->a1 = 2 * (K * K - 1) * norm;
+                c->a2 = (1 - sqrtf(2) * K + K * K) * norm;
+                c->b1 = 2 * (K * K - V) * norm;
+                c->b2 = (V - sqrtf(2 * V) * K + K * K) * norm;
+            }
+            break;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::startRamp(eq_band_t* b) {
+    // a jump of the coefficients while playing is audible as a click (zipper noise), so they are moved in small steps
+    if(!b->active) {                 // the band was flat, start from the identity
+        memcpy(&b->cur, EQ_FLAT, sizeof(eq_coef_t));
+        b->z1[0] = b->z1[1] = b->z2[0] = b->z2[1] = 0;
+        if(b->gainDB == 0) return;   // still flat
+    }
+    b->step.a0 = (b->target.a0 - b->cur.a0) / EQ_RAMP_CHUNKS;
+    b->step.a1 = (b->target.a1 - b->cur.a1) / EQ_RAMP_CHUNKS;
+    b->step.a2 = (b->target.a2 - b->cur.a2) / EQ_RAMP_CHUNKS;
+    b->step.b1 = (b->target.b1 - b->cur.b1) / EQ_RAMP_CHUNKS;
+    b->step.b2 = (b->target.b2 - b->cur.b2) / EQ_RAMP_CHUNKS;
+    b->rampLeft = EQ_RAMP_CHUNKS;
+    b->active = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::updatePreamp() {
+    // boosted bands would clip, the signal is attenuated by the highest boost before filtering
+    float db = 0;
+    for(int i = 0; i < EQ_MAX_BANDS; i++) db = max(db, m_band[i].gainDB);
+    m_preampTarget = powf(10, -db / 20);
+    if(m_preampTarget == m_preamp) return;
+    m_preampStep = (m_preampTarget - m_preamp) / EQ_RAMP_CHUNKS;
+    m_preampRamp = EQ_RAMP_CHUNKS;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::filterChunk(eq_band_t* b, float* x, uint16_t frames, uint8_t channels) {
+
+    const float a0 = b->cur.a0, a1 = b->cur.a1, a2 = b->cur.a2, b1 = b->cur.b1, b2 = b->cur.b2;
+
+    if(channels == 2) { // both channels in one pass, the state stays in registers
+        float zl1 = b->z1[0], zl2 = b->z2[0];
+        float zr1 = b->z1[1], zr2 = b->z2[1];
+        for(int i = 0; i < frames; i++) {
+            float xl = x[0];
+            float xr = x[1];
+            float yl = a0 * xl + zl1;
+            float yr = a0 * xr + zr1;
+            zl1 = a1 * xl - b1 * yl + zl2;
+            zr1 = a1 * xr - b1 * yr + zr2;
+            zl2 = a2 * xl - b2 * yl;
+            zr2 = a2 * xr - b2 * yr;
+            x[0] = yl;
+            x[1] = yr;
+            x += 2;
+        }
+        b->z1[0] = zl1; b->z2[0] = zl2;
+        b->z1[1] = zr1; b->z2[1] = zr2;
+    }
+    else {
+        float z1 = b->z1[0], z2 = b->z2[0];
+        for(int i = 0; i < frames; i++) {
+            float in = x[i];
+            float y = a0 * in + z1;
+            z1 = a1 * in - b1 * y + z2;
+            z2 = a2 * in - b2 * y;
+            x[i] = y;
+        }
+        b->z1[0] = z1; b->z2[0] = z2;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BiquadEQ::process(int16_t* buff, uint16_t frames, uint8_t channels) {
+
+    if(isFlat()) return; // nothing to do, the samples pass unchanged
+    if(channels != 1 && channels != 2) return;
+
+    float x[EQ_CHUNK_FRAMES * 2];
+
+    while(frames) {
+        uint16_t n = min(frames, (uint16_t)EQ_CHUNK_FRAMES);
+        uint16_t ns = n * channels;
+
+        if(m_preampRamp) {
+            m_preamp += m_preampStep;
+            if(--m_preampRamp == 0) m_preamp = m_preampTarget;
+        }
+        const float g = m_preamp;
+        for(int i = 0; i < ns; i++) x[i] = buff[i] * g;
+
+        uint16_t mask = m_activeBands;
+        for(int k = 0; mask; k++, mask >>= 1) {
+            if(!(mask & 1)) continue;
+            eq_band_t* b = &m_band[k];
+            if(b->rampLeft) {
+                b->cur.a0 += b->step.a0;
+                b->cur.a1 += b->step.a1;
+                b->cur.a2 += b->step.a2;
+                b->cur.b1 += b->step.b1;
+                b->cur.b2 += b->step.b2;
+                if(--b->rampLeft == 0) {
+                    b->cur = b->target;
+                    if(b->gainDB == 0) { // the band has become flat, skip it from now on
+                        b->active = false;
+                        m_activeBands &= ~(1 << k);
+                        b->z1[0] = b->z1[1] = b->z2[0] = b->z2[1] = 0;
+                    }
+                }
+            }
+            filterChunk(b, x, n, channels);
+        }
+
+        for(int i = 0; i < ns; i++) {
+            float v = x[i];
+            if(v > 32767.0f) v = 32767.0f;
+            if(v < -32768.0f) v = -32768.0f;
+            buff[i] = (int16_t)v;
+        }
+        buff += ns;
+        frames -= n;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * biquad_eq.h
+ * N-band equaliser, cascaded biquads in transposed direct form II, processes whole PCM blocks in place
+ * coefficients: https://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+
+#define EQ_MAX_BANDS    10
+#define EQ_CHUNK_FRAMES 32    // frames per float work block, coefficients are interpolated block by block
+#define EQ_RAMP_CHUNKS  8     // a coefficient change is spread over 8 * 32 frames (~5ms @48kHz)
+
+enum : uint8_t {EQ_LOWSHELF = 0, EQ_PEAK = 1, EQ_HIGHSHELF = 2};
+
+class BiquadEQ {
+
+public:
+    BiquadEQ();
+    void     setSampleRate(uint32_t sampleRate);   // recalculates all bands, no ramp
+    bool     setBand(uint8_t band, uint8_t type, float freq, float Q, float gainDB); // gain 0dB switches the band off
+    float    getBandGain(uint8_t band);
+    void     clear();                              // zero the filter history (stop, seek)
+    bool     isFlat() { return !m_activeBands && !m_preampRamp && m_preamp == 1.0f; }
+    void     process(int16_t* buff, uint16_t frames, uint8_t channels); // interleaved, in place
+
+protected:
+    typedef struct _eq_coef{
+        float a0;   // numerator
+        float a1;
+        float a2;
+        float b1;   // denominator, b0 = 1
+        float b2;
+    } eq_coef_t;
+
+    typedef struct _eq_band{
+        uint8_t   type;
+        float     freq;
+        float     Q;
+        float     gainDB;
+        eq_coef_t cur;       // used for filtering
+        eq_coef_t target;    // cur moves towards target in m_rampLeft steps
+        eq_coef_t step;
+        uint8_t   rampLeft;
+        bool      active;    // false: flat and settled, the band is skipped
+        float     z1[2];     // TDF-II state, left / right
+        float     z2[2];
+    } eq_band_t;
+
+    void     calculateCoefficients(eq_band_t* b);
+    void     startRamp(eq_band_t* b);
+    void     updatePreamp();
+    void     filterChunk(eq_band_t* b, float* x, uint16_t frames, uint8_t channels);
+
+    eq_band_t m_band[EQ_MAX_BANDS];
+    uint32_t  m_sampleRate = 44100;
+    uint16_t  m_activeBands = 0;      // bit mask
+    float     m_preamp = 1.0f;        // headroom for boosted bands, 1 / max boost
+    float     m_preampTarget = 1.0f;
+    float     m_preampStep = 0;
+    uint8_t   m_preampRamp = 0;
+};
@@ -0,0 +1,135 @@
+/*
+ * buffer_health.cpp
+ * input buffer telemetry, the size the buffer should have
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "buffer_health.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+AudioBufferHealth::AudioBufferHealth() {
+    clear();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioBufferHealth::clear() {
+    memset(m_stats, 0, sizeof(m_stats));
+    for(int i = 0; i < BH_SOURCES; i++) m_stats[i].minFill = UINT32_MAX;
+    begin(m_source);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioBufferHealth::begin(uint8_t source) {
+    // the statistics of the source are kept, the gap and the byte rate are measured again from the first data on
+    if(source < BH_SOURCES) m_source = source;
+    m_f_flowing = false;
+    m_f_primed = false;
+    m_f_starved = false;
+    m_f_rate = false;
+    m_f_measured = false;
+    m_lastAdapt = 0;
+    m_high = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioBufferHealth::resume(uint32_t now) {
+    // nobody waited for data while paused
+    m_lastRefill = now;
+    m_lastSample = now;
+    m_f_rate = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioBufferHealth::starved() {
+    if(m_f_primed) m_f_starved = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioBufferHealth::update(uint32_t bytesIn, uint32_t filled, uint32_t size, uint32_t blockSize, bool playing, uint32_t now) {
+    bh_stats_t* s = &m_stats[m_source];
+    m_filled = filled;
+    m_f_playing = playing;
+    if(size != m_size) { // resized
+        m_size = size;
+        m_high = filled;
+    }
+    if(bytesIn != m_lastIn) {
+        if(m_f_flowing) {
+            uint32_t gap = now - m_lastRefill;
+            uint8_t  bin = 0;
+            while(bin < BH_GAP_BINS - 1 && gap >= (1UL << bin)) bin++;
+            s->gap[bin]++;
+            s->refills++;
+            s->gapMean += ((float)gap - s->gapMean) / 8;
+            s->gapDev += (fabsf((float)gap - s->gapMean) - s->gapDev) / 8;
+            if(gap > s->gapPeak) s->gapPeak = gap;
+        }
+        if(m_f_starved) {
+            s->underruns++;
+            if(s->byteRate) s->drain = max(s->drain, (float)size * 1000 / s->byteRate); // the whole buffer was too small
+            m_high = filled;
+        }
+        s->bytes += bytesIn - m_lastIn;
+        m_lastIn = bytesIn;
+        m_lastRefill = now;
+        m_f_flowing = true;
+        m_f_starved = false;
+    }
+    else if(size - filled < size / 8) {
+        m_lastRefill = now; // (almost) full, nobody waits for data
+    }
+    if(filled >= 4 * blockSize) m_f_primed = true;
+    if(filled > m_high) m_high = filled;
+    if(playing && s->byteRate) {
+        float drain = (float)(m_high - filled) * 1000 / s->byteRate;
+        if(drain > s->drain) s->drain = drain;
+    }
+    if(playing && size && now - m_lastSample >= BH_SAMPLE_MS) {
+        m_lastSample = now;
+        uint32_t bin = (uint64_t)filled * BH_FILL_BINS / size;
+        if(bin >= BH_FILL_BINS) bin = BH_FILL_BINS - 1;
+        s->fill[bin]++;
+        if(filled < s->minFill) s->minFill = filled;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioBufferHealth::adaptDue(uint32_t now) {
+    // the consumed byte rate is what came in minus what the fill level grew since the last call
+    if(m_lastAdapt && now - m_lastAdapt < BH_ADAPT_MS) return false;
+    bh_stats_t* s = &m_stats[m_source];
+    uint32_t    dt = m_lastAdapt ? now - m_lastAdapt : 0;
+    m_lastAdapt = now;
+    if(dt) { // half-life about three minutes
+        s->gapPeak -= s->gapPeak * dt / 256000.0f;
+        s->drain -= s->drain * dt / 256000.0f;
+    }
+    if(m_f_rate && m_f_playing && dt) {
+        int32_t consumed = (int32_t)(m_lastIn - m_rateIn) - (int32_t)(m_filled - m_rateFill);
+        if(consumed > 0) {
+            uint32_t rate = (uint64_t)consumed * 1000 / dt;
+            if(!m_f_measured) s->byteRate = rate; // the previous connection may have had another bitrate
+            else if(rate < 2 * s->byteRate) s->byteRate = (3 * s->byteRate + rate) / 4; // a jump empties the buffer
+            m_f_measured = true;
+        }
+    }
+    m_rateIn = m_lastIn;
+    m_rateFill = m_filled;
+    m_f_rate = m_f_playing;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioBufferHealth::targetSize(uint32_t blockSize, uint32_t byteRate) {
+    bh_stats_t* s = &m_stats[m_source];
+    if(m_f_measured || !byteRate) byteRate = s->byteRate; // the decoder knows the new connection better
+    if(!byteRate) return 0;
+    float gap = (m_source != BH_SD || !s->refills) ? BH_NET_MS : 0;
+    if(s->refills) gap = max(gap, max(s->gapPeak, s->gapMean + 4 * s->gapDev));
+    float cover = max(gap, s->drain) * 1.5f + BH_MARGIN_MS; // ms
+    return (uint32_t)(byteRate * cover / 1000) + 4 * blockSize;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioBufferHealth::adaptSize(uint32_t size, uint32_t filled, uint32_t blockSize, uint32_t byteRate, uint32_t maxSize) {
+    // grows at once and shrinks when the target is less than half, there is room for 25% more
+    uint32_t target = targetSize(blockSize, byteRate);
+    if(!target) return 0; // bitrate not yet known
+    target = constrain(target + target / 4, max((uint32_t)BH_MIN_SIZE, 4 * blockSize), maxSize);
+    if(target > size) return target;
+    if(target < size / 2 && filled + blockSize < target) return target;
+    return 0;
+}
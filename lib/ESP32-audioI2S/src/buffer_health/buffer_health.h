@@ -0,0 +1,82 @@
+/*
+ * buffer_health.h
+ * fill level, refill latency and underruns of the input buffer, per source, and the buffer size that follows from them
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  update() is called once per loop with the bytes written into the buffer so far. A refill is a loop in which bytes
+ *  arrived, the refill gap is the time since the previous one (only while the buffer had room). An underrun is counted
+ *  when the decoder found less than one block and data arrived afterwards, so the end of a file is not an underrun;
+ *  before the fill level reached four blocks once, it is the start threshold and not the size.
+ *  The drain is the largest drop of the fill level below its high-water mark, in ms at the consumed byte rate; after
+ *  an underrun it is at least the whole buffer. The peak gap and the drain decay with a half-life of about three
+ *  minutes. targetSize() = rate * max(drain, peak gap, mean gap + 4 deviations, BH_NET_MS for web sources) * 1.5 +
+ *  BH_MARGIN_MS + 4 blocks; a network stalls now and then even if it has not done so yet.
+ *  The statistics are kept per source, a new connection starts with what the previous ones of the same kind have shown.
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+
+#define BH_FILL_BINS      10         // 0...10%, 10...20% ... 90...100% of the buffer
+#define BH_GAP_BINS       12         // refill gap < 1, 2, 4, 8 ... 1024 ms, >= 1024 ms
+#define BH_SAMPLE_MS      100        // fill level sample interval
+#define BH_ADAPT_MS       1000       // targetSize() is looked at every second
+#define BH_MARGIN_MS      250
+#define BH_NET_MS         2000       // least gap assumed for HTTP and HLS, and for a source without refills
+#define BH_MIN_SIZE       8192
+#define BH_INTERNAL_MAX   32768      // larger buffers go to PSRAM
+#define BH_INTERNAL_KEEP  65536      // internal RAM that must remain free (WiFi, TLS)
+
+enum : uint8_t {BH_SD = 0, BH_HTTP = 1, BH_HLS = 2, BH_SOURCES = 3};
+
+typedef struct _bh_stats{
+    uint32_t fill[BH_FILL_BINS];    // one count per BH_SAMPLE_MS while playing
+    uint32_t gap[BH_GAP_BINS];      // refill gaps
+    uint32_t refills;
+    uint32_t underruns;
+    uint32_t bytes;                 // written into the buffer
+    uint32_t minFill;               // lowest fill level in bytes while playing
+    uint32_t byteRate;              // consumed by the decoder, bytes/s
+    float    gapMean;               // ms, moving average
+    float    gapDev;                // ms, mean absolute deviation
+    float    gapPeak;               // ms, decaying maximum
+    float    drain;                 // ms, decaying maximum
+} bh_stats_t;
+
+class AudioBufferHealth {
+
+public:
+    AudioBufferHealth();
+    void     clear();                                                   // all sources
+    void     begin(uint8_t source);                                     // new connection
+    void     update(uint32_t bytesIn, uint32_t filled, uint32_t size, uint32_t blockSize, bool playing, uint32_t now);
+    void     resume(uint32_t now);                                      // after a pause
+    void     starved();                                                 // the decoder found less than one block
+    uint32_t targetSize(uint32_t blockSize, uint32_t byteRate);         // byteRate of the decoder until one is measured
+    uint32_t adaptSize(uint32_t size, uint32_t filled, uint32_t blockSize, uint32_t byteRate, uint32_t maxSize); // 0: keep
+    bool     adaptDue(uint32_t now);                                    // true once per BH_ADAPT_MS
+    uint8_t  getSource() { return m_source; }
+    const bh_stats_t* getStats(uint8_t source) { return source < BH_SOURCES ? &m_stats[source] : NULL; }
+
+protected:
+    bh_stats_t m_stats[BH_SOURCES];
+    uint8_t    m_source = BH_SD;
+    bool       m_f_flowing = false;     // data arrived since begin()
+    bool       m_f_primed = false;      // four blocks were in the buffer
+    bool       m_f_starved = false;
+    bool       m_f_playing = false;
+    bool       m_f_rate = false;        // m_rateIn and m_rateFill are valid
+    bool       m_f_measured = false;    // byteRate of this connection
+    uint32_t   m_lastIn = 0;
+    uint32_t   m_lastRefill = 0;
+    uint32_t   m_lastSample = 0;
+    uint32_t   m_lastAdapt = 0;
+    uint32_t   m_rateIn = 0;            // bytesIn and fill level at the last adaptDue()
+    uint32_t   m_rateFill = 0;
+    uint32_t   m_filled = 0;
+    uint32_t   m_size = 0;
+    uint32_t   m_high = 0;              // high-water mark of the fill level
+};
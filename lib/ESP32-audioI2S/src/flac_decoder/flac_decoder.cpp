@@ -10,13 +10,14 @@
  *
  */
 #include "flac_decoder.h"
+#include "../ogg_demuxer/ogg_demuxer.h"
 #include "vector"
 using namespace std;
 
 FLACFrameHeader_t*   FLACFrameHeader;
 FLACMetadataBlock_t* FLACMetadataBlock;
 
-vector<uint16_t> s_flacSegmTableVec;
+ogg_page_t       s_flacOggPage;
 vector<int32_t>  coefs;
 vector<uint32_t> s_flacBlockPicItem;
 uint64_t         s_flac_bitBuffer = 0;
@@ -103,7 +104,7 @@ void FLACDecoder_ClearBuffer(){
         }
     }
 
-    s_flacSegmTableVec.clear(); s_flacSegmTableVec.shrink_to_fit();
+    OGG_clearPage(&s_flacOggPage);
     s_flacStatus = DECODE_FRAME;
     return;
 }
@@ -121,13 +122,13 @@ void FLACDecoder_FreeBuffers(){
         free(s_samplesBuffer); s_samplesBuffer = NULL;
     }
     coefs.clear(); coefs.shrink_to_fit();
-    s_flacSegmTableVec.clear(); s_flacSegmTableVec.shrink_to_fit();
+    OGG_clearPage(&s_flacOggPage);
     s_flacBlockPicItem.clear(); s_flacBlockPicItem.shrink_to_fit();
 }
 //----------------------------------------------------------------------------------------------------------------------
 void FLACDecoder_setDefaults(){
     coefs.clear(); coefs.shrink_to_fit();
-    s_flacSegmTableVec.clear(); s_flacSegmTableVec.shrink_to_fit();
+    OGG_clearPage(&s_flacOggPage);
     s_flacBlockPicItem.clear(); s_flacBlockPicItem.shrink_to_fit();
     s_flac_bitBuffer = 0;
     s_flacBitrate = 0;
@@ -161,15 +162,40 @@ const uint32_t mask[] = {0x00000000, 0x00000001, 0x00000003, 0x00000007, 0x00000
                          0x001fffff, 0x003fffff, 0x007fffff, 0x00ffffff, 0x01ffffff, 0x03ffffff, 0x07ffffff,
                          0x0fffffff, 0x1fffffff, 0x3fffffff, 0x7fffffff, 0xffffffff};
 
-uint32_t readUint(uint8_t nBits, int *bytesLeft){
-    while (s_flacBitBufferLen < nBits){
+// The bit buffer is a 64-bit accumulator, the lowest s_flacBitBufferLen bits are valid. Refills load as many whole
+// bytes as fit, but never more than *bytesLeft, so an ogg segment or the end of the input is not overrun.
+// *bytesLeft is decremented when a byte enters the accumulator, unconsumed bytes are given back by flacGiveBackBytes()
+
+static inline void flacFillBitBuffer(int* bytesLeft){
+    while(s_flacBitBufferLen <= 56 && *bytesLeft > 0){
+        s_flac_bitBuffer = (s_flac_bitBuffer << 8) | *(s_flacInptr + s_rIndex);
+        s_rIndex++;
+        (*bytesLeft)--;
+        s_flacBitBufferLen += 8;
+    }
+}
+
+static void flacFillBitBufferSlow(uint8_t nBits, int* bytesLeft){
+    flacFillBitBuffer(bytesLeft);
+    while(s_flacBitBufferLen < nBits){ // input exhausted
         uint8_t temp = *(s_flacInptr + s_rIndex);
         s_rIndex++;
         (*bytesLeft)--;
-        if(*bytesLeft < 0) { log_i("error in bitreader"); vTaskDelay(100);}
+        log_i("error in bitreader"); vTaskDelay(100);
         s_flac_bitBuffer = (s_flac_bitBuffer << 8) | temp;
         s_flacBitBufferLen += 8;
     }
+}
+
+static void flacGiveBackBytes(int* bytesLeft){ // return the whole bytes that are cached but not consumed
+    uint8_t n = s_flacBitBufferLen / 8;
+    s_rIndex -= n;
+    *bytesLeft += n;
+    s_flacBitBufferLen -= n * 8;
+}
+
+uint32_t readUint(uint8_t nBits, int *bytesLeft){
+    if(s_flacBitBufferLen < nBits) flacFillBitBufferSlow(nBits, bytesLeft);
     s_flacBitBufferLen -= nBits;
     uint32_t result = s_flac_bitBuffer >> s_flacBitBufferLen;
     if (nBits < 32)
@@ -183,12 +209,64 @@ int32_t readSignedInt(int nBits, int* bytesLeft){
     return temp;
 }
 
+static inline uint32_t readUnary(int* bytesLeft){ // count the zeros up to the next '1' bit and consume them all
+    uint32_t val = 0;
+    while(true){
+        if(s_flacBitBufferLen == 0) flacFillBitBufferSlow(1, bytesLeft);
+        uint64_t bits = s_flac_bitBuffer << (64 - s_flacBitBufferLen); // left aligned, invalid bits are zero
+        if(bits){
+            uint8_t zeros = __builtin_clzll(bits);
+            s_flacBitBufferLen -= zeros + 1;
+            return val + zeros;
+        }
+        val += s_flacBitBufferLen;
+        s_flacBitBufferLen = 0;
+    }
+}
+
 int64_t readRiceSignedInt(uint8_t param, int* bytesLeft){
-    long val = 0;
-    while (readUint(1, bytesLeft) == 0)
-        val++;
+    uint32_t val = readUnary(bytesLeft);
     val = (val << param) | readUint(param, bytesLeft);
-    return (val >> 1) ^ -(val & 1);
+    return (int32_t)((val >> 1) ^ -(val & 1));
+}
+
+static void readRicePartition(int32_t* out, int count, uint8_t param, int* bytesLeft){
+    // bulk version of readRiceSignedInt(), the accumulator is held in locals for the whole partition
+    uint64_t       bitBuffer = s_flac_bitBuffer;
+    uint8_t        bitBufferLen = s_flacBitBufferLen;
+    const uint8_t* inptr = s_flacInptr + s_rIndex;
+    const uint8_t* inptrStart = inptr;
+    int            avail = *bytesLeft;
+
+    for(int i = 0; i < count; i++){
+        if(bitBufferLen <= 32){ // common case: refill at most once per value
+            while(bitBufferLen <= 56 && avail > 0){
+                bitBuffer = (bitBuffer << 8) | *inptr++;
+                avail--;
+                bitBufferLen += 8;
+            }
+        }
+        uint64_t bits = bitBufferLen ? bitBuffer << (64 - bitBufferLen) : 0;
+        uint32_t val;
+        if(bits && __builtin_clzll(bits) + 1 + param <= bitBufferLen){ // unary part and remainder are both cached
+            uint8_t zeros = __builtin_clzll(bits);
+            bitBufferLen -= zeros + 1 + param;
+            val = (zeros << param) | (param ? (uint32_t)(bitBuffer >> bitBufferLen) & mask[param] : 0);
+        }
+        else{ // long unary code or input exhausted, take the generic path
+            s_flac_bitBuffer = bitBuffer; s_flacBitBufferLen = bitBufferLen;
+            s_rIndex += inptr - inptrStart; *bytesLeft = avail;
+            val = readUnary(bytesLeft);
+            val = (val << param) | readUint(param, bytesLeft);
+            bitBuffer = s_flac_bitBuffer; bitBufferLen = s_flacBitBufferLen;
+            inptr = inptrStart = s_flacInptr + s_rIndex; avail = *bytesLeft;
+        }
+        out[i] = (int32_t)((val >> 1) ^ -(val & 1));
+    }
+    s_flac_bitBuffer = bitBuffer;
+    s_flacBitBufferLen = bitBufferLen;
+    s_rIndex += inptr - inptrStart;
+    *bytesLeft = avail;
 }
 
 void alignToByte() {
@@ -256,58 +334,16 @@ char* FLACgetStreamTitle(){
 int FLACparseOGG(uint8_t *inbuf, int *bytesLeft){  // reference https://www.xiph.org/ogg/doc/rfc3533.txt
 
     s_f_flacParseOgg = false;
-    int idx = FLAC_specialIndexOf(inbuf, "OggS", 6);
-    if(idx != 0) return ERR_FLAC_DECODER_ASYNC;
-
-    uint8_t  version            = *(inbuf +  4); (void) version;
-    uint8_t  headerType         = *(inbuf +  5); (void) headerType;
-    uint64_t granulePosition    = (uint64_t)*(inbuf + 13) << 56;  // granule_position: an 8 Byte field containing -
-             granulePosition   += (uint64_t)*(inbuf + 12) << 48;  // position information. For an audio stream, it MAY
-             granulePosition   += (uint64_t)*(inbuf + 11) << 40;  // contain the total number of PCM samples encoded
-             granulePosition   += (uint64_t)*(inbuf + 10) << 32;  // after including all frames finished on this page.
-             granulePosition   += *(inbuf +  9) << 24;  // This is a hint for the decoder and gives it some timing
-             granulePosition   += *(inbuf +  8) << 16;  // and position information. A special value of -1 (in two's
-             granulePosition   += *(inbuf +  7) << 8;   // complement) indicates that no packets finish on this page.
-             granulePosition   += *(inbuf +  6); (void) granulePosition;
-    uint32_t bitstreamSerialNr  = *(inbuf + 17) << 24;  // bitstream_serial_number: a 4 Byte field containing the
-             bitstreamSerialNr += *(inbuf + 16) << 16;  // unique serial number by which the logical bitstream
-             bitstreamSerialNr += *(inbuf + 15) << 8;   // is identified.
-             bitstreamSerialNr += *(inbuf + 14); (void) bitstreamSerialNr;
-    uint32_t pageSequenceNr     = *(inbuf + 21) << 24;  // page_sequence_number: a 4 Byte field containing the sequence
-             pageSequenceNr    += *(inbuf + 20) << 16;  // number of the page so the decoder can identify page loss
-             pageSequenceNr    += *(inbuf + 19) << 8;   // This sequence number is increasing on each logical bitstream
-             pageSequenceNr    += *(inbuf + 18); (void) pageSequenceNr;
-    uint32_t CRCchecksum        = *(inbuf + 25) << 24;
-             CRCchecksum       += *(inbuf + 24) << 16;
-             CRCchecksum       += *(inbuf + 23) << 8;
-             CRCchecksum       += *(inbuf + 22); (void) CRCchecksum;
-    uint8_t  pageSegments       = *(inbuf + 26);        // giving the number of segment entries
-
-    // read the segment table (contains pageSegments bytes),  1...251: Length of the frame in bytes,
-    // 255: A second byte is needed.  The total length is first_byte + second byte
-    s_flacSegmTableVec.clear();
-    s_flacSegmTableVec.shrink_to_fit();
-    for(int i = 0; i < pageSegments; i++){
-        int n = *(inbuf + 27 + i);
-        while(*(inbuf + 27 + i) == 255){
-            i++;
-            if(i == pageSegments) break;
-            n+= *(inbuf + 27 + i);
-        }
-        s_flacSegmTableVec.insert(s_flacSegmTableVec.begin(), n);
-    }
-    // for(int i = 0; i< s_flacSegmTableVec.size(); i++){log_i("%i", s_flacSegmTableVec[i]);}
+    ogg_page_t* page = &s_flacOggPage;
+    if(OGG_parsePage(inbuf, *bytesLeft, page) != OGG_PAGE_OK) return ERR_FLAC_DECODER_ASYNC;
 
-    bool     continuedPage = headerType & 0x01; // set: page contains data of a packet continued from the previous page
-    bool     firstPage     = headerType & 0x02; // set: this is the first page of a logical bitstream (bos)
-    bool     lastPage      = headerType & 0x04; // set: this is the last page of a logical bitstream (eos)
+    // FLACDecode() takes the packet lengths from the page (OGG_nextPacket), continued lacing is already resolved
 
-    (void)continuedPage; (void)lastPage;
+    bool     firstPage     = page->firstPage;     // set: this is the first page of a logical bitstream (bos)
+    uint16_t headerSize    = page->headerSize;
 
     if(firstPage) s_flacPageNr = 0;
 
-    uint16_t headerSize = pageSegments + 27;
-
     *bytesLeft -= headerSize;
     s_flacCurrentFilePos += headerSize;
     return ERR_FLAC_NONE; // no error
@@ -627,10 +663,9 @@ int8_t FLACDecode(uint8_t *inbuf, int *bytesLeft, short *outbuf){ //  MAIN LOOP
             else return ret;  // error
         }
         //-------------------------------------------------------
-        if(!s_flacSegmTableVec.size()) log_e("size is 0");
-        segmLen = s_flacSegmTableVec.back();
-        s_flacSegmTableVec.pop_back();
-        if(!s_flacSegmTableVec.size()) s_f_flacParseOgg = true;
+        if(!OGG_packetsLeft(&s_flacOggPage)) log_e("size is 0");
+        segmLen = OGG_nextPacket(&s_flacOggPage);
+        if(!OGG_packetsLeft(&s_flacOggPage)) s_f_flacParseOgg = true;
         //-------------------------------------------------------
 
         if(s_flacRemainBlockPicLen <= 0 && !s_f_flacNewMetadataBlockPicture) {
@@ -745,6 +780,7 @@ int8_t FLACDecodeNative(uint8_t *inbuf, int *bytesLeft, short *outbuf){
 
     alignToByte();
     readUint(16, bytesLeft);
+    flacGiveBackBytes(bytesLeft); // the refill may have cached the start of the next frame
 
 //    s_flacCompressionRatio = (float)m_bytesDecoded / (float)s_blockSize * FLACMetadataBlock->numChannels * (16/8);
 //    log_i("s_flacCompressionRatio % f", s_flacCompressionRatio);
@@ -824,6 +860,7 @@ int8_t flacDecodeFrame(uint8_t *inbuf, int *bytesLeft){
         readUint(16, bytesLeft);
     }
     readUint(8, bytesLeft);
+    flacGiveBackBytes(bytesLeft); // the caller may move the input buffer before the subframes are decoded
     s_flacStatus = DECODE_SUBFRAMES;
     s_blockSizeLeft = s_blockSize;
     return ERR_FLAC_NONE;
@@ -864,6 +901,12 @@ uint32_t FLACGetAudioFileDuration() {
 }
 //----------------------------------------------------------------------------------------------------------------------
 int8_t decodeSubframes(int* bytesLeft){
+    int8_t ret = decodeChannelSubframes(bytesLeft);
+    flacGiveBackBytes(bytesLeft); // the footer is read from the input later, after all samples are written out
+    return ret;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t decodeChannelSubframes(int* bytesLeft){
     if(FLACFrameHeader->chanAsgn <= 7) {
         for (int ch = 0; ch < FLACMetadataBlock->numChannels; ch++)
             decodeSubframe(FLACMetadataBlock->bitsPerSample, ch, bytesLeft);
@@ -947,13 +990,9 @@ int8_t decodeFixedPredictionSubframe(uint8_t predOrder, uint8_t sampleDepth, uin
         s_samplesBuffer[ch][i] = readSignedInt(sampleDepth, bytesLeft);
     ret = decodeResiduals(predOrder, ch, bytesLeft);
     if(ret) return ret;
-    coefs.clear();
-    if(predOrder == 0) coefs.resize(0);
-    if(predOrder == 1) coefs.push_back(1);  // FIXED_PREDICTION_COEFFICIENTS
-    if(predOrder == 2){coefs.push_back(2); coefs.push_back(-1);}
-    if(predOrder == 3){coefs.push_back(3); coefs.push_back(-3); coefs.push_back(1);}
-    if(predOrder == 4){coefs.push_back(4); coefs.push_back(-6); coefs.push_back(4); coefs.push_back(-1);}
+    static const int32_t fixedCoefs[5][4] = {{0}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}}; // FIXED_PREDICTION_COEFFICIENTS
     if(predOrder > 4) return ERR_FLAC_PREORDER_TOO_BIG; // Error: preorder > 4"
+    coefs.assign(fixedCoefs[predOrder], fixedCoefs[predOrder] + predOrder);
     restoreLinearPrediction(ch, 0);
     return ERR_FLAC_NONE;
 }
@@ -993,9 +1032,7 @@ int8_t decodeResiduals(uint8_t warmup, uint8_t ch, int* bytesLeft) {
 
         int param = readUint(paramBits, bytesLeft);
         if (param < escapeParam) {
-            for (int j = start; j < end; j++){
-                s_samplesBuffer[ch][j] = readRiceSignedInt(param, bytesLeft);
-            }
+            readRicePartition(s_samplesBuffer[ch] + start, end - start, param, bytesLeft);
         } else {
             int numBits = readUint(5, bytesLeft);
             for (int j = start; j < end; j++){
@@ -1006,14 +1043,48 @@ int8_t decodeResiduals(uint8_t warmup, uint8_t ch, int* bytesLeft) {
     return ERR_FLAC_NONE;
 }
 //----------------------------------------------------------------------------------------------------------------------
-void restoreLinearPrediction(uint8_t ch, uint8_t shift) {
+template <int ORDER>
+static void restoreLinearPredictionOrder(int32_t* samples, const int32_t* coefsIn, uint8_t shift) {
+    int32_t c[ORDER]; // local copy, the compiler unrolls the inner loop and keeps the coefficients in registers
+    for (int j = 0; j < ORDER; j++) c[j] = coefsIn[j];
 
-    for (int i = coefs.size(); i < s_blockSize; i++) {
+    for (int i = ORDER; i < s_blockSize; i++) {
         int32_t sum = 0;
-        for (int j = 0; j < coefs.size(); j++){
-            sum += s_samplesBuffer[ch][i - 1 - j] * coefs[j];
+        for (int j = 0; j < ORDER; j++){
+            sum += samples[i - 1 - j] * c[j];
         }
-        s_samplesBuffer[ch][i] += (sum >> shift);
+        samples[i] += (sum >> shift);
+    }
+}
+
+void restoreLinearPrediction(uint8_t ch, uint8_t shift) {
+
+    int32_t*       samples = s_samplesBuffer[ch];
+    const int32_t* c = coefs.data();
+
+    switch(coefs.size()){ // orders up to 12 are the ones used by the reference encoder presets
+        case 0:  break;
+        case 1:  restoreLinearPredictionOrder< 1>(samples, c, shift); break;
+        case 2:  restoreLinearPredictionOrder< 2>(samples, c, shift); break;
+        case 3:  restoreLinearPredictionOrder< 3>(samples, c, shift); break;
+        case 4:  restoreLinearPredictionOrder< 4>(samples, c, shift); break;
+        case 5:  restoreLinearPredictionOrder< 5>(samples, c, shift); break;
+        case 6:  restoreLinearPredictionOrder< 6>(samples, c, shift); break;
+        case 7:  restoreLinearPredictionOrder< 7>(samples, c, shift); break;
+        case 8:  restoreLinearPredictionOrder< 8>(samples, c, shift); break;
+        case 9:  restoreLinearPredictionOrder< 9>(samples, c, shift); break;
+        case 10: restoreLinearPredictionOrder<10>(samples, c, shift); break;
+        case 11: restoreLinearPredictionOrder<11>(samples, c, shift); break;
+        case 12: restoreLinearPredictionOrder<12>(samples, c, shift); break;
+        default:
+            for (int i = coefs.size(); i < s_blockSize; i++) {
+                int32_t sum = 0;
+                for (int j = 0; j < coefs.size(); j++){
+                    sum += samples[i - 1 - j] * c[j];
+                }
+                samples[i] += (sum >> shift);
+            }
+            break;
     }
 }
 //----------------------------------------------------------------------------------------------------------------------
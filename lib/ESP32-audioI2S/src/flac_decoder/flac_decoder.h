@@ -172,6 +172,7 @@ int32_t          readSignedInt(int nBits, int* bytesLeft);
 int64_t          readRiceSignedInt(uint8_t param, int* bytesLeft);
 void             alignToByte();
 int8_t           decodeSubframes(int* bytesLeft);
+int8_t           decodeChannelSubframes(int* bytesLeft);
 int8_t           decodeSubframe(uint8_t sampleDepth, uint8_t ch, int* bytesLeft);
 int8_t           decodeFixedPredictionSubframe(uint8_t predOrder, uint8_t sampleDepth, uint8_t ch, int* bytesLeft);
 int8_t           decodeLinearPredictiveCodingSubframe(int lpcOrder, int sampleDepth, uint8_t ch, int* bytesLeft);
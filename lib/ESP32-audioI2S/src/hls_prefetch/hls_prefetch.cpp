@@ -0,0 +1,502 @@
+/*
+ * hls_prefetch.cpp
+ * HLS media segments and playlist refreshes, loaded by a task of their own over keep-alive connections
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "hls_prefetch.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+AudioHLSPrefetch::AudioHLSPrefetch() {
+    m_mutex = xSemaphoreCreateMutex();
+    m_gen.store(0);
+    m_plState.store(HP_FREE);
+    for(int i = 0; i < HP_SLOTS; i++) {
+        m_slot[i].state.store(HP_FREE);
+        m_slot[i].loaded.store(0);
+        m_slot[i].url = NULL;
+        m_slot[i].body = NULL;
+        m_slot[i].length = 0;
+        m_slot[i].readPos = 0;
+        m_slot[i].order = 0;
+        m_slot[i].gen = 0;
+        m_slot[i].seq = 0;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+AudioHLSPrefetch::~AudioHLSPrefetch() {
+    if(m_task) vTaskDelete(m_task);
+    m_task = NULL;
+    for(int i = 0; i < HP_SLOTS; i++) {
+        if(m_slot[i].url) {free(m_slot[i].url); m_slot[i].url = NULL;}
+        if(m_slot[i].body) {free(m_slot[i].body); m_slot[i].body = NULL;}
+    }
+    if(m_plUrl) {free(m_plUrl); m_plUrl = NULL;}
+    if(m_plBody) {free(m_plBody); m_plBody = NULL;}
+    if(m_conn) {delete[] m_conn; m_conn = NULL;}
+    if(m_mutex) vSemaphoreDelete(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioHLSPrefetch::begin() {
+    if(m_task) return true;
+    if(!psramFound() || !m_mutex) return false; // the segments are too big for the internal RAM
+    m_conn = new hp_conn_t[HP_CONNECTIONS];
+    for(int i = 0; i < HP_CONNECTIONS; i++) {
+        m_conn[i].secure.setInsecure(); // as Audio does
+        m_conn[i].client = NULL;
+        m_conn[i].host[0] = '\0';
+        m_conn[i].port = 0;
+    }
+    if(xTaskCreatePinnedToCore(task, "hlsPrefetch", HP_STACK, this, HP_PRIO, &m_task, HP_CORE) != pdPASS) {
+        log_e("hlsPrefetch task could not be created");
+        delete[] m_conn;
+        m_conn = NULL;
+        m_task = NULL;
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHLSPrefetch::clear() {
+    // what is loading belongs to the task until it sees the new generation
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_gen++;
+    for(int i = 0; i < HP_SLOTS; i++) {
+        hp_slot_t* s = &m_slot[i];
+        if(s->state == HP_LOADING) continue;
+        if(s->url) {free(s->url); s->url = NULL;}
+        if(s->body) {free(s->body); s->body = NULL;}
+        s->state = HP_FREE;
+    }
+    if(m_plState != HP_LOADING) {
+        if(m_plUrl) {free(m_plUrl); m_plUrl = NULL;}
+        if(m_plBody) {free(m_plBody); m_plBody = NULL;}
+        m_plState = HP_FREE;
+    }
+    xSemaphoreGive(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioHLSPrefetch::requestPlaylist(const char* url) {
+    if(!m_task || !url) return false;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    if(m_plState == HP_QUEUED || m_plState == HP_LOADING) {xSemaphoreGive(m_mutex); return false;}
+    if(m_plUrl) free(m_plUrl);
+    if(m_plBody) {free(m_plBody); m_plBody = NULL;}
+    m_plUrl = strdup(url);
+    m_plLen = 0;
+    m_plGen = m_gen;
+    m_plState = HP_QUEUED;
+    xSemaphoreGive(m_mutex);
+    xTaskNotifyGive(m_task);
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+char* AudioHLSPrefetch::takePlaylist(uint32_t* len) {
+    if(m_plState != HP_DONE) return NULL;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    char* body = m_plBody;
+    if(len) *len = m_plLen;
+    m_plBody = NULL;
+    if(m_plUrl) {free(m_plUrl); m_plUrl = NULL;}
+    m_plState = HP_FREE;
+    xSemaphoreGive(m_mutex);
+    return body;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHLSPrefetch::dropPlaylist() {
+    if(m_plState != HP_FAILED) return;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    if(m_plUrl) {free(m_plUrl); m_plUrl = NULL;}
+    if(m_plBody) {free(m_plBody); m_plBody = NULL;}
+    m_plState = HP_FREE;
+    xSemaphoreGive(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioHLSPrefetch::push(const char* url, uint64_t seq) {
+    if(!m_task || !url) return false;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* s = NULL;
+    for(int i = 0; i < HP_SLOTS; i++) {
+        if(m_slot[i].state == HP_FREE) {s = &m_slot[i]; break;}
+    }
+    if(!s) {xSemaphoreGive(m_mutex); return false;}
+    s->url = strdup(url);
+    s->body = NULL;
+    s->length = 0;
+    s->readPos = 0;
+    s->loaded = 0;
+    s->order = m_order++;
+    s->gen = m_gen;
+    s->seq = seq;
+    s->state = HP_QUEUED;
+    xSemaphoreGive(m_mutex);
+    xTaskNotifyGive(m_task);
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+AudioHLSPrefetch::hp_slot_t* AudioHLSPrefetch::head() {
+    // the oldest segment of this generation, called with the mutex taken
+    hp_slot_t* h = NULL;
+    for(int i = 0; i < HP_SLOTS; i++) {
+        hp_slot_t* s = &m_slot[i];
+        if(s->state == HP_FREE || s->gen != m_gen) continue;
+        if(!h || (int32_t)(s->order - h->order) < 0) h = s;
+    }
+    return h;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t AudioHLSPrefetch::queued() {
+    uint8_t n = 0;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    for(int i = 0; i < HP_SLOTS; i++) {
+        if(m_slot[i].state != HP_FREE && m_slot[i].gen == m_gen) n++;
+    }
+    xSemaphoreGive(m_mutex);
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t AudioHLSPrefetch::headState() {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* h = head();
+    uint8_t    state = h ? h->state.load() : HP_FREE;
+    xSemaphoreGive(m_mutex);
+    return state;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioHLSPrefetch::headLength(uint32_t* len) {
+    // known with the header (Content-Length, the body is allocated) or when the body is complete (chunked)
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* h = head();
+    bool       known = h && (h->body || h->state == HP_DONE);
+    *len = known ? h->length : 0;
+    xSemaphoreGive(m_mutex);
+    return known;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t AudioHLSPrefetch::headSeq() {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* h = head();
+    uint64_t   seq = h ? h->seq : 0;
+    xSemaphoreGive(m_mutex);
+    return seq;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioHLSPrefetch::available() {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* h = head();
+    uint32_t   n = (h && h->body) ? h->loaded - h->readPos : 0;
+    xSemaphoreGive(m_mutex);
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioHLSPrefetch::read(uint8_t* buff, uint32_t len) {
+    // the task writes behind 'loaded', the reader stays in front of it
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* h = head();
+    uint32_t   n = 0;
+    if(h && h->body) {
+        n = h->loaded - h->readPos;
+        if(n > len) n = len;
+        memcpy(buff, h->body + h->readPos, n);
+        h->readPos += n;
+    }
+    xSemaphoreGive(m_mutex);
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHLSPrefetch::pop() {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    hp_slot_t* h = head();
+    if(h) {
+        if(h->state == HP_LOADING) h->gen = m_gen - 1; // the task drops it
+        else {
+            if(h->url) {free(h->url); h->url = NULL;}
+            if(h->body) {free(h->body); h->body = NULL;}
+            h->state = HP_FREE;
+        }
+    }
+    xSemaphoreGive(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHLSPrefetch::task(void* param) {
+    ((AudioHLSPrefetch*)param)->run();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHLSPrefetch::run() {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        while(true) { // playlist first, then the oldest segment
+            char*      url = NULL;
+            uint8_t    role = HP_SEGMENT;
+            uint32_t   gen = 0;
+            hp_slot_t* slot = NULL;
+            xSemaphoreTake(m_mutex, portMAX_DELAY);
+            if(m_plState == HP_QUEUED) {
+                url = strdup(m_plUrl);
+                role = HP_PLAYLIST;
+                gen = m_plGen;
+                m_plState = HP_LOADING;
+            }
+            else {
+                for(int i = 0; i < HP_SLOTS; i++) {
+                    hp_slot_t* s = &m_slot[i];
+                    if(s->state != HP_QUEUED || s->gen != m_gen) continue;
+                    if(!slot || (int32_t)(s->order - slot->order) < 0) slot = s;
+                }
+                if(slot) {
+                    url = strdup(slot->url);
+                    gen = slot->gen;
+                    slot->state = HP_LOADING;
+                }
+            }
+            xSemaphoreGive(m_mutex);
+            if(!url) break;
+
+            uint8_t* body = NULL;
+            uint32_t len = 0;
+            uint32_t t0 = millis();
+            bool     ok = fetch(role, url, gen, &body, &len, slot);
+
+            xSemaphoreTake(m_mutex, portMAX_DELAY);
+            if(role == HP_PLAYLIST) {
+                if(gen != m_gen) { // cleared meanwhile
+                    if(body) free(body);
+                    if(m_plUrl) {free(m_plUrl); m_plUrl = NULL;}
+                    m_plState = HP_FREE;
+                }
+                else if(ok) {
+                    m_plBody = (char*)body;
+                    m_plLen = len;
+                    m_plState = HP_DONE;
+                }
+                else {
+                    if(body) free(body);
+                    m_plState = HP_FAILED;
+                    log_w("playlist %s failed", url);
+                }
+            }
+            else {
+                if(slot->gen != m_gen) { // cleared or popped meanwhile
+                    if(body) free(body);
+                    slot->body = NULL;
+                    if(slot->url) {free(slot->url); slot->url = NULL;}
+                    slot->state = HP_FREE;
+                }
+                else if(ok) {
+                    slot->body = body;
+                    slot->length = len;
+                    slot->loaded = len;
+                    slot->state = HP_DONE;
+                    m_loadTime = millis() - t0;
+                }
+                else {
+                    if(!slot->body && body) free(body); // a known length stays readable up to where it broke
+                    slot->state = HP_FAILED;
+                    log_w("segment %s failed", url);
+                }
+            }
+            xSemaphoreGive(m_mutex);
+            free(url);
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioHLSPrefetch::openConn(hp_conn_t* c, bool ssl, const char* host, uint16_t port) {
+    WiFiClient* client = ssl ? (WiFiClient*)&c->secure : &c->plain;
+    if(c->client == client && c->port == port && !strcmp(c->host, host) && client->connected()) return true; // keep-alive
+    if(c->client) c->client->stop();
+    c->client = NULL;
+    if(!client->connect(host, port, HP_TIMEOUT_MS)) {
+        log_w("hlsPrefetch: can't connect to %s:%u", host, port);
+        return false;
+    }
+    c->client = client;
+    c->port = port;
+    strlcpy(c->host, host, sizeof(c->host));
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int AudioHLSPrefetch::readLine(WiFiClient* client, char* line, uint16_t size) {
+    // one header line without CR LF, -1 on timeout or a closed connection
+    uint16_t pos = 0;
+    uint32_t t = millis();
+    while(true) {
+        if(!client->available()) {
+            if(!client->connected() || millis() - t > HP_TIMEOUT_MS) return -1;
+            vTaskDelay(1);
+            continue;
+        }
+        int b = client->read();
+        if(b < 0) continue;
+        if(b == '\n') break;
+        if(b == '\r') continue;
+        if(pos < size - 1) line[pos++] = (char)b;
+    }
+    line[pos] = '\0';
+    return pos;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t AudioHLSPrefetch::readBody(WiFiClient* client, uint8_t* dst, uint32_t len, uint32_t gen, hp_slot_t* slot, uint32_t base) {
+    // len bytes, -1 if the connection broke or the generation changed
+    uint32_t got = 0;
+    uint32_t t = millis();
+    while(got < len) {
+        if(gen != m_gen || (slot && slot->gen != gen)) return -1;
+        int n = client->available();
+        if(n <= 0) {
+            if(!client->connected() || millis() - t > HP_TIMEOUT_MS) return -1;
+            vTaskDelay(2);
+            continue;
+        }
+        if((uint32_t)n > len - got) n = len - got;
+        if(n > 4096) n = 4096;
+        n = client->read(dst + got, n);
+        if(n <= 0) continue;
+        got += n;
+        t = millis();
+        if(slot) slot->loaded.store(base + got);
+    }
+    return got;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioHLSPrefetch::fetch(uint8_t role, const char* url, uint32_t gen, uint8_t** body, uint32_t* len, hp_slot_t* slot) {
+    hp_conn_t* c = &m_conn[role];
+    char       line[512];
+    char*      location = NULL;
+    bool       ok = false;
+
+    for(int redirect = 0; redirect < 2; redirect++) {
+        const char* u = location ? location : url;
+        bool        ssl = !strncasecmp(u, "https://", 8);
+        if(!ssl && strncasecmp(u, "http://", 7)) break;
+        const char* h = u + (ssl ? 8 : 7);
+        const char* path = strchr(h, '/');
+        char        host[128];
+        size_t      hlen = path ? (size_t)(path - h) : strlen(h);
+        if(hlen >= sizeof(host)) break;
+        memcpy(host, h, hlen);
+        host[hlen] = '\0';
+        uint16_t port = ssl ? 443 : 80;
+        char*    colon = strchr(host, ':');
+        if(colon) {*colon = '\0'; port = atoi(colon + 1);}
+        if(!path) path = "/";
+
+        if(!openConn(c, ssl, host, port)) break;
+        WiFiClient* client = c->client;
+        client->printf("GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 audioI2S\r\n"
+                       "Accept-Encoding: identity;q=1,*;q=0\r\nConnection: keep-alive\r\n\r\n", path, host);
+
+        if(readLine(client, line, sizeof(line)) < 12) { // the server closed the kept connection, once more
+            client->stop();
+            c->client = NULL;
+            if(!openConn(c, ssl, host, port)) break;
+            client = c->client;
+            client->printf("GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 audioI2S\r\n"
+                           "Accept-Encoding: identity;q=1,*;q=0\r\nConnection: keep-alive\r\n\r\n", path, host);
+            if(readLine(client, line, sizeof(line)) < 12) break;
+        }
+        int      status = atoi(line + 9);
+        int32_t  contentLength = -1;
+        bool     chunked = false;
+        bool     close = false;
+        char*    newLocation = NULL;
+        while(true) {
+            int n = readLine(client, line, sizeof(line));
+            if(n < 0) {status = 0; break;}
+            if(n == 0) break; // end of header
+            if(!strncasecmp(line, "content-length:", 15)) contentLength = atoi(line + 15);
+            else if(!strncasecmp(line, "transfer-encoding:", 18) && strcasestr(line + 18, "chunked")) chunked = true;
+            else if(!strncasecmp(line, "connection:", 11) && strcasestr(line + 11, "close")) close = true;
+            else if(!strncasecmp(line, "location:", 9)) {
+                const char* l = line + 9;
+                while(*l == ' ') l++;
+                if(newLocation) free(newLocation);
+                if(*l == '/') { // relative to the host
+                    newLocation = (char*)malloc(strlen(l) + strlen(host) + 16);
+                    if(newLocation) sprintf(newLocation, "%s://%s:%u%s", ssl ? "https" : "http", host, port, l);
+                }
+                else newLocation = strdup(l);
+            }
+        }
+        if(status == 301 || status == 302 || status == 307 || status == 308) {
+            client->stop(); // the body of the redirect is not wanted
+            c->client = NULL;
+            if(location) free(location);
+            location = newLocation;
+            if(!location) break;
+            continue;
+        }
+        if(newLocation) free(newLocation);
+        if(status != 200) {
+            log_w("hlsPrefetch: HTTP status %i", status);
+            client->stop();
+            c->client = NULL;
+            break;
+        }
+
+        uint8_t* buf = NULL;
+        uint32_t total = 0;
+        bool     complete = false;
+        if(!chunked && contentLength >= 0) { // readable while it loads
+            if((uint32_t)contentLength > HP_MAX_BODY) {client->stop(); c->client = NULL; break;}
+            buf = (uint8_t*)ps_malloc(contentLength + 1);
+            if(!buf) {client->stop(); c->client = NULL; break;}
+            if(slot) {
+                xSemaphoreTake(m_mutex, portMAX_DELAY);
+                slot->body = buf;
+                slot->length = contentLength;
+                xSemaphoreGive(m_mutex);
+            }
+            complete = readBody(client, buf, contentLength, gen, slot, 0) == contentLength;
+            total = contentLength;
+        }
+        else if(chunked) {
+            while(true) {
+                if(readLine(client, line, sizeof(line)) < 0) break;
+                uint32_t size = strtoul(line, NULL, 16);
+                if(size == 0) { // trailer
+                    while(readLine(client, line, sizeof(line)) > 0) {;}
+                    complete = true;
+                    break;
+                }
+                if(total + size > HP_MAX_BODY) break;
+                uint8_t* p = (uint8_t*)ps_realloc(buf, total + size + 1);
+                if(!p) break;
+                buf = p;
+                if(readBody(client, buf + total, size, gen, slot, 0) != (int32_t)size) break;
+                total += size;
+                readLine(client, line, sizeof(line)); // CR LF behind the chunk
+            }
+        }
+        else { // until the server closes
+            close = true;
+            uint32_t size = 0;
+            while(total < HP_MAX_BODY) {
+                if(total == size) {
+                    uint8_t* p = (uint8_t*)ps_realloc(buf, size + 16384 + 1);
+                    if(!p) break;
+                    buf = p;
+                    size += 16384;
+                }
+                if(gen != m_gen || (slot && slot->gen != gen)) break;
+                int n = client->available();
+                if(n <= 0) {
+                    if(!client->connected()) {complete = true; break;}
+                    vTaskDelay(2);
+                    continue;
+                }
+                n = client->read(buf + total, min((uint32_t)n, size - total));
+                if(n > 0) total += n;
+            }
+        }
+        if(!complete || close) {client->stop(); c->client = NULL;}
+        if(buf) buf[total] = '\0'; // a playlist is text
+        *body = buf;
+        *len = total;
+        ok = complete;
+        break;
+    }
+    if(location) free(location);
+    return ok;
+}
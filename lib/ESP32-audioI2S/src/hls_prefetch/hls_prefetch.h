@@ -0,0 +1,100 @@
+/*
+ * hls_prefetch.h
+ * HLS media segments and playlist refreshes, loaded by a task of their own over keep-alive connections
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  audio task: parsePlaylist_M3U8() stays where it is, the segment URLs go to push() in the order they are played.
+ *  The task loads them one after the other into HP_SLOTS bodies in PSRAM, so the next HP_SLOTS - 1 segments are
+ *  ready when the current one ends; read() takes the bytes of the first one while it is still loading. A playlist
+ *  refresh (requestPlaylist) goes before the segments and uses a connection of its own. Chunked bodies are joined,
+ *  a redirect (301, 302, 307, 308) is followed once. clear() drops everything, a body that is loading is dropped by
+ *  the task as soon as it sees it.
+ *  connecttospeech() uses the segment queue as well: the sentences behind the first one are pushed as plain GET
+ *  URLs, their bodies follow the first one in InBuff.
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <atomic>
+
+#define HP_SLOTS          3                 // the segment that is played and two more
+#define HP_MAX_BODY       (2 * 1024 * 1024) // a bigger segment is skipped
+#define HP_TIMEOUT_MS     4000              // connect, header, no data
+#define HP_REFRESH_MS     2000              // least time between two playlist requests
+#define HP_STACK          6144
+#define HP_PRIO           2
+#define HP_CORE           0                 // WiFi
+
+enum : uint8_t {HP_FREE = 0, HP_QUEUED = 1, HP_LOADING = 2, HP_DONE = 3, HP_FAILED = 4}; // slot and playlist states
+enum : uint8_t {HP_PLAYLIST = 0, HP_SEGMENT = 1, HP_CONNECTIONS = 2};
+
+class AudioHLSPrefetch {
+
+public:
+    AudioHLSPrefetch();
+    ~AudioHLSPrefetch();
+    bool     begin();                                       // starts the task once, true if it runs
+    void     clear();                                       // new stream or stop
+    // playlist
+    bool     requestPlaylist(const char* url);              // false: one is still loading
+    uint8_t  playlistState() { return m_plState; }
+    char*    takePlaylist(uint32_t* len);                   // HP_DONE: the body (0 terminated), free() it
+    void     dropPlaylist();                                // HP_FAILED
+    // segments
+    bool     push(const char* url, uint64_t seq);           // false: no free slot
+    uint8_t  queued();                                      // segments that are not yet played
+    uint8_t  headState();                                   // state of the next segment, HP_FREE: none
+    bool     headLength(uint32_t* len);                     // false: not yet known, a known length can be 0
+    uint64_t headSeq();
+    uint32_t available();                                   // bytes of the next segment that can be read
+    uint32_t read(uint8_t* buff, uint32_t len);
+    void     pop();                                         // the next segment is played (or failed)
+    uint32_t getLoadTime() { return m_loadTime; }           // ms of the last segment, header to the end
+
+protected:
+    typedef struct _hp_slot{
+        std::atomic<uint8_t>  state;
+        std::atomic<uint32_t> loaded;                       // written by the task
+        char*     url;
+        uint8_t*  body;
+        uint32_t  length;                                   // content length, valid with body or HP_DONE
+        uint32_t  readPos;
+        uint32_t  order;                                    // push() counter, the lowest is the head
+        uint32_t  gen;                                      // clear() counter at push()
+        uint64_t  seq;
+    } hp_slot_t;
+
+    typedef struct _hp_conn{
+        WiFiClient        plain;
+        WiFiClientSecure  secure;
+        WiFiClient*       client;
+        char              host[128];
+        uint16_t          port;
+    } hp_conn_t;
+
+    static void task(void* param);
+    void     run();
+    bool     fetch(uint8_t role, const char* url, uint32_t gen, uint8_t** body, uint32_t* len, hp_slot_t* slot);
+    bool     openConn(hp_conn_t* c, bool ssl, const char* host, uint16_t port);
+    int      readLine(WiFiClient* client, char* line, uint16_t size);
+    int32_t  readBody(WiFiClient* client, uint8_t* dst, uint32_t len, uint32_t gen, hp_slot_t* slot, uint32_t base);
+    hp_slot_t* head();
+
+    SemaphoreHandle_t     m_mutex = NULL;
+    TaskHandle_t          m_task = NULL;
+    hp_slot_t             m_slot[HP_SLOTS];
+    hp_conn_t*            m_conn = NULL;                    // HP_CONNECTIONS, in the task
+    std::atomic<uint32_t> m_gen;
+    uint32_t              m_order = 0;
+    char*                 m_plUrl = NULL;
+    char*                 m_plBody = NULL;
+    uint32_t              m_plLen = 0;
+    uint32_t              m_plGen = 0;
+    std::atomic<uint8_t>  m_plState;
+    uint32_t              m_loadTime = 0;
+};
@@ -0,0 +1,125 @@
+/*
+ * http_body.cpp
+ * body of a web stream response: chunked transfer coding and ICY metadata are taken out, the audio bytes remain
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "http_body.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+AudioHTTPBody::AudioHTTPBody() {
+    begin(false, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHTTPBody::begin(bool chunked, uint32_t metaint) {
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_f_chunked = chunked;
+    m_chunkState = HB_SIZE;
+    m_f_digits = false;
+    m_f_ext = false;
+    m_lineLen = 0;
+    m_chunkLeft = 0;
+    m_metaint = metaint;
+    m_icyState = HB_AUDIO;
+    m_audioLeft = metaint;
+    m_metaLen = 0;
+    m_metaPos = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioHTTPBody::decode(uint8_t* buff, uint32_t len) {
+    // the output never overtakes the input, so one buffer is enough
+    uint32_t in = 0;
+    uint32_t out = 0;
+    if(!m_f_chunked) {
+        body(buff, 0, len, &out);
+        return out;
+    }
+    while(in < len) {
+        if(m_chunkState == HB_DATA) {
+            uint32_t n = len - in;
+            if(n > m_chunkLeft) n = m_chunkLeft;
+            body(buff, in, n, &out);
+            in += n;
+            m_chunkLeft -= n;
+            if(!m_chunkLeft) m_chunkState = HB_SIZE; // CR LF behind the data is an empty size line
+            continue;
+        }
+        if(m_chunkState == HB_END) break;
+        uint8_t c = buff[in++]; // size and trailer lines, a few bytes per chunk
+        if(m_chunkState == HB_SIZE) {
+            if(c == '\n') {
+                if(m_f_digits) {
+                    m_stats.chunks++;
+                    m_chunkState = m_chunkLeft ? HB_DATA : HB_TRAILER;
+                    m_lineLen = 0;
+                }
+                m_f_digits = false;
+                m_f_ext = false;
+            }
+            else if(c == '\r' || m_f_ext) { ; }
+            else if(isxdigit(c)) {
+                if(!m_f_digits) m_chunkLeft = 0;
+                m_chunkLeft = (m_chunkLeft << 4) + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+                m_f_digits = true;
+            }
+            else m_f_ext = true; // ";name=value" or white space
+        }
+        else { // HB_TRAILER, up to an empty line
+            if(c == '\n') {
+                if(!m_lineLen) m_chunkState = HB_END;
+                m_lineLen = 0;
+            }
+            else if(c != '\r') m_lineLen++;
+        }
+    }
+    return out;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioHTTPBody::body(uint8_t* buff, uint32_t in, uint32_t len, uint32_t* out) {
+    m_stats.bodyBytes += len;
+    while(len) {
+        if(!m_metaint || m_icyState == HB_AUDIO) {
+            uint32_t n = len;
+            if(m_metaint && n > m_audioLeft) n = m_audioLeft;
+            if(*out != in) memmove(buff + *out, buff + in, n);
+            *out += n;
+            in += n;
+            len -= n;
+            m_stats.audioBytes += n;
+            if(m_metaint) {
+                m_audioLeft -= n;
+                if(!m_audioLeft) m_icyState = HB_METALEN;
+            }
+        }
+        else if(m_icyState == HB_METALEN) {
+            m_metaLen = buff[in++] * 16; // max 4080
+            m_metaPos = 0;
+            len--;
+            if(m_metaLen) m_icyState = HB_META;
+            else {
+                m_icyState = HB_AUDIO;
+                m_audioLeft = m_metaint;
+            }
+        }
+        else { // HB_META
+            uint32_t n = m_metaLen - m_metaPos;
+            if(n > len) n = len;
+            if(m_meta && m_metaLen < m_metaSize) memcpy(m_meta + m_metaPos, buff + in, n);
+            m_metaPos += n;
+            in += n;
+            len -= n;
+            if(m_metaPos < m_metaLen) continue;
+            if(m_meta && m_metaLen < m_metaSize) {
+                m_meta[m_metaLen] = '\0';
+                if(strlen(m_meta)) {
+                    m_stats.metaBlocks++;
+                    if(m_cb) m_cb(m_cbArg, m_meta, m_metaLen);
+                }
+            }
+            else m_stats.metaSkipped++;
+            m_icyState = HB_AUDIO;
+            m_audioLeft = m_metaint;
+        }
+    }
+}
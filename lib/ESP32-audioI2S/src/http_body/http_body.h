@@ -0,0 +1,60 @@
+/*
+ * http_body.h
+ * body of a web stream response: chunked transfer coding and ICY metadata are taken out, the audio bytes remain
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  decode() works in place on what was read from the socket into the input buffer in one piece: chunk size lines,
+ *  the CR LF behind each chunk and the metadata blocks (length byte * 16 bytes every metaint audio bytes) are cut
+ *  out, the audio bytes are moved to the front. Every byte is consumed, a size line or a metadata block may end in
+ *  the next call. A whole metadata block goes to the callback (0 terminated), a block that does not fit into the
+ *  metadata buffer is skipped. After the last chunk (size 0) and its trailer the rest is ignored.
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+
+enum : uint8_t {HB_SIZE = 0, HB_DATA = 1, HB_TRAILER = 2, HB_END = 3};   // chunk layer
+enum : uint8_t {HB_AUDIO = 0, HB_METALEN = 1, HB_META = 2};             // ICY layer
+
+typedef struct _hb_stats{
+    uint32_t bodyBytes;     // received, without the chunk framing
+    uint32_t audioBytes;
+    uint32_t chunks;
+    uint32_t metaBlocks;    // with text
+    uint32_t metaSkipped;   // too long for the metadata buffer
+} hb_stats_t;
+
+class AudioHTTPBody {
+
+public:
+    AudioHTTPBody();
+    void     begin(bool chunked, uint32_t metaint);                 // new response, metaint 0: no ICY metadata
+    uint32_t decode(uint8_t* buff, uint32_t len);                   // in place, returns the audio bytes at buff[0]
+    void     setMetadataBuffer(char* buff, uint16_t size) { m_meta = buff; m_metaSize = size; }
+    void     setMetadataCallback(void (*cb)(void* arg, char* meta, uint16_t len), void* arg) { m_cb = cb; m_cbArg = arg; }
+    bool     isEnd() { return m_chunkState == HB_END; }             // chunked: the last chunk was received
+    const hb_stats_t* getStats() { return &m_stats; }
+
+protected:
+    void     body(uint8_t* buff, uint32_t in, uint32_t len, uint32_t* out);
+
+    hb_stats_t m_stats;
+    bool       m_f_chunked = false;
+    uint8_t    m_chunkState = HB_SIZE;
+    bool       m_f_digits = false;      // size line: hex digits seen
+    bool       m_f_ext = false;         // size line: chunk extension, ignored up to LF
+    uint16_t   m_lineLen = 0;           // trailer line
+    uint32_t   m_chunkLeft = 0;
+    uint32_t   m_metaint = 0;
+    uint8_t    m_icyState = HB_AUDIO;
+    uint32_t   m_audioLeft = 0;         // until the next metadata block
+    uint16_t   m_metaLen = 0;
+    uint16_t   m_metaPos = 0;
+    char*      m_meta = NULL;
+    uint16_t   m_metaSize = 0;
+    void     (*m_cb)(void* arg, char* meta, uint16_t len) = NULL;
+    void*      m_cbArg = NULL;
+};
@@ -1304,6 +1304,90 @@ int MP3GetNextFrameInfo(unsigned char *buf) {
 
     return ERR_MP3_NONE;
 }
+/***********************************************************************************************************************
+ * Function:    MP3GetFrameSize
+ *
+ * Description: length of the frame that starts at buf, taken from the frame header only
+ *
+ * Inputs:      pointer to a frame header, at least 4 valid bytes
+ *              optional pointer for the number of samples per channel in this frame
+ *
+ * Outputs:     none
+ *
+ * Return:      frame length in bytes including the header, ERR_MP3_INVALID_FRAMEHEADER if buf is no layer 3 header
+ *              or the bitrate is free format
+ *
+ * Notes:       does not touch the decoder state, used to walk through a file without decoding (seek index)
+ **********************************************************************************************************************/
+int MP3GetFrameSize(const unsigned char *buf, int *samplesPerFrame) {
+
+    if ((buf[0] & m_SYNCWORDH) != m_SYNCWORDH || (buf[1] & m_SYNCWORDL) != m_SYNCWORDL) return ERR_MP3_INVALID_FRAMEHEADER;
+    int verIdx = (buf[1] >> 3) & 0x03;   // 0: MPEG2.5, 2: MPEG2, 3: MPEG1
+    int layer  = 4 - ((buf[1] >> 1) & 0x03);
+    int brIdx  = (buf[2] >> 4) & 0x0f;
+    int srIdx  = (buf[2] >> 2) & 0x03;
+    int pad    = (buf[2] >> 1) & 0x01;
+    if (verIdx == 1 || layer != 3 || srIdx == 3 || brIdx == 0 || brIdx == 15) return ERR_MP3_INVALID_FRAMEHEADER;
+
+    int ver = (verIdx == 3) ? MPEG1 : (verIdx == 2) ? MPEG2 : MPEG25;
+    int spf = samplesPerFrameTab[ver][layer - 1];
+    if (samplesPerFrame) *samplesPerFrame = spf;
+    return (spf / 8) * bitrateTab[ver][layer - 1][brIdx] * 1000 / samplerateTab[ver][srIdx] + pad;
+}
+/***********************************************************************************************************************
+ * Function:    MP3GetXingInfo
+ *
+ * Description: parse the first frame of a file, it can be a Xing/Info frame without audio data
+ *
+ * Inputs:      pointer to the first frame header (located using MP3FindSyncWord())
+ *              number of valid bytes in buf
+ *
+ * Outputs:     filled-in MP3XingInfo struct, encoder delay and padding only if there is a LAME tag
+ *
+ * Return:      0 if ok, ERR_MP3_INVALID_FRAMEHEADER if buf is not a layer 3 frame
+ *
+ * Notes:       does not touch the decoder state, can be used for a file that is not playing yet
+ *              gapless: the decoder adds 529 samples, the valid samples of the file are
+ *              [encDelay + 529, frames * samplesPerFrame - encPadding + 529)
+ **********************************************************************************************************************/
+int MP3GetXingInfo(const unsigned char *buf, int nBytes, MP3XingInfo_t *xi) {
+
+    memset(xi, 0, sizeof(MP3XingInfo_t));
+    if (nBytes < 4) return ERR_MP3_INVALID_FRAMEHEADER;
+    int frameLen = MP3GetFrameSize(buf, &xi->samplesPerFrame);
+    if (frameLen < 0) return ERR_MP3_INVALID_FRAMEHEADER;
+
+    int verIdx = (buf[1] >> 3) & 0x03;
+    int crc    = !(buf[1] & 0x01);
+    int srIdx  = (buf[2] >> 2) & 0x03;
+    int mono   = ((buf[3] >> 6) & 0x03) == 3;
+    int ver = (verIdx == 3) ? MPEG1 : (verIdx == 2) ? MPEG2 : MPEG25;
+    xi->samprate = samplerateTab[ver][srIdx];
+    xi->nChans = mono ? 1 : 2;
+
+    int pos = 4 + (crc ? 2 : 0) + sideBytesTab[ver][mono ? 0 : 1];
+    if (pos + 8 > nBytes) return ERR_MP3_NONE;
+    if (memcmp(buf + pos, "Xing", 4) && memcmp(buf + pos, "Info", 4)) return ERR_MP3_NONE; // ordinary audio frame
+    xi->frameLen = frameLen;
+
+    uint32_t flags = (buf[pos + 4] << 24) | (buf[pos + 5] << 16) | (buf[pos + 6] << 8) | buf[pos + 7];
+    pos += 8;
+    if (flags & 0x01) {                  // frames
+        if (pos + 4 > nBytes) return ERR_MP3_NONE;
+        xi->frames = (buf[pos] << 24) | (buf[pos + 1] << 16) | (buf[pos + 2] << 8) | buf[pos + 3];
+        pos += 4;
+    }
+    if (flags & 0x02) pos += 4;          // bytes
+    if (flags & 0x04) pos += 100;        // toc
+    if (flags & 0x08) pos += 4;          // quality
+
+    // LAME tag: 9 bytes version, ... , 3 bytes delay / padding at offset 21, 12 bits each
+    if (pos + 24 > nBytes || pos + 24 > frameLen) return ERR_MP3_NONE;
+    if (memcmp(buf + pos, "LAME", 4) && memcmp(buf + pos, "Lavc", 4) && memcmp(buf + pos, "Lavf", 4)) return ERR_MP3_NONE;
+    xi->encDelay   = (buf[pos + 21] << 4) | (buf[pos + 22] >> 4);
+    xi->encPadding = ((buf[pos + 22] & 0x0f) << 8) | buf[pos + 23];
+    return ERR_MP3_NONE;
+}
 /***********************************************************************************************************************
  * Function:    MP3ClearBadFrame
  *
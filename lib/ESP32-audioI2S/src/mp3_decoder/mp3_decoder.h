@@ -43,6 +43,16 @@ typedef struct MP3FrameInfo {
     int version;
 } MP3FrameInfo_t;
 
+typedef struct MP3XingInfo {   // first frame of the file, Xing/Info header and LAME extension
+    int      samprate;
+    int      nChans;
+    int      samplesPerFrame;
+    int      frameLen;         // bytes of the Xing/Info frame, 0: no such frame, the first frame is audio
+    uint32_t frames;           // audio frames without the Xing/Info frame, 0: unknown
+    uint16_t encDelay;         // LAME: samples added by the encoder at the beginning
+    uint16_t encPadding;       // LAME: samples added at the end
+} MP3XingInfo_t;
+
 typedef struct SFBandTable {
     int/*short*/ l[23];
     int/*short*/ s[14];
@@ -466,6 +476,8 @@ int  MP3GetChannels();
 int  MP3GetBitsPerSample();
 int  MP3GetBitrate();
 int  MP3GetOutputSamps();
+int  MP3GetXingInfo(const unsigned char *buf, int nBytes, MP3XingInfo_t *xi);
+int  MP3GetFrameSize(const unsigned char *buf, int *samplesPerFrame);
 
 //internally used
 void MP3Decoder_ClearBuffer(void);
@@ -0,0 +1,319 @@
+/*
+ * ogg_demuxer.cpp
+ * page and packet layer shared by the Ogg based decoders (Opus, Vorbis, Ogg-FLAC)
+ * reference https://www.xiph.org/ogg/doc/rfc3533.txt
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "ogg_demuxer.h"
+
+typedef struct __attribute__((packed)) _ogg_index_entry{
+    uint32_t filePos;           // first byte of the page ("OggS")
+    uint64_t startGranule;      // granule of the first sample decoded from that page
+    uint64_t endGranule;        // granule at the end of that page
+} ogg_index_entry_t;
+
+bool                      s_f_oggCRCcheck = false;
+uint32_t                 *s_oggCRCtable = NULL;
+uint32_t                  s_oggPageCount = 0;
+const uint8_t            *s_oggLastPageHeader = NULL;
+uint64_t                  s_oggLastGranule = 0;
+uint64_t                  s_oggStartGranule = 0;      // where the last parsed page starts
+uint64_t                  s_oggEndGranule = 0;        // last granule != -1, where the next page starts
+vector<ogg_index_entry_t> s_oggIndex;
+
+//----------------------------------------------------------------------------------------------------------------------
+//                                          P A G E S   A N D   P A C K E T S
+//----------------------------------------------------------------------------------------------------------------------
+int8_t OGG_parsePage(const uint8_t* buf, int32_t len, ogg_page_t* page){
+    // parses the page header and the segment table once, the caller guarantees that the header is in the buffer
+    // len is only used for the (optional) CRC check, which needs the complete page
+    if(buf[0] != 'O' || buf[1] != 'g' || buf[2] != 'g' || buf[3] != 'S') return ERR_OGG_SYNC_NOT_FOUND;
+    if(buf[4] != 0) return ERR_OGG_VERSION; // stream_structure_version
+
+    page->header          = buf;
+    page->headerType      = buf[5];
+    page->granulePosition = (uint64_t)buf[13] << 56 | (uint64_t)buf[12] << 48 | (uint64_t)buf[11] << 40 |
+                            (uint64_t)buf[10] << 32 | (uint64_t)buf[ 9] << 24 | (uint64_t)buf[ 8] << 16 |
+                            (uint64_t)buf[ 7] <<  8 | (uint64_t)buf[ 6];
+    page->serialNr        = (uint32_t)buf[17] << 24 | (uint32_t)buf[16] << 16 | (uint32_t)buf[15] << 8 | buf[14];
+    page->pageSequenceNr  = (uint32_t)buf[21] << 24 | (uint32_t)buf[20] << 16 | (uint32_t)buf[19] << 8 | buf[18];
+    page->CRCchecksum     = (uint32_t)buf[25] << 24 | (uint32_t)buf[24] << 16 | (uint32_t)buf[23] << 8 | buf[22];
+    page->pageSegments    = buf[26];
+    page->headerSize      = OGG_PAGE_HEADER_SIZE + page->pageSegments;
+    page->continuedPage   = page->headerType & 0x01; // set: page contains data of a packet continued from the previous page
+    page->firstPage       = page->headerType & 0x02; // set: this is the first page of a logical bitstream (bos)
+    page->lastPage        = page->headerType & 0x04; // set: this is the last page of a logical bitstream (eos)
+
+    // segment table, 0...254: last segment of a packet, 255: the packet continues in the next segment
+    const uint8_t* segTab = buf + OGG_PAGE_HEADER_SIZE;
+    uint32_t n = 0;
+    uint8_t  k = 0;
+    page->bodySize = 0;
+    for(int i = 0; i < page->pageSegments; i++){
+        n += segTab[i];
+        if(segTab[i] < 255){
+            page->packetLen[k++] = n;
+            page->bodySize += n;
+            n = 0;
+        }
+    }
+    page->lastPacketOpen = (page->pageSegments > 0 && segTab[page->pageSegments - 1] == 255);
+    if(page->lastPacketOpen){
+        page->packetLen[k++] = n;
+        page->bodySize += n;
+    }
+    page->nrOfPackets = k;
+    page->nextPacket = 0;
+
+    if(s_f_oggCRCcheck && len >= (int32_t)(page->headerSize + page->bodySize)){
+        if(OGG_pageCRC(buf, page->headerSize + page->bodySize) != page->CRCchecksum){
+            log_e("Ogg page %lu, CRC error", (long unsigned)page->pageSequenceNr);
+            OGG_clearPage(page); // no packet of this page is handed out
+            return ERR_OGG_CRC;
+        }
+    }
+
+    s_oggPageCount++;
+    s_oggLastPageHeader = buf;
+    s_oggLastGranule = page->granulePosition;
+    s_oggStartGranule = s_oggEndGranule;
+    if(page->granulePosition != (uint64_t)-1) s_oggEndGranule = page->granulePosition;
+    return OGG_PAGE_OK;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t OGG_packetsLeft(const ogg_page_t* page){
+    return page->nrOfPackets - page->nextPacket;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t OGG_nextPacket(ogg_page_t* page){
+    // the decoders consume the page body in order, the packet starts at their read position and the input buffer
+    // may have moved since the page header was parsed, so only the length is handed out
+    if(page->nextPacket >= page->nrOfPackets) return 0;
+    return page->packetLen[page->nextPacket++];
+}
+//----------------------------------------------------------------------------------------------------------------------
+void OGG_clearPage(ogg_page_t* page){
+    // no packets left, the next decode call starts with a new page
+    page->nrOfPackets = 0;
+    page->nextPacket = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t OGG_findSyncWord(const uint8_t* buf, int32_t len){
+    // memchr skips to the next 'O' candidate instead of comparing the pattern at every position
+    const uint8_t* p = buf;
+    const uint8_t* end = buf + len - 3;
+    while(p < end){
+        p = (const uint8_t*)memchr(p, 'O', end - p);
+        if(!p) break;
+        if(p[1] == 'g' && p[2] == 'g' && p[3] == 'S') return p - buf;
+        p++;
+    }
+    return ERR_OGG_SYNC_NOT_FOUND;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t OGG_identifyCodec(const uint8_t* buf, int32_t len){
+    // the first packet of the first page identifies the codec: "OpusHead", 0x01"vorbis" or 0x7F"FLAC"..."fLaC"
+    auto findIn = [](const uint8_t* b, int32_t l, const char* str) -> bool {
+        int32_t sl = strlen(str);
+        for(int32_t i = 0; i + sl <= l; i++){
+            if(b[i] == (uint8_t)str[0] && memcmp(b + i, str, sl) == 0) return true;
+        }
+        return false;
+    };
+    if(len < 6) return OGG_CODEC_NONE;
+    if(memcmp(buf, "OggS", 4) != 0){
+        if(findIn(buf, 6, "fLaC")) return OGG_CODEC_FLAC; // native FLAC, no ogg wrapper
+        return OGG_CODEC_NONE;
+    }
+    int32_t n = min(len - OGG_PAGE_HEADER_SIZE, (int32_t)40); // the segment table and the first bytes of the packet
+    if(n <= 0) return OGG_CODEC_NONE;
+    buf += OGG_PAGE_HEADER_SIZE;
+    if(findIn(buf, n, "OpusHead")) return OGG_CODEC_OPUS;
+    if(findIn(buf, n, "fLaC"))     return OGG_CODEC_FLAC;
+    if(findIn(buf, n, "vorbis"))   return OGG_CODEC_VORBIS;
+    return OGG_CODEC_NONE;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void OGG_setCRCcheck(bool enable){
+    // CRC-32, polynomial 0x04c11db7, no reflection, initial value 0 - the table is only held while checking is enabled
+    if(enable && !s_oggCRCtable){
+        s_oggCRCtable = (uint32_t*)malloc(256 * sizeof(uint32_t));
+        if(!s_oggCRCtable){log_e("oom"); s_f_oggCRCcheck = false; return;}
+        for(uint32_t i = 0; i < 256; i++){
+            uint32_t r = i << 24;
+            for(int j = 0; j < 8; j++) r = (r & 0x80000000UL) ? (r << 1) ^ 0x04c11db7UL : (r << 1);
+            s_oggCRCtable[i] = r;
+        }
+    }
+    if(!enable && s_oggCRCtable){free(s_oggCRCtable); s_oggCRCtable = NULL;}
+    s_f_oggCRCcheck = enable;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t OGG_pageCRC(const uint8_t* page, uint32_t pageSize){
+    if(!s_oggCRCtable) return 0;
+    uint32_t crc = 0;
+    for(uint32_t i = 0; i < pageSize; i++){
+        uint8_t b = (i >= 22 && i < 26) ? 0 : page[i]; // the checksum field itself counts as zero
+        crc = (crc << 8) ^ s_oggCRCtable[((crc >> 24) ^ b) & 0xff];
+    }
+    return crc;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t OGG_getPageCount(){
+    return s_oggPageCount;
+}
+const uint8_t* OGG_getLastPageHeader(){
+    return s_oggLastPageHeader;
+}
+uint64_t OGG_getLastGranule(){
+    return s_oggLastGranule;
+}
+uint64_t OGG_getLastPageStartGranule(){
+    return s_oggStartGranule;
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                          G R A N U L E   I N D E X
+//----------------------------------------------------------------------------------------------------------------------
+void OGG_indexReset(){
+    s_oggIndex.clear();
+    s_oggIndex.shrink_to_fit();
+    s_oggStartGranule = 0;
+    s_oggEndGranule = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void OGG_indexAdd(uint32_t filePos, uint64_t startGranule, uint64_t endGranule){
+    // pages arrive in file order, only pages that finish a packet (granule != -1) and move forward are stored,
+    // so the index stays sorted by file position and by granule. Header pages (granule 0) are no seek targets.
+    if(endGranule == (uint64_t)-1 || endGranule == 0 || startGranule >= endGranule) return;
+    if(s_oggIndex.size() >= OGG_INDEX_MAX_PAGES) return;
+    if(s_oggIndex.size()){
+        const ogg_index_entry_t& last = s_oggIndex.back();
+        if(filePos <= last.filePos || startGranule < last.endGranule) return;
+    }
+    ogg_index_entry_t e;
+    e.filePos = filePos;
+    e.startGranule = startGranule;
+    e.endGranule = endGranule;
+    s_oggIndex.push_back(e);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t OGG_indexFind(uint64_t granulePosition, uint64_t* pageGranule){
+    // binary search for the indexed page that holds granulePosition (the last page that starts at or before it),
+    // decoding restarts at the beginning of that page. *pageGranule receives the granule where that page starts.
+    // Returns -1 if the position lies beyond the indexed part of the stream.
+    if(s_oggIndex.empty()) return -1;
+    if(granulePosition > s_oggIndex.back().endGranule) return -1;
+    int32_t lo = 0, hi = s_oggIndex.size() - 1, found = -1;
+    while(lo <= hi){
+        int32_t mid = (lo + hi) >> 1;
+        if(s_oggIndex[mid].startGranule <= granulePosition){found = mid; lo = mid + 1;}
+        else hi = mid - 1;
+    }
+    if(found < 0) found = 0; // before the first indexed page
+    if(pageGranule) *pageGranule = s_oggIndex[found].startGranule;
+    return s_oggIndex[found].filePos;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool OGG_indexLast(uint32_t* filePos, uint64_t* startGranule){
+    // the furthest indexed page, OGG_bisect() goes on from there
+    if(s_oggIndex.empty()) return false;
+    *filePos = s_oggIndex.back().filePos;
+    *startGranule = s_oggIndex.back().startGranule;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t OGG_indexSize(){
+    return s_oggIndex.size();
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                            B I S E C T I O N
+//----------------------------------------------------------------------------------------------------------------------
+static int32_t bisectPageSize(const uint8_t* buf, int32_t len){
+    // size of the page at buf if its header is complete and plausible, else 0
+    if(len < OGG_PAGE_HEADER_SIZE || memcmp(buf, "OggS", 4) || buf[4] != 0) return 0;
+    int32_t size = OGG_PAGE_HEADER_SIZE + buf[26];
+    if(len < size) return 0;
+    for(int i = 0; i < buf[26]; i++) size += buf[OGG_PAGE_HEADER_SIZE + i];
+    return size;
+}
+static uint64_t bisectGranule(const uint8_t* buf){
+    uint64_t g = 0;
+    for(int i = 13; i >= 6; i--) g = (g << 8) | buf[i];
+    return g;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool bisectProbe(File& file, uint8_t* buf, uint32_t pos, uint32_t* pagePos, uint32_t* pageEnd, uint64_t* granule){
+    // the first page at or behind pos that finishes a packet; a sync word counts only if the next page follows it
+    // (or the window ends), so "OggS" in the audio data is not taken for a page
+    file.seek(pos);
+    int32_t n = file.read(buf, OGG_BISECT_WINDOW);
+    int32_t i = 0;
+    while(i + OGG_PAGE_HEADER_SIZE <= n){
+        int32_t sync = OGG_findSyncWord(buf + i, n - i);
+        if(sync < 0) return false;
+        i += sync;
+        int32_t size = bisectPageSize(buf + i, n - i);
+        bool    next = (i + size + 4 > n) || !memcmp(buf + i + size, "OggS", 4);
+        if(!size || !next){i++; continue;}
+        while(size){                                  // from here on page by page
+            uint64_t g = bisectGranule(buf + i);
+            if(g != (uint64_t)-1){
+                *pagePos = pos + i;
+                *pageEnd = pos + i + size;
+                *granule = g;
+                return true;
+            }
+            i += size;
+            size = bisectPageSize(buf + i, n - i);
+        }
+        return false;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int32_t bisectWalk(File& file, uint8_t* buf, uint32_t pos, uint64_t start, uint64_t granulePosition,
+                          uint64_t* pageGranule){
+    // page by page from pos (a page that starts at 'start'): the last page that begins with a new packet and starts
+    // at or before granulePosition, as OGG_indexFind() would return it; -2: the stream ends before granulePosition
+    int32_t found = -1;
+    while(true){
+        file.seek(pos);
+        int32_t size = bisectPageSize(buf, file.read(buf, OGG_PAGE_HEADER_SIZE + OGG_MAX_SEGMENTS));
+        if(!size) return (start < granulePosition) ? -2 : found;
+        if(start > granulePosition) return found;
+        uint64_t g = bisectGranule(buf);
+        if(!(buf[5] & 0x01) && g != 0){found = pos; *pageGranule = start;} // header pages (granule 0) are no targets
+        if(g != (uint64_t)-1){
+            if(granulePosition < g) return found;
+            start = g;
+        }
+        pos += size;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t OGG_bisect(File& file, uint32_t startPos, uint64_t startGranule, uint64_t granulePosition, uint64_t* pageGranule){
+    // the page that holds granulePosition when the index does not reach it yet. startPos is a page that starts at
+    // startGranule <= granulePosition (the last indexed page or the first page of the file). The file range is halved
+    // by the granule of the first complete page behind the middle until 2 * OGG_BISECT_WINDOW bytes are left, then
+    // the pages are walked. Returns -1 if the stream ends before granulePosition. The file position is not restored.
+    if(!file || startGranule > granulePosition) return -1;
+    uint8_t* buf = (uint8_t*)malloc(OGG_BISECT_WINDOW);
+    if(!buf) return -1;
+    uint32_t lo = startPos, hi = file.size();
+    uint64_t loGranule = startGranule, g = 0;
+    while(hi - lo > 2 * OGG_BISECT_WINDOW){
+        uint32_t mid = lo + (hi - lo) / 2, pagePos, pageEnd;
+        if(!bisectProbe(file, buf, mid, &pagePos, &pageEnd, &g) || g > granulePosition) hi = mid;
+        else{lo = pageEnd; loGranule = g;}          // the next page starts at g
+    }
+    uint64_t granule = 0;
+    int32_t  found = bisectWalk(file, buf, lo, loGranule, granulePosition, &granule);
+    // the pages behind lo continue a packet up to the target: the page where it begins lies before lo
+    if(found == -1 && lo != startPos) found = bisectWalk(file, buf, startPos, startGranule, granulePosition, &granule);
+    free(buf);
+    if(found < 0) return -1;
+    if(pageGranule) *pageGranule = granule;
+    return found;
+}
@@ -0,0 +1,67 @@
+/*
+ * ogg_demuxer.h
+ * page and packet layer shared by the Ogg based decoders (Opus, Vorbis, Ogg-FLAC)
+ * reference https://www.xiph.org/ogg/doc/rfc3533.txt
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+
+#include "Arduino.h"
+#include <FS.h>
+#include <vector>
+using namespace std;
+
+#define OGG_PAGE_HEADER_SIZE 27    // fixed part, followed by the segment table
+#define OGG_MAX_SEGMENTS     255
+#define OGG_INDEX_MAX_PAGES  4096  // granule index limit, 20 bytes per entry
+#define OGG_BISECT_WINDOW    8192  // bytes read per bisection step, more than the largest usual page
+
+enum : int8_t  {OGG_PAGE_OK = 0,
+                ERR_OGG_SYNC_NOT_FOUND = -1,
+                ERR_OGG_VERSION = -2,
+                ERR_OGG_CRC = -3};
+
+enum : uint8_t {OGG_CODEC_NONE, OGG_CODEC_OPUS, OGG_CODEC_VORBIS, OGG_CODEC_FLAC};
+
+typedef struct _ogg_page{
+    const uint8_t* header;              // points to "OggS", the page is never copied
+    uint8_t        headerType;
+    uint64_t       granulePosition;     // -1: no packet finishes on this page
+    uint32_t       serialNr;
+    uint32_t       pageSequenceNr;
+    uint32_t       CRCchecksum;
+    uint8_t        pageSegments;
+    uint16_t       headerSize;          // 27 + pageSegments
+    uint32_t       bodySize;            // sum of all lacing values
+    uint8_t        nrOfPackets;         // packets (or packet parts) on this page
+    uint8_t        nextPacket;          // next packet handed out by OGG_nextPacket()
+    uint16_t       packetLen[OGG_MAX_SEGMENTS]; // lacing resolved, 255 + 255 + 10 -> 520
+    bool           continuedPage;       // first packet continues a packet of the previous page
+    bool           firstPage;           // bos
+    bool           lastPage;            // eos
+    bool           lastPacketOpen;      // last lacing value is 255, the packet continues on the next page
+} ogg_page_t;
+
+int8_t            OGG_parsePage(const uint8_t* buf, int32_t len, ogg_page_t* page);
+uint8_t           OGG_packetsLeft(const ogg_page_t* page);
+uint16_t          OGG_nextPacket(ogg_page_t* page);
+void              OGG_clearPage(ogg_page_t* page);
+int32_t           OGG_findSyncWord(const uint8_t* buf, int32_t len);
+uint8_t           OGG_identifyCodec(const uint8_t* buf, int32_t len);
+void              OGG_setCRCcheck(bool enable);
+uint32_t          OGG_pageCRC(const uint8_t* page, uint32_t pageSize);
+uint32_t          OGG_getPageCount();
+const uint8_t*    OGG_getLastPageHeader();
+uint64_t          OGG_getLastGranule();
+uint64_t          OGG_getLastPageStartGranule();
+// granule index, filled while playing, used for seeking
+void              OGG_indexReset();
+void              OGG_indexAdd(uint32_t filePos, uint64_t startGranule, uint64_t endGranule);
+int32_t           OGG_indexFind(uint64_t granulePosition, uint64_t* pageGranule = NULL);
+bool              OGG_indexLast(uint32_t* filePos, uint64_t* startGranule);
+uint16_t          OGG_indexSize();
+// beyond the index: bisection over the file by page granule
+int32_t           OGG_bisect(File& file, uint32_t startPos, uint64_t startGranule, uint64_t granulePosition,
+                             uint64_t* pageGranule = NULL);
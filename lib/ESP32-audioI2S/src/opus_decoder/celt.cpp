@@ -189,7 +189,7 @@ static const uint32_t CELT_PVQ_U_DATA[1272] = {
     /*N=14, K=14:*/
     1409933619};
 
-static const uint8_t band_allocation[] = {
+const uint8_t band_allocation[] = {
     /*0  200 400 600 800  1k 1.2 1.4 1.6  2k 2.4 2.8 3.2  4k 4.8 5.6 6.8  8k 9.6 12k 15.6 */
     0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
     90,  80,  75,  69,  63,  56,  49,  40,  34,  29,  20,  18,  10,  0,   0,   0,   0,   0,   0,   0,   0,
@@ -204,7 +204,7 @@ static const uint8_t band_allocation[] = {
     200, 200, 200, 200, 200, 200, 200, 200, 198, 193, 188, 183, 178, 173, 168, 163, 158, 153, 148, 129, 104,
 };
 
-static const int16_t eband5ms[] = {
+const int16_t eband5ms[] = {
 /*0  200 400 600 800  1k 1.2 1.4 1.6  2k 2.4 2.8 3.2  4k 4.8 5.6 6.8  8k 9.6 12k 15.6 */
   0,  1,  2,  3,  4,  5,  6,  7,  8, 10, 12, 14, 16, 20, 24, 28, 34, 40, 48, 60, 78, 100
 };
@@ -341,7 +341,7 @@ static const int16_t mdct_twiddles960[1800] = {
     -32074, -32239, -32381, -32501, -32600, -32675, -32729, -32759,
 };
 
-static const int16_t window120[120] = {
+const int16_t window120[120] = {
     2,     20,    55,    108,   178,   266,   372,   494,   635,   792,   966,   1157,  1365,  1590,  1831,
     2089,  2362,  2651,  2956,  3276,  3611,  3961,  4325,  4703,  5094,  5499,  5916,  6346,  6788,  7241,
     7705,  8179,  8663,  9156,  9657,  10167, 10684, 11207, 11736, 12271, 12810, 13353, 13899, 14447, 14997,
@@ -352,7 +352,19 @@ static const int16_t window120[120] = {
     32717, 32729, 32740, 32748, 32754, 32758, 32762, 32764, 32766, 32767, 32767, 32767, 32767, 32767, 32767,
 };
 
-static const int16_t logN400[21] = {
+/* Post-filter cross-fade, window120[i]^2 in Q15 (MULT16_16_Q15(window120[i], window120[i])) */
+static const int16_t comb_fade120[120] = {
+    0,      0,      0,      0,      0,      2,      4,      7,      12,     19,     28,     40,     56,     77,     102,
+    133,    170,    214,    266,    327,    397,    478,    570,    674,    791,    922,    1068,   1228,   1406,   1600,
+    1811,   2041,   2290,   2558,   2845,   3154,   3483,   3832,   4203,   4595,   5007,   5441,   5895,   6369,   6863,
+    7376,   7908,   8458,   9025,   9608,   10205,  10817,  11441,  12076,  12722,  13376,  14037,  14703,  15374,  16047,
+    16720,  17394,  18064,  18730,  19392,  20045,  20691,  21325,  21950,  22561,  23159,  23743,  24310,  24859,  25391,
+    25904,  26397,  26872,  27326,  27759,  28173,  28564,  28935,  29283,  29613,  29922,  30209,  30477,  30726,  30955,
+    31168,  31361,  31539,  31698,  31844,  31976,  32093,  32196,  32289,  32369,  32440,  32500,  32554,  32598,  32634,
+    32666,  32690,  32712,  32728,  32740,  32748,  32756,  32760,  32764,  32766,  32766,  32766,  32766,  32766,  32766,
+};
+
+const int16_t logN400[21] = {
     0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 8, 16, 16, 16, 21, 21, 24, 29, 34, 36,
 };
 
@@ -535,15 +547,15 @@ const signed char eMeans[25] = {103, 100, 92, 85, 81, 77, 72, 70, 78, 75, 73, 71
                                 74,  69,  72, 70, 74, 76, 71, 60, 60, 60, 60, 60};
 
 /* prediction coefficients: 0.9, 0.8, 0.65, 0.5 */
-static const int16_t pred_coef[4] = {29440, 26112, 21248, 16384};
-static const int16_t beta_coef[4] = {30147, 22282, 12124, 6554};
-static const int16_t beta_intra = 4915;
+const int16_t pred_coef[4] = {29440, 26112, 21248, 16384};
+const int16_t beta_coef[4] = {30147, 22282, 12124, 6554};
+const int16_t beta_intra = 4915;
 
 
 /*Parameters of the Laplace-like probability models used for the coarse energy. There is one pair of parameters for
   each frame size, prediction type (inter/intra), and band number. The first number of each pair is the probability
   of 0, and the second is the decay rate, both in Q8 precision.*/
-static const uint8_t e_prob_model[4][2][42] = {
+const uint8_t e_prob_model[4][2][42] = {
     /*120 sample frames.*/
     {/*Inter*/
      {72, 127, 65, 129, 66, 128, 65, 128, 64, 128, 62, 128, 64, 128, 64, 128, 92, 78,  92, 79,  92,
@@ -573,11 +585,11 @@ static const uint8_t e_prob_model[4][2][42] = {
      {22, 178, 63, 114, 74, 82,  84, 83,  92, 82,  103, 62,  96, 72,  96, 67,  101, 73, 107, 72, 113,
       55, 118, 52, 125, 52, 118, 52, 117, 55, 135, 49,  137, 39, 157, 32, 145, 29,  97, 33,  77, 40}}};
 
-static const uint8_t small_energy_icdf[3]={2,1,0};
+const uint8_t small_energy_icdf[3]={2,1,0};
 
-static const uint8_t trim_icdf[11] = {126, 124, 119, 109, 87, 41, 19, 9, 4, 2, 0};
+const uint8_t trim_icdf[11] = {126, 124, 119, 109, 87, 41, 19, 9, 4, 2, 0};
 /* Probs: NONE: 21.875%, LIGHT: 6.25%, NORMAL: 65.625%, AGGRESSIVE: 6.25% */
-static const uint8_t spread_icdf[4] = {25, 23, 2, 0};
+const uint8_t spread_icdf[4] = {25, 23, 2, 0};
 
 static const uint8_t tapset_icdf[3]={2,1,0};
 
@@ -643,15 +655,19 @@ const mdct_lookup_t m_mdct_lookup = {
      mdct_twiddles960,                               /* mdct */
 };
 
-const uint32_t row_idx[15] = {0, 176, 351, 525, 698, 870, 1041, 1131, 1178, 1207, 1226, 1240, 1248, 1254, 1257};
+/* Row pointers into CELT_PVQ_U_DATA, U(n, k) is CELT_PVQ_U_ROW[min(n, k)][max(n, k)] */
+static const uint32_t *const CELT_PVQ_U_ROW[15] = {
+    CELT_PVQ_U_DATA + 0,    CELT_PVQ_U_DATA + 176,  CELT_PVQ_U_DATA + 351,  CELT_PVQ_U_DATA + 525,
+    CELT_PVQ_U_DATA + 698,  CELT_PVQ_U_DATA + 870,  CELT_PVQ_U_DATA + 1041, CELT_PVQ_U_DATA + 1131,
+    CELT_PVQ_U_DATA + 1178, CELT_PVQ_U_DATA + 1207, CELT_PVQ_U_DATA + 1226, CELT_PVQ_U_DATA + 1240,
+    CELT_PVQ_U_DATA + 1248, CELT_PVQ_U_DATA + 1254, CELT_PVQ_U_DATA + 1257};
 
 uint32_t celt_pvq_u_row(uint32_t row, uint32_t data){
-    uint32_t  ret = CELT_PVQ_U_DATA[row_idx[row] + data];
-    return ret;
+    return CELT_PVQ_U_ROW[row][data];
 }
 
 #define DECODE_BUFFER_SIZE 2048
-#define CELT_PVQ_U(_n, _k) (celt_pvq_u_row(min(_n, _k), max(_n, _k)))
+#define CELT_PVQ_U(_n, _k) (CELT_PVQ_U_ROW[min(_n, _k)][max(_n, _k)])
 #define CELT_PVQ_V(_n, _k) (CELT_PVQ_U(_n, _k) + CELT_PVQ_U(_n, (_k) + 1))
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -800,19 +816,38 @@ void renormalise_vector(int16_t *X, int32_t N, int16_t gain) {
 //----------------------------------------------------------------------------------------------------------------------
 
 void comb_filter_const(int32_t *y, int32_t *x, int32_t T, int32_t N, int16_t g10, int16_t g11, int16_t g12) {
+    /* The five taps x[i-T-2..i-T+2] are kept in registers and rotated, the loop is unrolled by four so every
+       input sample is loaded once. y and x may be the same buffer (T >= 15), therefore each output is written
+       before the tap that depends on it is loaded. */
     int32_t x0, x1, x2, x3, x4;
     int32_t i;
-    x4 = x[-T - 2];
-    x3 = x[-T - 1];
-    x2 = x[-T];
-    x1 = x[-T + 1];
-    for (i = 0; i < N; i++) {
-        x0 = x[i - T + 2];
-        y[i]  = x[i];
-        y[i] += MULT16_32_Q15(g10, x2);
-        y[i] += MULT16_32_Q15(g11, ADD32(x1, x3));
-        y[i] += MULT16_32_Q15(g12, ADD32(x0, x4));
-        y[i] = SATURATE(y[i], (300000000));
+    const int32_t *xp = x - T;
+    x4 = xp[-2];
+    x3 = xp[-1];
+    x2 = xp[0];
+    x1 = xp[1];
+    for (i = 0; i < N - 3; i += 4) {
+        int32_t t;
+        x0 = xp[i + 2];
+        t = x[i] + MULT16_32_Q15(g10, x2) + MULT16_32_Q15(g11, ADD32(x1, x3)) + MULT16_32_Q15(g12, ADD32(x0, x4));
+        y[i] = SATURATE(t, (300000000));
+        x4 = xp[i + 3];
+        t = x[i + 1] + MULT16_32_Q15(g10, x1) + MULT16_32_Q15(g11, ADD32(x0, x2)) + MULT16_32_Q15(g12, ADD32(x4, x3));
+        y[i + 1] = SATURATE(t, (300000000));
+        x3 = xp[i + 4];
+        t = x[i + 2] + MULT16_32_Q15(g10, x0) + MULT16_32_Q15(g11, ADD32(x4, x1)) + MULT16_32_Q15(g12, ADD32(x3, x2));
+        y[i + 2] = SATURATE(t, (300000000));
+        x2 = xp[i + 5];
+        t = x[i + 3] + MULT16_32_Q15(g10, x4) + MULT16_32_Q15(g11, ADD32(x3, x0)) + MULT16_32_Q15(g12, ADD32(x2, x1));
+        y[i + 3] = SATURATE(t, (300000000));
+        /* rotate back so that x1..x4 hold x[i+4-T+1] .. x[i+4-T-2] */
+        x1 = x2; x2 = x3; x3 = x4; x4 = x0;
+    }
+    for (; i < N; i++) {
+        int32_t t;
+        x0 = xp[i + 2];
+        t = x[i] + MULT16_32_Q15(g10, x2) + MULT16_32_Q15(g11, ADD32(x1, x3)) + MULT16_32_Q15(g12, ADD32(x0, x4));
+        y[i] = SATURATE(t, (300000000));
         x4 = x3;
         x3 = x2;
         x2 = x1;
@@ -854,18 +889,21 @@ void comb_filter(int32_t *y, int32_t *x, int32_t T0, int32_t T1, int32_t N, int1
     x4 = x[-T1 - 2];
     /* If the filter didn't change, we don't need the overlap */
     if(g0 == g1 && T0 == T1 && tapset0 == tapset1) overlap = 0;
+    const int32_t *xp0 = x - T0;
     for(i = 0; i < overlap; i++) {
-        int16_t f;
+        int16_t f, nf;
+        int32_t t;
         x0 = x[i - T1 + 2];
-        f = MULT16_16_Q15(window120[i], window120[i]);
-        y[i] = x[i];
-        y[i] += MULT16_32_Q15(MULT16_16_Q15((32767 - f), g00), x[i - T0]);
-        y[i] += MULT16_32_Q15(MULT16_16_Q15((32767 - f), g01), ADD32(x[i - T0 + 1], x[i - T0 - 1]));
-        y[i] += MULT16_32_Q15(MULT16_16_Q15((32767 - f), g02), ADD32(x[i - T0 + 2], x[i - T0 - 2]));
-        y[i] += MULT16_32_Q15(MULT16_16_Q15(f, g10), x2);
-        y[i] += MULT16_32_Q15(MULT16_16_Q15(f, g11), ADD32(x1, x3));
-        y[i] += MULT16_32_Q15(MULT16_16_Q15(f, g12), ADD32(x0, x4));
-        y[i] = SATURATE(y[i], (300000000));
+        f = comb_fade120[i];
+        nf = 32767 - f;
+        t = x[i];
+        t += MULT16_32_Q15(MULT16_16_Q15(nf, g00), xp0[i]);
+        t += MULT16_32_Q15(MULT16_16_Q15(nf, g01), ADD32(xp0[i + 1], xp0[i - 1]));
+        t += MULT16_32_Q15(MULT16_16_Q15(nf, g02), ADD32(xp0[i + 2], xp0[i - 2]));
+        t += MULT16_32_Q15(MULT16_16_Q15(f, g10), x2);
+        t += MULT16_32_Q15(MULT16_16_Q15(f, g11), ADD32(x1, x3));
+        t += MULT16_32_Q15(MULT16_16_Q15(f, g12), ADD32(x0, x4));
+        y[i] = SATURATE(t, (300000000));
         x4 = x3;
         x3 = x2;
         x2 = x1;
@@ -2546,8 +2584,7 @@ int32_t cwrsi(int32_t _n, int32_t _k, uint32_t _i, int32_t *_y) {
         /*Lots of pulses case:*/
         if (_k >= _n) {
             const uint32_t *row;
-            //row = celt_pvq_u_row[_n];
-            row = &CELT_PVQ_U_DATA[row_idx[_n]];
+            row = CELT_PVQ_U_ROW[_n];
 
             /*Are the pulses in this dimension negative?*/
             p = row[_k + 1];
@@ -2559,7 +2596,7 @@ int32_t cwrsi(int32_t _n, int32_t _k, uint32_t _i, int32_t *_y) {
             if (q > _i) {
                 assert(p > q);
                 _k = _n;
-                do p = celt_pvq_u_row(--_k, _n);
+                do p = CELT_PVQ_U_ROW[--_k][_n];
                 while (p > _i);
             } else
                 for (p = row[_k]; p > _i; p = row[_k]) _k--;
@@ -2571,8 +2608,8 @@ int32_t cwrsi(int32_t _n, int32_t _k, uint32_t _i, int32_t *_y) {
         /*Lots of dimensions case:*/
         else {
             /*Are there any pulses in this dimension at all?*/
-            p = celt_pvq_u_row(_k, _n);
-            q = celt_pvq_u_row(_k + 1, _n);
+            p = CELT_PVQ_U_ROW[_k][_n];
+            q = CELT_PVQ_U_ROW[_k + 1][_n];
             if (p <= _i && _i < q) {
                 _i -= p;
                 *_y++ = 0;
@@ -2582,7 +2619,7 @@ int32_t cwrsi(int32_t _n, int32_t _k, uint32_t _i, int32_t *_y) {
                 _i -= q & s;
                 /*Count how many pulses were placed in this dimension.*/
                 k0 = _k;
-                do p = celt_pvq_u_row(--_k, _n);
+                do p = CELT_PVQ_U_ROW[--_k][_n];
                 while (p > _i);
                 _i -= p;
                 val = (k0 - _k + s) ^ s;
@@ -2942,6 +2979,7 @@ void kf_bfly5(kiss_fft_cpx *Fout, const size_t fstride, const kiss_fft_state *st
     int32_t i, u;
     kiss_fft_cpx scratch[13];
     const kiss_twiddle_cpx *tw;
+    const kiss_twiddle_cpx *tw1, *tw2, *tw3, *tw4;
     kiss_twiddle_cpx ya, yb;
     kiss_fft_cpx *Fout_beg = Fout;
 
@@ -2958,15 +2996,20 @@ void kf_bfly5(kiss_fft_cpx *Fout, const size_t fstride, const kiss_fft_state *st
         Fout2 = Fout0 + 2 * m;
         Fout3 = Fout0 + 3 * m;
         Fout4 = Fout0 + 4 * m;
+        tw1 = tw2 = tw3 = tw4 = tw;
 
         /* For non-custom modes, m is guaranteed to be a multiple of 4. */
         for (u = 0; u < m; ++u) {
             scratch[0] = *Fout0;
 
-            C_MUL(scratch[1], *Fout1, tw[u * fstride]);
-            C_MUL(scratch[2], *Fout2, tw[2 * u * fstride]);
-            C_MUL(scratch[3], *Fout3, tw[3 * u * fstride]);
-            C_MUL(scratch[4], *Fout4, tw[4 * u * fstride]);
+            C_MUL(scratch[1], *Fout1, *tw1);
+            C_MUL(scratch[2], *Fout2, *tw2);
+            C_MUL(scratch[3], *Fout3, *tw3);
+            C_MUL(scratch[4], *Fout4, *tw4);
+            tw1 += fstride;
+            tw2 += 2 * fstride;
+            tw3 += 3 * fstride;
+            tw4 += 4 * fstride;
 
             C_ADD(scratch[7], scratch[1], scratch[4]);
             C_SUB(scratch[10], scratch[1], scratch[4]);
@@ -3243,20 +3286,27 @@ void clt_mdct_backward(int32_t *in, int32_t * out, int32_t overlap, int32_t shif
         const int32_t * xp1 = in;
         const int32_t * xp2 = in + stride * (N2 - 1);
         int32_t * yp = out + (overlap >> 1);
-        const int16_t * t = &trig[0];
+        const int16_t * t0 = &trig[0];
+        const int16_t * t1 = &trig[N4];
         const int16_t * bitrev = m_mdct_lookup.kfft[shift]->bitrev;
+        const int32_t step = 2 * stride;
         for (i = 0; i < N4; i++) {
             int32_t rev;
-            int32_t yr, yi;
+            int32_t x1, x2, yr, yi;
+            int16_t c, s;
             rev = *bitrev++;
-            yr = ADD32_ovflw(S_MUL(*xp2, t[i]), S_MUL(*xp1, t[N4 + i]));
-            yi = SUB32_ovflw(S_MUL(*xp1, t[i]), S_MUL(*xp2, t[N4 + i]));
+            x1 = *xp1;
+            x2 = *xp2;
+            c = *t0++;
+            s = *t1++;
+            yr = ADD32_ovflw(S_MUL(x2, c), S_MUL(x1, s));
+            yi = SUB32_ovflw(S_MUL(x1, c), S_MUL(x2, s));
             /* We swap real and imag because we use an FFT instead of an IFFT. */
             yp[2 * rev + 1] = yr;
             yp[2 * rev] = yi;
             /* Storing the pre-rotation directly in the bitrev order. */
-            xp1 += 2 * stride;
-            xp2 -= 2 * stride;
+            xp1 += step;
+            xp2 -= step;
         }
     }
 
@@ -85,6 +85,19 @@ typedef struct _ec_ctx {
 extern ec_ctx_t s_ec;
 extern const uint8_t cache_bits50[392];
 extern const int16_t cache_index50[105];
+extern const uint8_t band_allocation[];
+extern const int16_t eband5ms[];
+extern const int16_t window120[120];
+extern const int16_t logN400[21];
+extern const signed char eMeans[25];
+extern const int16_t pred_coef[4];
+extern const int16_t beta_coef[4];
+extern const int16_t beta_intra;
+extern const uint8_t e_prob_model[4][2][42];
+extern const uint8_t small_energy_icdf[3];
+extern const uint8_t trim_icdf[11];
+extern const uint8_t spread_icdf[4];
+extern const signed char tf_select_table[4][8];
 
 typedef struct _band_ctx{
     int32_t encode;
@@ -185,6 +198,7 @@ struct CELTMode {
 };
 
 extern const CELTMode m_CELTMode;
+extern const mdct_lookup_t m_mdct_lookup;
 
 #define _min(a,b) ((a)<(b)?(a):(b))
 #define _max(a,b) ((a)>(b)?(a):(b))
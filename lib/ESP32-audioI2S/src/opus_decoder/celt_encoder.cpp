@@ -0,0 +1,1097 @@
+/* Copyright (c) 2007-2008 CSIRO
+   Copyright (c) 2007-2010 Xiph.Org Foundation
+   Copyright (c) 2008 Gregory Maxwell
+   Written by Jean-Marc Valin and Gregory Maxwell */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*
+ * celt_encoder.cpp
+ * based on Xiph.Org Foundation celt encoder, a subset for speech: mono, long blocks, no postfilter,
+ * no tf changes, no dynalloc, fixed spread and trim, constant bitrate. The tables and the band helpers are
+ * those of celt.cpp, the state is separate from the decoder: both can run at the same time.
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+
+#include "celt_encoder.h"
+#include "opus_decoder.h"
+
+const uint32_t EC_SYM_BITS    = 8;
+const uint8_t  EC_SYM_MAX     = 255;
+const uint8_t  EC_CODE_BITS   = 32;
+const uint32_t EC_CODE_TOP    = 2147483648; // 1U << (EC_CODE_BITS - 1);
+const uint32_t EC_CODE_BOT    = 8388608;    // EC_CODE_TOP >> EC_SYM_BITS;
+const uint8_t  EC_CODE_SHIFT  = 23;         // EC_CODE_BITS - EC_SYM_BITS - 1;
+const uint8_t  EC_UINT_BITS   = 8;
+const uint8_t  EC_WINDOW_SIZE = 32;
+const uint8_t  BITRES         = 3;
+const uint8_t  EPSILON        = 1;
+const uint8_t  LAPLACE_MINP   = 1;
+
+typedef struct _celt_enc {
+    int32_t upsample;             // 48000 / sample rate
+    int32_t end;                  // coded bands
+    int32_t intra;                // the next frame is coded without prediction
+    int32_t preemph_mem;
+    int16_t oldBandE[21];         // quantised energies, as the decoder has them
+    int32_t in_mem[120];          // pre-emphasised overlap of the last frame
+} celt_enc_t;
+
+static celt_enc_t*   s_celtEnc = NULL;
+static ec_ctx_t      s_ecEnc;                   // not s_ec: that one belongs to the decoder
+static int32_t*      s_encInBuff = NULL;        // overlap + frame, pre-emphasised
+static int32_t*      s_encFreqBuff = NULL;      // MDCT
+static kiss_fft_cpx* s_encFftBuff = NULL;
+static int16_t*      s_encXBuff = NULL;         // normalised bands
+static int32_t*      s_encIyBuff = NULL;        // pulses, 3 x 176
+static int32_t       s_encRemainingBits = 0;
+
+#define CELT_PVQ_U(_n, _k) (celt_pvq_u_row(_min(_n, _k), _max(_n, _k)))
+#define CELT_PVQ_V(_n, _k) (CELT_PVQ_U(_n, _k) + CELT_PVQ_U(_n, (_k) + 1))
+
+// save stack arrays in heap, prefer PSRAM
+#ifdef BOARD_HAS_PSRAM
+    #define __heap_caps_malloc(size) heap_caps_malloc(size, MALLOC_CAP_SPIRAM)
+#else
+    #define __heap_caps_malloc(size) heap_caps_malloc(size, MALLOC_CAP_DEFAULT)
+#endif
+
+bool CELTEncoder_AllocateBuffers(void) {
+    if(!s_celtEnc)     {s_celtEnc = (celt_enc_t*)        __heap_caps_malloc(sizeof(celt_enc_t));}
+    if(!s_encInBuff)   {s_encInBuff = (int32_t*)         __heap_caps_malloc(1080 * sizeof(int32_t));}
+    if(!s_encFreqBuff) {s_encFreqBuff = (int32_t*)       __heap_caps_malloc(960  * sizeof(int32_t));}
+    if(!s_encFftBuff)  {s_encFftBuff = (kiss_fft_cpx*)   __heap_caps_malloc(480  * sizeof(kiss_fft_cpx));}
+    if(!s_encXBuff)    {s_encXBuff = (int16_t*)          __heap_caps_malloc(960  * sizeof(int16_t));}
+    if(!s_encIyBuff)   {s_encIyBuff = (int32_t*)         __heap_caps_malloc(3 * 176 * sizeof(int32_t));}
+
+    if(!s_celtEnc || !s_encInBuff || !s_encFreqBuff || !s_encFftBuff || !s_encXBuff || !s_encIyBuff) {
+        CELTEncoder_FreeBuffers();
+        log_e("not enough memory to allocate celtencoder buffers");
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void CELTEncoder_FreeBuffers(){
+    if(s_celtEnc)     { free(s_celtEnc);     s_celtEnc =     NULL; }
+    if(s_encInBuff)   { free(s_encInBuff);   s_encInBuff =   NULL; }
+    if(s_encFreqBuff) { free(s_encFreqBuff); s_encFreqBuff = NULL; }
+    if(s_encFftBuff)  { free(s_encFftBuff);  s_encFftBuff =  NULL; }
+    if(s_encXBuff)    { free(s_encXBuff);    s_encXBuff =    NULL; }
+    if(s_encIyBuff)   { free(s_encIyBuff);   s_encIyBuff =   NULL; }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+int32_t celt_encoder_init(int32_t sampleRate, int32_t end){
+    if(!s_celtEnc) return ERR_OPUS_CELT_ALLOC_FAIL;
+    if(sampleRate <= 0 || 48000 % sampleRate || 48000 / sampleRate > 6) return ERR_OPUS_INVALID_SAMPLERATE;
+    if(end != 13 && end != 17 && end != 19 && end != 21) return ERR_OPUS_CELT_END_BAND;  // the bandwidths of the TOC
+    s_celtEnc->upsample = 48000 / sampleRate;
+    s_celtEnc->end = end;
+    celt_encoder_reset();
+    return ERR_OPUS_NONE;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+void celt_encoder_reset(){
+    if(!s_celtEnc) return;
+    s_celtEnc->intra = 1;
+    s_celtEnc->preemph_mem = 0;
+    memset(s_celtEnc->oldBandE, 0, sizeof(s_celtEnc->oldBandE));
+    memset(s_celtEnc->in_mem, 0, sizeof(s_celtEnc->in_mem));
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                         R A N G E   E N C O D E R
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_init(uint8_t *_buf, uint32_t _size) {
+    s_ecEnc.buf = _buf;
+    s_ecEnc.end_offs = 0;
+    s_ecEnc.end_window = 0;
+    s_ecEnc.nend_bits = 0;
+    s_ecEnc.nbits_total = EC_CODE_BITS + 1;
+    s_ecEnc.offs = 0;
+    s_ecEnc.rng = EC_CODE_TOP;
+    s_ecEnc.rem = -1;
+    s_ecEnc.val = 0;
+    s_ecEnc.ext = 0;
+    s_ecEnc.storage = _size;
+    s_ecEnc.error = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static inline int32_t ec_enc_tell() { return s_ecEnc.nbits_total - EC_ILOG(s_ecEnc.rng); }
+
+static uint32_t ec_enc_tell_frac() {  // as ec_tell_frac() of the decoder
+    static const uint32_t correction[8] = {35733, 38967, 42495, 46340, 50535, 55109, 60097, 65535};
+    uint32_t nbits = s_ecEnc.nbits_total << BITRES;
+    int32_t  l = EC_ILOG(s_ecEnc.rng);
+    uint32_t r = s_ecEnc.rng >> (l - 16);
+    uint32_t b = (r >> 12) - 8;
+    b += r > correction[b];
+    l = (l << 3) + b;
+    return nbits - l;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static int32_t ec_write_byte(uint32_t _value) {
+    if(s_ecEnc.offs + s_ecEnc.end_offs >= s_ecEnc.storage) return -1;
+    s_ecEnc.buf[s_ecEnc.offs++] = (uint8_t)_value;
+    return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static int32_t ec_write_byte_at_end(uint32_t _value) {
+    if(s_ecEnc.offs + s_ecEnc.end_offs >= s_ecEnc.storage) return -1;
+    s_ecEnc.buf[s_ecEnc.storage - ++(s_ecEnc.end_offs)] = (uint8_t)_value;
+    return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/* Outputs a symbol, with a carry bit. If there is a potential to propagate a carry over several symbols, they are
+   buffered until it can be determined whether or not an actual carry will occur. */
+static void ec_enc_carry_out(int32_t _c) {
+    if(_c != EC_SYM_MAX) {
+        int32_t carry = _c >> EC_SYM_BITS;
+        /*Don't output a byte on the first write. This compare should be taken care of by branch-prediction thereafter.*/
+        if(s_ecEnc.rem >= 0) s_ecEnc.error |= ec_write_byte(s_ecEnc.rem + carry);
+        if(s_ecEnc.ext > 0) {
+            uint32_t sym = (EC_SYM_MAX + carry) & EC_SYM_MAX;
+            do s_ecEnc.error |= ec_write_byte(sym);
+            while(--(s_ecEnc.ext) > 0);
+        }
+        s_ecEnc.rem = _c & EC_SYM_MAX;
+    }
+    else s_ecEnc.ext++;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_normalize() {
+    /*If the range is too small, output some bits and rescale it.*/
+    while(s_ecEnc.rng <= EC_CODE_BOT) {
+        ec_enc_carry_out((int32_t)(s_ecEnc.val >> EC_CODE_SHIFT));
+        /*Move the next-to-high-order symbol into the high-order position.*/
+        s_ecEnc.val = (s_ecEnc.val << EC_SYM_BITS) & (EC_CODE_TOP - 1);
+        s_ecEnc.rng <<= EC_SYM_BITS;
+        s_ecEnc.nbits_total += EC_SYM_BITS;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_encode(uint32_t _fl, uint32_t _fh, uint32_t _ft) {
+    uint32_t r = s_ecEnc.rng / _ft;
+    if(_fl > 0) {
+        s_ecEnc.val += s_ecEnc.rng - r * (_ft - _fl);
+        s_ecEnc.rng = r * (_fh - _fl);
+    }
+    else s_ecEnc.rng -= r * (_ft - _fh);
+    ec_enc_normalize();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_encode_bin(uint32_t _fl, uint32_t _fh, uint32_t _bits) {
+    uint32_t r = s_ecEnc.rng >> _bits;
+    if(_fl > 0) {
+        s_ecEnc.val += s_ecEnc.rng - r * ((1U << _bits) - _fl);
+        s_ecEnc.rng = r * (_fh - _fl);
+    }
+    else s_ecEnc.rng -= r * ((1U << _bits) - _fh);
+    ec_enc_normalize();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_bit_logp(int32_t _val, uint32_t _logp) {
+    uint32_t r = s_ecEnc.rng;
+    uint32_t l = s_ecEnc.val;
+    uint32_t s = r >> _logp;
+    r -= s;
+    if(_val) s_ecEnc.val = l + r;
+    s_ecEnc.rng = _val ? s : r;
+    ec_enc_normalize();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_icdf(int32_t _s, const uint8_t *_icdf, uint32_t _ftb) {
+    uint32_t r = s_ecEnc.rng >> _ftb;
+    if(_s > 0) {
+        s_ecEnc.val += s_ecEnc.rng - r * _icdf[_s - 1];
+        s_ecEnc.rng = r * (_icdf[_s - 1] - _icdf[_s]);
+    }
+    else s_ecEnc.rng -= r * _icdf[_s];
+    ec_enc_normalize();
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_bits(uint32_t _fl, uint32_t _bits) {
+    uint32_t window = s_ecEnc.end_window;
+    int32_t  used = s_ecEnc.nend_bits;
+    assert(_bits > 0);
+    if(used + _bits > EC_WINDOW_SIZE) {
+        do {
+            s_ecEnc.error |= ec_write_byte_at_end(window & EC_SYM_MAX);
+            window >>= EC_SYM_BITS;
+            used -= EC_SYM_BITS;
+        } while(used >= (int32_t)EC_SYM_BITS);
+    }
+    window |= _fl << used;
+    used += _bits;
+    s_ecEnc.end_window = window;
+    s_ecEnc.nend_bits = used;
+    s_ecEnc.nbits_total += _bits;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_uint(uint32_t _fl, uint32_t _ft) {
+    assert(_ft > 1);
+    _ft--;
+    int32_t ftb = EC_ILOG(_ft);
+    if(ftb > EC_UINT_BITS) {
+        ftb -= EC_UINT_BITS;
+        uint32_t ft = (_ft >> ftb) + 1;
+        uint32_t fl = _fl >> ftb;
+        ec_encode(fl, fl + 1, ft);
+        ec_enc_bits(_fl & ((1U << ftb) - 1U), ftb);
+    }
+    else ec_encode(_fl, _fl + 1, _ft + 1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_enc_done() {
+    /*We output the minimum number of bits that ensures that the symbols encoded thus far will be decoded correctly
+      regardless of the bits that follow.*/
+    int32_t  l = EC_CODE_BITS - EC_ILOG(s_ecEnc.rng);
+    uint32_t msk = (EC_CODE_TOP - 1) >> l;
+    uint32_t end = (s_ecEnc.val + msk) & ~msk;
+    if((end | msk) >= s_ecEnc.val + s_ecEnc.rng) {
+        l++;
+        msk >>= 1;
+        end = (s_ecEnc.val + msk) & ~msk;
+    }
+    while(l > 0) {
+        ec_enc_carry_out((int32_t)(end >> EC_CODE_SHIFT));
+        end = (end << EC_SYM_BITS) & (EC_CODE_TOP - 1);
+        l -= EC_SYM_BITS;
+    }
+    /*If we have a buffered byte flush it into the output buffer.*/
+    if(s_ecEnc.rem >= 0 || s_ecEnc.ext > 0) ec_enc_carry_out(0);
+    /*If we have buffered extra bits, flush them as well.*/
+    uint32_t window = s_ecEnc.end_window;
+    int32_t  used = s_ecEnc.nend_bits;
+    while(used >= (int32_t)EC_SYM_BITS) {
+        s_ecEnc.error |= ec_write_byte_at_end(window & EC_SYM_MAX);
+        window >>= EC_SYM_BITS;
+        used -= EC_SYM_BITS;
+    }
+    /*Clear any excess space and add any remaining extra bits to the last byte.*/
+    if(!s_ecEnc.error) {
+        memset(s_ecEnc.buf + s_ecEnc.offs, 0, s_ecEnc.storage - s_ecEnc.offs - s_ecEnc.end_offs);
+        if(used > 0) {
+            /*If there's no range coder data at all, give up.*/
+            if(s_ecEnc.end_offs >= s_ecEnc.storage) s_ecEnc.error = -1;
+            else {
+                l = -l;
+                /*If we've busted, don't add too many extra bits to the last byte; it would corrupt the range
+                  coder data, and that's more important.*/
+                if(s_ecEnc.offs + s_ecEnc.end_offs >= s_ecEnc.storage && l < used) {
+                    window &= (1 << l) - 1;
+                    s_ecEnc.error = -1;
+                }
+                s_ecEnc.buf[s_ecEnc.storage - s_ecEnc.end_offs - 1] |= (uint8_t)window;
+            }
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void ec_laplace_encode(int32_t *value, uint32_t fs, int32_t decay) {
+    uint32_t fl = 0;
+    int32_t  val = *value;
+    if(val) {
+        int32_t s = -(val < 0);
+        int32_t i;
+        val = (val + s) ^ s;
+        fl = fs;
+        fs = ec_laplace_get_freq1(fs, decay);
+        /* Search the decaying part of the PDF.*/
+        for(i = 1; fs > 0 && i < val; i++) {
+            fs *= 2;
+            fl += fs + 2 * LAPLACE_MINP;
+            fs = (fs * (int32_t)decay) >> 15;
+        }
+        /* Everything beyond that has probability LAPLACE_MINP. */
+        if(!fs) {
+            int32_t ndi_max = (32768 - fl + LAPLACE_MINP - 1);
+            ndi_max = (ndi_max - s) >> 1;
+            int32_t di = _min(val - i, ndi_max - 1);
+            fl += (2 * di + 1 + s) * LAPLACE_MINP;
+            fs = _min(LAPLACE_MINP, 32768 - fl);
+            *value = (i + di + s) ^ s;
+        }
+        else {
+            fs += LAPLACE_MINP;
+            fl += fs & ~s;
+        }
+        assert(fl + fs <= 32768);
+        assert(fs > 0);
+    }
+    ec_encode_bin(fl, fl + fs, 15);
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                         A N A L Y S I S
+//----------------------------------------------------------------------------------------------------------------------
+
+/* The pre-emphasis of the decoder's deemphasis() inverted, the input is zero-stuffed up to 48 kHz. */
+static void celt_preemphasis(const int16_t *pcm, int32_t *inp, int32_t N) {
+    const int16_t coef0 = m_CELTMode.preemph[0];
+    const int32_t upsample = s_celtEnc->upsample;
+    int32_t m = s_celtEnc->preemph_mem;
+    for(int32_t i = 0; i < N; i++) {
+        int16_t x = (i % upsample) ? 0 : pcm[i / upsample];
+        inp[i] = SHL32(x, 12) - m;
+        m = MULT16_16(coef0, x) >> 3;
+    }
+    s_celtEnc->preemph_mem = m;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/* Forward MDCT, the counterpart of clt_mdct_backward(): window and fold the input to N/2, N/4 point complex FFT,
+   rotate. in: overlap + N/2 samples, out: N/2 coefficients. */
+static void clt_mdct_forward(int32_t *in, int32_t *out, int32_t overlap, int32_t shift) {
+    int32_t i;
+    int32_t N, N2, N4;
+    const kiss_fft_state *st = m_mdct_lookup.kfft[shift];
+    const int16_t *trig = m_mdct_lookup.trig;
+    const int16_t *window = window120;
+    int16_t scale = st->scale;
+    int32_t scale_shift = st->scale_shift - 1;
+
+    N = m_mdct_lookup.n;
+    for(i = 0; i < shift; i++) {
+        N >>= 1;
+        trig += N;
+    }
+    N2 = N >> 1;
+    N4 = N >> 2;
+    int32_t *f = out;                   // the folded input, out is written after the FFT only
+    kiss_fft_cpx *f2 = s_encFftBuff;
+
+    /* Consider the input to be composed of four blocks: [a, b, c, d] */
+    /* Window, shuffle, fold */
+    {
+        const int32_t *xp1 = in + (overlap >> 1);
+        const int32_t *xp2 = in + N2 - 1 + (overlap >> 1);
+        int32_t *yp = f;
+        const int16_t *wp1 = window + (overlap >> 1);
+        const int16_t *wp2 = window + (overlap >> 1) - 1;
+        for(i = 0; i < ((overlap + 3) >> 2); i++) {
+            /* Real part arranged as -d-cR, Imag part arranged as -b+aR*/
+            *yp++ = MULT16_32_Q15(*wp2, xp1[N2]) + MULT16_32_Q15(*wp1, *xp2);
+            *yp++ = MULT16_32_Q15(*wp1, *xp1) - MULT16_32_Q15(*wp2, xp2[-N2]);
+            xp1 += 2;
+            xp2 -= 2;
+            wp1 += 2;
+            wp2 -= 2;
+        }
+        wp1 = window;
+        wp2 = window + overlap - 1;
+        for(; i < N4 - ((overlap + 3) >> 2); i++) {
+            /* Real part arranged as a-bR, Imag part arranged as -c-dR */
+            *yp++ = *xp2;
+            *yp++ = *xp1;
+            xp1 += 2;
+            xp2 -= 2;
+        }
+        for(; i < N4; i++) {
+            /* Real part arranged as a-bR, Imag part arranged as -c-dR */
+            *yp++ = -MULT16_32_Q15(*wp1, xp1[-N2]) + MULT16_32_Q15(*wp2, *xp2);
+            *yp++ = MULT16_32_Q15(*wp2, *xp1) + MULT16_32_Q15(*wp1, xp2[N2]);
+            xp1 += 2;
+            xp2 -= 2;
+            wp1 += 2;
+            wp2 -= 2;
+        }
+    }
+    /* Pre-rotation */
+    {
+        int32_t *yp = f;
+        const int16_t *t = &trig[0];
+        for(i = 0; i < N4; i++) {
+            int16_t t0 = t[i];
+            int16_t t1 = t[N4 + i];
+            int32_t re = *yp++;
+            int32_t im = *yp++;
+            int32_t yr = S_MUL(re, t0) - S_MUL(im, t1);
+            int32_t yi = S_MUL(im, t0) + S_MUL(re, t1);
+            /* the 1/N4 of the FFT, with rounding (MULT16_32_Q16() of celt.h truncates to 32 bit before the shift) */
+            yr = (int32_t)(((int64_t)scale * yr) >> 16);
+            yi = (int32_t)(((int64_t)scale * yi) >> 16);
+            f2[st->bitrev[i]].r = (yr + ((1 << scale_shift) >> 1)) >> scale_shift;
+            f2[st->bitrev[i]].i = (yi + ((1 << scale_shift) >> 1)) >> scale_shift;
+        }
+    }
+
+    /* N/4 complex FFT, does not downscale anymore */
+    opus_fft_impl(st, f2);
+
+    /* Post-rotate */
+    {
+        const kiss_fft_cpx *fp = f2;
+        int32_t *yp1 = out;
+        int32_t *yp2 = out + N2 - 1;
+        const int16_t *t = &trig[0];
+        for(i = 0; i < N4; i++) {
+            int32_t yr = S_MUL(fp->i, t[N4 + i]) - S_MUL(fp->r, t[i]);
+            int32_t yi = S_MUL(fp->r, t[N4 + i]) + S_MUL(fp->i, t[i]);
+            *yp1 = yr;
+            *yp2 = yi;
+            fp++;
+            yp1 += 2;
+            yp2 -= 2;
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/* Band amplitudes (Q12 like the MDCT), normalised bands (Q14) and log2 energies (Q10, eMeans removed). */
+static void compute_band_energies(const int32_t *freq, int32_t *bandE, int32_t end, int32_t LM) {
+    for(int32_t i = 0; i < end; i++) {
+        int32_t j = eband5ms[i] << LM;
+        int32_t maxval = celt_maxabs32(&freq[j], (eband5ms[i + 1] - eband5ms[i]) << LM);
+        if(maxval > 0) {
+            int32_t shift = celt_ilog2(maxval) - 14 + (((logN400[i] >> BITRES) + LM + 1) >> 1);
+            int32_t sum = 0;
+            do {
+                int16_t x = (int16_t)VSHR32(freq[j], shift);
+                sum = MAC16_16(sum, x, x);
+            } while(++j < eband5ms[i + 1] << LM);
+            /* We're adding one here to ensure the normalized band isn't larger than unity norm */
+            bandE[i] = EPSILON + VSHR32(celt_sqrt(sum), -shift);
+        }
+        else bandE[i] = EPSILON;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void normalise_bands(const int32_t *freq, int16_t *X, const int32_t *bandE, int32_t end, int32_t M) {
+    for(int32_t i = 0; i < end; i++) {
+        int32_t shift = celt_zlog2(bandE[i]) - 13;
+        int16_t E = (int16_t)VSHR32(bandE[i], shift);
+        int16_t g = (int16_t)celt_rcp(SHL32(E, 3));
+        int32_t j = M * eband5ms[i];
+        do X[j] = (int16_t)MULT16_16_Q15(VSHR32(freq[j], shift - 1), g);
+        while(++j < M * eband5ms[i + 1]);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void amp2Log2(const int32_t *bandE, int16_t *bandLogE, int32_t end) {
+    /* bandE[] is Q12 but celt_log2() takes a Q14 input, +2.0 compensates */
+    for(int32_t i = 0; i < end; i++)
+        bandLogE[i] = celt_log2(bandE[i]) - SHL16((int16_t)eMeans[i], 6) + QCONST16(2.f, 10);
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                         E N E R G Y
+//----------------------------------------------------------------------------------------------------------------------
+
+/* The state update is that of unquant_coarse_energy(), including its rounding. */
+static void quant_coarse_energy(const int16_t *bandLogE, int16_t *oldEBands, int16_t *error, int32_t intra,
+                                int32_t LM, int32_t nbBytes) {
+    const uint8_t *prob_model = e_prob_model[LM][intra];
+    const int32_t  end = s_celtEnc->end;
+    int32_t prev = 0;
+    int32_t budget = nbBytes * 8;
+    int16_t coef, beta;
+    /* don't let the energy drop faster than the decoder would with too few bits */
+    int16_t max_decay = (int16_t)_min(QCONST16(16.f, 10), SHL32(nbBytes, 10 - 3));
+
+    if(ec_enc_tell() + 3 <= budget) ec_enc_bit_logp(intra, 3);
+    if(intra) {
+        coef = 0;
+        beta = beta_intra;
+    } else {
+        beta = beta_coef[LM];
+        coef = pred_coef[LM];
+    }
+
+    for(int32_t i = 0; i < end; i++) {
+        int16_t x = bandLogE[i];
+        int16_t oldE = _max(-QCONST16(9.f, 10), oldEBands[i]);
+        int32_t f = SHL32(EXTEND32(x), 7) - PSHR(MULT16_16(coef, oldE), 8) - prev;
+        /* Rounding to nearest integer here is really important! */
+        int32_t qi = (f + QCONST32(.5f, 10 + 7)) >> (10 + 7);
+        int16_t decay_bound = (int16_t)_max(-QCONST16(28.f, 10), (int32_t)oldEBands[i] - max_decay);
+        /* Prevent the energy from going down too quickly (e.g. for bands that have just one bin) */
+        if(qi < 0 && x < decay_bound) {
+            qi += (int32_t)SHR16(SUB16(decay_bound, x), 10);
+            if(qi > 0) qi = 0;
+        }
+        /* If we don't have enough bits to encode all the energy, just assume something safe. */
+        int32_t tell = ec_enc_tell();
+        int32_t bits_left = budget - tell - 3 * (end - i);
+        if(i != 0 && bits_left < 30) {
+            if(bits_left < 24) qi = _min(1, qi);
+            if(bits_left < 16) qi = _max(-1, qi);
+        }
+        if(budget - tell >= 15) {
+            int32_t pi = 2 * _min(i, 20);
+            ec_laplace_encode(&qi, prob_model[pi] << 7, prob_model[pi + 1] << 6);
+        }
+        else if(budget - tell >= 2) {
+            qi = _max(-1, _min(qi, 1));
+            ec_enc_icdf(2 * qi ^ -(qi < 0), small_energy_icdf, 2);
+        }
+        else if(budget - tell >= 1) {
+            qi = _min(0, qi);
+            ec_enc_bit_logp(-qi, 1);
+        }
+        else qi = -1;
+        error[i] = (int16_t)(((f + (1 << 6)) >> 7) - SHL16(qi, 10));
+        int32_t q = SHL32(EXTEND32(qi), 10);
+        int32_t tmp = PSHR(MULT16_16(coef, oldE), 8) + prev + SHL32(q, 7);
+        tmp = _max(-QCONST32(28.f, 10 + 7), tmp);
+        oldEBands[i] = PSHR(tmp, 7);
+        prev = prev + SHL32(q, 7) - MULT16_16(beta, PSHR(q, 8));
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void quant_fine_energy(int16_t *oldEBands, int16_t *error, const int32_t *fine_quant) {
+    for(int32_t i = 0; i < s_celtEnc->end; i++) {
+        if(fine_quant[i] <= 0) continue;
+        int16_t frac = 1 << fine_quant[i];
+        int32_t q2 = (error[i] + QCONST16(.5f, 10)) >> (10 - fine_quant[i]);
+        if(q2 > frac - 1) q2 = frac - 1;
+        if(q2 < 0) q2 = 0;
+        ec_enc_bits(q2, fine_quant[i]);
+        int16_t offset = SUB16(SHR32(SHL32(EXTEND32(q2), 10) + QCONST16(.5f, 10), fine_quant[i]), QCONST16(.5f, 10));
+        oldEBands[i] += offset;
+        error[i] -= offset;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void quant_energy_finalise(int16_t *oldEBands, int16_t *error, const int32_t *fine_quant,
+                                  const int32_t *fine_priority, int32_t bits_left) {
+    /* Use up the remaining bits */
+    for(int32_t prio = 0; prio < 2; prio++) {
+        for(int32_t i = 0; i < s_celtEnc->end && bits_left >= 1; i++) {
+            if(fine_quant[i] >= MAX_FINE_BITS || fine_priority[i] != prio) continue;
+            int32_t q2 = error[i] < 0 ? 0 : 1;
+            ec_enc_bits(q2, 1);
+            int16_t offset = SHR16(SHL16(q2, 10) - QCONST16(.5f, 10), fine_quant[i] + 1);
+            oldEBands[i] += offset;
+            error[i] -= offset;
+            bits_left--;
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                         A L L O C A T I O N
+//----------------------------------------------------------------------------------------------------------------------
+
+/* clt_compute_allocation() and interp_bits2pulses() of the decoder for C == 1, the skip decision is coded instead of
+   read: no band is skipped on purpose. */
+static int32_t compute_allocation(const int32_t *offsets, const int32_t *cap, int32_t alloc_trim, int32_t total,
+                                  int32_t *_balance, int32_t *bits, int32_t *ebits, int32_t *fine_priority,
+                                  int32_t LM) {
+    const int32_t end = s_celtEnc->end;
+    const int32_t len = m_CELTMode.nbEBands;
+    const int32_t alloc_floor = 1 << BITRES;
+    const int32_t logM = LM << BITRES;
+    int32_t bits1[21], bits2[21], thresh[21], trim_offset[21];
+    int32_t lo, hi, j, psum, done, left, percoeff, codedBands, balance;
+    int32_t skip_start = 0;
+
+    total = _max(total, 0);
+    /* Reserve a bit to signal the end of manually skipped bands. */
+    int32_t skip_rsv = total >= 1 << BITRES ? 1 << BITRES : 0;
+    total -= skip_rsv;
+
+    for(j = 0; j < end; j++) {
+        int32_t N = eband5ms[j + 1] - eband5ms[j];
+        /* Below this threshold, we're sure not to allocate any PVQ bits */
+        thresh[j] = _max(1 << BITRES, (3 * N << LM << BITRES) >> 4);
+        /* Tilt of the allocation curve */
+        trim_offset[j] = N * (alloc_trim - 5 - LM) * (end - j - 1) * (1 << (LM + BITRES)) >> 6;
+        /* Giving less resolution to single-coefficient bands because they get more benefit from having one coarse
+           value per coefficient*/
+        if(N << LM == 1) trim_offset[j] -= 1 << BITRES;
+    }
+    lo = 1;
+    hi = m_CELTMode.nbAllocVectors - 1;
+    do {
+        int32_t mid = (lo + hi) >> 1;
+        done = psum = 0;
+        for(j = end; j-- > 0;) {
+            int32_t N = eband5ms[j + 1] - eband5ms[j];
+            int32_t bitsj = N * band_allocation[mid * len + j] << LM >> 2;
+            if(bitsj > 0) bitsj = _max(0, bitsj + trim_offset[j]);
+            bitsj += offsets[j];
+            if(bitsj >= thresh[j] || done) {
+                done = 1;
+                /* Don't allocate more than we can actually use */
+                psum += _min(bitsj, cap[j]);
+            }
+            else if(bitsj >= 1 << BITRES) psum += 1 << BITRES;
+        }
+        if(psum > total) hi = mid - 1;
+        else lo = mid + 1;
+    } while(lo <= hi);
+    hi = lo--;
+    for(j = 0; j < end; j++) {
+        int32_t N = eband5ms[j + 1] - eband5ms[j];
+        int32_t bits1j = N * band_allocation[lo * len + j] << LM >> 2;
+        int32_t bits2j = hi >= m_CELTMode.nbAllocVectors ? cap[j] : N * band_allocation[hi * len + j] << LM >> 2;
+        if(bits1j > 0) bits1j = _max(0, bits1j + trim_offset[j]);
+        if(bits2j > 0) bits2j = _max(0, bits2j + trim_offset[j]);
+        if(lo > 0) bits1j += offsets[j];
+        bits2j += offsets[j];
+        if(offsets[j] > 0) skip_start = j;
+        bits2j = _max(0, bits2j - bits1j);
+        bits1[j] = bits1j;
+        bits2[j] = bits2j;
+    }
+
+    /* interp_bits2pulses() */
+    lo = 0;
+    hi = 1 << ALLOC_STEPS;
+    for(int32_t i = 0; i < ALLOC_STEPS; i++) {
+        int32_t mid = (lo + hi) >> 1;
+        psum = done = 0;
+        for(j = end; j-- > 0;) {
+            int32_t tmp = bits1[j] + (mid * bits2[j] >> ALLOC_STEPS);
+            if(tmp >= thresh[j] || done) {
+                done = 1;
+                psum += _min(tmp, cap[j]);
+            }
+            else if(tmp >= alloc_floor) psum += alloc_floor;
+        }
+        if(psum > total) hi = mid;
+        else lo = mid;
+    }
+    psum = done = 0;
+    for(j = end; j-- > 0;) {
+        int32_t tmp = bits1[j] + (lo * bits2[j] >> ALLOC_STEPS);
+        if(tmp < thresh[j] && !done) tmp = tmp >= alloc_floor ? alloc_floor : 0;
+        else done = 1;
+        tmp = _min(tmp, cap[j]);
+        bits[j] = tmp;
+        psum += tmp;
+    }
+    /* Decide which bands to skip, working backwards from the end. */
+    for(codedBands = end;; codedBands--) {
+        j = codedBands - 1;
+        if(j <= skip_start) {
+            /* Give the bit we reserved to end skipping back. */
+            total += skip_rsv;
+            break;
+        }
+        left = total - psum;
+        percoeff = left / (eband5ms[codedBands] - eband5ms[0]);
+        left -= (eband5ms[codedBands] - eband5ms[0]) * percoeff;
+        int32_t rem = _max(left - (eband5ms[j] - eband5ms[0]), 0);
+        int32_t band_width = eband5ms[codedBands] - eband5ms[j];
+        int32_t band_bits = bits[j] + percoeff * band_width + rem;
+        /* Only code a skip decision if we're above the threshold for this band, otherwise it is force-skipped. */
+        if(band_bits >= _max(thresh[j], alloc_floor + (1 << BITRES))) {
+            ec_enc_bit_logp(1, 1);
+            break;
+        }
+        /* Reclaim the bits originally allocated to this band. */
+        psum -= bits[j];
+        if(band_bits >= alloc_floor) {
+            psum += alloc_floor;
+            bits[j] = alloc_floor;
+        }
+        else bits[j] = 0;
+    }
+
+    /* Allocate the remaining bits */
+    left = total - psum;
+    percoeff = left / (eband5ms[codedBands] - eband5ms[0]);
+    left -= (eband5ms[codedBands] - eband5ms[0]) * percoeff;
+    for(j = 0; j < codedBands; j++) bits[j] += percoeff * (eband5ms[j + 1] - eband5ms[j]);
+    for(j = 0; j < codedBands; j++) {
+        int32_t tmp = _min(left, eband5ms[j + 1] - eband5ms[j]);
+        bits[j] += tmp;
+        left -= tmp;
+    }
+
+    balance = 0;
+    for(j = 0; j < codedBands; j++) {
+        int32_t N = (eband5ms[j + 1] - eband5ms[j]) << LM;
+        int32_t bit = bits[j] + balance;
+        int32_t excess;
+        if(N > 1) {
+            excess = _max(bit - cap[j], 0);
+            bits[j] = bit - excess;
+            int32_t NClogN = N * (logN400[j] + logM);
+            /* Offset for the number of fine bits by log2(N)/2 + 21 (FINE_OFFSET) */
+            int32_t offset = (NClogN >> 1) - N * 21;
+            /* N=2 is the only point that doesn't match the curve */
+            if(N == 2) offset += N << BITRES >> 2;
+            /* Changing the offset for allocating the second and third fine energy bit */
+            if(bits[j] + offset < N * 2 << BITRES) offset += NClogN >> 2;
+            else if(bits[j] + offset < N * 3 << BITRES) offset += NClogN >> 3;
+            /* Divide with rounding */
+            ebits[j] = (_max(0, bits[j] + offset + (N << (BITRES - 1))) / N) >> BITRES;
+            /* Make sure not to bust */
+            if(ebits[j] > (bits[j] >> BITRES)) ebits[j] = bits[j] >> BITRES;
+            /* More than that is useless because that's about as far as PVQ can go */
+            ebits[j] = _min(ebits[j], MAX_FINE_BITS);
+            /* If we rounded down or capped this band, make it a candidate for the final fine energy pass */
+            fine_priority[j] = ebits[j] * (N << BITRES) >= bits[j] + offset;
+            /* Remove the allocated fine bits; the rest are assigned to PVQ */
+            bits[j] -= ebits[j] << BITRES;
+        }
+        else {
+            /* For N=1, all bits go to fine energy except for a single sign bit */
+            excess = _max(0, bit - (1 << BITRES));
+            bits[j] = bit - excess;
+            ebits[j] = 0;
+            fine_priority[j] = 1;
+        }
+        /* Fine energy can't take advantage of the re-balancing in quant_all_bands_enc(), do it here.*/
+        if(excess > 0) {
+            int32_t extra_fine = _min(excess >> BITRES, MAX_FINE_BITS - ebits[j]);
+            ebits[j] += extra_fine;
+            int32_t extra_bits = extra_fine << BITRES;
+            fine_priority[j] = extra_bits >= excess - balance;
+            excess -= extra_bits;
+        }
+        balance = excess;
+    }
+    *_balance = balance;
+    /* The skipped bands use all their bits for fine energy. */
+    for(; j < end; j++) {
+        ebits[j] = bits[j] >> BITRES;
+        bits[j] = 0;
+        fine_priority[j] = ebits[j] < 1;
+    }
+    return codedBands;
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                         P V Q
+//----------------------------------------------------------------------------------------------------------------------
+
+/* Pyramid vector search: the K pulses that match the direction of X best. yy is kept in 32 bit. */
+static void op_pvq_search(int16_t *X, int32_t *iy, int32_t K, int32_t N) {
+    int32_t *y = s_encIyBuff + 176;
+    int32_t *signx = s_encIyBuff + 2 * 176;
+    int32_t i, j;
+    int32_t xy = 0, yy = 0;
+    int32_t pulsesLeft = K;
+
+    /* Get rid of the sign */
+    int32_t sum = 0;
+    for(j = 0; j < N; j++) {
+        signx[j] = X[j] < 0;
+        X[j] = (int16_t)abs(X[j]);
+        iy[j] = 0;
+        y[j] = 0;
+    }
+    /* Do a pre-search by projecting on the pyramid */
+    if(K > (N >> 1)) {
+        for(j = 0; j < N; j++) sum += X[j];
+        /* If X is too small, just replace it with a pulse at 0 */
+        if(sum <= K) {
+            X[0] = QCONST16(1.f, 14);
+            for(j = 1; j < N; j++) X[j] = 0;
+            sum = QCONST16(1.f, 14);
+        }
+        int16_t rcp = (int16_t)(((int64_t)K * celt_rcp(sum)) >> 16);
+        for(j = 0; j < N; j++) {
+            /* It's really important to round *towards zero* here */
+            iy[j] = MULT16_16_Q15(X[j], rcp);
+            y[j] = iy[j];
+            yy += y[j] * y[j];
+            xy += X[j] * y[j];
+            y[j] *= 2;
+            pulsesLeft -= iy[j];
+        }
+    }
+    /* This should never happen, but just in case it does (e.g. on silence) we fill the first bin with pulses. */
+    if(pulsesLeft > N + 3) {
+        yy += pulsesLeft * pulsesLeft + pulsesLeft * y[0];
+        iy[0] += pulsesLeft;
+        pulsesLeft = 0;
+    }
+    for(i = 0; i < pulsesLeft; i++) {
+        int32_t rshift = 1 + celt_ilog2(K - pulsesLeft + i + 1);
+        int32_t best_id = 0;
+        /* The squared magnitude term gets added anyway, so we might as well add it outside the loop */
+        yy += 1;
+        /* Rxy/sqrt(Ryy) is maximised as Rxy^2/Ryy, compared without a division */
+        int32_t Rxy = (xy + X[0]) >> rshift;
+        int32_t best_num = MULT16_16_Q15(Rxy, Rxy);
+        int32_t best_den = yy + y[0];
+        for(j = 1; j < N; j++) {
+            Rxy = (xy + X[j]) >> rshift;
+            Rxy = MULT16_16_Q15(Rxy, Rxy);
+            int32_t Ryy = yy + y[j];
+            if((int64_t)best_den * Rxy > (int64_t)Ryy * best_num) {
+                best_den = Ryy;
+                best_num = Rxy;
+                best_id = j;
+            }
+        }
+        xy += X[best_id];
+        yy += y[best_id];
+        y[best_id] += 2;
+        iy[best_id]++;
+    }
+    /* Put the original sign back */
+    for(j = 0; j < N; j++) iy[j] = (iy[j] ^ -signx[j]) + signx[j];
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/* The index of a pulse vector, the inverse of cwrsi(). */
+static uint32_t icwrs(int32_t _n, const int32_t *_y) {
+    int32_t  j = _n - 1;
+    uint32_t i = _y[j] < 0;
+    int32_t  k = abs(_y[j]);
+    do {
+        j--;
+        i += CELT_PVQ_U(_n - j, k);
+        k += abs(_y[j]);
+        if(_y[j] < 0) i += CELT_PVQ_U(_n - j, k + 1);
+    } while(j > 0);
+    return i;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void alg_quant(int16_t *X, int32_t N, int32_t K, int32_t spread) {
+    int32_t *iy = s_encIyBuff;
+    assert(N <= 176);
+    exp_rotation(X, N, 1, 1, K, spread);
+    op_pvq_search(X, iy, K, N);
+    ec_enc_uint(icwrs(N, iy), CELT_PVQ_V(N, K));
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+/* compute_theta() of the decoder for a mono split: the angle between the energies of both halves, triangular pdf */
+static void compute_theta_enc(int16_t *X, int16_t *Y, int32_t N, int32_t *b, int32_t LM, int32_t band, int32_t *itheta_,
+                          int32_t *delta_, int32_t *qalloc_) {
+    int32_t pulse_cap = logN400[band] + LM * (1 << BITRES);
+    int32_t offset = (pulse_cap >> 1) - QTHETA_OFFSET;
+    int32_t qn = compute_qn(N, *b, offset, pulse_cap, 0);
+    int32_t tell = ec_enc_tell_frac();
+    int32_t itheta = 0;
+    int32_t delta;
+    if(qn != 1) {
+        int16_t mid = (int16_t)_min(32767, celt_sqrt(EPSILON + celt_inner_prod(X, X, N)));
+        int16_t side = (int16_t)_min(32767, celt_sqrt(EPSILON + celt_inner_prod(Y, Y, N)));
+        if(side == 0) itheta = 0;
+        else if(mid == 0) itheta = 16384;
+        else itheta = MULT16_16_Q15(QCONST16(0.63662f, 15), celt_atan2p(side, mid));
+        itheta = (itheta * qn + 8192) >> 14;
+        int32_t ft = ((qn >> 1) + 1) * ((qn >> 1) + 1);
+        int32_t fs = itheta <= (qn >> 1) ? itheta + 1 : qn + 1 - itheta;
+        int32_t fl = itheta <= (qn >> 1) ? itheta * (itheta + 1) >> 1 : ft - ((qn + 1 - itheta) * (qn + 2 - itheta) >> 1);
+        ec_encode(fl, fl + fs, ft);
+        itheta = itheta * 16384 / qn;
+    }
+    *qalloc_ = ec_enc_tell_frac() - tell;
+    *b -= *qalloc_;
+    if(itheta == 0) delta = -16384;
+    else if(itheta == 16384) delta = 16384;
+    else {
+        int32_t imid = bitexact_cos((int16_t)itheta);
+        int32_t iside = bitexact_cos((int16_t)(16384 - itheta));
+        /* This is the mid vs side allocation that minimizes squared error in that band. */
+        delta = FRAC_MUL16((N - 1) << 7, bitexact_log2tan(iside, imid));
+    }
+    *itheta_ = itheta;
+    *delta_ = delta;
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void quant_partition_enc(int16_t *X, int32_t N, int32_t b, int32_t LM, int32_t band, int32_t spread) {
+    const uint8_t *cache = cache_bits50 + cache_index50[(LM + 1) * m_CELTMode.nbEBands + band];
+    /* If we need 1.5 more bit than we can produce, split the band in two. */
+    if(LM != -1 && b > cache[cache[0]] + 12 && N > 2) {
+        int32_t itheta, delta, qalloc;
+        N >>= 1;
+        int16_t *Y = X + N;
+        LM -= 1;
+        compute_theta_enc(X, Y, N, &b, LM, band, &itheta, &delta, &qalloc);
+        int32_t mbits = _max(0, _min(b, (b - delta) / 2));
+        int32_t sbits = b - mbits;
+        s_encRemainingBits -= qalloc;
+        int32_t rebalance = s_encRemainingBits;
+        if(mbits >= sbits) {
+            quant_partition_enc(X, N, mbits, LM, band, spread);
+            rebalance = mbits - (rebalance - s_encRemainingBits);
+            if(rebalance > 3 << BITRES && itheta != 0) sbits += rebalance - (3 << BITRES);
+            quant_partition_enc(Y, N, sbits, LM, band, spread);
+        }
+        else {
+            quant_partition_enc(Y, N, sbits, LM, band, spread);
+            rebalance = sbits - (rebalance - s_encRemainingBits);
+            if(rebalance > 3 << BITRES && itheta != 16384) mbits += rebalance - (3 << BITRES);
+            quant_partition_enc(X, N, mbits, LM, band, spread);
+        }
+        return;
+    }
+    /* This is the basic no-split case */
+    int32_t q = bits2pulses(band, LM, b);
+    int32_t curr_bits = pulses2bits(band, LM, q);
+    s_encRemainingBits -= curr_bits;
+    /* Ensures we can never bust the budget */
+    while(s_encRemainingBits < 0 && q > 0) {
+        s_encRemainingBits += curr_bits;
+        q--;
+        curr_bits = pulses2bits(band, LM, q);
+        s_encRemainingBits -= curr_bits;
+    }
+    if(q != 0) alg_quant(X, N, get_pulses(q), spread);
+}
+//----------------------------------------------------------------------------------------------------------------------
+
+static void quant_all_bands_enc(int16_t *X_, const int32_t *pulses, int32_t spread, int32_t total_bits, int32_t balance,
+                            int32_t LM, int32_t codedBands) {
+    const int32_t M = 1 << LM;
+    for(int32_t i = 0; i < s_celtEnc->end; i++) {
+        int32_t b;
+        int32_t N = M * (eband5ms[i + 1] - eband5ms[i]);
+        int32_t tell = ec_enc_tell_frac();
+        /* Compute how many bits we want to allocate to this band */
+        if(i != 0) balance -= tell;
+        int32_t remaining_bits = total_bits - tell - 1;
+        s_encRemainingBits = remaining_bits;
+        if(i <= codedBands - 1) {
+            int32_t curr_balance = celt_sudiv(balance, _min(3, codedBands - i));
+            b = _max(0, _min(16383, _min(remaining_bits + 1, pulses[i] + curr_balance)));
+        }
+        else b = 0;
+        quant_partition_enc(X_ + M * eband5ms[i], N, b, LM, i, spread);
+        balance += pulses[i] + tell;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+//                                         F R A M E
+//----------------------------------------------------------------------------------------------------------------------
+
+/* pcm: frame_size samples at the rate of celt_encoder_init(), 2.5 ms frames are not supported. The packet gets the
+   TOC byte (CELT only, code 0, mono) and nbBytes - 1 bytes of range coder data. */
+int32_t celt_encode(const int16_t *pcm, int32_t frame_size, uint8_t *packet, int32_t nbBytes) {
+    int32_t i, LM;
+    const int32_t end = s_celtEnc ? s_celtEnc->end : 0;
+    const int32_t overlap = m_CELTMode.overlap;
+
+    if(!s_celtEnc || !pcm || !packet) return ERR_OPUS_CELT_BAD_ARG;
+    int32_t N = frame_size * s_celtEnc->upsample;
+    for(LM = 1; LM <= m_CELTMode.maxLM; LM++)
+        if(m_CELTMode.shortMdctSize << LM == N) break;
+    if(LM > m_CELTMode.maxLM) {log_e("frame size %li not supported", (long)frame_size); return ERR_OPUS_CELT_BAD_ARG;}
+    if(nbBytes < 3 || nbBytes > 1276) return ERR_OPUS_CELT_BAD_ARG;
+
+    /* TOC: config 16 + 4 * bandwidth + frame size, NB 13, WB 17, SWB 19, FB 21 bands */
+    int32_t bw = end <= 13 ? 0 : end <= 17 ? 1 : end <= 19 ? 2 : 3;
+    packet[0] = (uint8_t)((16 + 4 * bw + LM) << 3);
+    nbBytes--;
+    ec_enc_init(packet + 1, nbBytes);
+    int32_t total_bits = nbBytes * 8;
+
+    /* MDCT of the last overlap and this frame */
+    int32_t *in = s_encInBuff;
+    memcpy(in, s_celtEnc->in_mem, overlap * sizeof(int32_t));
+    celt_preemphasis(pcm, in + overlap, N);
+    memcpy(s_celtEnc->in_mem, in + N, overlap * sizeof(int32_t));
+    int32_t *freq = s_encFreqBuff;
+    clt_mdct_forward(in, freq, overlap, m_CELTMode.maxLM - LM);
+    if(s_celtEnc->upsample != 1) {
+        int32_t bound = N / s_celtEnc->upsample;
+        for(i = 0; i < bound; i++) freq[i] *= s_celtEnc->upsample;
+        for(; i < N; i++) freq[i] = 0;
+    }
+
+    int32_t bandE[21];
+    int16_t bandLogE[21];
+    int16_t error[21];
+    compute_band_energies(freq, bandE, end, LM);
+    amp2Log2(bandE, bandLogE, end);
+    int16_t *X = s_encXBuff;
+    normalise_bands(freq, X, bandE, end, 1 << LM);
+
+    /* silence, postfilter and transient flags, all zero */
+    ec_enc_bit_logp(0, 15);
+    if(ec_enc_tell() + 16 <= total_bits) ec_enc_bit_logp(0, 1);
+    if(ec_enc_tell() + 3 <= total_bits) ec_enc_bit_logp(0, 3);
+
+    int16_t *oldBandE = s_celtEnc->oldBandE;
+    quant_coarse_energy(bandLogE, oldBandE, error, s_celtEnc->intra, LM, nbBytes);
+    s_celtEnc->intra = 0;
+
+    /* tf_res all zero: no change bits, no tf_select (as tf_decode() reads them) */
+    {
+        uint32_t budget = total_bits;
+        uint32_t tell = ec_enc_tell();
+        int32_t  logp = 4;
+        int32_t  tf_select_rsv = tell + logp + 1 <= budget;
+        budget -= tf_select_rsv;
+        for(i = 0; i < end; i++) {
+            if(tell + logp <= budget) {
+                ec_enc_bit_logp(0, logp);
+                tell = ec_enc_tell();
+            }
+            logp = 5;
+        }
+        if(tf_select_rsv && tf_select_table[LM][0] != tf_select_table[LM][2]) ec_enc_bit_logp(0, 1);
+    }
+
+    const int32_t spread = 2;  // SPREAD_NORMAL
+    if(ec_enc_tell() + 4 <= total_bits) ec_enc_icdf(spread, spread_icdf, 5);
+
+    int32_t cap[21];
+    init_caps(cap, LM, 1);
+    int32_t offsets[21] = {0};
+    {
+        /* no dynalloc boost: one zero flag per band while there are bits for it */
+        int32_t tell = ec_enc_tell_frac();
+        int32_t total = total_bits << BITRES;
+        for(i = 0; i < end; i++) {
+            if(tell + (6 << BITRES) < total && 0 < cap[i]) {
+                ec_enc_bit_logp(0, 6);
+                tell = ec_enc_tell_frac();
+            }
+        }
+        const int32_t alloc_trim = 5;
+        if(tell + (6 << BITRES) <= total) ec_enc_icdf(alloc_trim, trim_icdf, 7);
+    }
+
+    int32_t bits = (nbBytes * 8 << BITRES) - ec_enc_tell_frac() - 1;
+    int32_t pulses[21], fine_quant[21], fine_priority[21];
+    int32_t balance;
+    int32_t codedBands = compute_allocation(offsets, cap, 5, bits, &balance, pulses, fine_quant, fine_priority, LM);
+
+    quant_fine_energy(oldBandE, error, fine_quant);
+    quant_all_bands_enc(X, pulses, spread, nbBytes * (8 << BITRES), balance, LM, codedBands);
+    quant_energy_finalise(oldBandE, error, fine_quant, fine_priority, nbBytes * 8 - ec_enc_tell());
+    ec_enc_done();
+    if(s_ecEnc.error) {log_e("celt encoder busted"); return ERR_OPUS_CELT_INTERNAL_ERROR;}
+    return nbBytes + 1;
+}
@@ -0,0 +1,17 @@
+/*
+ * celt_encoder.h
+ * mono CELT encoder for speech upload, long blocks only, packets as CELT-only Opus frames
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "celt.h"
+
+#define CELT_ENC_LOOKAHEAD 120      // samples at 48 kHz between input and decoded output (the MDCT overlap)
+
+bool     CELTEncoder_AllocateBuffers(void);
+void     CELTEncoder_FreeBuffers();
+int32_t  celt_encoder_init(int32_t sampleRate, int32_t end);    // 8000...48000 Hz, end band 13 (NB) ... 21 (FB)
+void     celt_encoder_reset();                                  // a new stream: the next frame is coded intra
+int32_t  celt_encode(const int16_t *pcm, int32_t frame_size, uint8_t *packet, int32_t nbBytes); // returns nbBytes or < 0
@@ -10,6 +10,7 @@
 //----------------------------------------------------------------------------------------------------------------------
 #include "opus_decoder.h"
 #include "celt.h"
+#include "../ogg_demuxer/ogg_demuxer.h"
 #include "Arduino.h"
 #include <vector>
 
@@ -18,6 +19,7 @@
 const uint32_t CELT_SET_END_BAND_REQUEST   = 10012;
 const uint32_t CELT_SET_START_BAND_REQUEST = 10010;
 const uint32_t CELT_SET_SIGNALLING_REQUEST = 10016;
+const uint32_t CELT_SET_CHANNELS_REQUEST   = 10008;
 const uint32_t CELT_GET_AND_CLEAR_ERROR_REQUEST = 10007;
 
 enum {OPUS_BANDWIDTH_NARROWBAND = 8000, OPUS_BANDWIDTH_MEDIUMBAND = 12000, OPUS_BANDWIDTH_WIDEBAND = 16000};
@@ -39,6 +41,7 @@ uint8_t   s_opusPageNr = 0;
 uint8_t   s_frameCount = 0;
 uint16_t  s_opusOggHeaderSize = 0;
 uint16_t  s_bandWidth = 0;
+uint16_t  s_opusPreSkip = 0;
 uint32_t  s_opusSamplerate = 0;
 uint32_t  s_opusSegmentLength = 0;
 uint32_t  s_opusCurrentFilePos = 0;
@@ -51,21 +54,17 @@ uint32_t  s_opusBlockLen = 0;
 char     *s_opusChbuf = NULL;
 int32_t   s_opusValidSamples = 0;
 
-uint16_t *s_opusSegmentTable;
-uint8_t   s_opusSegmentTableSize = 0;
-int16_t   s_opusSegmentTableRdPtr = -1;
 int8_t    s_opusError = 0;
 float     s_opusCompressionRatio = 0;
 
 std::vector <uint32_t>s_opusBlockPicItem;
+ogg_page_t s_opusOggPage;
 
 bool OPUSDecoder_AllocateBuffers(){
     const uint32_t CELT_SET_END_BAND_REQUEST = 10012;
     const uint32_t CELT_SET_SIGNALLING_REQUEST = 10016;
     s_opusChbuf = (char*)malloc(512);
     if(!CELTDecoder_AllocateBuffers()) {log_e("CELT not init"); return false;}
-    s_opusSegmentTable = (uint16_t*)malloc(256 * sizeof(uint16_t));
-    if(!s_opusSegmentTable) {log_e("CELT not init"); return false;}
     CELTDecoder_ClearBuffer();
     OPUSDecoder_ClearBuffers();
     s_opusError = celt_decoder_init(2); if(s_opusError < 0) {log_e("CELT not init"); return false;}
@@ -87,12 +86,10 @@ bool OPUSDecoder_AllocateBuffers(){
 }
 void OPUSDecoder_FreeBuffers(){
     if(s_opusChbuf)        {free(s_opusChbuf);        s_opusChbuf = NULL;}
-    if(s_opusSegmentTable) {free(s_opusSegmentTable); s_opusSegmentTable = NULL;}
     CELTDecoder_FreeBuffers();
 }
 void OPUSDecoder_ClearBuffers(){
     if(s_opusChbuf)        memset(s_opusChbuf, 0, 512);
-    if(s_opusSegmentTable) memset(s_opusSegmentTable, 0, 256 * sizeof(int16_t));
 }
 void OPUSsetDefaults(){
     s_f_opusParseOgg = false;
@@ -104,11 +101,11 @@ void OPUSsetDefaults(){
     s_mode = 0;
     s_opusSamplerate = 0;
     s_bandWidth = 0;
+    s_opusPreSkip = 0;
     s_opusSegmentLength = 0;
     s_opusValidSamples = 0;
-    s_opusSegmentTableSize = 0;
     s_opusOggHeaderSize = 0;
-    s_opusSegmentTableRdPtr = -1;
+    OGG_clearPage(&s_opusOggPage);
     s_opusCountCode = 0;
     s_opusBlockPicPos = 0;
     s_opusCurrentFilePos = 0;
@@ -121,6 +118,13 @@ void OPUSsetDefaults(){
     s_opusError = 0;
     s_opusBlockPicItem.clear(); s_opusBlockPicItem.shrink_to_fit();
 }
+void OPUSDecoderSeekReset(){
+    // the next call of OPUSDecode() starts with a new Ogg page, the stream parameters are kept
+    OGG_clearPage(&s_opusOggPage);
+    s_frameCount = 0;
+    s_opusCountCode = 0;
+    s_opusValidSamples = 0;
+}
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -156,7 +160,7 @@ int OPUSDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf) {
 
     if(s_frameCount > 0) return opusDecodePage3(inbuf, bytesLeft, segmLen, outbuf); // decode audio, next part
 
-    if(!s_opusSegmentTableSize) {
+    if(!OGG_packetsLeft(&s_opusOggPage)) {
         s_f_opusParseOgg = false;
         s_opusCountCode = 0;
         ret = OPUSparseOGG(inbuf, bytesLeft);
@@ -164,11 +168,7 @@ int OPUSDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf) {
         inbuf += s_opusOggHeaderSize;
     }
 
-    if(s_opusSegmentTableSize > 0) {
-        s_opusSegmentTableRdPtr++;
-        s_opusSegmentTableSize--;
-        segmLen = s_opusSegmentTable[s_opusSegmentTableRdPtr];
-    }
+    if(OGG_packetsLeft(&s_opusOggPage)) segmLen = OGG_nextPacket(&s_opusOggPage);
 
     if(s_opusPageNr == 0) { // OpusHead
         ret = opusDecodePage0(inbuf, bytesLeft, segmLen);
@@ -179,7 +179,9 @@ int OPUSDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf) {
         s_opusRemainBlockPicLen = s_opusBlockPicLen;
         *bytesLeft -= (segmLen - s_blockPicLenUntilFrameEnd);
         s_opusCommentBlockSize = s_blockPicLenUntilFrameEnd;
-        s_opusPageNr++;
+        // only a packet that goes on over the page end has parts on the next pages, else the audio follows
+        bool continued = !OGG_packetsLeft(&s_opusOggPage) && s_opusOggPage.lastPacketOpen;
+        s_opusPageNr += continued ? 1 : 2;
         ret = OPUS_PARSE_OGG_DONE;
     }
     else if(s_opusPageNr == 2) { // OpusComment Subsequent Pages
@@ -193,9 +195,6 @@ int OPUSDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf) {
     }
     else { ; }
 
-    if(s_opusSegmentTableSize == 0) {
-        s_opusSegmentTableRdPtr = -1; // back to the parking position
-    }
     return ret;
 }
 
@@ -262,6 +261,7 @@ int opusDecodePage3(uint8_t* inbuf, int* bytesLeft, uint32_t segmentLength, shor
 //    celt_decoder_ctl(CELT_SET_START_BAND_REQUEST, endband);
     if (s_mode == MODE_CELT_ONLY){
         celt_decoder_ctl(CELT_SET_END_BAND_REQUEST, endband);
+        celt_decoder_ctl(CELT_SET_CHANNELS_REQUEST, s_f_opusStereoFlag ? 2 : 1); // mono streams are copied to both channels
     }
     else if(s_mode == MODE_SILK_ONLY){
         // silk_InitDecoder();
@@ -618,6 +618,9 @@ uint8_t OPUSGetChannels(){
 uint32_t OPUSGetSampRate(){
     return s_opusSamplerate;
 }
+uint16_t OPUSGetPreSkip(){ // samples at 48kHz to drop at the start, granule positions include them
+    return s_opusPreSkip;
+}
 uint8_t OPUSGetBitsPerSample(){
     return 16;
 }
@@ -789,8 +792,9 @@ int parseOpusHead(uint8_t *inbuf, int nBytes){  // reference https://wiki.xiph.o
 
     if(channelCount == 0 || channelCount >2) return ERR_OPUS_CHANNELS_OUT_OF_RANGE;
     s_opusChannels = channelCount;
-    if(sampleRate != 48000) return ERR_OPUS_INVALID_SAMPLERATE;
-    s_opusSamplerate = sampleRate;
+    s_opusPreSkip = preSkip;
+    (void)sampleRate;                                    // the rate of the source, the decoder always gives 48 kHz
+    s_opusSamplerate = 48000;
     if(channelMap > 1) return ERR_OPUS_EXTRA_CHANNELS_UNSUPPORTED;
 
     (void)outputGain;
@@ -801,61 +805,20 @@ int parseOpusHead(uint8_t *inbuf, int nBytes){  // reference https://wiki.xiph.o
 //----------------------------------------------------------------------------------------------------------------------
 int OPUSparseOGG(uint8_t *inbuf, int *bytesLeft){  // reference https://www.xiph.org/ogg/doc/rfc3533.txt
 
-    int idx = OPUS_specialIndexOf(inbuf, "OggS", 6);
-    if(idx != 0) return ERR_OPUS_DECODER_ASYNC;
-
-    int16_t segmentTableWrPtr = -1;
-
-    uint8_t  version            = *(inbuf +  4); (void) version;
-    uint8_t  headerType         = *(inbuf +  5); (void) headerType;
-    uint64_t granulePosition    = (uint64_t)*(inbuf + 13) << 56;  // granule_position: an 8 Byte field containing -
-             granulePosition   += (uint64_t)*(inbuf + 12) << 48;  // position information. For an audio stream, it MAY
-             granulePosition   += (uint64_t)*(inbuf + 11) << 40;  // contain the total number of PCM samples encoded
-             granulePosition   += (uint64_t)*(inbuf + 10) << 32;  // after including all frames finished on this page.
-             granulePosition   += *(inbuf +  9) << 24;  // This is a hint for the decoder and gives it some timing
-             granulePosition   += *(inbuf +  8) << 16;  // and position information. A special value of -1 (in two's
-             granulePosition   += *(inbuf +  7) << 8;   // complement) indicates that no packets finish on this page.
-             granulePosition   += *(inbuf +  6); (void) granulePosition;
-    uint32_t bitstreamSerialNr  = *(inbuf + 17) << 24;  // bitstream_serial_number: a 4 Byte field containing the
-             bitstreamSerialNr += *(inbuf + 16) << 16;  // unique serial number by which the logical bitstream
-             bitstreamSerialNr += *(inbuf + 15) << 8;   // is identified.
-             bitstreamSerialNr += *(inbuf + 14); (void) bitstreamSerialNr;
-    uint32_t pageSequenceNr     = *(inbuf + 21) << 24;  // page_sequence_number: a 4 Byte field containing the sequence
-             pageSequenceNr    += *(inbuf + 20) << 16;  // number of the page so the decoder can identify page loss
-             pageSequenceNr    += *(inbuf + 19) << 8;   // This sequence number is increasing on each logical bitstream
-             pageSequenceNr    += *(inbuf + 18); (void) pageSequenceNr;
-    uint32_t CRCchecksum        = *(inbuf + 25) << 24;
-             CRCchecksum       += *(inbuf + 24) << 16;
-             CRCchecksum       += *(inbuf + 23) << 8;
-             CRCchecksum       += *(inbuf + 22); (void) CRCchecksum;
-    uint8_t  pageSegments       = *(inbuf + 26);        // giving the number of segment entries
-
-    // read the segment table (contains pageSegments bytes),  1...251: Length of the frame in bytes,
-    // 255: A second byte is needed.  The total length is first_byte + second byte
-    s_opusSegmentLength = 0;
-    segmentTableWrPtr = -1;
-
-    for(int i = 0; i < pageSegments; i++){
-        int n = *(inbuf + 27 + i);
-        while(*(inbuf + 27 + i) == 255){
-            i++;
-            if(i == pageSegments) break;
-            n+= *(inbuf + 27 + i);
-        }
-        segmentTableWrPtr++;
-        s_opusSegmentTable[segmentTableWrPtr] = n;
-        s_opusSegmentLength += n;
-    }
-    s_opusSegmentTableSize = segmentTableWrPtr + 1;
-    s_opusCompressionRatio = (float)(960 * 2 * pageSegments)/s_opusSegmentLength;  // const 960 validBytes out
+    ogg_page_t* page = &s_opusOggPage;
+    if(OGG_parsePage(inbuf, *bytesLeft, page) != OGG_PAGE_OK) return ERR_OPUS_DECODER_ASYNC;
+
+    // OPUSDecode() takes the packet lengths from the page (OGG_nextPacket), continued lacing is already resolved
+    s_opusSegmentLength = page->bodySize;
+    s_opusCompressionRatio = (float)(960 * 2 * page->pageSegments)/s_opusSegmentLength;  // const 960 validBytes out
 
-    s_f_continuedPage = headerType & 0x01; // set: page contains data of a packet continued from the previous page
-    s_f_firstPage     = headerType & 0x02; // set: this is the first page of a logical bitstream (bos)
-    s_f_lastPage      = headerType & 0x04; // set: this is the last page of a logical bitstream (eos)
+    s_f_continuedPage = page->continuedPage;
+    s_f_firstPage     = page->firstPage;
+    s_f_lastPage      = page->lastPage;
 
 //  log_i("firstPage %i, continuedPage %i, lastPage %i",s_f_firstPage, s_f_continuedPage, s_f_lastPage);
 
-    uint16_t headerSize   = pageSegments + 27;
+    uint16_t headerSize   = page->headerSize;
     *bytesLeft           -= headerSize;
     s_opusCurrentFilePos += headerSize;
     s_opusOggHeaderSize   = headerSize;
@@ -872,7 +835,7 @@ int OPUSparseOGG(uint8_t *inbuf, int *bytesLeft){  // reference https://www.xiph
 //----------------------------------------------------------------------------------------------------------------------
 int OPUSFindSyncWord(unsigned char *buf, int nBytes){
     // assume we have a ogg wrapper
-    int idx = OPUS_specialIndexOf(buf, "OggS", nBytes);
+    int idx = OGG_findSyncWord(buf, nBytes);
     if(idx >= 0){ // Magic Word found
     //    log_i("OggS found at %i", idx);
         s_f_opusParseOgg = true;
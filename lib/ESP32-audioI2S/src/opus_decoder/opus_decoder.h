@@ -36,6 +36,7 @@ bool             OPUSDecoder_AllocateBuffers();
 void             OPUSDecoder_FreeBuffers();
 void             OPUSDecoder_ClearBuffers();
 void             OPUSsetDefaults();
+void             OPUSDecoderSeekReset();
 int              OPUSDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf);
 int              opusDecodePage0(uint8_t* inbuf, int* bytesLeft, uint32_t segmentLength);
 int              opusDecodePage3(uint8_t* inbuf, int* bytesLeft, uint32_t segmentLength, short *outbuf);
@@ -45,6 +46,7 @@ int8_t           opus_FramePacking_Code2(uint8_t *inbuf, int *bytesLeft, short *
 int8_t           opus_FramePacking_Code3(uint8_t *inbuf, int *bytesLeft, short *outbuf, int packetLen, uint16_t samplesPerFrame, uint8_t* frameCount);
 uint8_t          OPUSGetChannels();
 uint32_t         OPUSGetSampRate();
+uint16_t         OPUSGetPreSkip();
 uint8_t          OPUSGetBitsPerSample();
 uint32_t         OPUSGetBitRate();
 uint16_t         OPUSGetOutputSamps();
@@ -0,0 +1,282 @@
+/*
+ * resampler.cpp
+ * fixed point polyphase sample rate converter
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "resampler.h"
+
+// prefer PSRAM
+#define __malloc_heap_psram(size) \
+    heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT|MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT|MALLOC_CAP_INTERNAL)
+
+static const float RS_KAISER_BETA = 8.6f; // stopband ~ -90dB
+
+//----------------------------------------------------------------------------------------------------------------------
+static float bessel_i0(float x) {
+    float sum = 1, term = 1;
+    for(int k = 1; k < 30; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if(term < sum * 1e-9f) break;
+    }
+    return sum;
+}
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while(b) { uint32_t t = a % b; a = b; b = t; }
+    return a;
+}
+static inline int16_t sat16(int32_t v) {
+    v = (v + (1 << (RS_COEF_SHIFT - 1))) >> RS_COEF_SHIFT;
+    if(v > 32767) return 32767;
+    if(v < -32768) return -32768;
+    return v;
+}
+//----------------------------------------------------------------------------------------------------------------------
+AudioResampler::AudioResampler() {
+    memset(m_bank, 0, sizeof(m_bank));
+}
+AudioResampler::~AudioResampler() {
+    freeBanks();
+    if(m_work) {free(m_work); m_work = NULL;}
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioResampler::freeBanks() {
+    for(int i = 0; i < RS_BANK_CACHE; i++) {
+        if(m_bank[i].coef) free(m_bank[i].coef);
+        memset(&m_bank[i], 0, sizeof(rs_bank_t));
+    }
+    m_cur = NULL;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioResampler::setRates(uint32_t inRate, uint32_t outRate, uint8_t channels) {
+
+    if(!inRate || !outRate || (channels != 1 && channels != 2)) return false;
+    if(inRate == m_inRate && outRate == m_outRate && channels == m_channels) return true;
+    m_inRate = inRate;
+    m_outRate = outRate;
+    m_channels = channels;
+
+    if(inRate == outRate) {
+        m_mode = RS_BYPASS;
+        reset();
+        return true;
+    }
+
+    // downsampling needs a lower cutoff and, for the same transition band, proportionally more taps
+    float    ratio = (float)outRate / inRate;
+    float    cutoff = 0.91f * min(1.0f, ratio);
+    uint16_t taps = RS_TAPS;
+    if(ratio < 1.0f) taps = min((uint16_t)RS_MAX_TAPS, (uint16_t)((RS_TAPS / ratio + 1) / 2 * 2));
+
+    uint32_t g = gcd(inRate, outRate);
+    uint32_t L = outRate / g;
+    uint32_t M = inRate / g;
+
+    if(L <= RS_MAX_PHASES) { // exact polyphase
+        m_mode = RS_POLYPHASE;
+        m_cur = getBank(L, M, taps, cutoff);
+        m_stepInt = M / L;
+        m_stepFrac = M % L;
+    }
+    else { // arbitrary ratio
+        m_mode = RS_ARBITRARY;
+        m_cur = getBank(RS_ARB_PHASES + 1, 0, taps, cutoff);
+        uint64_t step = ((uint64_t)inRate << 32) / outRate;
+        m_stepInt = step >> 32;
+        m_stepFrac = (uint32_t)step;
+    }
+    if(!m_cur) {
+        log_e("oom");
+        m_mode = RS_BYPASS;
+        return false;
+    }
+    m_L = L;
+    m_M = M;
+
+    if(!m_work || m_taps != taps) {
+        if(m_work) free(m_work);
+        m_taps = taps;
+        m_workCap = m_taps + RS_CHUNK_FRAMES;
+        m_work = (int16_t*)malloc(m_workCap * 2 * sizeof(int16_t)); // internal RAM, accessed for every tap
+        if(!m_work) {
+            log_e("oom");
+            m_mode = RS_BYPASS;
+            return false;
+        }
+    }
+    reset();
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+AudioResampler::rs_bank_t* AudioResampler::getBank(uint32_t L, uint32_t M, uint16_t taps, float cutoff) {
+    m_useCount++;
+    for(int i = 0; i < RS_BANK_CACHE; i++) {
+        rs_bank_t* b = &m_bank[i];
+        if(b->coef && b->L == L && b->M == M && b->taps == taps && b->cutoff == cutoff) {
+            b->lastUse = m_useCount;
+            return b;
+        }
+    }
+    rs_bank_t* b = &m_bank[0]; // replace the least recently used bank
+    for(int i = 1; i < RS_BANK_CACHE; i++) {
+        if(!m_bank[i].coef) { b = &m_bank[i]; break; }
+        if(m_bank[i].lastUse < b->lastUse) b = &m_bank[i];
+    }
+    if(b->coef) {free(b->coef); b->coef = NULL;}
+    b->coef = (int16_t*)__malloc_heap_psram(L * taps * sizeof(int16_t));
+    if(!b->coef) return NULL;
+    b->L = L;
+    b->M = M;
+    b->taps = taps;
+    b->cutoff = cutoff;
+    b->lastUse = m_useCount;
+    buildBank(b);
+    return b;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioResampler::buildBank(rs_bank_t* b) {
+    // Kaiser windowed sinc. Phase p produces the sample at (D + p / phases) input frames after the window start,
+    // D = taps / 2 - 1. Every phase is normalised to a DC gain of exactly 1.
+    uint32_t phases = (b->M) ? b->L : RS_ARB_PHASES;
+    float    D = b->taps / 2 - 1;
+    float    half = b->taps / 2.0f;
+    float    i0beta = bessel_i0(RS_KAISER_BETA);
+    float    h[RS_MAX_TAPS];
+
+    for(uint32_t p = 0; p < b->L; p++) {
+        float frac = (float)p / phases;
+        float sum = 0;
+        for(int j = 0; j < b->taps; j++) {
+            float t = j - D - frac;
+            float x = b->cutoff * t;
+            float s = (fabsf(x) < 1e-6f) ? 1.0f : sinf((float)PI * x) / ((float)PI * x);
+            float r = t / half;
+            float w = (fabsf(r) < 1.0f) ? bessel_i0(RS_KAISER_BETA * sqrtf(1.0f - r * r)) / i0beta : 0;
+            h[j] = b->cutoff * s * w;
+            sum += h[j];
+        }
+        int16_t* c = b->coef + p * b->taps;
+        for(int j = 0; j < b->taps; j++) c[j] = (int16_t)lrintf(h[j] / sum * (1 << RS_COEF_SHIFT));
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioResampler::reset() {
+    // D zeros in front, the first output sample is aligned with the first input sample
+    m_pos = 0;
+    m_phase = 0;
+    m_fill = 0;
+    if(m_work && m_mode != RS_BYPASS) {
+        m_fill = m_taps / 2 - 1;
+        memset(m_work, 0, m_fill * m_channels * sizeof(int16_t));
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioResampler::maxOutputFrames(uint32_t inFrames) {
+    if(m_mode == RS_BYPASS) return inFrames;
+    return (uint32_t)(((uint64_t)(inFrames + m_fill) * m_outRate) / m_inRate) + 2;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioResampler::runPolyphase(int16_t* out) {
+    const uint16_t T = m_taps;
+    const uint32_t L = m_L;
+    const int16_t* coef = m_cur->coef;
+    uint32_t n = 0;
+
+    if(m_channels == 2) {
+        while(m_pos + T <= m_fill) {
+            const int16_t* x = m_work + m_pos * 2;
+            const int16_t* c = coef + m_phase * T;
+            int32_t accL = 0, accR = 0;
+            for(int j = 0; j < T; j++) {
+                accL += x[2 * j] * c[j];
+                accR += x[2 * j + 1] * c[j];
+            }
+            *out++ = sat16(accL);
+            *out++ = sat16(accR);
+            n++;
+            m_pos += m_stepInt;
+            m_phase += m_stepFrac;
+            if(m_phase >= L) { m_phase -= L; m_pos++; }
+        }
+    }
+    else {
+        while(m_pos + T <= m_fill) {
+            const int16_t* x = m_work + m_pos;
+            const int16_t* c = coef + m_phase * T;
+            int32_t acc = 0;
+            for(int j = 0; j < T; j++) acc += x[j] * c[j];
+            *out++ = sat16(acc);
+            n++;
+            m_pos += m_stepInt;
+            m_phase += m_stepFrac;
+            if(m_phase >= L) { m_phase -= L; m_pos++; }
+        }
+    }
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioResampler::runArbitrary(int16_t* out) {
+    // two neighbouring phases, the results are interpolated with the next 15 bits of the Q32 position
+    const uint16_t T = m_taps;
+    const int16_t* coef = m_cur->coef;
+    const uint8_t  ch = m_channels;
+    uint32_t n = 0;
+
+    while(m_pos + T <= m_fill) {
+        uint32_t p = m_phase >> 24;                 // 256 phases
+        int32_t  f = (m_phase >> 9) & 0x7FFF;       // Q15 between phase p and p + 1
+        const int16_t* c0 = coef + p * T;
+        const int16_t* c1 = c0 + T;
+        for(int k = 0; k < ch; k++) {
+            const int16_t* x = m_work + m_pos * ch + k;
+            int32_t acc0 = 0, acc1 = 0;
+            for(int j = 0; j < T; j++) {
+                acc0 += x[j * ch] * c0[j];
+                acc1 += x[j * ch] * c1[j];
+            }
+            int32_t y0 = sat16(acc0);
+            int32_t y1 = sat16(acc1);
+            *out++ = y0 + (((y1 - y0) * f) >> 15);
+        }
+        n++;
+        uint32_t old = m_phase;
+        m_phase += m_stepFrac;
+        m_pos += m_stepInt + (m_phase < old);       // carry of the fraction
+    }
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioResampler::process(const int16_t* in, uint32_t inFrames, int16_t* out) {
+
+    if(m_mode == RS_BYPASS) {
+        if(in != out) memcpy(out, in, inFrames * m_channels * sizeof(int16_t));
+        return inFrames;
+    }
+    const uint8_t ch = m_channels;
+    uint32_t outFrames = 0;
+
+    while(inFrames) {
+        uint32_t n = min(inFrames, m_workCap - m_fill);
+        memcpy(m_work + m_fill * ch, in, n * ch * sizeof(int16_t));
+        m_fill += n;
+        in += n * ch;
+        inFrames -= n;
+
+        if(m_mode == RS_POLYPHASE) outFrames += runPolyphase(out + outFrames * ch);
+        else                       outFrames += runArbitrary(out + outFrames * ch);
+
+        // keep the frames that are still needed by the next window
+        if(m_pos >= m_fill) {
+            m_pos -= m_fill;
+            m_fill = 0;
+        }
+        else {
+            memmove(m_work, m_work + m_pos * ch, (m_fill - m_pos) * ch * sizeof(int16_t));
+            m_fill -= m_pos;
+            m_pos = 0;
+        }
+    }
+    return outFrames;
+}
@@ -0,0 +1,71 @@
+/*
+ * resampler.h
+ * fixed point polyphase sample rate converter, converts the decoder output to one fixed I2S rate
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  exact ratios L/M (out/in) with L <= RS_MAX_PHASES use one filter phase per output position,
+ *  all other ratios use RS_ARB_PHASES phases and interpolate linearly between two neighbouring phases
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+
+#define RS_TAPS         32     // taps per phase when upsampling, scaled up with the ratio when downsampling
+#define RS_MAX_TAPS     128
+#define RS_MAX_PHASES   441    // covers 8k, 16k, 32k, 48k <-> 44.1k and 8k ... 48k, 22.05k -> 48k
+#define RS_ARB_PHASES   256    // arbitrary ratio
+#define RS_CHUNK_FRAMES 256    // input frames per work block
+#define RS_BANK_CACHE   3      // filter banks are kept, switching between 44.1k and 48k tracks costs no rebuild
+#define RS_COEF_SHIFT   15     // Q15 coefficients, int32 accumulator (the taps of a phase sum up to < 2.0)
+
+enum : uint8_t {RS_BYPASS = 0, RS_POLYPHASE = 1, RS_ARBITRARY = 2};
+
+class AudioResampler {
+
+public:
+    AudioResampler();
+    ~AudioResampler();
+    bool     setRates(uint32_t inRate, uint32_t outRate, uint8_t channels); // builds or reuses a filter bank
+    void     reset();                                       // clear the history (stop, seek)
+    bool     isBypass() { return m_mode == RS_BYPASS; }
+    uint8_t  getMode() { return m_mode; }
+    uint32_t maxOutputFrames(uint32_t inFrames);            // upper bound for the next process() call
+    uint32_t process(const int16_t* in, uint32_t inFrames, int16_t* out); // interleaved, returns output frames
+
+protected:
+    typedef struct _rs_bank{
+        uint32_t L;            // phases (RS_ARB_PHASES + 1 for arbitrary ratios)
+        uint32_t M;            // 0 for arbitrary ratios
+        uint16_t taps;
+        float    cutoff;       // relative to the input Nyquist frequency
+        int16_t* coef;         // [phase][taps]
+        uint32_t lastUse;
+    } rs_bank_t;
+
+    rs_bank_t* getBank(uint32_t L, uint32_t M, uint16_t taps, float cutoff);
+    void       buildBank(rs_bank_t* b);
+    void       freeBanks();
+    uint32_t   runPolyphase(int16_t* out);
+    uint32_t   runArbitrary(int16_t* out);
+
+    rs_bank_t  m_bank[RS_BANK_CACHE];
+    rs_bank_t* m_cur = NULL;
+    uint8_t    m_mode = RS_BYPASS;
+    uint8_t    m_channels = 2;
+    uint16_t   m_taps = RS_TAPS;
+    uint32_t   m_inRate = 0;
+    uint32_t   m_outRate = 0;
+    uint32_t   m_L = 1;
+    uint32_t   m_M = 1;
+    uint32_t   m_stepInt = 0;      // input frames per output frame, integer part
+    uint32_t   m_stepFrac = 0;     // polyphase: M % L, arbitrary: Q32 fraction
+    uint32_t   m_phase = 0;        // polyphase: 0 ... L-1, arbitrary: Q32 fraction
+    int16_t*   m_work = NULL;      // history + new input, interleaved
+    uint32_t   m_workCap = 0;      // frames
+    uint32_t   m_fill = 0;         // frames in m_work
+    uint32_t   m_pos = 0;          // first frame of the next filter window
+    uint32_t   m_useCount = 0;
+};
@@ -0,0 +1,290 @@
+/*
+ * seek_index.cpp
+ * frame positions of mp3 and m4a files, sidecar file on the SD card
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "seek_index.h"
+#include "../mp3_decoder/mp3_decoder.h"
+
+// prefer PSRAM
+#define __malloc_heap_psram(size) \
+    heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT|MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT|MALLOC_CAP_INTERNAL)
+
+//----------------------------------------------------------------------------------------------------------------------
+AudioSeekIndex::AudioSeekIndex() {
+}
+AudioSeekIndex::~AudioSeekIndex() {
+    reset();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::reset() {
+    if(m_file) m_file.close();
+    if(m_path) {free(m_path); m_path = NULL;}
+    if(m_buff) {free(m_buff); m_buff = NULL;}
+    m_pos.clear();
+    m_pos.shrink_to_fit();
+    m_fs = NULL;
+    m_state = SI_NONE;
+    m_type = 0;
+    m_frames = 0;
+    m_spf = 0;
+    m_framesPerEntry = 1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::open(fs::FS& fs, const char* path) {
+    reset();
+    m_fs = &fs;
+    m_path = strdup(path);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSeekIndex::beginMP3(uint32_t dataStart) {
+    // the interval and the samples per frame come from the first frame header, see scanMP3()
+    return begin(SI_MP3, dataStart);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSeekIndex::beginM4A(uint32_t dataStart, uint32_t stszPos, uint32_t stszEntries, uint32_t sampleRate) {
+    // the samples are stored one after the other from dataStart on, as m4a_correctResumeFilePos() assumes
+    if(!stszPos || !stszEntries) return false;
+    m_stszPos = stszPos;
+    m_stszLeft = stszEntries;
+    m_spf = 1024;
+    setInterval(sampleRate);
+    return begin(SI_M4A, dataStart);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSeekIndex::begin(uint8_t type, uint32_t dataStart) {
+    if(!m_fs || !m_path || m_state != SI_NONE) return false;
+    m_file = m_fs->open(m_path);
+    if(!m_file) {
+        m_state = SI_FAILED;
+        return false;
+    }
+    m_type = type;
+    m_dataStart = dataStart;
+    m_fileSize = m_file.size();
+    m_lastWrite = m_file.getLastWrite();
+    if(load()) {
+        m_file.close();
+        m_state = SI_READY;
+        return true;
+    }
+    m_buff = (uint8_t*)__malloc_heap_psram(SI_SCAN_BYTES);
+    if(!m_buff) {
+        log_e("oom");
+        m_file.close();
+        m_state = SI_FAILED;
+        return false;
+    }
+    m_pos.clear();
+    m_frames = 0;
+    m_scanPos = dataStart;
+    m_f_first = true;
+    m_state = SI_SCAN;
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::setInterval(uint32_t sampleRate) {
+    m_framesPerEntry = max((uint32_t)1, (uint32_t)((uint64_t)sampleRate * SI_INTERVAL_MS / 1000 / m_spf));
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::addEntry(uint32_t pos) {
+    // called for every frame, frames on the grid of m_framesPerEntry are stored
+    if(m_frames % m_framesPerEntry) return;
+    if(m_pos.size() >= SI_MAX_ENTRIES) { // very long file, keep every second entry
+        for(uint32_t i = 0; i < m_pos.size() / 2; i++) m_pos[i] = m_pos[2 * i];
+        m_pos.resize(m_pos.size() / 2);
+        m_framesPerEntry *= 2;
+        if(m_frames % m_framesPerEntry) return;
+    }
+    m_pos.push_back(pos);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::scanStep() {
+    if(m_state == SI_SCAN) {
+        if(m_type == SI_MP3) scanMP3();
+        else scanM4A();
+        return;
+    }
+    if(m_state == SI_SAVE) { // one loop() later, the sidecar file is written
+        if(!save()) log_w("seek index not saved");
+        m_state = SI_READY;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::scanMP3() {
+    // only the frame headers are evaluated, every frame begins where the previous one ends. Bytes that are not a
+    // header (damaged frames, ID3v1 or APE tag at the end) are skipped one by one, as the decoder does.
+    m_file.seek(m_scanPos);
+    int32_t n = m_file.read(m_buff, SI_SCAN_BYTES);
+    if(n < 4) { finish(); return; }
+    int32_t i = 0;
+
+    if(m_f_first) { // the Xing/Info frame holds no audio, the decoder gets the data behind it
+        m_f_first = false;
+        int sync = MP3FindSyncWord(m_buff, n);
+        if(sync < 0) { finish(); return; }
+        MP3XingInfo_t xi;
+        if(MP3GetXingInfo(m_buff + sync, n - sync, &xi) != ERR_MP3_NONE) { finish(); return; }
+        m_spf = xi.samplesPerFrame;
+        setInterval(xi.samprate);
+        i = sync + xi.frameLen;
+    }
+    while(i + 4 <= n) {
+        int len = MP3GetFrameSize(m_buff + i, NULL);
+        if(len <= 0) { i++; continue; }
+        addEntry(m_scanPos + i);
+        m_frames++;
+        i += len;
+    }
+    m_scanPos += i;
+    if(n < SI_SCAN_BYTES) finish(); // end of file
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::scanM4A() {
+    // stsz: one big endian uint32 per sample (aac frame)
+    uint32_t cnt = min(m_stszLeft, (uint32_t)(SI_SCAN_BYTES / 4));
+    m_file.seek(m_stszPos);
+    if(m_file.read(m_buff, cnt * 4) != cnt * 4) { finish(); return; }
+    for(uint32_t i = 0; i < cnt; i++) {
+        uint8_t* p = m_buff + 4 * i;
+        addEntry(m_scanPos);
+        m_frames++;
+        m_scanPos += (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    m_stszPos += cnt * 4;
+    m_stszLeft -= cnt;
+    if(!m_stszLeft) finish();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::finish() {
+    m_file.close();
+    if(m_buff) {free(m_buff); m_buff = NULL;}
+    m_state = m_pos.size() ? SI_SAVE : SI_FAILED;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t AudioSeekIndex::find(uint32_t frame, uint32_t* entryFrame) {
+    if(m_pos.empty()) return -1;
+    uint32_t j = frame / m_framesPerEntry;
+    if(j >= m_pos.size()) {
+        if(m_state != SI_READY) return -1; // not scanned yet
+        j = m_pos.size() - 1;
+    }
+    if(entryFrame) *entryFrame = j * m_framesPerEntry;
+    return m_pos[j];
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t AudioSeekIndex::frameAt(uint32_t filePos) {
+    // binary search, the frames between two entries are interpolated linearly
+    if(m_pos.empty() || filePos < m_pos[0]) return -1;
+    int32_t lo = 0, hi = m_pos.size() - 1;
+    while(lo < hi) {
+        int32_t mid = (lo + hi + 1) >> 1;
+        if(m_pos[mid] <= filePos) lo = mid;
+        else hi = mid - 1;
+    }
+    uint32_t frame = lo * m_framesPerEntry;
+    if(lo + 1 < (int32_t)m_pos.size()) {
+        frame += (uint64_t)(filePos - m_pos[lo]) * m_framesPerEntry / (m_pos[lo + 1] - m_pos[lo]);
+    }
+    else {
+        if(m_state != SI_READY) return -1; // behind the scanned part
+        if(m_fileSize > m_pos[lo] && m_frames > frame) { // the last frames end at the end of the file
+            frame += (uint64_t)(filePos - m_pos[lo]) * (m_frames - frame) / (m_fileSize - m_pos[lo]);
+        }
+        frame = min(frame, m_frames);
+    }
+    return frame;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSeekIndex::sidecarName(char* name) {
+    uint32_t hash = 2166136261UL; // FNV-1a
+    for(const char* p = m_path; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619UL;
+    sprintf(name, SI_DIR "/%08lX.idx", (unsigned long)hash);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSeekIndex::load() {
+    char name[32];
+    sidecarName(name);
+    if(!m_fs->exists(name)) return false;
+    File f = m_fs->open(name);
+    if(!f) return false;
+
+    si_header_t h;
+    bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h);
+    ok = ok && h.magic == SI_MAGIC && h.type == m_type && h.fileSize == m_fileSize && h.lastWrite == m_lastWrite;
+    ok = ok && h.dataStart == m_dataStart && h.entries && h.entries <= SI_MAX_ENTRIES && h.framesPerEntry;
+    if(ok) {
+        m_pos.resize(h.entries);
+        m_pos[0] = h.firstPos;
+        uint8_t  b[64];
+        uint32_t n = 0, k = 0;
+        for(uint32_t i = 1; ok && i < h.entries; i++) {
+            uint32_t d = 0;
+            uint8_t  shift = 0;
+            while(true) {
+                if(k == n) { // next block
+                    n = f.read(b, sizeof(b));
+                    k = 0;
+                    if(!n) { ok = false; break; }
+                }
+                d |= (uint32_t)(b[k] & 0x7F) << shift;
+                if(!(b[k++] & 0x80)) break;
+                shift += 7;
+                if(shift > 28) { ok = false; break; }
+            }
+            m_pos[i] = m_pos[i - 1] + d;
+        }
+    }
+    f.close();
+    if(!ok) {
+        m_pos.clear();
+        return false;
+    }
+    m_frames = h.frames;
+    m_framesPerEntry = h.framesPerEntry;
+    m_spf = h.samplesPerFrame;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSeekIndex::save() {
+    char name[32];
+    sidecarName(name);
+    if(!m_fs->exists(SI_DIR)) m_fs->mkdir(SI_DIR);
+    File f = m_fs->open(name, FILE_WRITE);
+    if(!f) return false;
+
+    si_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SI_MAGIC;
+    h.fileSize = m_fileSize;
+    h.lastWrite = m_lastWrite;
+    h.dataStart = m_dataStart;
+    h.frames = m_frames;
+    h.entries = m_pos.size();
+    h.framesPerEntry = m_framesPerEntry;
+    h.samplesPerFrame = m_spf;
+    h.type = m_type;
+    h.firstPos = m_pos[0];
+
+    // an entry spans some kB, with the interval doubled for long files at a high bitrate it can be more than 64 kB
+    uint8_t  b[64 + 5];
+    uint32_t n = 0;
+    bool     ok = f.write((uint8_t*)&h, sizeof(h)) == sizeof(h);
+    for(uint32_t i = 1; ok && i < m_pos.size(); i++) {
+        uint32_t d = m_pos[i] - m_pos[i - 1];
+        while(d > 0x7F) {
+            b[n++] = (d & 0x7F) | 0x80;
+            d >>= 7;
+        }
+        b[n++] = d;
+        if(n >= 64 || i == m_pos.size() - 1) {
+            ok = f.write(b, n) == n;
+            n = 0;
+        }
+    }
+    f.close();
+    if(!ok) m_fs->remove(name);
+    return ok;
+}
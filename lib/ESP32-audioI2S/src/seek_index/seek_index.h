@@ -0,0 +1,88 @@
+/*
+ * seek_index.h
+ * frame positions of mp3 and m4a files, built in the background while playing and kept in a sidecar file
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  one entry every SI_INTERVAL_MS (a fixed number of frames), so the position of frame n is entry n / framesPerEntry
+ *  mp3: the frame headers are walked through with a second file handle, m4a: the stsz table is read in blocks
+ *  sidecar: SI_DIR/<hash of the path>.idx, header + differences between the entries, 7 bits per byte, the highest bit
+ *  says that a byte follows (a difference of 0x3FFF and less has 2 bytes)
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+#include <FS.h>
+#include <vector>
+
+#define SI_INTERVAL_MS    250
+#define SI_MAX_ENTRIES    8192       // if there are more, the interval is doubled
+#define SI_SCAN_BYTES     8192       // file bytes per scanStep()
+#define SI_DIR            "/.seekidx"
+#define SI_MAGIC          0x32584953 // "SIX2", "SIX1" had 16 bit differences
+
+enum : uint8_t {SI_NONE = 0, SI_SCAN = 1, SI_SAVE = 2, SI_READY = 3, SI_FAILED = 4}; // states
+enum : uint8_t {SI_MP3 = 1, SI_M4A = 2};
+
+class AudioSeekIndex {
+
+public:
+    AudioSeekIndex();
+    ~AudioSeekIndex();
+    void     reset();
+    void     open(fs::FS& fs, const char* path);                        // the audio file, nothing is read here
+    bool     beginMP3(uint32_t dataStart);                              // behind the ID3 tags, returns true if loaded
+    bool     beginM4A(uint32_t dataStart, uint32_t stszPos, uint32_t stszEntries, uint32_t sampleRate);
+    void     scanStep();                                                // background work, audio task
+    bool     isBusy() { return m_state == SI_SCAN || m_state == SI_SAVE; }
+    bool     isReady() { return m_state == SI_READY; }
+    int32_t  find(uint32_t frame, uint32_t* entryFrame);               // position of an indexed frame <= frame, -1: unknown
+    int32_t  frameAt(uint32_t filePos);                                 // frame that contains filePos, -1: not indexed yet
+    uint32_t getFrames() { return m_frames; }                           // all frames when ready, indexed so far otherwise
+    uint16_t getSamplesPerFrame() { return m_spf; }                     // m4a: 1024, twice as much is decoded with SBR
+
+protected:
+    typedef struct __attribute__((packed)) _si_header{
+        uint32_t magic;
+        uint32_t fileSize;
+        uint32_t lastWrite;
+        uint32_t dataStart;
+        uint32_t frames;
+        uint16_t entries;
+        uint16_t framesPerEntry;
+        uint16_t samplesPerFrame;
+        uint8_t  type;
+        uint8_t  reserved;
+        uint32_t firstPos;          // entry 0, the others follow as differences (varint)
+    } si_header_t;
+
+    bool     begin(uint8_t type, uint32_t dataStart);
+    void     setInterval(uint32_t sampleRate);
+    void     addEntry(uint32_t pos);
+    void     scanMP3();
+    void     scanM4A();
+    void     finish();
+    bool     load();
+    bool     save();
+    void     sidecarName(char* name);
+
+    fs::FS*               m_fs = NULL;
+    char*                 m_path = NULL;
+    File                  m_file;               // second handle, the playing file keeps its position
+    uint8_t*              m_buff = NULL;        // SI_SCAN_BYTES
+    std::vector<uint32_t> m_pos;                // file position of frame n * m_framesPerEntry
+    uint8_t               m_state = SI_NONE;
+    uint8_t               m_type = 0;
+    bool                  m_f_first = true;     // mp3: skip the Xing frame
+    uint16_t              m_framesPerEntry = 1;
+    uint16_t              m_spf = 0;
+    uint32_t              m_frames = 0;
+    uint32_t              m_scanPos = 0;        // next frame
+    uint32_t              m_fileSize = 0;
+    uint32_t              m_lastWrite = 0;
+    uint32_t              m_dataStart = 0;
+    uint32_t              m_stszPos = 0;        // m4a: next stsz entry
+    uint32_t              m_stszLeft = 0;
+};
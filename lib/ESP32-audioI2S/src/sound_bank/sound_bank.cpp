@@ -0,0 +1,374 @@
+/*
+ * sound_bank.cpp
+ * decoded PCM cache for short clips, LRU within a memory budget
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "sound_bank.h"
+#include "../mp3_decoder/mp3_decoder.h"
+
+// prefer PSRAM
+#define __malloc_heap_psram(size) \
+    heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT|MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT|MALLOC_CAP_INTERNAL)
+
+//----------------------------------------------------------------------------------------------------------------------
+static uint32_t nameHash(const char* name) {
+    uint32_t hash = 2166136261UL; // FNV-1a
+    for(const char* p = name; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619UL;
+    return hash;
+}
+static inline uint16_t rd16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static inline uint32_t rd32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+//----------------------------------------------------------------------------------------------------------------------
+AudioSoundBank::AudioSoundBank() {
+    memset(m_sound, 0, sizeof(m_sound));
+    m_mutex = xSemaphoreCreateMutex();
+    m_loadMutex = xSemaphoreCreateMutex();
+}
+AudioSoundBank::~AudioSoundBank() {
+    clear();
+    if(m_dec) {free(m_dec); m_dec = NULL;}
+    vSemaphoreDelete(m_mutex);
+    vSemaphoreDelete(m_loadMutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSoundBank::begin(AudioMixer* mixer, uint32_t rate, uint32_t budget) {
+    m_mixer = mixer;
+    m_rate = constrain(rate, 8000, 48000);
+    setBudget(budget);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSoundBank::setBudget(uint32_t bytes) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    m_budget = bytes;
+    evict(0);
+    xSemaphoreGive(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioSoundBank::load(fs::FS& fs, const char* path, bool mp3Busy) {
+    if(contains(path)) return SB_OK;
+    uint32_t t = micros();
+    File file = fs.open(path);
+    if(!file) return SB_ERR_FILE;
+    uint32_t len = file.size();
+    if(len == 0 || len > SB_MAX_FILE) {
+        file.close();
+        return len ? SB_ERR_MEMORY : SB_ERR_FILE;
+    }
+    uint8_t* data = (uint8_t*)__malloc_heap_psram(len);
+    if(!data) {
+        file.close();
+        log_e("oom");
+        return SB_ERR_MEMORY;
+    }
+    uint32_t got = file.read(data, len);
+    file.close();
+    int8_t res = (got == len) ? decode(path, data, len, mp3Busy) : SB_ERR_FILE;
+    free(data);
+    if(res == SB_OK) m_stats.loadUs = micros() - t;
+    return res;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioSoundBank::loadMemory(const char* name, const uint8_t* data, uint32_t len, bool mp3Busy) {
+    if(contains(name)) return SB_OK;
+    uint32_t t = micros();
+    int8_t res = decode(name, data, len, mp3Busy);
+    if(res == SB_OK) m_stats.loadUs = micros() - t;
+    return res;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioSoundBank::play(const char* name, uint8_t type, float gain, bool count) {
+    // the trigger: a table lookup and a mixer slot, the mixer reads the PCM from the bank
+    uint32_t t = micros();
+    uint32_t hash = nameHash(name);
+    int8_t res;
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    int8_t i = lookup(name, hash);
+    if(i < 0) {
+        if(count) m_stats.misses++;
+        res = SB_ERR_MISS;
+    }
+    else {
+        sb_sound_t* s = &m_sound[i];
+        if(count) m_stats.hits++;
+        s->lastUse = ++m_useCount;
+        res = m_mixer ? m_mixer->playBuffer(type, s->pcm, s->frames, m_rate, s->channels, gain) : -1;
+        if(res < 0) res = SB_ERR_STREAMS;
+    }
+    xSemaphoreGive(m_mutex);
+    m_stats.triggerUs = micros() - t;
+    if(m_stats.triggerUs > m_stats.triggerUsMax) m_stats.triggerUsMax = m_stats.triggerUs;
+    return res;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSoundBank::contains(const char* name) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    int8_t i = lookup(name, nameHash(name));
+    if(i >= 0) m_sound[i].lastUse = ++m_useCount;
+    xSemaphoreGive(m_mutex);
+    return i >= 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSoundBank::unload(const char* name) {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    int8_t i = lookup(name, nameHash(name));
+    if(i >= 0 && !(m_mixer && m_mixer->isPlaying(m_sound[i].pcm))) freeSound(&m_sound[i]);
+    else if(i >= 0) m_sound[i].lastUse = 0; // the first to go
+    xSemaphoreGive(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSoundBank::clear() {
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    for(int i = 0; i < SB_MAX_SOUNDS; i++) {
+        if(m_sound[i].pcm && !(m_mixer && m_mixer->isPlaying(m_sound[i].pcm))) freeSound(&m_sound[i]);
+    }
+    xSemaphoreGive(m_mutex);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioSoundBank::lookup(const char* name, uint32_t hash) {
+    for(int i = 0; i < SB_MAX_SOUNDS; i++) {
+        sb_sound_t* s = &m_sound[i];
+        if(s->pcm && s->hash == hash && !strncmp(s->name, name, SB_NAME_LEN - 1)) return i;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSoundBank::freeSound(sb_sound_t* s) {
+    free(s->pcm);
+    m_stats.bytes -= s->bytes;
+    memset(s, 0, sizeof(sb_sound_t));
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSoundBank::evict(uint32_t need) {
+    // the least recently used clips go until 'need' more bytes fit and a slot is free, playing clips stay
+    while(true) {
+        bool slot = false;
+        for(int i = 0; i < SB_MAX_SOUNDS; i++) if(!m_sound[i].pcm) slot = true;
+        if(m_stats.bytes + need <= m_budget && (slot || !need)) return true;
+        int8_t oldest = -1;
+        for(int i = 0; i < SB_MAX_SOUNDS; i++) {
+            sb_sound_t* s = &m_sound[i];
+            if(!s->pcm || (m_mixer && m_mixer->isPlaying(s->pcm))) continue;
+            if(oldest < 0 || s->lastUse < m_sound[oldest].lastUse) oldest = i;
+        }
+        if(oldest < 0) return false;
+        freeSound(&m_sound[oldest]);
+        m_stats.evictions++;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSoundBank::appendPCM(const int16_t* pcm, uint32_t frames) {
+    if(m_decFrames + frames > m_decCap) {
+        uint32_t cap = max(m_decCap * 2, m_decFrames + frames + 4096);
+        int16_t* p = (int16_t*)__malloc_heap_psram(cap * m_decChannels * sizeof(int16_t));
+        if(!p) {
+            log_e("oom");
+            return false;
+        }
+        if(m_dec) {
+            memcpy(p, m_dec, m_decFrames * m_decChannels * sizeof(int16_t));
+            free(m_dec);
+        }
+        m_dec = p;
+        m_decCap = cap;
+    }
+    memcpy(m_dec + m_decFrames * m_decChannels, pcm, frames * m_decChannels * sizeof(int16_t));
+    m_decFrames += frames;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSoundBank::decodeWAV(const uint8_t* data, uint32_t len) {
+    // RIFF chunks, fmt before data, PCM 8 or 16 bit, WAVE_FORMAT_EXTENSIBLE with a PCM subformat
+    uint32_t pos = 12;
+    uint16_t bits = 0;
+    while(pos + 8 <= len) {
+        uint32_t size = rd32(data + pos + 4);
+        const uint8_t* c = data + pos + 8;
+        if(!memcmp(data + pos, "fmt ", 4) && size >= 16 && pos + 8 + 16 <= len) {
+            uint16_t format = rd16(c);
+            if(format == 0xFFFE && size >= 26) format = rd16(c + 24);
+            m_decChannels = rd16(c + 2);
+            m_decRate = rd32(c + 4);
+            bits = rd16(c + 14);
+            if(format != 1 || (m_decChannels != 1 && m_decChannels != 2) || (bits != 8 && bits != 16)) return false;
+            if(m_decRate < 8000 || m_decRate > 96000) return false;
+        }
+        else if(!memcmp(data + pos, "data", 4)) {
+            if(!bits) return false;                   // no fmt chunk
+            size = min(size, len - pos - 8);
+            uint8_t  bps = bits / 8 * m_decChannels;
+            uint32_t frames = size / bps;
+            int16_t  buff[256];
+            uint32_t per = 256 / m_decChannels;
+            for(uint32_t f = 0; f < frames; f += per) {
+                uint32_t n = min(per, frames - f);
+                const uint8_t* p = c + f * bps;
+                for(uint32_t i = 0; i < n * m_decChannels; i++) {
+                    buff[i] = (bits == 8) ? (int16_t)((p[i] - 128) << 8) : (int16_t)rd16(p + 2 * i);
+                }
+                if(!appendPCM(buff, n)) return false;
+            }
+            return m_decFrames > 0;
+        }
+        if(size > len - pos - 8) break;               // behind the end of the file, pos would wrap
+        pos += 8 + size + (size & 1);                 // chunks are word aligned
+    }
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSoundBank::decodeMP3(const uint8_t* data, uint32_t len) {
+    // the ID3 tag and the Xing/Info frame are skipped, the LAME delay and padding are cut as in gapless playback
+    uint32_t pos = 0;
+    if(len > 10 && !memcmp(data, "ID3", 3)) {
+        pos = 10 + ((data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 | (data[9] & 0x7F));
+        if(data[5] & 0x10) pos += 10;                 // footer
+    }
+    if(pos >= len) return false;
+    int sync = MP3FindSyncWord((uint8_t*)data + pos, len - pos);
+    if(sync < 0) return false;
+    pos += sync;
+
+    uint32_t skip = 0, total = UINT32_MAX;
+    MP3XingInfo_t xi;
+    if(MP3GetXingInfo(data + pos, len - pos, &xi) == ERR_MP3_NONE && xi.frameLen) {
+        if(xi.frames && (xi.encDelay || xi.encPadding) && xi.frames * xi.samplesPerFrame > (uint32_t)(xi.encDelay + xi.encPadding)) {
+            skip = xi.encDelay + 529;
+            total = xi.frames * xi.samplesPerFrame - xi.encDelay - xi.encPadding;
+        }
+        pos += xi.frameLen;
+    }
+
+    if(!MP3Decoder_AllocateBuffers()) return false;
+    int16_t* out = (int16_t*)malloc(1152 * 2 * sizeof(int16_t));
+    bool ok = (out != NULL);
+    while(ok && pos < len && m_decFrames < total) {
+        sync = MP3FindSyncWord((uint8_t*)data + pos, len - pos);
+        if(sync < 0) break;
+        pos += sync;
+        int left = len - pos;
+        int err = MP3Decode((uint8_t*)data + pos, &left, out, 0);
+        if(err == ERR_MP3_INDATA_UNDERFLOW) break;
+        if(err != ERR_MP3_NONE) {                    // the bit reservoir of the first frames, a damaged frame
+            pos = (left < (int)(len - pos)) ? len - left : pos + 1;
+            continue;
+        }
+        pos = len - left;
+        if(!m_decChannels) {
+            m_decChannels = MP3GetChannels();
+            m_decRate = MP3GetSampRate();
+            if(m_decChannels != 1 && m_decChannels != 2) ok = false;
+        }
+        if(!ok || MP3GetChannels() != m_decChannels) break;
+        uint32_t n = MP3GetOutputSamps() / m_decChannels;
+        uint32_t first = min(skip, n);
+        skip -= first;
+        n -= first;
+        if(n > total - m_decFrames) n = total - m_decFrames;
+        if(n && !appendPCM(out + first * m_decChannels, n)) ok = false;
+    }
+    if(out) free(out);
+    MP3Decoder_FreeBuffers();
+    return ok && m_decFrames > 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioSoundBank::decode(const char* name, const uint8_t* data, uint32_t len, bool mp3Busy) {
+    // one decoding at a time (m_dec, m_resampler), the table is locked only while storing: play() goes on meanwhile
+    xSemaphoreTake(m_loadMutex, portMAX_DELAY);
+    int8_t res = SB_ERR_FORMAT;
+    bool ok = false;
+    m_decFrames = 0;
+    m_decChannels = 0;
+    m_decRate = 0;
+    if(len > 12 && !memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WAVE", 4)) ok = decodeWAV(data, len);
+    else if(len > 4 && (!memcmp(data, "ID3", 3) || MP3FindSyncWord((uint8_t*)data, min(len, (uint32_t)4096)) == 0)) {
+        if(mp3Busy) res = SB_ERR_BUSY;                // the decoder state belongs to the music
+        else ok = decodeMP3(data, len);
+    }
+    if(ok) res = store(name, nameHash(name));
+    if(m_dec) {free(m_dec); m_dec = NULL;}
+    m_decCap = 0;
+    m_decFrames = 0;
+    xSemaphoreGive(m_loadMutex);
+    return res;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioSoundBank::store(const char* name, uint32_t hash) {
+    // resample m_dec to the bank rate, the resampler history is flushed with silence, its delay is compensated
+    uint8_t  ch = m_decChannels;
+    uint32_t frames = m_decFrames;
+    uint32_t cap = m_decCap;
+    int16_t* pcm = NULL;
+    if(m_decRate == m_rate) {
+        pcm = m_dec;                                  // taken over, the growth reserve is given back
+        m_dec = NULL;
+        int16_t* fit = (cap > frames + 1024) ? (int16_t*)__malloc_heap_psram(frames * ch * sizeof(int16_t)) : NULL;
+        if(fit) {
+            memcpy(fit, pcm, frames * ch * sizeof(int16_t));
+            free(pcm);
+            pcm = fit;
+            cap = frames;
+        }
+    }
+    else {
+        if(!m_resampler.setRates(m_decRate, m_rate, ch)) return SB_ERR_FORMAT;
+        m_resampler.reset();
+        uint32_t want = (uint64_t)m_decFrames * m_rate / m_decRate;
+        cap = want + 2 * RS_CHUNK_FRAMES;
+        pcm = (int16_t*)__malloc_heap_psram(cap * ch * sizeof(int16_t));
+        if(!pcm) {
+            log_e("oom");
+            return SB_ERR_MEMORY;
+        }
+        int16_t  zero[RS_CHUNK_FRAMES * 2] = {0};
+        uint32_t got = 0, in = 0, flush = 0;
+        while(got < want) {
+            uint32_t n = min((uint32_t)RS_CHUNK_FRAMES, m_decFrames - in);
+            const int16_t* src = m_dec + in * ch;
+            if(!n) {                                  // behind the end: silence pushes the last frames out
+                if(flush++ > RS_MAX_TAPS / RS_CHUNK_FRAMES + 4) break;
+                n = RS_CHUNK_FRAMES;
+                src = zero;
+            }
+            else in += n;
+            if(got + m_resampler.maxOutputFrames(n) > cap) break;
+            got += m_resampler.process(src, n, pcm + got * ch);
+        }
+        frames = min(got, want);
+    }
+    if(!frames) {
+        free(pcm);
+        return SB_ERR_FORMAT;
+    }
+
+    uint32_t bytes = cap * ch * sizeof(int16_t);        // what the clip occupies
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    int8_t res = SB_ERR_MEMORY;
+    int8_t old = lookup(name, hash);
+    if(old >= 0) {                                    // loaded by someone else in the meantime
+        m_sound[old].lastUse = ++m_useCount;
+        res = SB_OK;
+    }
+    else if(bytes <= m_budget && evict(bytes)) {
+        for(int i = 0; i < SB_MAX_SOUNDS; i++) {
+            sb_sound_t* s = &m_sound[i];
+            if(s->pcm) continue;
+            s->hash = hash;
+            strncpy(s->name, name, SB_NAME_LEN - 1);
+            s->name[SB_NAME_LEN - 1] = 0;
+            s->pcm = pcm;
+            s->frames = frames;
+            s->bytes = bytes;
+            s->channels = ch;
+            s->lastUse = ++m_useCount;
+            m_stats.bytes += bytes;
+            m_stats.loads++;
+            pcm = NULL;
+            res = SB_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(m_mutex);
+    if(pcm) free(pcm);                                // not stored
+    return res;
+}
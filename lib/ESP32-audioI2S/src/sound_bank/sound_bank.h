@@ -0,0 +1,90 @@
+/*
+ * sound_bank.h
+ * short clips (clicks, chimes, prompts) decoded once into PSRAM and played through the mixer without a decoder
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  load(): WAV (8/16 bit PCM) or MP3 -> 16 bit PCM, resampled to the bank rate, mono clips stay mono
+ *  play(): the cached PCM becomes a mixer stream (AudioMixer::playBuffer()), nothing is copied or decoded
+ *  the least recently played clips that are not playing make room when the memory budget is exceeded
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+#include <FS.h>
+#include "../audio_mixer/audio_mixer.h"
+#include "../resampler/resampler.h"
+
+#define SB_MAX_SOUNDS     16
+#define SB_NAME_LEN       64         // longer paths are told apart by their hash
+#define SB_MAX_FILE       (256 * 1024)
+#define SB_BUDGET         (512 * 1024) // bytes of PCM, default
+#define SB_RATE           44100      // default bank rate, the mixer converts linearly if the I2S clock differs
+
+enum : int8_t {SB_OK = 0, SB_ERR_MISS = -1, SB_ERR_FILE = -2, SB_ERR_FORMAT = -3, SB_ERR_MEMORY = -4,
+               SB_ERR_BUSY = -5, SB_ERR_STREAMS = -6};
+
+typedef struct _sb_stats{
+    uint32_t hits;               // play() found the clip (count = false: the retry after a load is not counted)
+    uint32_t misses;
+    uint32_t loads;              // clips decoded
+    uint32_t evictions;
+    uint32_t bytes;              // PCM in the bank
+    uint32_t loadUs;             // last load(), file and decoding
+    uint32_t triggerUs;          // last and worst play()
+    uint32_t triggerUsMax;
+} sb_stats_t;
+
+class AudioSoundBank {
+
+public:
+    AudioSoundBank();
+    ~AudioSoundBank();
+    void     begin(AudioMixer* mixer, uint32_t rate = SB_RATE, uint32_t budget = SB_BUDGET);
+    void     setBudget(uint32_t bytes);                                 // evicts what no longer fits
+    int8_t   load(fs::FS& fs, const char* path, bool mp3Busy = false);  // mp3Busy: an MP3 clip gives SB_ERR_BUSY
+    int8_t   loadMemory(const char* name, const uint8_t* data, uint32_t len, bool mp3Busy = false);
+    int8_t   play(const char* name, uint8_t type = MIX_EFFECT, float gain = 1.0, bool count = true); // mixer stream id or SB_ERR_...
+    bool     contains(const char* name);
+    void     unload(const char* name);                                  // kept until it has been played
+    void     clear();
+    const sb_stats_t* getStats() { return &m_stats; }
+
+protected:
+    typedef struct _sb_sound{
+        uint32_t hash;
+        char     name[SB_NAME_LEN];
+        int16_t* pcm;            // NULL: free slot
+        uint32_t frames;
+        uint32_t bytes;
+        uint8_t  channels;
+        uint32_t lastUse;
+    } sb_sound_t;
+
+    int8_t   decode(const char* name, const uint8_t* data, uint32_t len, bool mp3Busy);
+    bool     decodeWAV(const uint8_t* data, uint32_t len);
+    bool     decodeMP3(const uint8_t* data, uint32_t len);
+    bool     appendPCM(const int16_t* pcm, uint32_t frames);
+    int8_t   store(const char* name, uint32_t hash);
+    int8_t   lookup(const char* name, uint32_t hash);
+    bool     evict(uint32_t need);
+    void     freeSound(sb_sound_t* s);
+
+    AudioMixer*       m_mixer = NULL;
+    AudioResampler    m_resampler;
+    SemaphoreHandle_t m_mutex = NULL;           // the table, play() and load() may run in different tasks
+    SemaphoreHandle_t m_loadMutex = NULL;       // the decoding below, load() may run in more than one task
+    sb_sound_t        m_sound[SB_MAX_SOUNDS];
+    sb_stats_t        m_stats = {};
+    uint32_t          m_rate = SB_RATE;
+    uint32_t          m_budget = SB_BUDGET;
+    uint32_t          m_useCount = 0;
+    // decoding, load() only
+    int16_t*          m_dec = NULL;             // decoded PCM at the source rate
+    uint32_t          m_decFrames = 0;
+    uint32_t          m_decCap = 0;             // frames
+    uint32_t          m_decRate = 0;
+    uint8_t           m_decChannels = 0;
+};
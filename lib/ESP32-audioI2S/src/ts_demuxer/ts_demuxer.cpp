@@ -0,0 +1,219 @@
+/*
+ * ts_demuxer.cpp
+ * MPEG transport stream (HLS .ts segments), PAT, PMT and PES headers, the payload of one audio stream
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "ts_demuxer.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+AudioTSDemuxer::AudioTSDemuxer() {
+    reset();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioTSDemuxer::reset() {
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_programs = 0;
+    m_streams = 0;
+    m_selPid = 0;
+    m_f_userSel = false;
+    m_cc = 0xFF;
+    m_f_drop = true;
+    m_f_synced = true;
+    m_skip = 0;
+    m_pending = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioTSDemuxer::dropPending() {
+    m_pending = 0; // a lost packet shows up as continuity error
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioTSDemuxer::selectStream(uint8_t idx) {
+    if(idx >= m_streams) return false;
+    if(m_stream[idx].pid != m_selPid) {
+        m_selPid = m_stream[idx].pid;
+        m_cc = 0xFF;
+        m_f_drop = true; // from the next PES header on
+    }
+    m_f_userSel = true;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t AudioTSDemuxer::getStreamType() {
+    for(int i = 0; i < m_streams; i++) {
+        if(m_stream[i].pid == m_selPid) return m_stream[i].streamType;
+    }
+    return TS_ST_NONE;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int8_t AudioTSDemuxer::programOf(uint16_t pid) {
+    for(int i = 0; i < m_programs; i++) {
+        if(m_pmtPid[i] == pid) return i;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int16_t AudioTSDemuxer::sectionStart(const uint8_t* payload, uint8_t len, bool pusi, uint8_t tableId) {
+    // position of table_id, -1 if the section does not start in this packet or does not fit into it
+    if(!pusi || !len) return -1;
+    uint16_t s = 1 + payload[0]; // pointer_field
+    if(s + 3 > len || payload[s] != tableId) return -1;
+    uint16_t sectionLength = ((payload[s + 1] & 0x0F) << 8) | payload[s + 2];
+    if(s + 3 + sectionLength > len || sectionLength < 9) {
+        log_w("TS section 0x%02X with %u bytes not in one packet", tableId, sectionLength);
+        return -1;
+    }
+    return s;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioTSDemuxer::parsePAT(const uint8_t* payload, uint8_t len, bool pusi) {
+    int16_t s = sectionStart(payload, len, pusi, 0x00);
+    if(s < 0) return;
+    uint16_t end = s + 3 + (((payload[s + 1] & 0x0F) << 8) | payload[s + 2]) - 4; // without CRC
+    uint16_t pmtPid[TS_MAX_PROGRAMS];
+    uint16_t program[TS_MAX_PROGRAMS];
+    uint8_t  programs = 0;
+    for(uint16_t i = s + 8; i + 4 <= end && programs < TS_MAX_PROGRAMS; i += 4) {
+        uint16_t nr = (payload[i] << 8) | payload[i + 1];
+        if(nr == 0) continue; // network PID
+        program[programs] = nr;
+        pmtPid[programs] = ((payload[i + 2] & 0x1F) << 8) | payload[i + 3];
+        programs++;
+    }
+    if(programs == m_programs && !memcmp(pmtPid, m_pmtPid, programs * 2)) return; // every segment repeats it
+    memcpy(m_pmtPid, pmtPid, programs * 2);
+    memcpy(m_program, program, programs * 2);
+    m_programs = programs;
+    m_streams = 0; // the PMTs follow
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioTSDemuxer::parsePMT(const uint8_t* payload, uint8_t len, bool pusi) {
+    int16_t s = sectionStart(payload, len, pusi, 0x02);
+    if(s < 0) return;
+    uint16_t end = s + 3 + (((payload[s + 1] & 0x0F) << 8) | payload[s + 2]) - 4;
+    uint16_t program = (payload[s + 3] << 8) | payload[s + 4];
+    uint16_t cursor = s + 12 + (((payload[s + 10] & 0x0F) << 8) | payload[s + 11]); // behind program_info
+
+    uint8_t j = 0; // the streams of this program are listed anew
+    for(int i = 0; i < m_streams; i++) {
+        if(m_stream[i].program != program) m_stream[j++] = m_stream[i];
+    }
+    m_streams = j;
+    while(cursor + 5 <= end) {
+        uint8_t  type = payload[cursor];
+        uint16_t pid = ((payload[cursor + 1] & 0x1F) << 8) | payload[cursor + 2];
+        bool     audio = type == TS_ST_AAC_ADTS || type == TS_ST_AAC_LATM || type == TS_ST_MPEG1_AUDIO || type == TS_ST_MPEG2_AUDIO;
+        if(audio && m_streams < TS_MAX_STREAMS) {
+            m_stream[m_streams].pid = pid;
+            m_stream[m_streams].program = program;
+            m_stream[m_streams].streamType = type;
+            m_streams++;
+        }
+        cursor += 5 + (((payload[cursor + 3] & 0x0F) << 8) | payload[cursor + 4]); // + ES_info
+    }
+
+    int8_t sel = -1;
+    for(int i = 0; i < m_streams; i++) {
+        if(m_stream[i].pid == m_selPid) sel = i;
+    }
+    if(sel >= 0 && (m_f_userSel || m_stream[sel].streamType == TS_ST_AAC_ADTS)) return; // keep it
+    for(int i = 0; i < m_streams && sel < 0; i++) {
+        if(m_stream[i].streamType == TS_ST_AAC_ADTS) sel = i;
+    }
+    if(sel < 0 && m_streams) sel = 0;
+    if(sel < 0 || m_stream[sel].pid == m_selPid) return;
+    m_selPid = m_stream[sel].pid;
+    m_f_userSel = false;
+    m_cc = 0xFF;
+    m_f_drop = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioTSDemuxer::demux(uint8_t* buff, uint32_t len) {
+    // buff begins with the pending bytes of the last call, the audio payload is moved to the front, it never
+    // overtakes the packet that is read (every packet has at least 4 header bytes)
+    uint32_t in = 0;
+    uint32_t out = 0;
+    while(len - in >= TS_PACKET_SIZE) {
+        uint8_t* p = buff + in;
+        bool     lost = p[0] != TS_SYNC_BYTE;
+        if(!lost && !m_f_synced && len - in >= 2 * TS_PACKET_SIZE) lost = p[TS_PACKET_SIZE] != TS_SYNC_BYTE;
+        if(lost) {
+            if(m_f_synced) {
+                m_f_synced = false;
+                m_stats.syncLosses++;
+                if(!m_f_drop) {m_stats.pesDropped++; m_f_drop = true;}
+                log_w("TS sync lost, first bytes are %02X %02X %02X %02X", p[0], p[1], p[2], p[3]);
+            }
+            in++;
+            continue;
+        }
+        m_f_synced = true;
+        in += TS_PACKET_SIZE;
+        m_stats.packets++;
+
+        // --------------------------------------------------------------------------------------------------------
+        // 0. Byte SyncByte  | 0 | 1 | 0 | 0 | 0 | 1 | 1 | 1 | always bit pattern of 0x47
+        // 1. Byte           |TEI|PUSI|TP|PID|PID|PID|PID|PID|
+        // 2. Byte           |PID|PID|PID|PID|PID|PID|PID|PID|
+        // 3. Byte           |TSC|TSC|AFC|AFC|CC |CC |CC |CC |
+        // 4.-187. Byte      |adaptation field if AFC == 1x, then the payload if AFC == x1
+        //---------------------------------------------------------------------------------------------------------
+        uint16_t pid = ((p[1] & 0x1F) << 8) | p[2];
+        bool     pusi = p[1] & 0x40;
+        uint8_t  afc = (p[3] >> 4) & 0x03;
+        uint8_t  pos = 4;
+        bool     discontinuity = false;
+        if(p[1] & 0x80) { // transport error indicator
+            if(pid == m_selPid && !m_f_drop) {m_stats.pesDropped++; m_f_drop = true;}
+            continue;
+        }
+        if(afc & 0x02) {
+            if(p[4] > 183) continue;
+            discontinuity = p[4] && (p[5] & 0x80);
+            pos += 1 + p[4];
+        }
+        if(!(afc & 0x01) || pos >= TS_PACKET_SIZE) continue; // no payload, the counter does not count
+        uint8_t        n = TS_PACKET_SIZE - pos;
+        const uint8_t* payload = p + pos;
+
+        if(pid == m_selPid && m_selPid) {
+            uint8_t cc = p[3] & 0x0F;
+            if(m_cc != 0xFF && !discontinuity) {
+                if(cc == m_cc) continue; // duplicate packet
+                if(cc != ((m_cc + 1) & 0x0F)) {
+                    m_stats.ccErrors++;
+                    if(!m_f_drop) {m_stats.pesDropped++; m_f_drop = true;}
+                }
+            }
+            m_cc = cc;
+            if(pusi) { // PES header: 00 00 01, stream_id, PES_packet_length, 2 flag bytes, PES_header_data_length
+                if(n >= 9 && payload[0] == 0x00 && payload[1] == 0x00 && payload[2] == 0x01) {
+                    m_skip = 9 + payload[8];
+                    m_f_drop = false;
+                }
+                else {
+                    if(!m_f_drop) m_stats.pesDropped++;
+                    m_f_drop = true;
+                }
+            }
+            if(m_f_drop) continue;
+            if(m_skip) {
+                uint16_t s = m_skip < n ? m_skip : n;
+                payload += s;
+                n -= s;
+                m_skip -= s;
+            }
+            if(n) {
+                memmove(buff + out, payload, n);
+                out += n;
+            }
+        }
+        else if(pid == 0x0000) parsePAT(payload, n, pusi);
+        else if(programOf(pid) >= 0) parsePMT(payload, n, pusi);
+    }
+    m_pending = len - in;
+    if(m_pending && out != in) memmove(buff + out, buff + in, m_pending);
+    m_stats.payloadBytes += out;
+    return out;
+}
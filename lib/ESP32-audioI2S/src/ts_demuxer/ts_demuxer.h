@@ -0,0 +1,76 @@
+/*
+ * ts_demuxer.h
+ * MPEG transport stream (HLS .ts segments), PAT, PMT and PES headers, the payload of one audio stream
+ * reference ISO/IEC 13818-1
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  demux() works in place: the caller reads the segment bytes straight into the input buffer, the packet headers,
+ *  adaptation fields and PES headers are cut out and the audio payload is moved to the front, so the ADTS frames
+ *  are contiguous for the decoder across packet boundaries. A packet that is not complete stays behind the output
+ *  (pending()), the caller reads the next bytes behind it.
+ *  Lost sync: the bytes are skipped up to a sync byte that is followed by another one a packet later. A continuity
+ *  counter jump (or a lost sync) drops the rest of the PES packet, the next one starts with a whole ADTS frame.
+ *  Sections (PAT, PMT) must fit into one packet, as they always do with HLS.
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include "Arduino.h"
+
+#define TS_PACKET_SIZE    188
+#define TS_SYNC_BYTE      0x47
+#define TS_MAX_PROGRAMS   4          // PMT PIDs taken from the PAT
+#define TS_MAX_STREAMS    8          // audio elementary streams of all programs
+
+enum : uint8_t {TS_ST_NONE = 0x00, TS_ST_MPEG1_AUDIO = 0x03, TS_ST_MPEG2_AUDIO = 0x04, TS_ST_AAC_ADTS = 0x0F,
+                TS_ST_AAC_LATM = 0x11}; // stream types in the PMT
+
+typedef struct _ts_stream{
+    uint16_t pid;
+    uint16_t program;
+    uint8_t  streamType;
+} ts_stream_t;
+
+typedef struct _ts_stats{
+    uint32_t packets;
+    uint32_t syncLosses;    // times the sync byte had to be searched
+    uint32_t ccErrors;      // continuity counter jumps of the selected stream
+    uint32_t pesDropped;    // PES packets (rest of) dropped
+    uint32_t payloadBytes;  // audio bytes put out
+} ts_stats_t;
+
+class AudioTSDemuxer {
+
+public:
+    AudioTSDemuxer();
+    void     reset();                                               // new stream, PAT and PMT are read again
+    uint32_t demux(uint8_t* buff, uint32_t len);                    // in place, returns the audio bytes at buff[0]
+    uint16_t pending() { return m_pending; }                        // bytes of a packet behind the audio bytes
+    void     dropPending();                                         // they are gone (buffer reset or resized)
+    bool     selectStream(uint8_t idx);                             // default: the first ADTS stream
+    uint8_t  getStreams(const ts_stream_t** streams) { *streams = m_stream; return m_streams; }
+    uint8_t  getStreamType();                                       // of the selected stream, TS_ST_NONE: not yet known
+    const ts_stats_t* getStats() { return &m_stats; }
+
+protected:
+    void     parsePAT(const uint8_t* payload, uint8_t len, bool pusi);
+    void     parsePMT(const uint8_t* payload, uint8_t len, bool pusi);
+    int16_t  sectionStart(const uint8_t* payload, uint8_t len, bool pusi, uint8_t tableId);
+    int8_t   programOf(uint16_t pid);
+
+    ts_stream_t m_stream[TS_MAX_STREAMS];
+    ts_stats_t  m_stats;
+    uint16_t    m_pmtPid[TS_MAX_PROGRAMS];
+    uint16_t    m_program[TS_MAX_PROGRAMS];
+    uint8_t     m_programs = 0;
+    uint8_t     m_streams = 0;
+    uint16_t    m_selPid = 0;           // 0: not yet selected
+    bool        m_f_userSel = false;    // selectStream(), kept when the PMT comes again
+    uint8_t     m_cc = 0xFF;            // last continuity counter of the selected stream, 0xFF: none yet
+    bool        m_f_drop = true;        // skip until the next PES header
+    bool        m_f_synced = true;
+    uint16_t    m_skip = 0;             // PES header bytes that continue in the next packet
+    uint16_t    m_pending = 0;
+};
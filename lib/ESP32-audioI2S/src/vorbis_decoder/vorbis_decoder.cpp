@@ -22,6 +22,7 @@
 //----------------------------------------------------------------------------------------------------------------------
 #include "vorbis_decoder.h"
 #include "lookup.h"
+#include "../ogg_demuxer/ogg_demuxer.h"
 #include "alloca.h"
 #include <vector>
 using namespace std;
@@ -70,12 +71,10 @@ uint8_t   s_nrOfResidues = 0;
 uint8_t   s_nrOfMaps = 0;
 uint8_t   s_nrOfModes = 0;
 
-uint16_t *s_vorbisSegmentTable = NULL;
 uint16_t  s_oggPage3Len = 0; // length of the current audio segment
-uint8_t   s_vorbisSegmentTableSize = 0;
-int16_t   s_vorbisSegmentTableRdPtr = -1;
 int8_t    s_vorbisError = 0;
 float     s_vorbisCompressionRatio = 0;
+ogg_page_t s_vorbisOggPage;
 
 bitReader_t            s_bitReader;
 
@@ -91,14 +90,12 @@ vector<uint32_t>s_vorbisBlockPicItem;
 
 
 bool VORBISDecoder_AllocateBuffers(){
-    s_vorbisSegmentTable = (uint16_t*)__calloc_heap_psram(256, sizeof(uint16_t));
     s_vorbisChbuf = (char*)__calloc_heap_psram(256, sizeof(char));
     s_lastSegmentTable = (uint8_t*)__malloc_heap_psram(4096);
     VORBISsetDefaults();
     return true;
 }
 void VORBISDecoder_FreeBuffers(){
-    if(s_vorbisSegmentTable) {free(s_vorbisSegmentTable); s_vorbisSegmentTable = NULL;}
     if(s_vorbisChbuf){free(s_vorbisChbuf); s_vorbisChbuf = NULL;}
     if(s_lastSegmentTable){free(s_lastSegmentTable); s_lastSegmentTable = NULL;}
 
@@ -124,10 +121,9 @@ void VORBISsetDefaults(){
     s_vorbisBitRate = 0;
     s_vorbisSegmentLength = 0;
     s_vorbisValidSamples = 0;
-    s_vorbisSegmentTableSize = 0;
+    OGG_clearPage(&s_vorbisOggPage);
     s_vorbisCurrentFilePos = 0;
     s_vorbisOldMode = 0xFF;
-    s_vorbisSegmentTableRdPtr = -1;
     s_vorbisError = 0;
     s_lastSegmentTableLen = 0;
     s_vorbisBlockPicPos = 0;
@@ -139,6 +135,20 @@ void VORBISsetDefaults(){
 
     VORBISDecoder_ClearBuffers();
 }
+void VORBISDecoderSeekReset(){
+    // the next call of VORBISDecode() starts with a new Ogg page, codebooks and setup are kept
+    OGG_clearPage(&s_vorbisOggPage);
+    s_lastSegmentTableLen = 0;
+    s_f_lastSegmentTable = false;
+    s_f_oggContinuedPage = false;
+    s_f_parseOggDone = false;
+    s_vorbisValidSamples = 0;
+    if(s_dsp_state){
+        s_dsp_state->out_end = -1; // vorbis_dsp_restart, the first block after the seek only fills the overlap
+        s_dsp_state->out_begin = -1;
+    }
+    bitReader_clear();
+}
 
 void clearGlobalConfigurations() { // mode, mapping, floor etc
     if(s_nrOfCodebooks) {  // if we have a stream with changing codebooks, delete the old one
@@ -216,11 +226,10 @@ int VORBISDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf) {
         return VORBIS_PARSE_OGG_DONE;
     }
 
-    if(!s_vorbisSegmentTableSize) {
-        s_vorbisSegmentTableRdPtr = -1; // back to the parking position
+    if(!OGG_packetsLeft(&s_vorbisOggPage)) {
         ret = VORBISparseOGG(inbuf, bytesLeft);
         s_f_parseOggDone = true;
-        if(!s_vorbisSegmentTableSize) { log_w("OggS without segments?"); }
+        if(!OGG_packetsLeft(&s_vorbisOggPage)) { log_w("OggS without segments?"); }
         return ret;
     }
 
@@ -229,11 +238,7 @@ int VORBISDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf) {
     // If the next Ogg Page does not contain a 'continuedPage', the last segment is played first. However,
     // if 'continuedPage' is set, the first segment of the new page is added to the saved segment and played.
     if(!s_lastSegmentTableLen){
-        if(s_vorbisSegmentTableSize) {
-            s_vorbisSegmentTableRdPtr++;
-            s_vorbisSegmentTableSize--;
-            segmentLength = s_vorbisSegmentTable[s_vorbisSegmentTableRdPtr];
-        }
+        if(OGG_packetsLeft(&s_vorbisOggPage)) segmentLength = OGG_nextPacket(&s_vorbisOggPage);
     }
 
     if(s_pageNr < 4)
@@ -381,7 +386,7 @@ int vorbisDecodePage4(uint8_t* inbuf, int* bytesLeft, uint32_t segmentLength, sh
         }
     }
     else { // not s_f_parseOggDone
-        if(s_vorbisSegmentTableSize || s_f_lastSegmentTable) {
+        if(OGG_packetsLeft(&s_vorbisOggPage) || s_f_lastSegmentTable) {
             // if(s_f_oggLastPage) log_i("last page");
             bitReader_setData(inbuf, segmentLength);
             ret = vorbis_dsp_synthesis(inbuf, segmentLength, outbuf);
@@ -405,7 +410,7 @@ int vorbisDecodePage4(uint8_t* inbuf, int* bytesLeft, uint32_t segmentLength, sh
         s_f_oggFirstPage = false;
     }
     s_f_parseOggDone = false;
-    if(s_f_oggLastPage && !s_vorbisSegmentTableSize) { VORBISsetDefaults(); }
+    if(s_f_oggLastPage && !OGG_packetsLeft(&s_vorbisOggPage)) { VORBISsetDefaults(); }
 
     if(ret != VORBIS_CONTINUE){ // nothing to do here, is playing from lastSegmentBuff
         *bytesLeft -= segmentLength;
@@ -704,68 +709,29 @@ err_out:
 //----------------------------------------------------------------------------------------------------------------------
 int VORBISparseOGG(uint8_t *inbuf, int *bytesLeft){
                                                            // reference https://www.xiph.org/ogg/doc/rfc3533.txt
-    int ret = 0; (void)ret;
-
-    int idx = VORBIS_specialIndexOf(inbuf, "OggS", 8192);
+    int idx = OGG_findSyncWord(inbuf, _min(*bytesLeft, 8192));
     if(idx != 0){
         if(s_f_oggContinuedPage) return ERR_VORBIS_DECODER_ASYNC;
+        if(idx < 0) return ERR_VORBIS_OGG_SYNC_NOT_FOUND;
         inbuf += idx;
         *bytesLeft -= idx;
         s_vorbisCurrentFilePos += idx;
     }
 
-    int16_t segmentTableWrPtr = -1;
-
-    uint8_t  version            = *(inbuf +  4); (void) version;
-    uint8_t  headerType         = *(inbuf +  5); (void) headerType;
-    uint64_t granulePosition    = (uint64_t)*(inbuf + 13) << 56;  // granule_position: an 8 Byte field containing -
-             granulePosition   += (uint64_t)*(inbuf + 12) << 48;  // position information. For an audio stream, it MAY
-             granulePosition   += (uint64_t)*(inbuf + 11) << 40;  // contain the total number of PCM samples encoded
-             granulePosition   += (uint64_t)*(inbuf + 10) << 32;  // after including all frames finished on this page.
-             granulePosition   += *(inbuf +  9) << 24;  // This is a hint for the decoder and gives it some timing
-             granulePosition   += *(inbuf +  8) << 16;  // and position information. A special value of -1 (in two's
-             granulePosition   += *(inbuf +  7) << 8;   // complement) indicates that no packets finish on this page.
-             granulePosition   += *(inbuf +  6); (void) granulePosition;
-    uint32_t bitstreamSerialNr  = *(inbuf + 17) << 24;  // bitstream_serial_number: a 4 Byte field containing the
-             bitstreamSerialNr += *(inbuf + 16) << 16;  // unique serial number by which the logical bitstream
-             bitstreamSerialNr += *(inbuf + 15) << 8;   // is identified.
-             bitstreamSerialNr += *(inbuf + 14); (void) bitstreamSerialNr;
-    uint32_t pageSequenceNr     = *(inbuf + 21) << 24;  // page_sequence_number: a 4 Byte field containing the sequence
-             pageSequenceNr    += *(inbuf + 20) << 16;  // number of the page so the decoder can identify page loss
-             pageSequenceNr    += *(inbuf + 19) << 8;   // This sequence number is increasing on each logical bitstream
-             pageSequenceNr    += *(inbuf + 18); (void) pageSequenceNr;
-    uint32_t CRCchecksum        = *(inbuf + 25) << 24;
-             CRCchecksum       += *(inbuf + 24) << 16;
-             CRCchecksum       += *(inbuf + 23) << 8;
-             CRCchecksum       += *(inbuf + 22); (void) CRCchecksum;
-    uint8_t  pageSegments       = *(inbuf + 26);        // giving the number of segment entries
-
-    // read the segment table (contains pageSegments bytes),  1...251: Length of the frame in bytes,
-    // 255: A second byte is needed.  The total length is first_byte + second byte
-    s_vorbisSegmentLength = 0;
-    segmentTableWrPtr = -1;
+    ogg_page_t* page = &s_vorbisOggPage;
+    if(OGG_parsePage(inbuf, *bytesLeft, page) != OGG_PAGE_OK) return ERR_VORBIS_DECODER_ASYNC;
 
-    for(int i = 0; i < pageSegments; i++){
-        int n = *(inbuf + 27 + i);
-        while(*(inbuf + 27 + i) == 255){
-            i++;
-            if(i == pageSegments) break;
-            n+= *(inbuf + 27 + i);
-        }
-        segmentTableWrPtr++;
-        s_vorbisSegmentTable[segmentTableWrPtr] = n;
-        s_vorbisSegmentLength += n;
-    }
-    s_vorbisSegmentTableSize = segmentTableWrPtr + 1;
-    s_vorbisCompressionRatio = (float)(960 * 2 * pageSegments)/s_vorbisSegmentLength;  // const 960 validBytes out
+    // VORBISDecode() takes the packet lengths from the page (OGG_nextPacket), continued lacing is already resolved
+    s_vorbisSegmentLength = page->bodySize;
+    s_vorbisCompressionRatio = (float)(960 * 2 * page->pageSegments)/s_vorbisSegmentLength;  // const 960 validBytes out
 
-    bool     continuedPage = headerType & 0x01; // set: page contains data of a packet continued from the previous page
-    bool     firstPage     = headerType & 0x02; // set: this is the first page of a logical bitstream (bos)
-    bool     lastPage      = headerType & 0x04; // set: this is the last page of a logical bitstream (eos)
+    bool     continuedPage = page->continuedPage; // set: page contains data of a packet continued from the previous page
+    bool     firstPage     = page->firstPage;     // set: this is the first page of a logical bitstream (bos)
+    bool     lastPage      = page->lastPage;      // set: this is the last page of a logical bitstream (eos)
 
-    uint16_t headerSize    = pageSegments + 27;
+    uint16_t headerSize    = page->headerSize;
 
-    // log_i("headerSize %i, s_vorbisSegmentLength %i, s_vorbisSegmentTableSize %i", headerSize, s_vorbisSegmentLength, s_vorbisSegmentTableSize);
+    // log_i("headerSize %i, s_vorbisSegmentLength %i, packets %i", headerSize, s_vorbisSegmentLength, page->nrOfPackets);
     if(firstPage || continuedPage || lastPage){
     // log_w("firstPage %i  continuedPage %i  lastPage %i", firstPage, continuedPage, lastPage);
     }
@@ -823,7 +789,7 @@ log_e("continued page");
 //----------------------------------------------------------------------------------------------------------------------
 int VORBISFindSyncWord(unsigned char *buf, int nBytes){
     // assume we have a ogg wrapper
-    int idx = VORBIS_specialIndexOf(buf, "OggS", nBytes);
+    int idx = OGG_findSyncWord(buf, nBytes);
     if(idx >= 0){ // Magic Word found
     //    log_i("OggS found at %i", idx);
         return idx;
@@ -1216,7 +1182,7 @@ int _make_decode_table(codebook_t *s, char *lengthlist, uint8_t quantvals, int m
         s->dec_table = __malloc_heap_psram((s->used_entries * 2 + 1) * sizeof(*work));
         /* +1 (rather than -2) is to accommodate 0 and 1 sized books, which are specialcased to nodeb==4 */
         if(_make_words(lengthlist, s->entries, (uint32_t *)s->dec_table, quantvals, s, maptype)) return 1;
-
+        _make_decode_lut(s);
         return 0;
     }
 
@@ -1314,9 +1280,30 @@ int _make_decode_table(codebook_t *s, char *lengthlist, uint8_t quantvals, int m
         }
     }
     if(work) {free(work); work = NULL;}
+    _make_decode_lut(s);
     return 0;
 }
 //---------------------------------------------------------------------------------------------------------------------
+/* resolve every possible dec_lutbits wide bit pattern once, decode_packed_entry_number() then only walks the tree for
+   longer codewords. Optional: without memory (or for degenerate books) the tree walk is used as before */
+void _make_decode_lut(codebook_t *s) {
+    s->dec_lut = NULL;
+    s->dec_lutbits = 0;
+    if(s->used_entries < 2 || !s->dec_table) return;
+
+    uint8_t lutbits = s->dec_maxlength < 8 ? s->dec_maxlength : 8;
+    s->dec_lut = (uint32_t *)__malloc_heap_psram(sizeof(uint32_t) << lutbits);
+    if(!s->dec_lut) return;
+    s->dec_lutbits = lutbits;
+
+    for(uint32_t k = 0; k < (1u << lutbits); k++) {
+        int      used;
+        uint32_t chase = decode_chase_tree(s, k, lutbits, &used);
+        if(used <= lutbits && chase < (1u << 27)) s->dec_lut[k] = (chase << 5) | used;
+        else s->dec_lut[k] = 0;
+    }
+}
+//---------------------------------------------------------------------------------------------------------------------
 /* given a list of word lengths, number of used entries, and byte width of a leaf, generate the decode table */
 int _make_words(char *l, uint16_t n, uint32_t *work, uint8_t quantvals, codebook_t *b, int maptype) {
 
@@ -1471,6 +1458,7 @@ void vorbis_book_clear(codebook_t *b) {
    info struct */
     if(b->q_val) free(b->q_val);
     if(b->dec_table) free(b->dec_table);
+    if(b->dec_lut) free(b->dec_lut);
 
     memset(b, 0, sizeof(*b));
 }
@@ -1915,26 +1903,20 @@ int mapping_inverse(vorbis_info_mapping_t *info) {
         int32_t *pcmM = s_dsp_state->work[info->coupling[i].mag];
         int32_t *pcmA = s_dsp_state->work[info->coupling[i].ang];
 
+        /* square polar mapping without the four-way branch: the derived value is mag -/+ ang depending on whether
+           the signs of mag and ang agree, the sign of ang selects which channel keeps mag */
         for(j = 0; j < n / 2; j++) {
             int32_t mag = pcmM[j];
             int32_t ang = pcmA[j];
+            int32_t t = ((mag > 0) == (ang > 0)) ? mag - ang : mag + ang;
 
-            if(mag > 0)
-                if(ang > 0) {
-                    pcmM[j] = mag;
-                    pcmA[j] = mag - ang;
-                }
-                else {
-                    pcmA[j] = mag;
-                    pcmM[j] = mag + ang;
-                }
-            else if(ang > 0) {
+            if(ang > 0) {
                 pcmM[j] = mag;
-                pcmA[j] = mag + ang;
+                pcmA[j] = t;
             }
             else {
                 pcmA[j] = mag;
-                pcmM[j] = mag - ang;
+                pcmM[j] = t;
             }
         }
     }
@@ -2100,9 +2082,10 @@ int32_t vorbis_book_decode(codebook_t* book) {
 }
 //---------------------------------------------------------------------------------------------------------------------
 int32_t decode_packed_entry_number(codebook_t *book) {
-    uint32_t chase = 0;
+    uint32_t chase;
     int      read = book->dec_maxlength;
-    int32_t  lok = bitReader_look(read), i;
+    int32_t  lok = bitReader_look(read);
+    int      used;
 
     while(lok < 0 && read > 1){
         lok = bitReader_look(--read);
@@ -2113,6 +2096,29 @@ int32_t decode_packed_entry_number(codebook_t *book) {
         return -1;
     }
 
+    /* short codewords: one table access instead of a bit-by-bit tree walk */
+    if(book->dec_lut && read >= book->dec_lutbits) {
+        uint32_t e = book->dec_lut[lok & mask[book->dec_lutbits]];
+        if(e) {
+            bitReader_adv(e & 0x1f);
+            return e >> 5;
+        }
+    }
+
+    chase = decode_chase_tree(book, lok, read, &used);
+    if(used <= read) {
+        bitReader_adv(used);
+        return chase;
+    }
+    bitReader_adv(read + 1);
+    log_e("read %i", read);
+    return (-1);
+}
+//---------------------------------------------------------------------------------------------------------------------
+/* walks the decode tree with the (LSb first) bits in lok, *used is the codeword length or read + 1 if no leaf was hit */
+uint32_t decode_chase_tree(codebook_t *book, int32_t lok, int read, int *used) {
+    uint32_t chase = 0;
+    int      i;
     /* chase the tree with the bits we got */
     if(book->dec_nodeb == 1) {
         if(book->dec_leafw == 1) {
@@ -2177,13 +2183,8 @@ int32_t decode_packed_entry_number(codebook_t *book) {
         }
     }
 
-    if(i < read) {
-        bitReader_adv(i + 1);
-        return chase;
-    }
-    bitReader_adv(read + 1);
-    log_e("read %i", read);
-    return (-1);
+    *used = i + 1;
+    return chase;
 }
 //---------------------------------------------------------------------------------------------------------------------
 int render_point(int x0, int x1, int y0, int y1, int x) {
@@ -3000,7 +3001,7 @@ void mdct_bitreverse(int32_t *x, int n, int shift) {
 }
 //---------------------------------------------------------------------------------------------------------------------
 int bitrev12(int x) {
-    uint8_t bitrev[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+    static const uint8_t bitrev[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
     return bitrev[x >> 8] | (bitrev[(x & 0x0f0) >> 4] << 4) | (((int)bitrev[x & 0x00f]) << 8);
 }
 //---------------------------------------------------------------------------------------------------------------------
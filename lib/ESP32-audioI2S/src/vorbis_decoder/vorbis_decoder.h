@@ -89,6 +89,8 @@ typedef struct _codebook{
     int     q_bits;
     uint8_t q_pack;
     void   *q_val;
+    uint32_t *dec_lut;     /* direct lookup for codewords up to dec_lutbits long: (chase << 5) | length, 0 = walk the tree */
+    uint8_t   dec_lutbits;
 } codebook_t;
 
 typedef struct{
@@ -221,6 +223,7 @@ bool                  VORBISDecoder_AllocateBuffers();
 void                  VORBISDecoder_FreeBuffers();
 void                  VORBISDecoder_ClearBuffers();
 void                  VORBISsetDefaults();
+void                  VORBISDecoderSeekReset();
 void                  clearGlobalConfigurations();
 int                   VORBISDecode(uint8_t* inbuf, int* bytesLeft, short* outbuf);
 uint8_t               VORBISGetChannels();
@@ -263,6 +266,7 @@ int32_t*              floor0_inverse1(vorbis_info_floor_t* i, int32_t* lsp);
 int32_t*              floor1_inverse1(vorbis_info_floor_t* in, int32_t* fit_value);
 int32_t               vorbis_book_decode(codebook_t* book);
 int32_t               decode_packed_entry_number(codebook_t* book);
+uint32_t              decode_chase_tree(codebook_t* book, int32_t lok, int read, int* used);
 int                   render_point(int x0, int x1, int y0, int y1, int x);
 int32_t               vorbis_book_decodev_set(codebook_t* book, int32_t* a, int n, int point);
 int                   decode_map(codebook_t* s, int32_t* v, int point);
@@ -307,6 +311,7 @@ int32_t  _float32_unpack(int32_t val, int *point);
 int      _determine_node_bytes(uint32_t used, uint8_t leafwidth);
 int      _determine_leaf_words(int nodeb, int leafwidth);
 int      _make_decode_table(codebook_t *s, char *lengthlist, uint8_t quantvals, int maptype);
+void     _make_decode_lut(codebook_t *s);
 int      _make_words(char *l, uint16_t n, uint32_t *r, uint8_t quantvals, codebook_t *b, int maptype);
 uint8_t  _book_maptype1_quantvals(codebook_t *b);
 void     vorbis_book_clear(codebook_t *b);
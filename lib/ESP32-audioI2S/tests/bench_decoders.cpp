@@ -0,0 +1,188 @@
+/*
+ * bench_decoders.cpp
+ * decode time of the decoders per second of audio: the test files are decoded from memory, the best of some runs
+ * counts (CPU time of the thread). Not a test, ctest does not run it:
+ *
+ *   cmake --build build --target bench_decoders && build/bench_decoders [runs]
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  the host figures compare one version of a decoder with another on the same machine, the ESP32 is an in-order core
+ *  without the caches of a desktop CPU; the decoder sources can be swapped for those of an older commit, the calls
+ *  below are the same
+ */
+#include "test_common.h"
+#include "flac_decoder/flac_decoder.h"
+#include "aac_decoder/aac_decoder.h"
+#include "opus_decoder/opus_decoder.h"
+#include "vorbis_decoder/vorbis_decoder.h"
+#include <time.h>
+
+#define BENCH_RUNS 5
+
+typedef double (*bench_fn)(const uint8_t* d, size_t size); // decodes the file once, returns the seconds of audio
+
+static double cpuMs() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static double decodeFLAC(const uint8_t* d, size_t size) {
+    // STREAMINFO, the other metadata blocks are skipped
+    size_t   pos = 4;
+    uint64_t si = 0;
+    bool     last = false;
+    while(!last && pos + 4 <= size) {
+        last = d[pos] & 0x80;
+        if((d[pos] & 0x7F) == 0) {
+            for(int i = 10; i < 18; i++) si = (si << 8) | d[pos + 4 + i];
+        }
+        pos += 4 + ((d[pos + 1] << 16) | (d[pos + 2] << 8) | d[pos + 3]);
+    }
+    uint32_t rate = si >> 44;
+    uint8_t  channels = ((si >> 41) & 7) + 1;
+    static int16_t out[MAX_BLOCKSIZE * 2];
+    FLACDecoder_AllocateBuffers();
+    FLACDecoder_setDefaults();
+    FLACSetRawBlockParams(channels, rate, ((si >> 36) & 31) + 1, si & 0xFFFFFFFFFULL, size - pos);
+    pos += FLACFindSyncWord((uint8_t*)&d[pos], size - pos);
+    uint64_t frames = 0;
+    while(pos < size) {
+        int len = min(size - pos, (size_t)16384);
+        int bytesLeft = len;
+        if(FLACDecode((uint8_t*)&d[pos], &bytesLeft, out) < 0) break;
+        pos += len - bytesLeft;
+        frames += FLACGetOutputSamps() / channels;
+    }
+    FLACDecoder_FreeBuffers();
+    return (double)frames / rate;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static double decodeAAC(const uint8_t* d, size_t size) {
+    // the raw AAC-LC frames in mdat of an m4a, 44.1 kHz stereo as Miss-Marple.m4a
+    size_t pos = 0, end = 0;
+    while(pos + 8 <= size) {
+        uint32_t len = test_rd32be(&d[pos]);
+        if(!memcmp(&d[pos + 4], "mdat", 4)) {
+            end = min(size, pos + len);
+            pos += 8;
+            break;
+        }
+        if(len < 8) return 0;
+        pos += len;
+    }
+    static int16_t out[2048 * 2];
+    AACDecoder_AllocateBuffers();
+    AACSetRawBlockParams(0, 2, 44100, 1);
+    uint64_t samples = 0;
+    while(pos < end) {
+        int len = min(end - pos, (size_t)1600);
+        int bytesLeft = len;
+        if(AACDecode((uint8_t*)&d[pos], &bytesLeft, out) < 0) {
+            pos++;
+            continue;
+        }
+        pos += len - bytesLeft;
+        samples += AACGetOutputSamps();
+    }
+    double seconds = (double)samples / AACGetChannels() / AACGetSampRate();
+    AACDecoder_FreeBuffers();
+    return seconds;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static double decodeOpus(const uint8_t* d, size_t size) {
+    // the pages of an Ogg Opus file, the output is stereo
+    static int16_t out[8192];
+    OPUSDecoder_AllocateBuffers();
+    OPUSsetDefaults();
+    uint64_t frames = 0;
+    size_t   pos = 0;
+    bool     playing = false;
+    while(pos < size) {
+        int len = min(size - pos, (size_t)1024);
+        if(!playing) {
+            int sync = OPUSFindSyncWord((uint8_t*)&d[pos], len);
+            if(sync < 0) {
+                pos += len;
+                continue;
+            }
+            pos += sync;
+            playing = true;
+            continue;
+        }
+        int bytesLeft = len;
+        int ret = OPUSDecode((uint8_t*)&d[pos], &bytesLeft, out);
+        if(ret < 0) {
+            playing = false;
+            pos++;
+            continue;
+        }
+        pos += len - bytesLeft;
+        if(ret != OPUS_PARSE_OGG_DONE) frames += OPUSGetOutputSamps();
+    }
+    double seconds = (double)frames / OPUSGetSampRate();
+    OPUSDecoder_FreeBuffers();
+    return seconds;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static double decodeVorbis(const uint8_t* d, size_t size) {
+    // the pages of an Ogg Vorbis file, the output is stereo
+    static int16_t out[16384];
+    VORBISDecoder_AllocateBuffers();
+    VORBISsetDefaults();
+    uint64_t frames = 0;
+    size_t   pos = 0;
+    bool     playing = false;
+    while(pos < size) {
+        int len = min(size - pos, (size_t)8192);
+        if(!playing) {
+            int sync = VORBISFindSyncWord((uint8_t*)&d[pos], len);
+            if(sync < 0) {
+                pos += len;
+                continue;
+            }
+            pos += sync;
+            playing = true;
+            continue;
+        }
+        int bytesLeft = len;
+        int ret = VORBISDecode((uint8_t*)&d[pos], &bytesLeft, out);
+        if(ret < 0) {
+            playing = false;
+            pos++;
+            continue;
+        }
+        pos += len - bytesLeft;
+        if(ret != VORBIS_PARSE_OGG_DONE) frames += VORBISGetOutputSamps();
+    }
+    double seconds = (double)frames / VORBISGetSampRate();
+    VORBISDecoder_FreeBuffers();
+    return seconds;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void bench(const char* codec, const char* file, bench_fn fn, int runs) {
+    std::vector<uint8_t> d = test_readFile(file);
+    if(d.empty()) return;
+    size_t size = d.size();
+    d.resize(size + 8192, 0); // the bit readers may look ahead
+    double best = 1e30, seconds = 0;
+    for(int i = 0; i < runs; i++) {
+        double t0 = cpuMs();
+        seconds = fn(d.data(), size);
+        best = std::min(best, cpuMs() - t0);
+    }
+    printf("%-7s %-26s %6.2f s audio  %8.1f ms  %6.2f ms per s  %5.0fx real time\n", codec, file, seconds, best,
+           best / seconds, seconds * 1000 / best);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : BENCH_RUNS;
+    if(runs < 1) runs = 1;
+    bench("flac", "Santiano-Wellerman.flac", decodeFLAC, runs);
+    bench("aac", "Miss-Marple.m4a", decodeAAC, runs);
+    bench("opus", "sample.opus", decodeOpus, runs);
+    bench("vorbis", "Collide.ogg", decodeVorbis, runs);
+    return s_testFailures;
+}
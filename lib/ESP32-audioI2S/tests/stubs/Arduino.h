@@ -0,0 +1,222 @@
+/*
+ * Arduino.h
+ * host stand-in for the parts of the Arduino core and FreeRTOS the decoders and helper modules use
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
+#include <string>
+using std::min; using std::max;
+// size_t is 32 bit on the ESP32, min(uint32_t, size_t) compiles there
+template <typename A, typename B, typename = typename std::enable_if<!std::is_same<A, B>::value>::type>
+static inline typename std::common_type<A, B>::type min(A a, B b) { return a < b ? a : b; }
+template <typename A, typename B, typename = typename std::enable_if<!std::is_same<A, B>::value>::type>
+static inline typename std::common_type<A, B>::type max(A a, B b) { return a > b ? a : b; }
+using std::vector;
+
+typedef bool boolean;
+
+#define ESP_IDF_VERSION_MAJOR 5
+
+// the parts of the Arduino String the sources use
+class String {
+public:
+    String() {}
+    String(const char* s) : m_s(s ? s : "") {}
+    String(const std::string& s) : m_s(s) {}
+    String(const String& s) = default;
+    explicit String(int v) : m_s(std::to_string(v)) {}
+    String&     operator=(const String& s) = default;
+    size_t      length() const { return m_s.size(); }
+    const char* c_str() const { return m_s.c_str(); }
+    char        charAt(size_t i) const { return i < m_s.size() ? m_s[i] : 0; }
+    bool        operator==(const char* s) const { return m_s == s; }
+    bool        operator==(const String& s) const { return m_s == s.m_s; }
+    String&     operator+=(const char* s) { m_s += s; return *this; }
+    String&     operator+=(const String& s) { m_s += s.m_s; return *this; }
+    String&     operator+=(char c) { m_s += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.m_s + b.m_s); }
+    friend String operator+(const String& a, const char* b) { return String(a.m_s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.m_s); }
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    friend String operator+(const String& a, T v) { return String(a.m_s + std::to_string(v)); }
+
+private:
+    std::string m_s;
+};
+static inline char toLowerCase(char c) { return tolower(c); }
+static inline char* lltoa(long long v, char* buf, int base) { // base 10 only
+    sprintf(buf, "%lld", v);
+    return buf;
+}
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38) // newlib has it, glibc since 2.38
+static inline size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t n = strlen(src);
+    if(size) { size_t k = n < size ? n : size - 1; memcpy(dst, src, k); dst[k] = 0; }
+    return n;
+}
+#endif
+
+#define log_e(fmt, ...) fprintf(stderr, "E: " fmt "\n", ##__VA_ARGS__)
+#define log_w(fmt, ...) do{}while(0)
+#define log_i(fmt, ...) do{}while(0)
+#define log_d(fmt, ...) do{}while(0)
+#define log_v(fmt, ...) do{}while(0)
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+#ifndef _min
+#define _min(a,b) ((a)<(b)?(a):(b))
+#define _max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+// memory, PSRAM is plain heap on the host
+#define MALLOC_CAP_DEFAULT  (1 << 0)
+#define MALLOC_CAP_SPIRAM   (1 << 1)
+#define MALLOC_CAP_INTERNAL (1 << 2)
+#define MALLOC_CAP_8BIT     (1 << 3)
+static inline bool  psramFound() { return true; }
+static inline bool  psramInit() { return true; }
+static inline void* ps_malloc(size_t n) { return malloc(n); }
+static inline void* ps_calloc(size_t n, size_t s) { return calloc(n, s); }
+static inline void* ps_realloc(void* p, size_t n) { return realloc(p, n); }
+static inline void* heap_caps_malloc(size_t n, uint32_t) { return malloc(n); }
+static inline void* heap_caps_calloc(size_t n, size_t s, uint32_t) { return calloc(n, s); }
+static inline void* heap_caps_malloc_prefer(size_t n, size_t, ...) { return malloc(n); }
+static inline void* heap_caps_calloc_prefer(size_t n, size_t s, size_t, ...) { return calloc(n, s); }
+static inline size_t heap_caps_get_free_size(uint32_t) { return 200000; }
+struct EspClass {
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getFreePsram() { return 4000000; }
+    uint32_t getMaxAllocHeap() { return 100000; }
+};
+static EspClass ESP;
+
+//----------------------------------------------------------------------------------------------------------------------
+// time
+inline int64_t s_hostTimeUs = -1;   // >= 0: the time of micros() and esp_timer_get_time(), a test moves it on
+inline uint32_t micros() {          // one clock for all translation units
+    using namespace std::chrono;
+    static auto t0 = steady_clock::now();
+    if(s_hostTimeUs >= 0) return (uint32_t)s_hostTimeUs;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+static inline uint32_t millis() { return micros() / 1000; }
+static inline int64_t  esp_timer_get_time() { return s_hostTimeUs >= 0 ? s_hostTimeUs : micros(); }
+static inline void     delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+//----------------------------------------------------------------------------------------------------------------------
+// FreeRTOS, tasks are threads and a mutex is a recursive mutex
+typedef std::recursive_mutex* SemaphoreHandle_t;
+typedef std::thread*          TaskHandle_t;
+typedef int                   BaseType_t;
+#define portMAX_DELAY     0xFFFFFFFF
+#define pdTRUE            1
+#define pdFALSE           0
+#define pdPASS            1
+#define pdMS_TO_TICKS(ms) (ms)
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::recursive_mutex; }
+static inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new std::recursive_mutex; }
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t m, uint32_t) { m->lock(); return pdTRUE; }
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t m) { m->unlock(); return pdTRUE; }
+static inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t m, uint32_t) { m->lock(); return pdTRUE; }
+static inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t m) { m->unlock(); return pdTRUE; }
+static inline void       vSemaphoreDelete(SemaphoreHandle_t m) { delete m; }
+static inline void       vTaskDelay(uint32_t ticks) { if(ticks) std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+static inline TaskHandle_t xTaskGetCurrentTaskHandle() { return NULL; }
+// task notifications count per thread
+struct host_notify_t {
+    std::mutex                          m;
+    std::condition_variable             cv;
+    std::map<std::thread::id, uint32_t> count;
+};
+inline host_notify_t s_hostNotify;
+static inline void xTaskNotifyGive(TaskHandle_t t) {
+    if(!t) return;
+    std::lock_guard<std::mutex> lock(s_hostNotify.m);
+    s_hostNotify.count[t->get_id()]++;
+    s_hostNotify.cv.notify_all();
+}
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, uint32_t ticks) {
+    std::unique_lock<std::mutex> lock(s_hostNotify.m);
+    uint32_t& n = s_hostNotify.count[std::this_thread::get_id()];
+    auto      given = [&] { return n > 0; };
+    if(ticks == portMAX_DELAY) s_hostNotify.cv.wait(lock, given);
+    else if(!s_hostNotify.cv.wait_for(lock, std::chrono::milliseconds(ticks), given)) return 0;
+    uint32_t v = n;
+    n = clear ? 0 : n - 1;
+    return v;
+}
+static inline uint32_t   uxTaskGetStackHighWaterMark(TaskHandle_t) { return 1000; }
+static inline void       vTaskDelete(TaskHandle_t t) { if(t && t->joinable()) t->detach(); }
+static inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char*, uint32_t, void* arg, uint32_t,
+                                                 TaskHandle_t* handle, int) {
+    TaskHandle_t t = new std::thread(fn, arg);
+    if(handle) *handle = t;
+    else t->detach();
+    return pdPASS;
+}
+// queues copy their items, as in FreeRTOS
+struct QueueDefinition {
+    std::mutex                        m;
+    std::condition_variable           cv;
+    std::deque<std::vector<uint8_t>>  items;
+    size_t                            length;
+    size_t                            itemSize;
+};
+typedef QueueDefinition* QueueHandle_t;
+static inline QueueHandle_t xQueueCreate(size_t length, size_t itemSize) {
+    QueueHandle_t q = new QueueDefinition;
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+static inline void       vQueueDelete(QueueHandle_t q) { delete q; }
+static inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, uint32_t) {
+    std::lock_guard<std::mutex> lock(q->m);
+    if(q->items.size() >= q->length) return pdFALSE;
+    q->items.emplace_back((const uint8_t*)item, (const uint8_t*)item + q->itemSize);
+    q->cv.notify_one();
+    return pdTRUE;
+}
+static inline BaseType_t xQueueReceive(QueueHandle_t q, void* item, uint32_t ticks) {
+    std::unique_lock<std::mutex> lock(q->m);
+    auto ready = [q] { return !q->items.empty(); };
+    if(ticks == portMAX_DELAY) q->cv.wait(lock, ready);
+    else if(!q->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready)) return pdFALSE;
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    return pdTRUE;
+}
+static inline uint32_t   uxQueueMessagesWaiting(QueueHandle_t q) { std::lock_guard<std::mutex> lock(q->m); return q->items.size(); }
+static inline BaseType_t xQueueReset(QueueHandle_t q) { std::lock_guard<std::mutex> lock(q->m); q->items.clear(); return pdPASS; }
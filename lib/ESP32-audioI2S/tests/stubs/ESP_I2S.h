@@ -0,0 +1,46 @@
+/*
+ * ESP_I2S.h
+ * host stand-in for the I2SClass of the Arduino core 3, standard mode RX on a channel of the host I2S driver
+ * (driver/i2s_std.h): the test records into rxChan() with i2s_host_record(), readBytes() takes what is there
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
+#include "driver/i2s_std.h"
+
+typedef enum { I2S_MODE_STD = 0 } i2s_mode_t;
+
+class I2SClass {
+public:
+    virtual ~I2SClass() { end(); }
+    void setPins(int8_t bclk, int8_t ws, int8_t dout, int8_t din = -1, int8_t mclk = -1) {}
+    void setTimeout(int ms) {}
+    bool begin(i2s_mode_t mode, uint32_t rate, i2s_data_bit_width_t bits, i2s_slot_mode_t ch, int8_t slot_mask = -1) {
+        end();
+        i2s_chan_config_t cfg = {I2S_NUM_0, I2S_ROLE_MASTER, 6, 240, false}; // I2S_CHANNEL_DEFAULT_CONFIG
+        i2s_new_channel(&cfg, NULL, &m_rx);
+        i2s_std_config_t std = {};
+        std.clk_cfg.sample_rate_hz = rate;
+        std.slot_cfg.data_bit_width = bits;
+        std.slot_cfg.slot_mode = ch;
+        i2s_channel_init_std_mode(m_rx, &std);
+        return i2s_channel_enable(m_rx) == ESP_OK;
+    }
+    bool end() {
+        if(m_rx) i2s_del_channel(m_rx);
+        m_rx = NULL;
+        return true;
+    }
+    virtual size_t readBytes(char* buffer, size_t size) {
+        size_t n = 0;
+        if(m_rx) i2s_channel_read(m_rx, buffer, size, &n, 0);
+        return n;
+    }
+    i2s_chan_handle_t rxChan() { return m_rx; }
+    i2s_chan_handle_t txChan() { return NULL; }
+
+private:
+    i2s_chan_handle_t m_rx = NULL;
+};
@@ -0,0 +1,108 @@
+/*
+ * FS.h
+ * host stand-in for the Arduino FS and File classes, a directory of the host file system is the card
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
+#include <string>
+#include <memory>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+
+#define FILE_READ  "r"
+#define FILE_WRITE "w"
+
+class File {
+public:
+    File() {}
+    File(FILE* f, const std::string& path) : m_f(f, [](FILE* x) { if(x) fclose(x); }), m_path(path) { setName(); }
+    File(DIR* d, const std::string& path) : m_d(d, [](DIR* x) { if(x) closedir(x); }), m_path(path) { setName(); }
+    explicit operator bool() const { return (bool)m_f || (bool)m_d; }
+    size_t   read(uint8_t* buf, size_t n) {
+        size_t r = m_f ? fread(buf, 1, n, m_f.get()) : 0;
+        s_bytesRead += r;
+        return r;
+    }
+    int      read() { uint8_t c; return read(&c, 1) == 1 ? c : -1; }
+    size_t   readBytes(char* buf, size_t n) { return read((uint8_t*)buf, n); }
+    size_t   write(const uint8_t* buf, size_t n) { return m_f ? fwrite(buf, 1, n, m_f.get()) : 0; }
+    bool     seek(uint32_t pos) { return m_f && fseek(m_f.get(), pos, SEEK_SET) == 0; }
+    size_t   position() { return m_f ? ftell(m_f.get()) : 0; }
+    size_t   size() { struct stat st; return stat(m_path.c_str(), &st) == 0 ? st.st_size : 0; }
+    size_t   available() { return size() - position(); }
+    time_t   getLastWrite() { struct stat st; return stat(m_path.c_str(), &st) == 0 ? st.st_mtime : 0; }
+    void     close() { m_f.reset(); m_d.reset(); }
+    bool     isDirectory() { return (bool)m_d; }
+    const char* name() { return m_name.c_str(); }
+    const char* path() { return m_path.c_str(); }
+
+    File openNextFile() {
+        std::string full;
+        bool        dir;
+        if(!nextEntry(&full, &dir)) return File();
+        s_opens++;
+        if(dir) return File(opendir(full.c_str()), full);
+        return File(fopen(full.c_str(), "rb"), full);
+    }
+    String getNextFileName(bool* isDir) { // the path, the entry is not opened
+        std::string full;
+        if(!nextEntry(&full, isDir)) return String();
+        return String(full.substr(s_rootLen));
+    }
+
+    static inline size_t s_bytesRead = 0; // all handles, tests look at the I/O a function needs
+    static inline size_t s_opens = 0;     // files opened while walking a directory
+    static inline size_t s_rootLen = 0;   // length of the host path of the card
+
+private:
+    void setName() {
+        size_t k = m_path.rfind('/');
+        m_name = (k == std::string::npos) ? m_path : m_path.substr(k + 1);
+    }
+    bool nextEntry(std::string* full, bool* dir) {
+        if(!m_d) return false;
+        struct dirent* e;
+        while((e = readdir(m_d.get()))) {
+            if(!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+            *full = m_path + "/" + e->d_name;
+            struct stat st;
+            *dir = stat(full->c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+            return true;
+        }
+        return false;
+    }
+
+    std::shared_ptr<FILE> m_f;
+    std::shared_ptr<DIR>  m_d;
+    std::string           m_path;
+    std::string           m_name;
+};
+
+namespace fs {
+class FS {
+public:
+    FS(const std::string& root) : m_root(root) { File::s_rootLen = root.size(); }
+    File open(const char* path, const char* mode = FILE_READ) {
+        std::string full = m_root + path;
+        while(full.size() > m_root.size() + 1 && full.back() == '/') full.pop_back();
+        struct stat st;
+        if(mode[0] != 'w' && stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return File(opendir(full.c_str()), full);
+        FILE* f = fopen(full.c_str(), mode[0] == 'w' ? "wb" : "rb");
+        return f ? File(f, full) : File();
+    }
+    bool exists(const char* path) { struct stat st; return stat((m_root + path).c_str(), &st) == 0; }
+    bool mkdir(const char* path) { return ::mkdir((m_root + path).c_str(), 0755) == 0; }
+    bool remove(const char* path) { return ::remove((m_root + path).c_str()) == 0; }
+    bool rmdir(const char* path) { return ::rmdir((m_root + path).c_str()) == 0; }
+    bool rename(const char* from, const char* to) { return ::rename((m_root + from).c_str(), (m_root + to).c_str()) == 0; }
+
+private:
+    std::string m_root;
+};
+}
+using fs::FS;
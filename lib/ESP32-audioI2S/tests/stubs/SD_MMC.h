@@ -0,0 +1,11 @@
+/*
+ * SD_MMC.h
+ * host stand-in for the SD card, the test defines SD_MMC on a temporary directory
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "FS.h"
+
+extern fs::FS SD_MMC;
@@ -0,0 +1,11 @@
+/*
+ * SPIFFS.h
+ * host stand-in, the file system objects are defined by the tests that use them
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "FS.h"
+
+extern fs::FS SPIFFS;
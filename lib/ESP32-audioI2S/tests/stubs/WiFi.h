@@ -0,0 +1,112 @@
+/*
+ * WiFi.h
+ * host stand-in for the Arduino WiFiClient, a plain TCP socket, tests talk to a server on localhost
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
+#include <map>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+class WiFiClient {
+public:
+    WiFiClient() {}
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+    virtual ~WiFiClient() { stop(); }
+
+    int connect(const char* host, uint16_t port, int32_t timeout_ms = 3000) {
+        stop();
+        auto local = s_localHosts.find(host);
+        if(local != s_localHosts.end()) {
+            host = "127.0.0.1";
+            port = local->second;
+        }
+        char     service[8];
+        addrinfo hints = {}, *res = NULL;
+        hints.ai_socktype = SOCK_STREAM;
+        snprintf(service, sizeof(service), "%u", port);
+        if(getaddrinfo(host, service, &hints, &res) || !res) return 0;
+        m_fd = socket(res->ai_family, SOCK_STREAM, 0);
+        if(m_fd >= 0 && ::connect(m_fd, res->ai_addr, res->ai_addrlen)) { ::close(m_fd); m_fd = -1; }
+        freeaddrinfo(res);
+        if(m_fd < 0) return 0;
+        int one = 1;
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        s_connects++;
+        return 1;
+    }
+    int available() {
+        if(m_fd < 0) return 0;
+        int n = 0;
+        ioctl(m_fd, FIONREAD, &n);
+        return n;
+    }
+    uint8_t connected() {
+        if(m_fd < 0) return false;
+        if(available()) return true;
+        pollfd p = {m_fd, POLLIN, 0};
+        char   c;
+        if(poll(&p, 1, 0) > 0 && recv(m_fd, &c, 1, MSG_PEEK) <= 0) return false; // closed by the server
+        return true;
+    }
+    int read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+    int read(uint8_t* buf, size_t n) { // does not block, as on the ESP32
+        if(m_fd < 0) return -1;
+        int r = recv(m_fd, buf, n, MSG_DONTWAIT);
+        return r > 0 ? r : (r == 0 ? 0 : -1);
+    }
+    int peek() {
+        uint8_t c;
+        return (m_fd >= 0 && recv(m_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1) ? c : -1;
+    }
+    size_t readBytes(uint8_t* buf, size_t n) { int r = read(buf, n); return r > 0 ? r : 0; }
+    size_t write(const uint8_t* buf, size_t n) { return m_fd >= 0 ? ::send(m_fd, buf, n, MSG_NOSIGNAL) : 0; }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t println(const char* s = "") { return print(s) + print("\r\n"); }
+    size_t printf(const char* fmt, ...) {
+        char    buf[2048];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        return write((const uint8_t*)buf, min(n, (int)sizeof(buf) - 1));
+    }
+    void stop() {
+        if(m_fd >= 0) ::close(m_fd);
+        m_fd = -1;
+    }
+    void flush() {}
+    void setNoDelay(bool) {}
+    void setTimeout(uint32_t) {}
+    void setConnectionTimeout(uint32_t) {}
+    operator bool() { return connected(); }
+
+    static inline uint32_t s_connects = 0; // tests count the connections a function needs
+    static inline std::map<std::string, uint16_t> s_localHosts; // host name -> port of a test server on 127.0.0.1
+
+private:
+    int m_fd = -1;
+};
+
+#define WL_CONNECTED 3
+class WiFiClass {
+public:
+    uint8_t status() { return WL_CONNECTED; }
+    bool    isConnected() { return true; }
+    int8_t  RSSI() { return -50; }
+};
+static WiFiClass WiFi;
@@ -0,0 +1,16 @@
+/*
+ * WiFiClientSecure.h
+ * host stand-in, TLS is not emulated: the secure client is a plain TCP client
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "WiFi.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() {}
+    void setCACert(const char*) {}
+    void setHandshakeTimeout(unsigned long) {}
+};
@@ -0,0 +1,191 @@
+/*
+ * i2s_std.h
+ * host stand-in for the ESP-IDF 5 I2S standard mode driver. A TX channel has dma_desc_num buffers of dma_frame_num
+ * frames, writes never block; the test plays the channel with i2s_host_play(), which moves the frames to 'played'
+ * (an empty DMA sends silence, it is counted in 'underruns' and not kept) and calls on_sent for every buffer. An RX
+ * channel is filled with i2s_host_record(): a buffer can be read once it is full, it calls on_recv then; with all
+ * buffers full the oldest one is dropped and on_recv_q_ovf is called.
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
+
+typedef int esp_err_t;
+#define ESP_OK          0
+#define ESP_FAIL        -1
+#define ESP_ERR_TIMEOUT 0x107
+
+typedef int gpio_num_t;
+typedef enum { I2S_NUM_0 = 0, I2S_NUM_1 = 1, I2S_NUM_AUTO = 2 } i2s_port_t;
+typedef enum { I2S_ROLE_MASTER, I2S_ROLE_SLAVE } i2s_role_t;
+typedef enum { I2S_DATA_BIT_WIDTH_8BIT = 8, I2S_DATA_BIT_WIDTH_16BIT = 16, I2S_DATA_BIT_WIDTH_24BIT = 24,
+               I2S_DATA_BIT_WIDTH_32BIT = 32 } i2s_data_bit_width_t;
+typedef enum { I2S_SLOT_BIT_WIDTH_AUTO = 0, I2S_SLOT_BIT_WIDTH_16BIT = 16, I2S_SLOT_BIT_WIDTH_32BIT = 32 } i2s_slot_bit_width_t;
+typedef enum { I2S_SLOT_MODE_MONO = 1, I2S_SLOT_MODE_STEREO = 2 } i2s_slot_mode_t;
+typedef enum { I2S_STD_SLOT_LEFT = 1, I2S_STD_SLOT_RIGHT = 2, I2S_STD_SLOT_BOTH = 3 } i2s_std_slot_mask_t;
+typedef enum { I2S_CLK_SRC_DEFAULT } i2s_clock_src_t;
+typedef enum { I2S_MCLK_MULTIPLE_128 = 128, I2S_MCLK_MULTIPLE_256 = 256, I2S_MCLK_MULTIPLE_384 = 384 } i2s_mclk_multiple_t;
+
+typedef struct {
+    i2s_port_t id;
+    i2s_role_t role;
+    uint32_t   dma_desc_num;
+    uint32_t   dma_frame_num;
+    bool       auto_clear;
+} i2s_chan_config_t;
+typedef struct {
+    uint32_t            sample_rate_hz;
+    i2s_clock_src_t     clk_src;
+    i2s_mclk_multiple_t mclk_multiple;
+} i2s_std_clk_config_t;
+typedef struct {
+    i2s_data_bit_width_t data_bit_width;
+    i2s_slot_bit_width_t slot_bit_width;
+    i2s_slot_mode_t      slot_mode;
+    i2s_std_slot_mask_t  slot_mask;
+    uint32_t             ws_width;
+    bool                 ws_pol;
+    bool                 bit_shift;
+    bool                 msb_right;
+} i2s_std_slot_config_t;
+typedef struct {
+    gpio_num_t mclk;
+    gpio_num_t bclk;
+    gpio_num_t ws;
+    gpio_num_t dout;
+    gpio_num_t din;
+    struct {
+        bool mclk_inv;
+        bool bclk_inv;
+        bool ws_inv;
+    } invert_flags;
+} i2s_std_gpio_config_t;
+typedef struct {
+    i2s_std_clk_config_t  clk_cfg;
+    i2s_std_slot_config_t slot_cfg;
+    i2s_std_gpio_config_t gpio_cfg;
+} i2s_std_config_t;
+
+typedef struct i2s_host_channel* i2s_chan_handle_t;
+typedef struct {
+    void*  data;
+    size_t size;
+} i2s_event_data_t;
+typedef bool (*i2s_isr_callback_t)(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+typedef struct {
+    i2s_isr_callback_t on_recv;
+    i2s_isr_callback_t on_recv_q_ovf;
+    i2s_isr_callback_t on_sent;
+    i2s_isr_callback_t on_send_q_ovf;
+} i2s_event_callbacks_t;
+
+struct i2s_host_channel {
+    i2s_chan_config_t     cfg;
+    i2s_std_config_t      std;
+    i2s_event_callbacks_t cbs;
+    void*                 user;
+    bool                  tx;
+    bool                  enabled;
+    std::mutex            lock;
+    std::deque<uint8_t>   dma;      // TX: written, not played yet. RX: recorded, not read yet
+    std::vector<uint8_t>  filling;  // RX: the buffer the DMA records into
+    std::vector<uint8_t>  played;   // TX: everything the DMA has sent
+    uint32_t              underruns;// TX: frames of silence
+    uint32_t              writes;   // i2s_channel_write() calls
+    uint32_t              partial;  // frames of the current buffer
+};
+inline i2s_chan_handle_t i2s_host_tx = NULL;        // the last TX channel, tests reach the one of an Audio object
+
+static inline size_t i2s_host_frameBytes(i2s_chan_handle_t h) {
+    uint32_t bits = h->std.slot_cfg.data_bit_width ? h->std.slot_cfg.data_bit_width : 16;
+    uint32_t ch = h->std.slot_cfg.slot_mode == I2S_SLOT_MODE_MONO ? 1 : 2;
+    return bits / 8 * ch;
+}
+static inline size_t i2s_host_capacity(i2s_chan_handle_t h) {
+    return (size_t)h->cfg.dma_desc_num * h->cfg.dma_frame_num * i2s_host_frameBytes(h);
+}
+
+static inline esp_err_t i2s_new_channel(const i2s_chan_config_t* cfg, i2s_chan_handle_t* tx, i2s_chan_handle_t* rx) {
+    i2s_chan_handle_t* out[2] = {tx, rx};
+    for(int k = 0; k < 2; k++) {
+        if(!out[k]) continue;
+        i2s_chan_handle_t h = new i2s_host_channel();
+        h->cfg = *cfg;
+        h->tx = (k == 0);
+        *out[k] = h;
+        if(h->tx) i2s_host_tx = h;
+    }
+    return ESP_OK;
+}
+static inline esp_err_t i2s_del_channel(i2s_chan_handle_t h) {
+    if(h == i2s_host_tx) i2s_host_tx = NULL;
+    delete h;
+    return ESP_OK;
+}
+static inline esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t h, const i2s_std_config_t* cfg) { h->std = *cfg; return ESP_OK; }
+static inline esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t h, const i2s_std_clk_config_t* cfg) { h->std.clk_cfg = *cfg; return ESP_OK; }
+static inline esp_err_t i2s_channel_reconfig_std_slot(i2s_chan_handle_t h, const i2s_std_slot_config_t* cfg) { h->std.slot_cfg = *cfg; return ESP_OK; }
+static inline esp_err_t i2s_channel_reconfig_std_gpio(i2s_chan_handle_t h, const i2s_std_gpio_config_t* cfg) { h->std.gpio_cfg = *cfg; return ESP_OK; }
+static inline esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t h, const i2s_event_callbacks_t* cbs, void* user) {
+    h->cbs = *cbs;
+    h->user = user;
+    return ESP_OK;
+}
+static inline esp_err_t i2s_channel_enable(i2s_chan_handle_t h) { h->enabled = true; return ESP_OK; }
+static inline esp_err_t i2s_channel_disable(i2s_chan_handle_t h) { h->enabled = false; return ESP_OK; }
+static inline esp_err_t i2s_channel_write(i2s_chan_handle_t h, const void* src, size_t size, size_t* written, uint32_t) {
+    std::lock_guard<std::mutex> lock(h->lock);
+    h->writes++;
+    size_t n = min(size, i2s_host_capacity(h) - h->dma.size());
+    h->dma.insert(h->dma.end(), (const uint8_t*)src, (const uint8_t*)src + n);
+    if(written) *written = n;
+    return n == size ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+static inline esp_err_t i2s_channel_read(i2s_chan_handle_t h, void* dst, size_t size, size_t* read, uint32_t) {
+    std::lock_guard<std::mutex> lock(h->lock);
+    size_t n = min(size, h->dma.size());
+    std::copy(h->dma.begin(), h->dma.begin() + n, (uint8_t*)dst);
+    h->dma.erase(h->dma.begin(), h->dma.begin() + n);
+    if(read) *read = n;
+    return n == size ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+// the DMA sends 'frames' frames, silence if nothing was written (auto_clear); on_sent after every buffer
+static inline void i2s_host_play(i2s_chan_handle_t h, uint32_t frames) {
+    size_t fb = i2s_host_frameBytes(h);
+    for(uint32_t i = 0; i < frames; i++) {
+        {
+            std::lock_guard<std::mutex> lock(h->lock);
+            if(h->dma.size() < fb) h->underruns++;
+            else {
+                h->played.insert(h->played.end(), h->dma.begin(), h->dma.begin() + fb);
+                h->dma.erase(h->dma.begin(), h->dma.begin() + fb);
+            }
+        }
+        if(++h->partial < h->cfg.dma_frame_num) continue;
+        h->partial = 0;
+        i2s_event_data_t ev = {NULL, h->cfg.dma_frame_num * fb};
+        if(h->cbs.on_sent) h->cbs.on_sent(h, &ev, h->user);
+    }
+}
+// the DMA receives 'len' bytes, on_recv after every buffer
+static inline void i2s_host_record(i2s_chan_handle_t h, const uint8_t* data, size_t len) {
+    size_t fb = i2s_host_frameBytes(h), buf = h->cfg.dma_frame_num * fb;
+    for(size_t i = 0; i + fb <= len; i += fb) {
+        h->filling.insert(h->filling.end(), data + i, data + i + fb);
+        if(h->filling.size() < buf) continue;
+        bool overflow;
+        {
+            std::lock_guard<std::mutex> lock(h->lock);
+            h->dma.insert(h->dma.end(), h->filling.begin(), h->filling.end());
+            overflow = h->dma.size() > i2s_host_capacity(h);
+            if(overflow) h->dma.erase(h->dma.begin(), h->dma.begin() + buf);
+        }
+        h->filling.clear();
+        i2s_event_data_t ev = {NULL, buf};
+        if(overflow && h->cbs.on_recv_q_ovf) h->cbs.on_recv_q_ovf(h, &ev, h->user);
+        if(h->cbs.on_recv) h->cbs.on_recv(h, &ev, h->user);
+    }
+}
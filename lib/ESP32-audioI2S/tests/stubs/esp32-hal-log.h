@@ -0,0 +1,9 @@
+/*
+ * esp32-hal-log.h
+ * host stand-in, the log macros are in Arduino.h
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
@@ -0,0 +1,9 @@
+/*
+ * esp_timer.h
+ * host stand-in, esp_timer_get_time() is in Arduino.h
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
@@ -0,0 +1,45 @@
+/*
+ * stream_buffer.h
+ * host stand-in for the FreeRTOS stream buffer, one writer and one reader; send and receive never block
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include "Arduino.h"
+
+struct StreamBufferDef_t {
+    std::mutex       m;
+    std::deque<char> data;
+    size_t           size;
+};
+typedef StreamBufferDef_t* StreamBufferHandle_t;
+
+static inline StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t) {
+    StreamBufferHandle_t s = new StreamBufferDef_t;
+    s->size = size;
+    return s;
+}
+static inline void vStreamBufferDelete(StreamBufferHandle_t s) { delete s; }
+static inline size_t xStreamBufferSend(StreamBufferHandle_t s, const void* data, size_t len, uint32_t) {
+    std::lock_guard<std::mutex> lock(s->m);
+    size_t n = min(len, s->size - s->data.size());
+    s->data.insert(s->data.end(), (const char*)data, (const char*)data + n);
+    return n;
+}
+static inline size_t xStreamBufferReceive(StreamBufferHandle_t s, void* data, size_t len, uint32_t) {
+    std::lock_guard<std::mutex> lock(s->m);
+    size_t n = min(len, s->data.size());
+    std::copy(s->data.begin(), s->data.begin() + n, (char*)data);
+    s->data.erase(s->data.begin(), s->data.begin() + n);
+    return n;
+}
+static inline size_t xStreamBufferBytesAvailable(StreamBufferHandle_t s) {
+    std::lock_guard<std::mutex> lock(s->m);
+    return s->data.size();
+}
+static inline BaseType_t xStreamBufferReset(StreamBufferHandle_t s) {
+    std::lock_guard<std::mutex> lock(s->m);
+    s->data.clear();
+    return pdPASS;
+}
@@ -0,0 +1,53 @@
+/*
+ * cencode.h
+ * host stand-in for the libb64 encoder of the Arduino core
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define base64_encode_expected_len(n) ((((4 * (n)) / 3) + 3) & ~3)
+
+typedef struct {
+    uint8_t bytes[3];
+    int     count;
+} base64_encodestate;
+
+static inline char base64_encode_value(uint8_t v) {
+    return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[v & 0x3F];
+}
+static inline void base64_init_encodestate(base64_encodestate* s) { s->count = 0; }
+static inline int  base64_encode_block(const char* in, int len, char* out, base64_encodestate* s) {
+    char* o = out;
+    for(int i = 0; i < len; i++) {
+        s->bytes[s->count++] = in[i];
+        if(s->count < 3) continue;
+        *o++ = base64_encode_value(s->bytes[0] >> 2);
+        *o++ = base64_encode_value((s->bytes[0] << 4) | (s->bytes[1] >> 4));
+        *o++ = base64_encode_value((s->bytes[1] << 2) | (s->bytes[2] >> 6));
+        *o++ = base64_encode_value(s->bytes[2]);
+        s->count = 0;
+    }
+    return o - out;
+}
+static inline int base64_encode_blockend(char* out, base64_encodestate* s) {
+    char* o = out;
+    if(s->count == 1) {
+        *o++ = base64_encode_value(s->bytes[0] >> 2);
+        *o++ = base64_encode_value(s->bytes[0] << 4);
+        *o++ = '=';
+        *o++ = '=';
+    }
+    else if(s->count == 2) {
+        *o++ = base64_encode_value(s->bytes[0] >> 2);
+        *o++ = base64_encode_value((s->bytes[0] << 4) | (s->bytes[1] >> 4));
+        *o++ = base64_encode_value(s->bytes[1] << 2);
+        *o++ = '=';
+    }
+    *o = 0;
+    s->count = 0;
+    return o - out;
+}
@@ -0,0 +1,70 @@
+/*
+ * test_aac.cpp
+ * AAC decoder: the raw AAC-LC frames of an M4A decode to the same PCM as the helix reference
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  the expected hash was taken from the decoder before the table-driven Huffman decoding, the decoder is fixed-point,
+ *  so the output is bit exact on every host
+ */
+#include "test_common.h"
+#include "aac_decoder/aac_decoder.h"
+
+#define AAC_FILE        "Miss-Marple.m4a"
+#define AAC_PCM_HASH    0xC454F906
+#define AAC_FRAMES      1172      // stsz entries
+#define AAC_PCM_SAMPLES (AAC_FRAMES * 1024 * 2)
+
+static size_t findMdat(const std::vector<uint8_t>& d, size_t* end) {
+    size_t pos = 0;
+    while(pos + 8 <= d.size()) {
+        uint32_t len = test_rd32be(&d[pos]);
+        if(!memcmp(&d[pos + 4], "mdat", 4)) {
+            *end = min(d.size(), pos + len);
+            return pos + 8;
+        }
+        if(len < 8) break;
+        pos += len;
+    }
+    return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_aac_m4a() {
+    std::vector<uint8_t> d = test_readFile(AAC_FILE);
+    size_t end = 0;
+    size_t pos = findMdat(d, &end);
+    TEST_CHECK(pos > 0);
+    d.resize(d.size() + 2048, 0); // the bit reader may look ahead
+    TEST_CHECK(AACDecoder_AllocateBuffers());
+    AACSetRawBlockParams(0, 2, 44100, 1);
+    static int16_t out[2048 * 2];
+    uint32_t hash = 2166136261UL;
+    uint64_t samples = 0;
+    uint32_t frames = 0, errors = 0;
+    while(pos < end) {
+        int len = min(end - pos, (size_t)1600);
+        int bytesLeft = len;
+        int ret = AACDecode(&d[pos], &bytesLeft, out);
+        if(ret < 0) { errors++; pos++; continue; }
+        pos += len - bytesLeft;
+        int n = AACGetOutputSamps();
+        if(n) {
+            hash = test_fnv(out, n * sizeof(int16_t), hash);
+            samples += n;
+            frames++;
+        }
+    }
+    TEST_CHECK_EQ(errors, 0);
+    TEST_CHECK_EQ(AACGetChannels(), 2);
+    TEST_CHECK_EQ(AACGetSampRate(), 44100);
+    TEST_CHECK_EQ(frames, AAC_FRAMES);
+    TEST_CHECK_EQ(samples, AAC_PCM_SAMPLES);
+    TEST_CHECK_EQ(hash, AAC_PCM_HASH);
+    AACDecoder_FreeBuffers();
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_aac_m4a);
+    return s_testFailures;
+}
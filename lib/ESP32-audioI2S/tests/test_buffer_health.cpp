@@ -0,0 +1,184 @@
+/*
+ * test_buffer_health.cpp
+ * AudioBufferHealth with AudioBuffer: a throttled, jittery web source with stalls over ten minutes; the adaptive
+ * buffer plays it without underruns in less memory than the static worst-case size, a small static buffer does not.
+ * Histograms, per source statistics and the data through resize()
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Audio.h"
+#include <random>
+
+#define BH_RATE    16000   // bytes/s, 128 kbit/s mp3
+#define BH_FRAME   418     // bytes of one frame, 26.125 ms
+#define BH_SECONDS 600
+
+enum { STATIC_SMALL, STATIC_WORST, ADAPTIVE };
+
+typedef struct {
+    uint32_t underruns;
+    uint32_t audibleMs;  // the DMA ran dry
+    uint32_t badBytes;   // the decoder read other data than the source sent
+    size_t   peak;       // bytes of the buffer
+    size_t   avg;
+    uint32_t fillSamples;
+    uint32_t gapCount;
+    uint32_t refills;
+    uint32_t byteRate;
+} bh_run_t;
+
+// the link delivers packets every 5...35 ms at 1.5x the bitrate, stalls of 1.5...3 s every 15...40 s, a 16 KB socket
+// buffer in between; the decoder takes a frame when the DMA holds less than 160 ms. One step is one ms, the loop()
+// of Audio: read the socket, decode, update(), adapt.
+static bh_run_t run(int mode, uint32_t seed) {
+    std::mt19937      rng(seed);
+    bh_run_t          r = {};
+    AudioBuffer       buf;
+    AudioBufferHealth bh;
+    if(mode == STATIC_SMALL) buf.setBufsize(16000, 0);
+    uint32_t maxSize = buf.getMaxBufsize();
+    buf.init(mode == ADAPTIVE ? BH_MIN_SIZE : 0);
+    buf.changeMaxBlockSize(1600);
+    bh.begin(BH_HTTP);
+
+    uint32_t sock = 0, nextPkt = 0, stallEnd = 0, nextStall = 15000 + rng() % 25000, in = 0, out = 0;
+    double   dma = 0, memSum = 0;
+    bool     playing = false;
+    for(uint32_t t = 1; t < BH_SECONDS * 1000; t++) {
+        if(t >= nextStall) {
+            stallEnd = t + 1500 + rng() % 1500;
+            nextStall = stallEnd + 15000 + rng() % 25000;
+        }
+        if(t >= stallEnd && t >= nextPkt) {
+            nextPkt = t + 5 + rng() % 31;
+            sock = min(16384u, sock + (uint32_t)(1.5 * BH_RATE * (nextPkt - t) / 1000));
+        }
+        uint32_t n = min((size_t)sock, buf.writeSpace());
+        uint8_t* w = buf.getWritePtr();
+        for(uint32_t k = 0; k < n; k++) w[k] = (in + k) % 251;
+        buf.bytesWritten(n);
+        sock -= n;
+        in += n;
+
+        if(!playing && buf.bufferFilled() > 1600) playing = true;
+        while(playing && dma < 160) {
+            if(buf.bufferFilled() < buf.getMaxBlockSize()) {
+                bh.starved();
+                break;
+            }
+            uint8_t* p = buf.getReadPtr(); // the end of the ring is copied behind it
+            for(uint32_t k = 0; k < BH_FRAME; k++) r.badBytes += p[k] != (out + k) % 251;
+            buf.bytesWasRead(BH_FRAME);
+            out += BH_FRAME;
+            dma += 26.125;
+        }
+        if(playing) {
+            if(dma >= 1) dma -= 1;
+            else r.audibleMs++;
+        }
+        bh.update(buf.getBytesIn(), buf.bufferFilled(), buf.getBufsize(), buf.getMaxBlockSize(), playing, t);
+        if(mode == ADAPTIVE && bh.adaptDue(t)) {
+            uint32_t size = bh.adaptSize(buf.getBufsize(), buf.bufferFilled(), buf.getMaxBlockSize(), BH_RATE, maxSize);
+            if(size) TEST_CHECK(buf.resize(size, size > BH_INTERNAL_MAX));
+        }
+        r.peak = max(r.peak, (size_t)buf.getBufsize());
+        memSum += buf.getBufsize();
+    }
+    const bh_stats_t* st = bh.getStats(BH_HTTP);
+    r.underruns = st->underruns;
+    r.avg = memSum / (BH_SECONDS * 1000);
+    for(int i = 0; i < BH_FILL_BINS; i++) r.fillSamples += st->fill[i];
+    for(int i = 0; i < BH_GAP_BINS; i++) r.gapCount += st->gap[i];
+    r.refills = st->refills;
+    r.byteRate = st->byteRate;
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->refills, 0);   // the other sources are not touched
+    TEST_CHECK_EQ(bh.getStats(BH_HLS)->refills, 0);
+    return r;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_bh_adaptive() {
+    for(uint32_t seed = 1; seed <= 3; seed++) {
+        bh_run_t small = run(STATIC_SMALL, seed);
+        bh_run_t worst = run(STATIC_WORST, seed);
+        bh_run_t adapt = run(ADAPTIVE, seed);
+        printf("seed %u: underruns %u / %u / %u, audible %u / %u / %u ms, average size %zu / %zu / %zu\n", seed,
+               small.underruns, worst.underruns, adapt.underruns, small.audibleMs, worst.audibleMs, adapt.audibleMs,
+               small.avg, worst.avg, adapt.avg);
+        TEST_CHECK(small.underruns > 10);            // the stalls are longer than 14 KB last
+        TEST_CHECK(small.audibleMs > 0);
+        TEST_CHECK_EQ(worst.underruns, 0);
+        TEST_CHECK_EQ(adapt.underruns, 0);
+        TEST_CHECK(adapt.audibleMs <= worst.audibleMs); // what the source takes before the start is heard with any size
+        TEST_CHECK(adapt.peak < worst.peak / 4);
+        TEST_CHECK(adapt.avg < worst.avg / 4);
+        TEST_CHECK_EQ(adapt.badBytes, 0);            // the data survives every resize()
+        TEST_CHECK_EQ(small.badBytes, 0);
+        // one fill sample per 100 ms while playing, one gap per refill but the first, the consumed rate
+        TEST_CHECK(adapt.fillSamples > BH_SECONDS * 10 - 20 && adapt.fillSamples <= BH_SECONDS * 10);
+        TEST_CHECK(adapt.gapCount + 1 >= adapt.refills && adapt.gapCount <= adapt.refills);
+        TEST_CHECK_NEAR(adapt.byteRate, BH_RATE, BH_RATE / 10);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_bh_underrun_rules() {
+    AudioBufferHealth bh;
+    bh.begin(BH_SD);
+    uint32_t t = 0, in = 0;
+    // before four blocks were in the buffer a starved decoder is the start threshold
+    bh.update(in += 1000, 1000, 100000, 1600, true, t += 10);
+    bh.starved();
+    bh.update(in += 1000, 2000, 100000, 1600, true, t += 10);
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->underruns, 0);
+    // primed: starved, then data comes
+    bh.update(in += 8000, 10000, 100000, 1600, true, t += 10);
+    bh.starved();
+    bh.update(in, 1000, 100000, 1600, true, t += 10);
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->underruns, 0); // nothing came yet, it may be the end of the file
+    bh.update(in += 500, 1500, 100000, 1600, true, t += 10);
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->underruns, 1);
+    // the end of the file: starved and no more data
+    bh.starved();
+    for(int i = 0; i < 10; i++) bh.update(in, 1500, 100000, 1600, true, t += 10);
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->underruns, 1);
+    // a new connection of another kind, the SD statistics are kept
+    bh.begin(BH_HTTP);
+    TEST_CHECK_EQ(bh.getSource(), BH_HTTP);
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->underruns, 1);
+    TEST_CHECK_EQ(bh.getStats(BH_HTTP)->underruns, 0);
+    TEST_CHECK(bh.getStats(BH_SOURCES) == NULL);
+    bh.clear();
+    TEST_CHECK_EQ(bh.getStats(BH_SD)->underruns, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_bh_target() {
+    // a source without refills and a web source BH_NET_MS at least, an SD card that refills steadily much less
+    AudioBufferHealth bh;
+    uint32_t          net = (uint32_t)(BH_RATE * (BH_NET_MS * 1.5f + BH_MARGIN_MS) / 1000) + 4 * 1600;
+    bh.begin(BH_SD);
+    TEST_CHECK_EQ(bh.targetSize(1600, 0), 0);        // rate not known
+    TEST_CHECK_EQ(bh.targetSize(1600, BH_RATE), net);
+    uint32_t in = 0;
+    for(uint32_t t = 10; t < 5000; t += 10) bh.update(in += BH_RATE / 100, 20000, 100000, 1600, true, t);
+    TEST_CHECK(bh.targetSize(1600, BH_RATE) < net / 2);
+    TEST_CHECK(bh.targetSize(1600, BH_RATE) >= BH_RATE * BH_MARGIN_MS / 1000 + 4 * 1600);
+    bh.begin(BH_HTTP);
+    TEST_CHECK_EQ(bh.targetSize(1600, BH_RATE), net);
+    // adaptSize(): the constraints, grow at once, shrink below half only
+    uint32_t target = bh.targetSize(1600, BH_RATE) * 5 / 4;
+    TEST_CHECK_EQ(bh.adaptSize(BH_MIN_SIZE, 0, 1600, BH_RATE, 1000000), target);
+    TEST_CHECK_EQ(bh.adaptSize(BH_MIN_SIZE, 0, 1600, BH_RATE, 20000), 20000);
+    TEST_CHECK_EQ(bh.adaptSize(target, 0, 1600, BH_RATE, 1000000), 0);
+    TEST_CHECK_EQ(bh.adaptSize(2 * target - 1, 0, 1600, BH_RATE, 1000000), 0);
+    TEST_CHECK_EQ(bh.adaptSize(2 * target + 2, 0, 1600, BH_RATE, 1000000), target);
+    TEST_CHECK_EQ(bh.adaptSize(2 * target + 2, target, 1600, BH_RATE, 1000000), 0); // the data would not fit
+    TEST_CHECK_EQ(bh.adaptSize(BH_MIN_SIZE, 0, 1600, 0, 1000000), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_bh_target);
+    RUN_TEST(test_bh_underrun_rules);
+    RUN_TEST(test_bh_adaptive);
+    return s_testFailures;
+}
@@ -0,0 +1,123 @@
+/*
+ * test_common.h
+ * checks, test file access and small signal helpers shared by the host tests
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  every test is one executable, main() runs the test functions with RUN_TEST() and returns the number of failures
+ */
+#pragma once
+#include "Arduino.h"
+#include <string>
+
+#ifndef TESTFILES_DIR
+#define TESTFILES_DIR "../additional_info/Testfiles"
+#endif
+
+static int s_testFailures = 0;
+
+#define TEST_CHECK(cond) do { \
+    if(!(cond)) { s_testFailures++; fprintf(stderr, "%s:%d: FAILED: %s\n", __FILE__, __LINE__, #cond); } \
+} while(0)
+
+#define TEST_CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    if(_a != _b) { s_testFailures++; fprintf(stderr, "%s:%d: FAILED: %s == %s (%lld != %lld)\n", \
+                                             __FILE__, __LINE__, #a, #b, _a, _b); } \
+} while(0)
+
+#define TEST_CHECK_NEAR(a, b, tol) do { \
+    double _a = (double)(a), _b = (double)(b); \
+    if(fabs(_a - _b) > (tol)) { s_testFailures++; fprintf(stderr, "%s:%d: FAILED: %s ~ %s (%g != %g)\n", \
+                                                          __FILE__, __LINE__, #a, #b, _a, _b); } \
+} while(0)
+
+#define RUN_TEST(fn) do { \
+    int _f = s_testFailures; fn(); \
+    printf("%-40s %s\n", #fn, s_testFailures == _f ? "ok" : "FAILED"); \
+} while(0)
+
+//----------------------------------------------------------------------------------------------------------------------
+static std::vector<uint8_t> test_readFile(const char* name) {
+    std::vector<uint8_t> data;
+    std::string path = std::string(TESTFILES_DIR) + "/" + name;
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f) { fprintf(stderr, "can't open %s\n", path.c_str()); s_testFailures++; return data; }
+    uint8_t buf[16384];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return data;
+}
+static inline uint16_t test_rd16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static inline uint32_t test_rd32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static inline uint32_t test_rd32be(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+//----------------------------------------------------------------------------------------------------------------------
+// signal helpers
+static double test_rms(const int16_t* s, size_t n, size_t step = 1) {
+    double acc = 0;
+    size_t cnt = 0;
+    for(size_t i = 0; i < n; i += step) { acc += (double)s[i] * s[i]; cnt++; }
+    return cnt ? sqrt(acc / cnt) : 0;
+}
+static double test_dB(double x) { return 20 * log10(x > 1e-12 ? x : 1e-12); }
+static uint32_t test_fnv(const void* data, size_t len, uint32_t hash = 2166136261UL) {
+    const uint8_t* p = (const uint8_t*)data;
+    for(size_t i = 0; i < len; i++) hash = (hash ^ p[i]) * 16777619UL;
+    return hash;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// MD5 (RFC 1321), FLAC STREAMINFO carries the MD5 of the decoded samples
+typedef struct { uint32_t s[4]; uint64_t len; uint8_t buf[64]; } test_md5_t;
+static void test_md5Block(test_md5_t* c, const uint8_t* p) {
+    static const uint32_t K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+    static const uint8_t R[64] = {7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+                                  5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+                                  4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+                                  6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
+    uint32_t w[16];
+    for(int i = 0; i < 16; i++) w[i] = test_rd32(p + 4 * i);
+    uint32_t a = c->s[0], b = c->s[1], cc = c->s[2], d = c->s[3];
+    for(int i = 0; i < 64; i++) {
+        uint32_t f, g;
+        if(i < 16)      { f = (b & cc) | (~b & d); g = i; }
+        else if(i < 32) { f = (d & b) | (~d & cc); g = (5 * i + 1) & 15; }
+        else if(i < 48) { f = b ^ cc ^ d;          g = (3 * i + 5) & 15; }
+        else            { f = cc ^ (b | ~d);       g = (7 * i) & 15; }
+        uint32_t t = d; d = cc; cc = b;
+        uint32_t x = a + f + K[i] + w[g];
+        b = b + ((x << R[i]) | (x >> (32 - R[i])));
+        a = t;
+    }
+    c->s[0] += a; c->s[1] += b; c->s[2] += cc; c->s[3] += d;
+}
+static void test_md5Init(test_md5_t* c) {
+    c->s[0] = 0x67452301; c->s[1] = 0xefcdab89; c->s[2] = 0x98badcfe; c->s[3] = 0x10325476; c->len = 0;
+}
+static void test_md5Update(test_md5_t* c, const void* data, size_t n) {
+    const uint8_t* p = (const uint8_t*)data;
+    while(n--) {
+        c->buf[c->len++ & 63] = *p++;
+        if((c->len & 63) == 0) test_md5Block(c, c->buf);
+    }
+}
+static void test_md5Final(test_md5_t* c, uint8_t out[16]) {
+    uint64_t bits = c->len * 8;
+    uint8_t  pad = 0x80, zero = 0, len[8];
+    test_md5Update(c, &pad, 1);
+    while((c->len & 63) != 56) test_md5Update(c, &zero, 1);
+    for(int i = 0; i < 8; i++) len[i] = bits >> (8 * i);
+    test_md5Update(c, len, 8);
+    for(int i = 0; i < 4; i++) for(int j = 0; j < 4; j++) out[4 * i + j] = c->s[i] >> (8 * j);
+}
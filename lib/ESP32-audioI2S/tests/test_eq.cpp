@@ -0,0 +1,108 @@
+/*
+ * test_eq.cpp
+ * BiquadEQ: measured sine responses, flat bypass, band ramp-out, coefficient ramps and saturation
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "biquad_eq/biquad_eq.h"
+
+#define EQ_RATE 48000
+
+static std::vector<int16_t> sine(float freq, float amp, uint32_t frames, uint8_t channels) {
+    std::vector<int16_t> s(frames * channels);
+    for(uint32_t i = 0; i < frames; i++)
+        for(uint8_t c = 0; c < channels; c++) s[i * channels + c] = (int16_t)lrintf(amp * sinf(2 * PI * freq * i / EQ_RATE));
+    return s;
+}
+// gain of the settled second half in dB, channel 'ch'
+static double gainDB(BiquadEQ& eq, float freq, uint8_t channels, uint8_t ch = 0) {
+    const uint32_t n = EQ_RATE;
+    std::vector<int16_t> s = sine(freq, 8000, n, channels);
+    eq.clear();
+    for(uint32_t i = 0; i < n; i += 1152) eq.process(&s[i * channels], min(n - i, (uint32_t)1152), channels);
+    return test_dB(test_rms(&s[n / 2 * channels + ch], n / 2 * channels, channels) / (8000 / sqrt(2)));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_eq_response() {
+    BiquadEQ eq;
+    eq.setSampleRate(EQ_RATE);
+    eq.setBand(0, EQ_PEAK, 1000, 1.0, 6);
+    eq.setBand(1, EQ_LOWSHELF, 200, 0.707, -10);
+    eq.setBand(2, EQ_HIGHSHELF, 8000, 0.707, 3);
+    eq.setSampleRate(EQ_RATE); // no ramps
+    const double pre = -6; // headroom: the highest boost
+    TEST_CHECK_NEAR(gainDB(eq, 1000, 2) - pre, 6, 0.2);
+    TEST_CHECK_NEAR(gainDB(eq, 1000, 2, 1) - pre, 6, 0.2);
+    TEST_CHECK_NEAR(gainDB(eq, 40, 2) - pre, -10, 0.3);
+    TEST_CHECK_NEAR(gainDB(eq, 18000, 2) - pre, 3, 0.3);
+    TEST_CHECK_NEAR(gainDB(eq, 1000, 1) - pre, 6, 0.2); // mono path
+    TEST_CHECK_NEAR(gainDB(eq, 40, 1) - pre, -10, 0.3);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_eq_flat() {
+    BiquadEQ eq;
+    eq.setSampleRate(EQ_RATE);
+    TEST_CHECK(eq.isFlat());
+    std::vector<int16_t> src(48000 * 2);
+    for(auto& s : src) s = (int16_t)((rand() % 60000) - 30000);
+    std::vector<int16_t> buf = src;
+    eq.process(buf.data(), 48000, 2);
+    TEST_CHECK(buf == src);
+    // a band set back to 0 dB is ramped out and skipped afterwards
+    eq.setBand(4, EQ_PEAK, 1000, 1, 5);
+    TEST_CHECK(!eq.isFlat());
+    eq.process(buf.data(), 1024, 2);
+    eq.setBand(4, EQ_PEAK, 1000, 1, 0);
+    eq.process(buf.data(), 1024, 2);
+    TEST_CHECK(eq.isFlat());
+    buf = src;
+    eq.process(buf.data(), 48000, 2);
+    TEST_CHECK(buf == src);
+    TEST_CHECK(!eq.setBand(EQ_MAX_BANDS, EQ_PEAK, 1000, 1, 3));
+    TEST_CHECK_EQ(eq.getBandGain(4), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_eq_ramp() {
+    // a boost while playing lowers the preamp by 12 dB (x0.25), it moves in EQ_RAMP_CHUNKS steps:
+    // a 10000 sine steps by at most ~10000 * 0.75 / 8 + 131 per sample instead of ~7500 at once
+    BiquadEQ eq;
+    eq.setSampleRate(EQ_RATE);
+    const uint32_t n = 9600;
+    std::vector<int16_t> s = sine(100, 10000, n, 2);
+    int maxStep = 0;
+    for(uint32_t i = 0; i < n; i += 480) {
+        if(i == 4800) eq.setBand(0, EQ_PEAK, 10000, 1, 12);
+        eq.process(&s[i * 2], 480, 2);
+    }
+    for(uint32_t i = 1; i < n; i++) maxStep = max(maxStep, abs(s[i * 2] - s[(i - 1) * 2]));
+    // the unfiltered sine changes by at most 2*pi*100/48000*10000 = 131 per sample
+    TEST_CHECK(maxStep < 1100);
+    TEST_CHECK_NEAR(test_dB(test_rms(&s[(n - 2400) * 2], 2400 * 2, 2) / (10000 / sqrt(2))), -12, 0.3);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_eq_saturation() {
+    // the preamp leaves headroom, but a full-scale square wave through a narrow boost can still overshoot:
+    // the output saturates instead of wrapping around
+    BiquadEQ eq;
+    eq.setSampleRate(EQ_RATE);
+    eq.setBand(0, EQ_PEAK, 60, 0.3, 12);
+    eq.setBand(1, EQ_LOWSHELF, 100, 2, -12);
+    eq.setSampleRate(EQ_RATE);
+    const uint32_t n = 48000;
+    std::vector<int16_t> s(n * 2);
+    for(uint32_t i = 0; i < n; i++) s[2 * i] = s[2 * i + 1] = ((i / 400) & 1) ? 32767 : -32768;
+    eq.process(s.data(), n, 2);
+    int wraps = 0;
+    for(uint32_t i = 1; i < n; i++) if(abs(s[2 * i] - s[2 * (i - 1)]) > 60000) wraps++;
+    TEST_CHECK_EQ(wraps, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_eq_response);
+    RUN_TEST(test_eq_flat);
+    RUN_TEST(test_eq_ramp);
+    RUN_TEST(test_eq_saturation);
+    return s_testFailures;
+}
@@ -0,0 +1,128 @@
+/*
+ * test_flac.cpp
+ * FLAC decoder: bit exact output (STREAMINFO MD5) and the consumed-byte accounting at frame ends
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "flac_decoder/flac_decoder.h"
+
+#define FLAC_FILE  "Santiano-Wellerman.flac"
+#define FLAC_INBUF 16384 // bytes offered per call, like the audio task with a full input buffer
+
+typedef struct {
+    uint32_t rate;
+    uint8_t  channels;
+    uint8_t  bits;
+    uint64_t totalSamples;
+    uint8_t  md5[16];
+    size_t   audioStart;
+} flac_info_t;
+
+static bool parseStreamInfo(const std::vector<uint8_t>& d, flac_info_t* info) {
+    if(d.size() < 42 || memcmp(d.data(), "fLaC", 4)) return false;
+    size_t pos = 4;
+    while(pos + 4 <= d.size()) {
+        uint8_t  type = d[pos] & 0x7F;
+        bool     last = d[pos] & 0x80;
+        uint32_t len = (d[pos + 1] << 16) | (d[pos + 2] << 8) | d[pos + 3];
+        if(type == 0) {
+            const uint8_t* si = &d[pos + 4];
+            uint64_t v = 0;
+            for(int i = 10; i < 18; i++) v = (v << 8) | si[i];
+            info->rate = v >> 44;
+            info->channels = ((v >> 41) & 7) + 1;
+            info->bits = ((v >> 36) & 31) + 1;
+            info->totalSamples = v & 0xFFFFFFFFFULL;
+            memcpy(info->md5, si + 18, 16);
+        }
+        pos += 4 + len;
+        if(last) break;
+    }
+    info->audioStart = pos;
+    return pos <= d.size();
+}
+
+static bool isFrameSync(const uint8_t* p) { return p[0] == 0xFF && (p[1] & 0xFE) == 0xF8; }
+
+// decodes the whole file, resetBetweenFrames: the decoder is reset at every frame end as a resync would do
+static void decodeFile(const std::vector<uint8_t>& d, const flac_info_t& info, bool resetBetweenFrames,
+                       uint8_t md5[16], uint64_t* frames, uint32_t* frameEnds, uint32_t* badFrameEnds) {
+    static int16_t out[MAX_BLOCKSIZE * 2];
+    test_md5_t     ctx;
+    test_md5Init(&ctx);
+    FLACDecoder_setDefaults();
+    FLACSetRawBlockParams(info.channels, info.rate, info.bits, info.totalSamples, d.size() - info.audioStart);
+    size_t pos = info.audioStart;
+    int sync = FLACFindSyncWord((uint8_t*)&d[pos], d.size() - pos);
+    TEST_CHECK_EQ(sync, 0);
+    *frames = 0; *frameEnds = 0; *badFrameEnds = 0;
+    while(pos < d.size()) {
+        int    len = min(d.size() - pos, (size_t)FLAC_INBUF);
+        int    bytesLeft = len;
+        int8_t ret = FLACDecode((uint8_t*)&d[pos], &bytesLeft, out);
+        TEST_CHECK(ret >= 0);
+        if(ret < 0) break;
+        pos += len - bytesLeft;
+        if(ret == GIVE_NEXT_LOOP || ret == ERR_FLAC_NONE) {
+            uint16_t n = FLACGetOutputSamps();
+            for(uint16_t i = 0; i < n / info.channels; i++) {
+                for(uint8_t ch = 0; ch < info.channels; ch++) {
+                    int16_t s = out[2 * i + ch];
+                    test_md5Update(&ctx, &s, 2); // little endian host, as the MD5 is defined
+                }
+            }
+            *frames += n / info.channels;
+        }
+        if(ret == ERR_FLAC_NONE) { // footer read, the next byte must be the next frame
+            (*frameEnds)++;
+            if(pos < d.size() && !isFrameSync(&d[pos])) (*badFrameEnds)++;
+            if(resetBetweenFrames && pos < d.size()) {
+                sync = FLACFindSyncWord((uint8_t*)&d[pos], d.size() - pos); // calls FLACDecoderReset()
+                if(sync > 0) pos += sync;
+            }
+        }
+    }
+    test_md5Final(&ctx, md5);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static void test_flac_md5() {
+    std::vector<uint8_t> d = test_readFile(FLAC_FILE);
+    flac_info_t info = {};
+    TEST_CHECK(parseStreamInfo(d, &info));
+    TEST_CHECK_EQ(info.bits, 16);
+    TEST_CHECK(FLACDecoder_AllocateBuffers());
+    uint8_t md5[16];
+    uint64_t frames;
+    uint32_t ends, bad;
+    decodeFile(d, info, false, md5, &frames, &ends, &bad);
+    TEST_CHECK_EQ(frames, info.totalSamples);
+    TEST_CHECK(!memcmp(md5, info.md5, 16));
+    FLACDecoder_FreeBuffers();
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_flac_frame_end() {
+    // the bytes reported as consumed end exactly at the next frame, nothing of it is left in the bit cache,
+    // so a reset (stop, seek, resync) between frames loses no data
+    std::vector<uint8_t> d = test_readFile(FLAC_FILE);
+    flac_info_t info = {};
+    TEST_CHECK(parseStreamInfo(d, &info));
+    TEST_CHECK(FLACDecoder_AllocateBuffers());
+    uint8_t md5[16];
+    uint64_t frames;
+    uint32_t ends, bad;
+    decodeFile(d, info, true, md5, &frames, &ends, &bad);
+    TEST_CHECK(ends > 100);
+    TEST_CHECK_EQ(bad, 0);
+    TEST_CHECK_EQ(frames, info.totalSamples);
+    TEST_CHECK(!memcmp(md5, info.md5, 16));
+    FLACDecoder_FreeBuffers();
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_flac_md5);
+    RUN_TEST(test_flac_frame_end);
+    return s_testFailures;
+}
@@ -0,0 +1,144 @@
+/*
+ * test_gapless.cpp
+ * Audio with setNextFile(): an mp3 after an mp3 and an m4a after an m4a follow without a gap, the output is the
+ * trimmed length of both files (LAME tag, iTunSMPB) and the second one sounds like the first; other pairs are
+ * connected with connecttoFS()
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Audio.h"
+
+#define MP3_SAMPLES  813202  // LAME tag of Olsen-Banden.mp3
+#define M4A_FRAMES   1172    // stsz entries of Miss-Marple.m4a
+#define M4A_DELAY    2112    // iTunSMPB written by the test
+#define M4A_PADDING  700
+#define M4A_SAMPLES  (M4A_FRAMES * 1024 - M4A_DELAY - M4A_PADDING)
+
+static fs::FS*     s_card;
+static std::string s_nextFile;
+static int         s_gapless = 0;
+
+void audio_info(const char* info) {
+    if(strstr(info, "gapless")) s_gapless++;
+}
+void audio_next_file(const char* path) {
+    s_nextFile = path;
+}
+
+static void wr32be(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24, p[1] = v >> 16, p[2] = v >> 8, p[3] = v;
+}
+static void writeFile(const std::string& path, const std::vector<uint8_t>& d) {
+    FILE* f = fopen(path.c_str(), "wb");
+    fwrite(d.data(), 1, d.size(), f);
+    fclose(f);
+}
+// position of the child atom 'name' in [pos, end), 0 if there is none
+static size_t findAtom(const std::vector<uint8_t>& d, size_t pos, size_t end, const char* name) {
+    while(pos + 8 <= end) {
+        uint32_t len = test_rd32be(&d[pos]);
+        if(!memcmp(&d[pos + 4], name, 4)) return pos;
+        if(len < 8) break;
+        pos += len;
+    }
+    return 0;
+}
+// the m4a with a '----' iTunSMPB item at the end of ilst; moov is behind mdat, stco stays valid
+static std::vector<uint8_t> withSMPB(std::vector<uint8_t> d, uint32_t delay, uint32_t padding, uint32_t samples) {
+    size_t moov = findAtom(d, 0, d.size(), "moov");
+    size_t udta = findAtom(d, moov + 8, moov + test_rd32be(&d[moov]), "udta");
+    size_t meta = findAtom(d, udta + 8, udta + test_rd32be(&d[udta]), "meta");
+    size_t ilst = findAtom(d, meta + 12, meta + test_rd32be(&d[meta]), "ilst");
+    TEST_CHECK(moov && udta && meta && ilst);
+
+    char smpb[128];
+    snprintf(smpb, sizeof(smpb), " 00000000 %08X %08X %016llX 00000000 00000000", delay, padding,
+             (unsigned long long)samples);
+    std::vector<uint8_t> item(8);
+    auto add = [&](const char* name, const void* payload, size_t len, bool typed) {
+        size_t at = item.size();
+        item.resize(at + 8 + (typed ? 8 : 4) + len, 0);
+        wr32be(&item[at], 8 + (typed ? 8 : 4) + len);
+        memcpy(&item[at + 4], name, 4);
+        if(typed) item[at + 11] = 1; // utf-8
+        memcpy(&item[at + (typed ? 16 : 12)], payload, len);
+    };
+    add("mean", "com.apple.iTunes", 16, false);
+    add("name", "iTunSMPB", 8, false);
+    add("data", smpb, strlen(smpb), true);
+    wr32be(&item[0], item.size());
+    memcpy(&item[4], "----", 4);
+
+    size_t end = ilst + test_rd32be(&d[ilst]);
+    d.insert(d.begin() + end, item.begin(), item.end());
+    for(size_t a : {moov, udta, meta, ilst}) wr32be(&d[a], test_rd32be(&d[a]) + item.size());
+    return d;
+}
+// plays 'first' and 'next' behind it, returns the frames at the DMA
+static std::vector<int16_t> play(const char* first, const char* next) {
+    Audio audio;
+    audio.setVolume(21);
+    i2s_chan_handle_t tx = i2s_host_tx;
+    tx->played.clear();
+    s_nextFile.clear();
+    s_gapless = 0;
+    TEST_CHECK(audio.connecttoFS(*s_card, first));
+    TEST_CHECK(audio.setNextFile(*s_card, next));
+    for(int i = 0; i < 1000000 && audio.isRunning(); i++) {
+        audio.loop();
+        i2s_host_play(tx, 512);
+    }
+    TEST_CHECK(!audio.isRunning());
+    i2s_host_play(tx, i2s_host_capacity(tx) / 4);
+    const int16_t* s = (const int16_t*)tx->played.data();
+    return std::vector<int16_t>(s, s + tx->played.size() / 2);
+}
+// the second half sounds like the first one, the decoder state of the seam lies in the trimmed delay; level of the
+// difference below the signal (the AAC noise substitution draws other random numbers the second time)
+static double halvesDiffer(const std::vector<int16_t>& out) {
+    size_t               half = out.size() / 2;
+    std::vector<int16_t> diff(half);
+    for(size_t i = 0; i < half; i++) diff[i] = out[i] - out[half + i];
+    return test_dB(test_rms(diff.data(), half) / test_rms(out.data(), half));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_gapless_mp3() {
+    std::vector<int16_t> out = play("/a.mp3", "/b.mp3");
+    TEST_CHECK(s_nextFile == "/b.mp3");
+    TEST_CHECK_EQ(s_gapless, 1);
+    TEST_CHECK_EQ(out.size() / 2, 2 * (size_t)MP3_SAMPLES);
+    TEST_CHECK(halvesDiffer(out) < -80);
+}
+static void test_gapless_m4a() {
+    std::vector<int16_t> out = play("/a.m4a", "/b.m4a");
+    TEST_CHECK(s_nextFile == "/b.m4a");
+    TEST_CHECK_EQ(s_gapless, 1);
+    TEST_CHECK_EQ(out.size() / 2, 2 * (size_t)M4A_SAMPLES);
+    printf("m4a: second file %.1f dB off the first one\n", halvesDiffer(out));
+    TEST_CHECK(halvesDiffer(out) < -50);
+}
+static void test_gapless_mixed() {
+    // an m4a after an mp3 needs another decoder: connecttoFS() at the end of the first file
+    std::vector<int16_t> out = play("/a.mp3", "/b.m4a");
+    TEST_CHECK(s_nextFile == "/b.m4a");
+    TEST_CHECK_EQ(s_gapless, 0);
+    TEST_CHECK_EQ(out.size() / 2, (size_t)MP3_SAMPLES + M4A_SAMPLES);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    char dir[] = "/tmp/test_gaplessXXXXXX";
+    if(!mkdtemp(dir)) return 1;
+    std::vector<uint8_t> mp3 = test_readFile("Olsen-Banden.mp3");
+    std::vector<uint8_t> m4a = withSMPB(test_readFile("Miss-Marple.m4a"), M4A_DELAY, M4A_PADDING, M4A_SAMPLES);
+    for(const char* name : {"/a.mp3", "/b.mp3"}) writeFile(dir + std::string(name), mp3);
+    for(const char* name : {"/a.m4a", "/b.m4a"}) writeFile(dir + std::string(name), m4a);
+    fs::FS card(dir);
+    s_card = &card;
+
+    RUN_TEST(test_gapless_mp3);
+    RUN_TEST(test_gapless_m4a);
+    RUN_TEST(test_gapless_mixed);
+    return s_testFailures;
+}
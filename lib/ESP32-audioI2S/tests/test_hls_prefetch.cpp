@@ -0,0 +1,174 @@
+/*
+ * test_hls_prefetch.cpp
+ * AudioHLSPrefetch against a local server: chunked playlist, segments in order over one keep-alive connection and
+ * readable while they load, redirect, chunked segment, empty segment (Content-Length: 0), failed segment, clear()
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "test_server.h"
+#include "hls_prefetch/hls_prefetch.h"
+
+#define HT_SEG 200000
+
+static std::string      s_playlist;
+static Test_Server*     s_srv;
+static AudioHLSPrefetch s_hp; // one for all tests as in Audio: the task of a deleted one goes on running on the host
+
+static uint8_t segByte(uint32_t n, uint32_t i) { return (uint8_t)(n * 7 + i); }
+static std::string segment(uint32_t n) {
+    std::string d(HT_SEG, 0);
+    for(uint32_t i = 0; i < HT_SEG; i++) d[i] = segByte(n, i);
+    return d;
+}
+// /pl.m3u8 chunked, /seg/<n>.ts in pieces of 20000 bytes every 10 ms, /chunked/<n>.ts, /redir/<n>, /empty, /missing
+static bool handler(int fd, const Test_Request& r) {
+    const std::string& p = r.path;
+    uint32_t           n = atoi(p.c_str() + p.rfind('/') + 1);
+    if(p == "/pl.m3u8") {
+        test_sendHeader(fd, 200, -1);
+        for(size_t i = 0; i < s_playlist.size(); i += 20) test_sendChunk(fd, s_playlist.substr(i, 20));
+        return test_sendChunk(fd, "");
+    }
+    if(!p.compare(0, 5, "/seg/")) {
+        std::string d = segment(n);
+        test_sendHeader(fd, 200, d.size());
+        for(size_t i = 0; i < d.size(); i += 20000) {
+            if(!test_send(fd, d.data() + i, 20000)) return false;
+            test_sleep(10);
+        }
+        return true;
+    }
+    if(!p.compare(0, 9, "/chunked/")) {
+        std::string d = segment(n);
+        test_sendHeader(fd, 200, -1);
+        for(size_t i = 0; i < d.size(); i += 50000) {
+            test_sendChunk(fd, d.substr(i, 50000));
+            test_sleep(20);
+        }
+        return test_sendChunk(fd, "");
+    }
+    if(!p.compare(0, 7, "/redir/")) return test_sendHeader(fd, 302, 0, "Location: /seg/" + std::to_string(n) + ".ts\r\n");
+    if(p == "/empty") return test_sendHeader(fd, 200, 0);
+    return test_sendHeader(fd, 404, 0);
+}
+static bool waitFor(std::function<bool()> cond, uint32_t ms = 5000) {
+    for(uint32_t t = 0; t < ms; t += 2) {
+        if(cond()) return true;
+        vTaskDelay(2);
+    }
+    return false;
+}
+// reads the head segment to its end and pops it; bytes that differ from segment n
+static uint32_t readHead(AudioHLSPrefetch& hp, uint32_t n, bool* early) {
+    uint32_t len = 0, pos = 0, bad = 0;
+    TEST_CHECK(waitFor([&] { return hp.headLength(&len); }));
+    TEST_CHECK_EQ(len, HT_SEG);
+    if(early) *early = hp.headState() == HP_LOADING;
+    uint8_t buf[1500];
+    uint32_t t0 = millis();
+    while(pos < len && millis() - t0 < 5000) {
+        uint32_t k = hp.read(buf, sizeof(buf));
+        for(uint32_t i = 0; i < k; i++) bad += buf[i] != segByte(n, pos + i);
+        pos += k;
+        if(!k) vTaskDelay(1);
+    }
+    TEST_CHECK_EQ(pos, len);
+    hp.pop();
+    return bad;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_hp_segments() {
+    Test_Server&      srv = *s_srv;
+    AudioHLSPrefetch& hp = s_hp;
+    TEST_CHECK(hp.begin());
+    s_playlist = "#EXTM3U\n#EXT-X-MEDIA-SEQUENCE:10\n";
+    for(int i = 10; i < 13; i++) s_playlist += "#EXTINF:10,\n" + srv.url("/seg/" + std::to_string(i) + ".ts") + "\n";
+    TEST_CHECK(hp.requestPlaylist(srv.url("/pl.m3u8").c_str()));
+    TEST_CHECK(!hp.requestPlaylist(srv.url("/pl.m3u8").c_str()));    // one at a time
+    TEST_CHECK(waitFor([&] { return hp.playlistState() == HP_DONE; }));
+    uint32_t plLen = 0;
+    char*    pl = hp.takePlaylist(&plLen);
+    TEST_CHECK(pl && plLen == s_playlist.size() && s_playlist == pl); // the chunks are joined
+    free(pl);
+    TEST_CHECK_EQ(hp.playlistState(), HP_FREE);
+
+    // three slots; the next segments load while the head is read, over one connection
+    uint32_t connects = WiFiClient::s_connects;
+    TEST_CHECK(hp.push(srv.url("/seg/1.ts").c_str(), 1));
+    TEST_CHECK(hp.push(srv.url("/redir/2").c_str(), 2));
+    TEST_CHECK(hp.push(srv.url("/seg/3.ts").c_str(), 3));
+    TEST_CHECK(!hp.push(srv.url("/seg/4.ts").c_str(), 4));
+    TEST_CHECK_EQ(hp.queued(), 3);
+    uint32_t bad = 0;
+    bool     early = false, anyEarly = false;
+    for(uint32_t n = 1; n <= 5; n++) {
+        TEST_CHECK_EQ(hp.headSeq(), n);
+        bad += readHead(hp, n, &early);
+        anyEarly |= early;
+        if(n <= 2) TEST_CHECK(hp.push(srv.url("/seg/" + std::to_string(n + 3) + ".ts").c_str(), n + 3));
+    }
+    TEST_CHECK_EQ(bad, 0);
+    TEST_CHECK(anyEarly);                                             // read before the body was complete
+    TEST_CHECK_EQ(hp.headState(), HP_FREE);
+    TEST_CHECK_EQ(hp.queued(), 0);
+    TEST_CHECK(WiFiClient::s_connects - connects <= 3);               // keep-alive, the redirect costs one
+    TEST_CHECK(hp.getLoadTime() > 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_hp_lengths() {
+    Test_Server&      srv = *s_srv;
+    AudioHLSPrefetch& hp = s_hp;
+    hp.clear();
+    uint32_t len = 1;
+    TEST_CHECK(!hp.headLength(&len));                                 // no segment
+    TEST_CHECK_EQ(len, 0);
+
+    // chunked: the length is known when the body is complete
+    TEST_CHECK(hp.push(srv.url("/chunked/8.ts").c_str(), 8));
+    TEST_CHECK(waitFor([&] { return hp.headState() == HP_LOADING; }));
+    TEST_CHECK(!hp.headLength(&len));
+    TEST_CHECK(waitFor([&] { return hp.headState() == HP_DONE; }));
+    TEST_CHECK(hp.headLength(&len));
+    TEST_CHECK_EQ(len, HT_SEG);
+    TEST_CHECK_EQ(readHead(hp, 8, NULL), 0);
+
+    // Content-Length: 0 is a known length, the segment is done and popped, it does not block the queue
+    TEST_CHECK(hp.push(srv.url("/empty").c_str(), 9));
+    TEST_CHECK(hp.push(srv.url("/seg/10.ts").c_str(), 10));
+    TEST_CHECK(waitFor([&] { return hp.headState() == HP_DONE; }));
+    len = 1;
+    TEST_CHECK(hp.headLength(&len));
+    TEST_CHECK_EQ(len, 0);
+    TEST_CHECK_EQ(hp.available(), 0);
+    hp.pop();
+    TEST_CHECK_EQ(hp.headSeq(), 10);
+    TEST_CHECK_EQ(readHead(hp, 10, NULL), 0);
+
+    // 404: failed, the next one follows
+    TEST_CHECK(hp.push(srv.url("/missing").c_str(), 11));
+    TEST_CHECK(hp.push(srv.url("/seg/12.ts").c_str(), 12));
+    TEST_CHECK(waitFor([&] { return hp.headState() == HP_FAILED; }));
+    hp.pop();
+    TEST_CHECK_EQ(readHead(hp, 12, NULL), 0);
+
+    // clear() while a segment loads: it is dropped, a new one loads
+    TEST_CHECK(hp.push(srv.url("/seg/13.ts").c_str(), 13));
+    TEST_CHECK(waitFor([&] { return hp.headState() == HP_LOADING; }));
+    hp.clear();
+    TEST_CHECK_EQ(hp.queued(), 0);
+    TEST_CHECK_EQ(hp.headState(), HP_FREE);
+    TEST_CHECK(hp.push(srv.url("/seg/14.ts").c_str(), 14));
+    TEST_CHECK_EQ(hp.headSeq(), 14);
+    TEST_CHECK_EQ(readHead(hp, 14, NULL), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    Test_Server srv(handler);
+    s_srv = &srv;
+    RUN_TEST(test_hp_segments);
+    RUN_TEST(test_hp_lengths);
+    fflush(stdout);
+    _exit(s_testFailures); // the task of s_hp is still running
+}
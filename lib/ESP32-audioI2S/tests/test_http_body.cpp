@@ -0,0 +1,205 @@
+/*
+ * test_http_body.cpp
+ * AudioHTTPBody: ICY metadata and chunked transfer coding taken out in place, fed in pieces of any size down to one
+ * byte; a stand-in radio server on 127.0.0.1 with configurable icy-metaint and chunk size, CPU time per MB
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "test_server.h"
+#include "WiFi.h"
+#include "http_body/http_body.h"
+#include <random>
+#include <time.h>
+
+typedef struct {
+    uint32_t metaint;   // 0: no ICY metadata
+    uint32_t chunk;     // 0: not chunked
+} hb_cfg_t;
+
+static const hb_cfg_t s_cfgs[] = {{8000, 0}, {16000, 4096}, {8192, 1000}, {0, 2048}, {16, 7}};
+
+static uint8_t audioByte(uint32_t i) { return (uint8_t)(i * 7 + (i >> 8)); }
+
+// the body as the server sends it; every third metadata block has a title, the others are empty (length byte 0)
+static std::string icyBody(uint32_t metaint, uint32_t total, std::vector<std::string>* titles) {
+    std::string out;
+    uint32_t    pos = 0, k = 0;
+    while(pos < total) {
+        uint32_t n = min(metaint ? metaint : 65536, total - pos);
+        for(uint32_t i = 0; i < n; i++) out += (char)audioByte(pos + i);
+        pos += n;
+        if(!metaint || pos >= total) continue;
+        std::string t = (k % 3) ? "" : "StreamTitle='Artist " + std::to_string(k) + " - Song';StreamUrl='';";
+        k++;
+        uint32_t l = (t.size() + 15) / 16;
+        out += (char)l;
+        out += t + std::string(l * 16 - t.size(), '\0');
+        if(l && titles) titles->push_back(t);
+    }
+    return out;
+}
+// chunk size lines in upper and lower case hex, with an extension now and then, a trailer behind the last chunk
+static std::string chunked(const std::string& body, uint32_t chunk) {
+    std::string out;
+    char        h[32];
+    for(size_t i = 0, k = 0; i < body.size(); i += chunk, k++) {
+        size_t n = min((size_t)chunk, body.size() - i);
+        snprintf(h, sizeof(h), (k & 1) ? "%zX\r\n" : (k % 5 == 0) ? "%zx;name=value\r\n" : "%zx\r\n", n);
+        out += h + body.substr(i, n) + "\r\n";
+    }
+    return out + "0\r\nX-Trailer: 1\r\n\r\n";
+}
+
+typedef struct {
+    std::vector<std::string> titles;
+} hb_meta_t;
+
+static void metaCb(void* arg, char* meta, uint16_t len) {
+    TEST_CHECK(strlen(meta) <= len);
+    ((hb_meta_t*)arg)->titles.push_back(meta);
+}
+static uint32_t badBytes(const uint8_t* p, uint32_t n) {
+    uint32_t bad = 0;
+    for(uint32_t i = 0; i < n; i++) bad += p[i] != audioByte(i);
+    return bad;
+}
+static double cpuTime() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_hb_pieces() {
+    // every configuration in random pieces and byte by byte: a size line, a metadata block and the trailer are cut
+    // anywhere, the audio and the titles come out as sent, the bytes behind the last chunk are ignored
+    const uint32_t total = 200000;
+    std::mt19937   rng(1);
+    char           meta[4096];
+    for(const hb_cfg_t& c : s_cfgs) {
+        std::vector<std::string> titles;
+        std::string              wire = icyBody(c.metaint, total, &titles);
+        if(c.chunk) wire = chunked(wire, c.chunk) + "garbage";
+        for(uint32_t maxPiece : {1u, 5u, 1500u, 70000u}) {
+            std::vector<uint8_t> buf(wire.begin(), wire.end());
+            AudioHTTPBody        hb;
+            hb_meta_t            m;
+            hb.begin(c.chunk > 0, c.metaint);
+            hb.setMetadataBuffer(meta, sizeof(meta));
+            hb.setMetadataCallback(metaCb, &m);
+            uint32_t in = 0, out = 0;
+            while(in < buf.size()) {
+                uint32_t n = min((uint32_t)(buf.size() - in), 1 + (uint32_t)(rng() % maxPiece));
+                uint32_t k = hb.decode(buf.data() + in, n);
+                memmove(buf.data() + out, buf.data() + in, k); // behind the audio that came before, as in InBuff
+                out += k;
+                in += n;
+            }
+            TEST_CHECK_EQ(out, total);
+            TEST_CHECK_EQ(badBytes(buf.data(), out), 0);
+            TEST_CHECK(m.titles == titles);
+            TEST_CHECK_EQ(hb.isEnd(), c.chunk > 0);
+            const hb_stats_t* st = hb.getStats();
+            TEST_CHECK_EQ(st->audioBytes, total);
+            TEST_CHECK_EQ(st->metaBlocks, titles.size());
+            TEST_CHECK_EQ(st->metaSkipped, 0);
+            if(c.chunk) TEST_CHECK_EQ(st->chunks, (icyBody(c.metaint, total, NULL).size() + c.chunk - 1) / c.chunk + 1);
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_hb_skip() {
+    // a block longer than the metadata buffer is skipped, the audio behind it and the next title are not affected
+    std::string body;
+    for(uint32_t i = 0; i < 3000; i++) body += (char)audioByte(i);
+    body += (char)20 + std::string(320, 'x');
+    for(uint32_t i = 3000; i < 6000; i++) body += (char)audioByte(i);
+    std::string t = "StreamTitle='Short';";
+    body += (char)2 + t + std::string(32 - t.size(), '\0');
+    for(uint32_t i = 6000; i < 7000; i++) body += (char)audioByte(i);
+
+    char          meta[256];
+    hb_meta_t     m;
+    AudioHTTPBody hb;
+    hb.begin(false, 3000);
+    hb.setMetadataBuffer(meta, sizeof(meta));
+    hb.setMetadataCallback(metaCb, &m);
+    std::vector<uint8_t> buf(body.begin(), body.end());
+    uint32_t             out = hb.decode(buf.data(), buf.size());
+    TEST_CHECK_EQ(out, 7000);
+    TEST_CHECK_EQ(badBytes(buf.data(), out), 0);
+    TEST_CHECK(m.titles.size() == 1 && m.titles[0] == t);
+    TEST_CHECK_EQ(hb.getStats()->metaSkipped, 1);
+    TEST_CHECK_EQ(hb.getStats()->metaBlocks, 1);
+    TEST_CHECK_EQ(hb.getStats()->bodyBytes, body.size());
+}
+//----------------------------------------------------------------------------------------------------------------------
+static hb_cfg_t s_srvCfg;
+static uint32_t s_srvTotal;
+
+static bool radio(int fd, const Test_Request& r) {
+    std::string wire = icyBody(s_srvCfg.metaint, s_srvTotal, NULL);
+    if(s_srvCfg.chunk) wire = chunked(wire, s_srvCfg.chunk);
+    std::string h = "ICY 200 OK\r\n";
+    if(s_srvCfg.metaint) h += "icy-metaint:" + std::to_string(s_srvCfg.metaint) + "\r\n";
+    if(s_srvCfg.chunk) h += "Transfer-Encoding: chunked\r\n";
+    test_send(fd, h + "\r\n");
+    test_send(fd, wire);
+    return false;
+}
+static void test_hb_radio() {
+    // processWebStream(): one read per loop as large as the space in InBuff, decode() behind it; the CPU time of the
+    // reads and decode() per MB of audio
+    Test_Server srv(radio);
+    s_srvTotal = 8 << 20;
+    std::vector<uint8_t> out(s_srvTotal + 16000);
+    char                 meta[4096];
+    for(const hb_cfg_t& c : s_cfgs) {
+        if(c.chunk == 7) continue; // only for the pieces
+        s_srvCfg = c;
+        WiFiClient cl;
+        TEST_CHECK(cl.connect("127.0.0.1", srv.port()));
+        cl.print("GET / HTTP/1.1\r\n\r\n");
+        std::string line;
+        while(true) { // the header
+            int b = cl.read();
+            if(b < 0) { if(!cl.connected()) break; continue; }
+            if(b != '\n') { line += (char)b; continue; }
+            if(line.size() <= 1) break;
+            line.clear();
+        }
+        AudioHTTPBody hb;
+        hb_meta_t     m;
+        hb.begin(c.chunk > 0, c.metaint);
+        hb.setMetadataBuffer(meta, sizeof(meta));
+        hb.setMetadataCallback(metaCb, &m);
+        uint32_t o = 0, loops = 0;
+        double   cpu = 0;
+        while(o < s_srvTotal) {
+            uint32_t a = cl.available();
+            if(!a) {
+                if(!cl.connected()) break;
+                continue;
+            }
+            double t0 = cpuTime(); // not the polling in between
+            int    r = cl.read(out.data() + o, min(a, (uint32_t)16000));
+            loops++;
+            if(r > 0) o += hb.decode(out.data() + o, r);
+            cpu += cpuTime() - t0;
+        }
+        double ms = cpu * 1000;
+        printf("metaint %5u chunk %4u: %.2f ms/MB, %u reads, %zu titles\n", c.metaint, c.chunk, ms / (o / 1048576.0),
+               loops, m.titles.size());
+        TEST_CHECK_EQ(o, s_srvTotal);
+        TEST_CHECK_EQ(badBytes(out.data(), o), 0);
+        if(c.metaint) TEST_CHECK_EQ(m.titles.size(), ((s_srvTotal - 1) / c.metaint + 2) / 3);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_hb_pieces);
+    RUN_TEST(test_hb_skip);
+    RUN_TEST(test_hb_radio);
+    return s_testFailures;
+}
@@ -0,0 +1,193 @@
+/*
+ * test_mixer.cpp
+ * AudioMixer: passthrough, exact same-rate sum, ducking ramps, clips from memory, stop fade, resampled streams and a
+ * producer thread feeding the lock free queue
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "audio_mixer/audio_mixer.h"
+#include <atomic>
+
+#define MIX_RATE  44100
+#define MIX_BLOCK 1152
+
+static std::vector<int16_t> noise(uint32_t samples, int amp) {
+    std::vector<int16_t> v(samples);
+    for(auto& s : v) s = (int16_t)((rand() % (2 * amp + 1)) - amp);
+    return v;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_passthrough() {
+    AudioMixer m;
+    m.setSampleRate(MIX_RATE);
+    std::vector<int16_t> music = noise(MIX_RATE * 2, 30000), x = music;
+    for(uint32_t i = 0; i + MIX_BLOCK <= MIX_RATE; i += MIX_BLOCK) m.mix(&x[i * 2], MIX_BLOCK, 2);
+    TEST_CHECK(x == music);
+    TEST_CHECK(!m.isActive());
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_sum() {
+    // same rate, no ducking: music + stream, saturated, mono stream on both channels
+    AudioMixer m;
+    m.setSampleRate(MIX_RATE);
+    m.setDucking(0);
+    std::vector<int16_t> music = noise(MIX_BLOCK * 4 * 2, 30000), x = music;
+    std::vector<int16_t> voice = noise(MIX_BLOCK * 3, 20000);
+    int8_t id = m.openStream(MIX_EFFECT, MIX_RATE, 1, 200);
+    TEST_CHECK(id >= 0);
+    TEST_CHECK_EQ(m.writeStream(id, voice.data(), voice.size()), voice.size());
+    m.endStream(id);
+    for(int b = 0; b < 4; b++) m.mix(&x[b * MIX_BLOCK * 2], MIX_BLOCK, 2);
+    uint32_t err = 0;
+    for(uint32_t i = 0; i < MIX_BLOCK * 4; i++) {
+        for(int c = 0; c < 2; c++) {
+            int ref = music[i * 2 + c] + (i < voice.size() ? voice[i] : 0);
+            ref = constrain(ref, -32768, 32767);
+            if(ref != x[i * 2 + c]) err++;
+        }
+    }
+    TEST_CHECK_EQ(err, 0);
+    TEST_CHECK(!m.isActive()); // drained and closed
+    TEST_CHECK_EQ(m.streamSpace(id), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_ducking() {
+    // a voice stream ducks the music by 12 dB within the attack time, the release brings it back
+    AudioMixer m;
+    m.setSampleRate(MIX_RATE);
+    m.setDucking(-12, 30, 300);
+    std::vector<int16_t> block(MIX_BLOCK * 2);
+    auto level = [&]() { // music gain of the last frame of a block of constant 16384
+        for(auto& s : block) s = 16384;
+        m.mix(block.data(), MIX_BLOCK, 2);
+        return block[MIX_BLOCK * 2 - 1] / 16384.0;
+    };
+    TEST_CHECK_NEAR(level(), 1.0, 0.001);
+    int8_t id = m.openStream(MIX_VOICE, 16000, 1, 500); // empty queue: only the ducking is heard
+    TEST_CHECK_NEAR(level(), 1.0 - (1.0 - 0.251) * MIX_BLOCK / (0.030 * MIX_RATE), 0.01); // linear attack
+    level();
+    TEST_CHECK_NEAR(level(), 0.251, 0.002);
+    m.endStream(id);                                      // nothing queued, closes at the next mix()
+    level();
+    TEST_CHECK(m.isActive());                             // still releasing
+    for(int i = 0; i < 20; i++) level();                  // 300 ms
+    TEST_CHECK_NEAR(level(), 1.0, 0.001);
+    TEST_CHECK(!m.isActive());
+    m.holdDucking(true);                                  // wake word: duck without a stream
+    for(int i = 0; i < 3; i++) level();
+    TEST_CHECK_NEAR(level(), 0.251, 0.002);
+    m.holdDucking(false);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_clip() {
+    // playBuffer() reads the caller's memory, the gain is applied, isPlaying() ends with the clip
+    AudioMixer m;
+    m.setSampleRate(MIX_RATE);
+    m.setDucking(0);
+    std::vector<int16_t> clip(1000 * 2, 8000);
+    TEST_CHECK(m.playBuffer(MIX_EFFECT, clip.data(), 1000, MIX_RATE, 2, 0.5f) >= 0);
+    TEST_CHECK(m.isPlaying(clip.data()));
+    std::vector<int16_t> x(MIX_BLOCK * 2, 0);
+    m.mix(x.data(), MIX_BLOCK, 2);
+    TEST_CHECK_NEAR(x[0], 4000, 1);
+    TEST_CHECK_NEAR(x[999 * 2 + 1], 4000, 1);
+    TEST_CHECK_EQ(x[1000 * 2], 0);
+    TEST_CHECK(!m.isPlaying(clip.data()));
+    // all slots in use
+    for(int i = 0; i < MIX_MAX_STREAMS; i++) TEST_CHECK(m.playBuffer(MIX_EFFECT, clip.data(), 1000, MIX_RATE, 2) >= 0);
+    TEST_CHECK_EQ(m.playBuffer(MIX_EFFECT, clip.data(), 1000, MIX_RATE, 2), -1);
+    TEST_CHECK_EQ(m.openStream(MIX_EFFECT, MIX_RATE, 2), -1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_stop() {
+    // stopStream() fades out over MIX_STOP_RAMP_MS instead of cutting
+    AudioMixer m;
+    m.setSampleRate(MIX_RATE);
+    m.setDucking(0);
+    std::vector<int16_t> clip(MIX_RATE * 2, 10000);
+    int8_t id = m.playBuffer(MIX_EFFECT, clip.data(), MIX_RATE, MIX_RATE, 2);
+    std::vector<int16_t> x(MIX_BLOCK * 2, 0);
+    m.mix(x.data(), MIX_BLOCK, 2);
+    m.stopStream(id);
+    std::fill(x.begin(), x.end(), 0);
+    m.mix(x.data(), MIX_BLOCK, 2);
+    uint32_t fade = MIX_STOP_RAMP_MS * MIX_RATE / 1000;
+    TEST_CHECK(x[0] > 9900);
+    TEST_CHECK_NEAR(x[fade / 2 * 2], 5000, 100);
+    TEST_CHECK_EQ(x[(fade + 1) * 2], 0);
+    int maxStep = 0;
+    for(uint32_t i = 1; i < MIX_BLOCK; i++) maxStep = max(maxStep, abs(x[i * 2] - x[(i - 1) * 2]));
+    TEST_CHECK(maxStep <= 10000 / (int)fade + 1);
+    TEST_CHECK(!m.isPlaying(clip.data()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_resample() {
+    // a 22.05 kHz sine mixed into 44.1 kHz and 48 kHz output: twice / 48/22.05 times the frames, same level
+    for(uint32_t out : {44100u, 48000u}) {
+        AudioMixer m;
+        m.setSampleRate(out);
+        m.setDucking(0);
+        const uint32_t n = 22050;
+        std::vector<int16_t> s(n);
+        for(uint32_t i = 0; i < n; i++) s[i] = (int16_t)lrint(10000 * sin(2 * M_PI * 500 * i / 22050.0));
+        m.playBuffer(MIX_EFFECT, s.data(), n, 22050, 1);
+        std::vector<int16_t> x((out + 2 * MIX_BLOCK) * 2, 0);
+        uint32_t frames = 0;
+        for(uint32_t i = 0; i < out + MIX_BLOCK; i += MIX_BLOCK) m.mix(&x[i * 2], MIX_BLOCK, 2);
+        for(uint32_t i = 0; i < out + 2 * MIX_BLOCK; i++) if(x[i * 2]) frames = i + 1;
+        TEST_CHECK_NEAR(frames, (double)n * out / 22050, 3);
+        TEST_CHECK_NEAR(test_rms(&x[out / 4 * 2], out / 2 * 2, 2), 10000 / sqrt(2), 50);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mix_thread() {
+    // one producer thread, the consumer mixes into silence: every frame arrives once and in order (underruns leave
+    // gaps of silence, the values are never 0)
+    AudioMixer m;
+    m.setSampleRate(MIX_RATE);
+    m.setDucking(0);
+    const uint32_t total = MIX_RATE * 4;
+    int8_t id = m.openStream(MIX_EFFECT, MIX_RATE, 2, 50);
+    std::atomic<bool> done(false);
+    std::thread producer([&]() {
+        std::vector<int16_t> chunk(2 * 700);
+        uint32_t sent = 0;
+        while(sent < total) {
+            uint32_t n = min((uint32_t)(rand() % 700) + 1, total - sent);
+            for(uint32_t i = 0; i < n; i++) { chunk[2 * i] = (int16_t)((sent + i) % 30000 + 1); chunk[2 * i + 1] = -chunk[2 * i]; }
+            uint32_t w = 0;
+            while(w < n) { w += m.writeStream(id, &chunk[2 * w], n - w); std::this_thread::yield(); }
+            sent += n;
+        }
+        m.endStream(id);
+        done = true;
+    });
+    std::vector<int16_t> x(MIX_BLOCK * 2);
+    uint32_t got = 0, bad = 0;
+    while(!done || m.isActive()) {
+        std::fill(x.begin(), x.end(), 0);
+        m.mix(x.data(), MIX_BLOCK, 2);
+        for(uint32_t i = 0; i < MIX_BLOCK; i++) {
+            if(!x[2 * i]) continue;
+            if(x[2 * i] != (int16_t)(got % 30000 + 1) || x[2 * i + 1] != -x[2 * i]) bad++;
+            got++;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    producer.join();
+    TEST_CHECK_EQ(got, total);
+    TEST_CHECK_EQ(bad, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_mix_passthrough);
+    RUN_TEST(test_mix_sum);
+    RUN_TEST(test_mix_ducking);
+    RUN_TEST(test_mix_clip);
+    RUN_TEST(test_mix_stop);
+    RUN_TEST(test_mix_resample);
+    RUN_TEST(test_mix_thread);
+    return s_testFailures;
+}
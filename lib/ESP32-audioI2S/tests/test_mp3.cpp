@@ -0,0 +1,106 @@
+/*
+ * test_mp3.cpp
+ * MP3 decoder: Xing/Info frame and LAME tag, gapless trimming of two files decoded back to back by one decoder
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "mp3_decoder/mp3_decoder.h"
+
+#define MP3_FILE    "Olsen-Banden.mp3"
+#define MP3_SAMPLES 813202 // LAME tag: frames * 1152 - encoder delay - padding
+#define MP3_DECODER_DELAY 529
+
+static size_t skipID3(const std::vector<uint8_t>& d) {
+    if(d.size() < 10 || memcmp(d.data(), "ID3", 3)) return 0;
+    return 10 + ((d[6] & 0x7f) << 21 | (d[7] & 0x7f) << 14 | (d[8] & 0x7f) << 7 | (d[9] & 0x7f));
+}
+// as Audio::mp3_readGaplessInfo() and Audio::gaplessTrim()
+typedef struct { uint32_t skip; uint32_t left; } trim_t;
+static size_t readGaplessInfo(const uint8_t* d, size_t len, trim_t* t) {
+    t->skip = 0;
+    t->left = UINT32_MAX;
+    int sync = MP3FindSyncWord((uint8_t*)d, len);
+    if(sync < 0) return 0;
+    MP3XingInfo_t xi;
+    if(MP3GetXingInfo(d + sync, len - sync, &xi) != ERR_MP3_NONE || !xi.frameLen) return 0;
+    uint32_t total = xi.frames * xi.samplesPerFrame;
+    if(xi.frames && (xi.encDelay || xi.encPadding) && total > (uint32_t)(xi.encDelay + xi.encPadding)) {
+        t->skip = xi.encDelay + MP3_DECODER_DELAY;
+        t->left = total - xi.encDelay - xi.encPadding;
+    }
+    return sync + xi.frameLen;
+}
+static void decode(const std::vector<uint8_t>& d, size_t pos, trim_t* t, std::vector<int16_t>& out) {
+    static int16_t buf[1152 * 2];
+    while(pos + 4 < d.size()) {
+        int sync = MP3FindSyncWord((uint8_t*)&d[pos], d.size() - pos);
+        if(sync < 0) break;
+        pos += sync;
+        int left = d.size() - pos, before = left;
+        if(MP3Decode((uint8_t*)&d[pos], &left, buf, 0)) { pos++; continue; }
+        pos += before - left;
+        uint8_t  ch = MP3GetChannels();
+        uint32_t valid = MP3GetOutputSamps() / ch, first = 0;
+        if(t && t->skip) { first = min(t->skip, valid); t->skip -= first; valid -= first; }
+        if(t && t->left != UINT32_MAX) { valid = min(valid, t->left); t->left -= valid; }
+        out.insert(out.end(), buf + first * ch, buf + (first + valid) * ch);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mp3_xing() {
+    std::vector<uint8_t> d = test_readFile(MP3_FILE);
+    size_t pos = skipID3(d);
+    int sync = MP3FindSyncWord(&d[pos], d.size() - pos);
+    TEST_CHECK(sync >= 0);
+    MP3XingInfo_t xi;
+    TEST_CHECK_EQ(MP3GetXingInfo(&d[pos + sync], d.size() - pos - sync, &xi), ERR_MP3_NONE);
+    TEST_CHECK(xi.frameLen > 0);
+    TEST_CHECK_EQ(xi.samplesPerFrame, 1152);
+    TEST_CHECK_EQ(xi.samprate, 44100);
+    TEST_CHECK_EQ(xi.frames * xi.samplesPerFrame - xi.encDelay - xi.encPadding, MP3_SAMPLES);
+    // the next frame carries audio
+    size_t next = pos + sync + xi.frameLen;
+    TEST_CHECK_EQ(MP3FindSyncWord(&d[next], d.size() - next), 0);
+    TEST_CHECK_EQ(MP3GetXingInfo(&d[next], d.size() - next, &xi), ERR_MP3_NONE);
+    TEST_CHECK_EQ(xi.frameLen, 0);
+    // truncated header
+    TEST_CHECK(MP3GetXingInfo(&d[pos + sync], 3, &xi) != ERR_MP3_NONE);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mp3_gapless() {
+    // the file twice through one decoder as setNextFile() does: each half is exactly the LAME length,
+    // the second one sounds like the first (the decoder state of the seam only touches the trimmed delay)
+    std::vector<uint8_t> d = test_readFile(MP3_FILE);
+    size_t audio = skipID3(d);
+    TEST_CHECK(MP3Decoder_AllocateBuffers());
+    std::vector<int16_t> out;
+    trim_t t;
+    for(int k = 0; k < 2; k++) {
+        size_t skip = readGaplessInfo(&d[audio], d.size() - audio, &t);
+        TEST_CHECK(skip > 0);
+        decode(d, audio + skip, &t, out);
+        TEST_CHECK_EQ(out.size() / 2, (k + 1) * (size_t)MP3_SAMPLES);
+    }
+    MP3Decoder_FreeBuffers();
+    uint32_t diff = 0;
+    for(size_t i = 0; i < (size_t)MP3_SAMPLES * 2; i++) diff += abs(out[i] - out[MP3_SAMPLES * 2 + i]) > 2;
+    TEST_CHECK_EQ(diff, 0);
+
+    // a fresh decoder that skips nothing yields the delay in front and the padding behind
+    TEST_CHECK(MP3Decoder_AllocateBuffers());
+    std::vector<int16_t> raw;
+    size_t skip = readGaplessInfo(&d[audio], d.size() - audio, &t);
+    uint32_t delay = t.skip;
+    decode(d, audio + skip, NULL, raw);
+    MP3Decoder_FreeBuffers();
+    TEST_CHECK(raw.size() / 2 > (size_t)MP3_SAMPLES + delay);
+    TEST_CHECK(!memcmp(&raw[delay * 2], out.data(), MP3_SAMPLES * 2 * sizeof(int16_t)));
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_mp3_xing);
+    RUN_TEST(test_mp3_gapless);
+    return s_testFailures;
+}
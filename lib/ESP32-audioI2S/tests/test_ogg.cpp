@@ -0,0 +1,366 @@
+/*
+ * test_ogg.cpp
+ * Ogg demuxer: codec detection, pages and packets, CRC, the granule index and Ogg-FLAC through the shared page layer
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "ogg_demuxer/ogg_demuxer.h"
+#include "opus_decoder/opus_decoder.h"
+#include "vorbis_decoder/vorbis_decoder.h"
+#include "flac_decoder/flac_decoder.h"
+
+#define OPUS_PRE_SKIP 312 // sample.opus, OpusHead
+
+// independent of the demuxer, used to build pages
+static uint32_t crc32ogg(const uint8_t* p, size_t n) {
+    uint32_t crc = 0;
+    for(size_t i = 0; i < n; i++) {
+        crc ^= (uint32_t)p[i] << 24;
+        for(int j = 0; j < 8; j++) crc = (crc & 0x80000000UL) ? (crc << 1) ^ 0x04c11db7UL : (crc << 1);
+    }
+    return crc;
+}
+// appends one page that holds 'packets' completely, granule -1: no packet ends here (not used)
+static void writePage(std::vector<uint8_t>& out, const std::vector<std::vector<uint8_t>>& packets, uint64_t granule,
+                      uint8_t type, uint32_t seq) {
+    std::vector<uint8_t> lacing;
+    for(auto& p : packets) {
+        size_t n = p.size();
+        while(n >= 255) { lacing.push_back(255); n -= 255; }
+        lacing.push_back(n);
+    }
+    size_t start = out.size();
+    uint8_t hdr[27] = {'O', 'g', 'g', 'S', 0, type};
+    for(int i = 0; i < 8; i++) hdr[6 + i] = granule >> (8 * i);
+    hdr[14] = 0x11; // serial
+    for(int i = 0; i < 4; i++) hdr[18 + i] = seq >> (8 * i);
+    hdr[26] = lacing.size();
+    out.insert(out.end(), hdr, hdr + 27);
+    out.insert(out.end(), lacing.begin(), lacing.end());
+    for(auto& p : packets) out.insert(out.end(), p.begin(), p.end());
+    uint32_t crc = crc32ogg(&out[start], out.size() - start);
+    for(int i = 0; i < 4; i++) out[start + 22 + i] = crc >> (8 * i);
+}
+// all pages of a file: file position, start and end granule, first packet is a new one
+typedef struct { uint32_t pos; uint64_t start; uint64_t end; bool continued; } page_info_t;
+static std::vector<page_info_t> walkPages(const std::vector<uint8_t>& d) {
+    std::vector<page_info_t> pages;
+    ogg_page_t page;
+    size_t pos = 0;
+    while(pos + 27 <= d.size()) {
+        if(OGG_parsePage(&d[pos], d.size() - pos, &page) != OGG_PAGE_OK) break;
+        page_info_t pi = {(uint32_t)pos, OGG_getLastPageStartGranule(), page.granulePosition, page.continuedPage};
+        pages.push_back(pi);
+        pos += page.headerSize + page.bodySize;
+    }
+    return pages;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ogg_identify() {
+    std::vector<uint8_t> opus = test_readFile("sample.opus");
+    std::vector<uint8_t> vorbis = test_readFile("Collide.ogg");
+    std::vector<uint8_t> flac = test_readFile("Santiano-Wellerman.flac");
+    TEST_CHECK_EQ(OGG_identifyCodec(opus.data(), opus.size()), OGG_CODEC_OPUS);
+    TEST_CHECK_EQ(OGG_identifyCodec(vorbis.data(), vorbis.size()), OGG_CODEC_VORBIS);
+    TEST_CHECK_EQ(OGG_identifyCodec(flac.data(), flac.size()), OGG_CODEC_FLAC);
+    // the signature ends exactly at the end of the buffer
+    std::vector<uint8_t> b(opus.begin(), opus.begin() + 28 + 8); // header, 1 lacing value, "OpusHead"
+    TEST_CHECK_EQ(OGG_identifyCodec(b.data(), b.size()), OGG_CODEC_OPUS);
+    b.pop_back();
+    TEST_CHECK_EQ(OGG_identifyCodec(b.data(), b.size()), OGG_CODEC_NONE);
+    // short buffers are not read beyond their end (each one is a heap block of exactly that size)
+    for(int len = 6; len < 36; len++) {
+        uint8_t* p = (uint8_t*)malloc(len);
+        memcpy(p, opus.data(), len);
+        TEST_CHECK_EQ(OGG_identifyCodec(p, len), OGG_CODEC_NONE);
+        free(p);
+    }
+    const uint8_t native[6] = {'f', 'L', 'a', 'C', 0, 0};
+    TEST_CHECK_EQ(OGG_identifyCodec(native, 6), OGG_CODEC_FLAC);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ogg_packets() {
+    std::vector<uint8_t> d = test_readFile("Collide.ogg");
+    ogg_page_t page;
+    size_t pos = 0;
+    uint32_t pages = 0, packets = 0;
+    while(pos < d.size()) {
+        TEST_CHECK_EQ(OGG_findSyncWord(&d[pos], d.size() - pos), 0);
+        TEST_CHECK_EQ(OGG_parsePage(&d[pos], d.size() - pos, &page), OGG_PAGE_OK);
+        uint32_t sum = 0;
+        uint8_t  n = OGG_packetsLeft(&page);
+        TEST_CHECK_EQ(n, page.nrOfPackets);
+        while(OGG_packetsLeft(&page)) { sum += OGG_nextPacket(&page); packets++; }
+        TEST_CHECK_EQ(OGG_nextPacket(&page), 0);
+        TEST_CHECK_EQ(sum, page.bodySize);
+        pos += page.headerSize + page.bodySize;
+        pages++;
+    }
+    TEST_CHECK_EQ(pos, d.size());
+    TEST_CHECK_EQ(pages, 108);
+    TEST_CHECK(packets > pages);
+    OGG_clearPage(&page);
+    TEST_CHECK_EQ(OGG_packetsLeft(&page), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ogg_crc() {
+    std::vector<uint8_t> d = test_readFile("Collide.ogg");
+    ogg_page_t page;
+    OGG_setCRCcheck(true);
+    size_t pos = 0;
+    while(pos < d.size()) {
+        TEST_CHECK_EQ(OGG_parsePage(&d[pos], d.size() - pos, &page), OGG_PAGE_OK);
+        pos += page.headerSize + page.bodySize;
+    }
+    d[5000] ^= 0x10; // inside the second or third page
+    pos = 0;
+    int8_t ret = OGG_PAGE_OK;
+    while(pos < d.size() && ret == OGG_PAGE_OK) {
+        ret = OGG_parsePage(&d[pos], d.size() - pos, &page);
+        if(ret == OGG_PAGE_OK) pos += page.headerSize + page.bodySize;
+    }
+    TEST_CHECK_EQ(ret, ERR_OGG_CRC);
+    TEST_CHECK(pos < 5000);
+    TEST_CHECK_EQ(OGG_packetsLeft(&page), 0); // nothing of the broken page reaches the decoder
+    // a decoder that meets the broken page resyncs, the other pages still play
+    VORBISDecoder_AllocateBuffers();
+    VORBISsetDefaults();
+    static int16_t out[16384];
+    size_t total = d.size();
+    d.resize(total + 8192, 0);
+    pos = 0;
+    bool playing = false;
+    uint32_t errors = 0;
+    uint64_t frames = 0;
+    while(pos < total) {
+        int len = min(total - pos, (size_t)8192);
+        if(!playing) {
+            int sync = VORBISFindSyncWord(&d[pos], len);
+            if(sync < 0) { pos += len; continue; }
+            pos += sync; playing = true; continue;
+        }
+        int bytesLeft = len;
+        int r = VORBISDecode(&d[pos], &bytesLeft, out);
+        if(r < 0) { errors++; playing = false; pos++; continue; }
+        pos += len - bytesLeft;
+        if(r != VORBIS_PARSE_OGG_DONE) frames += VORBISGetOutputSamps();
+    }
+    TEST_CHECK(errors >= 1);
+    TEST_CHECK(frames > 1000000); // only the broken page is lost
+    VORBISDecoder_FreeBuffers();
+    OGG_setCRCcheck(false);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ogg_index() {
+    // the index is filled as Audio::decodeData() does while playing, every seek target must lie within the page
+    // that OGG_indexFind() returns, and the returned granule must be the one where that page starts
+    std::vector<uint8_t> d = test_readFile("Collide.ogg");
+    OGG_indexReset();
+    std::vector<page_info_t> pages = walkPages(d);
+    TEST_CHECK_EQ(pages.size(), 108);
+    for(auto& p : pages) if(!p.continued) OGG_indexAdd(p.pos, p.start, p.end);
+    TEST_CHECK(OGG_indexSize() > 100);
+    uint64_t last = pages.back().end;
+    for(uint64_t target = 0; target < last; target += 4410) {
+        uint64_t granule = ~0ULL;
+        int32_t  pos = OGG_indexFind(target, &granule);
+        TEST_CHECK(pos >= 0);
+        const page_info_t* found = NULL;
+        for(auto& p : pages) if(p.pos == (uint32_t)pos) found = &p;
+        TEST_CHECK(found != NULL);
+        if(!found) break;
+        TEST_CHECK_EQ(granule, found->start);
+        if(target >= pages[2].end) { // behind the header pages
+            TEST_CHECK(found->start <= target);
+            TEST_CHECK(target < found->end);
+        }
+    }
+    TEST_CHECK_EQ(OGG_indexFind(last + 1), -1);
+    OGG_indexReset();
+    TEST_CHECK_EQ(OGG_indexFind(0), -1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ogg_bisect() {
+    // beyond the index the bisection finds the same page as a full index would, from the first page of the file and
+    // from the furthest page of a partial index, and reads a small part of the file for it
+    fs::FS card(TESTFILES_DIR);
+    for(const char* name : {"Collide.ogg", "sample.opus"}) {
+        std::vector<uint8_t>     d = test_readFile(name);
+        std::vector<page_info_t> pages = walkPages(d);
+        OGG_indexReset();
+        for(auto& p : pages) if(!p.continued) OGG_indexAdd(p.pos, p.start, p.end);
+        File     f = card.open((std::string("/") + name).c_str());
+        uint64_t last = pages.back().end;
+        uint32_t seeks = 0;
+        size_t   bytes = File::s_bytesRead;
+        for(uint64_t target = pages[2].end; target <= last; target += last / 97) {
+            uint64_t granule = 0, ref = 0;
+            int32_t  pos = OGG_bisect(f, 0, 0, target, &granule);
+            TEST_CHECK_EQ(pos, OGG_indexFind(target, &ref));
+            TEST_CHECK_EQ(granule, ref);
+            seeks++;
+        }
+        double kb = (File::s_bytesRead - bytes) / 1024.0 / seeks;
+        // a partial index: the first quarter of the pages played
+        std::vector<page_info_t> full = pages;
+        OGG_indexReset();
+        for(size_t i = 0; i < full.size() / 4; i++) if(!full[i].continued) OGG_indexAdd(full[i].pos, full[i].start, full[i].end);
+        uint32_t startPos = 0;
+        uint64_t startGranule = 0;
+        TEST_CHECK(OGG_indexLast(&startPos, &startGranule));
+        for(uint64_t target = startGranule; target <= last; target += last / 31) {
+            uint64_t granule = 0;
+            int32_t  pos = OGG_bisect(f, startPos, startGranule, target, &granule);
+            const page_info_t* ref = NULL;                    // the last new-packet page that starts at or before it
+            for(auto& p : full) if(!p.continued && p.end && p.start <= target && (!ref || p.pos > ref->pos)) ref = &p;
+            TEST_CHECK(ref && pos == (int32_t)ref->pos);
+            if(ref) TEST_CHECK_EQ(granule, ref->start);
+        }
+        TEST_CHECK_EQ(OGG_bisect(f, startPos, startGranule, last + 1), -1);
+        TEST_CHECK_EQ(OGG_bisect(f, startPos, startGranule, startGranule - 1), -1);
+        printf("%-12s %zu KB, %zu pages: %.1f KB read per seek\n", name, d.size() / 1024, pages.size(), kb);
+        TEST_CHECK(kb < d.size() / 1024.0 / 4);
+        f.close();
+    }
+    OGG_indexReset();
+}
+//----------------------------------------------------------------------------------------------------------------------
+static uint64_t decodeOpusFrom(const std::vector<uint8_t>& d, size_t pos, bool seek) {
+    static int16_t out[8192];
+    std::vector<uint8_t> buf(d);
+    size_t total = d.size();
+    buf.resize(total + 8192, 0);
+    if(seek) OPUSDecoderSeekReset();
+    uint64_t frames = 0;
+    while(pos < total) {
+        int len = min(total - pos, (size_t)1024);
+        int bytesLeft = len;
+        int r = OPUSDecode(&buf[pos], &bytesLeft, out);
+        TEST_CHECK(r >= 0);
+        if(r < 0) break;
+        pos += len - bytesLeft;
+        if(r != OPUS_PARSE_OGG_DONE) frames += OPUSGetOutputSamps();
+    }
+    return frames;
+}
+static void test_ogg_opus_seek() {
+    // decoding from the page that OGG_indexFind() returns yields exactly the samples behind its granule,
+    // and the Opus pre-skip is known for the granule -> time conversion
+    std::vector<uint8_t> d = test_readFile("sample.opus");
+    OGG_indexReset();
+    std::vector<page_info_t> pages = walkPages(d);
+    for(auto& p : pages) if(!p.continued) OGG_indexAdd(p.pos, p.start, p.end);
+    TEST_CHECK(OPUSDecoder_AllocateBuffers());
+    OPUSsetDefaults();
+    decodeOpusFrom(d, 0, false); // reads the header pages
+    TEST_CHECK_EQ(OPUSGetPreSkip(), OPUS_PRE_SKIP);
+    // reference: from the second audio page after a seek reset, so the end trimming is the same as for every other
+    // seek (the first audio page holds more samples than its granule says, the encoder started at -pre-skip)
+    uint64_t all = decodeOpusFrom(d, pages[3].pos, true) + pages[3].start;
+    for(int sec = 1; sec < 18; sec += 4) {
+        uint64_t granule = 0;
+        int32_t  pos = OGG_indexFind((uint64_t)sec * 48000 + OPUSGetPreSkip(), &granule);
+        TEST_CHECK(pos > 0);
+        uint64_t frames = decodeOpusFrom(d, pos, true);
+        TEST_CHECK_EQ(frames + granule, all);                     // the page starts at 'granule'
+        TEST_CHECK(granule <= (uint64_t)sec * 48000 + OPUS_PRE_SKIP);
+        TEST_CHECK((int64_t)granule - OPUS_PRE_SKIP > (int64_t)(sec - 2) * 48000); // about one second per page
+    }
+    OPUSDecoder_FreeBuffers();
+    OGG_indexReset();
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ogg_flac() {
+    // Santiano-Wellerman.flac in an Ogg container (FLAC-to-Ogg mapping 1.0), decoded through FLACDecode()
+    std::vector<uint8_t> src = test_readFile("Santiano-Wellerman.flac");
+    if(src.size() < 42) return;
+    // metadata blocks and the frame positions of the native stream
+    std::vector<std::vector<uint8_t>> meta;
+    size_t pos = 4;
+    while(true) {
+        bool last = src[pos] & 0x80;
+        uint32_t len = (src[pos + 1] << 16) | (src[pos + 2] << 8) | src[pos + 3];
+        meta.push_back(std::vector<uint8_t>(src.begin() + pos, src.begin() + pos + 4 + len));
+        pos += 4 + len;
+        if(last) break;
+    }
+    uint8_t  md5[16];
+    memcpy(md5, &meta[0][4 + 18], 16);
+    uint16_t blockSize = (meta[0][4] << 8) | meta[0][5];
+    std::vector<size_t> frames;
+    for(size_t i = pos; i + 1 < src.size(); i++) { // candidates, checked below by the frame numbers
+        if(src[i] == 0xFF && src[i + 1] == 0xF8) frames.push_back(i);
+    }
+    // keep the sync codes that carry the expected frame number (UTF-8 coded, < 128 fits one byte, else two)
+    std::vector<size_t> starts;
+    for(size_t f : frames) {
+        uint32_t n = starts.size();
+        const uint8_t* h = &src[f + 4];
+        uint32_t num = (h[0] < 0x80) ? h[0] : ((h[0] & 0x1F) << 6) | (h[1] & 0x3F);
+        if(num == n) starts.push_back(f);
+    }
+    starts.push_back(src.size());
+    TEST_CHECK(starts.size() > 100);
+
+    std::vector<uint8_t> ogg;
+    std::vector<uint8_t> first = {0x7F, 'F', 'L', 'A', 'C', 1, 0, 0, (uint8_t)(meta.size() - 1), 'f', 'L', 'a', 'C'};
+    first.insert(first.end(), meta[0].begin(), meta[0].end());
+    uint32_t seq = 0;
+    writePage(ogg, {first}, 0, 0x02, seq++);
+    for(size_t i = 1; i < meta.size(); i++) writePage(ogg, {meta[i]}, 0, 0, seq++);
+    uint64_t granule = 0;
+    for(size_t i = 0; i + 1 < starts.size(); i += 4) { // 4 frames per page
+        std::vector<std::vector<uint8_t>> packets;
+        for(size_t k = i; k < i + 4 && k + 1 < starts.size(); k++) {
+            packets.push_back(std::vector<uint8_t>(src.begin() + starts[k], src.begin() + starts[k + 1]));
+            granule += blockSize; // the last frame may be shorter, the granule is not used by the decoder
+        }
+        writePage(ogg, packets, granule, (i + 5 >= starts.size()) ? 0x04 : 0, seq++);
+    }
+    TEST_CHECK_EQ(OGG_identifyCodec(ogg.data(), ogg.size()), OGG_CODEC_FLAC);
+
+    OGG_setCRCcheck(true); // the pages written above must pass
+    TEST_CHECK(FLACDecoder_AllocateBuffers());
+    FLACDecoder_setDefaults();
+    static int16_t out[MAX_BLOCKSIZE * 2];
+    test_md5_t ctx;
+    test_md5Init(&ctx);
+    size_t total = ogg.size();
+    ogg.resize(total + 16, 0);
+    pos = 0;
+    uint64_t samples = 0;
+    uint32_t errors = 0;
+    while(pos < total) {
+        int len = min(total - pos, (size_t)16384);
+        int bytesLeft = len;
+        int8_t r = FLACDecode(&ogg[pos], &bytesLeft, out);
+        if(r < 0) { errors++; break; }
+        pos += len - bytesLeft;
+        if(r == ERR_FLAC_NONE) {
+            uint16_t n = FLACGetOutputSamps();
+            for(uint16_t i = 0; i < n / 2; i++) test_md5Update(&ctx, &out[2 * i], 4);
+            samples += n / 2;
+        }
+    }
+    uint8_t res[16];
+    test_md5Final(&ctx, res);
+    TEST_CHECK_EQ(errors, 0);
+    TEST_CHECK_EQ(samples, 450155);
+    TEST_CHECK(!memcmp(res, md5, 16));
+    FLACDecoder_FreeBuffers();
+    OGG_setCRCcheck(false);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_ogg_identify);
+    RUN_TEST(test_ogg_packets);
+    RUN_TEST(test_ogg_crc);
+    RUN_TEST(test_ogg_index);
+    RUN_TEST(test_ogg_bisect);
+    RUN_TEST(test_ogg_opus_seek);
+    RUN_TEST(test_ogg_flac);
+    return s_testFailures;
+}
@@ -0,0 +1,62 @@
+/*
+ * test_opus.cpp
+ * Opus (CELT) decoder: sample.opus decodes to the same PCM as the reference decoder
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  the expected hash was taken from the decoder before the comb filter, PVQ and IMDCT changes, with the first audio
+ *  packet behind OpusTags decoded (all 904 packets of the file); CELT is built fixed-point, so the output is bit exact
+ *  on every host
+ */
+#include "test_common.h"
+#include "opus_decoder/opus_decoder.h"
+
+#define OPUS_FILE       "sample.opus"
+#define OPUS_PCM_HASH   0xEDEA5CCB
+#define OPUS_PCM_FRAMES 867840    // 18.08 s at 48 kHz
+
+//----------------------------------------------------------------------------------------------------------------------
+static void test_opus_decode() {
+    std::vector<uint8_t> d = test_readFile(OPUS_FILE);
+    size_t total = d.size();
+    d.resize(total + 8192, 0);
+    TEST_CHECK(OPUSDecoder_AllocateBuffers());
+    OPUSsetDefaults();
+    static int16_t out[8192];
+    uint32_t hash = 2166136261UL;
+    uint64_t frames = 0;
+    uint32_t errors = 0;
+    size_t   pos = 0;
+    bool     playing = false;
+    while(pos < total) {
+        int len = min(total - pos, (size_t)1024);
+        if(!playing) {
+            int sync = OPUSFindSyncWord(&d[pos], len);
+            if(sync < 0) { pos += len; continue; }
+            pos += sync;
+            playing = true;
+            continue;
+        }
+        int bytesLeft = len;
+        int ret = OPUSDecode(&d[pos], &bytesLeft, out);
+        if(ret < 0) { errors++; playing = false; pos++; continue; }
+        pos += len - bytesLeft;
+        if(ret == OPUS_PARSE_OGG_DONE) continue;
+        uint16_t n = OPUSGetOutputSamps(); // stereo frames
+        if(n) {
+            hash = test_fnv(out, n * 2 * sizeof(int16_t), hash);
+            frames += n;
+        }
+    }
+    TEST_CHECK_EQ(errors, 0);
+    TEST_CHECK_EQ(OPUSGetSampRate(), 48000);
+    TEST_CHECK_EQ(frames, OPUS_PCM_FRAMES);
+    TEST_CHECK_EQ(hash, OPUS_PCM_HASH);
+    OPUSDecoder_FreeBuffers();
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_opus_decode);
+    return s_testFailures;
+}
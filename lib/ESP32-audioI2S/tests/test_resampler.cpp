@@ -0,0 +1,144 @@
+/*
+ * test_resampler.cpp
+ * AudioResampler: THD+N of all supported ratios, passband, output frame count, block size independence and bypass
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "resampler/resampler.h"
+
+// THD+N of channel 'ch': least squares fit of a sine at the known frequency (sin, cos, dc), the residual is the rest
+static double thdn(const std::vector<int16_t>& y, uint8_t channels, uint8_t ch, double f, double fs, size_t from, size_t to) {
+    double A[3][3] = {{0}}, B[3] = {0};
+    for(size_t i = from; i < to; i++) {
+        double v[3] = {sin(2 * M_PI * f * i / fs), cos(2 * M_PI * f * i / fs), 1};
+        for(int r = 0; r < 3; r++) {
+            B[r] += v[r] * y[i * channels + ch];
+            for(int c = 0; c < 3; c++) A[r][c] += v[r] * v[c];
+        }
+    }
+    auto det = [](double m[3][3]) {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+               m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    };
+    double d = det(A), k[3];
+    for(int c = 0; c < 3; c++) {
+        double m[3][3];
+        for(int r = 0; r < 3; r++) for(int q = 0; q < 3; q++) m[r][q] = (q == c) ? B[r] : A[r][q];
+        k[c] = det(m) / d;
+    }
+    double e = 0, p = 0;
+    for(size_t i = from; i < to; i++) {
+        double fit = k[0] * sin(2 * M_PI * f * i / fs) + k[1] * cos(2 * M_PI * f * i / fs);
+        double r = y[i * channels + ch] - fit - k[2];
+        e += r * r;
+        p += fit * fit;
+    }
+    return 10 * log10(e / p);
+}
+static std::vector<int16_t> sine(double f, double amp, uint32_t rate, uint32_t frames, uint8_t channels) {
+    std::vector<int16_t> x(frames * channels);
+    for(uint32_t i = 0; i < frames; i++)
+        for(uint8_t c = 0; c < channels; c++) x[i * channels + c] = (int16_t)lrint(amp * sin(2 * M_PI * f * i / rate + c));
+    return x;
+}
+// feeds 'x' in blocks of 'block' frames, checks the maxOutputFrames() bound of every call
+static std::vector<int16_t> run(AudioResampler& rs, const std::vector<int16_t>& x, uint8_t channels, uint32_t block) {
+    uint32_t frames = x.size() / channels;
+    std::vector<int16_t> y(rs.maxOutputFrames(frames) * channels + 64);
+    size_t on = 0;
+    for(uint32_t i = 0; i < frames; i += block) {
+        uint32_t n = min(block, frames - i);
+        uint32_t bound = rs.maxOutputFrames(n);
+        if(y.size() < (on + bound) * channels) y.resize((on + bound) * channels);
+        uint32_t o = rs.process(&x[i * channels], n, &y[on * channels]);
+        TEST_CHECK(o <= bound);
+        on += o;
+    }
+    y.resize(on * channels);
+    return y;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_rs_thdn() {
+    struct { uint32_t in, out; uint8_t mode; } r[] = {
+        {44100, 48000, RS_POLYPHASE}, {48000, 44100, RS_POLYPHASE}, {16000, 48000, RS_POLYPHASE},
+        {8000, 48000, RS_POLYPHASE},  {22050, 48000, RS_POLYPHASE}, {32000, 48000, RS_POLYPHASE},
+        {16000, 44100, RS_POLYPHASE}, {96000, 48000, RS_POLYPHASE}, {11025, 48000, RS_ARBITRARY},
+        {44056, 48000, RS_ARBITRARY}};
+    for(auto& t : r) {
+        AudioResampler rs;
+        TEST_CHECK(rs.setRates(t.in, t.out, 2));
+        TEST_CHECK_EQ(rs.getMode(), t.mode);
+        uint32_t n = t.in * 2;
+        std::vector<int16_t> x = sine(997, 29204, t.in, n, 2); // -1 dBFS
+        std::vector<int16_t> y = run(rs, x, 2, 1152);
+        size_t on = y.size() / 2;
+        // the filter delay is held back, at most RS_MAX_TAPS input frames
+        TEST_CHECK(on <= (uint64_t)n * t.out / t.in);
+        TEST_CHECK(on + (uint64_t)RS_MAX_TAPS * t.out / t.in + 2 >= (uint64_t)n * t.out / t.in);
+        double d0 = thdn(y, 2, 0, 997, t.out, t.out / 4, on - 100);
+        double d1 = thdn(y, 2, 1, 997, t.out, t.out / 4, on - 100);
+        if(d0 > -78 || d1 > -78) fprintf(stderr, "%u -> %u: THD+N %.1f / %.1f dB\n", t.in, t.out, d0, d1);
+        TEST_CHECK(d0 < -78);
+        TEST_CHECK(d1 < -78);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_rs_passband() {
+    AudioResampler rs;
+    rs.setRates(44100, 48000, 1);
+    for(double f : {20.0, 1000.0, 10000.0, 16000.0}) {
+        rs.reset();
+        std::vector<int16_t> y = run(rs, sine(f, 16000, 44100, 44100, 1), 1, 44100);
+        double g = test_dB(test_rms(&y[y.size() / 4], y.size() / 2) / (16000 / sqrt(2)));
+        TEST_CHECK_NEAR(g, 0, 0.1);
+    }
+    rs.reset();
+    std::vector<int16_t> y = run(rs, sine(21500, 16000, 44100, 44100, 1), 1, 44100); // transition band
+    TEST_CHECK(test_dB(test_rms(&y[y.size() / 4], y.size() / 2) / (16000 / sqrt(2))) < -10);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_rs_blocks() {
+    // the output does not depend on how the input is split into blocks, reset() restarts the stream
+    for(uint32_t in : {44100u, 44056u}) {
+        AudioResampler rs;
+        rs.setRates(in, 48000, 2);
+        std::vector<int16_t> x(in * 2);
+        for(auto& s : x) s = (int16_t)((rand() % 40000) - 20000);
+        std::vector<int16_t> a = run(rs, x, 2, in);
+        rs.reset();
+        std::vector<int16_t> b = run(rs, x, 2, 1);
+        rs.reset();
+        std::vector<int16_t> c = run(rs, x, 2, 1153);
+        TEST_CHECK(a == b);
+        TEST_CHECK(a == c);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_rs_bypass() {
+    AudioResampler rs;
+    TEST_CHECK(rs.setRates(48000, 48000, 2));
+    TEST_CHECK(rs.isBypass());
+    // switching between rates reuses the cached filter banks and gives the same output as a fresh instance
+    std::vector<int16_t> x = sine(440, 10000, 44100, 4410, 2);
+    rs.setRates(44100, 48000, 2);
+    std::vector<int16_t> a = run(rs, x, 2, 1152);
+    rs.setRates(32000, 48000, 2);
+    rs.setRates(44100, 48000, 2);
+    rs.reset();
+    std::vector<int16_t> b = run(rs, x, 2, 1152);
+    AudioResampler fresh;
+    fresh.setRates(44100, 48000, 2);
+    std::vector<int16_t> c = run(fresh, x, 2, 1152);
+    TEST_CHECK(a == b);
+    TEST_CHECK(a == c);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_rs_thdn);
+    RUN_TEST(test_rs_passband);
+    RUN_TEST(test_rs_blocks);
+    RUN_TEST(test_rs_bypass);
+    return s_testFailures;
+}
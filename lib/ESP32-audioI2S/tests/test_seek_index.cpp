@@ -0,0 +1,249 @@
+/*
+ * test_seek_index.cpp
+ * AudioSeekIndex: entries against the frame positions the decoders see, the sidecar file and its invalidation,
+ * sample accurate jumps in mp3 and m4a files
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "seek_index/seek_index.h"
+#include "mp3_decoder/mp3_decoder.h"
+#include "aac_decoder/aac_decoder.h"
+#include <functional>
+
+#define SI_MP3_FILE "Olsen-Banden.mp3"
+#define SI_M4A_FILE "Miss-Marple.m4a"
+#define SI_JUMPS    50
+#define SI_COMPARE  4096 // frames compared behind every jump target
+
+static std::string s_root; // a temporary directory is the card
+
+static void copyToCard(const char* name, const std::vector<uint8_t>& d) {
+    FILE* f = fopen((s_root + "/" + name).c_str(), "wb");
+    fwrite(d.data(), 1, d.size(), f);
+    fclose(f);
+}
+static uint32_t lcg(uint32_t* s) { *s = *s * 1664525 + 1013904223; return *s >> 8; }
+
+typedef struct {
+    std::vector<uint8_t>  data;       // padded, the decoders may read ahead
+    size_t                size;
+    uint32_t              dataStart;
+    uint32_t              stszPos;    // m4a
+    uint32_t              stszEntries;
+    std::vector<uint32_t> framePos;   // file position of every audio frame
+    std::vector<int16_t>  pcm;        // continuous decode from the first frame
+    uint16_t              spf;        // decoded frames per audio frame
+} si_file_t;
+
+static void loadMP3(si_file_t* f) {
+    f->data = test_readFile(SI_MP3_FILE);
+    std::vector<uint8_t>& d = f->data;
+    f->size = d.size();
+    f->dataStart = (!memcmp(d.data(), "ID3", 3)) ? 10 + ((d[6] & 0x7f) << 21 | (d[7] & 0x7f) << 14 | (d[8] & 0x7f) << 7 | (d[9] & 0x7f)) : 0;
+    d.resize(f->size + 8192, 0);
+    size_t p = f->dataStart + MP3FindSyncWord(&d[f->dataStart], f->size - f->dataStart);
+    MP3XingInfo_t xi;
+    MP3GetXingInfo(&d[p], f->size - p, &xi);
+    p += xi.frameLen;
+    static int16_t buf[1152 * 2];
+    MP3Decoder_AllocateBuffers();
+    while(p + 4 < f->size) {
+        int s = MP3FindSyncWord(&d[p], f->size - p);
+        if(s < 0) break;
+        p += s;
+        int left = f->size - p, before = left;
+        if(MP3Decode(&d[p], &left, buf, 0)) { p++; continue; }
+        f->framePos.push_back(p);
+        p += before - left;
+        f->spf = MP3GetOutputSamps() / 2;
+        f->pcm.insert(f->pcm.end(), buf, buf + MP3GetOutputSamps());
+    }
+    MP3Decoder_FreeBuffers();
+}
+static void loadM4A(si_file_t* f) {
+    f->data = test_readFile(SI_M4A_FILE);
+    std::vector<uint8_t>& d = f->data;
+    f->size = d.size();
+    d.resize(f->size + 8192, 0);
+    std::function<void(size_t, size_t)> walk = [&](size_t p, size_t end) {
+        while(p + 8 <= end) {
+            uint32_t len = test_rd32be(&d[p]);
+            if(len < 8) break;
+            const char* t = (const char*)&d[p + 4];
+            if(!memcmp(t, "mdat", 4)) f->dataStart = p + 8;
+            if(!memcmp(t, "moov", 4) || !memcmp(t, "trak", 4) || !memcmp(t, "mdia", 4) || !memcmp(t, "minf", 4) ||
+               !memcmp(t, "stbl", 4)) walk(p + 8, p + len);
+            if(!memcmp(t, "stsz", 4)) { f->stszEntries = test_rd32be(&d[p + 16]); f->stszPos = p + 20; }
+            p += len;
+        }
+    };
+    walk(0, f->size);
+    static int16_t buf[2048 * 2];
+    AACDecoder_AllocateBuffers();
+    AACSetRawBlockParams(0, 2, 44100, 1);
+    size_t p = f->dataStart;
+    for(uint32_t i = 0; i < f->stszEntries; i++) {
+        uint32_t sz = test_rd32be(&d[f->stszPos + 4 * i]);
+        f->framePos.push_back(p);
+        int bytesLeft = sz;
+        AACDecode(&d[p], &bytesLeft, buf);
+        p += sz;
+        f->spf = AACGetOutputSamps() / 2;
+        f->pcm.insert(f->pcm.end(), buf, buf + AACGetOutputSamps());
+    }
+    AACDecoder_FreeBuffers();
+}
+static bool begin(AudioSeekIndex& si, const si_file_t& f, bool m4a) {
+    return m4a ? si.beginM4A(f.dataStart, f.stszPos, f.stszEntries, 44100) : si.beginMP3(f.dataStart);
+}
+// decodes SI_COMPARE frames from 'pos' on, the first 'skip' output frames are dropped, as Audio does after a jump
+static std::vector<int16_t> decodeFrom(const si_file_t& f, bool m4a, uint32_t pos, uint32_t frame, uint32_t skip) {
+    static int16_t buf[2048 * 2];
+    std::vector<int16_t> out;
+    std::vector<uint8_t>& d = (std::vector<uint8_t>&)f.data;
+    if(!m4a) {
+        MP3Decoder_AllocateBuffers();
+        while(out.size() < SI_COMPARE * 2 && pos + 4 < f.size) {
+            pos += MP3FindSyncWord(&d[pos], f.size - pos);
+            int left = f.size - pos, before = left;
+            int err = MP3Decode(&d[pos], &left, buf, 0);
+            if(err == ERR_MP3_MAINDATA_UNDERFLOW) { skip -= min(skip, (uint32_t)f.spf); pos += before - left; continue; }
+            if(err) { pos++; continue; }
+            pos += before - left;
+            uint32_t n = min(skip, (uint32_t)f.spf);
+            skip -= n;
+            out.insert(out.end(), buf + n * 2, buf + f.spf * 2);
+        }
+        MP3Decoder_FreeBuffers();
+    }
+    else {
+        AACDecoder_AllocateBuffers();
+        AACSetRawBlockParams(0, 2, 44100, 1);
+        while(out.size() < SI_COMPARE * 2 && frame < f.stszEntries) {
+            uint32_t sz = test_rd32be(&d[f.stszPos + 4 * frame++]);
+            int bytesLeft = sz;
+            AACDecode(&d[pos], &bytesLeft, buf);
+            pos += sz;
+            uint32_t n = min(skip, (uint32_t)f.spf);
+            skip -= n;
+            out.insert(out.end(), buf + n * 2, buf + f.spf * 2);
+        }
+        AACDecoder_FreeBuffers();
+    }
+    return out;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void checkFile(const char* name, bool m4a) {
+    si_file_t f = {};
+    if(m4a) loadM4A(&f); else loadMP3(&f);
+    TEST_CHECK(f.framePos.size() > 500);
+    copyToCard(name, std::vector<uint8_t>(f.data.begin(), f.data.begin() + f.size));
+    fs::FS card(s_root);
+    std::string path = std::string("/") + name;
+
+    // build while "playing"
+    AudioSeekIndex si;
+    si.open(card, path.c_str());
+    TEST_CHECK(!begin(si, f, m4a));
+    TEST_CHECK(si.isBusy());
+    uint32_t steps = 0;
+    while(si.isBusy() && steps < 100000) { si.scanStep(); steps++; }
+    TEST_CHECK(si.isReady());
+    TEST_CHECK_EQ(si.getFrames(), f.framePos.size());
+    TEST_CHECK(card.exists(SI_DIR));
+
+    // a second instance takes the sidecar, nothing of the audio file is scanned
+    AudioSeekIndex s2;
+    s2.open(card, path.c_str());
+    File::s_bytesRead = 0;
+    TEST_CHECK(begin(s2, f, m4a));
+    TEST_CHECK(s2.isReady());
+    TEST_CHECK(File::s_bytesRead < 20000);
+    TEST_CHECK_EQ(s2.getFrames(), f.framePos.size());
+    uint32_t bad = 0;
+    for(uint32_t n = 0; n < f.framePos.size(); n++) {
+        uint32_t ef = UINT32_MAX;
+        int32_t  pos = s2.find(n, &ef);
+        if(ef > n || n - ef >= 64 || pos != (int32_t)f.framePos[ef]) bad++;
+        int32_t at = s2.frameAt(f.framePos[n]);   // exact on the entries, interpolated between them
+        if(n == ef ? at != (int32_t)n : abs(at - (int32_t)n) >= 64) bad++;
+    }
+    TEST_CHECK_EQ(bad, 0);
+
+    // jumps: a few frames in front of the target (bit reservoir, overlap), then the samples up to the target are dropped.
+    // mp3 is bit exact, the AAC decoder keeps its PNS noise seed across frames, so the m4a output may differ in the low
+    // bits, a position that is off by one sample differs by far more
+    uint32_t seed = 1, mismatches = 0;
+    const uint32_t preroll = m4a ? 2 : 6;
+    for(int k = 0; k < SI_JUMPS; k++) {
+        uint32_t target = lcg(&seed) % (f.pcm.size() / 2 - SI_COMPARE - 8192);
+        uint32_t frame = target / f.spf, ef;
+        int32_t  pos = s2.find(frame > preroll ? frame - preroll : 0, &ef);
+        TEST_CHECK(pos > 0);
+        std::vector<int16_t> out = decodeFrom(f, m4a, pos, ef, target - ef * f.spf);
+        if(out.size() < SI_COMPARE * 2) { mismatches++; continue; }
+        int maxDiff = 0;
+        for(int i = 0; i < SI_COMPARE * 2; i++) maxDiff = max(maxDiff, abs(out[i] - f.pcm[(size_t)target * 2 + i]));
+        if(maxDiff > (m4a ? 64 : 0)) mismatches++;
+    }
+    TEST_CHECK_EQ(mismatches, 0);
+
+    // the file has changed: the sidecar is not used
+    f.data[f.size] = 0;
+    copyToCard(name, std::vector<uint8_t>(f.data.begin(), f.data.begin() + f.size + 1));
+    AudioSeekIndex s3;
+    s3.open(card, path.c_str());
+    TEST_CHECK(!begin(s3, f, m4a));
+    TEST_CHECK(s3.isBusy());
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_si_mp3() { checkFile(SI_MP3_FILE, false); }
+static void test_si_m4a() { checkFile(SI_M4A_FILE, true); }
+//----------------------------------------------------------------------------------------------------------------------
+static void test_si_large_entries() {
+    // an stsz table alone: between the entries there are a few bytes up to some MB, the sidecar keeps every one
+    const uint32_t n = 3000, dataStart = 1 << 20;
+    std::vector<uint8_t> d(8 + 4 * n);
+    std::vector<uint32_t> pos;
+    uint32_t seed = 7, p = dataStart;
+    for(uint32_t i = 0; i < n; i++) {
+        uint32_t sz = (i % 500 == 499) ? 300000 + lcg(&seed) % 5000000 : 1 + lcg(&seed) % 900;
+        d[8 + 4 * i] = sz >> 24, d[9 + 4 * i] = sz >> 16, d[10 + 4 * i] = sz >> 8, d[11 + 4 * i] = sz;
+        pos.push_back(p);
+        p += sz;
+    }
+    copyToCard("large.m4a", d);
+    fs::FS card(s_root);
+
+    AudioSeekIndex si;
+    si.open(card, "/large.m4a");
+    TEST_CHECK(!si.beginM4A(dataStart, 8, n, 44100));
+    while(si.isBusy()) si.scanStep();
+    TEST_CHECK(si.isReady());
+
+    AudioSeekIndex s2;
+    s2.open(card, "/large.m4a");
+    TEST_CHECK(s2.beginM4A(dataStart, 8, n, 44100)); // from the sidecar
+    TEST_CHECK_EQ(s2.getFrames(), n);
+    uint32_t bad = 0;
+    for(uint32_t f = 0; f < n; f++) {
+        uint32_t ef = UINT32_MAX;
+        int32_t  at = s2.find(f, &ef);
+        if(ef > f || at != (int32_t)pos[ef]) bad++;
+    }
+    TEST_CHECK_EQ(bad, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    char dir[] = "/tmp/seekidx_XXXXXX";
+    if(!mkdtemp(dir)) return 1;
+    s_root = dir;
+    RUN_TEST(test_si_mp3);
+    RUN_TEST(test_si_m4a);
+    RUN_TEST(test_si_large_entries);
+    std::string rm = "rm -rf " + s_root;
+    if(system(rm.c_str())) {}
+    return s_testFailures;
+}
@@ -0,0 +1,149 @@
+/*
+ * test_server.h
+ * HTTP/1.1 server on 127.0.0.1 for the tests that go through WiFiClient. Every connection has a thread, requests on
+ * it are served one after the other (keep-alive) until the handler returns false or the client closes. The handler
+ * writes the response with the helpers below and may sleep between the writes to throttle it.
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct Test_Request {
+    std::string method;
+    std::string path;
+    std::string header;   // all header lines
+    std::string body;     // Content-Length bytes
+};
+typedef std::function<bool(int fd, const Test_Request& req)> Test_Handler; // false: close the connection
+
+static inline bool test_send(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while(len) {
+        ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+        if(n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+static inline bool test_send(int fd, const std::string& s) { return test_send(fd, s.data(), s.size()); }
+// status line and header; contentLength < 0: chunked
+static inline bool test_sendHeader(int fd, int status, long contentLength, const std::string& extra = "") {
+    char h[256];
+    if(contentLength < 0) snprintf(h, sizeof(h), "HTTP/1.1 %d X\r\nTransfer-Encoding: chunked\r\n", status);
+    else snprintf(h, sizeof(h), "HTTP/1.1 %d X\r\nContent-Length: %ld\r\n", status, contentLength);
+    return test_send(fd, h + extra + "\r\n");
+}
+static inline bool test_sendChunk(int fd, const std::string& data) { // an empty one ends the body
+    char h[16];
+    snprintf(h, sizeof(h), "%zx\r\n", data.size());
+    return test_send(fd, h + data + "\r\n");
+}
+static inline void test_sleep(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+class Test_Server {
+public:
+    explicit Test_Server(Test_Handler handler) : m_handler(handler) {
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in a = {};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = 0;
+        bind(m_fd, (sockaddr*)&a, sizeof(a));
+        socklen_t len = sizeof(a);
+        getsockname(m_fd, (sockaddr*)&a, &len);
+        m_port = ntohs(a.sin_port);
+        listen(m_fd, 16);
+        m_accept = std::thread([this] { acceptLoop(); });
+    }
+    ~Test_Server() {
+        m_stop = true;
+        ::shutdown(m_fd, SHUT_RDWR);
+        ::close(m_fd);
+        m_accept.join();
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for(int fd : m_clients) ::shutdown(fd, SHUT_RDWR);
+        }
+        for(auto& t : m_threads) t.join();
+    }
+    std::string url(const std::string& path) const { return "http://127.0.0.1:" + std::to_string(m_port) + path; }
+    uint16_t    port() const { return m_port; }
+
+    std::atomic<uint32_t> requests{0};
+    std::atomic<uint32_t> connections{0};
+
+private:
+    void acceptLoop() {
+        while(!m_stop) {
+            int fd = accept(m_fd, NULL, NULL);
+            if(fd < 0) break;
+            connections++;
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_clients.push_back(fd);
+            m_threads.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+    bool readRequest(int fd, std::string& buf, Test_Request* r) {
+        size_t end;
+        while((end = buf.find("\r\n\r\n")) == std::string::npos) {
+            char    c[4096];
+            ssize_t n = recv(fd, c, sizeof(c), 0);
+            if(n <= 0) return false;
+            buf.append(c, n);
+        }
+        std::string head = buf.substr(0, end + 2);
+        buf.erase(0, end + 4);
+        size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+        r->method = head.substr(0, sp1);
+        r->path = head.substr(sp1 + 1, sp2 - sp1 - 1);
+        r->header = head.substr(head.find("\r\n") + 2);
+        size_t      len = 0;
+        std::string lower = r->header;
+        for(char& ch : lower) ch = tolower(ch);
+        size_t k = lower.find("content-length:");
+        if(k != std::string::npos) len = strtoul(lower.c_str() + k + 15, NULL, 10);
+        while(buf.size() < len) {
+            char    c[4096];
+            ssize_t n = recv(fd, c, sizeof(c), 0);
+            if(n <= 0) return false;
+            buf.append(c, n);
+        }
+        r->body = buf.substr(0, len);
+        buf.erase(0, len);
+        return true;
+    }
+    void serve(int fd) {
+        std::string  buf;
+        Test_Request r;
+        while(!m_stop && readRequest(fd, buf, &r)) {
+            requests++;
+            if(!m_handler(fd, r)) break;
+        }
+        std::lock_guard<std::mutex> lock(m_lock);
+        ::close(fd);
+        for(auto& c : m_clients) if(c == fd) c = -1;
+    }
+
+    Test_Handler             m_handler;
+    int                      m_fd = -1;
+    uint16_t                 m_port = 0;
+    std::atomic<bool>        m_stop{false};
+    std::thread              m_accept;
+    std::mutex               m_lock;
+    std::vector<int>         m_clients;
+    std::vector<std::thread> m_threads;
+};
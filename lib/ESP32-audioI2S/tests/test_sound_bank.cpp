@@ -0,0 +1,336 @@
+/*
+ * test_sound_bank.cpp
+ * AudioSoundBank: WAV and MP3 clips resampled to the bank rate, sample-exact through the mixer, trigger time against
+ * decoding per trigger, hit rate over the budget, eviction that spares playing clips, damaged RIFF chunk sizes; and
+ * Audio::loadSound() decoding while the music plays without holding up loop()
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Audio.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+
+#define SB_TEST_RATE 44100
+
+static fs::FS s_card(TESTFILES_DIR);
+
+static void wr16(std::vector<uint8_t>& v, uint16_t x) { v.push_back(x); v.push_back(x >> 8); }
+static void wr32(std::vector<uint8_t>& v, uint32_t x) { wr16(v, x); wr16(v, x >> 16); }
+// a 16 bit PCM WAV with a sine, the data chunk at 44
+static std::vector<uint8_t> makeWAV(uint32_t rate, uint8_t ch, uint32_t frames, float hz) {
+    std::vector<uint8_t> v = {'R', 'I', 'F', 'F'};
+    wr32(v, 36 + frames * ch * 2);
+    v.insert(v.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    wr32(v, 16);
+    wr16(v, 1);
+    wr16(v, ch);
+    wr32(v, rate);
+    wr32(v, rate * ch * 2);
+    wr16(v, ch * 2);
+    wr16(v, 16);
+    v.insert(v.end(), {'d', 'a', 't', 'a'});
+    wr32(v, frames * ch * 2);
+    for(uint32_t i = 0; i < frames; i++)
+        for(int c = 0; c < ch; c++) wr16(v, (uint16_t)(int16_t)(8000 * sin(2 * M_PI * hz * i / rate) + c));
+    return v;
+}
+static double nowUs() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+// the table of the bank, for the tests
+class TestBank : public AudioSoundBank {
+public:
+    const int16_t* pcm(const char* name, uint32_t* frames = NULL, uint8_t* ch = NULL) {
+        for(int i = 0; i < SB_MAX_SOUNDS; i++) {
+            if(!m_sound[i].pcm || strcmp(m_sound[i].name, name)) continue;
+            if(frames) *frames = m_sound[i].frames;
+            if(ch) *ch = m_sound[i].channels;
+            return m_sound[i].pcm;
+        }
+        return NULL;
+    }
+};
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sb_formats() {
+    // 8 and 16 bit, mono and stereo, 8 ... 44.1 kHz: the length at the bank rate, the channels stay
+    AudioMixer mixer;
+    mixer.setSampleRate(SB_TEST_RATE);
+    TestBank bank;
+    bank.begin(&mixer, SB_TEST_RATE, 4 * 1024 * 1024);
+    const char* files[] = {"test_16bit_mono.wav", "test_16bit_stereo.wav", "test_8bit_mono.wav", "test_8bit_stereo.wav"};
+    for(const char* name : files) {
+        std::string          path = std::string("/") + name;
+        std::vector<uint8_t> d = test_readFile(name);
+        if(d.size() <= SB_MAX_FILE) TEST_CHECK_EQ(bank.load(s_card, path.c_str()), SB_OK);
+        else {                                              // too large for load(), the data chunk is cut
+            TEST_CHECK_EQ(bank.load(s_card, path.c_str()), SB_ERR_MEMORY);
+            d.resize(SB_MAX_FILE);
+            TEST_CHECK_EQ(bank.loadMemory(path.c_str(), d.data(), d.size()), SB_OK);
+        }
+        uint32_t pos = 12;
+        while(memcmp(&d[pos], "data", 4)) pos += 8 + test_rd32(&d[pos + 4]);
+        uint16_t ch = test_rd16(&d[22]);
+        double   sec = (double)min((size_t)test_rd32(&d[pos + 4]), d.size() - pos - 8) / (ch * test_rd16(&d[34]) / 8) /
+                     test_rd32(&d[24]);
+        uint32_t frames = 0;
+        uint8_t  channels = 0;
+        TEST_CHECK(bank.pcm(path.c_str(), &frames, &channels));
+        TEST_CHECK_EQ(channels, ch);
+        TEST_CHECK_NEAR(frames, sec * SB_TEST_RATE, 2);
+    }
+    // an MP3 clip: the start of Olsen-Banden.mp3, the whole file is larger than SB_MAX_FILE
+    std::vector<uint8_t> mp3 = test_readFile("Olsen-Banden.mp3");
+    TEST_CHECK_EQ(bank.load(s_card, "/Olsen-Banden.mp3"), mp3.size() > SB_MAX_FILE ? SB_ERR_MEMORY : SB_OK);
+    mp3.resize(24 * 1024);
+    TEST_CHECK_EQ(bank.loadMemory("mp3", mp3.data(), mp3.size(), true), SB_ERR_BUSY);
+    TEST_CHECK_EQ(bank.loadMemory("mp3", mp3.data(), mp3.size()), SB_OK);
+    uint32_t frames = 0;
+    const int16_t* p = bank.pcm("mp3", &frames);
+    TEST_CHECK(p && frames > SB_TEST_RATE && frames < 2 * SB_TEST_RATE);
+    if(p) TEST_CHECK(test_rms(p, frames * 2) > 1000);
+    TEST_CHECK_EQ(bank.loadMemory("text", (const uint8_t*)"no audio in here", 16), SB_ERR_FORMAT);
+    TEST_CHECK_EQ(bank.getStats()->loads, 5);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sb_exact() {
+    // a clip at the bank rate reaches the output sample by sample, mono on both channels
+    AudioMixer mixer;
+    mixer.setSampleRate(SB_TEST_RATE);
+    mixer.setDucking(0);
+    TestBank bank;
+    bank.begin(&mixer, SB_TEST_RATE);
+    std::vector<uint8_t> w = makeWAV(SB_TEST_RATE, 1, 4410, 441);
+    TEST_CHECK_EQ(bank.loadMemory("exact", w.data(), w.size()), SB_OK);
+    TEST_CHECK(bank.play("exact") >= 0);
+    int16_t  buf[256 * 2];
+    uint32_t pos = 0, differ = 0;
+    while(mixer.isActive() && pos < 4410) {
+        memset(buf, 0, sizeof(buf));
+        mixer.mix(buf, 256, 2);
+        for(int i = 0; i < 256 && pos < 4410; i++, pos++) {
+            int16_t ref = (int16_t)test_rd16(&w[44 + 2 * pos]);
+            if(buf[2 * i] != ref || buf[2 * i + 1] != ref) differ++;
+        }
+    }
+    TEST_CHECK_EQ(pos, 4410);
+    TEST_CHECK_EQ(differ, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sb_trigger() {
+    // play(): a lookup and a mixer slot; the same clip decoded on every trigger instead
+    AudioMixer mixer;
+    mixer.setSampleRate(SB_TEST_RATE);
+    TestBank bank;
+    bank.begin(&mixer, SB_TEST_RATE);
+    std::vector<uint8_t> mp3 = test_readFile("Olsen-Banden.mp3");
+    mp3.resize(24 * 1024);
+    TEST_CHECK_EQ(bank.loadMemory("clip", mp3.data(), mp3.size()), SB_OK);
+    std::vector<double> trig;
+    int16_t             buf[128 * 2];
+    for(int k = 0; k < 2000; k++) {
+        double t = nowUs();
+        int8_t id = bank.play("clip");
+        trig.push_back(nowUs() - t);
+        TEST_CHECK(id >= 0);
+        if(id < 0) break;
+        mixer.mix(buf, 128, 2);
+        mixer.stopStream(id);
+        while(mixer.isActive()) mixer.mix(buf, 128, 2);
+    }
+    std::sort(trig.begin(), trig.end());
+    double t = nowUs();
+    for(int k = 0; k < 10; k++) {
+        bank.unload("again");
+        TEST_CHECK_EQ(bank.loadMemory("again", mp3.data(), mp3.size()), SB_OK);
+    }
+    double decodeUs = (nowUs() - t) / 10;
+    printf("trigger: median %.2f us, p99 %.2f us; decoding the clip per trigger %.0f us\n", trig[trig.size() / 2],
+           trig[trig.size() * 99 / 100], decodeUs);
+    TEST_CHECK(trig[trig.size() / 2] * 100 < decodeUs);
+    TEST_CHECK(bank.getStats()->triggerUsMax >= bank.getStats()->triggerUs);
+    TEST_CHECK_EQ(bank.getStats()->hits, 2000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sb_budget() {
+    // 12 clips at 16 ... 48 kHz played with Zipf frequencies, loaded on a miss: the hit rate grows with the budget, the
+    // bank stays within it
+    std::vector<std::vector<uint8_t>> clips;
+    const uint32_t                    rates[] = {16000, 22050, 44100, 48000};
+    uint32_t                          total = 0;
+    for(int i = 0; i < 12; i++) {
+        uint32_t rate = rates[i % 4];
+        uint8_t  ch = 1 + (i % 3 == 0);
+        double   sec = 0.05 + 0.05 * i;
+        clips.push_back(makeWAV(rate, ch, sec * rate, 300 + 50 * i));
+        total += sec * SB_TEST_RATE * 2 * ch;
+    }
+    std::vector<double> w;
+    for(int i = 0; i < 12; i++) w.push_back(1.0 / (i + 1));
+    double last = 0;
+    for(uint32_t budget : {128 * 1024, 256 * 1024, 512 * 1024, 2048 * 1024}) {
+        AudioMixer mixer;
+        mixer.setSampleRate(SB_TEST_RATE);
+        TestBank bank;
+        bank.begin(&mixer, SB_TEST_RATE, budget);
+        std::mt19937                 rng(1);
+        std::discrete_distribution<> zipf(w.begin(), w.end());
+        uint32_t                     maxBytes = 0;
+        uint32_t                     played = 0;
+        for(int k = 0; k < 3000; k++) {
+            int  c = zipf(rng);
+            char name[16];
+            sprintf(name, "clip%d", c);
+            int8_t id = bank.play(name);
+            if(id == SB_ERR_MISS && bank.loadMemory(name, clips[c].data(), clips[c].size()) == SB_OK)
+                id = bank.play(name, MIX_EFFECT, 1.0, false);
+            if(id >= 0) played++;
+            int16_t buf[1024 * 2];
+            for(int j = 0; j < 8; j++) mixer.mix(buf, 1024, 2); // 186 ms between the triggers
+            maxBytes = max(maxBytes, bank.getStats()->bytes);
+        }
+        const sb_stats_t* st = bank.getStats();
+        double            rate = 100.0 * st->hits / (st->hits + st->misses);
+        printf("budget %4u KB (all clips %u KB): hit rate %5.1f %%, %u evictions, %u of 3000 played\n", budget / 1024,
+               total / 1024, rate, st->evictions, played);
+        TEST_CHECK_EQ(st->hits + st->misses, 3000);
+        TEST_CHECK(maxBytes <= budget);
+        TEST_CHECK(played > 2900);                          // else the clips that play fill the budget
+        TEST_CHECK(rate >= last);
+        last = rate;
+    }
+    TEST_CHECK(last > 99.5); // everything fits: a miss per clip
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sb_evict_playing() {
+    // a playing clip is not evicted, it goes once it has been played
+    AudioMixer mixer;
+    mixer.setSampleRate(SB_TEST_RATE);
+    TestBank bank;
+    bank.begin(&mixer, SB_TEST_RATE, 100000);
+    std::vector<uint8_t> a = makeWAV(SB_TEST_RATE, 1, 30000, 440), b = makeWAV(SB_TEST_RATE, 1, 30000, 880);
+    TEST_CHECK_EQ(bank.loadMemory("A", a.data(), a.size()), SB_OK);
+    TEST_CHECK(bank.play("A") >= 0);
+    TEST_CHECK_EQ(bank.loadMemory("B", b.data(), b.size()), SB_ERR_MEMORY);
+    TEST_CHECK(bank.contains("A"));
+    bank.unload("A");                                       // kept while it plays
+    TEST_CHECK(bank.pcm("A"));
+    int16_t buf[2048 * 2];
+    while(mixer.isActive()) mixer.mix(buf, 2048, 2);
+    TEST_CHECK_EQ(bank.loadMemory("B", b.data(), b.size()), SB_OK);
+    TEST_CHECK(!bank.contains("A") && bank.contains("B"));
+    TEST_CHECK_EQ(bank.getStats()->evictions, 1);
+    TEST_CHECK(bank.getStats()->bytes <= 100000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sb_damaged() {
+    // chunk sizes behind the end of the file: 8 + size wraps to 0 and would stay on the chunk, or far beyond; a data
+    // chunk that is longer than the file is cut
+    TestBank bank;
+    bank.begin(NULL, SB_TEST_RATE);
+    std::vector<uint8_t> w = makeWAV(SB_TEST_RATE, 1, 1000, 441);
+    for(uint32_t size : {0xFFFFFFF8u, 0xFFFFFFF0u, 0x80000000u, 0x7FFFFFFFu, 4000u}) {
+        std::vector<uint8_t> d(w.begin(), w.begin() + 36);  // RIFF and fmt
+        d.insert(d.end(), {'j', 'u', 'n', 'k'});
+        wr32(d, size);
+        d.insert(d.end(), w.begin() + 36, w.end());         // behind it the data chunk
+        TEST_CHECK_EQ(bank.loadMemory("damaged", d.data(), d.size()), SB_ERR_FORMAT);
+    }
+    std::vector<uint8_t> d = w;
+    d[40] = 0xFF, d[41] = 0xFF, d[42] = 0xFF, d[43] = 0xFF;
+    TEST_CHECK_EQ(bank.loadMemory("cut", d.data(), d.size()), SB_OK);
+    uint32_t frames = 0;
+    TEST_CHECK(bank.pcm("cut", &frames));
+    TEST_CHECK_EQ(frames, 1000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// connecttoFS() reports the file under mutex_audio: the audio task is busy meanwhile
+static std::function<void()> s_whileBusy;
+void audio_info(const char* info) {
+    if(s_whileBusy && !strncmp(info, "Reading file", 12)) s_whileBusy();
+}
+static void test_sb_load_while_playing() {
+    // a WAV clip is decoded in another task while mutex_audio is held, play() does not decode on a miss; an MP3 clip
+    // waits while the music uses the MP3 decoder
+    char dir[] = "/tmp/test_sound_bankXXXXXX";
+    TEST_CHECK(mkdtemp(dir));
+    fs::FS               clips(dir);
+    std::vector<uint8_t> big = makeWAV(22050, 1, 120000, 523), small = makeWAV(SB_TEST_RATE, 1, 4410, 1000);
+    std::vector<uint8_t> mp3 = test_readFile("Olsen-Banden.mp3");
+    mp3.resize(24 * 1024);
+    const std::pair<const char*, const std::vector<uint8_t>*> files[] = {{"/big.wav", &big}, {"/small.wav", &small},
+                                                                         {"/clip.mp3", &mp3}};
+    for(const auto& f : files) {
+        FILE* fp = fopen((std::string(dir) + f.first).c_str(), "wb");
+        fwrite(f.second->data(), 1, f.second->size(), fp);
+        fclose(fp);
+    }
+
+    Audio audio;
+    audio.getSoundBank()->setBudget(2 * 1024 * 1024);
+    TEST_CHECK_EQ(audio.loadSound(clips, "/small.wav"), SB_OK);
+    double t = nowUs();
+    TEST_CHECK_EQ(audio.playSound("/big.wav"), SB_ERR_MISS);   // not decoded on the trigger
+    double missUs = nowUs() - t;
+
+    std::atomic<bool> done(false);
+    std::thread       loader;
+    int8_t            res = SB_ERR_MISS;
+    double            loadUs = 0, heldUs = 0;
+    s_whileBusy = [&]() {
+        t = nowUs();
+        loader = std::thread([&]() {
+            res = audio.loadSound(clips, "/big.wav");
+            loadUs = nowUs() - t;
+            done = true;
+        });
+        while(!done && nowUs() - t < 2000000) vTaskDelay(1);
+        heldUs = nowUs() - t;
+    };
+    TEST_CHECK(audio.connecttoFS(s_card, "/Olsen-Banden.mp3"));
+    s_whileBusy = NULL;
+    loader.join();
+    printf("playSound() on a miss %.1f us; loadSound() of a %zu KB WAV %.0f us while mutex_audio is held\n", missUs,
+           big.size() / 1024, loadUs);
+    TEST_CHECK(done && heldUs < 2000000);                     // under mutex_audio it would wait for connecttoFS()
+    TEST_CHECK_EQ(res, SB_OK);
+    TEST_CHECK(missUs < 1000);
+
+    // the MP3 decoder plays the music: the MP3 clip waits, the WAV clips play
+    i2s_chan_handle_t tx = i2s_host_tx;
+    for(int i = 0; i < 20; i++) {
+        audio.loop();
+        i2s_host_play(tx, 256);
+    }
+    TEST_CHECK(audio.isRunning());
+    TEST_CHECK_EQ(audio.loadSound(clips, "/clip.mp3"), SB_ERR_BUSY);
+    TEST_CHECK(audio.playSound("/big.wav") >= 0);
+    TEST_CHECK(audio.playSound("/small.wav") >= 0);
+    TEST_CHECK(audio.connecttoFS(s_card, "/Pink-Panther.wav"));
+    TEST_CHECK_EQ(audio.loadSound(clips, "/clip.mp3"), SB_OK);
+    TEST_CHECK(audio.playSound("/clip.mp3") >= 0);
+    for(int i = 0; i < 20; i++) {
+        audio.loop();
+        i2s_host_play(tx, 256);
+    }
+    TEST_CHECK(audio.isRunning());
+
+    for(const auto& f : files) remove((std::string(dir) + f.first).c_str());
+    rmdir(dir);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_sb_formats);
+    RUN_TEST(test_sb_exact);
+    RUN_TEST(test_sb_trigger);
+    RUN_TEST(test_sb_budget);
+    RUN_TEST(test_sb_evict_playing);
+    RUN_TEST(test_sb_damaged);
+    RUN_TEST(test_sb_load_while_playing);
+    return s_testFailures;
+}
@@ -0,0 +1,221 @@
+/*
+ * test_speech.cpp
+ * Audio::connecttospeech() against a stand-in translate_tts server on 127.0.0.1: the text goes sentence by sentence,
+ * the sentences behind the first one are loaded while it plays and follow it gaplessly; time to the first sample and
+ * the gaps, compared with one connecttospeech() per sentence as an app did it before; sentences whose first bytes come
+ * in short reads
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "test_server.h"
+#include "Audio.h"
+
+#define SP_FRAMES  25      // mp3 frames of one sentence, 0.65 s
+#define SP_LAT_MS  200     // synthesis: latency of the server, and 2 ms per character
+#define SP_RATE    32768   // bytes/s of the body
+#define SP_HOST    "translate.google.com.vn"
+
+static std::vector<std::string> s_sentences;  // as connecttospeech() should split the text
+static std::vector<std::string> s_bodies;     // ID3 tag and the next SP_FRAMES frames of Olsen-Banden.mp3
+static std::vector<std::string> s_requested;
+static std::mutex               s_reqLock;
+static Audio                    s_audio;      // one for all runs: the task of its m_hls goes on running on the host
+static uint32_t                 s_headMs = 0; // the bodies behind the first one begin with 3 and 4 bytes, this far apart
+
+static std::string urldecode(const std::string& s) {
+    std::string out;
+    for(size_t i = 0; i < s.size(); i++) {
+        if(s[i] == '%' && i + 2 < s.size()) {
+            out += (char)strtoul(s.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+        }
+        else out += s[i] == '+' ? ' ' : s[i];
+    }
+    return out;
+}
+static bool tts(int fd, const Test_Request& r) {
+    size_t      q = r.path.find("&q=");
+    std::string text = q == std::string::npos ? "" : urldecode(r.path.substr(q + 3));
+    size_t      i = 0;
+    while(i < s_sentences.size() && s_sentences[i] != text) i++;
+    {
+        std::lock_guard<std::mutex> lock(s_reqLock);
+        s_requested.push_back(text);
+    }
+    bool keepAlive = r.header.find("Connection: close") == std::string::npos;
+    if(i == s_sentences.size()) return test_sendHeader(fd, 404, 0) && keepAlive;
+    test_sleep(SP_LAT_MS + 2 * text.size());
+    const std::string& b = s_bodies[i];
+    if(!test_sendHeader(fd, 200, b.size(), "Content-Type: audio/mpeg\r\n")) return false;
+    size_t             k = 0;
+    for(size_t piece : {3, 4}) { // m_hls has these first, short reads of the ID3 header
+        if(!s_headMs || !i) break;
+        if(!test_send(fd, b.substr(k, piece))) return false;
+        k += piece;
+        test_sleep(s_headMs);
+    }
+    for(; k < b.size(); k += 4096) {
+        if(!test_send(fd, b.substr(k, 4096))) return false;
+        test_sleep(4096 * 1000 / SP_RATE);
+    }
+    return keepAlive;
+}
+// the ID3 tag of the file and the frame positions behind it; the bodies go without the first frame (LAME tag), a file
+// with it would be trimmed to the encoder delay and padding, a speech is not
+static std::string mp3Frames(std::vector<uint32_t>* pos) {
+    static const uint16_t br[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+    static const uint32_t sr[4] = {44100, 48000, 32000, 0};
+    std::vector<uint8_t>  d = test_readFile("Olsen-Banden.mp3");
+    uint32_t              p = 0;
+    if(d.size() > 10 && !memcmp(d.data(), "ID3", 3))
+        p = 10 + ((d[6] & 0x7F) << 21 | (d[7] & 0x7F) << 14 | (d[8] & 0x7F) << 7 | (d[9] & 0x7F));
+    std::string id3(d.begin(), d.begin() + p);
+    while(p + 4 <= d.size() && d[p] == 0xFF && (d[p + 1] & 0xE0) == 0xE0 && sr[(d[p + 2] >> 2) & 3]) {
+        pos->push_back(p);
+        p += 144000 * br[d[p + 2] >> 4] / sr[(d[p + 2] >> 2) & 3] + ((d[p + 2] >> 1) & 1);
+    }
+    pos->push_back(p);
+    s_bodies.clear();
+    for(size_t i = 0; i < s_sentences.size(); i++) {
+        uint32_t a = (*pos)[1 + i * SP_FRAMES], b = (*pos)[1 + (i + 1) * SP_FRAMES]; // not the LAME tag frame
+        s_bodies.push_back(id3 + std::string(d.begin() + a, d.begin() + b));
+    }
+    return id3;
+}
+
+typedef struct {
+    uint32_t firstSample;  // ms after connecttospeech()
+    uint32_t gapMs;        // silence between the first and the last sample
+    uint32_t gaps;
+    uint32_t doneMs;
+} sp_run_t;
+
+// the DMA plays in real time, loop() every ms; pipelined: the whole text at once, else one sentence after the other
+static std::vector<uint8_t> run(const std::string& text, bool pipelined, size_t refBytes, sp_run_t* r) {
+    i2s_chan_handle_t tx = i2s_host_tx;
+    {
+        std::lock_guard<std::mutex> lock(tx->lock);
+        tx->played.clear();
+    }
+    *r = {};
+    uint32_t t0 = millis(), playedFrames = 0;
+    size_t   next = 0;
+    bool     inGap = false;
+    if(pipelined) TEST_CHECK(s_audio.connecttospeech(text.c_str(), "en"));
+    else TEST_CHECK(s_audio.connecttospeech(s_sentences[next++].c_str(), "en"));
+    while(millis() - t0 < 20000) {
+        s_audio.loop();
+        if(!s_audio.isRunning()) {
+            if(next == 0 || next == s_sentences.size()) break;
+            TEST_CHECK(s_audio.connecttospeech(s_sentences[next++].c_str(), "en")); // in audio_eof_speech()
+        }
+        uint32_t due = (millis() - t0) * 441 / 10 - playedFrames;
+        for(uint32_t k = 0; k < due; k++) {
+            size_t before = tx->played.size();
+            i2s_host_play(tx, 1);
+            playedFrames++;
+            if(!r->firstSample && tx->played.size()) r->firstSample = millis() - t0;
+            bool gap = tx->played.size() == before && before && before < refBytes;
+            if(gap) r->gapMs++;  // in frames for now
+            if(gap && !inGap) r->gaps++;
+            inGap = gap;
+        }
+        vTaskDelay(1);
+    }
+    r->doneMs = millis() - t0;
+    r->gapMs = r->gapMs * 10 / 441;
+    TEST_CHECK(!s_audio.isRunning());
+    i2s_host_play(tx, i2s_host_capacity(tx) / 4); // the rest of the DMA buffers
+    return tx->played;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_sp_sentences() {
+    Test_Server srv(tts);
+    WiFiClient::s_localHosts[SP_HOST] = srv.port();
+
+    std::string longOne = "Others are a little longer, because the model keeps talking about the weather and the news of "
+                          "the day, about the traffic in the city and the football results of the weekend, and about "
+                          "the prices in the shops nearby";
+    std::string cut = longOne.substr(0, longOne.rfind(' ', 179) + 1); // at the last blank in front of 180 bytes
+    s_sentences = {"Hello, this is the answer of the assistant.", "It comes in several sentences!", "Some are short.",
+                   cut, longOne.substr(cut.size()) + ".", "Do you want to know more?"};
+    std::string text = s_sentences[0];
+    for(size_t i = 1; i < s_sentences.size(); i++) text += (i == 4 ? "" : i == 5 ? "\n" : " ") + s_sentences[i];
+    std::vector<uint32_t> pos;
+    std::string           id3 = mp3Frames(&pos);
+    TEST_CHECK(pos.size() > s_sentences.size() * SP_FRAMES + 1);
+
+    // the reference: the same frames in one file
+    char dir[] = "/tmp/test_speechXXXXXX";
+    TEST_CHECK(mkdtemp(dir));
+    FILE* f = fopen((std::string(dir) + "/speech.mp3").c_str(), "wb");
+    fwrite(id3.data(), 1, id3.size(), f);
+    for(const std::string& b : s_bodies) fwrite(b.data() + id3.size(), 1, b.size() - id3.size(), f);
+    fclose(f);
+    fs::FS card(dir);
+    i2s_chan_handle_t tx = i2s_host_tx;
+    TEST_CHECK(s_audio.connecttoFS(card, "/speech.mp3"));
+    for(int i = 0; i < 100000 && s_audio.isRunning(); i++) {
+        s_audio.loop();
+        i2s_host_play(tx, 512);
+    }
+    i2s_host_play(tx, i2s_host_capacity(tx) / 4);
+    std::vector<uint8_t> ref = tx->played;
+    remove((std::string(dir) + "/speech.mp3").c_str());
+    rmdir(dir);
+    TEST_CHECK_EQ(ref.size(), s_sentences.size() * SP_FRAMES * 1152 * 4); // every frame, the last one as well
+
+    // pipelined: every sentence is requested once, in order, the first on its own connection, the others over one
+    // keep-alive connection of m_hls; the samples are those of the file, without a gap
+    sp_run_t             pl, seq;
+    uint32_t             connects = srv.connections;
+    std::vector<uint8_t> out = run(text, true, ref.size(), &pl);
+    TEST_CHECK(s_requested == s_sentences);
+    TEST_CHECK(srv.connections - connects <= 2);
+    TEST_CHECK_EQ(out.size(), ref.size());
+    TEST_CHECK(out == ref);
+    // the first sample: the latency of the server, the body of two frames, a few ms for the rest
+    TEST_CHECK(pl.firstSample < SP_LAT_MS + 2 * s_sentences[0].size() + 200);
+
+    // one connecttospeech() per sentence waits for the synthesis of each
+    s_requested.clear();
+    out = run(text, false, ref.size(), &seq);
+    TEST_CHECK(s_requested == s_sentences);
+    TEST_CHECK(seq.gaps >= s_sentences.size() - 1);
+    TEST_CHECK(seq.gapMs > (s_sentences.size() - 1) * SP_LAT_MS / 2); // less what the DMA buffers hold
+
+    // the sentences behind the first one come in short pieces first, the decoder waits at their start: the header of
+    // the ID3 tag is collected before it is cut out, and the first bytes of a body without a tag are kept. The tag holds
+    // a PRIV frame that looks like audio, one frame of the file
+    std::string frame = "test" + std::string(1, '\0') + s_bodies[0].substr(id3.size(), pos[2] - pos[1]);
+    std::string tag = "ID3" + std::string("\3\0\0", 3) + std::string(4, '\0') + "PRIV" + std::string(6, '\0') + frame;
+    for(int k = 0; k < 4; k++) {
+        tag[9 - k] = (char)(((tag.size() - 10) >> (7 * k)) & 0x7F);
+        tag[17 - k] = (char)(frame.size() >> (8 * k));
+    }
+    for(std::string& b : s_bodies) b = tag + b.substr(id3.size());
+    s_headMs = 400;
+    sp_run_t pieces;
+    out = run(text, true, ref.size(), &pieces);
+    TEST_CHECK(pieces.gaps >= s_sentences.size() - 1);
+    TEST_CHECK(out == ref);
+    for(std::string& b : s_bodies) b.erase(0, tag.size());
+    out = run(text, true, ref.size(), &pieces);
+    TEST_CHECK(pieces.gaps >= s_sentences.size() - 1);
+    TEST_CHECK(out == ref);
+    s_headMs = 0;
+
+    printf("%zu sentences, %u ms of speech\n", s_sentences.size(), (unsigned)(ref.size() / 4 * 10 / 441));
+    printf("pipelined:  first sample after %u ms, %u gaps (%u ms), done after %u ms\n", pl.firstSample, pl.gaps,
+           pl.gapMs, pl.doneMs);
+    printf("sequential: first sample after %u ms, %u gaps (%u ms), done after %u ms\n", seq.firstSample, seq.gaps,
+           seq.gapMs, seq.doneMs);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_sp_sentences);
+    fflush(stdout);
+    _exit(s_testFailures); // the task of m_hls is still running
+}
@@ -0,0 +1,305 @@
+/*
+ * test_ts_demuxer.cpp
+ * AudioTSDemuxer with synthetic transport streams: PAT, a PMT with a video and two ADTS streams, read in random
+ * pieces into a buffer as processWebStreamTS() does. Clean stream, lost packets (continuity errors), garbage between
+ * packets (lost sync), the second stream selected, InBuff resized with a packet pending; throughput in MB/s
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "ts_demuxer/ts_demuxer.h"
+#include "Audio.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#define PID_PMT    0x1000
+#define PID_VIDEO  0x100
+#define PID_AUDIO1 0x101
+#define PID_AUDIO2 0x102
+
+typedef struct {
+    uint16_t             pid;
+    int                  pes;       // PES packet number, -1: section
+    std::vector<uint8_t> payload;   // audio bytes in this packet (the PES header cut out)
+} ts_meta_t;
+
+static std::mt19937 s_rng(1);
+static uint8_t      s_cc[8192];
+
+// one PES packet of an elementary stream in TS packets, the last one padded with an adaptation field
+static void packetize(std::vector<uint8_t>& ts, std::vector<ts_meta_t>& meta, uint16_t pid, int pes, const std::vector<uint8_t>& es) {
+    uint8_t              h[14] = {0, 0, 1, 0xC0, 0, 0, 0x80, 0x80, 5, 0x21, 0, 1, 0, 1}; // PTS only
+    uint16_t             pesLen = es.size() + 8;
+    std::vector<uint8_t> d(h, h + 14);
+    d[4] = pesLen >> 8;
+    d[5] = pesLen;
+    d.insert(d.end(), es.begin(), es.end());
+    for(size_t pos = 0; pos < d.size();) {
+        uint8_t p[TS_PACKET_SIZE];
+        size_t  n = std::min<size_t>(184, d.size() - pos);
+        int     hl = 4;
+        p[0] = TS_SYNC_BYTE;
+        p[1] = (pos == 0 ? 0x40 : 0) | (pid >> 8);
+        p[2] = pid;
+        if(n < 184) {
+            int af = 183 - n;
+            p[3] = 0x30 | s_cc[pid];
+            p[4] = af;
+            if(af) {
+                p[5] = 0;
+                memset(p + 6, 0xFF, af - 1);
+            }
+            hl = 5 + af;
+        }
+        else p[3] = 0x10 | s_cc[pid];
+        s_cc[pid] = (s_cc[pid] + 1) & 15;
+        memcpy(p + hl, &d[pos], n);
+        ts_meta_t m = {pid, pes, {}};
+        if(pos + n > 14) m.payload.assign(d.begin() + std::max<size_t>(pos, 14), d.begin() + pos + n);
+        ts.insert(ts.end(), p, p + TS_PACKET_SIZE);
+        meta.push_back(m);
+        pos += n;
+    }
+}
+static void section(std::vector<uint8_t>& ts, std::vector<ts_meta_t>& meta, uint16_t pid, const std::vector<uint8_t>& sec) {
+    uint8_t p[TS_PACKET_SIZE];
+    memset(p, 0xFF, sizeof(p));
+    p[0] = TS_SYNC_BYTE;
+    p[1] = 0x40 | (pid >> 8);
+    p[2] = pid;
+    p[3] = 0x10 | s_cc[pid];
+    s_cc[pid] = (s_cc[pid] + 1) & 15;
+    p[4] = 0; // pointer field
+    memcpy(p + 5, sec.data(), sec.size());
+    ts.insert(ts.end(), p, p + TS_PACKET_SIZE);
+    meta.push_back({pid, -1, {}});
+}
+static const std::vector<uint8_t> s_pat = {0x00, 0xB0, 13, 0, 1, 0xC1, 0, 0, 0, 1, 0xF0, 0x00, 0, 0, 0, 0};
+static const std::vector<uint8_t> s_pmt2 = {0x02, 0xB0, 13 + 15, 0, 1, 0xC1, 0, 0, 0xE1, 0x00, 0xF0, 0x00,  // PCR PID
+                                            0x1B, 0xE1, 0x00, 0xF0, 0,      // H.264
+                                            0x0F, 0xE1, 0x01, 0xF0, 0,      // ADTS
+                                            0x0F, 0xE1, 0x02, 0xF0, 0,      // ADTS
+                                            0, 0, 0, 0};
+static const std::vector<uint8_t> s_pmt1 = {0x02, 0xB0, 13 + 5, 0, 1, 0xC1, 0, 0, 0xE1, 0x01, 0xF0, 0x00,
+                                            0x0F, 0xE1, 0x01, 0xF0, 0, 0, 0, 0, 0};
+static std::vector<uint8_t> adtsFrame(uint16_t pid, int k) {
+    std::vector<uint8_t> f(200 + s_rng() % 600);
+    f[0] = 0xFF;
+    f[1] = 0xF1;
+    for(size_t i = 2; i < f.size(); i++) f[i] = (pid * 7 + k * 13 + i) & 0xFF;
+    return f;
+}
+// 20 segments of PAT, PMT and 30 groups of three PES packets: 3 ADTS frames, 1 ADTS frame, video
+static void buildStream(std::vector<uint8_t>& ts, std::vector<ts_meta_t>& meta) {
+    memset(s_cc, 0, sizeof(s_cc));
+    int pes = 0;
+    for(int seg = 0; seg < 20; seg++) {
+        section(ts, meta, 0, s_pat);
+        section(ts, meta, PID_PMT, s_pmt2);
+        for(int k = 0; k < 30; k++) {
+            std::vector<uint8_t> es;
+            for(int j = 0; j < 3; j++) {
+                std::vector<uint8_t> f = adtsFrame(PID_AUDIO1, k);
+                es.insert(es.end(), f.begin(), f.end());
+            }
+            packetize(ts, meta, PID_AUDIO1, pes++, es);
+            packetize(ts, meta, PID_AUDIO2, pes++, adtsFrame(PID_AUDIO2, k));
+            packetize(ts, meta, PID_VIDEO, pes++, std::vector<uint8_t>(1000, 0xAB));
+        }
+    }
+}
+enum { TS_CLEAN, TS_LOST, TS_GARBAGE, TS_SELECT };
+
+// the demuxer output must equal the payload of the wanted stream without the PES packets that lost bytes
+static void runMode(int mode) {
+    std::vector<uint8_t>   ts;
+    std::vector<ts_meta_t> meta;
+    buildStream(ts, meta);
+    uint16_t want = mode == TS_SELECT ? PID_AUDIO2 : PID_AUDIO1;
+
+    std::vector<bool>   lost(meta.size(), false);
+    std::vector<size_t> garbageAt;
+    uint32_t            nLost = 0;
+    if(mode == TS_LOST) {
+        for(int i = 0; i < 40; i++) {
+            size_t j = s_rng() % meta.size();
+            if(meta[j].pid == want && !lost[j]) { lost[j] = true; nLost++; }
+        }
+    }
+    if(mode == TS_GARBAGE) for(int i = 0; i < 20; i++) garbageAt.push_back(2 + s_rng() % (meta.size() - 2));
+    std::sort(garbageAt.begin(), garbageAt.end());
+
+    std::vector<uint8_t> in, expect;
+    int    lostPes = -99, lastPes = -99;
+    size_t g = 0;
+    for(size_t i = 0; i < meta.size(); i++) {
+        for(; g < garbageAt.size() && garbageAt[g] == i; g++) { // the PES that is running loses its rest
+            for(int b = 0; b < 50; b++) {
+                uint8_t c = s_rng();
+                in.push_back(c == TS_SYNC_BYTE ? 0x48 : c);
+            }
+            lostPes = lastPes;
+        }
+        if(lost[i]) { lostPes = meta[i].pes; continue; }
+        in.insert(in.end(), ts.begin() + i * TS_PACKET_SIZE, ts.begin() + (i + 1) * TS_PACKET_SIZE);
+        if(meta[i].pid != want) continue;
+        lastPes = meta[i].pes;
+        if(meta[i].pes != lostPes) expect.insert(expect.end(), meta[i].payload.begin(), meta[i].payload.end());
+    }
+
+    // random reads behind the pending bytes, as processWebStreamTS() reads into InBuff
+    AudioTSDemuxer       d;
+    std::vector<uint8_t> buf(in.size() + 4096);
+    size_t               wp = 0, rp = 0;
+    if(mode == TS_SELECT) { // PAT and PMT first, then the second audio stream
+        memcpy(&buf[0], &in[0], 2 * TS_PACKET_SIZE);
+        TEST_CHECK_EQ(d.demux(&buf[0], 2 * TS_PACKET_SIZE), 0);
+        rp = 2 * TS_PACKET_SIZE;
+        const ts_stream_t* st;
+        TEST_CHECK_EQ(d.getStreams(&st), 2);         // the video is not an audio stream
+        TEST_CHECK_EQ(st[1].pid, PID_AUDIO2);
+        TEST_CHECK(d.selectStream(1));
+        TEST_CHECK(!d.selectStream(2));
+    }
+    while(rp < in.size()) {
+        size_t   n = std::min<size_t>(1 + s_rng() % 3000, in.size() - rp);
+        uint16_t pend = d.pending();
+        memcpy(&buf[wp + pend], &in[rp], n);
+        rp += n;
+        wp += d.demux(&buf[wp], pend + n);
+    }
+    TEST_CHECK_EQ(wp, expect.size());
+    TEST_CHECK(wp == expect.size() && !memcmp(buf.data(), expect.data(), wp));
+    TEST_CHECK_EQ(d.getStreamType(), TS_ST_AAC_ADTS);
+    const ts_stats_t* s = d.getStats();
+    TEST_CHECK_EQ(s->payloadBytes, expect.size());
+    if(mode == TS_LOST) {
+        TEST_CHECK_EQ(s->ccErrors, nLost);
+        TEST_CHECK(s->pesDropped >= 1 && s->pesDropped <= nLost);
+    }
+    if(mode == TS_GARBAGE) TEST_CHECK(s->syncLosses >= 1 && s->syncLosses <= 20);
+    if(mode == TS_CLEAN) {
+        TEST_CHECK_EQ(s->packets, in.size() / TS_PACKET_SIZE);
+        TEST_CHECK_EQ(s->ccErrors + s->syncLosses + s->pesDropped, 0);
+    }
+}
+static void test_ts_clean() { runMode(TS_CLEAN); }
+static void test_ts_lost() { runMode(TS_LOST); }
+static void test_ts_garbage() { runMode(TS_GARBAGE); }
+static void test_ts_select() { runMode(TS_SELECT); }
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ts_resize() {
+    // InBuff is resized while a packet is pending behind the write pointer (Audio::adaptInBuff()): the bytes move
+    // with the stored data, no continuity error and no PES packet lost
+    std::vector<uint8_t>   ts;
+    std::vector<ts_meta_t> meta;
+    buildStream(ts, meta);
+    std::vector<uint8_t> expect, out;
+    for(const ts_meta_t& m : meta) {
+        if(m.pid == PID_AUDIO1) expect.insert(expect.end(), m.payload.begin(), m.payload.end());
+    }
+    AudioTSDemuxer d;
+    AudioBuffer    buf;
+    buf.init(BH_MIN_SIZE);
+    const size_t sizes[] = {9000, 20011, 12345, 40000, 8500};
+    uint32_t     resizes = 0, withPending = 0;
+    size_t       rp = 0;
+    for(int k = 0; rp < ts.size(); k++) { // as processWebStreamTS() and a decoder that leaves a byte at least
+        uint16_t pend = d.pending();
+        uint8_t* wp = buf.getWritePtr();
+        uint32_t ws = buf.writeSpace();
+        size_t   filled = buf.bufferFilled();
+        if(filled > 1 && (s_rng() & 1)) {
+            size_t n = std::min<size_t>({1 + s_rng() % 3000, filled - 1, buf.getBytesToEnd()});
+            out.insert(out.end(), buf.getReadPtr(), buf.getReadPtr() + n);
+            buf.bytesWasRead(n);
+        }
+        else if(ws >= pend + 2 * TS_PACKET_SIZE) {
+            size_t n = std::min<size_t>({1 + s_rng() % 2000, ts.size() - rp, ws - pend});
+            memcpy(wp + pend, &ts[rp], n);
+            rp += n;
+            buf.bytesWritten(d.demux(wp, pend + n));
+        }
+        else if(buf.freeSpace() > pend + TS_PACKET_SIZE) { // end of the ring, one packet in two parts
+            uint8_t pkt[TS_PACKET_SIZE];
+            size_t  n = std::min<size_t>(TS_PACKET_SIZE - pend, ts.size() - rp);
+            memcpy(pkt, wp, pend);
+            memcpy(pkt + pend, &ts[rp], n);
+            rp += n;
+            d.dropPending();
+            uint32_t len = d.demux(pkt, pend + n);
+            size_t   part = std::min<size_t>(len, buf.writeSpace());
+            memcpy(buf.getWritePtr(), pkt, part);
+            buf.bytesWritten(part);
+            memcpy(buf.getWritePtr(), pkt + part, len - part);
+            buf.bytesWritten(len - part);
+        }
+        if(k % 7 == 3) {
+            bool f_pending = d.pending() > 0;
+            if(buf.resize(sizes[resizes % 5], resizes & 1, d.pending())) {
+                resizes++;
+                withPending += f_pending;
+            }
+        }
+    }
+    while(buf.bufferFilled()) {
+        size_t n = std::min<size_t>(buf.bufferFilled(), buf.getBytesToEnd());
+        out.insert(out.end(), buf.getReadPtr(), buf.getReadPtr() + n);
+        buf.bytesWasRead(n);
+    }
+    printf("%u resizes, %u of them with a pending packet\n", resizes, withPending);
+    TEST_CHECK(resizes > 20 && withPending > 10);
+    TEST_CHECK_EQ(d.getStats()->ccErrors, 0);
+    TEST_CHECK_EQ(d.getStats()->pesDropped, 0);
+    TEST_CHECK_EQ(out.size(), expect.size());
+    TEST_CHECK(out == expect);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ts_throughput() {
+    // 20 MB, one audio stream, demuxed in 64 KB reads
+    memset(s_cc, 0, sizeof(s_cc));
+    std::vector<uint8_t>   ts;
+    std::vector<ts_meta_t> meta;
+    for(int pes = 0; ts.size() < 20 * 1000 * 1000;) {
+        section(ts, meta, 0, s_pat);
+        section(ts, meta, PID_PMT, s_pmt1);
+        for(int k = 0; k < 30; k++) {
+            std::vector<uint8_t> es;
+            for(int j = 0; j < 3; j++) {
+                std::vector<uint8_t> f = adtsFrame(PID_AUDIO1, k);
+                es.insert(es.end(), f.begin(), f.end());
+            }
+            packetize(ts, meta, PID_AUDIO1, pes++, es);
+        }
+    }
+    std::vector<uint8_t> payload;
+    for(const ts_meta_t& m : meta) payload.insert(payload.end(), m.payload.begin(), m.payload.end());
+    size_t expect = payload.size();
+    AudioTSDemuxer       d;
+    std::vector<uint8_t> buf(ts.size());
+    size_t               out = 0;
+    double               s = 0;
+    for(size_t i = 0; i < ts.size(); i += 65536) {
+        size_t   n = std::min<size_t>(65536, ts.size() - i);
+        uint16_t pend = d.pending();
+        memcpy(&buf[out + pend], &ts[i], n); // the socket read behind the pending bytes, not timed
+        auto t0 = std::chrono::steady_clock::now();
+        out += d.demux(&buf[out], pend + n);
+        s += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    printf("demux %.1f MB in %.1f ms, %.0f MB/s\n", ts.size() / 1e6, s * 1000, ts.size() / 1e6 / s);
+    TEST_CHECK_EQ(out, expect);
+    TEST_CHECK(!memcmp(buf.data(), payload.data(), out));
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_ts_clean);
+    RUN_TEST(test_ts_lost);
+    RUN_TEST(test_ts_garbage);
+    RUN_TEST(test_ts_select);
+    RUN_TEST(test_ts_resize);
+    RUN_TEST(test_ts_throughput);
+    return s_testFailures;
+}
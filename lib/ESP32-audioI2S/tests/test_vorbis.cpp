@@ -0,0 +1,61 @@
+/*
+ * test_vorbis.cpp
+ * Vorbis decoder: Collide.ogg decodes to the same PCM as the reference decoder
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ *
+ *  the expected hash was taken from the decoder before the codeword lookup tables, the decoder is
+ *  fixed-point (Tremor), so the output is bit exact on every host
+ */
+#include "test_common.h"
+#include "vorbis_decoder/vorbis_decoder.h"
+
+#define VORBIS_FILE       "Collide.ogg"
+#define VORBIS_PCM_HASH   0x435CBF4E
+#define VORBIS_PCM_FRAMES 1236672   // 28.04 s at 44.1 kHz
+
+//----------------------------------------------------------------------------------------------------------------------
+static void test_vorbis_decode() {
+    std::vector<uint8_t> d = test_readFile(VORBIS_FILE);
+    size_t total = d.size();
+    d.resize(total + 8192, 0);
+    TEST_CHECK(VORBISDecoder_AllocateBuffers());
+    VORBISsetDefaults();
+    static int16_t out[16384];
+    uint32_t hash = 2166136261UL;
+    uint64_t frames = 0;
+    uint32_t errors = 0;
+    size_t   pos = 0;
+    bool     playing = false;
+    while(pos < total) {
+        int len = min(total - pos, (size_t)8192);
+        if(!playing) {
+            int sync = VORBISFindSyncWord(&d[pos], len);
+            if(sync < 0) { pos += len; continue; }
+            pos += sync;
+            playing = true;
+            continue;
+        }
+        int bytesLeft = len;
+        int ret = VORBISDecode(&d[pos], &bytesLeft, out);
+        if(ret < 0) { errors++; playing = false; pos++; continue; }
+        pos += len - bytesLeft;
+        if(ret == VORBIS_PARSE_OGG_DONE) continue;
+        uint16_t n = VORBISGetOutputSamps(); // stereo frames
+        if(n) {
+            hash = test_fnv(out, n * 2 * sizeof(int16_t), hash);
+            frames += n;
+        }
+    }
+    TEST_CHECK_EQ(errors, 0);
+    TEST_CHECK_EQ(VORBISGetSampRate(), 44100);
+    TEST_CHECK_EQ(frames, VORBIS_PCM_FRAMES);
+    TEST_CHECK_EQ(hash, VORBIS_PCM_HASH);
+    VORBISDecoder_FreeBuffers();
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_vorbis_decode);
+    return s_testFailures;
+}
@@ -0,0 +1,95 @@
+/*
+ * test_wav_passthrough.cpp
+ * Audio with 16 bit stereo WAV files: passthrough from InBuff to the DMA buffers, the output is the data chunk at
+ * full volume and the data chunk with one gain per channel below, every frame once, in blocks and not frame by frame
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Audio.h"
+
+#define PT_INBUFF 40002 // not a multiple of 4: frames are split at the end of the ring
+
+static fs::FS s_card(TESTFILES_DIR);
+
+// the data chunk of a WAV file
+static std::vector<uint8_t> wavData(const char* name) {
+    std::vector<uint8_t> d = test_readFile(name);
+    for(size_t pos = 12; pos + 8 <= d.size();) {
+        uint32_t size = d[pos + 4] | d[pos + 5] << 8 | d[pos + 6] << 16 | (uint32_t)d[pos + 7] << 24;
+        if(!memcmp(&d[pos], "data", 4)) return std::vector<uint8_t>(d.begin() + pos + 8, d.begin() + pos + 8 + size);
+        pos += 8 + size + (size & 1);
+    }
+    return {};
+}
+// plays the file; the DMA sends a buffer after every loop(), as fast as the file is read
+static std::vector<uint8_t> play(const char* name, uint8_t volume, uint32_t* writes, uint16_t* vu) {
+    Audio audio;
+    audio.setBufsize(-1, PT_INBUFF);
+    audio.setVolume(volume);
+    i2s_chan_handle_t tx = i2s_host_tx;
+    TEST_CHECK(audio.connecttoFS(s_card, (std::string("/") + name).c_str()));
+    *vu = 0;
+    for(int i = 0; i < 100000 && audio.isRunning(); i++) {
+        audio.loop();
+        *vu = max(*vu, audio.getVUlevel());
+        i2s_host_play(tx, 512);
+    }
+    TEST_CHECK(!audio.isRunning());
+    i2s_host_play(tx, i2s_host_capacity(tx) / 4); // the rest of the DMA buffers
+    *writes = tx->writes;
+    return tx->played;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_pt_unity(const char* name) {
+    std::vector<uint8_t> ref = wavData(name);
+    TEST_CHECK(ref.size() > 100000);
+    uint32_t writes;
+    uint16_t vu;
+    std::vector<uint8_t> out = play(name, 21, &writes, &vu);
+    TEST_CHECK_EQ(out.size(), ref.size());    // every frame, the last one as well
+    TEST_CHECK(out == ref);                   // byte-identical
+    TEST_CHECK(writes < ref.size() / 4 / 64); // blocks, not one write per frame
+    TEST_CHECK(vu > 0);
+}
+static void test_pt_unity_all() {
+    test_pt_unity("test_16bit_stereo.wav");   // LIST chunk in front of the data
+    test_pt_unity("Pink-Panther.wav");
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_pt_gain() {
+    // below full volume every sample of a channel is scaled by the same factor and truncated, once
+    std::vector<uint8_t> ref = wavData("Pink-Panther.wav");
+    uint32_t writes;
+    uint16_t vu;
+    std::vector<uint8_t> out = play("Pink-Panther.wav", 12, &writes, &vu);
+    TEST_CHECK_EQ(out.size(), ref.size());
+    if(out.size() != ref.size()) return;
+    const int16_t* r = (const int16_t*)ref.data();
+    const int16_t* o = (const int16_t*)out.data();
+    double lo[2] = {0, 0}, hi[2] = {1, 1};    // the gain that explains all samples so far
+    bool   changed = false;
+    for(size_t i = 0; i < ref.size() / 2; i++) {
+        int ch = i & 1;
+        if(r[i] == 0) { if(o[i]) hi[ch] = -1; continue; }
+        // (int32_t)(x * g) truncates towards zero: |o| <= |x| * g < |o| + 1
+        double a = abs(r[i]), b = abs(o[i]);
+        if((r[i] < 0) != (o[i] < 0) && o[i]) hi[ch] = -1;
+        lo[ch] = max(lo[ch], b / a);
+        hi[ch] = min(hi[ch], (b + 1) / a);
+        if(o[i] != r[i]) changed = true;
+    }
+    TEST_CHECK(changed);
+    // lo <= gain < hi, a gain like 16/49 meets both ends within the rounding of the division; scaling twice or
+    // another gain would be off by at least 1/32768
+    TEST_CHECK(lo[0] < hi[0] + 1e-9 && lo[1] < hi[1] + 1e-9);
+    TEST_CHECK(hi[0] < 0.9 && hi[1] < 0.9);
+    TEST_CHECK(writes < ref.size() / 4 / 64);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_pt_unity_all);
+    RUN_TEST(test_pt_gain);
+    return s_testFailures;
+}
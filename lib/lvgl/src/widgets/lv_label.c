@@ -49,6 +49,13 @@ static void lv_label_dot_tmp_free(lv_obj_t * label);
 static void set_ofs_x_anim(void * obj, int32_t v);
 static void set_ofs_y_anim(void * obj, int32_t v);
 
+#if LV_LABEL_LINE_CACHE
+static bool lv_label_line_cache_usable(lv_obj_t * obj);
+static bool lv_label_line_cache_refr(lv_obj_t * obj, uint32_t first, lv_coord_t max_w);
+static bool lv_label_line_cache_append(lv_obj_t * obj, const char * txt);
+static void lv_label_line_cache_free(lv_obj_t * obj);
+#endif
+
 /**********************
  *  STATIC VARIABLES
  **********************/
@@ -229,6 +236,21 @@ void lv_label_set_recolor(lv_obj_t * obj, bool en)
     lv_label_refr_text(obj);
 }
 
+#if LV_LABEL_LINE_CACHE
+void lv_label_set_line_cache(lv_obj_t * obj, bool en)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_label_t * label = (lv_label_t *)obj;
+    if(label->line_cache == en) return;
+
+    label->line_cache = en == false ? 0 : 1;
+
+    /*Build or free the cache*/
+    lv_label_refr_text(obj);
+}
+#endif
+
 void lv_label_set_text_sel_start(lv_obj_t * obj, uint32_t index)
 {
     LV_ASSERT_OBJ(obj, MY_CLASS);
@@ -283,6 +305,16 @@ bool lv_label_get_recolor(const lv_obj_t * obj)
     return label->recolor == 0 ? false : true;
 }
 
+#if LV_LABEL_LINE_CACHE
+bool lv_label_get_line_cache(const lv_obj_t * obj)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    lv_label_t * label = (lv_label_t *)obj;
+    return label->line_cache == 0 ? false : true;
+}
+#endif
+
 void lv_label_get_letter_pos(const lv_obj_t * obj, uint32_t char_id, lv_point_t * pos)
 {
     LV_ASSERT_OBJ(obj, MY_CLASS);
@@ -645,6 +677,11 @@ void lv_label_ins_text(lv_obj_t * obj, uint32_t pos, const char * txt)
     /*Can not append to static text*/
     if(label->static_txt != 0) return;
 
+#if LV_LABEL_LINE_CACHE
+    /*Lay out only the last lines*/
+    if(pos == LV_LABEL_POS_LAST && lv_label_line_cache_append(obj, txt)) return;
+#endif
+
     lv_obj_invalidate(obj);
 
     /*Allocate space for the new text*/
@@ -713,6 +750,14 @@ static void lv_label_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj)
     label->dot.tmp_ptr   = NULL;
     label->dot_tmp_alloc = 0;
 
+#if LV_LABEL_LINE_CACHE
+    label->line_cache  = 0;
+    label->lines.start = NULL;
+    label->lines.cnt   = 0;
+    label->lines.size  = 0;
+    label->lines.max_w = -1;
+#endif
+
     lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE);
     lv_label_set_long_mode(obj, LV_LABEL_LONG_WRAP);
     lv_label_set_text(obj, "Text");
@@ -727,6 +772,9 @@ static void lv_label_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj)
     lv_label_t * label = (lv_label_t *)obj;
 
     lv_label_dot_tmp_free(obj);
+#if LV_LABEL_LINE_CACHE
+    lv_label_line_cache_free(obj);
+#endif
     if(!label->static_txt) lv_mem_free(label->text);
     label->text = NULL;
 }
@@ -759,6 +807,11 @@ static void lv_label_event(const lv_obj_class_t * class_p, lv_event_t * e)
         lv_event_set_ext_draw_size(e, font_h / 4);
     }
     else if(code == LV_EVENT_SIZE_CHANGED) {
+#if LV_LABEL_LINE_CACHE
+        /*Only the height has changed, the lines stay the same*/
+        lv_label_t * label = (lv_label_t *)obj;
+        if(label->lines.max_w >= 0 && label->lines.max_w == lv_obj_get_content_width(obj)) return;
+#endif
         lv_label_revert_dots(obj);
         lv_label_refr_text(obj);
     }
@@ -776,7 +829,12 @@ static void lv_label_event(const lv_obj_class_t * class_p, lv_event_t * e)
         if(lv_obj_get_style_width(obj, LV_PART_MAIN) == LV_SIZE_CONTENT && !obj->w_layout) w = LV_COORD_MAX;
         else w = lv_obj_get_content_width(obj);
 
+#if LV_LABEL_LINE_CACHE
+        if(label->lines.max_w >= 0 && label->lines.max_w == w) size = label->lines.txt_size;
+        else lv_txt_get_size(&size, label->text, font, letter_space, line_space, w, flag);
+#else
         lv_txt_get_size(&size, label->text, font, letter_space, line_space, w, flag);
+#endif
 
         lv_point_t * self_size = lv_event_get_param(e);
         self_size->x = LV_MAX(self_size->x, size.x);
@@ -849,14 +907,31 @@ static void draw_main(lv_event_t * e)
         lv_area_move(&txt_coords, 0, -s);
         txt_coords.y2 = obj->coords.y2;
     }
+
+    const char * txt = label->text;
+#if LV_LABEL_LINE_CACHE
+    /*Start with the first line in the clip area. With text selection the letter indices have to start at 0.*/
+    if(label->lines.max_w >= 0 && label->lines.cnt > 0 &&
+       (label_draw_dsc.sel_start == LV_DRAW_LABEL_NO_TXT_SEL || label_draw_dsc.sel_end == LV_DRAW_LABEL_NO_TXT_SEL)) {
+        int32_t line_h = lv_font_get_line_height(label_draw_dsc.font) + label_draw_dsc.line_space;
+        int32_t line = (draw_ctx->clip_area->y1 - txt_coords.y1) / line_h;
+        if(line > 0) {
+            if((uint32_t)line >= label->lines.cnt) line = label->lines.cnt - 1;
+            txt = &label->text[label->lines.start[line]];
+            txt_coords.y1 += line * line_h;
+            hint = NULL;
+        }
+    }
+#endif
+
     if(label->long_mode == LV_LABEL_LONG_SCROLL || label->long_mode == LV_LABEL_LONG_SCROLL_CIRCULAR) {
         const lv_area_t * clip_area_ori = draw_ctx->clip_area;
         draw_ctx->clip_area = &txt_clip;
-        lv_draw_label(draw_ctx, &label_draw_dsc, &txt_coords, label->text, hint);
+        lv_draw_label(draw_ctx, &label_draw_dsc, &txt_coords, txt, hint);
         draw_ctx->clip_area = clip_area_ori;
     }
     else {
-        lv_draw_label(draw_ctx, &label_draw_dsc, &txt_coords, label->text, hint);
+        lv_draw_label(draw_ctx, &label_draw_dsc, &txt_coords, txt, hint);
     }
 
     const lv_area_t * clip_area_ori = draw_ctx->clip_area;
@@ -914,7 +989,17 @@ static void lv_label_refr_text(lv_obj_t * obj)
     if(label->expand != 0) flag |= LV_TEXT_FLAG_EXPAND;
     if(lv_obj_get_style_width(obj, LV_PART_MAIN) == LV_SIZE_CONTENT && !obj->w_layout) flag |= LV_TEXT_FLAG_FIT;
 
+#if LV_LABEL_LINE_CACHE
+    if(lv_label_line_cache_usable(obj) && lv_label_line_cache_refr(obj, 0, max_w)) {
+        size = label->lines.txt_size;
+    }
+    else {
+        lv_label_line_cache_free(obj);
+        lv_txt_get_size(&size, label->text, font, letter_space, line_space, max_w, flag);
+    }
+#else
     lv_txt_get_size(&size, label->text, font, letter_space, line_space, max_w, flag);
+#endif
 
     lv_obj_refresh_self_size(obj);
 
@@ -1256,6 +1341,150 @@ static void lv_label_dot_tmp_free(lv_obj_t * obj)
 }
 
 
+#if LV_LABEL_LINE_CACHE
+/**
+ * Check whether the lines of the label can be kept
+ * @param obj       pointer to a label object
+ * @return          true: wrapped lines with a fixed width
+ */
+static bool lv_label_line_cache_usable(lv_obj_t * obj)
+{
+    lv_label_t * label = (lv_label_t *)obj;
+    if(label->line_cache == 0 || label->long_mode != LV_LABEL_LONG_WRAP || label->expand != 0) return false;
+    if(lv_obj_get_style_width(obj, LV_PART_MAIN) == LV_SIZE_CONTENT && !obj->w_layout) return false;
+    return true;
+}
+
+/**
+ * Break the text to lines again from a given line, the lines before it are kept
+ * @param obj       pointer to a label object
+ * @param first     index of the first line to break, 0: the whole text. Only 0 or the line before the last one
+ *                  as the longest line is known only without the last two lines.
+ * @param max_w     width of the lines
+ * @return          false: out of memory, the cache is freed
+ */
+static bool lv_label_line_cache_refr(lv_obj_t * obj, uint32_t first, lv_coord_t max_w)
+{
+    lv_label_t * label = (lv_label_t *)obj;
+    lv_label_line_cache_t * lines = &label->lines;
+    const lv_font_t * font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    lv_coord_t line_space = lv_obj_get_style_text_line_space(obj, LV_PART_MAIN);
+    lv_coord_t letter_space = lv_obj_get_style_text_letter_space(obj, LV_PART_MAIN);
+    lv_text_flag_t flag = label->recolor != 0 ? LV_TEXT_FLAG_RECOLOR : LV_TEXT_FLAG_NONE;
+    const char * text = label->text;
+
+    uint32_t line_start = first == 0 ? 0 : lines->start[first];
+    if(first == 0) lines->w = 0;
+    lines->max_w = max_w;
+
+    /*The widths of the last two lines, they can still change*/
+    lv_coord_t w_prev = 0;
+    lv_coord_t w_last = 0;
+    uint32_t i = first;
+    while(text[line_start] != '\0') {
+        if(i == lines->size) {
+            uint32_t size = lines->size == 0 ? 8 : lines->size * 2;
+            uint32_t * start = lv_mem_realloc(lines->start, size * sizeof(uint32_t));
+            if(start == NULL) {
+                lv_label_line_cache_free(obj);
+                return false;
+            }
+            lines->start = start;
+            lines->size = size;
+        }
+
+        uint32_t len = _lv_txt_get_next_line(&text[line_start], font, letter_space, max_w, NULL, flag);
+        lines->start[i] = line_start;
+        lines->w = LV_MAX(lines->w, w_prev);
+        w_prev = w_last;
+        w_last = lv_txt_get_width(&text[line_start], len, font, letter_space, flag);
+        line_start += len;
+        i++;
+    }
+    lines->cnt = i;
+
+    /*The same as `lv_txt_get_size`*/
+    int32_t letter_height = lv_font_get_line_height(font);
+    int32_t h = (int32_t)lines->cnt * (letter_height + line_space);
+    if(line_start != 0 && (text[line_start - 1] == '\n' || text[line_start - 1] == '\r')) {
+        h += letter_height + line_space;
+    }
+    h = h == 0 ? letter_height : h - line_space;
+
+    lines->txt_size.x = LV_MAX(lines->w, LV_MAX(w_prev, w_last));
+    lines->txt_size.y = LV_MIN(h, (int32_t)LV_MAX_OF(lv_coord_t));
+    return true;
+}
+
+/**
+ * Append a text and break only the last two lines again. Only the lines that changed are invalidated.
+ * @param obj       pointer to a label object
+ * @param txt       the text to append
+ * @return          false: the lines are not cached, nothing was done
+ */
+static bool lv_label_line_cache_append(lv_obj_t * obj, const char * txt)
+{
+    lv_label_t * label = (lv_label_t *)obj;
+    lv_label_line_cache_t * lines = &label->lines;
+    if(lines->max_w < 0 || lines->max_w != lv_obj_get_content_width(obj)) return false;
+
+    /*The text ends in the last line, no need to measure all of it*/
+    uint32_t old_cnt = lines->cnt;
+    size_t old_len = old_cnt == 0 ? 0 : lines->start[old_cnt - 1] + strlen(&label->text[lines->start[old_cnt - 1]]);
+    size_t ins_len = strlen(txt);
+    char * text = lv_mem_realloc(label->text, old_len + ins_len + 1);
+    LV_ASSERT_MALLOC(text);
+    if(text == NULL) return true;
+    label->text = text;
+    lv_memcpy(&text[old_len], txt, ins_len + 1);
+
+    /*Appending can move a word of the last line to a new line, and "\r" + "\n" or a growing long word can also
+     *change where the line before it ends. The lines above are not affected.*/
+    uint32_t first = old_cnt < 2 ? 0 : old_cnt - 2;
+    uint32_t old_next = first + 1 < old_cnt ? lines->start[first + 1] : 0;
+    if(!lv_label_line_cache_refr(obj, first, lines->max_w)) {
+        lv_label_refr_text(obj);
+        return true;
+    }
+
+    /*The first line whose letters changed*/
+    uint32_t changed = first;
+    if(first + 1 < old_cnt && first + 1 < lines->cnt && lines->start[first + 1] == old_next) changed = first + 1;
+
+    lv_obj_refresh_self_size(obj);
+
+    /*Invalidate from the changed line to the bottom*/
+    lv_area_t txt_coords;
+    lv_obj_get_content_coords(obj, &txt_coords);
+    const lv_font_t * font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    int32_t line_h = lv_font_get_line_height(font) + lv_obj_get_style_text_line_space(obj, LV_PART_MAIN);
+    int32_t y1 = txt_coords.y1 - lv_obj_get_scroll_top(obj) + (int32_t)changed * line_h;
+    lv_coord_t ext = _lv_obj_get_ext_draw_size(obj);
+    lv_area_t inv;
+    inv.x1 = obj->coords.x1 - ext;
+    inv.x2 = obj->coords.x2 + ext;
+    inv.y1 = LV_MIN(y1 - ext, obj->coords.y2);
+    inv.y2 = obj->coords.y2 + ext;
+    lv_obj_invalidate_area(obj, &inv);
+
+    return true;
+}
+
+/**
+ * Free the line cache and mark it invalid
+ * @param obj       pointer to a label object
+ */
+static void lv_label_line_cache_free(lv_obj_t * obj)
+{
+    lv_label_t * label = (lv_label_t *)obj;
+    lv_mem_free(label->lines.start);
+    label->lines.start = NULL;
+    label->lines.cnt   = 0;
+    label->lines.size  = 0;
+    label->lines.max_w = -1;
+}
+#endif
+
 static void set_ofs_x_anim(void * obj, int32_t v)
 {
     lv_label_t * label = (lv_label_t *)obj;
@@ -50,6 +50,18 @@ enum {
 };
 typedef uint8_t lv_label_long_mode_t;
 
+#if LV_LABEL_LINE_CACHE
+/** Line breaks of a label, kept to lay out appended text from the last lines only*/
+typedef struct {
+    uint32_t * start;       /*Byte index of the first letter of every line*/
+    uint32_t cnt;           /*Number of lines*/
+    uint32_t size;          /*Allocated entries in `start`*/
+    lv_coord_t max_w;       /*The lines are broken to this width, -1: the cache is not valid*/
+    lv_coord_t w;           /*Longest line, without the last two*/
+    lv_point_t txt_size;    /*Size of the whole text*/
+} lv_label_line_cache_t;
+#endif
+
 typedef struct {
     lv_obj_t obj;
     char * text;
@@ -63,6 +75,10 @@ typedef struct {
     lv_draw_label_hint_t hint;
 #endif
 
+#if LV_LABEL_LINE_CACHE
+    lv_label_line_cache_t lines;
+#endif
+
 #if LV_LABEL_TEXT_SELECTION
     uint32_t sel_start;
     uint32_t sel_end;
@@ -74,6 +90,9 @@ typedef struct {
     uint8_t recolor : 1;                /*Enable in-line letter re-coloring*/
     uint8_t expand : 1;                 /*Ignore real width (used by the library with LV_LABEL_LONG_SCROLL)*/
     uint8_t dot_tmp_alloc : 1;         /*1: dot is allocated, 0: dot directly holds up to 4 chars*/
+#if LV_LABEL_LINE_CACHE
+    uint8_t line_cache : 1;             /*Keep the line breaks (see `lv_label_set_line_cache`)*/
+#endif
 } lv_label_t;
 
 extern const lv_obj_class_t lv_label_class;
@@ -146,6 +165,17 @@ void lv_label_set_text_sel_start(lv_obj_t * obj, uint32_t index);
  */
 void lv_label_set_text_sel_end(lv_obj_t * obj, uint32_t index);
 
+#if LV_LABEL_LINE_CACHE
+/**
+ * Keep the line breaks of the label. Text appended with `lv_label_ins_text(obj, LV_LABEL_POS_LAST, txt)`
+ * is laid out from the last two lines and only the lines that changed are invalidated.
+ * Only in LV_LABEL_LONG_WRAP mode with a width that is not LV_SIZE_CONTENT, else it is ignored.
+ * @param obj           pointer to a label object
+ * @param en            true: keep the line breaks, false: lay out the whole text on every change
+ */
+void lv_label_set_line_cache(lv_obj_t * obj, bool en);
+#endif
+
 /*=====================
  * Getter functions
  *====================*/
@@ -171,6 +201,15 @@ lv_label_long_mode_t lv_label_get_long_mode(const lv_obj_t * obj);
  */
 bool lv_label_get_recolor(const lv_obj_t * obj);
 
+#if LV_LABEL_LINE_CACHE
+/**
+ * Get whether the label keeps its line breaks
+ * @param obj       pointer to a label object
+ * @return          true: the line cache is enabled, false: disabled
+ */
+bool lv_label_get_line_cache(const lv_obj_t * obj);
+#endif
+
 /**
  * Get the relative x and y coordinates of a letter
  * @param obj       pointer to a label object
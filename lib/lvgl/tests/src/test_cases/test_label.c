@@ -0,0 +1,102 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+
+#include "unity/unity.h"
+
+static lv_obj_t * active_screen = NULL;
+static lv_obj_t * label = NULL;
+
+void setUp(void)
+{
+    active_screen = lv_scr_act();
+    label = lv_label_create(active_screen);
+    lv_obj_set_width(label, 120);
+    lv_label_set_line_cache(label, true);
+    lv_label_set_text(label, "");
+}
+
+void tearDown(void)
+{
+    lv_obj_clean(active_screen);
+}
+
+static void assert_same_lines(lv_obj_t * obj, lv_obj_t * ref)
+{
+    lv_label_t * a = (lv_label_t *)obj;
+    lv_label_t * b = (lv_label_t *)ref;
+
+    TEST_ASSERT_EQUAL_STRING(b->text, a->text);
+    TEST_ASSERT_TRUE(a->lines.max_w >= 0);
+    TEST_ASSERT_EQUAL_UINT32(b->lines.cnt, a->lines.cnt);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(b->lines.start, a->lines.start, a->lines.cnt);
+    TEST_ASSERT_EQUAL_INT32(b->lines.txt_size.x, a->lines.txt_size.x);
+    TEST_ASSERT_EQUAL_INT32(b->lines.txt_size.y, a->lines.txt_size.y);
+    TEST_ASSERT_EQUAL_INT32(lv_obj_get_height(ref), lv_obj_get_height(obj));
+}
+
+void test_label_line_cache_should_be_enabled(void)
+{
+    TEST_ASSERT_TRUE(lv_label_get_line_cache(label));
+    TEST_ASSERT_TRUE(((lv_label_t *)label)->lines.max_w >= 0);
+}
+
+void test_label_line_cache_should_break_appended_text_like_the_whole_text(void)
+{
+    /*Words that move to the next line, "\r" + "\n" in two parts and a word longer than the label*/
+    static const char * parts[] = {"The ", "answer ", "arrives ", "token ", "by ", "token\r", "\n", "Läuft ",
+                                   "日本語", "Supercalifragilisticexpialidocious", " and ", "more\n", "\n", "end"
+                                  };
+
+    lv_obj_t * ref = lv_label_create(active_screen);
+    lv_obj_set_width(ref, 120);
+    lv_label_set_line_cache(ref, true);
+
+    char text[256] = "";
+    uint32_t i;
+    for(i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        lv_label_ins_text(label, LV_LABEL_POS_LAST, parts[i]);
+        strcat(text, parts[i]);
+        lv_label_set_text(ref, text);
+        lv_obj_update_layout(active_screen);
+        assert_same_lines(label, ref);
+    }
+}
+
+void test_label_line_cache_should_invalidate_only_the_last_lines(void)
+{
+    lv_label_set_text(label, "A few lines of text that were there before the last word was appended ");
+    lv_obj_update_layout(active_screen);
+    lv_refr_now(NULL);
+
+    lv_coord_t h = lv_obj_get_height(label);
+    lv_label_ins_text(label, LV_LABEL_POS_LAST, "ok");
+    TEST_ASSERT_EQUAL_INT32(h, lv_obj_get_height(label));
+
+    lv_disp_t * disp = lv_disp_get_default();
+    const lv_font_t * font = lv_obj_get_style_text_font(label, LV_PART_MAIN);
+    TEST_ASSERT_EQUAL_UINT16(1, disp->inv_p);
+    TEST_ASSERT_TRUE(disp->inv_areas[0].y1 > label->coords.y1);
+    TEST_ASSERT_TRUE(lv_area_get_height(&disp->inv_areas[0]) < 3 * lv_font_get_line_height(font));
+}
+
+void test_label_line_cache_should_not_be_used_with_content_width(void)
+{
+    lv_obj_set_width(label, LV_SIZE_CONTENT);
+    TEST_ASSERT_EQUAL_INT32(-1, ((lv_label_t *)label)->lines.max_w);
+
+    lv_label_ins_text(label, LV_LABEL_POS_LAST, "Hello ");
+    lv_label_ins_text(label, LV_LABEL_POS_LAST, "LVGL!");
+    TEST_ASSERT_EQUAL_STRING("Hello LVGL!", lv_label_get_text(label));
+}
+
+void test_label_line_cache_should_be_freed_when_disabled(void)
+{
+    lv_label_set_text(label, "Some text");
+    lv_label_set_line_cache(label, false);
+
+    TEST_ASSERT_FALSE(lv_label_get_line_cache(label));
+    TEST_ASSERT_NULL(((lv_label_t *)label)->lines.start);
+    TEST_ASSERT_EQUAL_INT32(-1, ((lv_label_t *)label)->lines.max_w);
+}
+
+#endif
@@ -0,0 +1,413 @@
+#include "Album_Art.h"
+#include "src/extra/libs/sjpg/tjpgd.h"
+
+// The picture is located by walking the tag headers (ID3v2 APIC/PIC, FLAC PICTURE, MP4 covr), only the image itself
+// is read. It is decoded by tjpgd in a background task with the largest 1/2^n scaling that stays above the thumbnail
+// size, then reduced with a box filter. The RGB565 thumbnails are kept in a small LRU cache and written to the SD card,
+// a track that was shown before costs one file read.
+
+typedef struct {
+  uint32_t Key;                                     // FNV-1a of the file name
+  uint32_t Used;                                    // LRU clock
+  uint8_t  State;                                   // ART_FREE, ART_BUSY, ALBUM_ART_READY, ALBUM_ART_NONE
+  uint8_t  Refs;                                    // held by album images
+  uint16_t* Pixels;
+  lv_img_dsc_t Img;
+} Art_Entry;
+
+typedef struct {
+  uint32_t Key;
+  char     Path[128];
+} Art_Request;
+
+typedef struct {                                    // tjpgd device
+  File*    File_In;
+  uint32_t Left;                                    // bytes of the picture not yet read
+  uint8_t* Rgb;                                     // RGB888, Width x Height
+  uint16_t Width;
+  uint16_t Height;
+} Art_Source;
+
+#define ART_FREE    0xFF
+#define ART_BUSY    0xFE
+
+static Art_Entry Entry[ALBUM_ART_CACHE];
+static uint32_t Entry_Clock = 0;
+static SemaphoreHandle_t Art_Mutex = NULL;
+static QueueHandle_t Art_Queue = NULL;
+
+static void* Art_Alloc(size_t size)
+{
+  return psramFound() ? ps_malloc(size) : malloc(size);
+}
+static uint32_t Art_Key(const char* fileName)
+{
+  uint32_t hash = 2166136261UL;
+  while (*fileName) hash = (hash ^ (uint8_t)*fileName++) * 16777619UL;  // FNV-1a
+  return hash;
+}
+static void Art_Cache_Path(char* path, uint16_t len, uint32_t key)
+{
+  snprintf(path, len, "%s/%08lX.bin", ALBUM_ART_DIR, (unsigned long)key);
+}
+
+/************************************************************  Locate  ************************************************************/
+static uint32_t Be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint32_t Syncsafe(const uint8_t* p) { return ((p[0] & 0x7F) << 21) | ((p[1] & 0x7F) << 14) | ((p[2] & 0x7F) << 7) | (p[3] & 0x7F); }
+
+static bool Locate_ID3(File &file, uint32_t* pos, uint32_t* len)
+{
+  // ID3v2 APIC (v2.3/2.4) or PIC (v2.2) frame, the front cover is preferred over the first picture
+  uint8_t hdr[10];
+  file.seek(0);
+  if (file.read(hdr, 10) != 10 || memcmp(hdr, "ID3", 3) != 0) return false;
+  uint8_t ver = hdr[3];
+  if (hdr[5] & 0x80) return false;                                  // unsynchronisation, the picture would be altered
+  uint32_t end = 10 + Syncsafe(hdr + 6);
+  uint32_t p = 10;
+  if ((hdr[5] & 0x40) && ver >= 3) {                                // extended header
+    uint8_t ext[4];
+    if (file.read(ext, 4) != 4) return false;
+    p += (ver == 4) ? Syncsafe(ext) : Be32(ext) + 4;
+  }
+  uint8_t frameHdr = (ver == 2) ? 6 : 10;
+  bool found = false;
+  while (p + frameHdr <= end) {
+    uint8_t f[10];
+    file.seek(p);
+    if (file.read(f, frameHdr) != frameHdr || f[0] == 0) break;     // padding
+    uint32_t size;
+    bool pic;
+    if (ver == 2) {
+      size = (f[3] << 16) | (f[4] << 8) | f[5];
+      pic = !memcmp(f, "PIC", 3);
+    } else {
+      size = (ver == 4) ? Syncsafe(f + 4) : Be32(f + 4);
+      pic = !memcmp(f, "APIC", 4) && !(f[9] & 0x0C);                 // not compressed or encrypted
+    }
+    p += frameHdr;
+    if (size > end - p) break;
+    if (pic && size > 16) {
+      // encoding, MIME type (v2.2: 3 byte format), picture type, description, data
+      uint8_t head[160];
+      uint16_t n = file.read(head, min(size, (uint32_t)sizeof(head)));
+      uint16_t i = 1;
+      if (ver == 2) i += 3;                                         // image format
+      else {                                                        // MIME type
+        while (i < n && head[i]) i++;
+        i++;
+      }
+      uint8_t type = (i < n) ? head[i] : 0;
+      i++;
+      if (head[0] == 1 || head[0] == 2) {                           // UTF-16 description, 00 00 aligned
+        while (i + 1 < n && (head[i] || head[i + 1])) i += 2;
+        i += 2;
+      } else {
+        while (i < n && head[i]) i++;
+        i++;
+      }
+      if (i < n && (!found || type == 3)) {
+        *pos = p + i;
+        *len = size - i;
+        found = true;
+        if (type == 3) return true;                                 // front cover
+      }
+    }
+    p += size;
+  }
+  return found;
+}
+static bool Locate_FLAC(File &file, uint32_t* pos, uint32_t* len)
+{
+  // METADATA_BLOCK_PICTURE (type 6): type, MIME, description, width, height, depth, colors, length, data
+  uint8_t hdr[4];
+  file.seek(0);
+  if (file.read(hdr, 4) != 4 || memcmp(hdr, "fLaC", 4) != 0) return false;
+  uint32_t p = 4;
+  bool found = false;
+  while (1) {
+    file.seek(p);
+    if (file.read(hdr, 4) != 4) return found;
+    uint32_t size = (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+    p += 4;
+    if ((hdr[0] & 0x7F) == 6 && size > 32) {
+      uint8_t b[8];
+      uint32_t q = p;
+      file.read(b, 8);
+      uint32_t type = Be32(b);
+      q += 8 + Be32(b + 4);                                         // MIME
+      file.seek(q);
+      file.read(b, 4);
+      q += 4 + Be32(b) + 16;                                        // description, width ... colors
+      file.seek(q);
+      file.read(b, 4);
+      uint32_t dataLen = Be32(b);
+      if (q + 4 + dataLen <= p + size && (!found || type == 3)) {
+        *pos = q + 4;
+        *len = dataLen;
+        found = true;
+        if (type == 3) return true;
+      }
+    }
+    p += size;
+    if (hdr[0] & 0x80) return found;                                // last metadata block
+  }
+}
+static bool MP4_Find(File &file, uint32_t start, uint32_t end, const char* name, uint32_t* bodyPos, uint32_t* bodyEnd)
+{
+  uint8_t a[8];
+  for (uint32_t p = start; p + 8 <= end; ) {
+    file.seek(p);
+    if (file.read(a, 8) != 8) return false;
+    uint32_t size = Be32(a);
+    if (size < 8 || p + size > end) return false;                   // 64 bit atoms are not used for the tags
+    if (!memcmp(a + 4, name, 4)) {
+      *bodyPos = p + 8;
+      *bodyEnd = p + size;
+      return true;
+    }
+    p += size;
+  }
+  return false;
+}
+static bool Locate_MP4(File &file, uint32_t* pos, uint32_t* len)
+{
+  // moov/udta/meta/ilst/covr/data, the meta atom has 4 bytes version and flags, data has 8 bytes type and locale
+  uint32_t p, e = file.size();
+  if (!MP4_Find(file, 0, e, "moov", &p, &e)) return false;
+  if (!MP4_Find(file, p, e, "udta", &p, &e)) return false;
+  if (!MP4_Find(file, p, e, "meta", &p, &e)) return false;
+  if (!MP4_Find(file, p + 4, e, "ilst", &p, &e)) return false;
+  if (!MP4_Find(file, p, e, "covr", &p, &e)) return false;
+  if (!MP4_Find(file, p, e, "data", &p, &e) || e < p + 8) return false;
+  *pos = p + 8;
+  *len = e - p - 8;
+  return true;
+}
+
+/************************************************************  Decode  ************************************************************/
+static size_t Art_Input(JDEC* jd, uint8_t* buff, size_t n)
+{
+  Art_Source* src = (Art_Source*)jd->device;
+  if (n > src->Left) n = src->Left;
+  if (buff) n = src->File_In->read(buff, n);
+  else src->File_In->seek(src->File_In->position() + n);            // skip
+  src->Left -= n;
+  return n;
+}
+static int Art_Output(JDEC* jd, void* bitmap, JRECT* rect)
+{
+  Art_Source* src = (Art_Source*)jd->device;
+  const uint8_t* rgb = (const uint8_t*)bitmap;
+  uint16_t w = rect->right - rect->left + 1;
+  for (uint16_t y = rect->top; y <= rect->bottom; y++, rgb += w * 3) {
+    if (y >= src->Height) break;
+    uint16_t n = (rect->left + w <= src->Width) ? w : src->Width - rect->left;
+    if (rect->left < src->Width) memcpy(src->Rgb + (y * src->Width + rect->left) * 3, rgb, n * 3);
+  }
+  return 1;
+}
+static void Art_Scale(const Art_Source* src, uint16_t* out)
+{
+  // centred square, every thumbnail pixel is the average of its box in the source
+  uint16_t side = min(src->Width, src->Height);
+  uint16_t ox = (src->Width - side) / 2, oy = (src->Height - side) / 2;
+  for (uint16_t y = 0; y < ALBUM_ART_SIZE; y++) {
+    uint16_t y0 = oy + (uint32_t)y * side / ALBUM_ART_SIZE;
+    uint16_t y1 = max((uint16_t)(oy + (uint32_t)(y + 1) * side / ALBUM_ART_SIZE), (uint16_t)(y0 + 1));
+    for (uint16_t x = 0; x < ALBUM_ART_SIZE; x++) {
+      uint16_t x0 = ox + (uint32_t)x * side / ALBUM_ART_SIZE;
+      uint16_t x1 = max((uint16_t)(ox + (uint32_t)(x + 1) * side / ALBUM_ART_SIZE), (uint16_t)(x0 + 1));
+      uint32_t r = 0, g = 0, b = 0, n = (uint32_t)(y1 - y0) * (x1 - x0);
+      for (uint16_t sy = y0; sy < y1; sy++) {
+        const uint8_t* p = src->Rgb + (sy * src->Width + x0) * 3;
+        for (uint16_t sx = x0; sx < x1; sx++, p += 3) {
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+      }
+      *out++ = lv_color_make(r / n, g / n, b / n).full;
+    }
+  }
+}
+static bool Art_Decode(File &file, uint32_t pos, uint32_t len, uint16_t* out)
+{
+  uint8_t magic[2];
+  file.seek(pos);
+  if (len < 4 || file.read(magic, 2) != 2 || magic[0] != 0xFF || magic[1] != 0xD8) return false;  // PNG is not decoded
+  file.seek(pos);
+  void* work = malloc(ALBUM_ART_WORK);                              // internal RAM, the huffman tables are in there
+  if (!work) return false;
+  JDEC jd;
+  Art_Source src = {&file, len, NULL, 0, 0};
+  bool ok = false;
+  if (jd_prepare(&jd, Art_Input, work, ALBUM_ART_WORK, &src) == JDR_OK) {
+    uint8_t scale = 0;
+    while (scale < 3 && (jd.width >> (scale + 1)) >= ALBUM_ART_SIZE && (jd.height >> (scale + 1)) >= ALBUM_ART_SIZE) scale++;
+    src.Width = jd.width >> scale;
+    src.Height = jd.height >> scale;
+    src.Rgb = (uint8_t*)Art_Alloc((uint32_t)src.Width * src.Height * 3);
+    if (src.Rgb && src.Width && src.Height) {
+      memset(src.Rgb, 0, (uint32_t)src.Width * src.Height * 3);
+      if (jd_decomp(&jd, Art_Output, scale) == JDR_OK) {
+        Art_Scale(&src, out);
+        ok = true;
+      }
+    }
+    free(src.Rgb);
+  }
+  free(work);
+  return ok;
+}
+
+/************************************************************  Cache  ************************************************************/
+static uint8_t Art_Load(Art_Entry* e, const char* path)
+{
+  // SD card cache first, then the picture of the music file, the result is written to the SD card either way
+  File music = SD_MMC.open(path);
+  if (!music) return ALBUM_ART_NONE;
+  uint32_t size = music.size();
+  uint32_t time = music.getLastWrite();
+  char cachePath[32];
+  Art_Cache_Path(cachePath, sizeof(cachePath), e->Key);
+  Album_Art_Header hdr;
+  File cache = SD_MMC.open(cachePath);
+  if (cache) {
+    bool hit = cache.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) && hdr.Magic == ALBUM_ART_MAGIC &&
+               hdr.Source_Size == size && hdr.Source_Time == time;
+    uint8_t state = ALBUM_ART_PENDING;
+    if (hit && hdr.Width == 0) state = ALBUM_ART_NONE;
+    else if (hit && hdr.Width == ALBUM_ART_SIZE && hdr.Height == ALBUM_ART_SIZE &&
+             cache.read((uint8_t*)e->Pixels, ALBUM_ART_SIZE * ALBUM_ART_SIZE * 2) == ALBUM_ART_SIZE * ALBUM_ART_SIZE * 2)
+      state = ALBUM_ART_READY;
+    cache.close();
+    if (state != ALBUM_ART_PENDING) {
+      music.close();
+      return state;
+    }
+  }
+
+  uint32_t pos = 0, len = 0;
+  bool found = Locate_ID3(music, &pos, &len) || Locate_FLAC(music, &pos, &len) || Locate_MP4(music, &pos, &len);
+  bool ok = found && pos + len <= size && Art_Decode(music, pos, len, e->Pixels);
+  music.close();
+
+  hdr.Magic = ALBUM_ART_MAGIC;
+  hdr.Source_Size = size;
+  hdr.Source_Time = time;
+  hdr.Width = ok ? ALBUM_ART_SIZE : 0;
+  hdr.Height = ok ? ALBUM_ART_SIZE : 0;
+  if (!SD_MMC.exists(ALBUM_ART_DIR)) SD_MMC.mkdir(ALBUM_ART_DIR);
+  cache = SD_MMC.open(cachePath, FILE_WRITE);
+  if (cache) {
+    cache.write((const uint8_t*)&hdr, sizeof(hdr));
+    if (ok) cache.write((const uint8_t*)e->Pixels, ALBUM_ART_SIZE * ALBUM_ART_SIZE * 2);
+    cache.close();
+  }
+  return ok ? ALBUM_ART_READY : ALBUM_ART_NONE;
+}
+static Art_Entry* Art_Claim(uint32_t key)
+{
+  // a slot for a new thumbnail, NULL if it is known already or every slot is held by an image
+  Art_Entry* victim = NULL;
+  xSemaphoreTake(Art_Mutex, portMAX_DELAY);
+  for (uint8_t i = 0; i < ALBUM_ART_CACHE; i++) {
+    Art_Entry* e = &Entry[i];
+    if (e->State != ART_FREE && e->Key == key) {
+      e->Used = ++Entry_Clock;
+      xSemaphoreGive(Art_Mutex);
+      return NULL;
+    }
+    if (e->State == ART_BUSY || e->Refs) continue;
+    if (!victim || e->State == ART_FREE || (victim->State != ART_FREE && e->Used < victim->Used)) victim = e;
+  }
+  if (victim) {
+    victim->Key = key;
+    victim->State = ART_BUSY;
+    victim->Used = ++Entry_Clock;
+  }
+  xSemaphoreGive(Art_Mutex);
+  return victim;
+}
+static void Album_Art_Task(void *parameter)
+{
+  Art_Request req;
+  while (1) {
+    if (xQueueReceive(Art_Queue, &req, portMAX_DELAY) != pdTRUE) continue;
+    Art_Entry* e = Art_Claim(req.Key);
+    if (!e) continue;
+    if (!e->Pixels) e->Pixels = (uint16_t*)Art_Alloc(ALBUM_ART_SIZE * ALBUM_ART_SIZE * 2);
+    uint8_t state = e->Pixels ? Art_Load(e, req.Path) : ALBUM_ART_NONE;
+    xSemaphoreTake(Art_Mutex, portMAX_DELAY);
+    e->State = state;
+    xSemaphoreGive(Art_Mutex);
+  }
+  vTaskDelete(NULL);
+}
+
+void Album_Art_Init()
+{
+  if (Art_Queue) return;
+  for (uint8_t i = 0; i < ALBUM_ART_CACHE; i++) {
+    Entry[i].State = ART_FREE;
+    Entry[i].Refs = 0;
+    Entry[i].Pixels = NULL;
+  }
+  Art_Mutex = xSemaphoreCreateMutex();
+  Art_Queue = xQueueCreate(ALBUM_ART_QUEUE, sizeof(Art_Request));
+  xTaskCreatePinnedToCore(
+    Album_Art_Task,
+    "Album_Art_Task",
+    6144,
+    NULL,
+    2,                                              // below audio and LVGL
+    NULL,
+    0
+  );
+}
+void Album_Art_Request(const char* directory, const char* fileName)
+{
+  if (!Art_Queue) return;
+  Art_Request req;
+  req.Key = Art_Key(fileName);
+  if (strcmp(directory, "/") == 0)
+    snprintf(req.Path, sizeof(req.Path), "%s%s", directory, fileName);
+  else
+    snprintf(req.Path, sizeof(req.Path), "%s/%s", directory, fileName);
+  xQueueSend(Art_Queue, &req, 0);                                   // full: the request is dropped, Get() stays PENDING
+}
+uint8_t Album_Art_Get(const char* fileName, const lv_img_dsc_t** img)
+{
+  uint32_t key = Art_Key(fileName);
+  uint8_t state = ALBUM_ART_PENDING;
+  if (!Art_Mutex) return ALBUM_ART_NONE;
+  xSemaphoreTake(Art_Mutex, portMAX_DELAY);
+  for (uint8_t i = 0; i < ALBUM_ART_CACHE; i++) {
+    Art_Entry* e = &Entry[i];
+    if (e->Key != key || e->State == ART_FREE || e->State == ART_BUSY) continue;
+    state = e->State;
+    e->Used = ++Entry_Clock;
+    if (state == ALBUM_ART_READY) {
+      e->Refs++;
+      e->Img.header.always_zero = 0;
+      e->Img.header.w = ALBUM_ART_SIZE;
+      e->Img.header.h = ALBUM_ART_SIZE;
+      e->Img.header.cf = LV_IMG_CF_TRUE_COLOR;
+      e->Img.data_size = ALBUM_ART_SIZE * ALBUM_ART_SIZE * 2;
+      e->Img.data = (const uint8_t*)e->Pixels;
+      *img = &e->Img;
+    }
+    break;
+  }
+  xSemaphoreGive(Art_Mutex);
+  return state;
+}
+void Album_Art_Release(const lv_img_dsc_t* img)
+{
+  if (!img || !Art_Mutex) return;
+  xSemaphoreTake(Art_Mutex, portMAX_DELAY);
+  for (uint8_t i = 0; i < ALBUM_ART_CACHE; i++)
+    if (&Entry[i].Img == img && Entry[i].Refs) Entry[i].Refs--;
+  xSemaphoreGive(Art_Mutex);
+}
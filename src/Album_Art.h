@@ -0,0 +1,32 @@
+#pragma once
+#include "Arduino.h"
+#include <cstring>
+#include "FS.h"
+#include "SD_MMC.h"
+#include <lvgl.h>
+
+#define ALBUM_ART_SIZE        176                   // the album widget, the covers of the demo are 176 x 175
+#define ALBUM_ART_CACHE       6                     // thumbnails in PSRAM, 62 KB each
+#define ALBUM_ART_DIR         "/.art"               // hidden, one file per track: Album_Art_Header | RGB565 pixels
+#define ALBUM_ART_MAGIC       0x32545241            // "ART2"
+#define ALBUM_ART_QUEUE       4                     // pending requests
+#define ALBUM_ART_WORK        4096                  // tjpgd work area (3100 bytes for baseline JPEG)
+
+enum {
+  ALBUM_ART_PENDING = 0,                            // not yet decoded, ask again
+  ALBUM_ART_READY,
+  ALBUM_ART_NONE,                                   // no picture or not a baseline JPEG, show the default cover
+};
+
+typedef struct __attribute__((packed)) {
+  uint32_t Magic;
+  uint32_t Source_Size;                             // size and time of the music file, a replaced file is decoded again
+  uint32_t Source_Time;
+  uint16_t Width;                                   // 0: the file has no usable picture
+  uint16_t Height;
+} Album_Art_Header;
+
+void    Album_Art_Init();                                                       // starts the decoder task
+void    Album_Art_Request(const char* directory, const char* fileName);         // asynchronous, e.g. for the next track too
+uint8_t Album_Art_Get(const char* fileName, const lv_img_dsc_t** img);          // READY: img is held until released
+void    Album_Art_Release(const lv_img_dsc_t* img);
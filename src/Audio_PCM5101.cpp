@@ -1,4 +1,5 @@
 #include "Audio_PCM5101.h"
+#include "MIC_AEC.h"
 Audio audio;
 uint8_t Volume = Volume_MAX;
 void IRAM_ATTR example_increase_audio_tick(void *arg)
@@ -9,6 +10,12 @@ void Audio_Init() {
   // Audio
   audio.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT);
   audio.setVolume(Volume); // 0...21    
+  audio.getSoundBank()->setBudget(Sound_Budget);
+  const char* sounds[] = {Sound_Listening, Sound_Done};
+  for(const char* path : sounds) {                                    // decoded once, before the music uses the decoder
+    if(SD_MMC.exists(path))
+      audio.loadSound(SD_MMC, path);
+  }
 
   esp_timer_handle_t audio_tick_timer = NULL;
   const esp_timer_create_args_t audio_tick_timer_args = {
@@ -66,6 +73,29 @@ void Play_Music(const char* directory, const char* fileName) {
   Music_pause();     
   vTaskDelay(pdMS_TO_TICKS(100));    
 }
+void Music_Queue_Next(const char* directory, const char* fileName) {
+  const int maxPathLength = 100; 
+  char filePath[maxPathLength];
+  if (strcmp(directory, "/") == 0) {                                               
+    snprintf(filePath, maxPathLength, "%s%s", directory, fileName);   
+  } else {                                                            
+    snprintf(filePath, maxPathLength, "%s/%s", directory, fileName);
+  }
+  audio.setNextFile(SD_MMC, filePath);                                // follows the current track without a gap
+}
+static volatile bool Next_Started = false;
+void audio_next_file(const char* info) {                              // audio task: the queued track is playing now
+  Next_Started = true;
+}
+void audio_output_tap(const int16_t* frames, uint16_t n, uint32_t rate, int64_t playUs) {  // audio task: the echo reference
+  AEC_Reference(frames, n, rate, playUs);
+}
+bool Music_Next_Started() {
+  if (!Next_Started)
+    return false;
+  Next_Started = false;
+  return true;
+}
 void Music_pause() {
   if (audio.isRunning()) {            
     audio.pauseResume();             
@@ -102,6 +132,30 @@ uint16_t Music_Energy() {
   return Audio_Energy;
 }
 
+void Music_duck(bool hold) {
+  audio.getMixer()->holdDucking(hold);   // lower the music instead of pausing it
+}
+void Audio_Click() {
+  static int16_t click[Click_LEN];
+  static bool click_ready = false;
+  if(!click_ready) {                                                  // 2kHz burst with exponential decay
+    for(int i = 0; i < Click_LEN; i++)
+      click[i] = 12000 * expf(-6.0f * i / Click_LEN) * sinf(2 * PI * 2000 * i / Click_RATE);
+    click_ready = true;
+  }
+  int8_t id = audio.getMixer()->openStream(MIX_EFFECT, Click_RATE, 1, 20);
+  if(id < 0) return;                                                  // all mixer streams are busy, skip this click
+  audio.getMixer()->writeStream(id, click, Click_LEN);
+  audio.getMixer()->endStream(id);                                   // closed by the mixer when played
+}
+
+void Audio_Sound(const char* path, uint8_t type) {
+  int8_t id = audio.playSound(path, type);                          // cached: no file access, no decoder
+  if(id == SB_ERR_MISS && audio.loadSound(SD_MMC, path) == SB_OK)     // decoded in this task, the music goes on
+    id = audio.playSound(path, type);
+  if(id < 0) printf("Sound %s not played: %d\r\n", path, id);
+}
+
 void Audio_Loop()
 {
   if(!audio.isRunning())
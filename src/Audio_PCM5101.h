@@ -11,6 +11,13 @@
 #define EXAMPLE_Audio_TICK_PERIOD_MS  20
 #define Volume_MAX  21
 
+#define Click_RATE    16000
+#define Click_LEN     128             // 8ms
+
+#define Sound_Budget      (256 * 1024)            // bytes of decoded clips in PSRAM
+#define Sound_Listening   "/sounds/listening.wav" // after the wake word
+#define Sound_Done        "/sounds/done.wav"      // the voice query is complete
+
 
 extern Audio audio;
 extern uint8_t Volume;
@@ -21,8 +28,13 @@ void Audio_Loop();
 void Audio_Init();
 void Volume_adjustment(uint8_t Volume);
 void Play_Music(const char* directory, const char* fileName);
+void Music_Queue_Next(const char* directory, const char* fileName);
+bool Music_Next_Started();
 void Music_pause(); 
 void Music_resume();    
 uint32_t Music_Duration();  
 uint32_t Music_Elapsed();   
 uint16_t Music_Energy();    
+void Music_duck(bool hold);
+void Audio_Click();
+void Audio_Sound(const char* path, uint8_t type = MIX_EFFECT);
@@ -0,0 +1,488 @@
+#include "LLM_Client.h"
+#include "http_body/http_body.h"
+#include "freertos/stream_buffer.h"
+
+// The answer of a local model arrives as a token stream: server-sent events ("data: {json}", OpenAI compatible) or
+// one JSON object per line (Ollama). The client task scans the bytes as they come, without a line buffer or a JSON
+// tree, and passes the decoded content strings through a stream buffer to LVGL. The transcript appends them once per
+// LLM_RENDER_PERIOD to its last label only. The labels keep their line breaks, an append lays out and redraws the
+// last lines; full lines are left behind in labels of their own every LLM_LABEL_CHUNK bytes, so old text can be
+// dropped line by line.
+//
+// A module of its own: nothing in the firmware calls it yet. The voice query of MIC_MSM is encoded audio and there is
+// no speech to text in this tree, the app that has a text asks with LLM_Ask() and shows LLM_Transcript_Create().
+
+enum { LLM_LINE_START = 0, LLM_LINE_JSON, LLM_LINE_SKIP };
+enum { LLM_JSON_VALUE = 0, LLM_JSON_STRING, LLM_JSON_ESCAPE, LLM_JSON_UNICODE, LLM_JSON_LITERAL };
+
+typedef struct {                                    // LLM_Parser_Feed(), decoded text is passed on in pieces
+  LLM_Text_Cb Cb;
+  void*    Arg;
+  char     Out[64];
+  uint8_t  Out_Len;
+  uint32_t Tokens;
+} LLM_Sink;
+
+static char     LLM_Host[LLM_HOST_LEN];
+static uint16_t LLM_Port = 0;
+static char     LLM_Model[LLM_MODEL_LEN];
+static char     LLM_Prompt[LLM_PROMPT_LEN];
+static volatile uint8_t LLM_Status = LLM_IDLE;
+static LLM_Stats LLM_Stat;
+static LLM_Parser Parser;
+static TaskHandle_t LLM_Task_Handle = NULL;
+static StreamBufferHandle_t Text_Buffer = NULL;
+static volatile uint32_t Text_Since = 0;            // millis() of the oldest text not yet in the label, 0: none
+static uint32_t Request_Time = 0;
+static lv_timer_t* Transcript_Timer = NULL;
+
+/************************************************************  Parser  ************************************************************/
+void LLM_Parser_Reset(LLM_Parser* p)
+{
+  memset(p, 0, sizeof(LLM_Parser));
+}
+static void Sink_Flush(LLM_Sink* s, bool token_end)
+{
+  if (s->Out_Len || token_end) s->Cb(s->Arg, s->Out, s->Out_Len, token_end);
+  s->Out_Len = 0;
+}
+static void Sink_Byte(LLM_Sink* s, uint8_t c)
+{
+  s->Out[s->Out_Len++] = c;
+  if (s->Out_Len == sizeof(s->Out)) Sink_Flush(s, false);
+}
+static void String_Byte(LLM_Parser* p, LLM_Sink* s, uint8_t c)
+{
+  if (p->Is_Key) {
+    if (p->Key_Len < LLM_KEY_LEN) p->Key[p->Key_Len] = c;
+    if (p->Key_Len <= LLM_KEY_LEN) p->Key_Len++;                     // LLM_KEY_LEN + 1: too long
+  }
+  else if (p->Emit) Sink_Byte(s, c);
+}
+static void String_Code_Point(LLM_Parser* p, LLM_Sink* s, uint32_t cp)
+{
+  if (cp < 0x80) String_Byte(p, s, cp);
+  else if (cp < 0x800) {
+    String_Byte(p, s, 0xC0 | (cp >> 6));
+    String_Byte(p, s, 0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000) {
+    String_Byte(p, s, 0xE0 | (cp >> 12));
+    String_Byte(p, s, 0x80 | ((cp >> 6) & 0x3F));
+    String_Byte(p, s, 0x80 | (cp & 0x3F));
+  }
+  else {
+    String_Byte(p, s, 0xF0 | (cp >> 18));
+    String_Byte(p, s, 0x80 | ((cp >> 12) & 0x3F));
+    String_Byte(p, s, 0x80 | ((cp >> 6) & 0x3F));
+    String_Byte(p, s, 0x80 | (cp & 0x3F));
+  }
+}
+static bool Value_Of(LLM_Parser* p, const char* key)
+{
+  return strcmp(p->Value_Of, key) == 0;
+}
+static void Json_Char(LLM_Parser* p, LLM_Sink* s, uint8_t c)
+{
+  switch (p->State) {
+    case LLM_JSON_VALUE:
+      if (c == ' ' || c == '\t' || c == '\r' || c == '\n') break;
+      if (c == '{' || c == '[') {
+        if (p->Depth < 32) {
+          if (c == '{') p->Objects |= 1UL << p->Depth;
+          else p->Objects &= ~(1UL << p->Depth);
+        }
+        p->Depth++;
+        p->Expect_Key = c == '{';
+        p->Value_Of[0] = '\0';
+      }
+      else if (c == '}' || c == ']') {
+        if (p->Depth) p->Depth--;
+        p->Expect_Key = false;
+        p->Value_Of[0] = '\0';
+      }
+      else if (c == ',') {
+        p->Expect_Key = p->Depth && p->Depth <= 32 && (p->Objects & (1UL << (p->Depth - 1)));
+        p->Value_Of[0] = '\0';
+      }
+      else if (c == ':') p->Expect_Key = false;
+      else if (c == '"') {
+        p->Is_Key = p->Expect_Key;
+        p->Key_Len = 0;
+        p->Emit = !p->Is_Key && (Value_Of(p, "content") || Value_Of(p, "response"));   // OpenAI delta, Ollama
+        p->Surrogate = 0;
+        p->State = LLM_JSON_STRING;
+      }
+      else {                                                        // number, true, false, null
+        p->Literal[0] = c;
+        p->Literal_Len = 1;
+        p->State = LLM_JSON_LITERAL;
+      }
+      break;
+    case LLM_JSON_STRING:
+      if (c == '\\') p->State = LLM_JSON_ESCAPE;
+      else if (c == '"') {
+        if (p->Is_Key) {
+          p->Key[p->Key_Len <= LLM_KEY_LEN ? p->Key_Len : 0] = '\0';
+          memcpy(p->Value_Of, p->Key, sizeof(p->Value_Of));
+          p->Expect_Key = false;
+        }
+        else {
+          if (p->Emit) {
+            s->Tokens++;
+            Sink_Flush(s, true);
+          }
+          p->Value_Of[0] = '\0';
+        }
+        p->State = LLM_JSON_VALUE;
+      }
+      else String_Byte(p, s, c);
+      break;
+    case LLM_JSON_ESCAPE:
+      p->State = LLM_JSON_STRING;
+      switch (c) {
+        case 'n': String_Byte(p, s, '\n'); break;
+        case 't': String_Byte(p, s, '\t'); break;
+        case 'r': break;                                            // the label breaks at \n
+        case 'b': case 'f': break;
+        case 'u': p->Hex = 0; p->Hex_Len = 0; p->State = LLM_JSON_UNICODE; break;
+        default:  String_Byte(p, s, c); break;                      // " \ /
+      }
+      break;
+    case LLM_JSON_UNICODE:
+      p->Hex = (p->Hex << 4) | (c <= '9' ? c - '0' : ((c | 0x20) - 'a' + 10)) ;
+      if (++p->Hex_Len < 4) break;
+      p->State = LLM_JSON_STRING;
+      if (p->Hex >= 0xD800 && p->Hex < 0xDC00) p->Surrogate = p->Hex;   // the low half follows as \uDCxx
+      else if (p->Hex >= 0xDC00 && p->Hex < 0xE000) {
+        if (p->Surrogate) String_Code_Point(p, s, 0x10000 + ((uint32_t)(p->Surrogate - 0xD800) << 10) + (p->Hex - 0xDC00));
+        p->Surrogate = 0;
+      }
+      else String_Code_Point(p, s, p->Hex);
+      break;
+    case LLM_JSON_LITERAL:
+      if (isalnum(c) || c == '.' || c == '-' || c == '+') {
+        if (p->Literal_Len < sizeof(p->Literal) - 1) p->Literal[p->Literal_Len++] = c;
+        break;
+      }
+      p->Literal[p->Literal_Len] = '\0';
+      if (Value_Of(p, "done") && strcmp(p->Literal, "true") == 0) p->Done = true;   // Ollama
+      p->Value_Of[0] = '\0';
+      p->State = LLM_JSON_VALUE;
+      Json_Char(p, s, c);                                           // the character behind the literal
+      break;
+  }
+}
+static void Json_Begin(LLM_Parser* p)
+{
+  p->State = LLM_JSON_VALUE;
+  p->Depth = 0;
+  p->Objects = 0;
+  p->Expect_Key = false;
+  p->Value_Of[0] = '\0';
+  p->Line = LLM_LINE_JSON;
+}
+uint32_t LLM_Parser_Feed(LLM_Parser* p, const uint8_t* data, uint32_t len, LLM_Text_Cb cb, void* arg)
+{
+  LLM_Sink s;
+  s.Cb = cb;
+  s.Arg = arg;
+  s.Out_Len = 0;
+  s.Tokens = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    uint8_t c = data[i];
+    switch (p->Line) {
+      case LLM_LINE_START:
+        if (c == '\n') { p->Prefix_Len = 0; break; }
+        if (c == '\r') break;
+        if (p->Prefix_Len == 5) {                                   // "data:" seen
+          if (c == ' ') break;
+          if (c == '[') { p->Done = true; p->Line = LLM_LINE_SKIP; break; }   // data: [DONE]
+          Json_Begin(p);
+          Json_Char(p, &s, c);
+          break;
+        }
+        if (p->Prefix_Len == 0 && c == '{') {                       // a JSON object per line
+          Json_Begin(p);
+          Json_Char(p, &s, c);
+          break;
+        }
+        if (c == (uint8_t)"data:"[p->Prefix_Len]) p->Prefix_Len++;
+        else p->Line = LLM_LINE_SKIP;                               // event:, id:, retry:, comment
+        break;
+      case LLM_LINE_JSON:
+        if (c == '\n') {                                            // never inside a JSON string
+          if (p->State == LLM_JSON_LITERAL) Json_Char(p, &s, ' ');
+          p->Line = LLM_LINE_START;
+          p->Prefix_Len = 0;
+          break;
+        }
+        Json_Char(p, &s, c);
+        break;
+      default:
+        if (c == '\n') {
+          p->Line = LLM_LINE_START;
+          p->Prefix_Len = 0;
+        }
+        break;
+    }
+  }
+  Sink_Flush(&s, false);
+  return s.Tokens;
+}
+
+/************************************************************  Client  ************************************************************/
+static uint16_t Json_Escape(char* dst, uint16_t size, const char* src)
+{
+  uint16_t n = 0;
+  for (; *src && n + 7 < size; src++) {
+    uint8_t c = *src;
+    if (c == '"' || c == '\\') { dst[n++] = '\\'; dst[n++] = c; }
+    else if (c == '\n') { dst[n++] = '\\'; dst[n++] = 'n'; }
+    else if (c == '\r') { dst[n++] = '\\'; dst[n++] = 'r'; }
+    else if (c == '\t') { dst[n++] = '\\'; dst[n++] = 't'; }
+    else if (c < 0x20) n += snprintf(dst + n, size - n, "\\u%04x", c);
+    else dst[n++] = c;
+  }
+  dst[n] = '\0';
+  return n;
+}
+static void Text_Out(void* arg, const char* text, uint16_t len, bool token_end)
+{
+  if (token_end) {
+    LLM_Stat.Tokens++;
+    if (LLM_Stat.Tokens == 1) LLM_Stat.First_Token_Ms = millis() - Request_Time;
+  }
+  if (!len) return;
+  size_t sent = xStreamBufferSend(Text_Buffer, text, len, 0);
+  LLM_Stat.Bytes += sent;
+  LLM_Stat.Dropped += len - sent;
+  if (sent && !Text_Since) Text_Since = millis() | 1;
+}
+static int Read_Line(WiFiClient &client, char* line, uint16_t size)
+{
+  // header line without CR LF, -1: timeout or closed
+  uint16_t n = 0;
+  uint32_t t = millis();
+  while (true) {
+    if (!client.available()) {
+      if (!client.connected() || millis() - t > LLM_TIMEOUT_MS) return -1;
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+    int c = client.read();
+    if (c == '\n') break;
+    if (c != '\r' && n + 1 < size) line[n++] = c;
+  }
+  line[n] = '\0';
+  return n;
+}
+static uint8_t LLM_Request()
+{
+  static char body[LLM_PROMPT_LEN * 2 + 160];
+  static uint8_t buf[1460];
+  char line[256];
+  WiFiClient client;
+  AudioHTTPBody http;
+
+  Request_Time = millis();
+  if (!client.connect(LLM_Host, LLM_Port, LLM_TIMEOUT_MS)) {
+    printf("LLM: no connection to %s:%u\r\n", LLM_Host, LLM_Port);
+    return LLM_ERROR;
+  }
+  uint16_t n = snprintf(body, sizeof(body), "{\"model\":\"%s\",\"stream\":true,\"messages\":[{\"role\":\"user\",\"content\":\"", LLM_Model);
+  n += Json_Escape(body + n, sizeof(body) - n - 8, LLM_Prompt);
+  n += snprintf(body + n, sizeof(body) - n, "\"}]}");
+  client.setNoDelay(true);
+  client.printf("POST %s HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: application/json\r\nAccept: text/event-stream\r\n"
+                "Content-Length: %u\r\nConnection: close\r\n\r\n", LLM_PATH, LLM_Host, LLM_Port, n);
+  client.write((const uint8_t*)body, n);
+
+  if (Read_Line(client, line, sizeof(line)) < 12) return LLM_ERROR;
+  int status = atoi(line + 9);
+  bool chunked = false;
+  while (true) {
+    int len = Read_Line(client, line, sizeof(line));
+    if (len < 0) return LLM_ERROR;
+    if (len == 0) break;
+    if (!strncasecmp(line, "transfer-encoding:", 18) && strcasestr(line + 18, "chunked")) chunked = true;
+  }
+  if (status != 200) {
+    printf("LLM: HTTP %d\r\n", status);
+    return LLM_ERROR;
+  }
+
+  LLM_Status = LLM_STREAMING;
+  http.begin(chunked, 0);
+  LLM_Parser_Reset(&Parser);
+  uint32_t t = millis();
+  while (!Parser.Done && !http.isEnd()) {
+    int avail = client.available();
+    if (!avail) {
+      if (!client.connected()) break;
+      if (millis() - t > LLM_TIMEOUT_MS) {
+        printf("LLM: timeout\r\n");
+        return LLM_ERROR;
+      }
+      vTaskDelay(pdMS_TO_TICKS(2));
+      continue;
+    }
+    t = millis();
+    int r = client.read(buf, avail < (int)sizeof(buf) ? avail : sizeof(buf));
+    if (r <= 0) continue;
+    uint32_t len = http.decode(buf, r);                             // chunk framing out, in place
+    LLM_Parser_Feed(&Parser, buf, len, Text_Out, NULL);
+  }
+  client.stop();
+  return LLM_DONE;
+}
+static void LLM_Task(void *parameter)
+{
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    LLM_Status = LLM_Request();
+    printf("LLM: %lu tokens, %lu bytes, first token after %lu ms\r\n", (unsigned long)LLM_Stat.Tokens,
+           (unsigned long)LLM_Stat.Bytes, (unsigned long)LLM_Stat.First_Token_Ms);
+  }
+  vTaskDelete(NULL);
+}
+
+void LLM_Init(const char* host, uint16_t port, const char* model)
+{
+  strlcpy(LLM_Host, host, sizeof(LLM_Host));
+  strlcpy(LLM_Model, model, sizeof(LLM_Model));
+  LLM_Port = port;
+  if (LLM_Task_Handle) return;
+  Text_Buffer = xStreamBufferCreate(LLM_TEXT_BUFFER, 1);
+  xTaskCreatePinnedToCore(
+    LLM_Task,
+    "LLM_Task",
+    6144,
+    NULL,
+    2,                                              // below audio and LVGL
+    &LLM_Task_Handle,
+    0
+  );
+}
+bool LLM_Ask(const char* prompt)
+{
+  if (!LLM_Task_Handle || LLM_Status == LLM_CONNECTING || LLM_Status == LLM_STREAMING) return false;
+  strlcpy(LLM_Prompt, prompt, sizeof(LLM_Prompt));
+  memset(&LLM_Stat, 0, sizeof(LLM_Stat));
+  LLM_Status = LLM_CONNECTING;
+  xTaskNotifyGive(LLM_Task_Handle);
+  return true;
+}
+uint8_t LLM_State()
+{
+  return LLM_Status;
+}
+const LLM_Stats* LLM_Get_Stats()
+{
+  return &LLM_Stat;
+}
+
+/************************************************************  Transcript  ************************************************************/
+static lv_obj_t* Transcript_Label(lv_obj_t* transcript)
+{
+  lv_obj_t* label = lv_label_create(transcript);
+  lv_obj_set_width(label, lv_pct(100));
+  lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+  lv_label_set_line_cache(label, true);                             // an append lays out and redraws the last lines only
+  lv_label_set_text(label, "");
+  return label;
+}
+static void Transcript_Split(lv_obj_t* transcript, lv_obj_t* tail)
+{
+  // the full lines stay in tail, the last one goes on in a new label: it starts a line there as it did in tail,
+  // so the text is broken at the same places and nothing moves on the screen
+  lv_coord_t width = lv_obj_get_content_width(tail);
+  if (width <= 0) return;                                           // not yet laid out
+  const char* text = lv_label_get_text(tail);
+  const lv_font_t* font = lv_obj_get_style_text_font(tail, LV_PART_MAIN);
+  lv_coord_t letter_space = lv_obj_get_style_text_letter_space(tail, LV_PART_MAIN);
+  uint32_t start = 0;
+  uint32_t last = 0;
+  while (text[start]) {
+    last = start;
+    start += _lv_txt_get_next_line(&text[start], font, letter_space, width, NULL, LV_TEXT_FLAG_NONE);
+  }
+  if (last == 0) return;                                            // one line only
+  lv_obj_t* next = Transcript_Label(transcript);
+  lv_label_set_text(next, &text[last]);
+  lv_label_cut_text(tail, _lv_txt_encoded_get_char_id(text, last), _lv_txt_get_encoded_length(&text[last]));
+}
+void LLM_Transcript_Append(lv_obj_t* transcript, const char* text)
+{
+  uint32_t len = strlen(text);
+  if (!len) return;
+  uint32_t total = (uint32_t)(uintptr_t)lv_obj_get_user_data(transcript) + len;
+  bool follow = lv_obj_get_scroll_bottom(transcript) <= 0;          // the user did not scroll back
+  lv_obj_t* tail = lv_obj_get_child(transcript, -1);
+  if (!tail) tail = Transcript_Label(transcript);
+  lv_label_ins_text(tail, LV_LABEL_POS_LAST, text);
+  if (strlen(lv_label_get_text(tail)) > LLM_LABEL_CHUNK) Transcript_Split(transcript, tail);
+  while (total > LLM_TRANSCRIPT_MAX && lv_obj_get_child_cnt(transcript) > 2) {
+    lv_obj_t* first = lv_obj_get_child(transcript, 0);
+    total -= strlen(lv_label_get_text(first));
+    lv_obj_del(first);
+  }
+  lv_obj_set_user_data(transcript, (void*)(uintptr_t)total);        // bytes shown
+  if (follow) {
+    lv_obj_update_layout(transcript);
+    lv_obj_scroll_to_y(transcript, LV_COORD_MAX, LV_ANIM_OFF);      // bounded to the end of the text
+  }
+}
+static void Transcript_Timer_Cb(lv_timer_t* timer)
+{
+  // the text of the stream buffer goes to the transcript, an UTF-8 sequence that is not complete waits
+  static char text[LLM_LABEL_CHUNK + 4];
+  static uint8_t carry = 0;
+  if (!Text_Buffer) return;
+  size_t n = xStreamBufferReceive(Text_Buffer, text + carry, LLM_LABEL_CHUNK - carry, 0);
+  if (!n) return;
+  n += carry;
+  size_t end = n;
+  size_t i = n;
+  while (i > 0 && n - i < 3 && ((uint8_t)text[i - 1] & 0xC0) == 0x80) i--;   // continuation bytes at the end
+  if (i > 0 && (uint8_t)text[i - 1] >= 0xC0) {
+    uint8_t c = text[i - 1];
+    uint8_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+    if (n - (i - 1) < need) end = i - 1;                            // the rest of it comes with the next read
+  }
+  char keep[4];
+  carry = n - end;
+  memcpy(keep, text + end, carry);
+  text[end] = '\0';
+  lv_obj_t* transcript = (lv_obj_t*)timer->user_data;
+  LLM_Transcript_Append(transcript, text);
+  memcpy(text, keep, carry);
+  lv_timer_t* refr = _lv_disp_get_refr_timer(lv_obj_get_disp(transcript));
+  if (refr) lv_timer_ready(refr);                                   // drawn with the next lv_timer_handler(), not a period later
+  uint32_t since = Text_Since;
+  if (since && !xStreamBufferBytesAvailable(Text_Buffer)) Text_Since = 0;
+  if (since) {
+    LLM_Stat.Render_Latency_Ms = millis() - since;
+    if (LLM_Stat.Render_Latency_Ms > LLM_Stat.Render_Latency_Max_Ms) LLM_Stat.Render_Latency_Max_Ms = LLM_Stat.Render_Latency_Ms;
+  }
+}
+static void Transcript_Delete_Event_Cb(lv_event_t* e)
+{
+  if (!Transcript_Timer || Transcript_Timer->user_data != lv_event_get_target(e)) return;
+  lv_timer_del(Transcript_Timer);
+  Transcript_Timer = NULL;
+}
+lv_obj_t* LLM_Transcript_Create(lv_obj_t* parent, lv_coord_t w, lv_coord_t h)
+{
+  lv_obj_t* transcript = lv_obj_create(parent);
+  lv_obj_remove_style_all(transcript);
+  lv_obj_set_size(transcript, w, h);
+  lv_obj_set_flex_flow(transcript, LV_FLEX_FLOW_COLUMN);
+  lv_obj_set_style_pad_row(transcript, lv_obj_get_style_text_line_space(transcript, LV_PART_MAIN), 0);   // labels join like lines
+  lv_obj_set_scroll_dir(transcript, LV_DIR_VER);
+  lv_obj_set_user_data(transcript, NULL);
+  lv_obj_add_event_cb(transcript, Transcript_Delete_Event_Cb, LV_EVENT_DELETE, NULL);
+  if (Transcript_Timer) lv_timer_del(Transcript_Timer);             // one transcript takes the stream
+  Transcript_Timer = lv_timer_create(Transcript_Timer_Cb, LLM_RENDER_PERIOD, transcript);
+  return transcript;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "Arduino.h"
+#include <cstring>
+#include <WiFi.h>
+#include <lvgl.h>
+
+#define LLM_HOST_LEN          64
+#define LLM_MODEL_LEN         48
+#define LLM_PROMPT_LEN        1024                  // the request body is built from it
+#define LLM_PATH              "/v1/chat/completions" // OpenAI compatible: llama.cpp server, Ollama, LM Studio
+#define LLM_TEXT_BUFFER       4096                  // decoded text on its way from the client task to LVGL
+#define LLM_TIMEOUT_MS        15000                 // connect, first byte, no data
+#define LLM_KEY_LEN           16                    // JSON keys that are compared, longer ones never match
+#define LLM_LABEL_CHUNK       1024                  // bytes of the label that grows, full lines go to a label of their own
+#define LLM_TRANSCRIPT_MAX    8192                  // older labels are deleted
+#define LLM_RENDER_PERIOD     30                    // ms, the appended text is taken over once per period
+
+enum {
+  LLM_IDLE = 0,
+  LLM_CONNECTING,                                   // request sent, waiting for the header
+  LLM_STREAMING,
+  LLM_DONE,
+  LLM_ERROR,
+};
+
+typedef struct {
+  uint32_t Tokens;                                  // content strings of the stream, one per event
+  uint32_t Bytes;                                   // UTF-8 text
+  uint32_t Dropped;                                 // text buffer full, LVGL did not keep up
+  uint32_t First_Token_Ms;                          // request to the first token
+  uint32_t Render_Latency_Ms;                       // text received to label, last and worst
+  uint32_t Render_Latency_Max_Ms;
+} LLM_Stats;
+
+typedef struct {                                    // incremental SSE / NDJSON and JSON scanner, no allocation
+  uint8_t  Line;                                    // LLM_LINE_*
+  uint8_t  Prefix_Len;                              // of "data:"
+  uint8_t  State;                                   // LLM_JSON_*
+  uint8_t  Depth;
+  uint32_t Objects;                                 // bit n: level n is an object (else an array)
+  bool     Expect_Key;
+  bool     Is_Key;
+  bool     Emit;                                    // the string is content
+  uint8_t  Key_Len;                                 // > LLM_KEY_LEN: too long
+  char     Key[LLM_KEY_LEN + 1];
+  char     Value_Of[LLM_KEY_LEN + 1];               // the key of the value that follows
+  uint8_t  Hex_Len;
+  uint16_t Hex;
+  uint16_t Surrogate;                               // high surrogate of a \u pair
+  uint8_t  Literal_Len;
+  char     Literal[6];
+  bool     Done;                                    // data: [DONE] or "done": true
+} LLM_Parser;
+
+typedef void (*LLM_Text_Cb)(void* arg, const char* text, uint16_t len, bool token_end);
+
+// library only, see LLM_Client.cpp: no caller in the firmware, tests/test_llm_client.cpp runs it against a stand-in
+// server
+void    LLM_Init(const char* host, uint16_t port, const char* model);          // starts the client task
+bool    LLM_Ask(const char* prompt);                                            // false: a request is running
+uint8_t LLM_State();
+const LLM_Stats* LLM_Get_Stats();
+
+void     LLM_Parser_Reset(LLM_Parser* p);
+uint32_t LLM_Parser_Feed(LLM_Parser* p, const uint8_t* data, uint32_t len, LLM_Text_Cb cb, void* arg); // returns the tokens
+
+lv_obj_t* LLM_Transcript_Create(lv_obj_t* parent, lv_coord_t w, lv_coord_t h);  // scrolls with the answer
+void      LLM_Transcript_Append(lv_obj_t* transcript, const char* text);          // LVGL task
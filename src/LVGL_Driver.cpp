@@ -40,6 +40,12 @@ void Lvgl_Touchpad_Read( lv_indev_drv_t * indev_drv, lv_indev_data_t * data )
   touch_data.points = 0;
   touch_data.gesture = NONE;
 }
+/*Touch feedback, a short click sound through the audio mixer*/
+void Lvgl_Touchpad_Feedback( lv_indev_drv_t * indev_drv, uint8_t code )
+{
+  if (code == LV_EVENT_CLICKED)
+    Audio_Click();
+}
 void example_increase_lvgl_tick(void *arg)
 {
     /* Tell LVGL how many milliseconds has elapsed */
@@ -70,6 +76,7 @@ void Lvgl_Init(void)
   lv_indev_drv_init( &indev_drv );
   indev_drv.type = LV_INDEV_TYPE_POINTER;
   indev_drv.read_cb = Lvgl_Touchpad_Read;
+  indev_drv.feedback_cb = Lvgl_Touchpad_Feedback;
   lv_indev_drv_register( &indev_drv );
 
   /* Create simple label */
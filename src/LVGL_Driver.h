@@ -6,6 +6,7 @@
 #include <esp_heap_caps.h>
 #include "Display_ST77916.h"
 #include "Touch_CST816.h"
+#include "Audio_PCM5101.h"
 
 #define LCD_WIDTH     EXAMPLE_LCD_WIDTH
 #define LCD_HEIGHT    EXAMPLE_LCD_HEIGHT
@@ -17,6 +18,7 @@
 void Lvgl_print(const char * buf);
 void Lvgl_Display_LCD( lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p ); // Displays LVGL content on the LCD.    This function implements associating LVGL data to the LCD screen
 void Lvgl_Touchpad_Read( lv_indev_drv_t * indev_drv, lv_indev_data_t * data );                // Read the touchpad
+void Lvgl_Touchpad_Feedback( lv_indev_drv_t * indev_drv, uint8_t code );                      // Click sound
 void example_increase_lvgl_tick(void *arg);
 
 void Lvgl_Init(void);
@@ -18,6 +18,8 @@
 #define DEG_STEP            (180/BAR_CNT)
 #define BAND_CNT            4
 #define BAR_PER_BAND_CNT    (BAR_CNT / BAND_CNT)
+#define LIST_ROW_HEIGHT     60
+#define LIST_HEIGHT         (LV_VER_RES - LIST_ROW_HEIGHT)
 
 
 /**********************
@@ -33,6 +35,7 @@ static lv_obj_t * spectrum_obj;
 static lv_obj_t * title_label;
 static lv_obj_t * time_obj;
 static lv_obj_t * album_img_obj;
+static lv_timer_t  * album_art_timer = NULL;
 static lv_obj_t * slider_obj;
 static uint32_t spectrum_i = 0;
 static uint32_t spectrum_i_pause = 0;
@@ -54,9 +57,7 @@ static const uint16_t rnd_array[30] = {994, 285, 553, 11, 792, 707, 966, 641, 85
 
 
 
-char SD_Name[100][100] ;    
-char File_Name[100][100] ;     
-char Audio_Name[100] ;         
+char Audio_Name[LIBRARY_TAG_LEN] ;  
 uint16_t ACTIVE_TRACK_CNT;     
 uint32_t Audio_duration;      
 uint32_t Audio_duration_A;        
@@ -64,6 +65,7 @@ uint32_t Audio_Elapsed;
 uint16_t Audio_energy;         
 
 static lv_obj_t * list;
+static uint32_t list_checked_id = UINT32_MAX;
 static lv_style_t style_btn_round;
 static lv_style_t style_btn_pr;
 static lv_style_t style_btn_play;
@@ -143,7 +145,6 @@ lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent)
 
     lv_obj_t * list_box = create_List_box(panel2);
     
-    lv_obj_set_size(list_box, LV_SIZE_CONTENT, LV_SIZE_CONTENT);               
     // lv_obj_add_style(list_box, &music_style, 0);
 
     static lv_coord_t grid_2_col_dsc[] = {LV_GRID_FR(1),LV_GRID_FR(1),  LV_GRID_TEMPLATE_LAST};
@@ -442,10 +443,51 @@ lv_obj_t * album_img_create(lv_obj_t * parent)
   lv_img_set_antialias(img, false);                                            
   lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);                                   
   lv_obj_add_event_cb(img, album_gesture_event_cb, LV_EVENT_GESTURE, NULL);   
+  lv_obj_add_event_cb(img, album_img_delete_event_cb, LV_EVENT_DELETE, NULL); 
+  lv_obj_set_user_data(img, NULL);                                            // the thumbnail that is held
+  if(album_art_timer) lv_timer_del(album_art_timer);                          // the previous track is not shown anymore
+  album_art_timer = NULL;
+  if(!album_art_set(img)) {                                                   // decoding, the cover above is shown meanwhile
+    album_art_timer = lv_timer_create(album_art_timer_cb, 50, img);
+    lv_timer_set_repeat_count(album_art_timer, 60);
+  }
   lv_obj_clear_flag(img, LV_OBJ_FLAG_GESTURE_BUBBLE);                         
   lv_obj_add_flag(img, LV_OBJ_FLAG_CLICKABLE);                                
   return img;
 }
+bool album_art_set(lv_obj_t * img)
+{
+  // true if the album art of the track is shown or there is none
+  char name[LIBRARY_NAME_LEN];
+  const lv_img_dsc_t * art = NULL;
+  if(!Library_Name(track_id, name, sizeof(name))) return true;
+  uint8_t state = Album_Art_Get(name, &art);
+  if(state == ALBUM_ART_READY) {
+    lv_img_set_src(img, art);                                                 
+    lv_obj_set_user_data(img, (void *)art);
+  }
+  return state != ALBUM_ART_PENDING;
+}
+void album_art_timer_cb(lv_timer_t * t)
+{
+  bool last = (t->repeat_count == 0);                                        // LVGL deletes the timer after the last call
+  if(album_art_set((lv_obj_t *)t->user_data)) {
+    if(!last) lv_timer_del(t);
+    album_art_timer = NULL;
+  }
+  else if(last) {                                                             // given up, the default cover stays
+    album_art_timer = NULL;
+  }
+}
+void album_img_delete_event_cb(lv_event_t * e)
+{
+  lv_obj_t * img = lv_event_get_target(e);
+  if(album_art_timer && album_art_timer->user_data == img) {
+    lv_timer_del(album_art_timer);
+    album_art_timer = NULL;
+  }
+  Album_Art_Release((const lv_img_dsc_t *)lv_obj_get_user_data(img));
+}
 void spectrum_anim_cb(void * a, int32_t v)
 {
   lv_obj_t * obj = (lv_obj_t *)a;
@@ -738,6 +780,14 @@ void hide_slider(lv_event_t * e) {
 void timer_cb(lv_timer_t * t)
 {
   LV_UNUSED(t);                                                             
+  if(Music_Next_Started()) {                                                // the player has continued with the queued track
+    uint32_t id = (track_id + 1) % ACTIVE_TRACK_CNT;
+    Audio_Elapsed = 0;
+    LVGL_Gapless_Music(id);
+    track_load(id);
+    _lv_demo_music_resume();
+    return;
+  }
   if(Audio_duration == 0){
     Audio_duration = Music_Duration();                            
     if(Audio_duration != 0) 
@@ -749,7 +799,7 @@ void timer_cb(lv_timer_t * t)
     time_act++;                                                               
     lv_label_set_text_fmt(time_obj, "%"LV_PRIu32":%02"LV_PRIu32, time_act / 60, time_act % 60);   
     lv_slider_set_value(slider_obj, time_act, LV_ANIM_ON);  
-    if(time_act >= Audio_duration){                             
+    if(time_act >= Audio_duration && !audio.isRunning()){      // the queued track could not be started
       _lv_demo_music_album_next(true);    
     }
   }                 
@@ -794,27 +844,16 @@ lv_obj_t * create_List_box(lv_obj_t * parent)
   lv_style_set_text_font(&style_title, font_small);                         
   lv_style_set_text_color(&style_title, lv_color_hex(0x101010));            
     
-  list = lv_obj_create(parent);
-  lv_obj_remove_style_all(list);                                            
-  lv_obj_set_size(list, LV_SIZE_CONTENT, LV_SIZE_CONTENT);                  
-  lv_obj_set_pos(list, 0, LV_DEMO_MUSIC_HANDLE_SIZE);                       
-  // lv_obj_set_y(list, LV_DEMO_MUSIC_HANDLE_SIZE);
+  // only the visible rows exist, they are bound to the tracks of the library while scrolling
+  list = Virtual_List_Create(parent, lv_pct(100), LIST_HEIGHT, LIST_ROW_HEIGHT, list_row_create, list_row_bind, NULL);
   lv_obj_add_style(list, &music_style, LV_PART_SCROLLBAR);
-  lv_obj_set_flex_flow(list, LV_FLEX_FLOW_COLUMN);
-
-  uint32_t List_id;
-  for(List_id = 0; List_id < ACTIVE_TRACK_CNT; List_id++) {                 
-      add_list_btn(list,  List_id);                                         
-  }
   lv_obj_set_scroll_snap_y(list, LV_SCROLL_SNAP_CENTER);                    
+  Virtual_List_Set_Count(list, ACTIVE_TRACK_CNT);
   _lv_demo_music_list_btn_check(0, true);                                         
   return list;
 }
-lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t List_id)
+void list_row_create(lv_obj_t * btn, void * user_data)
 {
-  lv_obj_t * btn = lv_obj_create(parent);                                  
-  lv_obj_remove_style_all(btn);                                             
-  lv_obj_set_size(btn, lv_pct(100), 60);  
   lv_obj_add_style(btn, &style_btn_round, 0);                                  
 
   lv_obj_add_style(btn, &style_btn_stop, 0);                                
@@ -828,7 +867,7 @@ lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t List_id)
   lv_obj_set_grid_cell(icon, LV_GRID_ALIGN_START, 0, 1, LV_GRID_ALIGN_CENTER, 0, 2);  
 
   lv_obj_t * title_label = lv_label_create(btn);                           
-  lv_label_set_text(title_label, File_Name[List_id]);                       
+  lv_label_set_text(title_label, "");                       
   lv_obj_set_grid_cell(title_label, LV_GRID_ALIGN_START, 1, 1, LV_GRID_ALIGN_CENTER, 0, 1);
   lv_obj_add_style(title_label, &style_title, 0);
 
@@ -838,23 +877,38 @@ lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t List_id)
   // lv_obj_set_width(border, lv_pct(120));                                    
   // lv_obj_align(border, LV_ALIGN_BOTTOM_MID, 0, 0);                          
   // lv_obj_add_flag(border, LV_OBJ_FLAG_IGNORE_LAYOUT);                       
-  return btn;
 }
-
-void _lv_demo_music_list_btn_check(uint32_t List_id, bool state)
+void list_row_bind(lv_obj_t * btn, uint32_t List_id, void * user_data)
+{
+  char title[LIBRARY_TAG_LEN];
+  Library_Title(List_id, title, sizeof(title));                              // one page read at most
+  lv_label_set_text(lv_obj_get_child(btn, 1), title);
+  list_row_state(btn, List_id == list_checked_id);
+}
+void list_row_state(lv_obj_t * btn, bool state)
 {
-  lv_obj_t * btn = lv_obj_get_child(list, List_id);                           
   lv_obj_t * icon = lv_obj_get_child(btn, 0);                                
-
   if(state) {
     lv_obj_add_state(btn, LV_STATE_CHECKED);                                  
     lv_img_set_src(icon, &img_lv_demo_music_btn_list_pause);                  
-    lv_obj_scroll_to_view(btn, LV_ANIM_ON);                                   
   }
   else {
     lv_obj_clear_state(btn, LV_STATE_CHECKED);                                
     lv_img_set_src(icon, &img_lv_demo_music_btn_list_play);                   
   }
+}
+
+void _lv_demo_music_list_btn_check(uint32_t List_id, bool state)
+{
+  if(state)
+    list_checked_id = List_id;
+  else if(list_checked_id == List_id)
+    list_checked_id = UINT32_MAX;
+  lv_obj_t * btn = Virtual_List_Get_Row(list, List_id);                      // NULL if the row is not created
+  if(btn)
+    list_row_state(btn, state);
+  if(state)
+    Virtual_List_Scroll_To(list, List_id, LV_ANIM_ON);                       
   // lv_obj_scroll_to_view(panel1, LV_ANIM_ON);                               
   lv_obj_invalidate(panel1);                                                 
 }
@@ -862,7 +916,7 @@ void _lv_demo_music_list_btn_check(uint32_t List_id, bool state)
 void btn_click_event_cb(lv_event_t * e)
 {
   lv_obj_t * btn = lv_event_get_target(e);                                    
-  uint32_t idx = lv_obj_get_child_id(btn);                                    
+  uint32_t idx = Virtual_List_Get_Index(btn);                                 
   _lv_demo_music_play(idx);                                                   
 }
 
@@ -953,28 +1007,35 @@ void _lv_demo_music_pause(void)
  *  Other         *  Other         *  Other         *  Other                   
 ************************************************************************************************************************************/
 
-void remove_file_extension(char *file_name) {
-  char *last_dot = strrchr(file_name, '.');
-  if (last_dot != NULL) {
-    *last_dot = '\0'; 
-  }
-}
 void LVGL_Search_Music() {        
-  ACTIVE_TRACK_CNT = Folder_retrieval("/",".mp3",SD_Name,100);
+  ACTIVE_TRACK_CNT = Library_Init("/",".mp3",false);              // only the header is read if nothing has changed
+  Album_Art_Init();
   if(ACTIVE_TRACK_CNT) {  
-    for (int i = 0; i < ACTIVE_TRACK_CNT; i++) {
-      strcpy(File_Name[i], SD_Name[i]);
-      remove_file_extension(File_Name[i]); 
-    }                
     LVGL_Play_Music(0);    
   }                                                             
 }
 void LVGL_Play_Music(uint32_t ID) {
-  Play_Music("/",SD_Name[ID]);
-  strncpy(Audio_Name,File_Name[ID], sizeof(File_Name[ID]));       
+  char name[LIBRARY_NAME_LEN];
+  Library_Name(ID, name, sizeof(name));
+  Play_Music("/",name);
+  Album_Art_Request("/",name);
+  Library_Title(ID, Audio_Name, sizeof(Audio_Name));       
   Audio_duration = Music_Duration();  
   // while(Audio_duration == 0)   
   //   Audio_duration = Music_Duration();  
+  Library_Name((ID + 1) % ACTIVE_TRACK_CNT, name, sizeof(name));
+  Music_Queue_Next("/",name);
+  Album_Art_Request("/",name);                                    // decoded ahead like the audio
+}
+void LVGL_Gapless_Music(uint32_t ID) {                            // the player is already on this track
+  char name[LIBRARY_NAME_LEN];
+  Library_Name(ID, name, sizeof(name));
+  Album_Art_Request("/",name);                                    // normally cached by the pre-roll request
+  Library_Title(ID, Audio_Name, sizeof(Audio_Name));       
+  Audio_duration = Music_Duration();  
+  Library_Name((ID + 1) % ACTIVE_TRACK_CNT, name, sizeof(name));
+  Music_Queue_Next("/",name);
+  Album_Art_Request("/",name);                                    // decoded ahead like the audio
 }
 void LVGL_Elapsed_Music() {
   Audio_Elapsed = Music_Elapsed();                             
@@ -11,6 +11,9 @@
 #include <demos/music/assets/spectrum_3.h>
 
 #include "SD_Card.h"
+#include "Music_Library.h"
+#include "LVGL_Virtual_List.h"
+#include "Album_Art.h"
 #include "Audio_PCM5101.h"
 
 /**********************
@@ -39,7 +42,9 @@ void _lv_demo_music_pause(void);
  *   STATIC FUNCTIONS
  **********************/
 lv_obj_t * create_List_box(lv_obj_t * parent);
-lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t track_id);
+void list_row_create(lv_obj_t * btn, void * user_data);
+void list_row_bind(lv_obj_t * btn, uint32_t track_id, void * user_data);
+void list_row_state(lv_obj_t * btn, bool state);
 void _lv_demo_music_list_btn_check(uint32_t track_id, bool state);
 void btn_click_event_cb(lv_event_t * e);
 
@@ -57,6 +62,9 @@ void spectrum_draw_event_cb(lv_event_t * e);
 void spectrum_anim_cb(void * a, int32_t v);
 void start_anim_cb(void * a, int32_t v);
 lv_obj_t * album_img_create(lv_obj_t * parent);
+bool album_art_set(lv_obj_t * img);
+void album_art_timer_cb(lv_timer_t * t);
+void album_img_delete_event_cb(lv_event_t * e);
 void album_gesture_event_cb(lv_event_t * e);
 void play_event_click_cb(lv_event_t * e);
 void prev_click_event_cb(lv_event_t * e);
@@ -76,6 +84,7 @@ void LVGL_Search_Music();
 void LVGL_Resume_Music();
 void LVGL_Pause_Music();  
 void LVGL_Play_Music(uint32_t ID);  
+void LVGL_Gapless_Music(uint32_t ID);
 void LVGL_Elapsed_Music(); 
 uint16_t LVGL_Music_Energy();   
 void LVGL_volume_adjustment(uint8_t Volume);
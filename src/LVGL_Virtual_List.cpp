@@ -0,0 +1,132 @@
+#include "LVGL_Virtual_List.h"
+
+typedef struct {
+  Virtual_List_Create_cb create_cb;
+  Virtual_List_Bind_cb bind_cb;
+  void * user_data;
+  lv_coord_t row_height;
+  uint32_t count;
+  uint16_t pool;                                                    // rows that exist
+  uint16_t created;
+  lv_obj_t ** rows;                                                 // the row of index i is rows[i % pool]
+} Virtual_List_t;
+
+#define ROW_UNBOUND   0                                             // user data of a row: index + 1
+
+static void Virtual_List_Update(lv_obj_t * list)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  if(!vl || !vl->created) return;
+  int32_t first = lv_obj_get_scroll_y(list) / vl->row_height - VIRTUAL_LIST_MARGIN;
+  if(first < 0) first = 0;
+  if(vl->count > vl->pool && (uint32_t)first > vl->count - vl->pool) first = vl->count - vl->pool;
+  uint32_t last = LV_MIN(vl->count, first + (uint32_t)vl->created);
+  for(uint32_t i = first; i < last; i++) {
+    lv_obj_t * row = vl->rows[i % vl->pool];
+    if((uintptr_t)lv_obj_get_user_data(row) == i + 1) continue;     // already shows this index
+    lv_obj_set_user_data(row, (void *)(uintptr_t)(i + 1));
+    lv_obj_set_y(row, i * vl->row_height);
+    lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+    vl->bind_cb(row, i, vl->user_data);
+  }
+  for(uint16_t k = vl->count; k < vl->created; k++) {              // fewer entries than rows
+    lv_obj_add_flag(vl->rows[k], LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_user_data(vl->rows[k], (void *)ROW_UNBOUND);
+  }
+}
+static void Virtual_List_Event_cb(lv_event_t * e)
+{
+  lv_obj_t * list = lv_event_get_target(e);
+  lv_event_code_t code = lv_event_get_code(e);
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  if(!vl) return;
+  if(code == LV_EVENT_SCROLL) {
+    Virtual_List_Update(list);
+  }
+  else if(code == LV_EVENT_GET_SELF_SIZE) {                         // the scroll range covers all entries
+    lv_point_t * p = (lv_point_t *)lv_event_get_param(e);
+    p->y = LV_MAX(p->y, (lv_coord_t)(vl->count * vl->row_height));
+  }
+  else if(code == LV_EVENT_DELETE) {
+    lv_mem_free(vl->rows);
+    lv_mem_free(vl);
+    lv_obj_set_user_data(list, NULL);
+  }
+}
+
+lv_obj_t * Virtual_List_Create(lv_obj_t * parent, lv_coord_t width, lv_coord_t height, lv_coord_t row_height,
+                               Virtual_List_Create_cb create_cb, Virtual_List_Bind_cb bind_cb, void * user_data)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_mem_alloc(sizeof(Virtual_List_t));
+  if(!vl) return NULL;
+  lv_memset_00(vl, sizeof(Virtual_List_t));
+  vl->create_cb = create_cb;
+  vl->bind_cb = bind_cb;
+  vl->user_data = user_data;
+  vl->row_height = row_height;
+  vl->pool = (height + row_height - 1) / row_height + 1 + 2 * VIRTUAL_LIST_MARGIN;
+  vl->rows = (lv_obj_t **)lv_mem_alloc(vl->pool * sizeof(lv_obj_t *));
+  if(!vl->rows) {
+    lv_mem_free(vl);
+    return NULL;
+  }
+
+  lv_obj_t * list = lv_obj_create(parent);
+  lv_obj_remove_style_all(list);
+  lv_obj_set_size(list, width, height);
+  lv_obj_set_scroll_dir(list, LV_DIR_VER);
+  lv_obj_set_user_data(list, vl);
+  lv_obj_add_event_cb(list, Virtual_List_Event_cb, LV_EVENT_ALL, NULL);
+  return list;
+}
+void Virtual_List_Set_Count(lv_obj_t * list, uint32_t count)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  if(!vl) return;
+  vl->count = count;
+  while(vl->created < vl->pool && vl->created < count) {            // rows are created once and then reused
+    lv_obj_t * row = lv_obj_create(list);
+    lv_obj_remove_style_all(row);
+    lv_obj_set_size(row, lv_pct(100), vl->row_height);
+    lv_obj_set_user_data(row, (void *)ROW_UNBOUND);
+    vl->create_cb(row, vl->user_data);
+    vl->rows[vl->created++] = row;
+  }
+  lv_obj_refresh_self_size(list);
+  lv_obj_scroll_to_y(list, LV_MIN(lv_obj_get_scroll_y(list), LV_MAX(0, (lv_coord_t)(count * vl->row_height) - lv_obj_get_content_height(list))), LV_ANIM_OFF);
+  Virtual_List_Refresh(list);
+}
+uint32_t Virtual_List_Get_Count(lv_obj_t * list)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  return vl ? vl->count : 0;
+}
+void Virtual_List_Refresh(lv_obj_t * list)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  if(!vl) return;
+  for(uint16_t k = 0; k < vl->created; k++) lv_obj_set_user_data(vl->rows[k], (void *)ROW_UNBOUND);
+  Virtual_List_Update(list);
+}
+void Virtual_List_Scroll_To(lv_obj_t * list, uint32_t index, lv_anim_enable_t anim)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  if(!vl || index >= vl->count) return;
+  lv_coord_t y = index * vl->row_height - (lv_obj_get_content_height(list) - vl->row_height) / 2;
+  lv_coord_t max_y = vl->count * vl->row_height - lv_obj_get_content_height(list);
+  if(y > max_y) y = max_y;
+  if(y < 0) y = 0;
+  lv_obj_scroll_to_y(list, y, anim);
+}
+lv_obj_t * Virtual_List_Get_Row(lv_obj_t * list, uint32_t index)
+{
+  Virtual_List_t * vl = (Virtual_List_t *)lv_obj_get_user_data(list);
+  if(!vl || !vl->created || index >= vl->count) return NULL;
+  lv_obj_t * row = vl->rows[index % vl->pool];
+  if((uintptr_t)lv_obj_get_user_data(row) != index + 1) return NULL;
+  return row;
+}
+uint32_t Virtual_List_Get_Index(lv_obj_t * row)
+{
+  return (uint32_t)(uintptr_t)lv_obj_get_user_data(row) - 1;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <lvgl.h>
+
+#define VIRTUAL_LIST_MARGIN   2               // rows kept above and below the viewport
+
+/*
+ * A scrollable list that creates only the rows that can be seen, plus a margin. The rows have a fixed height and
+ * are placed by their index, there is no flex layout. When the list is scrolled, the rows that leave the viewport
+ * are moved to the other end and bound to the new index (the row of index i is always row i % pool size).
+ */
+typedef void (*Virtual_List_Create_cb)(lv_obj_t * row, void * user_data);                  // children of a new row
+typedef void (*Virtual_List_Bind_cb)(lv_obj_t * row, uint32_t index, void * user_data);    // show the data of index
+
+lv_obj_t * Virtual_List_Create(lv_obj_t * parent, lv_coord_t width, lv_coord_t height, lv_coord_t row_height,
+                               Virtual_List_Create_cb create_cb, Virtual_List_Bind_cb bind_cb, void * user_data);
+void       Virtual_List_Set_Count(lv_obj_t * list, uint32_t count);
+uint32_t   Virtual_List_Get_Count(lv_obj_t * list);
+void       Virtual_List_Refresh(lv_obj_t * list);                                           // bind the rows again
+void       Virtual_List_Scroll_To(lv_obj_t * list, uint32_t index, lv_anim_enable_t anim);  // index in the center
+lv_obj_t * Virtual_List_Get_Row(lv_obj_t * list, uint32_t index);                           // NULL: not created
+uint32_t   Virtual_List_Get_Index(lv_obj_t * row);
@@ -0,0 +1,188 @@
+#include "MIC_AEC.h"
+#include "resampler/resampler.h"
+
+// The audio task hands over what it writes to the DAC together with the time it will be played. Both sides use one
+// clock, esp_timer, counted in samples at AEC_RATE (AEC_Clock()): the I2S clocks and esp_timer come from the same
+// crystal, so nothing drifts. The reference is mixed down, resampled and stored at its playing time; the microphone
+// reader takes the reference at the time of its samples and runs a block NLMS filter over it, the echo estimate is
+// subtracted before ESP_SR and the VAD get the samples. The cost is fixed: 2 x AEC_TAPS multiply-adds per sample while
+// a reference plays, a copy when not.
+
+#define AEC_REF_MASK          (AEC_REF_SAMPLES - 1)
+#define AEC_WINDOW            (AEC_TAPS + AEC_BLOCK - 1)
+#define AEC_CHUNK             64                    // reference frames mixed down at a time
+#define AEC_OUT_MAX           768                   // resampler output of a chunk, up to 8 kHz -> 16 kHz
+#define AEC_GUARD             1024                  // the oldest reference may be overwritten while it is read
+#define AEC_CONVERGED         6.0f                  // dB ERLE: the echo estimate is good enough to detect near end speech
+#define AEC_FREEZE_MAX        1000                  // blocks (2 s) frozen in a row: the echo path has changed, adapt again
+
+static int16_t* Ref = NULL;
+static volatile uint32_t Ref_Next = 0;              // AEC_Clock() index behind the last reference sample
+static volatile uint32_t Ref_Start = 0;             // from here on the ring holds reference (or silence)
+static bool     Ref_Started = false;
+static uint32_t Ref_Rate = 0;
+static AudioResampler Resampler;
+static int16_t  Ref_Mono[AEC_CHUNK];
+static int16_t  Ref_Out[AEC_OUT_MAX];
+
+static volatile bool Enabled = true;
+static float    W[AEC_TAPS];                        // reversed: W[AEC_TAPS - 1] weighs the newest reference sample
+static float    X[AEC_WINDOW];
+static float    E[AEC_BLOCK];
+static uint8_t  Hold = 0;
+static uint16_t Frozen = 0;
+static AEC_Stats Stat;
+
+uint32_t AEC_Clock(int64_t us)
+{
+  return (uint32_t)(us * (AEC_RATE / 1000) / 1000);
+}
+bool AEC_Init()
+{
+  if (!Ref) {
+    size_t size = AEC_REF_SAMPLES * sizeof(int16_t);
+    Ref = (int16_t*)(psramFound() ? ps_malloc(size) : malloc(size));
+    if (!Ref) {
+      printf("AEC: no memory for the reference ring\r\n");
+      return false;
+    }
+    memset(Ref, 0, size);
+  }
+  memset(W, 0, sizeof(W));
+  Stat.ERLE = 0;
+  return true;
+}
+void AEC_Enable(bool on)
+{
+  Enabled = on;
+}
+
+/************************************************************  Reference  ************************************************************/
+static void Ref_Place(uint32_t pos)
+{
+  // silence was played in between (underrun, pause) or the DMA queue was restarted
+  uint32_t next = Ref_Next;
+  int32_t gap = pos - next;
+  if (Ref_Started && gap > 0 && gap < (int32_t)AEC_REF_SAMPLES) {
+    for (uint32_t i = next; i != pos; i++) Ref[i & AEC_REF_MASK] = 0;
+  }
+  else Ref_Start = pos;
+  Resampler.reset();
+  __atomic_store_n(&Ref_Next, pos, __ATOMIC_RELEASE);
+  Ref_Started = true;
+  Stat.Resyncs++;
+}
+void AEC_Reference(const int16_t* stereo, uint32_t frames, uint32_t rate, int64_t play_us)
+{
+  if (!Ref || !frames) return;
+  if (rate != Ref_Rate) {
+    if (!Resampler.setRates(rate, AEC_RATE, 1)) return;
+    Ref_Rate = rate;
+    Ref_Started = false;
+  }
+  // the first frame is played at play_us; small deviations are timing noise, the reference stays continuous
+  uint32_t pos = AEC_Clock(play_us);
+  int32_t off = pos - Ref_Next;
+  if (!Ref_Started || off > AEC_RESYNC || off < -AEC_RESYNC) Ref_Place(pos);
+
+  uint32_t next = Ref_Next;
+  while (frames) {
+    uint32_t n = frames < AEC_CHUNK ? frames : AEC_CHUNK;
+    while (n > 1 && Resampler.maxOutputFrames(n) > AEC_OUT_MAX) n >>= 1;
+    for (uint32_t i = 0; i < n; i++) Ref_Mono[i] = (stereo[2 * i] + stereo[2 * i + 1]) >> 1;
+    uint32_t out = Resampler.process(Ref_Mono, n, Ref_Out);
+    for (uint32_t i = 0; i < out; i++) Ref[(next + i) & AEC_REF_MASK] = Ref_Out[i];
+    next += out;
+    __atomic_store_n(&Ref_Next, next, __ATOMIC_RELEASE);
+    stereo += 2 * n;
+    frames -= n;
+  }
+}
+
+/************************************************************  Canceller  ************************************************************/
+static float Gather(uint32_t first, uint32_t len)
+{
+  // the reference that is not (or no longer) in the ring counts as silence
+  uint32_t next = __atomic_load_n(&Ref_Next, __ATOMIC_ACQUIRE);
+  uint32_t start = Ref_Start;
+  float energy = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    uint32_t idx = first + i;
+    int32_t age = next - idx;
+    float v = 0;
+    if (age > 0 && age <= (int32_t)(AEC_REF_SAMPLES - AEC_GUARD) && (int32_t)(idx - start) >= 0)
+      v = Ref[idx & AEC_REF_MASK];
+    X[i] = v;
+    energy += v * v;
+  }
+  return energy;
+}
+static void Cancel_Block(int16_t* mic, uint32_t n, uint32_t pos)
+{
+  // mic[2 * j] is taken at clock pos + j, its echo lies in the reference AEC_DELAY ... AEC_DELAY + AEC_TAPS - 1 before
+  uint32_t len = AEC_TAPS - 1 + n;
+  float energy = Gather(pos - AEC_DELAY - (AEC_TAPS - 1), len);
+  Stat.Blocks++;
+  if (energy < AEC_MIN_ENERGY * len) return;
+  Stat.Active_Blocks++;
+
+  float em = 0, ee = 0, ey = 0;
+  for (uint32_t j = 0; j < n; j++) {
+    const float* x = &X[j];
+    float y = 0;
+    for (int k = 0; k < AEC_TAPS; k++) y += W[k] * x[k];
+    float m = mic[2 * j];
+    float e = m - y;
+    E[j] = e;
+    em += m * m;
+    ee += e * e;
+    ey += y * y;
+    int32_t s = lrintf(e);
+    mic[2 * j] = s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+  }
+
+  // near end speech: the residual is much larger than the echo estimate of a converged filter
+  bool converged = Stat.ERLE > AEC_CONVERGED;
+  if (converged && ee > AEC_DT_RATIO * ey) {
+    Hold = AEC_DT_HOLD;
+    if (++Frozen > AEC_FREEZE_MAX) {
+      Stat.ERLE = 0;
+      Frozen = 0;
+    }
+    return;
+  }
+  Frozen = 0;
+  Stat.ERLE += 0.02f * (10.0f * log10f((em + 1.0f) / (ee + 1.0f)) - Stat.ERLE);
+  if (Hold) {
+    Hold--;
+    return;
+  }
+
+  // W += mu * sum(e[j] x[j]) / (n |x|^2), |x|^2 from the energy of the window
+  float step = AEC_MU / (n * energy * AEC_TAPS / len + AEC_TAPS * AEC_MIN_ENERGY);
+  for (uint32_t j = 0; j < n; j++) E[j] *= step;
+  for (int k = 0; k < AEC_TAPS; k++) {
+    float g = 0;
+    for (uint32_t j = 0; j < n; j++) g += E[j] * X[j + k];
+    W[k] += g;
+  }
+  Stat.Adapt_Blocks++;
+}
+void AEC_Process(int16_t* stereo, uint32_t frames, int64_t end_us)
+{
+  if (!Ref || !Enabled || !frames || !Ref_Started) return;
+  uint32_t t = micros();
+  uint32_t pos = AEC_Clock(end_us) - frames;        // the last sample is taken at end_us
+  int16_t* mic = stereo + MIC_SLOT;
+  for (uint32_t b = 0; b < frames; b += AEC_BLOCK) {
+    uint32_t n = frames - b < AEC_BLOCK ? frames - b : AEC_BLOCK;
+    Cancel_Block(mic + 2 * b, n, pos + b);
+  }
+  t = micros() - t;
+  Stat.Us = t * (AEC_RATE / 100) / frames;
+  if (Stat.Us > Stat.Us_Max) Stat.Us_Max = Stat.Us;
+}
+const AEC_Stats* AEC_Get_Stats()
+{
+  return &Stat;
+}
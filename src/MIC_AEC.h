@@ -0,0 +1,33 @@
+#pragma once
+#include "Arduino.h"
+#include <cstring>
+#include "MIC_Capture.h"
+
+#define AEC_RATE              MIC_SAMPLE_RATE       // the reference is resampled to the rate of the microphone
+#define AEC_TAPS              256                   // 16 ms of echo path behind AEC_DELAY
+#define AEC_BLOCK             32                    // samples per filter update, 2 ms
+#define AEC_DELAY             24                    // taps in front of the expected echo: timing error, resampler
+#define AEC_REF_BITS          13                    // 2^13 samples: 512 ms of reference, more than the DMA queue holds
+#define AEC_REF_SAMPLES       (1UL << AEC_REF_BITS)
+#define AEC_RESYNC            48                    // a reference block this far off its continuation is placed anew
+#define AEC_MU                0.5f                  // step size of the normalised update, 0 ... 1
+#define AEC_MIN_ENERGY        1600.0f               // mean square of the reference below this: nothing to cancel (rms 40)
+#define AEC_DT_RATIO          2.0f                  // residual above this times the echo estimate: near end speech
+#define AEC_DT_HOLD           8                     // blocks the adaptation stays frozen after near end speech
+
+typedef struct {
+  uint32_t Blocks;                                  // AEC_BLOCK each
+  uint32_t Active_Blocks;                           // with a reference to cancel
+  uint32_t Adapt_Blocks;                            // the filter was updated
+  uint32_t Resyncs;                                 // reference blocks placed anew (start, underrun, rate change)
+  float    ERLE;                                    // dB, smoothed over the active blocks
+  uint32_t Us;                                      // last call, worst call and all calls per 10 ms of audio
+  uint32_t Us_Max;
+} AEC_Stats;
+
+bool    AEC_Init();
+void    AEC_Enable(bool on);
+void    AEC_Reference(const int16_t* stereo, uint32_t frames, uint32_t rate, int64_t play_us);  // audio task: what goes to the DAC
+void    AEC_Process(int16_t* stereo, uint32_t frames, int64_t end_us);                          // mic reader, MIC_SLOT in place
+uint32_t AEC_Clock(int64_t us);                                                                // esp_timer µs -> AEC_RATE sample index
+const AEC_Stats* AEC_Get_Stats();
@@ -0,0 +1,271 @@
+#include "MIC_Capture.h"
+#include "MIC_AEC.h"
+
+// ESP_SR reads the microphone through MIC_I2S::readBytes(); every block it gets is also copied, the microphone slot
+// only, into a ring in PSRAM. The ring is never locked: the I2S reader is the only writer and advances Write_Pos
+// after the samples, a reader checks afterwards whether its samples were overwritten in the meantime. MICTask runs
+// a fixed-point VAD (energy over an adaptive noise floor, zero crossings for fricatives) over 10 ms frames. Once
+// armed, the next utterance is handed out from MIC_PREROLL_MS before its onset as slices of the ring, while it is
+// still growing, until MIC_VAD_END_MS of silence end it.
+
+#define MIC_RING_MASK         (MIC_RING_SAMPLES - 1)
+#define MIC_PREROLL           (MIC_PREROLL_MS * (MIC_SAMPLE_RATE / 1000))
+#define MIC_END_FRAMES        (MIC_VAD_END_MS / 10)
+#define MIC_MAX_SAMPLES       (MIC_VAD_MAX_MS * (MIC_SAMPLE_RATE / 1000))
+
+static int16_t* Ring = NULL;
+static volatile uint32_t Write_Pos = 0;             // samples written so far, all positions wrap with uint32_t
+static volatile uint32_t Chunk_Max = 0;             // largest block, it is written before Write_Pos moves on
+static TaskHandle_t Process_Task = NULL;
+static MIC_Event_Cb Event_Cb = NULL;
+static MIC_Stats Stat;
+
+static uint32_t Vad_Pos = 0;                        // MICTask: frames up to here are decided
+static uint32_t Noise = 0;
+static uint8_t  Speech_Run = 0;
+static uint16_t Silence_Run = 0;
+static bool     Speech = false;
+static uint32_t Speech_Start = 0;
+
+static volatile bool     Armed = false;
+static volatile uint32_t Arm_Pos = 0;
+static volatile uint8_t  Utt_State = MIC_IDLE;
+static volatile uint32_t Utt_Start = 0;
+static volatile uint32_t Utt_End = 0;               // MICTask moves it on, the consumer may read up to here
+static volatile uint32_t Read_Pos = 0;              // the consumer releases up to here
+
+static volatile int64_t  Recv_Us = 0;               // esp_timer time the last RX DMA buffer was full
+static volatile uint32_t Recv_Frames = 0;           // frames of the full buffers, the dropped ones included
+static volatile uint32_t Recv_Dropped = 0;          // frames of buffers the DMA dropped, the reader was too late
+static uint32_t Read_Frames = 0;
+
+/************************************************************  I2S  ************************************************************/
+// ESP_SR reads whenever it gets to it, the samples may have waited in the DMA queue for a while. The time of the last
+// sample read comes from the on_recv interrupt of the buffers, as the play time of the speaker from on_sent.
+static bool IRAM_ATTR On_Recv(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx)
+{
+  Recv_Us = esp_timer_get_time();
+  Recv_Frames = Recv_Frames + event->size / 4;
+  return false;
+}
+static bool IRAM_ATTR On_Recv_Overflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx)
+{
+  Recv_Dropped = Recv_Dropped + event->size / 4;
+  return false;
+}
+bool MIC_I2S::begin(i2s_mode_t mode, uint32_t rate, i2s_data_bit_width_t bits, i2s_slot_mode_t ch, int8_t slot_mask)
+{
+  if (!I2SClass::begin(mode, rate, bits, ch, slot_mask)) return false;
+  i2s_chan_handle_t rx = rxChan();
+  i2s_event_callbacks_t cbs = {};
+  cbs.on_recv = On_Recv;
+  cbs.on_recv_q_ovf = On_Recv_Overflow;
+  i2s_channel_disable(rx);                          // callbacks are registered on a stopped channel only
+  Recv_Us = 0;
+  Recv_Frames = 0;
+  Recv_Dropped = 0;
+  Read_Frames = 0;
+  i2s_channel_register_event_callback(rx, &cbs, NULL);
+  return i2s_channel_enable(rx) == ESP_OK;
+}
+size_t MIC_I2S::readBytes(char* buffer, size_t size)
+{
+  size_t n = I2SClass::readBytes(buffer, size);
+  int64_t us;
+  uint32_t recv;
+  do {                                              // On_Recv() may come in between
+    us = Recv_Us;
+    recv = Recv_Frames;
+  } while (us != Recv_Us);
+  Read_Frames += n / 4;
+  // the frames still queued behind the last one read were taken after it
+  int32_t behind = recv - Recv_Dropped - Read_Frames;
+  if (!us || behind < 0 || behind > (int32_t)MIC_SAMPLE_RATE) {
+    if (us) Read_Frames = recv - Recv_Dropped;      // out of step: count on from here
+    us = esp_timer_get_time();                      // the time of the read then
+    behind = 0;
+  }
+  AEC_Process((int16_t*)buffer, n / 4, us - (int64_t)behind * 1000000 / MIC_SAMPLE_RATE);  // the speaker echo out
+  MIC_Capture_Write((const int16_t*)buffer, n / 4);                 // 16 bit stereo
+  return n;
+}
+
+/************************************************************  Ring  ************************************************************/
+void MIC_Capture_Write(const int16_t* stereo, uint32_t frames)
+{
+  if (!Ring || !frames) return;
+  if (frames > Chunk_Max) Chunk_Max = frames;
+  uint32_t w = Write_Pos;
+  stereo += MIC_SLOT;
+  for (uint32_t i = 0; i < frames; i++) Ring[(w + i) & MIC_RING_MASK] = stereo[i * 2];
+  __atomic_store_n(&Write_Pos, w + frames, __ATOMIC_RELEASE);
+  if (Process_Task) xTaskNotifyGive(Process_Task);
+}
+static bool Overwritten(uint32_t pos)
+{
+  // the next block may already be on its way into the ring behind Write_Pos
+  return __atomic_load_n(&Write_Pos, __ATOMIC_ACQUIRE) + Chunk_Max - pos > MIC_RING_SAMPLES;
+}
+bool MIC_Capture_Init()
+{
+  if (!Ring) {
+    size_t size = MIC_RING_SAMPLES * sizeof(int16_t);
+    Ring = (int16_t*)(psramFound() ? ps_malloc(size) : malloc(size));
+    if (!Ring) {
+      printf("MIC: no memory for the capture ring\r\n");
+      return false;
+    }
+    memset(Ring, 0, size);
+  }
+  Process_Task = xTaskGetCurrentTaskHandle();
+  return true;
+}
+
+/************************************************************  VAD  ************************************************************/
+static bool Vad_Frame(const int16_t* x)
+{
+  int32_t sum = 0;
+  uint64_t square = 0;
+  for (int i = 0; i < MIC_FRAME; i++) {
+    sum += x[i];
+    square += (int32_t)x[i] * x[i];
+  }
+  int32_t mean = sum / MIC_FRAME;                                   // the DC offset of the microphone
+  int64_t variance = (int64_t)(square / MIC_FRAME) - (int64_t)mean * mean;
+  uint32_t energy = variance > 0 ? (uint32_t)variance : 0;
+  uint16_t crossings = 0;
+  bool below = x[0] < mean;
+  for (int i = 1; i < MIC_FRAME; i++) {
+    bool b = x[i] < mean;
+    crossings += b != below;
+    below = b;
+  }
+
+  if (!Noise) Noise = energy | 1;
+  uint64_t noise = Noise;
+  bool speech = energy > MIC_VAD_MIN_ENERGY &&
+                (energy > noise * (Speech ? 3 : 6) || (crossings > MIC_VAD_ZCR && energy > noise * 3));
+  if (energy < Noise) Noise -= (Noise - energy) >> 2;               // falls fast, rises slowly, hardly during speech
+  else Noise += (Noise >> (Speech ? 11 : 8)) + 1;
+  Stat.Noise = Noise;
+  return speech;
+}
+static void Utterance_Event(uint8_t event, uint32_t samples)
+{
+  if (Event_Cb) Event_Cb(event, samples);
+}
+void MIC_Capture_Process()
+{
+  static int16_t frame[MIC_FRAME];                  // a frame across the end of the ring
+  if (!Ring) return;
+  uint32_t w = __atomic_load_n(&Write_Pos, __ATOMIC_ACQUIRE);
+  if (w - Vad_Pos > MIC_RING_SAMPLES / 2) Vad_Pos = w - MIC_FRAME;  // far behind (start up), skip to the end
+  while (w - Vad_Pos >= MIC_FRAME) {
+    uint32_t i = Vad_Pos & MIC_RING_MASK;
+    const int16_t* x = &Ring[i];
+    if (i + MIC_FRAME > MIC_RING_SAMPLES) {
+      uint32_t n = MIC_RING_SAMPLES - i;
+      memcpy(frame, &Ring[i], n * sizeof(int16_t));
+      memcpy(&frame[n], Ring, (MIC_FRAME - n) * sizeof(int16_t));
+      x = frame;
+    }
+    bool loud = Vad_Frame(x);
+    Vad_Pos += MIC_FRAME;
+    Stat.Frames++;
+
+    if (loud) {
+      Stat.Speech_Frames++;
+      Silence_Run = 0;
+      if (Speech_Run < 255) Speech_Run++;
+      if (!Speech && Speech_Run >= MIC_VAD_START_FRAMES) {
+        Speech = true;
+        Speech_Start = Vad_Pos - Speech_Run * MIC_FRAME;
+      }
+    }
+    else {
+      Speech_Run = 0;
+      if (Speech && ++Silence_Run >= MIC_END_FRAMES) Speech = false;
+    }
+
+    uint8_t state = Utt_State;
+    if (state == MIC_SPEAKING) {
+      __atomic_store_n(&Utt_End, Vad_Pos, __ATOMIC_RELEASE);
+      if (!Speech || Vad_Pos - Utt_Start >= MIC_MAX_SAMPLES) {
+        Utt_State = MIC_ENDED;
+        Utterance_Event(MIC_UTTERANCE_END, Vad_Pos - Utt_Start);
+      }
+    }
+    else if (Armed && Speech) {
+      // from the pre-roll on, but nothing from before the arming (e.g. the wake word, if the query follows at once)
+      uint32_t start = Speech_Start - MIC_PREROLL;
+      if ((int32_t)(Arm_Pos - start) > 0) start = Arm_Pos;
+      Armed = false;
+      Utt_Start = start;
+      Read_Pos = start;
+      __atomic_store_n(&Utt_End, Vad_Pos, __ATOMIC_RELEASE);
+      __atomic_store_n(&Utt_State, (uint8_t)MIC_SPEAKING, __ATOMIC_RELEASE);
+      Stat.Utterances++;
+      Utterance_Event(MIC_UTTERANCE_START, Vad_Pos - start);
+    }
+  }
+  uint8_t state = Utt_State;
+  if (state != MIC_IDLE && Read_Pos != Utt_End && Overwritten(Read_Pos)) {
+    Utt_State = MIC_IDLE;                                           // the consumer did not keep up
+    Stat.Lost++;
+    Utterance_Event(MIC_UTTERANCE_LOST, Utt_End - Utt_Start);
+  }
+}
+
+/************************************************************  Utterance  ************************************************************/
+void MIC_Capture_Arm(bool on)
+{
+  if (on) {
+    if (Utt_State == MIC_SPEAKING) return;
+    Arm_Pos = __atomic_load_n(&Write_Pos, __ATOMIC_ACQUIRE);
+    Utt_State = MIC_IDLE;                                           // the last utterance is given up
+  }
+  Armed = on;
+}
+void MIC_Capture_On_Event(MIC_Event_Cb cb)
+{
+  Event_Cb = cb;
+}
+uint8_t MIC_Capture_State()
+{
+  return __atomic_load_n(&Utt_State, __ATOMIC_ACQUIRE);
+}
+uint8_t MIC_Capture_Get(MIC_Slice slice[2])
+{
+  if (MIC_Capture_State() == MIC_IDLE) return 0;
+  uint32_t end = __atomic_load_n(&Utt_End, __ATOMIC_ACQUIRE);
+  uint32_t r = Read_Pos;
+  uint32_t n = end - r;
+  if (!n || Overwritten(r)) return 0;
+  uint32_t i = r & MIC_RING_MASK;
+  uint32_t first = MIC_RING_SAMPLES - i;
+  if (first >= n) {
+    slice[0].Data = &Ring[i];
+    slice[0].Samples = n;
+    return 1;
+  }
+  slice[0].Data = &Ring[i];
+  slice[0].Samples = first;
+  slice[1].Data = Ring;
+  slice[1].Samples = n - first;
+  return 2;
+}
+bool MIC_Capture_Release(uint32_t samples)
+{
+  uint32_t r = Read_Pos;
+  bool ok = !Overwritten(r);                         // checked after the samples were used
+  Read_Pos = r + samples;
+  return ok;
+}
+void MIC_Capture_Finish()
+{
+  Utt_State = MIC_IDLE;                                             // only MICTask moves the state, no race
+}
+const MIC_Stats* MIC_Capture_Get_Stats()
+{
+  return &Stat;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Arduino.h"
+#include <cstring>
+#include "ESP_I2S.h"
+
+#define MIC_SAMPLE_RATE       16000
+#define MIC_RING_BITS         17                    // 2^17 samples: 8.2 s mono, 256 KB in PSRAM
+#define MIC_RING_SAMPLES      (1UL << MIC_RING_BITS)
+#define MIC_SLOT              0                     // the microphone in the stereo frame: 0 left, 1 right
+#define MIC_FRAME             160                   // 10 ms, one VAD decision
+#define MIC_PREROLL_MS        1500                  // taken along from before the speech onset
+#define MIC_VAD_START_FRAMES  3                     // speech frames in a row that start an utterance
+#define MIC_VAD_END_MS        400                   // silence that ends it
+#define MIC_VAD_MAX_MS        7000                  // with the pre-roll, longer utterances are cut: the ring must hold them
+#define MIC_VAD_MIN_ENERGY    400                   // mean square below this is never speech (rms 20, -64 dBFS)
+#define MIC_VAD_ZCR           48                    // zero crossings per frame above this: fricative, needs less energy
+
+enum {
+  MIC_IDLE = 0,
+  MIC_SPEAKING,                                     // the utterance grows, slices can be taken already
+  MIC_ENDED,                                        // complete, the rest can be taken
+};
+
+enum {
+  MIC_UTTERANCE_START = 0,
+  MIC_UTTERANCE_END,
+  MIC_UTTERANCE_LOST,                               // overwritten before it was released, the utterance is dropped
+};
+
+typedef struct {
+  const int16_t* Data;                              // in the ring, valid until released
+  uint32_t Samples;
+} MIC_Slice;
+
+typedef struct {
+  uint32_t Frames;                                  // VAD decisions
+  uint32_t Speech_Frames;
+  uint32_t Utterances;
+  uint32_t Lost;
+  uint32_t Noise;                                   // noise floor, mean square
+} MIC_Stats;
+
+typedef void (*MIC_Event_Cb)(uint8_t event, uint32_t samples);  // MICTask, samples of the utterance so far
+
+class MIC_I2S : public I2SClass {                   // the reader of ESP_SR feeds the capture ring as well
+public:
+  bool   begin(i2s_mode_t mode, uint32_t rate, i2s_data_bit_width_t bits, i2s_slot_mode_t ch, int8_t slot_mask = -1);
+  size_t readBytes(char* buffer, size_t size) override;
+};
+
+bool    MIC_Capture_Init();                                                     // in the task that calls MIC_Capture_Process()
+void    MIC_Capture_Write(const int16_t* stereo, uint32_t frames);              // I2S reader, never blocks
+void    MIC_Capture_Process();                                                  // VAD over the new frames
+void    MIC_Capture_Arm(bool on);                                               // hand out the next utterance (or not)
+void    MIC_Capture_On_Event(MIC_Event_Cb cb);
+uint8_t MIC_Capture_State();
+uint8_t MIC_Capture_Get(MIC_Slice slice[2]);                                    // what is not yet released, 0..2 slices
+bool    MIC_Capture_Release(uint32_t samples);                                  // false: overwritten while in use
+void    MIC_Capture_Finish();                                                   // MICTask: the utterance is taken, back to idle
+const MIC_Stats* MIC_Capture_Get_Stats();
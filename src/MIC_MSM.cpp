@@ -1,12 +1,15 @@
 #include "MIC_MSM.h"
 #include "LVGL_Music.h"
+#include "MIC_Capture.h"
+#include "Voice_Encoder.h"
+#include "MIC_AEC.h"
 // English wakeword : Hi ESP！！！！
 // Chinese wakeword : Hi 乐鑫！！！！
 // 英文唤醒词 : Hi ESP！！！！
 // 中文唤醒词 : Hi 乐鑫！！！！
 
 
-I2SClass i2s;
+MIC_I2S i2s;                            // ESP_SR reads it, the capture ring gets a copy
 
 // Generated using the following command:
 // python3 tools/gen_sr_commands.py "Turn on the light,Switch on the light;Turn off the light,Switch off the light,Go dark;Start fan;Stop fan"
@@ -35,24 +38,29 @@ uint8_t LCD_Backlight_original = 0;
 void Awaken_Event(sr_event_t event, int command_id, int phrase_id) {
   switch (event) {
     case SR_EVENT_WAKEWORD: 
-      if(ACTIVE_TRACK_CNT)
-        _lv_demo_music_pause();
+      Music_duck(true);                   // the music keeps playing at a lower level
+      Audio_Sound(Sound_Listening, MIX_VOICE);
       printf("WakeWord Detected!\r\n"); 
       LCD_Backlight_original = LCD_Backlight;
       break;
     case SR_EVENT_WAKEWORD_CHANNEL:
       printf("WakeWord Channel %d Verified!\r\n", command_id);
       ESP_SR.setMode(SR_MODE_COMMAND);  // Switch to Command detection
+      MIC_Capture_Arm(true);            // the next utterance is kept as a voice query
       LCD_Backlight = 35;
       break;
     case SR_EVENT_TIMEOUT:
       printf("Timeout Detected!\r\n");
       ESP_SR.setMode(SR_MODE_WAKEWORD);  // Switch back to WakeWord detection
+      MIC_Capture_Arm(false);            // an utterance already running is finished
       LCD_Backlight = LCD_Backlight_original;
+      Music_duck(false);
       if(play_Music_Flag){
         play_Music_Flag = 0;
-        if(ACTIVE_TRACK_CNT)
-          _lv_demo_music_resume();   
+        if(ACTIVE_TRACK_CNT){
+          if(!audio.isRunning())
+            _lv_demo_music_resume();
+        }
         else
           printf("No MP3 file found in SD card!\r\n");    
       }
@@ -84,10 +92,37 @@ void Awaken_Event(sr_event_t event, int command_id, int phrase_id) {
   }
 }
 
+void Utterance_Event(uint8_t event, uint32_t samples) {
+  unsigned long ms = samples / (MIC_SAMPLE_RATE / 1000);
+  switch (event) {
+    case MIC_UTTERANCE_START: printf("Utterance started (%lu ms pre-roll)\r\n", ms); break;
+    case MIC_UTTERANCE_END:   printf("Utterance ended, %lu ms\r\n", ms);
+                              Audio_Sound(Sound_Done);                        break;
+    case MIC_UTTERANCE_LOST:  printf("Utterance lost after %lu ms\r\n", ms);     break;
+  }
+}
+
+void Voice_Sink(uint8_t event, const uint8_t* data, uint32_t len) {
+  // the upload of the voice query goes here, blocks and pages arrive while the user is still speaking; a text for
+  // LLM_Ask() needs speech to text, which this firmware does not have
+  static uint32_t bytes = 0;
+  bytes = event == VOICE_START ? len : bytes + len;
+  const Voice_Stats* s = Voice_Encoder_Get_Stats();
+  switch (event) {
+    case VOICE_END:   printf("Voice query encoded, %lu bytes, %lu us per frame (max %lu)\r\n", (unsigned long)bytes,
+                             (unsigned long)(s->Encode_Us_Sum / (s->Frames ? s->Frames : 1)), (unsigned long)s->Encode_Us_Max); break;
+    case VOICE_ABORT: printf("Voice query dropped\r\n"); break;
+  }
+}
+
 void _MIC_Init() {
   i2s.setPins(I2S_PIN_BCK, I2S_PIN_WS, I2S_PIN_DOUT, I2S_PIN_DIN);
   i2s.setTimeout(1000);
-  i2s.begin(I2S_MODE_STD, 16000, I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO);
+  i2s.begin(I2S_MODE_STD, MIC_SAMPLE_RATE, I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO);
+  MIC_Capture_Init();
+  AEC_Init();
+  MIC_Capture_On_Event(Utterance_Event);
+  Voice_Encoder_Init(VOICE_FORMAT_OPUS, Voice_Sink);
 
   ESP_SR.onEvent(Awaken_Event);
   ESP_SR.begin(i2s, sr_commands, sizeof(sr_commands) / sizeof(sr_cmd_t), SR_CHANNELS_STEREO, SR_MODE_WAKEWORD);
@@ -97,7 +132,9 @@ void MICTask(void *parameter) {
   esp_task_wdt_add(NULL);
   while(1){
     esp_task_wdt_reset();
-    vTaskDelay(pdMS_TO_TICKS(50));
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));   // woken by every block ESP_SR reads
+    MIC_Capture_Process();
+    Voice_Encoder_Process();                        // encodes the utterance while it grows
   }
   vTaskDelete(NULL);
   
@@ -106,7 +143,7 @@ void MIC_Init() {
   xTaskCreatePinnedToCore(
     MICTask,     
     "MICTask",  
-    4096,                
+    6144,                
     NULL,                 
     5,                   
     NULL,                 
@@ -0,0 +1,775 @@
+#include "Music_Library.h"
+#include "mp3_decoder/mp3_decoder.h"
+
+// Database on the SD card: Library_Header | Library_Record[Count] | string table (NUL terminated, UTF-8)
+// Only the header is read when the library is opened, records and names are read in pages on request.
+
+static File Library_File;
+static Library_Header Header;
+static bool Library_Valid = false;
+static uint8_t* Page_Buff[LIBRARY_PAGES] = {NULL};
+static int32_t Page_No[LIBRARY_PAGES];
+static uint16_t Page_Len[LIBRARY_PAGES];
+static uint32_t Page_Use[LIBRARY_PAGES];
+static uint32_t Page_Clock = 0;
+
+typedef struct {
+  uint32_t Name;                                    // offset in Build_Names
+  uint32_t Size;
+  uint32_t Time;
+} Build_Entry;
+
+typedef struct {                                    // growing buffer in PSRAM
+  uint8_t* Data;
+  uint32_t Len;
+  uint32_t Cap;
+} Build_Buff;
+
+static const char* Sort_Names = NULL;               // qsort() has no context parameter
+
+static void* Library_Alloc(size_t size)
+{
+  return psramFound() ? ps_malloc(size) : malloc(size);
+}
+static bool Buff_Append(Build_Buff* b, const void* data, uint32_t len)
+{
+  if (b->Len + len > b->Cap) {
+    uint32_t cap = max(b->Cap * 2, b->Len + len + 4096);
+    uint8_t* p = (uint8_t*)(psramFound() ? ps_realloc(b->Data, cap) : realloc(b->Data, cap));
+    if (!p) return false;
+    b->Data = p;
+    b->Cap = cap;
+  }
+  memcpy(b->Data + b->Len, data, len);
+  b->Len += len;
+  return true;
+}
+static uint32_t Name_Hash(uint32_t hash, const char* name)
+{
+  while (*name) hash = (hash ^ (uint8_t)*name++) * 16777619UL;  // FNV-1a
+  return hash * 16777619UL;                                     // separator
+}
+static bool Extension_Match(const char* name, const char* fileExtension)
+{
+  size_t n = strlen(name), e = strlen(fileExtension);
+  return n > e && strcasecmp(name + n - e, fileExtension) == 0;
+}
+static uint8_t Codec_From_Name(const char* name)
+{
+  const char* ext = strrchr(name, '.');
+  if (!ext) return LIBRARY_CODEC_NONE;
+  if (!strcasecmp(ext, ".mp3")) return LIBRARY_CODEC_MP3;
+  if (!strcasecmp(ext, ".m4a") || !strcasecmp(ext, ".aac")) return LIBRARY_CODEC_M4A;
+  if (!strcasecmp(ext, ".flac")) return LIBRARY_CODEC_FLAC;
+  if (!strcasecmp(ext, ".wav")) return LIBRARY_CODEC_WAV;
+  if (!strcasecmp(ext, ".ogg") || !strcasecmp(ext, ".opus")) return LIBRARY_CODEC_OGG;
+  return LIBRARY_CODEC_NONE;
+}
+static void Join_Path(char* path, uint16_t len, const char* directory, const char* fileName)
+{
+  if (strcmp(directory, "/") == 0)
+    snprintf(path, len, "%s%s", directory, fileName);
+  else
+    snprintf(path, len, "%s/%s", directory, fileName);
+}
+
+/************************************************************  Pages  ************************************************************/
+static void Page_Reset()
+{
+  for (int i = 0; i < LIBRARY_PAGES; i++) {
+    Page_No[i] = -1;
+    Page_Len[i] = 0;
+    Page_Use[i] = 0;
+  }
+}
+static const uint8_t* Page_Get(uint32_t pos, uint16_t* avail)
+{
+  int32_t no = pos / LIBRARY_PAGE_SIZE;
+  uint16_t ofs = pos % LIBRARY_PAGE_SIZE;
+  int slot = 0;
+  for (int i = 0; i < LIBRARY_PAGES; i++) {
+    if (Page_No[i] == no && Page_Buff[i]) {
+      Page_Use[i] = ++Page_Clock;
+      *avail = (ofs < Page_Len[i]) ? Page_Len[i] - ofs : 0;
+      return *avail ? Page_Buff[i] + ofs : NULL;
+    }
+    if (Page_Use[i] < Page_Use[slot]) slot = i;                 // least recently used
+  }
+  if (!Page_Buff[slot]) Page_Buff[slot] = (uint8_t*)Library_Alloc(LIBRARY_PAGE_SIZE);
+  if (!Page_Buff[slot]) return NULL;
+  Library_File.seek(no * LIBRARY_PAGE_SIZE);
+  int32_t n = Library_File.read(Page_Buff[slot], LIBRARY_PAGE_SIZE);
+  Page_No[slot] = no;
+  Page_Len[slot] = (n > 0) ? n : 0;
+  Page_Use[slot] = ++Page_Clock;
+  *avail = (ofs < Page_Len[slot]) ? Page_Len[slot] - ofs : 0;
+  return *avail ? Page_Buff[slot] + ofs : NULL;
+}
+static bool Library_Read(uint32_t pos, void* data, uint32_t len)
+{
+  uint8_t* d = (uint8_t*)data;
+  while (len) {
+    uint16_t avail;
+    const uint8_t* p = Page_Get(pos, &avail);
+    if (!p) return false;
+    uint32_t n = min((uint32_t)avail, len);
+    memcpy(d, p, n);
+    d += n;
+    pos += n;
+    len -= n;
+  }
+  return true;
+}
+static bool Library_String(uint32_t offset, char* str, uint16_t len)
+{
+  str[0] = 0;
+  if (offset == LIBRARY_NONE) return true;
+  if (offset >= Header.Strings_Size) return false;
+  uint32_t pos = Header.Strings + offset;
+  uint16_t n = 0;
+  while (n < len - 1) {
+    uint16_t avail;
+    const uint8_t* p = Page_Get(pos, &avail);
+    if (!p) break;
+    uint16_t k = min((uint16_t)(len - 1 - n), avail);
+    const uint8_t* end = (const uint8_t*)memchr(p, 0, k);
+    if (end) k = end - p;
+    memcpy(str + n, p, k);
+    n += k;
+    pos += k;
+    if (end) break;
+  }
+  str[n] = 0;
+  return true;
+}
+static bool Library_Record_Get(uint32_t index, Library_Record* record)
+{
+  if (!Library_Valid || index >= Header.Count) return false;
+  return Library_Read(sizeof(Library_Header) + index * sizeof(Library_Record), record, sizeof(Library_Record));
+}
+static bool Library_Open()
+{
+  Library_Valid = false;
+  Page_Reset();
+  if (!SD_MMC.exists(LIBRARY_FILE)) return false;
+  Library_File = SD_MMC.open(LIBRARY_FILE);
+  if (!Library_File) return false;
+  if (Library_File.read((uint8_t*)&Header, sizeof(Header)) != sizeof(Header) || Header.Magic != LIBRARY_MAGIC ||
+      Header.Strings != sizeof(Library_Header) + Header.Count * sizeof(Library_Record) ||
+      Library_File.size() < Header.Strings + Header.Strings_Size) {
+    printf("Music library: %s is damaged\r\n", LIBRARY_FILE);
+    Library_File.close();
+    return false;
+  }
+  Header.Directory[sizeof(Header.Directory) - 1] = 0;
+  Header.Extension[sizeof(Header.Extension) - 1] = 0;
+  Library_Valid = true;
+  return true;
+}
+void Library_Close()
+{
+  if (Library_File) Library_File.close();
+  Library_Valid = false;
+  Page_Reset();
+}
+
+/************************************************************  Tags  ************************************************************/
+static void Tag_Text_Enc(uint8_t enc, const uint8_t* data, uint32_t len, char* text)
+{
+  // ISO-8859-1 (0), UTF-16 with BOM (1), UTF-16BE (2) or UTF-8 (3), output UTF-8
+  uint16_t n = 0;
+  if (enc == 1 || enc == 2) {
+    bool le = false;
+    if (enc == 1 && len >= 2) {
+      le = (data[0] == 0xFF && data[1] == 0xFE);
+      if ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF)) { data += 2; len -= 2; }
+    }
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+      uint16_t c = le ? (data[i] | (data[i + 1] << 8)) : ((data[i] << 8) | data[i + 1]);
+      if (c == 0) break;
+      if (c >= 0xD800 && c < 0xE000) c = '?';                   // no surrogate pairs in the fonts anyway
+      if (c < 0x80) {
+        if (n + 1 >= LIBRARY_TAG_LEN) break;
+        text[n++] = c;
+      } else if (c < 0x800) {
+        if (n + 2 >= LIBRARY_TAG_LEN) break;
+        text[n++] = 0xC0 | (c >> 6);
+        text[n++] = 0x80 | (c & 0x3F);
+      } else {
+        if (n + 3 >= LIBRARY_TAG_LEN) break;
+        text[n++] = 0xE0 | (c >> 12);
+        text[n++] = 0x80 | ((c >> 6) & 0x3F);
+        text[n++] = 0x80 | (c & 0x3F);
+      }
+    }
+  } else {
+    for (uint32_t i = 0; i < len && data[i]; i++) {
+      uint8_t c = data[i];
+      if (enc == 0 && c >= 0x80) {                               // Latin-1 -> UTF-8
+        if (n + 2 >= LIBRARY_TAG_LEN) break;
+        text[n++] = 0xC0 | (c >> 6);
+        text[n++] = 0x80 | (c & 0x3F);
+      } else {
+        if (n + 1 >= LIBRARY_TAG_LEN) break;
+        if (enc == 3 && (c & 0xC0) == 0xC0) {                    // do not cut a UTF-8 sequence
+          uint8_t k = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : 2;
+          if (n + k >= LIBRARY_TAG_LEN) break;
+        }
+        text[n++] = c;
+      }
+    }
+  }
+  text[n] = 0;
+}
+static void Tag_Text(const uint8_t* data, uint32_t len, char* text)
+{
+  // ID3 text frame: encoding byte, then the text
+  if (len < 2) { text[0] = 0; return; }
+  Tag_Text_Enc(data[0], data + 1, len - 1, text);
+}
+static uint32_t Get_LE32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint32_t Get_BE32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static void Tag_Read_Vorbis(const uint8_t* data, uint32_t len, Library_Track* track)
+{
+  // Vorbis comment (Ogg, FLAC): vendor string, number of comments, "TITLE=..." each with a 32 bit length, UTF-8
+  if (len < 8 || Get_LE32(data) > len - 8) return;
+  uint32_t pos = 4 + Get_LE32(data);
+  uint32_t count = Get_LE32(data + pos);
+  pos += 4;
+  for (uint32_t i = 0; i < count && pos + 4 <= len; i++) {
+    uint32_t n = Get_LE32(data + pos);
+    pos += 4;
+    if (n > len - pos) break;
+    const char* c = (const char*)data + pos;
+    char* dst = NULL;
+    uint8_t key = 0;
+    if (n > 6 && !strncasecmp(c, "TITLE=", 6)) { dst = track->Title; key = 6; }
+    if (n > 7 && !strncasecmp(c, "ARTIST=", 7)) { dst = track->Artist; key = 7; }
+    if (n > 6 && !strncasecmp(c, "ALBUM=", 6)) { dst = track->Album; key = 6; }
+    if (dst && !dst[0]) Tag_Text_Enc(3, data + pos + key, n - key, dst);
+    pos += n;
+  }
+}
+static uint32_t Tag_Read_ID3(File &file, Library_Track* track)
+{
+  // returns the position behind the ID3v2 tag, title, artist and album are taken from it
+  uint8_t hdr[10];
+  file.seek(0);
+  if (file.read(hdr, 10) != 10 || memcmp(hdr, "ID3", 3) != 0) return 0;
+  uint8_t ver = hdr[3];
+  uint32_t tagSize = ((hdr[6] & 0x7F) << 21) | ((hdr[7] & 0x7F) << 14) | ((hdr[8] & 0x7F) << 7) | (hdr[9] & 0x7F);
+  uint32_t end = 10 + tagSize + ((hdr[5] & 0x10) ? 10 : 0);
+  if (hdr[5] & 0x80) return end;                                // unsynchronisation, rare, the tags are skipped
+
+  uint32_t len = min(tagSize, (uint32_t)8192);                  // the text frames are at the beginning
+  uint8_t* tag = (uint8_t*)Library_Alloc(len);
+  if (!tag) return end;
+  len = file.read(tag, len);
+  uint32_t pos = 0;
+  if ((hdr[5] & 0x40) && ver >= 3 && len >= 4) {                // extended header
+    uint32_t ext = (ver == 4) ? (((tag[0] & 0x7F) << 21) | ((tag[1] & 0x7F) << 14) | ((tag[2] & 0x7F) << 7) | (tag[3] & 0x7F))
+                              : ((tag[0] << 24) | (tag[1] << 16) | (tag[2] << 8) | tag[3]) + 4;
+    pos = ext;
+  }
+  uint8_t frameHdr = (ver == 2) ? 6 : 10;
+  while (pos + frameHdr <= len && tag[pos]) {
+    const uint8_t* f = tag + pos;
+    uint32_t size;
+    char* dst = NULL;
+    if (ver == 2) {
+      size = (f[3] << 16) | (f[4] << 8) | f[5];
+      if (!memcmp(f, "TT2", 3)) dst = track->Title;
+      if (!memcmp(f, "TP1", 3)) dst = track->Artist;
+      if (!memcmp(f, "TAL", 3)) dst = track->Album;
+    } else {
+      if (ver == 4) size = ((f[4] & 0x7F) << 21) | ((f[5] & 0x7F) << 14) | ((f[6] & 0x7F) << 7) | (f[7] & 0x7F);
+      else          size = (f[4] << 24) | (f[5] << 16) | (f[6] << 8) | f[7];
+      if (!memcmp(f, "TIT2", 4)) dst = track->Title;
+      if (!memcmp(f, "TPE1", 4)) dst = track->Artist;
+      if (!memcmp(f, "TALB", 4)) dst = track->Album;
+    }
+    pos += frameHdr;
+    if (size > len - pos) break;
+    if (dst) Tag_Text(tag + pos, size, dst);
+    pos += size;
+  }
+  free(tag);
+  return end;
+}
+/*********************************************************  Containers  *********************************************************/
+static void Parse_M4A(File &file, Library_Track* track)
+{
+  // moov/trak/mdia: mdhd (time scale, duration), minf/stbl/stsd: mp4a (channels, sample rate), moov/udta/meta/ilst: tags.
+  // moov can be in front of or behind mdat, only the atoms on the way are read.
+  uint32_t fileSize = file.size();
+  uint8_t hdr[64];
+  auto Find_Atom = [&](uint32_t pos, uint32_t end, const char* name, uint32_t* size) -> uint32_t {  // 0: not found
+    while (pos + 8 <= end) {
+      file.seek(pos);
+      if (file.read(hdr, 8) != 8) return 0;
+      uint32_t len = Get_BE32(hdr);
+      if (len < 8 || len > end - pos) return 0;                 // 64 bit size or damaged
+      if (!memcmp(hdr + 4, name, 4)) { *size = len; return pos; }
+      pos += len;
+    }
+    return 0;
+  };
+  uint32_t moovSize = 0, size = 0, mdiaSize = 0;
+  uint32_t moov = Find_Atom(0, fileSize, "moov", &moovSize);
+  if (!moov) return;
+  uint32_t trak = Find_Atom(moov + 8, moov + moovSize, "trak", &size);
+  uint32_t mdia = trak ? Find_Atom(trak + 8, trak + size, "mdia", &mdiaSize) : 0;
+  uint32_t mdhd = mdia ? Find_Atom(mdia + 8, mdia + mdiaSize, "mdhd", &size) : 0;
+  if (mdhd && file.seek(mdhd) && file.read(hdr, 40) == 40) {
+    uint64_t scale, duration;
+    if (hdr[8] == 1) { scale = Get_BE32(hdr + 28); duration = ((uint64_t)Get_BE32(hdr + 32) << 32) | Get_BE32(hdr + 36); }
+    else             { scale = Get_BE32(hdr + 20); duration = Get_BE32(hdr + 24); }
+    if (scale) track->Duration = min(duration / scale, (uint64_t)0xFFFF);
+  }
+  uint32_t pos = mdia;
+  uint32_t end = mdia + mdiaSize;
+  const char* stsdPath[] = {"minf", "stbl", "stsd"};
+  for (int i = 0; pos && i < 3; i++) {
+    pos = Find_Atom(pos + 8, end, stsdPath[i], &size);
+    end = pos + size;
+  }
+  if (pos && file.seek(pos) && file.read(hdr, 50) == 50 && !memcmp(hdr + 20, "mp4a", 4)) {
+    track->Channels = (hdr[40] << 8) | hdr[41];
+    track->Sample_Rate = (hdr[48] << 8) | hdr[49];
+  }
+  uint32_t udta = Find_Atom(moov + 8, moov + moovSize, "udta", &size);
+  uint32_t meta = udta ? Find_Atom(udta + 8, udta + size, "meta", &size) : 0;
+  uint32_t ilst = meta ? Find_Atom(meta + 12, meta + size, "ilst", &size) : 0;   // meta: 4 bytes version + flags
+  if (!ilst) return;
+  end = ilst + size;
+  pos = ilst + 8;
+  while (pos + 8 <= end) {                                      // items: size, name, data atom: size, "data", type, locale
+    file.seek(pos);
+    if (file.read(hdr, 8) != 8) return;
+    uint32_t len = Get_BE32(hdr);
+    if (len < 8 || len > end - pos) return;
+    char* dst = NULL;
+    if (!memcmp(hdr + 4, "\xA9nam", 4)) dst = track->Title;
+    if (!memcmp(hdr + 4, "\xA9""ART", 4)) dst = track->Artist;
+    if (!memcmp(hdr + 4, "\xA9""alb", 4)) dst = track->Album;
+    if (dst && len > 24) {
+      uint8_t text[LIBRARY_TAG_LEN * 2];
+      uint32_t n = min(len - 24, (uint32_t)sizeof(text));
+      if (file.read(hdr, 16) == 16 && !memcmp(hdr + 4, "data", 4) && file.read(text, n) == n) Tag_Text_Enc(3, text, n, dst);
+    }
+    pos += len;
+  }
+}
+static void Parse_FLAC(File &file, uint32_t start, Library_Track* track)
+{
+  // "fLaC", then metadata blocks: 1 bit last, 7 bits type, 24 bits length. STREAMINFO (0) and VORBIS_COMMENT (4)
+  uint8_t hdr[34];
+  file.seek(start);
+  if (file.read(hdr, 4) != 4 || memcmp(hdr, "fLaC", 4)) return;
+  uint32_t pos = start + 4;
+  bool last = false;
+  while (!last) {
+    file.seek(pos);
+    if (file.read(hdr, 4) != 4) return;
+    last = hdr[0] & 0x80;
+    uint8_t type = hdr[0] & 0x7F;
+    uint32_t len = (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+    pos += 4;
+    if (type == 0 && len >= 34 && file.read(hdr, 34) == 34) {  // 20 bits rate, 3 bits channels - 1, 5 bits bps - 1, 36 bits samples
+      track->Sample_Rate = (hdr[10] << 12) | (hdr[11] << 4) | (hdr[12] >> 4);
+      track->Channels = ((hdr[12] >> 1) & 7) + 1;
+      uint64_t samples = ((uint64_t)(hdr[13] & 0x0F) << 32) | Get_BE32(hdr + 14);
+      if (track->Sample_Rate) track->Duration = min(samples / track->Sample_Rate, (uint64_t)0xFFFF);
+    }
+    if (type == 4) {
+      uint32_t n = min(len, (uint32_t)8192);
+      uint8_t* data = (uint8_t*)Library_Alloc(n);
+      if (data) {
+        if (file.read(data, n) == n) Tag_Read_Vorbis(data, n, track);
+        free(data);
+      }
+    }
+    if (type == 0x7F) return;                                   // invalid
+    pos += len;
+  }
+}
+static void Parse_WAV(File &file, Library_Track* track)
+{
+  // RIFF chunks: "fmt " (channels, rate, bytes per second), "data" (its size), LIST/INFO (INAM, IART, IPRD)
+  uint8_t hdr[16];
+  uint32_t fileSize = file.size();
+  file.seek(0);
+  if (file.read(hdr, 12) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) return;
+  uint32_t pos = 12, byteRate = 0, dataSize = 0;
+  while (pos + 8 <= fileSize) {
+    file.seek(pos);
+    if (file.read(hdr, 8) != 8) break;
+    uint32_t len = Get_LE32(hdr + 4);
+    if (!memcmp(hdr, "fmt ", 4) && len >= 16 && file.read(hdr, 16) == 16) {
+      track->Channels = hdr[2] | (hdr[3] << 8);
+      track->Sample_Rate = Get_LE32(hdr + 4);
+      byteRate = Get_LE32(hdr + 8);
+    }
+    if (!memcmp(hdr, "data", 4)) {
+      dataSize = min(len, fileSize - pos - 8);                  // a stream may have left 0 or 0xFFFFFFFF
+      if (!len || len == 0xFFFFFFFF) dataSize = fileSize - pos - 8;
+    }
+    if (!memcmp(hdr, "LIST", 4) && len > 4 && len <= 4096) {
+      uint8_t* data = (uint8_t*)Library_Alloc(len);
+      if (data && file.read(data, len) == len && !memcmp(data, "INFO", 4)) {
+        for (uint32_t i = 4; i + 8 <= len;) {
+          uint32_t n = Get_LE32(data + i + 4);
+          if (n > len - i - 8) break;
+          char* dst = NULL;
+          if (!memcmp(data + i, "INAM", 4)) dst = track->Title;
+          if (!memcmp(data + i, "IART", 4)) dst = track->Artist;
+          if (!memcmp(data + i, "IPRD", 4)) dst = track->Album;
+          if (dst) Tag_Text_Enc(0, data + i + 8, n, dst);
+          i += 8 + n + (n & 1);
+        }
+      }
+      if (data) free(data);
+    }
+    if (len > fileSize - pos - 8) break;
+    pos += 8 + len + (len & 1);
+  }
+  if (byteRate && dataSize) track->Duration = min(dataSize / byteRate, (uint32_t)0xFFFF);
+}
+static uint32_t Ogg_Packet(const uint8_t* buf, uint32_t len, uint8_t index, uint8_t* out, uint32_t cap)
+{
+  // packet 'index' of the pages in buf, the header packets of Vorbis, Opus and FLAC. Returns its length (up to cap)
+  uint32_t pos = 0, n = 0;
+  uint8_t packet = 0;
+  while (pos + 27 <= len && !memcmp(buf + pos, "OggS", 4)) {
+    uint8_t segments = buf[pos + 26];
+    const uint8_t* lacing = buf + pos + 27;
+    uint32_t data = pos + 27 + segments;
+    if (data > len) break;
+    for (uint8_t i = 0; i < segments; i++) {
+      uint32_t l = min((uint32_t)lacing[i], len - min(data, len));
+      if (packet == index && n < cap) {
+        uint32_t c = min(l, cap - n);
+        memcpy(out + n, buf + data, c);
+        n += c;
+      }
+      data += lacing[i];
+      if (lacing[i] < 255) {
+        if (packet == index) return n;
+        packet++;
+      }
+    }
+    pos = data;
+  }
+  return n;
+}
+static void Parse_Ogg(File &file, Library_Track* track)
+{
+  // identification header (Vorbis, Opus, FLAC) and comments from the first pages, the duration from the granule
+  // position of the last page
+  const uint32_t bufSize = 8192;
+  uint8_t* buf = (uint8_t*)Library_Alloc(bufSize);
+  uint8_t* packet = (uint8_t*)Library_Alloc(bufSize);
+  if (!buf || !packet) { free(buf); free(packet); return; }
+  file.seek(0);
+  uint32_t len = file.read(buf, bufSize);
+  uint32_t n = Ogg_Packet(buf, len, 0, packet, bufSize);
+  uint64_t preSkip = 0;
+  uint32_t granuleRate = 0;
+  int comments = -1;                                            // offset of the comment block in packet 1
+  if (n >= 30 && !memcmp(packet, "\x01vorbis", 7)) {
+    track->Channels = packet[11];
+    track->Sample_Rate = granuleRate = Get_LE32(packet + 12);
+    comments = 7;
+  }
+  if (n >= 19 && !memcmp(packet, "OpusHead", 8)) {
+    track->Channels = packet[9];
+    preSkip = packet[10] | (packet[11] << 8);
+    track->Sample_Rate = granuleRate = 48000;                   // Opus always decodes at 48 kHz
+    comments = 8;
+  }
+  if (n >= 51 && !memcmp(packet, "\x7F""FLAC", 5) && !memcmp(packet + 9, "fLaC", 4)) {  // + STREAMINFO block
+    const uint8_t* si = packet + 17;
+    track->Sample_Rate = granuleRate = (si[10] << 12) | (si[11] << 4) | (si[12] >> 4);
+    track->Channels = ((si[12] >> 1) & 7) + 1;
+    comments = 4;                                               // VORBIS_COMMENT block header
+  }
+  if (comments >= 0) {
+    n = Ogg_Packet(buf, len, 1, packet, bufSize);
+    if (n > (uint32_t)comments) Tag_Read_Vorbis(packet + comments, n - comments, track);
+  }
+  uint32_t fileSize = file.size();
+  if (granuleRate && fileSize > 27) {                           // the last page
+    uint32_t tail = min(fileSize, bufSize);
+    file.seek(fileSize - tail);
+    len = file.read(buf, tail);
+    for (int32_t i = (int32_t)len - 27; i >= 0; i--) {
+      if (memcmp(buf + i, "OggS", 4)) continue;
+      uint64_t granule = Get_LE32(buf + i + 6) | ((uint64_t)Get_LE32(buf + i + 10) << 32);
+      if (granule == 0xFFFFFFFFFFFFFFFFULL) continue;             // no packet ends on this page
+      if (granule > preSkip) track->Duration = min((granule - preSkip) / granuleRate, (uint64_t)0xFFFF);
+      break;
+    }
+  }
+  free(buf);
+  free(packet);
+}
+static void Library_Parse(const char* path, Library_Track* track)
+{
+  // tags and duration of a new or changed file, only the headers are read
+  File file = SD_MMC.open(path);
+  if (!file) return;
+  uint32_t fileSize = file.size();
+  if (track->Codec == LIBRARY_CODEC_M4A) Parse_M4A(file, track);
+  if (track->Codec == LIBRARY_CODEC_FLAC) Parse_FLAC(file, Tag_Read_ID3(file, track), track);
+  if (track->Codec == LIBRARY_CODEC_WAV) Parse_WAV(file, track);
+  if (track->Codec == LIBRARY_CODEC_OGG) Parse_Ogg(file, track);
+  if (track->Codec == LIBRARY_CODEC_MP3) {
+    uint32_t start = Tag_Read_ID3(file, track);
+    uint8_t buf[1024];
+    file.seek(start);
+    int32_t n = file.read(buf, sizeof(buf));
+    int sync = (n > 4) ? MP3FindSyncWord(buf, n) : -1;
+    MP3XingInfo_t xi;
+    if (sync >= 0 && MP3GetXingInfo(buf + sync, n - sync, &xi) == ERR_MP3_NONE && xi.samprate) {
+      track->Sample_Rate = xi.samprate;
+      track->Channels = xi.nChans;
+      if (xi.frames) {                                          // VBR, exact
+        track->Duration = (uint64_t)xi.frames * xi.samplesPerFrame / xi.samprate;
+      } else {                                                  // CBR, from the size of the first frame
+        int spf = 0;
+        int frameLen = MP3GetFrameSize(buf + sync, &spf);
+        if (frameLen > 0 && fileSize > start + sync)
+          track->Duration = (uint64_t)(fileSize - start - sync) / frameLen * spf / xi.samprate;
+      }
+    }
+  }
+  file.close();
+}
+
+/************************************************************  Build  ************************************************************/
+static int Entry_Compare(const void* a, const void* b)
+{
+  const char* na = Sort_Names + ((const Build_Entry*)a)->Name;
+  const char* nb = Sort_Names + ((const Build_Entry*)b)->Name;
+  int r = strcasecmp(na, nb);
+  return r ? r : strcmp(na, nb);
+}
+static uint32_t Build_String(Build_Buff* strings, const char* str)
+{
+  if (!str[0]) return LIBRARY_NONE;
+  uint32_t offset = strings->Len;
+  if (!Buff_Append(strings, str, strlen(str) + 1)) return LIBRARY_NONE;
+  return offset;
+}
+static bool Library_Build(const char* directory, const char* fileExtension)
+{
+  // Only new and changed files are parsed, the others are taken from the old database. Both lists are sorted by
+  // name, so they are compared in one pass.
+  uint32_t t0 = millis();
+  File Path = SD_MMC.open(directory);
+  if (!Path || !Path.isDirectory()) {
+    printf("Path: <%s> does not exist\r\n", directory);
+    return false;
+  }
+  Build_Buff names = {NULL, 0, 0}, entries = {NULL, 0, 0}, strings = {NULL, 0, 0}, records = {NULL, 0, 0};
+  uint32_t signature = 2166136261UL, count = 0, parsed = 0;
+  bool ok = true;
+
+  File file = Path.openNextFile();
+  while (file && ok) {
+    if (!file.isDirectory() && Extension_Match(file.name(), fileExtension)) {
+      Build_Entry e = {names.Len, (uint32_t)file.size(), (uint32_t)file.getLastWrite()};
+      ok = Buff_Append(&names, file.name(), strlen(file.name()) + 1) && Buff_Append(&entries, &e, sizeof(e));
+      signature = Name_Hash(signature, file.name());
+      count++;
+    }
+    file = Path.openNextFile();
+  }
+  Path.close();
+  if (count > 0xFFFF) count = 0xFFFF;                         // ACTIVE_TRACK_CNT is 16 bit
+  Build_Entry* entry = (Build_Entry*)entries.Data;
+  if (ok && count) {
+    Sort_Names = (const char*)names.Data;
+    qsort(entry, count, sizeof(Build_Entry), Entry_Compare);
+  }
+
+  bool reuse = Library_Valid && !strcmp(Header.Directory, directory) && !strcmp(Header.Extension, fileExtension);
+  uint32_t old = 0;
+  uint32_t lastArtist = LIBRARY_NONE, lastAlbum = LIBRARY_NONE;
+  char artist[LIBRARY_TAG_LEN] = "", album[LIBRARY_TAG_LEN] = "";
+  for (uint32_t i = 0; i < count && ok; i++) {
+    const char* name = (const char*)names.Data + entry[i].Name;
+    Library_Track track;
+    Library_Record r;
+    memset(&track, 0, sizeof(track));
+    track.Codec = Codec_From_Name(name);
+    bool found = false;
+    while (reuse && old < Header.Count) {                      // merge with the old database
+      Library_Record o;
+      char oldName[LIBRARY_NAME_LEN];
+      if (!Library_Record_Get(old, &o) || !Library_String(o.Name, oldName, sizeof(oldName))) { reuse = false; break; }
+      int c = strcasecmp(oldName, name);
+      if (!c) c = strcmp(oldName, name);
+      if (c > 0) break;
+      old++;
+      if (c < 0) continue;                                      // deleted file
+      if (o.Size == entry[i].Size && o.Time == entry[i].Time) {
+        Library_String(o.Title, track.Title, sizeof(track.Title));
+        Library_String(o.Artist, track.Artist, sizeof(track.Artist));
+        Library_String(o.Album, track.Album, sizeof(track.Album));
+        track.Duration = o.Duration;
+        track.Codec = o.Codec;
+        track.Channels = o.Channels;
+        track.Sample_Rate = o.Sample_Rate;
+        found = true;
+      }
+      break;
+    }
+    if (!found) {
+      char path[LIBRARY_NAME_LEN + 64];
+      Join_Path(path, sizeof(path), directory, name);
+      Library_Parse(path, &track);
+      parsed++;
+    }
+    if (!track.Title[0]) {                                      // no tag, the file name without extension
+      strncpy(track.Title, name, sizeof(track.Title) - 1);
+      track.Title[sizeof(track.Title) - 1] = 0;
+      char* dot = strrchr(track.Title, '.');
+      if (dot) *dot = 0;
+    }
+    r.Name = Build_String(&strings, name);
+    r.Title = Build_String(&strings, track.Title);
+    if (!track.Artist[0] || strcmp(track.Artist, artist)) {     // the tracks of an album follow each other
+      lastArtist = Build_String(&strings, track.Artist);
+      strcpy(artist, track.Artist);
+    }
+    if (!track.Album[0] || strcmp(track.Album, album)) {
+      lastAlbum = Build_String(&strings, track.Album);
+      strcpy(album, track.Album);
+    }
+    r.Artist = lastArtist;
+    r.Album = lastAlbum;
+    r.Size = entry[i].Size;
+    r.Time = entry[i].Time;
+    r.Duration = track.Duration;
+    r.Codec = track.Codec;
+    r.Channels = track.Channels;
+    r.Sample_Rate = track.Sample_Rate;
+    ok = (r.Name != LIBRARY_NONE) && Buff_Append(&records, &r, sizeof(r));
+  }
+
+  if (ok) {
+    Library_Header h;
+    memset(&h, 0, sizeof(h));
+    h.Magic = LIBRARY_MAGIC;
+    h.Count = count;
+    h.Signature = signature;
+    h.Strings = sizeof(Library_Header) + count * sizeof(Library_Record);
+    h.Strings_Size = strings.Len;
+    strncpy(h.Directory, directory, sizeof(h.Directory) - 1);
+    strncpy(h.Extension, fileExtension, sizeof(h.Extension) - 1);
+    File db = SD_MMC.open(LIBRARY_TMP, FILE_WRITE);
+    ok = db && db.write((uint8_t*)&h, sizeof(h)) == sizeof(h);
+    if (ok && records.Len) ok = db.write(records.Data, records.Len) == records.Len;
+    if (ok && strings.Len) ok = db.write(strings.Data, strings.Len) == strings.Len;
+    if (db) db.close();
+    Library_Close();
+    if (ok) {
+      SD_MMC.remove(LIBRARY_FILE);
+      ok = SD_MMC.rename(LIBRARY_TMP, LIBRARY_FILE);
+    }
+  }
+  if (!ok) printf("Music library: building the database failed\r\n");
+  else printf("Music library: %lu tracks, %lu parsed, %lu ms\r\n", (unsigned long)count, (unsigned long)parsed, (unsigned long)(millis() - t0));
+  free(names.Data);
+  free(entries.Data);
+  free(strings.Data);
+  free(records.Data);
+  return ok;
+}
+static bool Library_Unchanged(const char* directory, const char* fileExtension)
+{
+  // The directory time stamp is not updated by FAT when files are added, so the names are compared instead. This
+  // walk does not open the files, that is what makes Folder_retrieval() slow.
+  File Path = SD_MMC.open(directory);
+  if (!Path || !Path.isDirectory()) return false;
+  uint32_t signature = 2166136261UL, count = 0;
+  bool isDir = false;
+  String path = Path.getNextFileName(&isDir);
+  while (path.length()) {
+    const char* name = strrchr(path.c_str(), '/');
+    name = name ? name + 1 : path.c_str();
+    if (!isDir && Extension_Match(name, fileExtension)) {
+      signature = Name_Hash(signature, name);
+      count++;
+    }
+    path = Path.getNextFileName(&isDir);
+  }
+  Path.close();
+  if (count > 0xFFFF) count = 0xFFFF;
+  return count == Header.Count && signature == Header.Signature;
+}
+
+/************************************************************  API  ************************************************************/
+uint32_t Library_Init(const char* directory, const char* fileExtension, bool rebuild)
+{
+  Library_Close();
+  Library_Open();
+  bool same = Library_Valid && !strcmp(Header.Directory, directory) && !strcmp(Header.Extension, fileExtension);
+  if (rebuild || !same || !Library_Unchanged(directory, fileExtension)) {
+    if (!Library_Build(directory, fileExtension)) {
+      Library_Close();
+      return 0;
+    }
+    Library_Open();
+  }
+  if (!Library_Valid) return 0;
+  printf("Music library: %lu tracks in %s\r\n", (unsigned long)Header.Count, directory);
+  return Header.Count;
+}
+uint32_t Library_Count()
+{
+  return Library_Valid ? Header.Count : 0;
+}
+bool Library_Get(uint32_t index, Library_Track* track)
+{
+  Library_Record r;
+  if (!Library_Record_Get(index, &r)) return false;
+  Library_String(r.Name, track->Name, sizeof(track->Name));
+  Library_String(r.Title, track->Title, sizeof(track->Title));
+  Library_String(r.Artist, track->Artist, sizeof(track->Artist));
+  Library_String(r.Album, track->Album, sizeof(track->Album));
+  track->Duration = r.Duration;
+  track->Codec = r.Codec;
+  track->Channels = r.Channels;
+  track->Sample_Rate = r.Sample_Rate;
+  return true;
+}
+bool Library_Name(uint32_t index, char* name, uint16_t len)
+{
+  Library_Record r;
+  if (!Library_Record_Get(index, &r)) return false;
+  return Library_String(r.Name, name, len);
+}
+bool Library_Title(uint32_t index, char* title, uint16_t len)
+{
+  Library_Record r;
+  if (!Library_Record_Get(index, &r)) return false;
+  return Library_String(r.Title, title, len);
+}
+int32_t Library_Find(const char* fileName)
+{
+  // binary search, the records are sorted by name
+  int32_t lo = 0, hi = (int32_t)Library_Count() - 1;
+  char name[LIBRARY_NAME_LEN];
+  while (lo <= hi) {
+    int32_t mid = (lo + hi) / 2;
+    if (!Library_Name(mid, name, sizeof(name))) return -1;
+    int c = strcasecmp(name, fileName);
+    if (!c) c = strcmp(name, fileName);
+    if (!c) return mid;
+    if (c < 0) lo = mid + 1;
+    else hi = mid - 1;
+  }
+  return -1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Arduino.h"
+#include <cstring>
+#include "FS.h"
+#include "SD_MMC.h"
+
+#define LIBRARY_FILE          "/.library.db"        // hidden, next to the music
+#define LIBRARY_TMP           "/.library.tmp"
+#define LIBRARY_MAGIC         0x3242444C            // "LDB2", "LDB1" had the duration of mp3 files only
+#define LIBRARY_PAGE_SIZE     2048                  // the database is read in pages, never as a whole
+#define LIBRARY_PAGES         4
+#define LIBRARY_NAME_LEN      100                   // file name, as before with Folder_retrieval()
+#define LIBRARY_TAG_LEN       64                    // title, artist, album (UTF-8)
+#define LIBRARY_NONE          0xFFFFFFFF            // string not present
+
+enum {
+  LIBRARY_CODEC_NONE = 0,
+  LIBRARY_CODEC_MP3,
+  LIBRARY_CODEC_M4A,
+  LIBRARY_CODEC_FLAC,
+  LIBRARY_CODEC_WAV,
+  LIBRARY_CODEC_OGG,
+};
+
+typedef struct __attribute__((packed)) {
+  uint32_t Magic;
+  uint32_t Count;
+  uint32_t Signature;                               // FNV-1a over the file names in directory order
+  uint32_t Strings;                                 // file position of the string table
+  uint32_t Strings_Size;
+  char     Directory[64];
+  char     Extension[8];
+} Library_Header;
+
+typedef struct __attribute__((packed)) {            // 32 bytes, sorted by file name
+  uint32_t Name;                                    // offsets in the string table
+  uint32_t Title;
+  uint32_t Artist;
+  uint32_t Album;
+  uint32_t Size;                                    // size and time of the file, an unchanged file is not parsed again
+  uint32_t Time;
+  uint16_t Duration;                                // seconds, 0: unknown
+  uint8_t  Codec;
+  uint8_t  Channels;
+  uint32_t Sample_Rate;
+} Library_Record;
+
+typedef struct {
+  char     Name[LIBRARY_NAME_LEN];
+  char     Title[LIBRARY_TAG_LEN];                  // ID3 title, otherwise the file name without extension
+  char     Artist[LIBRARY_TAG_LEN];
+  char     Album[LIBRARY_TAG_LEN];
+  uint16_t Duration;
+  uint8_t  Codec;
+  uint8_t  Channels;
+  uint32_t Sample_Rate;
+} Library_Track;
+
+uint32_t Library_Init(const char* directory, const char* fileExtension, bool rebuild);  // returns the number of tracks
+void     Library_Close();
+uint32_t Library_Count();
+bool     Library_Get(uint32_t index, Library_Track* track);
+bool     Library_Name(uint32_t index, char* name, uint16_t len);                         // file name only, cheaper
+bool     Library_Title(uint32_t index, char* title, uint16_t len);
+int32_t  Library_Find(const char* fileName);                                            // index, -1: not in the library
@@ -17,4 +17,3 @@ void SD_Init();
 void Flash_test();
 
 bool File_Search(const char* directory, const char* fileName);
-uint16_t Folder_retrieval(const char* directory, const char* fileExtension, char File_Name[][100],uint16_t maxFiles);
@@ -0,0 +1,319 @@
+#include "Voice_Encoder.h"
+#include "opus_decoder/celt_encoder.h"
+
+// MICTask takes the utterance from the capture ring while it is still spoken and encodes it frame by frame, so the
+// upload overlaps the speech. IMA-ADPCM (4:1, next to no CPU) is the baseline; Ogg Opus, made by the CELT encoder of
+// the audio library at 24 kbit/s, is 9.5:1 with the page overhead. The sink gets the container header, then whole
+// blocks or pages. The stream size is not known in advance, the WAV header has the streaming value 0xFFFFFFFF.
+
+#define VOICE_FRAME_MAX       VOICE_ADPCM_SAMPLES
+#define VOICE_OGG_HEADER      (27 + VOICE_OGG_FRAMES)
+#define VOICE_OGG_PAGE        (VOICE_OGG_HEADER + VOICE_OGG_FRAMES * VOICE_OPUS_BYTES)
+#define VOICE_OUT_SIZE        (2 * 64 + VOICE_OGG_PAGE) // OpusHead and OpusTags pages, or an audio page
+
+static uint8_t  Format = VOICE_FORMAT_ADPCM;
+static Voice_Sink_Cb Sink = NULL;
+static Voice_Stats Stat;
+static bool     Active = false;
+static int16_t  Frame[VOICE_FRAME_MAX];
+static uint16_t Frame_Fill = 0;
+static uint8_t* Out = NULL;                         // the next sink call is assembled here
+
+static int16_t  Adpcm_Predictor = 0;
+static uint8_t  Adpcm_Index = 0;
+
+static uint8_t  Page_Packets = 0;                   // Opus packets in Out behind the page header
+static uint32_t Page_Sequence = 0;
+static uint64_t Granule = 0;                        // 48 kHz samples decoded up to the end of the last packet
+
+static const int16_t Adpcm_Step[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+  118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+  6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767,
+};
+static const int8_t Adpcm_Index_Step[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static void Put_16(uint8_t* p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+static void Put_32(uint8_t* p, uint32_t v)
+{
+  Put_16(p, v);
+  Put_16(p + 2, v >> 16);
+}
+
+/************************************************************  IMA-ADPCM  ************************************************************/
+void Voice_ADPCM_Reset()
+{
+  Adpcm_Predictor = 0;
+  Adpcm_Index = 0;
+}
+uint32_t Voice_ADPCM_Header(uint8_t* out)
+{
+  memcpy(out, "RIFF", 4);
+  Put_32(out + 4, 0xFFFFFFFF);
+  memcpy(out + 8, "WAVEfmt ", 8);
+  Put_32(out + 16, 20);
+  Put_16(out + 20, 0x11);                           // WAVE_FORMAT_IMA_ADPCM
+  Put_16(out + 22, 1);
+  Put_32(out + 24, MIC_SAMPLE_RATE);
+  Put_32(out + 28, MIC_SAMPLE_RATE * VOICE_ADPCM_BLOCK / VOICE_ADPCM_SAMPLES);
+  Put_16(out + 32, VOICE_ADPCM_BLOCK);
+  Put_16(out + 34, 4);
+  Put_16(out + 36, 2);
+  Put_16(out + 38, VOICE_ADPCM_SAMPLES);
+  memcpy(out + 40, "data", 4);
+  Put_32(out + 44, 0xFFFFFFFF);
+  return 48;
+}
+static uint8_t Adpcm_Nibble(int16_t sample)
+{
+  int32_t step = Adpcm_Step[Adpcm_Index];
+  int32_t diff = sample - Adpcm_Predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+  int32_t delta = step >> 3;                        // what the decoder adds: rounded like there
+  if (diff >= step) { code |= 4; diff -= step; delta += step; }
+  step >>= 1;
+  if (diff >= step) { code |= 2; diff -= step; delta += step; }
+  step >>= 1;
+  if (diff >= step) { code |= 1; delta += step; }
+  int32_t p = Adpcm_Predictor + ((code & 8) ? -delta : delta);
+  Adpcm_Predictor = p > 32767 ? 32767 : p < -32768 ? -32768 : p;
+  int32_t i = Adpcm_Index + Adpcm_Index_Step[code & 7];
+  Adpcm_Index = i < 0 ? 0 : i > 88 ? 88 : i;
+  return code;
+}
+uint32_t Voice_ADPCM_Block(const int16_t* pcm, uint8_t* out)
+{
+  Adpcm_Predictor = pcm[0];                         // the first sample is sent as it is
+  Put_16(out, pcm[0]);
+  out[2] = Adpcm_Index;
+  out[3] = 0;
+  for (int i = 1; i < VOICE_ADPCM_SAMPLES; i += 2) {
+    uint8_t lo = Adpcm_Nibble(pcm[i]);
+    out[4 + i / 2] = lo | (Adpcm_Nibble(pcm[i + 1]) << 4);
+  }
+  return VOICE_ADPCM_BLOCK;
+}
+
+/************************************************************  Ogg Opus  ************************************************************/
+static uint32_t Ogg_CRC(const uint8_t* p, uint32_t len)
+{
+  // bitwise, a page is some hundred bytes every 100 ms; the table of the Ogg demuxer belongs to the player
+  uint32_t crc = 0;
+  while (len--) {
+    crc ^= (uint32_t)*p++ << 24;
+    for (int i = 0; i < 8; i++) crc = (crc & 0x80000000UL) ? (crc << 1) ^ 0x04C11DB7UL : crc << 1;
+  }
+  return crc;
+}
+static uint32_t Ogg_Page(uint8_t* page, uint8_t type, uint64_t granule, const uint8_t* lacing, uint8_t segments,
+                         uint32_t body)
+{
+  // the body is already in place behind the segment table
+  memcpy(page, "OggS", 4);
+  page[4] = 0;
+  page[5] = type;                                   // 2: first page, 4: last page
+  Put_32(page + 6, (uint32_t)granule);
+  Put_32(page + 10, (uint32_t)(granule >> 32));
+  Put_32(page + 14, VOICE_OGG_SERIAL);
+  Put_32(page + 18, Page_Sequence++);
+  Put_32(page + 22, 0);
+  page[26] = segments;
+  memcpy(page + 27, lacing, segments);
+  uint32_t size = 27 + segments + body;
+  Put_32(page + 22, Ogg_CRC(page, size));
+  return size;
+}
+static uint32_t Ogg_Opus_Headers(uint8_t* out)
+{
+  uint8_t* body = out + 28;
+  memcpy(body, "OpusHead", 8);
+  body[8] = 1;                                      // version
+  body[9] = 1;                                      // mono
+  Put_16(body + 10, VOICE_OPUS_PRESKIP);
+  Put_32(body + 12, MIC_SAMPLE_RATE);
+  Put_16(body + 16, 0);                             // output gain
+  body[18] = 0;                                     // mapping family
+  uint8_t lacing = 19;
+  uint32_t n = Ogg_Page(out, 2, 0, &lacing, 1, 19);
+
+  static const char vendor[] = "ESP32-S3 voice encoder";
+  body = out + n + 28;
+  memcpy(body, "OpusTags", 8);
+  Put_32(body + 8, sizeof(vendor) - 1);
+  memcpy(body + 12, vendor, sizeof(vendor) - 1);
+  Put_32(body + 12 + sizeof(vendor) - 1, 0);        // no comments
+  lacing = 16 + sizeof(vendor) - 1;
+  return n + Ogg_Page(out + n, 0, 0, &lacing, 1, lacing);
+}
+static uint32_t Ogg_Flush(bool last)
+{
+  if (!Page_Packets && !last) return 0;
+  uint8_t lacing[VOICE_OGG_FRAMES];
+  memset(lacing, VOICE_OPUS_BYTES, sizeof(lacing));
+  // the packets were written for a full segment table, move them up if the page is short
+  if (Page_Packets < VOICE_OGG_FRAMES)
+    memmove(Out + 27 + Page_Packets, Out + VOICE_OGG_HEADER, Page_Packets * VOICE_OPUS_BYTES);
+  uint32_t n = Ogg_Page(Out, last ? 4 : 0, Granule, lacing, Page_Packets, Page_Packets * VOICE_OPUS_BYTES);
+  Page_Packets = 0;
+  return n;
+}
+
+/************************************************************  Stream  ************************************************************/
+static uint16_t Frame_Size()
+{
+  return Format == VOICE_FORMAT_OPUS ? VOICE_OPUS_FRAME : VOICE_ADPCM_SAMPLES;
+}
+static void Emit(uint8_t event, uint32_t len)
+{
+  Stat.Bytes += len;
+  if (Sink) Sink(event, Out, len);
+}
+static void Start()
+{
+  uint32_t n;
+  if (Format == VOICE_FORMAT_OPUS) {
+    celt_encoder_reset();
+    Page_Sequence = 0;
+    Page_Packets = 0;
+    Granule = 0;
+    n = Ogg_Opus_Headers(Out);
+  }
+  else {
+    Voice_ADPCM_Reset();
+    n = Voice_ADPCM_Header(Out);
+  }
+  Frame_Fill = 0;
+  Active = true;
+  Stat.Utterances++;
+  Emit(VOICE_START, n);
+}
+static uint32_t Encode_Frame()
+{
+  // returns the ADPCM block in Out, an Opus packet is added to the page in Out
+  uint32_t t = micros();
+  uint32_t n = 0;
+  if (Format == VOICE_FORMAT_OPUS) {
+    uint8_t* packet = Out + VOICE_OGG_HEADER + Page_Packets * VOICE_OPUS_BYTES;
+    if (celt_encode(Frame, VOICE_OPUS_FRAME, packet, VOICE_OPUS_BYTES) != VOICE_OPUS_BYTES)
+      memset(packet, 0, VOICE_OPUS_BYTES);
+    Page_Packets++;
+    Granule += VOICE_OPUS_FRAME * (48000 / MIC_SAMPLE_RATE);
+  }
+  else n = Voice_ADPCM_Block(Frame, Out);
+  t = micros() - t;
+  Stat.Encode_Us = t;
+  if (t > Stat.Encode_Us_Max) Stat.Encode_Us_Max = t;
+  Stat.Encode_Us_Sum += t;
+  Stat.Frames++;
+  Frame_Fill = 0;
+  return n;
+}
+static void Frame_Done()
+{
+  uint32_t n = Encode_Frame();
+  if (Format == VOICE_FORMAT_OPUS && Page_Packets == VOICE_OGG_FRAMES) n = Ogg_Flush(false);
+  if (n) Emit(VOICE_DATA, n);
+}
+static void Finish()
+{
+  // zero padding; the decoder output lags VOICE_OPUS_PRESKIP behind, a frame more if the padding does not cover it
+  uint32_t n = 0;
+  if (Format == VOICE_FORMAT_OPUS) {
+    uint64_t samples = Granule + Frame_Fill * (48000 / MIC_SAMPLE_RATE);
+    while (Frame_Fill || Granule < samples + VOICE_OPUS_PRESKIP) {
+      if (Page_Packets == VOICE_OGG_FRAMES) Emit(VOICE_DATA, Ogg_Flush(false));
+      memset(&Frame[Frame_Fill], 0, (VOICE_OPUS_FRAME - Frame_Fill) * sizeof(int16_t));
+      Encode_Frame();
+    }
+    Granule = samples + VOICE_OPUS_PRESKIP;         // the last page has a packet, its granule trims the padding
+    n = Ogg_Flush(true);
+  }
+  else if (Frame_Fill) {
+    memset(&Frame[Frame_Fill], 0, (VOICE_ADPCM_SAMPLES - Frame_Fill) * sizeof(int16_t));
+    n = Encode_Frame();
+  }
+  Active = false;
+  Emit(VOICE_END, n);
+}
+bool Voice_Encoder_Init(uint8_t format, Voice_Sink_Cb sink)
+{
+  if (!Out) {
+    Out = (uint8_t*)(psramFound() ? ps_malloc(VOICE_OUT_SIZE) : malloc(VOICE_OUT_SIZE));
+    if (!Out) {
+      printf("Voice: no memory for the output buffer\r\n");
+      return false;
+    }
+  }
+  if (format == VOICE_FORMAT_OPUS) {
+    if (!CELTEncoder_AllocateBuffers() || celt_encoder_init(MIC_SAMPLE_RATE, VOICE_OPUS_BANDS) != 0) {
+      printf("Voice: no CELT encoder, IMA-ADPCM is used\r\n");
+      format = VOICE_FORMAT_ADPCM;
+    }
+  }
+  Format = format;
+  Sink = sink;
+  Active = false;
+  return true;
+}
+void Voice_Encoder_Process()
+{
+  if (!Out || !Sink) return;
+  uint8_t state = MIC_Capture_State();
+  if (!Active) {
+    if (state == MIC_IDLE) return;
+    Start();
+  }
+  else if (state == MIC_IDLE) {                     // lost, or given up for a new one
+    Active = false;
+    Emit(VOICE_ABORT, 0);
+    return;
+  }
+
+  MIC_Slice slice[2];
+  uint8_t slices = MIC_Capture_Get(slice);
+  uint32_t taken = 0;
+  uint16_t size = Frame_Size();
+  for (uint8_t s = 0; s < slices; s++) {
+    const int16_t* x = slice[s].Data;
+    uint32_t left = slice[s].Samples;
+    while (left) {
+      uint32_t n = size - Frame_Fill;
+      if (n > left) n = left;
+      memcpy(&Frame[Frame_Fill], x, n * sizeof(int16_t));
+      Frame_Fill += n;
+      x += n;
+      left -= n;
+      taken += n;
+      if (Frame_Fill == size) Frame_Done();
+    }
+  }
+  Stat.Samples += taken;
+  if (taken && !MIC_Capture_Release(taken)) {      // overwritten while it was encoded
+    Active = false;
+    Emit(VOICE_ABORT, 0);
+    MIC_Capture_Finish();
+    return;
+  }
+  if (state == MIC_ENDED && !taken) {              // all of it is taken
+    Finish();
+    MIC_Capture_Finish();
+  }
+}
+bool Voice_Encoder_Active()
+{
+  return Active;
+}
+const Voice_Stats* Voice_Encoder_Get_Stats()
+{
+  return &Stat;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "Arduino.h"
+#include <cstring>
+#include "MIC_Capture.h"
+
+#define VOICE_ADPCM_BLOCK     256                   // bytes per IMA-ADPCM block (WAV blockAlign), 4 bytes header
+#define VOICE_ADPCM_SAMPLES   505                   // per block: the header sample and 252 x 2 nibbles
+#define VOICE_OPUS_FRAME      320                   // 20 ms at 16 kHz, one CELT frame
+#define VOICE_OPUS_BYTES      60                    // per frame with the TOC byte: 24 kbit/s, constant
+#define VOICE_OPUS_BANDS      17                    // wideband, 8 kHz audio bandwidth
+#define VOICE_OPUS_PRESKIP    120                   // 48 kHz samples the decoder drops, the MDCT overlap
+#define VOICE_OGG_FRAMES      5                     // packets per page: 100 ms of speech per sink call
+#define VOICE_OGG_SERIAL      0x566F6963UL          // "Voic"
+
+enum {
+  VOICE_FORMAT_ADPCM = 0,                           // WAV, 4 bit IMA-ADPCM: 8.1 KB/s
+  VOICE_FORMAT_OPUS,                                // Ogg Opus, CELT only: 3 KB/s
+};
+
+enum {
+  VOICE_START = 0,                                  // data: the container header
+  VOICE_DATA,                                       // data: whole ADPCM blocks or Ogg pages
+  VOICE_END,                                        // data: the last block or page, the stream is complete
+  VOICE_ABORT,                                      // no data, the utterance was lost: discard the stream
+};
+
+typedef struct {
+  uint32_t Utterances;
+  uint32_t Frames;                                  // ADPCM blocks or Opus frames
+  uint32_t Samples;                                 // taken from the capture ring
+  uint32_t Bytes;                                   // handed to the sink, headers included
+  uint32_t Encode_Us;                               // last frame, worst frame, all frames
+  uint32_t Encode_Us_Max;
+  uint64_t Encode_Us_Sum;
+} Voice_Stats;
+
+typedef void (*Voice_Sink_Cb)(uint8_t event, const uint8_t* data, uint32_t len);  // MICTask, must not block long
+
+bool    Voice_Encoder_Init(uint8_t format, Voice_Sink_Cb sink);                 // in the task that captures
+void    Voice_Encoder_Process();                                                // after MIC_Capture_Process()
+bool    Voice_Encoder_Active();                                                 // a stream is open
+const Voice_Stats* Voice_Encoder_Get_Stats();
+
+// the encoders without the capture ring, e.g. for tests
+void     Voice_ADPCM_Reset();
+uint32_t Voice_ADPCM_Header(uint8_t* out);                                      // 48 bytes WAV header, streaming sizes
+uint32_t Voice_ADPCM_Block(const int16_t* pcm, uint8_t* out);                   // VOICE_ADPCM_SAMPLES -> VOICE_ADPCM_BLOCK
@@ -0,0 +1,304 @@
+/*
+ * test_album_art.cpp
+ * Album_Art: the picture of ID3v2.3/2.4, FLAC and MP4 tags against a full size reference decode, front cover
+ * preference, pictures that are not decoded, the SD card cache and its invalidation, LRU eviction of unheld entries
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Album_Art.h"
+#include "src/extra/libs/sjpg/tjpgd.h"
+#include <sys/stat.h>
+#include <utime.h>
+
+#define ART_FRONT       "../../examples/ESP32_A1S/A1S_Radio1.jpg"         // baseline, 800 x 800
+#define ART_OTHER       "../../examples/DLNA/additional_info/DLNA_web.jpg" // baseline, 678 x 481
+#define ART_PROGRESSIVE "../../examples/Simple_WiFi_Radio/Simple_WiFi_Radio.jpg"
+#define ART_TIMEOUT     5000 // ms
+#define ART_TOLERANCE   8    // mean difference per channel: RGB565 and the 1/2^n scaled decode (5.5 and 6.7 measured),
+                             // another picture differs by > 100
+
+static std::string s_root;
+fs::FS             SD_MMC("");
+
+typedef std::vector<uint8_t> bytes_t;
+typedef struct { uint8_t r, g, b; } rgb_t;
+
+static void put32(bytes_t& d, uint32_t v) { for(int s = 24; s >= 0; s -= 8) d.push_back(v >> s); }
+static void putSyncsafe(bytes_t& d, uint32_t v) { for(int s = 21; s >= 0; s -= 7) d.push_back((v >> s) & 0x7F); }
+static void append(bytes_t& d, const bytes_t& s) { d.insert(d.end(), s.begin(), s.end()); }
+static void append(bytes_t& d, const char* s, size_t n) { d.insert(d.end(), s, s + n); }
+static void writeFile(const std::string& name, const bytes_t& d) {
+    FILE* f = fopen((s_root + "/" + name).c_str(), "wb");
+    fwrite(d.data(), 1, d.size(), f);
+    fclose(f);
+}
+static void setTime(const std::string& path, time_t t) {
+    struct utimbuf u = {t, t};
+    utime(path.c_str(), &u);
+}
+static bytes_t atom(const char* type, const bytes_t& body) {
+    bytes_t a;
+    put32(a, body.size() + 8);
+    append(a, type, 4);
+    append(a, body);
+    return a;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// tags around the pictures
+static bytes_t apic(uint8_t ver, uint8_t type, const bytes_t& img) {
+    bytes_t body = {0};                                   // ISO-8859-1
+    append(body, "image/jpeg", 11);
+    body.push_back(type);
+    if(ver == 4) { body[0] = 1; append(body, "\xff\xfe" "d\0\0\0", 6); } // UTF-16 description
+    else append(body, "cover", 6);
+    append(body, img);
+    bytes_t f;
+    append(f, "APIC", 4);
+    if(ver == 4) putSyncsafe(f, body.size()); else put32(f, body.size());
+    f.push_back(0);
+    f.push_back(0);
+    append(f, body);
+    return f;
+}
+static bytes_t id3(uint8_t ver, const std::vector<bytes_t>& frames, const bytes_t& audio) {
+    bytes_t t;
+    for(auto& f : frames) append(t, f);
+    t.resize(t.size() + 64, 0);                           // padding
+    bytes_t d = {'I', 'D', '3', ver, 0, 0};
+    putSyncsafe(d, t.size());
+    append(d, t);
+    append(d, audio);
+    return d;
+}
+static bytes_t flac(const bytes_t& img) {
+    bytes_t d = {'f', 'L', 'a', 'C', 0x00, 0, 0, 34};     // STREAMINFO
+    d.resize(d.size() + 34, 0);
+    bytes_t p;
+    put32(p, 3);
+    put32(p, 10);
+    append(p, "image/jpeg", 10);
+    put32(p, 0);                                          // description
+    for(int i = 0; i < 4; i++) put32(p, 0);               // width, height, depth, colors
+    put32(p, img.size());
+    append(p, img);
+    d.push_back(0x86);                                    // last block, PICTURE
+    d.push_back(p.size() >> 16);
+    d.push_back(p.size() >> 8);
+    d.push_back(p.size());
+    append(d, p);
+    return d;
+}
+static bytes_t m4a(const bytes_t& img) {
+    bytes_t data = {0, 0, 0, 13, 0, 0, 0, 0};             // JPEG, locale
+    append(data, img);
+    bytes_t meta = {0, 0, 0, 0};                          // version, flags
+    append(meta, atom("ilst", atom("covr", atom("data", data))));
+    bytes_t d = atom("ftyp", {'M', '4', 'A', ' ', 0, 0, 0, 0});
+    append(d, atom("moov", atom("udta", atom("meta", meta))));
+    append(d, atom("mdat", bytes_t(256, 0)));
+    return d;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// reference: full size decode, then the box filter of the centred square
+typedef struct { const bytes_t* d; size_t pos; std::vector<rgb_t>* rgb; uint16_t w; } ref_src_t;
+static size_t refInput(JDEC* jd, uint8_t* buff, size_t n) {
+    ref_src_t* s = (ref_src_t*)jd->device;
+    n = min(n, s->d->size() - s->pos);
+    if(buff) memcpy(buff, s->d->data() + s->pos, n);
+    s->pos += n;
+    return n;
+}
+static int refOutput(JDEC* jd, void* bitmap, JRECT* r) {
+    ref_src_t* s = (ref_src_t*)jd->device;
+    const rgb_t* p = (const rgb_t*)bitmap;
+    for(int y = r->top; y <= r->bottom; y++)
+        for(int x = r->left; x <= r->right; x++) (*s->rgb)[y * s->w + x] = *p++;
+    return 1;
+}
+static std::vector<rgb_t> reference(const bytes_t& img) {
+    std::vector<rgb_t> full, out;
+    static uint8_t work[ALBUM_ART_WORK];
+    JDEC      jd;
+    ref_src_t s = {&img, 0, &full, 0};
+    if(jd_prepare(&jd, refInput, work, sizeof(work), &s) != JDR_OK) return out;
+    s.w = jd.width;
+    full.resize((size_t)jd.width * jd.height);
+    if(jd_decomp(&jd, refOutput, 0) != JDR_OK) return out;
+    uint32_t side = min(jd.width, jd.height), ox = (jd.width - side) / 2, oy = (jd.height - side) / 2;
+    for(uint32_t y = 0; y < ALBUM_ART_SIZE; y++) {
+        for(uint32_t x = 0; x < ALBUM_ART_SIZE; x++) {
+            uint32_t y0 = oy + y * side / ALBUM_ART_SIZE, y1 = oy + (y + 1) * side / ALBUM_ART_SIZE;
+            uint32_t x0 = ox + x * side / ALBUM_ART_SIZE, x1 = ox + (x + 1) * side / ALBUM_ART_SIZE;
+            uint32_t r = 0, g = 0, b = 0, n = (y1 - y0) * (x1 - x0);
+            for(uint32_t sy = y0; sy < y1; sy++)
+                for(uint32_t sx = x0; sx < x1; sx++) { rgb_t c = full[sy * jd.width + sx]; r += c.r; g += c.g; b += c.b; }
+            out.push_back({(uint8_t)(r / n), (uint8_t)(g / n), (uint8_t)(b / n)});
+        }
+    }
+    return out;
+}
+// mean difference per channel of a thumbnail to a reference
+static double difference(const lv_img_dsc_t* img, const std::vector<rgb_t>& ref) {
+    if(!img || ref.size() != ALBUM_ART_SIZE * ALBUM_ART_SIZE) return 1e9;
+    const lv_color_t* px = (const lv_color_t*)img->data;
+    double sum = 0;
+    for(size_t i = 0; i < ref.size(); i++) {
+        uint32_t c = lv_color_to32(px[i]);
+        sum += abs((int)((c >> 16) & 0xFF) - ref[i].r) + abs((int)((c >> 8) & 0xFF) - ref[i].g) + abs((int)(c & 0xFF) - ref[i].b);
+    }
+    return sum / ref.size() / 3;
+}
+static uint8_t waitArt(const char* name, const lv_img_dsc_t** img) {
+    *img = NULL;
+    uint8_t state = ALBUM_ART_PENDING;
+    for(int t = 0; t < ART_TIMEOUT && (state = Album_Art_Get(name, img)) == ALBUM_ART_PENDING; t++) delay(1);
+    return state;
+}
+static uint8_t load(const char* name, const lv_img_dsc_t** img) {
+    Album_Art_Request("/", name);
+    return waitArt(name, img);
+}
+// other tracks without a picture push the unheld entries out of the RAM cache
+static void fillCache(int n) {
+    static int next = 0;
+    bytes_t audio(3000, 0x55);
+    for(int i = 0; i < n; i++) {
+        std::string name = "filler" + std::to_string(next++) + ".mp3";
+        writeFile(name, audio);
+        const lv_img_dsc_t* img;
+        TEST_CHECK_EQ(load(name.c_str(), &img), ALBUM_ART_NONE);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bytes_t s_front, s_other, s_progressive, s_audio;
+
+static void test_art_formats() {
+    std::vector<rgb_t> ref = reference(s_front), refOther = reference(s_other);
+    TEST_CHECK(!ref.empty() && !refOther.empty());
+
+    // the front cover is taken even if another picture comes first
+    writeFile("v23.mp3", id3(3, {apic(3, 0, s_other), apic(3, 3, s_front)}, s_audio));
+    writeFile("v24.mp3", id3(4, {apic(4, 3, s_front)}, s_audio));
+    writeFile("other.mp3", id3(3, {apic(3, 0, s_other)}, s_audio));
+    writeFile("f.flac", flac(s_front));
+    writeFile("m.m4a", m4a(s_front));
+    const char* names[] = {"v23.mp3", "v24.mp3", "f.flac", "m.m4a"};
+    for(const char* name : names) {
+        const lv_img_dsc_t* img;
+        TEST_CHECK_EQ(load(name, &img), ALBUM_ART_READY);
+        if(!img) continue;
+        TEST_CHECK_EQ(img->header.w, ALBUM_ART_SIZE);
+        TEST_CHECK_EQ(img->header.h, ALBUM_ART_SIZE);
+        TEST_CHECK_EQ(img->header.cf, LV_IMG_CF_TRUE_COLOR);
+        TEST_CHECK(difference(img, ref) < ART_TOLERANCE);
+        TEST_CHECK(difference(img, refOther) > 20);
+        Album_Art_Release(img);
+    }
+    const lv_img_dsc_t* img;
+    TEST_CHECK_EQ(load("other.mp3", &img), ALBUM_ART_READY); // the only picture, not square
+    TEST_CHECK(difference(img, refOther) < ART_TOLERANCE);
+    Album_Art_Release(img);
+
+    // no picture, progressive JPEG, PNG, missing file: the default cover
+    bytes_t png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    png.resize(2000, 0);
+    writeFile("none.mp3", s_audio);
+    writeFile("prog.mp3", id3(3, {apic(3, 3, s_progressive)}, s_audio));
+    writeFile("png.mp3", id3(3, {apic(3, 3, png)}, s_audio));
+    const char* none[] = {"none.mp3", "prog.mp3", "png.mp3", "missing.mp3"};
+    for(const char* name : none) TEST_CHECK_EQ(load(name, &img), ALBUM_ART_NONE);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_art_cache() {
+    const lv_img_dsc_t* img;
+    TEST_CHECK_EQ(load("v23.mp3", &img), ALBUM_ART_READY);
+    bytes_t pixels(img->data, img->data + img->data_size);
+    Album_Art_Release(img);
+
+    // out of RAM, the music file unchanged (the content is not compared, only size and time): the thumbnail comes
+    // from the SD card
+    fillCache(ALBUM_ART_CACHE + 2);
+    TEST_CHECK_EQ(Album_Art_Get("v23.mp3", &img), ALBUM_ART_PENDING);
+    std::string v23 = s_root + "/v23.mp3";
+    struct stat st;
+    TEST_CHECK(stat(v23.c_str(), &st) == 0);
+    long   size = st.st_size;
+    time_t time = st.st_mtime;
+    writeFile("v23.mp3", bytes_t(size, 0x33));
+    setTime(v23, time);
+    TEST_CHECK_EQ(load("v23.mp3", &img), ALBUM_ART_READY);
+    TEST_CHECK(img && !memcmp(img->data, pixels.data(), pixels.size()));
+    Album_Art_Release(img);
+    // "no picture" is cached as well
+    fillCache(ALBUM_ART_CACHE);
+    TEST_CHECK(stat((s_root + "/none.mp3").c_str(), &st) == 0);
+    writeFile("none.mp3", bytes_t(s_audio.size(), 0));
+    setTime(s_root + "/none.mp3", st.st_mtime);
+    TEST_CHECK_EQ(load("none.mp3", &img), ALBUM_ART_NONE);
+
+    // replaced by a file of the same size, written later: decoded again
+    fillCache(ALBUM_ART_CACHE);
+    setTime(v23, time + 60);
+    TEST_CHECK_EQ(load("v23.mp3", &img), ALBUM_ART_NONE);
+    // another size: decoded again
+    writeFile("v23.mp3", id3(3, {apic(3, 3, s_front)}, s_audio));
+    fillCache(ALBUM_ART_CACHE);
+    TEST_CHECK_EQ(load("v23.mp3", &img), ALBUM_ART_READY);
+    Album_Art_Release(img);
+    fillCache(ALBUM_ART_CACHE);
+    writeFile("v23.mp3", bytes_t(size + 1, 0x33));
+    setTime(v23, time);
+    TEST_CHECK_EQ(load("v23.mp3", &img), ALBUM_ART_NONE);
+    writeFile("v23.mp3", id3(3, {apic(3, 3, s_front)}, s_audio));
+    fillCache(ALBUM_ART_CACHE);
+    TEST_CHECK_EQ(load("v23.mp3", &img), ALBUM_ART_READY);
+    Album_Art_Release(img);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_art_lru() {
+    // an entry held by an album image is never evicted, an unheld one is
+    const lv_img_dsc_t *held, *img;
+    TEST_CHECK_EQ(load("f.flac", &held), ALBUM_ART_READY);
+    TEST_CHECK_EQ(Album_Art_Get("f.flac", &img), ALBUM_ART_READY); // held twice
+    TEST_CHECK(img == held);
+    bytes_t pixels(held->data, held->data + held->data_size);
+    fillCache(2 * ALBUM_ART_CACHE);
+    TEST_CHECK_EQ(Album_Art_Get("f.flac", &img), ALBUM_ART_READY);
+    TEST_CHECK(img == held && !memcmp(img->data, pixels.data(), pixels.size()));
+    Album_Art_Release(held);
+    Album_Art_Release(held);
+    fillCache(2 * ALBUM_ART_CACHE);
+    TEST_CHECK_EQ(Album_Art_Get("f.flac", &img), ALBUM_ART_READY);  // released once less than taken
+    Album_Art_Release(img);
+    Album_Art_Release(img);
+    fillCache(ALBUM_ART_CACHE);
+    TEST_CHECK_EQ(Album_Art_Get("f.flac", &img), ALBUM_ART_PENDING);
+
+    // the most recently used entries stay
+    TEST_CHECK_EQ(load("m.m4a", &img), ALBUM_ART_READY);
+    Album_Art_Release(img);
+    fillCache(ALBUM_ART_CACHE - 1);
+    TEST_CHECK_EQ(Album_Art_Get("m.m4a", &img), ALBUM_ART_READY);
+    Album_Art_Release(img);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    char dir[] = "/tmp/albumart_XXXXXX";
+    if(!mkdtemp(dir)) return 1;
+    s_root = dir;
+    SD_MMC = fs::FS(s_root);
+    s_front = test_readFile(ART_FRONT);
+    s_other = test_readFile(ART_OTHER);
+    s_progressive = test_readFile(ART_PROGRESSIVE);
+    s_audio = test_readFile("Olsen-Banden.mp3");
+    s_audio.resize(16384);
+    Album_Art_Init();
+    RUN_TEST(test_art_formats);
+    RUN_TEST(test_art_cache);
+    RUN_TEST(test_art_lru);
+    std::string rm = "rm -rf " + s_root;
+    if(system(rm.c_str())) {}
+    return s_testFailures;
+}
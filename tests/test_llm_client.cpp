@@ -0,0 +1,244 @@
+/*
+ * test_llm_client.cpp
+ * LLM_Client: the SSE / NDJSON scanner with every split of its input, the transcript with 10000 appended tokens (CPU
+ * and redrawn pixels per token stay flat, the tail of the text is shown), and a whole answer from a stand-in server
+ * on 127.0.0.1 that replays a token stream: tokens, first token, token to pixel latency
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "test_server.h"
+#include "LLM_Client.h"
+#include <random>
+#include <time.h>
+
+#define LC_WIDTH    360
+#define LC_TOKENS   10000
+#define LC_STREAM   400     // tokens the server replays
+#define LC_RATE     200     // tokens/s
+#define LC_FIRST_MS 200     // until the first token
+
+static lv_color_t s_buf[LC_WIDTH * 36];
+static uint64_t   s_pixels;
+static uint32_t   s_flushes;
+static const char* s_words[] = {"the ", "model ", "answers ", "with ", "a ", "token ", "stream, ", "which ", "is ",
+                                "shown ", "while ", "it ", "arrives. ", "L\xC3\xA4uft ", "gut ", "\xE6\x97\xA5\xE6\x9C\xAC "};
+
+static void flush(lv_disp_drv_t* d, const lv_area_t* a, lv_color_t*) {
+    s_pixels += lv_area_get_size(a);
+    if(lv_disp_flush_is_last(d)) s_flushes++;
+    lv_disp_flush_ready(d);
+}
+static double cpuMs() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+static std::string transcriptText(lv_obj_t* t) {
+    std::string s;
+    for(uint32_t i = 0; i < lv_obj_get_child_cnt(t); i++) s += lv_label_get_text(lv_obj_get_child(t, i));
+    return s;
+}
+static std::vector<std::string> tokens(uint32_t n, uint32_t seed) {
+    std::mt19937             rng(seed);
+    std::vector<std::string> t;
+    for(uint32_t i = 0; i < n; i++) {
+        t.push_back(s_words[rng() % 16]);
+        if(rng() % 60 == 0) t.back() += "\n";
+    }
+    return t;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static std::string s_out;
+static int         s_ends;
+static void textCb(void*, const char* text, uint16_t len, bool end) {
+    s_out.append(text, len);
+    if(end) s_ends++;
+}
+// byte by byte, in one piece and in random pieces: the same text, tokens and end
+static void checkParser(const std::string& in, const std::string& want, int wantTokens, bool wantDone) {
+    std::mt19937 rng(1);
+    for(int mode = 0; mode < 3; mode++) {
+        LLM_Parser p;
+        LLM_Parser_Reset(&p);
+        s_out.clear();
+        s_ends = 0;
+        uint32_t ret = 0;
+        for(size_t i = 0; i < in.size();) {
+            size_t n = mode == 0 ? 1 : mode == 1 ? in.size() : 1 + rng() % 13;
+            n = min(n, in.size() - i);
+            ret += LLM_Parser_Feed(&p, (const uint8_t*)in.data() + i, n, textCb, NULL);
+            i += n;
+        }
+        TEST_CHECK(s_out == want);
+        TEST_CHECK_EQ(s_ends, wantTokens);
+        TEST_CHECK_EQ(ret, wantTokens);
+        TEST_CHECK_EQ(p.Done, wantDone);
+    }
+}
+static void test_lc_parser() {
+    // OpenAI: comments, other fields, CR LF, no blank behind "data:", escapes, a surrogate pair, UTF-8, keys that are
+    // too long, a role without content, [DONE]
+    checkParser(": keep-alive\n\n"
+                "event: message\nid: 1\n"
+                "data: {\"id\":\"c1\",\"choices\":[{\"index\":0,\"delta\":{\"role\":\"assistant\",\"content\":null},"
+                "\"finish_reason\":null}]}\n\n"
+                "data: {\"id\":\"c1\",\"choices\":[{\"index\":0,\"delta\":{\"content\":\"Hel\"},\"finish_reason\":null}]}\r\n\r\n"
+                "data:{\"choices\":[{\"delta\":{\"content\":\"lo \\\"w\\u00f6rld\\\"\\n\"}}]}\n\n"
+                "data: {\"choices\":[{\"delta\":{\"reasoning_content\":\"hidden\",\"a_very_long_key_name_that_is_long\":"
+                "\"x\",\"content\":\"\\ud83d\\ude00 \xE6\x97\xA5\xE6\x9C\xAC\"}}],\"usage\":{\"n\":[1,2.5e3,true]}}\n\n"
+                "data: {\"choices\":[{\"delta\":{},\"finish_reason\":\"stop\"}]}\n\n"
+                "data: [DONE]\n\n",
+                "Hello \"w\xC3\xB6rld\"\n\xF0\x9F\x98\x80 \xE6\x97\xA5\xE6\x9C\xAC", 3, true);
+    // Ollama /api/chat and /api/generate, one object per line, "done": true
+    checkParser("{\"model\":\"m\",\"message\":{\"role\":\"assistant\",\"content\":\"Hi\"},\"done\":false}\n"
+                "{\"model\":\"m\",\"message\":{\"role\":\"assistant\",\"content\":\", there\\t!\"},\"done\":false}\n"
+                "{\"model\":\"m\",\"message\":{\"role\":\"assistant\",\"content\":\"\"},\"done\":true,\"total_duration\":123}\n",
+                "Hi, there\t!", 3, true);
+    checkParser("{\"response\":\"a\",\"done\":false}\n{\"response\":\"b\",\"done\":true}\n", "ab", 2, true);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_lc_transcript() {
+    // every token is drawn at once; the cost of the first and the last thousand tokens is about the same
+    lv_obj_clean(lv_scr_act());
+    lv_obj_t* t = LLM_Transcript_Create(lv_scr_act(), 300, 300);
+    lv_obj_center(t);
+    lv_refr_now(NULL);
+    std::vector<std::string> tok = tokens(LC_TOKENS, 7);
+    std::string              all;
+    double                   cpu[LC_TOKENS / 1000], c0 = cpuMs();
+    uint64_t                 px[LC_TOKENS / 1000], p0 = s_pixels;
+    for(uint32_t i = 0; i < LC_TOKENS; i++) {
+        LLM_Transcript_Append(t, tok[i].c_str());
+        all += tok[i];
+        lv_refr_now(NULL);
+        if(i % 1000 == 999) {
+            double c = cpuMs();
+            cpu[i / 1000] = (c - c0) / 1000;
+            px[i / 1000] = (s_pixels - p0) / 1000;
+            c0 = c;
+            p0 = s_pixels;
+        }
+    }
+    printf("CPU per token (us) by thousands:");
+    for(int k = 0; k < LC_TOKENS / 1000; k++) printf(" %.0f", cpu[k] * 1000);
+    printf("\npixels per token:");
+    for(int k = 0; k < LC_TOKENS / 1000; k++) printf(" %lu", (unsigned long)px[k]);
+    printf("\n");
+    double first = min(cpu[0], cpu[1]), last = max(cpu[LC_TOKENS / 1000 - 2], cpu[LC_TOKENS / 1000 - 1]);
+    TEST_CHECK(last < 3 * first + 0.05);                      // a single label grows tenfold over these tokens
+    TEST_CHECK(px[LC_TOKENS / 1000 - 1] < 2 * px[1] + 1000);
+    TEST_CHECK(px[LC_TOKENS / 1000 - 1] < 300 * 300 / 2);      // not the whole transcript
+    // the tail of the text, whole lines only dropped; it stays at the bottom
+    std::string shown = transcriptText(t);
+    TEST_CHECK(shown.size() <= LLM_TRANSCRIPT_MAX + LLM_LABEL_CHUNK + 64);
+    TEST_CHECK(shown.size() > LLM_TRANSCRIPT_MAX / 2);
+    TEST_CHECK(all.compare(all.size() - shown.size(), shown.size(), shown) == 0);
+    TEST_CHECK_EQ((uint32_t)(uintptr_t)lv_obj_get_user_data(t), shown.size());
+    TEST_CHECK(lv_obj_get_scroll_bottom(t) <= 0);
+    TEST_CHECK(lv_obj_get_child_cnt(t) <= LLM_TRANSCRIPT_MAX / (LLM_LABEL_CHUNK / 2) + 2);
+    lv_obj_del(t);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static std::vector<std::string>                  s_tokens;
+static std::vector<std::pair<uint32_t, uint32_t>> s_sent;  // bytes sent so far, millis()
+static std::mutex                                 s_sentLock;
+
+// an OpenAI compatible server: SSE, chunked, LC_RATE tokens/s after LC_FIRST_MS
+static bool llm(int fd, const Test_Request& r) {
+    TEST_CHECK(r.method == "POST" && r.path == LLM_PATH);
+    TEST_CHECK(r.body.find("\"stream\":true") != std::string::npos);
+    TEST_CHECK(r.body.find("\"content\":\"Tell me \\\"something\\\".\"") != std::string::npos);
+    test_sendHeader(fd, 200, -1, "Content-Type: text/event-stream\r\n");
+    test_sleep(LC_FIRST_MS);
+    uint32_t t0 = millis(), bytes = 0;
+    for(size_t i = 0; i < s_tokens.size(); i++) {
+        std::string esc;
+        for(char c : s_tokens[i]) esc += c == '\n' ? std::string("\\n") : std::string(1, c);
+        test_sendChunk(fd, "data: {\"id\":\"c\",\"object\":\"chat.completion.chunk\",\"choices\":[{\"index\":0,\"delta\":"
+                           "{\"content\":\"" + esc + "\"},\"finish_reason\":null}]}\n\n");
+        bytes += s_tokens[i].size();
+        {
+            std::lock_guard<std::mutex> lock(s_sentLock);
+            s_sent.push_back({bytes, millis()});
+        }
+        int32_t d = t0 + (i + 1) * 1000 / LC_RATE - millis();
+        if(d > 0) test_sleep(d);
+    }
+    test_sendChunk(fd, "data: [DONE]\n\n");
+    test_sendChunk(fd, "");
+    return false;
+}
+static void test_lc_stream() {
+    // Lvgl_Loop(): lv_timer_handler() every 5 ms; a token is on the screen with the first flush after the transcript
+    // holds its bytes
+    Test_Server srv(llm);
+    s_tokens = tokens(LC_STREAM, 3);
+    std::string all;
+    for(const std::string& s : s_tokens) all += s;
+    lv_obj_clean(lv_scr_act());
+    lv_obj_t* t = LLM_Transcript_Create(lv_scr_act(), 300, 300);
+    lv_obj_center(t);
+    LLM_Init("127.0.0.1", srv.port(), "stand-in");
+    TEST_CHECK(LLM_Ask("Tell me \"something\"."));
+    TEST_CHECK(!LLM_Ask("Twice"));                               // one request at a time
+
+    std::vector<std::pair<uint32_t, uint32_t>> shown;          // bytes on the screen, millis()
+    uint32_t                                    last = millis(), t0 = last, flushes = s_flushes;
+    double                                      c0 = cpuMs();
+    while(millis() - t0 < 10000) {
+        uint32_t n = millis();
+        lv_tick_inc(n - last);
+        last = n;
+        lv_timer_handler();                                    // the transcript timer runs in front of the refresh
+        uint32_t bytes = (uint32_t)(uintptr_t)lv_obj_get_user_data(t);
+        if(s_flushes != flushes) shown.push_back({bytes, millis()});
+        flushes = s_flushes;
+        uint8_t s = LLM_State();
+        if((s == LLM_DONE || s == LLM_ERROR) && bytes == all.size() && shown.size() && shown.back().first == bytes) break;
+        usleep(5000);
+    }
+    double          cpu = cpuMs() - c0;
+    const LLM_Stats* st = LLM_Get_Stats();
+    TEST_CHECK_EQ(LLM_State(), LLM_DONE);
+    TEST_CHECK_EQ(st->Tokens, LC_STREAM);
+    TEST_CHECK_EQ(st->Bytes, all.size());
+    TEST_CHECK_EQ(st->Dropped, 0);
+    TEST_CHECK(st->First_Token_Ms >= LC_FIRST_MS && st->First_Token_Ms < LC_FIRST_MS + 100);
+    TEST_CHECK(transcriptText(t) == all);
+
+    std::vector<uint32_t> lat;
+    size_t                f = 0;
+    for(auto& s : s_sent) {
+        while(f < shown.size() && shown[f].first < s.first) f++;
+        if(f < shown.size()) lat.push_back(shown[f].second - s.second);
+    }
+    TEST_CHECK_EQ(lat.size(), s_sent.size());
+    std::sort(lat.begin(), lat.end());
+    if(lat.empty()) return;
+    uint32_t p50 = lat[lat.size() / 2], p95 = lat[lat.size() * 95 / 100];
+    printf("%u tokens at %u/s: first token %u ms, token to pixel median %u ms, p95 %u ms, max %u ms, LVGL %.0f us "
+           "per token, render latency max %u ms\n", st->Tokens, LC_RATE, st->First_Token_Ms, p50, p95, lat.back(),
+           cpu * 1000 / st->Tokens, st->Render_Latency_Max_Ms);
+    TEST_CHECK(p95 < LLM_RENDER_PERIOD + 40);                  // one render period, a loop and the drawing
+    TEST_CHECK(st->Render_Latency_Max_Ms < LLM_RENDER_PERIOD + 40);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    lv_init();
+    static lv_disp_draw_buf_t db;
+    lv_disp_draw_buf_init(&db, s_buf, NULL, LC_WIDTH * 36);
+    static lv_disp_drv_t dd;
+    lv_disp_drv_init(&dd);
+    dd.hor_res = LC_WIDTH;
+    dd.ver_res = LC_WIDTH;
+    dd.flush_cb = flush;
+    dd.draw_buf = &db;
+    lv_disp_drv_register(&dd);
+    RUN_TEST(test_lc_parser);
+    RUN_TEST(test_lc_transcript);
+    RUN_TEST(test_lc_stream);
+    fflush(stdout);
+    _exit(s_testFailures); // the client task waits for the next question
+}
@@ -0,0 +1,187 @@
+/*
+ * test_mic_aec.cpp
+ * MIC_AEC behind MIC_I2S on a simulated clock: Pink-Panther.wav goes to the speaker as the reference, 150 ms ahead of
+ * its play time, the microphone hears it through a room with reflections, speech from the near end and noise. The I2S
+ * driver stamps every RX buffer, ESP_SR reads when it gets to it; ERLE, double talk and CPU time, with a reader that
+ * wakes every 32 ms and with one that is up to 50 ms late on top, the DMA queue holds 90 ms
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "MIC_AEC.h"
+#include <random>
+#include <time.h>
+
+#define AT_RATE      16000
+#define AT_T0        1000000   // µs, the clock of the first run
+#define AT_AHEAD_US  150000    // the audio task writes this far ahead of the DAC
+#define AT_BLOCK     128       // frames of the reference per write
+#define AT_READ      512       // frames ESP_SR reads at a time
+#define AT_NEAR_S    4         // the near end speaks from here on
+#define AT_SETTLED_S 10        // the filter has converged
+
+static MIC_I2S              s_i2s;
+static std::vector<int16_t> s_music;     // 22.05 kHz stereo
+static uint32_t             s_musicRate;
+static std::vector<double>  s_echo, s_near, s_noise;
+static std::vector<int16_t> s_mic;
+static std::mt19937         s_rng(1);
+
+static std::vector<int16_t> pcm16(const char* name, uint32_t* rate, uint16_t* ch) {
+    std::vector<uint8_t> d = test_readFile(name);
+    *ch = test_rd16(&d[22]);
+    *rate = test_rd32(&d[24]);
+    uint32_t pos = 12;
+    while(memcmp(&d[pos], "data", 4)) pos += 8 + test_rd32(&d[pos + 4]);
+    uint32_t n = min((size_t)test_rd32(&d[pos + 4]), d.size() - pos - 8) / 2;
+    std::vector<int16_t> out(n);
+    memcpy(out.data(), &d[pos + 8], n * 2);
+    return out;
+}
+// mono at 16 kHz, windowed sinc low pass at 7.6 kHz
+static std::vector<double> mono16k(const std::vector<int16_t>& x, uint32_t rate, uint16_t ch) {
+    size_t              frames = x.size() / ch;
+    std::vector<double> m(frames), out;
+    for(size_t i = 0; i < frames; i++) {
+        for(int c = 0; c < ch; c++) m[i] += x[i * ch + c];
+        m[i] /= ch;
+    }
+    double fc = 7600.0 / rate;
+    for(double t = 0; t < frames - 1; t += rate / 16000.0) {
+        double acc = 0, ws = 0;
+        for(int k = (int)t - 32; k <= (int)t + 32; k++) {
+            if(k < 0 || k >= (int)frames) continue;
+            double u = k - t, s = u == 0 ? 2 * fc : sin(2 * M_PI * fc * u) / (M_PI * u), w = 0.5 + 0.5 * cos(M_PI * u / 33);
+            acc += m[k] * s * w;
+            ws += s * w;
+        }
+        out.push_back(acc / ws);
+    }
+    return out;
+}
+// the room: the direct path after 1.3 ms, reflections decaying over 6 ms; speech from 4 s on, noise everywhere
+static void scene() {
+    uint16_t ch;
+    s_music = pcm16("Pink-Panther.wav", &s_musicRate, &ch);
+    s_music.insert(s_music.end(), s_music.begin(), s_music.end());  // 14 s
+    std::vector<double> m = mono16k(s_music, s_musicRate, ch);
+    uint32_t            sr;
+    std::vector<int16_t> sp = pcm16("test_16bit_mono.wav", &sr, &ch);
+    std::vector<double>  near = mono16k(sp, sr, ch);
+
+    std::normal_distribution<double> nd(0, 1);
+    std::vector<double>              h(120);
+    h[20] = 1.0;
+    for(int k = 23; k < 120; k++) h[k] = 0.25 * nd(s_rng) * exp(-(k - 20) / 30.0);
+    size_t n = m.size();
+    s_echo.assign(n, 0);
+    s_near.assign(n, 0);
+    s_noise.assign(n, 0);
+    s_mic.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        for(size_t k = 0; k < h.size() && k <= i; k++) s_echo[i] += 0.5 * h[k] * m[i - k];
+        if(i >= AT_NEAR_S * AT_RATE && i - AT_NEAR_S * AT_RATE < near.size()) s_near[i] = 0.5 * near[i - AT_NEAR_S * AT_RATE];
+        s_noise[i] = 20 * nd(s_rng);
+        s_mic[i] = (int16_t)max(-32768.0, min(32767.0, s_echo[i] + s_near[i] + s_noise[i]));
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    double erleFirst;   // dB, 1 ... 2 s
+    double erle;        // dB, from AT_SETTLED_S on
+    double dtIn;        // dB, echo and noise to the speech while the near end speaks, before and after the AEC
+    double dtOut;
+    double usPer10ms;
+    double lateMs;      // the longest a frame waited in the DMA queue before it was read
+} at_run_t;
+
+static double energy(const std::vector<double>& v, size_t a, size_t b) {
+    double s = 0;
+    for(size_t i = a; i < b && i < v.size(); i++) s += v[i] * v[i];
+    return s;
+}
+// frame i is taken at AT_T0 + i / AT_RATE, the DMA buffer it completes calls on_recv then; the reader wakes every
+// 32 ms plus up to maxLateMs and reads what is there
+static at_run_t run(uint32_t maxLateMs) {
+    std::normal_distribution<double> jitter(0, 150);
+    std::uniform_int_distribution<>  late(0, maxLateMs * 1000);
+    TEST_CHECK(s_i2s.begin(I2S_MODE_STD, AT_RATE, I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO));
+    TEST_CHECK(AEC_Init());
+    AEC_Stats st0 = *AEC_Get_Stats();
+    static int64_t t0 = AT_T0;
+    t0 += 100000000;                                               // a new stretch of the clock for every run
+    size_t    n = s_mic.size(), mf = 0, got = 0;
+    int64_t   readAt = t0;
+    std::vector<double> out(n);
+    at_run_t  r = {};
+    double    cpuMs = 0;
+    for(size_t i = 0; i < n; i++) {
+        int64_t now = t0 + (int64_t)(i + 1) * 1000000 / AT_RATE;
+        s_hostTimeUs = now;
+        // the audio task: the play time from on_sent is good to a few hundred µs
+        while(mf < s_music.size() / 2 && t0 + (int64_t)mf * 1000000 / s_musicRate < now + AT_AHEAD_US) {
+            uint32_t k = min((size_t)AT_BLOCK, s_music.size() / 2 - mf);
+            AEC_Reference(&s_music[2 * mf], k, s_musicRate, t0 + (int64_t)mf * 1000000 / s_musicRate + (int64_t)jitter(s_rng));
+            mf += k;
+        }
+        int16_t frame[2] = {};
+        frame[MIC_SLOT] = s_mic[i];
+        i2s_host_record(s_i2s.rxChan(), (const uint8_t*)frame, 4);
+        if(now < readAt) continue;
+        int16_t buf[AT_READ * 2];
+        size_t  k;
+        timespec c0, c1;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+        while((k = s_i2s.readBytes((char*)buf, sizeof(buf)) / 4)) {
+            // the first frame of the read has waited since it was taken
+            r.lateMs = max(r.lateMs, (now - (t0 + (int64_t)(got + 1) * 1000000 / AT_RATE)) / 1000.0);
+            for(size_t j = 0; j < k; j++) out[got + j] = buf[2 * j + MIC_SLOT];
+            got += k;
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+        cpuMs += (c1.tv_sec - c0.tv_sec) * 1e3 + (c1.tv_nsec - c0.tv_nsec) * 1e-6;
+        readAt = now + 32000 + late(s_rng);
+    }
+    s_hostTimeUs = -1;
+    TEST_CHECK(got > n - 2 * AT_READ);
+    TEST_CHECK_EQ(AEC_Get_Stats()->Resyncs - st0.Resyncs, 1);   // the reference went on without a gap
+
+    std::vector<double> res(got);                                  // the echo that is left
+    for(size_t i = 0; i < got; i++) res[i] = out[i] - s_near[i] - s_noise[i];
+    size_t ns = AT_NEAR_S * AT_RATE, ne = ns;
+    while(ne < got && s_near[ne] != 0) ne++;
+    while(ne < got && energy(s_near, ne, ne + 1600) > 0) ne += 1600;
+    r.erleFirst = 10 * log10(energy(s_echo, AT_RATE, 2 * AT_RATE) / energy(res, AT_RATE, 2 * AT_RATE));
+    r.erle = 10 * log10(energy(s_echo, AT_SETTLED_S * AT_RATE, got) / energy(res, AT_SETTLED_S * AT_RATE, got));
+    double sp = energy(s_near, ns, ne), in = 0, o = 0;
+    for(size_t i = ns; i < ne; i++) {
+        in += (s_mic[i] - s_near[i]) * (s_mic[i] - s_near[i]);
+        o += (out[i] - s_near[i]) * (out[i] - s_near[i]);
+    }
+    r.dtIn = 10 * log10(in / sp);
+    r.dtOut = 10 * log10(o / sp);
+    r.usPer10ms = cpuMs * 1000 / (got / 160.0);
+    printf("reader late up to %3u ms (frames waited %5.1f ms): ERLE 1-2 s %4.1f dB, after %4.1f dB, double talk %5.1f -> "
+           "%5.1f dB, %4.1f us per 10 ms\n", maxLateMs, r.lateMs, r.erleFirst, r.erle, r.dtIn, r.dtOut, r.usPer10ms);
+    return r;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_aec_reader() {
+    // the block is placed by the time its last frame was taken, not by the time of the read: a late reader cancels
+    // as well as a prompt one
+    scene();
+    at_run_t prompt = run(0), lateReader = run(50);
+    TEST_CHECK(lateReader.lateMs > 60);                          // far more than the AEC_DELAY taps cover
+    for(const at_run_t* r : {&prompt, &lateReader}) {
+        TEST_CHECK(r->erleFirst > 4);
+        TEST_CHECK(r->erle > 7);                                 // stamped at the read it is 1 ... 2 dB
+        TEST_CHECK(r->dtOut < r->dtIn - 5);                      // the speech is kept, the echo is not
+    }
+    TEST_CHECK_NEAR(lateReader.erle, prompt.erle, 2.5);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    RUN_TEST(test_aec_reader);
+    return s_testFailures;
+}
@@ -0,0 +1,194 @@
+/*
+ * test_mic_capture.cpp
+ * MIC_Capture behind MIC_I2S: the test WAVs at 16 kHz with noise and a DC offset between them, recorded into the I2S
+ * RX channel in blocks as ESP_SR reads them; utterances from the pre-roll on, identical to the source across the
+ * end of the ring, end of speech latency, CPU per second of audio, arming, lost utterances
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "MIC_Capture.h"
+#include <random>
+#include <time.h>
+
+#define MC_BLOCK 512     // frames ESP_SR reads at a time
+
+static MIC_I2S              s_i2s;
+static std::vector<int16_t> s_mic;       // everything recorded, the index is the position in the ring
+static std::mt19937         s_rng(1);
+
+typedef struct {
+    uint8_t  event;
+    uint32_t pos;        // recorded samples when it came
+    uint32_t samples;
+} mc_event_t;
+static std::vector<mc_event_t> s_events;
+
+static void eventCb(uint8_t event, uint32_t samples) { s_events.push_back({event, (uint32_t)s_mic.size(), samples}); }
+
+// a test file as the microphone hears it: 16 kHz mono, half the level
+static std::vector<int16_t> speech(const char* name, uint32_t maxMs) {
+    std::vector<uint8_t> d = test_readFile(name);
+    uint16_t             ch = test_rd16(&d[22]), bits = test_rd16(&d[34]);
+    uint32_t             rate = test_rd32(&d[24]), pos = 12;
+    while(memcmp(&d[pos], "data", 4)) pos += 8 + test_rd32(&d[pos + 4]);
+    uint32_t           frames = test_rd32(&d[pos + 4]) / (ch * bits / 8);
+    const uint8_t*     p = &d[pos + 8];
+    std::vector<float> mono(frames);
+    for(uint32_t i = 0; i < frames; i++) {
+        float s = 0;
+        for(int c = 0; c < ch; c++) s += bits == 16 ? (int16_t)test_rd16(p + (i * ch + c) * 2) : (p[i * ch + c] - 128) * 256;
+        mono[i] = s / ch;
+    }
+    std::vector<int16_t> out;
+    for(double t = 0; t < frames - 1 && out.size() < maxMs * 16; t += rate / 16000.0) {
+        uint32_t i = t;
+        double   a = t - i;
+        out.push_back((mono[i] * (1 - a) + mono[i + 1] * a) / 2);
+    }
+    return out;
+}
+// -58 dBFS noise and a DC offset on everything
+static int16_t mic(float x) {
+    static std::normal_distribution<float> noise(0, 40);
+    return (int16_t)max(-32768.f, min(32767.f, x + noise(s_rng) + 300));
+}
+// recorded in blocks and read as far as the DMA buffers are full; MICTask: VAD, the slices of the utterance are taken
+// and released as they come
+static double s_cpuMs;
+static void record(const std::vector<int16_t>& x, std::vector<int16_t>* taken) {
+    std::vector<int16_t> stereo(MC_BLOCK * 2);
+    for(size_t i = 0; i < x.size(); i += MC_BLOCK) {
+        uint32_t n = min((size_t)MC_BLOCK, x.size() - i);
+        for(uint32_t k = 0; k < n; k++) {
+            stereo[2 * k + MIC_SLOT] = x[i + k];
+            stereo[2 * k + 1 - MIC_SLOT] = 0;
+        }
+        i2s_host_record(s_i2s.rxChan(), (const uint8_t*)stereo.data(), n * 4);
+        int16_t buf[MC_BLOCK * 2];                          // the full DMA buffers
+        for(size_t k; (k = s_i2s.readBytes((char*)buf, sizeof(buf)) / 4);)
+            for(size_t j = 0; j < k; j++) s_mic.push_back(buf[2 * j + MIC_SLOT]);
+        timespec t0, t1;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+        MIC_Capture_Process();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+        s_cpuMs += (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) * 1e-6;
+        if(!taken) continue;
+        MIC_Slice s[2];
+        uint8_t   k = MIC_Capture_Get(s);
+        uint32_t  got = 0;
+        for(int j = 0; j < k; j++) {
+            taken->insert(taken->end(), s[j].Data, s[j].Data + s[j].Samples);
+            got += s[j].Samples;
+        }
+        if(k) TEST_CHECK(MIC_Capture_Release(got));
+    }
+}
+static std::vector<int16_t> noise(uint32_t ms) {
+    std::vector<int16_t> x(ms * 16);
+    for(int16_t& s : x) s = mic(0);
+    return x;
+}
+// where the taken samples are in the recording
+static int64_t findInRecording(const std::vector<int16_t>& taken, uint32_t from, uint32_t to) {
+    for(uint32_t s = from; s <= to && s + taken.size() <= s_mic.size(); s++)
+        if(!memcmp(&s_mic[s], taken.data(), taken.size() * 2)) return s;
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mc_utterances() {
+    const char* files[] = {"Pink-Panther.wav", "test_16bit_mono.wav", "test_16bit_stereo.wav", "test_8bit_mono.wav"};
+    double sec = 0;
+    for(const char* name : files) {
+        std::vector<int16_t> w = speech(name, 5000);
+        size_t               a = 0, b = w.size();
+        while(a < b && abs(w[a]) < 100) a++;                  // the signal, without the silence at the ends
+        while(b > a && abs(w[b - 1]) < 100) b--;
+        std::vector<int16_t> x;
+        for(int16_t s : w) x.push_back(mic(s));
+        MIC_Capture_Arm(true);
+        s_events.clear();
+        std::vector<int16_t> taken;
+        record(noise(2000), &taken);
+        uint32_t onset = s_mic.size() + a, end = s_mic.size() + b;
+        record(x, &taken);
+        record(noise(2500), &taken);
+        sec += (x.size() + 4500 * 16) / 16000.0;
+
+        // one utterance, from MIC_PREROLL_MS before the onset to the end of the signal and the silence behind it
+        TEST_CHECK_EQ(MIC_Capture_State(), MIC_ENDED);
+        TEST_CHECK(s_events.size() == 2 && s_events[0].event == MIC_UTTERANCE_START && s_events[1].event == MIC_UTTERANCE_END);
+        if(s_events.size() != 2) continue;
+        TEST_CHECK_EQ(taken.size(), s_events[1].samples);
+        int64_t start = findInRecording(taken, onset - MIC_PREROLL_MS * 16 - 1600, onset);
+        TEST_CHECK(start >= 0);                                 // the slices are the recording, across the end of the ring
+        TEST_CHECK(start + (int64_t)taken.size() >= end);
+        TEST_CHECK(start <= onset - MIC_PREROLL_MS * 16 + 800); // the onset is detected within 50 ms
+        // the end: MIC_VAD_END_MS of silence after the signal, a block and a frame late at most
+        int32_t late = (int32_t)(s_events[1].pos - end) / 16;
+        printf("%-24s %5.2f s of speech, end detected after %d ms, pre-roll %d ms\n", name, (end - onset) / 16000.0, late, (int)(onset - start) / 16);
+        TEST_CHECK(late >= MIC_VAD_END_MS - 100 && late < MIC_VAD_END_MS + 100);
+        MIC_Capture_Finish();
+    }
+    TEST_CHECK(s_mic.size() > 2 * MIC_RING_SAMPLES);
+    const MIC_Stats* st = MIC_Capture_Get_Stats();
+    TEST_CHECK_EQ(st->Utterances, 4);
+    TEST_CHECK_EQ(st->Lost, 0);
+    TEST_CHECK(st->Noise < 40 * 40 * 2);                       // the noise, not the DC offset
+    printf("VAD and slices: %.1f us per second of audio, %u of %u frames speech\n", s_cpuMs * 1000 / sec,
+           st->Speech_Frames, st->Frames);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mc_arm() {
+    // armed 300 ms before the onset: nothing from before the arming; not armed: no utterance
+    std::vector<int16_t> w = speech("test_16bit_mono.wav", 3000), x;
+    for(int16_t s : w) x.push_back(mic(s));
+    record(noise(1000), NULL);
+    MIC_Capture_Arm(false);
+    uint32_t utterances = MIC_Capture_Get_Stats()->Utterances;
+    record(x, NULL);
+    record(noise(1000), NULL);
+    TEST_CHECK_EQ(MIC_Capture_Get_Stats()->Utterances, utterances);
+    TEST_CHECK_EQ(MIC_Capture_State(), MIC_IDLE);
+
+    record(noise(1700), NULL);
+    MIC_Capture_Arm(true);
+    uint32_t             armPos = s_mic.size();
+    std::vector<int16_t> taken;
+    record(noise(300), &taken);
+    record(x, &taken);
+    record(noise(1000), &taken);
+    TEST_CHECK_EQ(MIC_Capture_State(), MIC_ENDED);
+    TEST_CHECK_EQ(findInRecording(taken, armPos, armPos), armPos);
+    MIC_Capture_Finish();
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_mc_lost() {
+    // an utterance nobody takes is overwritten by the ring: lost, and nothing is handed out
+    std::vector<int16_t> w = speech("Pink-Panther.wav", 3000), x;
+    for(int16_t s : w) x.push_back(mic(s));
+    MIC_Capture_Arm(true);
+    s_events.clear();
+    record(x, NULL);
+    record(noise(1000), NULL);
+    TEST_CHECK_EQ(MIC_Capture_State(), MIC_ENDED);
+    MIC_Slice s[2];
+    TEST_CHECK(MIC_Capture_Get(s) > 0);
+    record(noise(MIC_RING_SAMPLES / 16), NULL);
+    TEST_CHECK_EQ(MIC_Capture_State(), MIC_IDLE);
+    TEST_CHECK_EQ(MIC_Capture_Get(s), 0);
+    TEST_CHECK(!MIC_Capture_Release(1));
+    TEST_CHECK_EQ(MIC_Capture_Get_Stats()->Lost, 1);
+    TEST_CHECK(s_events.size() == 3 && s_events[2].event == MIC_UTTERANCE_LOST);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    s_i2s.begin(I2S_MODE_STD, MIC_SAMPLE_RATE, I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO);
+    TEST_CHECK(MIC_Capture_Init());
+    MIC_Capture_On_Event(eventCb);
+    RUN_TEST(test_mc_utterances);
+    RUN_TEST(test_mc_arm);
+    RUN_TEST(test_mc_lost);
+    return s_testFailures;
+}
@@ -0,0 +1,218 @@
+/*
+ * test_music_library.cpp
+ * Music_Library: database build, tags and duration (mp3, m4a, flac, wav, ogg), sort order, reopen without parsing,
+ * incremental update, paged reads and the rebuild of a damaged database
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Music_Library.h"
+#include <string>
+
+#define ML_TRACKS 300
+
+static std::string   s_root;
+fs::FS               SD_MMC("");
+static std::vector<uint8_t> s_mp3;     // Xing frame and the first audio frames of the test file
+static size_t        s_buildBytes;     // read by the first build, every track is parsed
+
+static void writeFile(const std::string& name, const std::vector<uint8_t>& d) {
+    FILE* f = fopen((s_root + "/" + name).c_str(), "wb");
+    if(!d.empty()) fwrite(d.data(), 1, d.size(), f);
+    fclose(f);
+}
+static void id3Frame(std::vector<uint8_t>& t, const char* id, uint8_t enc, const std::string& text) {
+    uint32_t n = text.size() + 1;
+    uint8_t  h[11] = {(uint8_t)id[0], (uint8_t)id[1], (uint8_t)id[2], (uint8_t)id[3], 0, 0, (uint8_t)(n >> 8), (uint8_t)n, 0, 0, enc};
+    t.insert(t.end(), h, h + 11);
+    t.insert(t.end(), text.begin(), text.end());
+}
+// ID3v2.3 with title, artist and album in front of the audio
+static std::vector<uint8_t> taggedMP3(const std::string& title, const std::string& artist, const std::string& album) {
+    std::vector<uint8_t> t;
+    id3Frame(t, "TIT2", 0, title);
+    id3Frame(t, "TPE1", 3, artist);
+    id3Frame(t, "TALB", 0, album);
+    t.resize(t.size() + 100, 0); // padding
+    uint32_t n = t.size();
+    std::vector<uint8_t> d = {'I', 'D', '3', 3, 0, 0, (uint8_t)((n >> 21) & 0x7F), (uint8_t)((n >> 14) & 0x7F),
+                              (uint8_t)((n >> 7) & 0x7F), (uint8_t)(n & 0x7F)};
+    d.insert(d.end(), t.begin(), t.end());
+    d.insert(d.end(), s_mp3.begin(), s_mp3.end());
+    return d;
+}
+static std::string trackName(int i) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s %05d - Artist %d.mp3", (i & 1) ? "track" : "Track", (i * 7919) % ML_TRACKS, i % 50);
+    return name;
+}
+static bool sorted() {
+    char prev[LIBRARY_NAME_LEN] = "", name[LIBRARY_NAME_LEN];
+    for(uint32_t i = 0; i < Library_Count(); i++) {
+        if(!Library_Name(i, name, sizeof(name))) return false;
+        if(i && strcasecmp(prev, name) > 0) return false;
+        strcpy(prev, name);
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ml_build() {
+    for(int i = 0; i < ML_TRACKS; i++) {
+        if(i % 3 == 0) writeFile(trackName(i), taggedMP3("Titel \xe9 " + std::to_string(i), "K\xc3\xbcnstler", "Album"));
+        else writeFile(trackName(i), s_mp3);
+    }
+    writeFile("cover.jpg", {1, 2, 3});
+    writeFile("notes.txt", {});
+    SD_MMC.mkdir("/sub.mp3"); // a directory is not a track
+
+    File::s_bytesRead = 0;
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", false), ML_TRACKS);
+    s_buildBytes = File::s_bytesRead;
+    TEST_CHECK_EQ(Library_Count(), ML_TRACKS);
+    TEST_CHECK(sorted());
+
+    uint32_t tagged = 0;
+    Library_Track t;
+    for(uint32_t i = 0; i < Library_Count(); i++) {
+        TEST_CHECK(Library_Get(i, &t));
+        TEST_CHECK_EQ(t.Codec, LIBRARY_CODEC_MP3);
+        TEST_CHECK_EQ(t.Sample_Rate, 44100);
+        TEST_CHECK_EQ(t.Channels, 2);
+        TEST_CHECK_EQ(t.Duration, 18);   // Xing frame count of the test file, not the size of the copy
+        if(!strncmp(t.Title, "Titel \xc3\xa9 ", 9)) {  // Latin-1 -> UTF-8
+            tagged++;
+            TEST_CHECK(!strcmp(t.Artist, "K\xc3\xbcnstler"));
+            TEST_CHECK(!strcmp(t.Album, "Album"));
+        }
+        else {                                       // the file name without extension
+            std::string name = t.Name;
+            TEST_CHECK(name.substr(0, name.size() - 4) == t.Title);
+        }
+    }
+    TEST_CHECK_EQ(tagged, (ML_TRACKS + 2) / 3);
+    TEST_CHECK(!Library_Get(ML_TRACKS, &t));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ml_reopen() {
+    // unchanged directory: the names are compared, no track is opened or parsed
+    File::s_opens = 0;
+    File::s_bytesRead = 0;
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", false), ML_TRACKS);
+    TEST_CHECK_EQ(File::s_opens, 0);
+    TEST_CHECK_EQ(File::s_bytesRead, sizeof(Library_Header));
+
+    // ten rows for the first screen are read in pages, not the whole database
+    File::s_bytesRead = 0;
+    Library_Track t;
+    for(int i = 0; i < 10; i++) Library_Get(i, &t);
+    TEST_CHECK(File::s_bytesRead <= 3 * LIBRARY_PAGE_SIZE);
+    File::s_bytesRead = 0;
+    for(int i = 0; i < 10; i++) Library_Get(i, &t);
+    TEST_CHECK_EQ(File::s_bytesRead, 0);             // cached
+
+    char name[LIBRARY_NAME_LEN];
+    TEST_CHECK(Library_Name(123, name, sizeof(name)));
+    TEST_CHECK_EQ(Library_Find(name), 123);
+    TEST_CHECK_EQ(Library_Find("missing.mp3"), -1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ml_update() {
+    // a forced rescan takes the unchanged tracks from the database
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", true), ML_TRACKS);
+    TEST_CHECK(sorted());
+    // 10 files added, 5 removed: only the new files are parsed
+    for(int i = 0; i < 10; i++) writeFile("New " + std::to_string(i) + ".mp3", taggedMP3("New", "A", "B"));
+    for(int i = 0; i < 5; i++) remove((s_root + "/" + trackName(i)).c_str());
+    File::s_bytesRead = 0;
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", false), ML_TRACKS + 5);
+    TEST_CHECK(File::s_bytesRead < s_buildBytes / 5);
+    TEST_CHECK(sorted());
+    TEST_CHECK(Library_Find("New 3.mp3") >= 0);
+    TEST_CHECK_EQ(Library_Find(trackName(2).c_str()), -1);
+    char title[LIBRARY_TAG_LEN];
+    TEST_CHECK(Library_Title(Library_Find("New 3.mp3"), title, sizeof(title)));
+    TEST_CHECK(!strcmp(title, "New"));
+    // another extension is another library
+    writeFile("a.flac", {'f', 'L', 'a', 'C'});
+    TEST_CHECK_EQ(Library_Init("/", ".flac", false), 1);
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", false), ML_TRACKS + 5);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ml_containers() {
+    // the test files of the audio library: duration, channels, rate and tags from the headers of each format
+    struct {
+        const char* file;
+        const char* ext;
+        uint8_t     codec;
+        uint16_t    duration;
+        uint8_t     channels;
+        uint32_t    rate;
+        const char* title;
+        const char* artist;
+        const char* album;
+    } c[] = {
+        {"Miss-Marple.m4a", ".m4a", LIBRARY_CODEC_M4A, 27, 2, 44100, "Miss-Marple", "Miss Marple", ""},
+        {"Santiano-Wellerman.flac", ".flac", LIBRARY_CODEC_FLAC, 10, 2, 44100, "Santiano-Wellerman", "Santiano-Wellermann", ""},
+        {"Pink-Panther.wav", ".wav", LIBRARY_CODEC_WAV, 7, 2, 22050, "Pink-Panther", "", ""},
+        {"Collide.ogg", ".ogg", LIBRARY_CODEC_OGG, 28, 2, 44100, "Collide", "Eddie Grey", "Pop Vocals, Vol. 2, Set 5"},
+        {"sample.opus", ".opus", LIBRARY_CODEC_OGG, 18, 2, 48000, "sample", "", "sample 1"},
+    };
+    remove((s_root + "/a.flac").c_str());
+    for(const auto& e : c) {
+        writeFile(e.file, test_readFile(e.file));
+        TEST_CHECK_EQ(Library_Init("/", e.ext, false), 1);
+        Library_Track t;
+        TEST_CHECK(Library_Get(0, &t));
+        TEST_CHECK_EQ(t.Codec, e.codec);
+        TEST_CHECK_EQ(t.Duration, e.duration);
+        TEST_CHECK_EQ(t.Channels, e.channels);
+        TEST_CHECK_EQ(t.Sample_Rate, e.rate);
+        TEST_CHECK(!strcmp(t.Title, e.title));
+        TEST_CHECK(!strcmp(t.Artist, e.artist));
+        TEST_CHECK(!strcmp(t.Album, e.album));
+        remove((s_root + "/" + e.file).c_str());
+    }
+    // a WAV with a LIST/INFO chunk behind the data
+    std::vector<uint8_t> w = test_readFile("Pink-Panther.wav");
+    const char info[] = "INFOINAM\x06\0\0\0Title\0IART\x07\0\0\0Artist\0\0IPRD\x06\0\0\0Album\0";
+    uint8_t list[8] = {'L', 'I', 'S', 'T', sizeof(info) - 1, 0, 0, 0};
+    w.insert(w.end(), list, list + 8);
+    w.insert(w.end(), info, info + sizeof(info) - 1);
+    writeFile("info.wav", w);
+    TEST_CHECK_EQ(Library_Init("/", ".wav", false), 1);
+    Library_Track t;
+    TEST_CHECK(Library_Get(0, &t));
+    TEST_CHECK_EQ(t.Duration, 7);
+    TEST_CHECK(!strcmp(t.Title, "Title") && !strcmp(t.Artist, "Artist") && !strcmp(t.Album, "Album"));
+    remove((s_root + "/info.wav").c_str());
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", false), ML_TRACKS + 5);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_ml_damaged() {
+    Library_Close();
+    FILE* f = fopen((s_root + LIBRARY_FILE).c_str(), "r+b");
+    TEST_CHECK(f != NULL);
+    if(f) { fseek(f, 0, SEEK_END); long n = ftell(f); fclose(f); TEST_CHECK(truncate((s_root + LIBRARY_FILE).c_str(), n / 2) == 0); }
+    TEST_CHECK_EQ(Library_Init("/", ".mp3", false), ML_TRACKS + 5);
+    TEST_CHECK(sorted());
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    char dir[] = "/tmp/library_XXXXXX";
+    if(!mkdtemp(dir)) return 1;
+    s_root = dir;
+    SD_MMC = fs::FS(s_root);
+    std::vector<uint8_t> d = test_readFile("Olsen-Banden.mp3");
+    size_t start = 10 + ((d[6] & 0x7f) << 21 | (d[7] & 0x7f) << 14 | (d[8] & 0x7f) << 7 | (d[9] & 0x7f));
+    s_mp3.assign(d.begin() + start, d.begin() + start + 4096);
+    RUN_TEST(test_ml_build);
+    RUN_TEST(test_ml_reopen);
+    RUN_TEST(test_ml_update);
+    RUN_TEST(test_ml_containers);
+    RUN_TEST(test_ml_damaged);
+    Library_Close();
+    std::string rm = "rm -rf " + s_root;
+    if(system(rm.c_str())) {}
+    return s_testFailures;
+}
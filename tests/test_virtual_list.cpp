@@ -0,0 +1,156 @@
+/*
+ * test_virtual_list.cpp
+ * LVGL_Virtual_List: row pool and heap independent of the number of entries, every visible index bound to the row
+ * at its position while scrolling, scroll range, Scroll_To, Set_Count and Refresh
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "LVGL_Virtual_List.h"
+
+#define VL_WIDTH    360
+#define VL_HEIGHT   300
+#define VL_ROW      60
+#define VL_ENTRIES  5000
+#define VL_POOL     (VL_HEIGHT / VL_ROW + 1 + 2 * VIRTUAL_LIST_MARGIN)
+
+static lv_color_t s_buf[VL_WIDTH * 36];
+static uint32_t   s_binds;
+static const char* s_prefix = "Track";  // the data source
+
+static void flush(lv_disp_drv_t* d, const lv_area_t*, lv_color_t*) { lv_disp_flush_ready(d); }
+static void createRow(lv_obj_t* row, void*) { lv_label_create(row); }
+static void bindRow(lv_obj_t* row, uint32_t index, void*) {
+    s_binds++;
+    lv_label_set_text_fmt(lv_obj_get_child(row, 0), "%s %u", s_prefix, (unsigned)index);
+}
+static size_t heapUsed() {
+    lv_mem_monitor_t m;
+    lv_mem_monitor(&m);
+    return m.total_size - m.free_size;
+}
+// every index in the viewport has its row, at its position and with its text. The rows are moved with lv_obj_set_y(),
+// their coordinates follow with the layout update of the next refresh.
+static uint32_t checkVisible(lv_obj_t* list) {
+    lv_obj_update_layout(list);
+    uint32_t bad = 0, count = Virtual_List_Get_Count(list);
+    int32_t  sy = lv_obj_get_scroll_y(list);
+    for(uint32_t i = sy / VL_ROW; i < count && (int32_t)(i * VL_ROW) < sy + VL_HEIGHT; i++) {
+        lv_obj_t* row = Virtual_List_Get_Row(list, i);
+        if(!row) { bad++; continue; }
+        char text[32];
+        snprintf(text, sizeof(text), "%s %u", s_prefix, (unsigned)i);
+        if(Virtual_List_Get_Index(row) != i || lv_obj_get_y(row) != (lv_coord_t)(i * VL_ROW) ||
+           lv_obj_has_flag(row, LV_OBJ_FLAG_HIDDEN) || strcmp(lv_label_get_text(lv_obj_get_child(row, 0)), text)) bad++;
+    }
+    return bad;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_vl_memory() {
+    // the flex list this replaces: one object and a label per entry
+    size_t    m0 = heapUsed();
+    lv_obj_t* flex = lv_obj_create(lv_scr_act());
+    lv_obj_remove_style_all(flex);
+    lv_obj_set_size(flex, VL_WIDTH, VL_HEIGHT);
+    lv_obj_set_flex_flow(flex, LV_FLEX_FLOW_COLUMN);
+    for(int i = 0; i < 40; i++) {
+        lv_obj_t* b = lv_obj_create(flex);
+        lv_obj_remove_style_all(b);
+        lv_obj_set_size(b, lv_pct(100), VL_ROW);
+        lv_label_set_text_fmt(lv_label_create(b), "Track %d", i);
+    }
+    lv_obj_update_layout(flex);
+    size_t flexHeap = heapUsed() - m0;
+    lv_obj_del(flex);
+
+    size_t heap[2];
+    for(int k = 0; k < 2; k++) {
+        m0 = heapUsed();
+        lv_obj_t* list = Virtual_List_Create(lv_scr_act(), VL_WIDTH, VL_HEIGHT, VL_ROW, createRow, bindRow, NULL);
+        TEST_CHECK(list != NULL);
+        Virtual_List_Set_Count(list, k ? VL_ENTRIES : 50);
+        lv_obj_update_layout(list);
+        heap[k] = heapUsed() - m0;
+        TEST_CHECK_EQ(lv_obj_get_child_cnt(list), VL_POOL);
+        TEST_CHECK_EQ(checkVisible(list), 0);
+        lv_obj_del(list);
+    }
+    TEST_CHECK(heap[1] < heap[0] + 256);  // text lengths differ, the objects do not
+    TEST_CHECK(heap[1] < flexHeap);       // 5000 entries cost less than 40 rows of the flex list
+    TEST_CHECK(heapUsed() <= m0);         // deleting the list frees its pool
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void test_vl_scroll() {
+    lv_obj_t* list = Virtual_List_Create(lv_scr_act(), VL_WIDTH, VL_HEIGHT, VL_ROW, createRow, bindRow, NULL);
+    Virtual_List_Set_Count(list, VL_ENTRIES);
+    lv_obj_update_layout(list);
+    TEST_CHECK_EQ(lv_obj_get_scroll_bottom(list), VL_ENTRIES * VL_ROW - VL_HEIGHT);
+
+    // page and odd steps down, then up again: only the rows that enter the view are bound
+    uint32_t bad = 0, pages = 0;
+    s_binds = 0;
+    while(lv_obj_get_scroll_bottom(list) > 0 && pages < 200) {
+        lv_obj_scroll_by(list, 0, -(pages & 1 ? 7 * VL_ROW : 37), LV_ANIM_OFF);
+        bad += checkVisible(list);
+        pages++;
+    }
+    TEST_CHECK_EQ(bad, 0);
+    TEST_CHECK(s_binds <= (uint32_t)lv_obj_get_scroll_y(list) / VL_ROW + 2 * VL_POOL);
+    for(int k = 0; k < 50; k++) {
+        lv_obj_scroll_by(list, 0, 4 * VL_ROW + 11, LV_ANIM_OFF);
+        bad += checkVisible(list);
+    }
+    TEST_CHECK_EQ(bad, 0);
+    TEST_CHECK_EQ(lv_obj_get_child_cnt(list), VL_POOL);
+
+    // the end of the list, the centre
+    Virtual_List_Scroll_To(list, VL_ENTRIES - 1, LV_ANIM_OFF);
+    TEST_CHECK_EQ(lv_obj_get_scroll_y(list), VL_ENTRIES * VL_ROW - VL_HEIGHT);
+    TEST_CHECK(Virtual_List_Get_Row(list, VL_ENTRIES - 1) != NULL);
+    TEST_CHECK_EQ(checkVisible(list), 0);
+    Virtual_List_Scroll_To(list, 2500, LV_ANIM_OFF);
+    TEST_CHECK_EQ(lv_obj_get_scroll_y(list), 2500 * VL_ROW - (VL_HEIGHT - VL_ROW) / 2);
+    TEST_CHECK_EQ(checkVisible(list), 0);
+    Virtual_List_Scroll_To(list, 1, LV_ANIM_OFF);
+    TEST_CHECK_EQ(lv_obj_get_scroll_y(list), 0);
+    TEST_CHECK(Virtual_List_Get_Row(list, VL_ENTRIES) == NULL);
+
+    // new data, the same rows
+    s_prefix = "Title";
+    Virtual_List_Scroll_To(list, 1234, LV_ANIM_OFF);
+    Virtual_List_Refresh(list);
+    TEST_CHECK_EQ(checkVisible(list), 0);
+    s_prefix = "Track";
+
+    // fewer entries than rows: the scroll position is clamped, the spare rows are hidden
+    Virtual_List_Set_Count(list, 3);
+    lv_obj_update_layout(list);
+    TEST_CHECK_EQ(lv_obj_get_scroll_y(list), 0);
+    TEST_CHECK_EQ(checkVisible(list), 0);
+    uint32_t shown = 0;
+    for(uint32_t i = 0; i < lv_obj_get_child_cnt(list); i++) shown += !lv_obj_has_flag(lv_obj_get_child(list, i), LV_OBJ_FLAG_HIDDEN);
+    TEST_CHECK_EQ(shown, 3);
+    Virtual_List_Set_Count(list, 0);
+    TEST_CHECK(Virtual_List_Get_Row(list, 0) == NULL);
+    Virtual_List_Set_Count(list, VL_ENTRIES);
+    lv_obj_update_layout(list);
+    TEST_CHECK_EQ(checkVisible(list), 0);
+    lv_obj_del(list);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    lv_init();
+    static lv_disp_draw_buf_t db;
+    lv_disp_draw_buf_init(&db, s_buf, NULL, VL_WIDTH * 36);
+    static lv_disp_drv_t dd;
+    lv_disp_drv_init(&dd);
+    dd.hor_res = VL_WIDTH;
+    dd.ver_res = VL_WIDTH;
+    dd.flush_cb = flush;
+    dd.draw_buf = &db;
+    lv_disp_drv_register(&dd);
+    RUN_TEST(test_vl_memory);
+    RUN_TEST(test_vl_scroll);
+    return s_testFailures;
+}
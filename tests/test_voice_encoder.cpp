@@ -0,0 +1,215 @@
+/*
+ * test_voice_encoder.cpp
+ * Voice_Encoder behind MIC_Capture: the test WAVs at 16 kHz as utterances, encoded while they are captured, as
+ * IMA-ADPCM WAV and as Ogg Opus; the streams decoded again (ADPCM here, Opus with the decoder of the audio library),
+ * compression ratio, SNR and encode time per frame, Ogg pages, CRCs and the final granule
+ *
+ *  Created on: 18.10.2026
+ *  Updated on: 18.10.2026
+ */
+#include "test_common.h"
+#include "Voice_Encoder.h"
+#include "opus_decoder/opus_decoder.h"
+#include "ogg_demuxer/ogg_demuxer.h"
+#include <random>
+
+#define VE_LEAD_MS  1000     // noise in front of the speech, less than MIC_PREROLL_MS: the utterance starts at Arm
+#define VE_TAIL_MS  1000
+
+static std::vector<uint8_t> s_stream;
+static uint32_t             s_events[4];
+static std::mt19937         s_rng(1);
+
+static void sink(uint8_t event, const uint8_t* data, uint32_t len) {
+    s_events[event]++;
+    if(event == VOICE_START) s_stream.clear();
+    s_stream.insert(s_stream.end(), data, data + len);
+}
+// a test file at 16 kHz mono, linear interpolation, 5 s at most: shorter than MIC_VAD_MAX_MS with the lead
+static std::vector<int16_t> speech(const char* name) {
+    std::vector<uint8_t> d = test_readFile(name);
+    uint16_t             ch = test_rd16(&d[22]), bits = test_rd16(&d[34]);
+    uint32_t             rate = test_rd32(&d[24]), pos = 12;
+    while(memcmp(&d[pos], "data", 4)) pos += 8 + test_rd32(&d[pos + 4]);
+    uint32_t           frames = test_rd32(&d[pos + 4]) / (ch * bits / 8);
+    const uint8_t*     p = &d[pos + 8];
+    std::vector<float> mono(frames);
+    for(uint32_t i = 0; i < frames; i++) {
+        float s = 0;
+        for(int c = 0; c < ch; c++) s += bits == 16 ? (int16_t)test_rd16(p + (i * ch + c) * 2) : (p[i * ch + c] - 128) * 256;
+        mono[i] = s / ch;
+    }
+    std::vector<int16_t> out;
+    for(double t = 0; t < frames - 1 && out.size() < 5 * 16000; t += rate / 16000.0) {
+        uint32_t i = t;
+        double   a = t - i;
+        out.push_back(mono[i] * (1 - a) + mono[i + 1] * a);
+    }
+    return out;
+}
+static double snrDb(const int16_t* a, const int16_t* b, size_t n) {
+    double s = 0, e = 0;
+    for(size_t i = 0; i < n; i++) {
+        s += (double)a[i] * a[i];
+        e += ((double)a[i] - b[i]) * ((double)a[i] - b[i]);
+    }
+    return 10 * log10(s / (e + 1e-9));
+}
+//----------------------------------------------------------------------------------------------------------------------
+// the reference IMA-ADPCM decoder of the WAV format
+static std::vector<int16_t> decodeADPCM(const std::vector<uint8_t>& s) {
+    static const int16_t step[89] = {
+        7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+        31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+        130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+        544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+        2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+        9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+    static const int8_t  index[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+    std::vector<int16_t> y;
+    for(size_t p = 48; p + VOICE_ADPCM_BLOCK <= s.size(); p += VOICE_ADPCM_BLOCK) {
+        int pred = (int16_t)test_rd16(&s[p]), idx = s[p + 2];
+        y.push_back(pred);
+        for(int i = 0; i < VOICE_ADPCM_SAMPLES - 1; i++) {
+            int c = (s[p + 4 + i / 2] >> ((i & 1) * 4)) & 15, st = step[idx], d = st >> 3;
+            if(c & 4) d += st;
+            if(c & 2) d += st >> 1;
+            if(c & 1) d += st >> 2;
+            pred = max(-32768, min(32767, (c & 8) ? pred - d : pred + d));
+            idx = max(0, min(88, idx + index[c & 7]));
+            y.push_back(pred);
+        }
+    }
+    return y;
+}
+// the Ogg pages: CRC, sequence and the granule of the last one; the decoder of the library, the left channel at 16 kHz
+static std::vector<int16_t> decodeOpus(std::vector<uint8_t> s, uint32_t* pages, uint64_t* granule) {
+    static ogg_page_t pg;
+    *pages = 0;
+    for(size_t p = 0; p < s.size(); p += pg.headerSize + pg.bodySize) {
+        TEST_CHECK_EQ(OGG_parsePage(&s[p], s.size() - p, &pg), OGG_PAGE_OK);
+        TEST_CHECK_EQ(OGG_pageCRC(&s[p], pg.headerSize + pg.bodySize), pg.CRCchecksum);
+        TEST_CHECK_EQ(pg.pageSequenceNr, *pages);
+        TEST_CHECK_EQ(pg.serialNr, VOICE_OGG_SERIAL);
+        TEST_CHECK_EQ(pg.lastPage, p + pg.headerSize + pg.bodySize == s.size());
+        (*pages)++;
+        *granule = pg.granulePosition;
+    }
+    std::vector<int16_t> y;
+    static int16_t       out[8192];
+    size_t               total = s.size(), pos = 0;
+    s.resize(total + 8192, 0);
+    OPUSsetDefaults();
+    pos = OPUSFindSyncWord(s.data(), total);
+    while(pos < total) {
+        int len = min(total - pos, (size_t)1024), left = len;
+        int ret = OPUSDecode(&s[pos], &left, out);
+        TEST_CHECK(ret >= 0);
+        if(ret < 0) break;
+        pos += len - left;
+        if(ret == OPUS_PARSE_OGG_DONE) continue;
+        for(uint16_t k = 0; k < OPUSGetOutputSamps(); k += 3) y.push_back(out[2 * k]);
+    }
+    TEST_CHECK_EQ(OPUSGetChannels(), 1);
+    return y;
+}
+//----------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    double   ratio;
+    double   snr;
+    double   usPerFrame;
+    uint32_t samples;
+} ve_result_t;
+
+// noise, the file, noise in 10 ms I2S blocks; MICTask: VAD, then the encoder
+static std::vector<int16_t> s_in;
+static ve_result_t encode(uint8_t format, const std::vector<int16_t>& x) {
+    std::normal_distribution<float> noise(0, 8);
+    s_in.assign(VE_LEAD_MS * 16, 0);
+    for(int16_t& s : s_in) s = noise(s_rng);
+    s_in.insert(s_in.end(), x.begin(), x.end());
+    for(uint32_t i = 0; i < VE_TAIL_MS * 16; i++) s_in.push_back(noise(s_rng));
+
+    TEST_CHECK(Voice_Encoder_Init(format, sink));
+    memset(s_events, 0, sizeof(s_events));
+    const Voice_Stats* st = Voice_Encoder_Get_Stats();
+    Voice_Stats        st0 = *st;
+    MIC_Capture_Arm(true);
+    int16_t stereo[2 * 160] = {};
+    for(size_t i = 0; i + 160 <= s_in.size(); i += 160) {
+        for(int k = 0; k < 160; k++) stereo[2 * k + MIC_SLOT] = s_in[i + k];
+        MIC_Capture_Write(stereo, 160);
+        MIC_Capture_Process();
+        Voice_Encoder_Process();
+    }
+    TEST_CHECK(s_events[VOICE_START] == 1 && s_events[VOICE_END] == 1 && s_events[VOICE_ABORT] == 0);
+    TEST_CHECK(!Voice_Encoder_Active());
+    TEST_CHECK_EQ(MIC_Capture_State(), MIC_IDLE);
+    TEST_CHECK_EQ(st->Bytes - st0.Bytes, s_stream.size());
+
+    ve_result_t r;
+    r.samples = st->Samples - st0.Samples;
+    r.ratio = r.samples * 2.0 / s_stream.size();
+    r.usPerFrame = (double)(st->Encode_Us_Sum - st0.Encode_Us_Sum) / (st->Frames - st0.Frames);
+    TEST_CHECK(r.samples > VE_LEAD_MS * 16 + x.size() && r.samples < s_in.size());   // up to the end of the silence
+    return r;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static const char* s_files[] = {"Pink-Panther.wav", "test_16bit_stereo.wav", "test_8bit_mono.wav"};
+
+static void test_ve_adpcm() {
+    // the WAV header, whole blocks; the decoded samples are the input from Arm on, close to 4:1, 27 dB at least
+    for(const char* name : s_files) {
+        ve_result_t r = encode(VOICE_FORMAT_ADPCM, speech(name));
+        TEST_CHECK(!memcmp(&s_stream[0], "RIFF", 4) && !memcmp(&s_stream[8], "WAVEfmt ", 8));
+        TEST_CHECK_EQ(test_rd16(&s_stream[20]), 0x11);
+        TEST_CHECK_EQ(test_rd32(&s_stream[24]), MIC_SAMPLE_RATE);
+        TEST_CHECK_EQ(test_rd16(&s_stream[32]), VOICE_ADPCM_BLOCK);
+        TEST_CHECK_EQ(test_rd16(&s_stream[38]), VOICE_ADPCM_SAMPLES);
+        TEST_CHECK_EQ((s_stream.size() - 48) % VOICE_ADPCM_BLOCK, 0);
+        std::vector<int16_t> y = decodeADPCM(s_stream);
+        TEST_CHECK(y.size() >= r.samples && y.size() < r.samples + VOICE_ADPCM_SAMPLES);
+        r.snr = snrDb(&s_in[0], &y[0], r.samples);
+        printf("adpcm %-22s %6u samples %6zu bytes  %4.1f:1  SNR %4.1f dB  %5.1f us/block\n", name, r.samples,
+               s_stream.size(), r.ratio, r.snr, r.usPerFrame);
+        TEST_CHECK(r.ratio > 3.8);
+        TEST_CHECK(r.snr > 27);
+    }
+}
+static void test_ve_opus() {
+    // OpusHead, OpusTags, pages of VOICE_OGG_FRAMES packets at 24 kbit/s; the granule of the last page is the pre-skip
+    // and the samples of the utterance, the decoder of the library plays it back
+    TEST_CHECK(OPUSDecoder_AllocateBuffers());
+    for(const char* name : s_files) {
+        ve_result_t r = encode(VOICE_FORMAT_OPUS, speech(name));
+        uint32_t    pages = 0;
+        uint64_t    granule = 0;
+        std::vector<int16_t> y = decodeOpus(s_stream, &pages, &granule);
+        uint32_t             packets = (r.samples * 3 + VOICE_OPUS_PRESKIP + 959) / 960; // the overlap flushed
+        TEST_CHECK_EQ(pages, 2 + (packets + VOICE_OGG_FRAMES - 1) / VOICE_OGG_FRAMES);
+        TEST_CHECK_EQ(granule, (uint64_t)r.samples * 3 + VOICE_OPUS_PRESKIP);
+        // the decoder output is behind by the pre-skip, the MDCT overlap
+        int    lag = 0;
+        double best = -100;
+        size_t n = min((size_t)r.samples, y.size()) - 80;
+        for(int l = 0; l < 80; l++) {
+            double snr = snrDb(&s_in[0], &y[l], n);
+            if(snr > best) { best = snr; lag = l; }
+        }
+        r.snr = best;
+        printf("opus  %-22s %6u samples %6zu bytes  %4.1f:1  SNR %4.1f dB  %5.1f us/frame, %u pages, delay %d\n", name,
+               r.samples, s_stream.size(), r.ratio, r.snr, r.usPerFrame, pages, lag);
+        TEST_CHECK_EQ(lag, VOICE_OPUS_PRESKIP / 3);
+        TEST_CHECK(r.ratio > 9);
+        TEST_CHECK(r.snr > 12);
+    }
+    OPUSDecoder_FreeBuffers();
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    TEST_CHECK(MIC_Capture_Init());
+    OGG_setCRCcheck(true);
+    RUN_TEST(test_ve_adpcm);
+    RUN_TEST(test_ve_opus);
+    return s_testFailures;
+}